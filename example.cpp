@@ -14,70 +14,261 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <cstdio>
+#include <memory>
+
+#if !defined(_WIN32)
+    #include <cerrno>
+    #include <csignal>
+    #include <fcntl.h>
+    #include <glob.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#else
+    #include <fcntl.h>
+    #include <io.h>
+#endif
 
 #include <motioncam/Decoder.hpp>
-#include <audiofile/AudioFile.h>
+#include <motioncam/RawData.hpp>
+#include <motioncam/RingBuffer.hpp>
+#include <motioncam/ThreadPool.hpp>
+#include <motioncam/Trace.hpp>
 
 #define TINY_DNG_WRITER_IMPLEMENTATION
     #include <tinydng/tiny_dng_writer.h>
 #undef TINY_DNG_WRITER_IMPLEMENTATION
 
+struct WavHeader {
+    char riff[4];
+    uint32_t riffSize;
+    char wave[4];
+    char fmt[4];
+    uint32_t fmtSize;
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sampleRate;
+    uint32_t byteRate;
+    uint16_t blockAlign;
+    uint16_t bitsPerSample;
+    char data[4];
+    uint32_t dataSize;
+};
+
+WavHeader makeWavHeader(const int sampleRateHz, const int numChannels, const uint32_t dataBytes) {
+    const uint16_t blockAlign = static_cast<uint16_t>(numChannels * sizeof(int16_t));
+
+    WavHeader header = {
+        { 'R', 'I', 'F', 'F' },
+        static_cast<uint32_t>(sizeof(WavHeader) - 8 + dataBytes),
+        { 'W', 'A', 'V', 'E' },
+        { 'f', 'm', 't', ' ' },
+        16,
+        1,  // PCM
+        static_cast<uint16_t>(numChannels),
+        static_cast<uint32_t>(sampleRateHz),
+        static_cast<uint32_t>(sampleRateHz) * blockAlign,
+        blockAlign,
+        16,
+        { 'd', 'a', 't', 'a' },
+        dataBytes
+    };
+
+    return header;
+}
+
+// Stream the audio chunks straight into a 16-bit PCM WAV. The decoded
+// chunks are already interleaved exactly as WAV stores its sample frames,
+// so the file is a header with sizes precomputed from the chunk lengths
+// followed by the chunks written out one at a time - no per-sample
+// splitting and no whole-recording buffer.
 void writeAudio(
     const std::string& outputPath,
     const int sampleRateHz,
     const int numChannels,
     std::vector<motioncam::AudioChunk>& audioChunks)
 {
-    AudioFile<int16_t> audio;
-    
-    audio.setNumChannels(numChannels);
-    audio.setSampleRate(sampleRateHz);
-    
-    if(numChannels == 2) {
-        for(auto& x : audioChunks) {
-            for(auto i = 0; i < x.second.size(); i+=2) {
-                audio.samples[0].push_back(x.second[i]);
-                audio.samples[1].push_back(x.second[i+1]);
-            }
-        }
+    if(numChannels <= 0)
+        return;
+
+    size_t totalSamples = 0;
+
+    for(const auto& x : audioChunks)
+        totalSamples += x.second.size();
+
+    std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(outputPath.c_str(), "wb"), fclose);
+
+    if(!file)
+        throw std::runtime_error("Failed to create " + outputPath);
+
+    const WavHeader header = makeWavHeader(sampleRateHz, numChannels, static_cast<uint32_t>(totalSamples * sizeof(int16_t)));
+
+    if(fwrite(&header, sizeof(WavHeader), 1, file.get()) != 1)
+        throw std::runtime_error("Failed to write " + outputPath);
+
+    for(const auto& x : audioChunks) {
+        if(x.second.empty())
+            continue;
+
+        if(fwrite(x.second.data(), sizeof(int16_t), x.second.size(), file.get()) != x.second.size())
+            throw std::runtime_error("Failed to write " + outputPath);
+    }
+}
+
+// Streams PCM into a WAV as chunks arrive: the header goes out first with
+// zero sizes and the real ones are patched in by close(), so writing can
+// begin before the total length is known. Creates no file when the stream
+// has no channels.
+class StreamingWavWriter {
+public:
+    StreamingWavWriter(const std::string& outputPath, const int sampleRateHz, const int numChannels)
+        : mPath(outputPath),
+          mFile(nullptr, fclose)
+    {
+        if(numChannels <= 0)
+            return;
+
+        mFile.reset(fopen(outputPath.c_str(), "wb"));
+
+        if(!mFile)
+            throw std::runtime_error("Failed to create " + outputPath);
+
+        mHeader = makeWavHeader(sampleRateHz, numChannels, 0);
+
+        if(fwrite(&mHeader, sizeof(WavHeader), 1, mFile.get()) != 1)
+            throw std::runtime_error("Failed to write " + outputPath);
+    }
+
+    void writeSamples(const int16_t* samples, const size_t numSamples) {
+        if(!mFile || numSamples == 0)
+            return;
+
+        if(fwrite(samples, sizeof(int16_t), numSamples, mFile.get()) != numSamples)
+            throw std::runtime_error("Failed to write " + mPath);
+
+        mTotalSamples += numSamples;
     }
-    else if(numChannels == 1) {
-        for(auto& x : audioChunks) {
-            for(auto i = 0; i < x.second.size(); i++)
-                audio.samples[0].push_back(x.second[i]);
+
+    // Patch the real sizes into the header and close the file
+    void close() {
+        if(!mFile)
+            return;
+
+        const uint32_t dataBytes = static_cast<uint32_t>(mTotalSamples * sizeof(int16_t));
+
+        mHeader.riffSize = static_cast<uint32_t>(sizeof(WavHeader) - 8 + dataBytes);
+        mHeader.dataSize = dataBytes;
+
+        if(fseek(mFile.get(), 0, SEEK_SET) != 0 || fwrite(&mHeader, sizeof(WavHeader), 1, mFile.get()) != 1)
+            throw std::runtime_error("Failed to write " + mPath);
+
+        mFile.reset();
+    }
+
+private:
+    std::string mPath;
+    std::unique_ptr<FILE, int(*)(FILE*)> mFile;
+    WavHeader mHeader{};
+    size_t mTotalSamples{0};
+};
+
+// Bits per sample to store, from the sensor's white level. Unknown or
+// unusual levels fall back to the full 16 bits.
+int dngBitsPerSample(double whiteLevel) {
+    if(whiteLevel >= 4)  {
+        if(whiteLevel <= 1023)
+            return 10;
+
+        if(whiteLevel <= 4095)
+            return 12;
+    }
+
+    return 16;
+}
+
+// Pack 16-bit samples down to bits per sample, MSB first with each row
+// starting on a byte boundary, as TIFF/DNG expects. Samples are clamped to
+// the packed range so an outlier cannot corrupt its neighbours.
+void packSamples(
+    const std::vector<uint16_t>& data,
+    const unsigned int width,
+    const unsigned int height,
+    const int bits,
+    std::vector<uint8_t>& out)
+{
+    const size_t rowBytes = (static_cast<size_t>(width) * bits + 7) / 8;
+    const uint16_t maxVal = static_cast<uint16_t>((1u << bits) - 1);
+
+    out.resize(rowBytes * height);
+
+    for(unsigned int y = 0; y < height; y++) {
+        const uint16_t* src = data.data() + static_cast<size_t>(y) * width;
+        uint8_t* dst = out.data() + static_cast<size_t>(y) * rowBytes;
+
+        uint32_t acc = 0;
+        int accBits = 0;
+
+        for(unsigned int x = 0; x < width; x++) {
+            acc = (acc << bits) | std::min(src[x], maxVal);
+            accBits += bits;
+
+            while(accBits >= 8) {
+                *dst++ = static_cast<uint8_t>(acc >> (accBits - 8));
+                accBits -= 8;
+            }
         }
+
+        if(accBits > 0)
+            *dst = static_cast<uint8_t>(acc << (8 - accBits));
     }
-    
-    audio.save(outputPath);
 }
 
-void writeDng(
-    const std::string& outputPath,
+// Set up the DNG image for a frame; shared by the file and in-memory writers
+void buildDng(
+    tinydngwriter::DNGImage& dng,
     const std::vector<uint16_t>& data,
     const nlohmann::json& metadata,
-    const nlohmann::json& containerMetadata)
+    const motioncam::ContainerMetadata& containerMetadata)
 {
     const unsigned int width = metadata["width"];
     const unsigned int height = metadata["height"];
-    
+
     std::vector<double> asShotNeutral = metadata["asShotNeutral"];
 
-    std::vector<uint16_t> blackLevel = containerMetadata["blackLevel"];
-    double whiteLevel = containerMetadata["whiteLevel"];
-    std::string sensorArrangement = containerMetadata["sensorArrangment"];
-    std::vector<double> colorMatrix1 = containerMetadata["colorMatrix1"];
-    std::vector<double> colorMatrix2 = containerMetadata["colorMatrix2"];
-    std::vector<double> forwardMatrix1 = containerMetadata["forwardMatrix1"];
-    std::vector<double> forwardMatrix2 = containerMetadata["forwardMatrix2"];
+    double whiteLevel = containerMetadata.whiteLevel;
 
-    // Create first frame
-    tinydngwriter::DNGImage dng;
+    const int bits = dngBitsPerSample(whiteLevel);
 
     dng.SetBigEndian(false);
     dng.SetDNGVersion(0, 0, 4, 1);
     dng.SetDNGBackwardVersion(0, 0, 1, 1);
-    dng.SetImageData(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+
+    // Store 10/12-bit captures packed instead of inflated to 16 bits; the
+    // bytes written per frame drop proportionally. SetImageData copies, so
+    // the packed scratch is only needed for this call.
+    if(bits < 16) {
+        std::vector<uint8_t> packed;
+
+        packSamples(data, width, height, bits, packed);
+
+        dng.SetImageData(packed.data(), packed.size());
+    }
+    else {
+        dng.SetImageData(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+    }
+
     dng.SetImageWidth(width);
     dng.SetImageLength(height);
     dng.SetPlanarConfig(tinydngwriter::PLANARCONFIG_CONTIG);
@@ -87,40 +278,59 @@ void writeDng(
     dng.SetCFARepeatPatternDim(2, 2);
     
     dng.SetBlackLevelRepeatDim(2, 2);
-    dng.SetBlackLevel(4, blackLevel.data());
+    dng.SetBlackLevel(4, containerMetadata.blackLevel.data());
     dng.SetWhiteLevelRational(1, &whiteLevel);
 
     std::vector<uint8_t> cfa;
-    
-    if(sensorArrangement == "rggb")
-        cfa = { 0, 1, 1, 2 };
-    else if(sensorArrangement == "bggr")
-        cfa = { 2, 1, 1, 0 };
-    else if(sensorArrangement == "grbg")
-        cfa = { 1, 0, 2, 1 };
-    else if(sensorArrangement == "gbrg")
-        cfa = { 1, 2, 0, 1 };
-    else
-        throw std::runtime_error("Invalid sensor arrangement");
+
+    switch(containerMetadata.sensorArrangement) {
+        case motioncam::ColorFilterArrangement::RGGB:
+            cfa = { 0, 1, 1, 2 };
+            break;
+        case motioncam::ColorFilterArrangement::BGGR:
+            cfa = { 2, 1, 1, 0 };
+            break;
+        case motioncam::ColorFilterArrangement::GRBG:
+            cfa = { 1, 0, 2, 1 };
+            break;
+        case motioncam::ColorFilterArrangement::GBRG:
+            cfa = { 1, 2, 0, 1 };
+            break;
+        default:
+            throw std::runtime_error("Invalid sensor arrangement");
+    }
 
     dng.SetCFAPattern(4, cfa.data());
     
     // Rectangular
     dng.SetCFALayout(1);
 
-    const uint16_t bps[1] = { 16 };
+    const uint16_t bps[1] = { static_cast<uint16_t>(bits) };
     dng.SetBitsPerSample(1, bps);
     
-    dng.SetColorMatrix1(3, colorMatrix1.data());
-    dng.SetColorMatrix2(3, colorMatrix2.data());
+    dng.SetColorMatrix1(3, containerMetadata.colorMatrix1.data());
+    dng.SetColorMatrix2(3, containerMetadata.colorMatrix2.data());
 
-    dng.SetForwardMatrix1(3, forwardMatrix1.data());
-    dng.SetForwardMatrix2(3, forwardMatrix2.data());
+    dng.SetForwardMatrix1(3, containerMetadata.forwardMatrix1.data());
+    dng.SetForwardMatrix2(3, containerMetadata.forwardMatrix2.data());
     
     dng.SetAsShotNeutral(3, asShotNeutral.data());
     
     const uint32_t activeArea[4] = { 0, 0, height, width };
     dng.SetActiveArea(&activeArea[0]);
+}
+
+void writeDng(
+    const std::string& outputPath,
+    const std::vector<uint16_t>& data,
+    const nlohmann::json& metadata,
+    const motioncam::ContainerMetadata& containerMetadata)
+{
+    MOTIONCAM_TRACE_SCOPE("writeDng");
+
+    tinydngwriter::DNGImage dng;
+
+    buildDng(dng, data, metadata, containerMetadata);
 
     // Write DNG
     std::string err;
@@ -131,65 +341,1292 @@ void writeDng(
     writer.WriteToFile(outputPath.c_str(), &err);
 }
 
+// Seekable output stream over a caller-provided growable buffer, so the DNG
+// writer's stream internals can serialize straight into memory
+class VectorStreamBuf : public std::streambuf {
+public:
+    explicit VectorStreamBuf(std::vector<uint8_t>& buffer) : mBuffer(buffer) {
+        mBuffer.clear();
+    }
+
+protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if(mPos + n > mBuffer.size())
+            mBuffer.resize(mPos + n);
+
+        std::memcpy(mBuffer.data() + mPos, s, n);
+        mPos += n;
+
+        return n;
+    }
+
+    int overflow(int ch) override {
+        if(ch != traits_type::eof()) {
+            const char c = static_cast<char>(ch);
+            xsputn(&c, 1);
+        }
+
+        return ch;
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override {
+        const size_t base =
+            dir == std::ios_base::beg ? 0 :
+            dir == std::ios_base::cur ? mPos : mBuffer.size();
+
+        mPos = base + off;
+
+        if(mPos > mBuffer.size())
+            mBuffer.resize(mPos);
+
+        return static_cast<pos_type>(mPos);
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode mode) override {
+        return seekoff(static_cast<off_type>(pos), std::ios_base::beg, mode);
+    }
+
+private:
+    std::vector<uint8_t>& mBuffer;
+    size_t mPos{0};
+};
+
+// Serialize a frame's DNG into outBuffer instead of a file, so consumers
+// can take frames straight from memory without a per-frame temp-file
+// round trip
+void exportDng(
+    std::vector<uint8_t>& outBuffer,
+    const std::vector<uint16_t>& data,
+    const nlohmann::json& metadata,
+    const motioncam::ContainerMetadata& containerMetadata)
+{
+    tinydngwriter::DNGImage dng;
+
+    buildDng(dng, data, metadata, containerMetadata);
+
+    std::string err;
+    tinydngwriter::DNGWriter writer(false);
+
+    writer.AddImage(&dng);
+
+    VectorStreamBuf buf(outBuffer);
+    std::ostream stream(&buf);
+
+    if(!writer.WriteToStream(&stream, &err))
+        throw std::runtime_error("Failed to serialize DNG: " + err);
+}
+
+// Writes the DNGs of one clip by patching a serialized template. The tag
+// set - color matrices, CFA pattern, black levels - is identical for every
+// frame of a clip; only the image strip and the AsShotNeutral rationals
+// vary. The first frame's serialized bytes are kept as a template, located
+// once, and every later frame is emitted as the template with just those
+// two regions replaced - no per-frame tag building or IFD serialization.
+// write() is safe to call from several threads at once.
+class DngSequenceWriter {
+public:
+    explicit DngSequenceWriter(const motioncam::ContainerMetadata& containerMetadata)
+        : mContainerMetadata(containerMetadata)
+    {
+    }
+
+    // Serialize one frame's DNG into outBuffer through the same template
+    // fast path as write(); used by the bundle output, which appends the
+    // serialized frames to a single file instead of creating one per frame
+    void render(std::vector<uint8_t>& outBuffer, const std::vector<uint16_t>& data, const nlohmann::json& metadata) {
+        std::call_once(mOnce, [&] { buildTemplate(data, metadata); });
+
+        const unsigned int width = metadata["width"];
+        const unsigned int height = metadata["height"];
+
+        if(!mValid || width != mWidth || height != mHeight) {
+            exportDng(outBuffer, data, metadata, mContainerMetadata);
+            return;
+        }
+
+        std::vector<uint8_t> packed;
+        const uint8_t* strip;
+        size_t stripLen;
+
+        if(mBits < 16) {
+            packSamples(data, mWidth, mHeight, mBits, packed);
+
+            strip = packed.data();
+            stripLen = packed.size();
+        }
+        else {
+            strip = reinterpret_cast<const uint8_t*>(data.data());
+            stripLen = data.size();
+        }
+
+        std::vector<double> asShotNeutral = metadata["asShotNeutral"];
+        uint8_t neutral[NEUTRAL_BYTES];
+
+        if(stripLen != mStripBytes || asShotNeutral.size() != 3 || !encodeNeutral(asShotNeutral.data(), neutral)) {
+            exportDng(outBuffer, data, metadata, mContainerMetadata);
+            return;
+        }
+
+        // The template with the two variable regions substituted
+        outBuffer.resize(mTemplate.size());
+
+        uint8_t* dst = outBuffer.data();
+
+        std::memcpy(dst, mTemplate.data(), mStripOffset);
+        std::memcpy(dst + mStripOffset, strip, stripLen);
+        std::memcpy(dst + mStripOffset + mStripBytes, mTemplate.data() + mStripOffset + mStripBytes,
+            mNeutralOffset - (mStripOffset + mStripBytes));
+        std::memcpy(dst + mNeutralOffset, neutral, NEUTRAL_BYTES);
+        std::memcpy(dst + mNeutralOffset + NEUTRAL_BYTES, mTemplate.data() + mNeutralOffset + NEUTRAL_BYTES,
+            mTemplate.size() - mNeutralOffset - NEUTRAL_BYTES);
+    }
+
+    void write(const std::string& outputPath, const std::vector<uint16_t>& data, const nlohmann::json& metadata) {
+        std::call_once(mOnce, [&] { buildTemplate(data, metadata); });
+
+        const unsigned int width = metadata["width"];
+        const unsigned int height = metadata["height"];
+
+        // A frame the template doesn't fit - changed dimensions, or the
+        // template failed to build - takes the full per-frame path
+        if(!mValid || width != mWidth || height != mHeight) {
+            writeDng(outputPath, data, metadata, mContainerMetadata);
+            return;
+        }
+
+        // Image strip bytes for this frame
+        std::vector<uint8_t> packed;
+        const uint8_t* strip;
+        size_t stripLen;
+
+        if(mBits < 16) {
+            packSamples(data, mWidth, mHeight, mBits, packed);
+
+            strip = packed.data();
+            stripLen = packed.size();
+        }
+        else {
+            strip = reinterpret_cast<const uint8_t*>(data.data());
+            stripLen = data.size();
+        }
+
+        // AsShotNeutral rationals, encoded exactly as the tag builder would
+        std::vector<double> asShotNeutral = metadata["asShotNeutral"];
+        uint8_t neutral[NEUTRAL_BYTES];
+
+        if(stripLen != mStripBytes || asShotNeutral.size() != 3 || !encodeNeutral(asShotNeutral.data(), neutral)) {
+            writeDng(outputPath, data, metadata, mContainerMetadata);
+            return;
+        }
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(outputPath.c_str(), "wb"), fclose);
+
+        if(!file)
+            throw std::runtime_error("Failed to create " + outputPath);
+
+        // Template bytes with the two variable regions substituted, in
+        // file order (the strip precedes the rationals in the data area)
+        bool ok = fwrite(mTemplate.data(), 1, mStripOffset, file.get()) == mStripOffset
+            && fwrite(strip, 1, stripLen, file.get()) == stripLen
+            && fwrite(mTemplate.data() + mStripOffset + mStripBytes, 1, mNeutralOffset - (mStripOffset + mStripBytes), file.get()) == mNeutralOffset - (mStripOffset + mStripBytes)
+            && fwrite(neutral, 1, NEUTRAL_BYTES, file.get()) == NEUTRAL_BYTES
+            && fwrite(mTemplate.data() + mNeutralOffset + NEUTRAL_BYTES, 1, mTemplate.size() - mNeutralOffset - NEUTRAL_BYTES, file.get()) == mTemplate.size() - mNeutralOffset - NEUTRAL_BYTES;
+
+        if(!ok)
+            throw std::runtime_error("Failed to write " + outputPath);
+    }
+
+private:
+    static constexpr size_t NEUTRAL_BYTES = 3 * 8;  // three RATIONALs
+
+    // Little-endian numerator/denominator pairs, through the same
+    // conversion the tag builder uses
+    static bool encodeNeutral(const double* values, uint8_t* out) {
+        for(int i = 0; i < 3; i++) {
+            double numerator, denominator;
+
+            if(tinydngwriter::DoubleToRational(values[i], &numerator, &denominator) != 0)
+                return false;
+
+            const uint32_t pair[2] = { static_cast<uint32_t>(numerator), static_cast<uint32_t>(denominator) };
+
+            std::memcpy(out + 8*i, pair, 8);
+        }
+
+        return true;
+    }
+
+    void buildTemplate(const std::vector<uint16_t>& data, const nlohmann::json& metadata) {
+        // Serialize the first frame with recognizable AsShotNeutral values
+        // so their rationals can be located in the byte stream. Odd
+        // integers pass through the rational conversion as value over one.
+        static const double sentinels[3] = { 9999991.0, 9999973.0, 9999943.0 };
+
+        nlohmann::json templateMetadata = metadata;
+        templateMetadata["asShotNeutral"] = { sentinels[0], sentinels[1], sentinels[2] };
+
+        tinydngwriter::DNGImage dng;
+
+        buildDng(dng, data, templateMetadata, mContainerMetadata);
+
+        std::string err;
+        tinydngwriter::DNGWriter writer(false);
+
+        writer.AddImage(&dng);
+
+        VectorStreamBuf buf(mTemplate);
+        std::ostream stream(&buf);
+
+        if(!writer.WriteToStream(&stream, &err))
+            throw std::runtime_error("Failed to serialize DNG: " + err);
+
+        mWidth = metadata["width"];
+        mHeight = metadata["height"];
+        mBits = dngBitsPerSample(mContainerMetadata.whiteLevel);
+
+        // The file is the 8 byte TIFF header, the image's data area, then
+        // the IFD, so the strip location within the data area maps
+        // straight to a file offset
+        mStripOffset = 8 + dng.GetStripOffset();
+        mStripBytes = dng.GetStripBytes();
+
+        uint8_t pattern[NEUTRAL_BYTES];
+
+        if(!encodeNeutral(sentinels, pattern))
+            return;
+
+        // The sentinel pattern must appear exactly once; a second match
+        // (conceivably inside the image strip) would make patching unsafe
+        size_t found = 0;
+
+        for(size_t i = 0; i + NEUTRAL_BYTES <= mTemplate.size(); i++) {
+            if(std::memcmp(mTemplate.data() + i, pattern, NEUTRAL_BYTES) == 0) {
+                mNeutralOffset = i;
+                found++;
+            }
+        }
+
+        // The writer emits the strip before the aux tag data, which the
+        // split write relies on
+        mValid = found == 1
+            && mStripOffset + mStripBytes <= mNeutralOffset
+            && mNeutralOffset + NEUTRAL_BYTES <= mTemplate.size();
+    }
+
+    const motioncam::ContainerMetadata& mContainerMetadata;
+    std::once_flag mOnce;
+    std::vector<uint8_t> mTemplate;
+    unsigned int mWidth{0};
+    unsigned int mHeight{0};
+    int mBits{0};
+    size_t mStripOffset{0};
+    size_t mStripBytes{0};
+    size_t mNeutralOffset{0};
+    bool mValid{false};
+};
+
+// Size of a finished output file, 0 when it does not exist
+uint64_t outputFileSize(const std::string& path) {
+    std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(path.c_str(), "rb"), fclose);
+
+    if(!file || fseek(file.get(), 0, SEEK_END) != 0)
+        return 0;
+
+    const long size = ftell(file.get());
+
+    return size > 0 ? static_cast<uint64_t>(size) : 0;
+}
+
+// Completion record of an export, one JSON line per frame the writers
+// finished (timestamp, output path, size), appended and flushed as frames
+// land. A re-run with --resume loads it, keeps the frames whose output
+// files still exist at the recorded size, and decodes only the rest - so
+// restarting a crashed 50k-frame export costs the missing tail, not the
+// whole job. A torn last line from the crash parses as invalid and that
+// frame is simply redone.
+class ExportManifest {
+public:
+    // A fresh export truncates any stale manifest; a resumed one appends
+    ExportManifest(const std::string& path, bool resume)
+        : mFile(fopen(path.c_str(), resume ? "ab" : "wb"), fclose)
+    {
+    }
+
+    // Timestamps recorded complete whose output files verify by size.
+    // Cheap: one stat-equivalent per completed frame, no decode.
+    static std::unordered_set<motioncam::Timestamp> loadCompleted(const std::string& path) {
+        std::unordered_set<motioncam::Timestamp> completed;
+        std::ifstream file(path);
+        std::string line;
+
+        while(std::getline(file, line)) {
+            nlohmann::json entry = nlohmann::json::parse(line, nullptr, false);
+
+            if(entry.is_discarded() || !entry.contains("timestamp") || !entry.contains("path") || !entry.contains("bytes"))
+                continue;
+
+            if(outputFileSize(entry["path"].get<std::string>()) == entry["bytes"].get<uint64_t>())
+                completed.insert(entry["timestamp"].get<motioncam::Timestamp>());
+        }
+
+        return completed;
+    }
+
+    // Record one finished frame. Called from concurrent writer threads;
+    // flushed per frame so the manifest survives a crash.
+    void record(motioncam::Timestamp timestamp, const std::string& outputPath) {
+        if(!mFile)
+            return;
+
+        const nlohmann::json entry{
+            { "timestamp", timestamp },
+            { "path", outputPath },
+            { "bytes", outputFileSize(outputPath) },
+        };
+
+        const std::string line = entry.dump() + "\n";
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        fwrite(line.data(), 1, line.size(), mFile.get());
+        fflush(mFile.get());
+    }
+
+private:
+    std::unique_ptr<FILE, int(*)(FILE*)> mFile;
+    std::mutex mMutex;
+};
+
+// How hard the export pushes finished files to stable storage. The default
+// leaves everything to the page cache - fastest, but a power cut can leave
+// thousands of zero-length DNGs behind a long export. Syncing every file
+// individually costs 20-30% of write throughput on journaling filesystems,
+// so the middle policy amortizes the journal commits over batches of
+// frames instead.
+enum class DurabilityPolicy {
+    // Leave flushing to the page cache
+    NONE,
+    // fdatasync completed files in batches of DURABILITY_BATCH frames
+    BATCHED,
+    // One sync pass over every output when the export finishes
+    COMPLETE,
+};
+
+constexpr size_t DURABILITY_BATCH = 32;
+
+// Applies the durability policy: writer threads report each finished file
+// and complete() flushes whatever is still pending, then fsyncs the output
+// directory itself so the new directory entries - not just their data -
+// survive power loss.
+class DurabilitySync {
+public:
+    explicit DurabilitySync(DurabilityPolicy policy) : mPolicy(policy) {}
+
+    // Called after a file is fully written and closed; under the batched
+    // policy every DURABILITY_BATCH-th call syncs the accumulated batch
+    void wrote(const std::string& path) {
+        if(mPolicy == DurabilityPolicy::NONE)
+            return;
+
+        std::vector<std::string> batch;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mPending.push_back(path);
+
+            if(mPolicy != DurabilityPolicy::BATCHED || mPending.size() < DURABILITY_BATCH)
+                return;
+
+            batch.swap(mPending);
+        }
+
+        // Sync outside the lock so the other writers keep finishing frames
+        for(const auto& file : batch)
+            syncFile(file);
+    }
+
+    // Flush everything still pending, then the containing directory
+    void complete(const std::string& directory) {
+        if(mPolicy == DurabilityPolicy::NONE)
+            return;
+
+        std::vector<std::string> batch;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            batch.swap(mPending);
+        }
+
+        for(const auto& file : batch)
+            syncFile(file);
+
+        syncDirectory(directory);
+    }
+
+private:
+    // Reopen and push the file's data to disk. The writer has already
+    // closed the file; fdatasync acts on the file, not on who wrote it.
+    static void syncFile(const std::string& path) {
+#if defined(_WIN32)
+        const int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+
+        if(fd < 0 || _commit(fd) != 0) {
+            if(fd >= 0)
+                _close(fd);
+
+            throw std::runtime_error("Failed to sync " + path);
+        }
+
+        _close(fd);
+#else
+        const int fd = open(path.c_str(), O_RDONLY);
+
+        if(fd < 0 || fdatasync(fd) != 0) {
+            if(fd >= 0)
+                close(fd);
+
+            throw std::runtime_error("Failed to sync " + path);
+        }
+
+        close(fd);
+#endif
+    }
+
+    // Best effort; directories cannot be opened for flushing on Windows
+    static void syncDirectory(const std::string& path) {
+#if !defined(_WIN32)
+        const int fd = open(path.c_str(), O_RDONLY);
+
+        if(fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+#else
+        (void)path;
+#endif
+    }
+
+    DurabilityPolicy mPolicy;
+    std::mutex mMutex;
+    std::vector<std::string> mPending;
+};
+
+// Trailer locating a bundle's index, fixed-size so it can be read from the
+// end of the file without knowing anything else about it
+struct BundleFooter {
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+    char magic[8];
+};
+
+constexpr char BUNDLE_MAGIC[8] = { 'D', 'N', 'G', 'B', 'N', 'D', 'L', '1' };
+
+// A whole DNG sequence in one offset-indexed container file. Writing tens
+// of thousands of individual files pays a filesystem metadata transaction
+// (create + close) per frame and makes copies and deletes of the export
+// take longer than the export itself; the bundle turns the sequence into
+// large sequential appends to a single file. Layout: the frames' DNG
+// bytes back to back, then a JSON index of {name, offset, bytes} entries,
+// then a fixed footer locating the index - so the contents can be listed
+// and extracted without scanning. append() is safe to call from several
+// writer threads; frames land in completion order and keep their names
+// through the index.
+class DngBundleWriter {
+public:
+    explicit DngBundleWriter(const std::string& path)
+        : mPath(path),
+          mFile(fopen(path.c_str(), "wb"), fclose)
+    {
+        if(!mFile)
+            throw std::runtime_error("Failed to create " + path);
+    }
+
+    // Append one serialized DNG. Concurrent writers serialize on the lock
+    // for the duration of a copy into the page cache, not a disk round
+    // trip, so the lock is not the bottleneck even at frame rate.
+    void append(const std::string& name, const uint8_t* data, const size_t len) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if(fwrite(data, 1, len, mFile.get()) != len)
+            throw std::runtime_error("Failed to write " + mPath);
+
+        mIndex.push_back({ { "name", name }, { "offset", mOffset }, { "bytes", len } });
+        mOffset += len;
+    }
+
+    // Write the index and footer and close the file
+    void close() {
+        if(!mFile)
+            return;
+
+        const std::string index = nlohmann::json(mIndex).dump();
+
+        BundleFooter footer{};
+        footer.indexOffset = mOffset;
+        footer.indexBytes = index.size();
+        std::memcpy(footer.magic, BUNDLE_MAGIC, sizeof(footer.magic));
+
+        if(fwrite(index.data(), 1, index.size(), mFile.get()) != index.size()
+            || fwrite(&footer, sizeof(footer), 1, mFile.get()) != 1)
+            throw std::runtime_error("Failed to write " + mPath);
+
+        mFile.reset();
+    }
+
+    const std::string& path() const {
+        return mPath;
+    }
+
+private:
+    std::string mPath;
+    std::unique_ptr<FILE, int(*)(FILE*)> mFile;
+    std::mutex mMutex;
+    std::vector<nlohmann::json> mIndex;
+    uint64_t mOffset{0};
+};
+
+// Unpack a bundle back into individual DNG files under outputDir (the
+// current directory when empty). Entries are extracted in file order, so
+// the bundle is read front to back.
+void extractBundle(const std::string& bundlePath, const std::string& outputDir) {
+    std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(bundlePath.c_str(), "rb"), fclose);
+
+    if(!file)
+        throw std::runtime_error("Failed to open " + bundlePath);
+
+    BundleFooter footer{};
+
+    if(fseek(file.get(), -static_cast<long>(sizeof(BundleFooter)), SEEK_END) != 0
+        || fread(&footer, sizeof(footer), 1, file.get()) != 1
+        || std::memcmp(footer.magic, BUNDLE_MAGIC, sizeof(footer.magic)) != 0)
+        throw std::runtime_error(bundlePath + " is not a DNG bundle");
+
+    std::string indexText(static_cast<size_t>(footer.indexBytes), '\0');
+
+    if(fseek(file.get(), static_cast<long>(footer.indexOffset), SEEK_SET) != 0
+        || fread(&indexText[0], 1, indexText.size(), file.get()) != indexText.size())
+        throw std::runtime_error("Failed to read the index of " + bundlePath);
+
+    const nlohmann::json index = nlohmann::json::parse(indexText);
+
+    const std::string prefix = outputDir.empty() ? std::string() : outputDir + "/";
+
+    std::vector<uint8_t> frame;
+
+    for(const auto& entry : index) {
+        const std::string name = entry["name"];
+
+        frame.resize(entry["bytes"].get<size_t>());
+
+        if(fseek(file.get(), static_cast<long>(entry["offset"].get<uint64_t>()), SEEK_SET) != 0
+            || fread(frame.data(), 1, frame.size(), file.get()) != frame.size())
+            throw std::runtime_error("Failed to read " + name + " from " + bundlePath);
+
+        std::unique_ptr<FILE, int(*)(FILE*)> out(fopen((prefix + name).c_str(), "wb"), fclose);
+
+        if(!out || fwrite(frame.data(), 1, frame.size(), out.get()) != frame.size())
+            throw std::runtime_error("Failed to write " + prefix + name);
+    }
+
+    std::cout << "Extracted " << index.size() << " files from " << bundlePath << std::endl;
+}
+
+// One frame in flight through the export pipeline. Jobs are recycled so the
+// pixel buffers are allocated once, not per frame.
+struct ExportJob {
+    int frameIndex;
+    motioncam::Timestamp timestamp;
+    std::vector<uint16_t> data;
+    nlohmann::json metadata;
+    // Serialized DNG bytes, used by the bundle output
+    std::vector<uint8_t> dngBuffer;
+};
+
+// The decode-to-disk stage of the export: a pool of DNG writer threads fed
+// recycled jobs, so disk writes overlap the decode of the next frame. The
+// fixed set of jobs bounds the pipeline by frame count and a byte budget
+// bounds it by memory: when the target disk stalls, submit() blocks at the
+// budget and the export degrades to disk speed instead of accumulating
+// decoded frames. MOTIONCAM_EXPORT_BUDGET_MB overrides the default budget;
+// a single frame is always admitted so oversized frames cannot stall
+// forever.
+//
+// Jobs come back from the writers over a lock-free MPSC ring - any writer
+// can finish a frame at any moment, and returning its job costs a couple
+// of atomic operations instead of taking the lock that the decode thread
+// would contend for at frame rate.
+//
+// The writes run on the process-wide shared pool at EXPORT priority,
+// tracked through a TaskGroup, so several pipelines - one per container
+// in a batch export - share the cores instead of each spawning a pool
+// that oversubscribes the machine. namePrefix distinguishes the output
+// files of concurrent clips.
+class DngExportPipeline {
+public:
+    explicit DngExportPipeline(const motioncam::ContainerMetadata& containerMetadata, std::string namePrefix = std::string(), ExportManifest* manifest = nullptr, DurabilitySync* durability = nullptr, DngBundleWriter* bundle = nullptr)
+        : mPool(motioncam::ThreadPool::shared()),
+          mDngWriter(containerMetadata),
+          mNamePrefix(std::move(namePrefix)),
+          mManifest(manifest),
+          mDurability(durability),
+          mBundle(bundle),
+          mFreeJobs(2*std::max<size_t>(1, mPool.numThreads()))
+    {
+        if(const char* budgetMb = std::getenv("MOTIONCAM_EXPORT_BUDGET_MB"))
+            mWriteBudget = static_cast<size_t>(std::max(1, std::atoi(budgetMb))) * 1024 * 1024;
+
+        for(size_t i = 0; i < 2*std::max<size_t>(1, mPool.numThreads()); i++)
+            mFreeJobs.tryPush(std::make_unique<ExportJob>());
+    }
+
+    // Take a recycled job, waiting until a writer hands one back. Returns
+    // null when a writer has failed; finish() rethrows the failure.
+    std::unique_ptr<ExportJob> acquire() {
+        std::unique_ptr<ExportJob> job;
+        motioncam::ringbuffer::Backoff backoff;
+
+        while(!mFreeJobs.tryPop(job)) {
+            if(mFailed.load(std::memory_order_acquire))
+                return nullptr;
+
+            backoff.wait();
+        }
+
+        return job;
+    }
+
+    // Hand a decoded frame to the writers, throttling against the byte
+    // budget first
+    void submit(std::unique_ptr<ExportJob> job) {
+        const size_t jobBytes = job->data.size() * sizeof(uint16_t);
+
+        motioncam::ringbuffer::Backoff backoff;
+
+        for(;;) {
+            if(mFailed.load(std::memory_order_acquire))
+                return;
+
+            // Only this thread admits work, so check-then-add cannot race
+            // another admission; the writers only subtract
+            const size_t inFlight = mInFlightBytes.load(std::memory_order_relaxed);
+
+            if(inFlight == 0 || inFlight + jobBytes <= mWriteBudget) {
+                mInFlightBytes.fetch_add(jobBytes, std::memory_order_relaxed);
+                break;
+            }
+
+            backoff.wait();
+        }
+
+        auto* rawJob = job.release();
+
+        mGroup.run(mPool, motioncam::Priority::EXPORT, [this, rawJob] {
+            std::unique_ptr<ExportJob> job(rawJob);
+            char name[32];
+
+            std::snprintf(name, sizeof(name), "frame_%06d.dng", job->frameIndex);
+
+            try {
+                if(mBundle) {
+                    // Bundle mode: serialize in memory and append; the
+                    // bundle's own close/sync covers durability
+                    mDngWriter.render(job->dngBuffer, job->data, job->metadata);
+
+                    mBundle->append(name, job->dngBuffer.data(), job->dngBuffer.size());
+                }
+                else {
+                    mDngWriter.write(mNamePrefix + name, job->data, job->metadata);
+
+                    if(mDurability)
+                        mDurability->wrote(mNamePrefix + name);
+
+                    if(mManifest)
+                        mManifest->record(job->timestamp, mNamePrefix + name);
+                }
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(mErrorMutex);
+
+                if(!mError) {
+                    mError = std::current_exception();
+                    mFailed.store(true, std::memory_order_release);
+                }
+            }
+
+            // Recycle the buffers and release the job's budget share. The
+            // ring holds every job ever created, so the push cannot fail
+            mInFlightBytes.fetch_sub(job->data.size() * sizeof(uint16_t), std::memory_order_relaxed);
+            mFreeJobs.tryPush(std::move(job));
+        });
+    }
+
+    // Wait for every submitted frame to reach disk
+    void finish() {
+        mGroup.wait();
+
+        if(mError)
+            std::rethrow_exception(mError);
+    }
+
+private:
+    motioncam::ThreadPool& mPool;
+    motioncam::TaskGroup mGroup;
+    DngSequenceWriter mDngWriter;
+    std::string mNamePrefix;
+    ExportManifest* mManifest;
+    DurabilitySync* mDurability;
+    DngBundleWriter* mBundle;
+
+    motioncam::MpscRingBuffer<std::unique_ptr<ExportJob>> mFreeJobs;
+    std::mutex mErrorMutex;
+    std::exception_ptr mError;
+    std::atomic<bool> mFailed{false};
+
+    // Pixel bytes handed to the writers and not yet on disk
+    size_t mWriteBudget{512u * 1024 * 1024};
+    std::atomic<size_t> mInFlightBytes{0};
+};
+
+// Decode frames on the calling thread and hand each one to the writer
+// pipeline
+void exportFrames(
+    motioncam::Decoder& decoder,
+    const std::vector<motioncam::Timestamp>& frames,
+    const int endFrame,
+    const motioncam::ContainerMetadata& containerMetadata,
+    const std::string& namePrefix = std::string(),
+    ExportManifest* manifest = nullptr,
+    const std::unordered_set<motioncam::Timestamp>* completed = nullptr,
+    DurabilitySync* durability = nullptr,
+    DngBundleWriter* bundle = nullptr)
+{
+    DngExportPipeline pipeline(containerMetadata, namePrefix, manifest, durability, bundle);
+
+    // Export decodes fill spare capacity and yield to interactive frames
+    decoder.setDecodeQoS(motioncam::raw::DecodeQoS::BACKGROUND);
+
+    for(int i = 0; i < endFrame; i++) {
+        // Frames a previous run already finished keep their index-derived
+        // names, so skipping them leaves the sequence intact
+        if(completed && completed->count(frames[i]))
+            continue;
+
+        auto job = pipeline.acquire();
+
+        if(!job)
+            break;
+
+        job->frameIndex = i;
+        job->timestamp = frames[i];
+
+        decoder.loadFrame(frames[i], job->data, job->metadata);
+
+        pipeline.submit(std::move(job));
+    }
+
+    pipeline.finish();
+}
+
+// Export the audio track and every frame with a single front-to-back pass
+// over the container: the decoder hands frames to the DNG pipeline and
+// audio chunks to a streaming WAV writer in file order, one sequential
+// read instead of a seeky audio walk followed by a separate frame pass.
+void exportSequential(
+    motioncam::Decoder& decoder,
+    const motioncam::ContainerMetadata& containerMetadata,
+    const std::string& namePrefix = std::string(),
+    ExportManifest* manifest = nullptr,
+    DurabilitySync* durability = nullptr,
+    DngBundleWriter* bundle = nullptr)
+{
+    StreamingWavWriter wav(namePrefix + "audio.wav", decoder.audioSampleRateHz(), decoder.numAudioChannels());
+    DngExportPipeline pipeline(containerMetadata, namePrefix, manifest, durability, bundle);
+
+    decoder.setDecodeQoS(motioncam::raw::DecodeQoS::BACKGROUND);
+
+    int frameIndex = 0;
+
+    decoder.visitSequential(
+        [&](motioncam::Timestamp timestamp, std::vector<uint16_t> data, nlohmann::json metadata) {
+            auto job = pipeline.acquire();
+
+            if(!job)
+                return;
+
+            job->frameIndex = frameIndex++;
+            job->timestamp = timestamp;
+            job->data = std::move(data);
+            job->metadata = std::move(metadata);
+
+            pipeline.submit(std::move(job));
+        },
+        [&](motioncam::Timestamp, const int16_t* samples, size_t numSamples) {
+            wav.writeSamples(samples, numSamples);
+        });
+
+    pipeline.finish();
+    wav.close();
+}
+
+// Frames the pipe writer gathers into one vectored write
+constexpr size_t PIPE_IOV_BATCH = 4;
+
+// Write a batch of decoded frames to stdout, each as one contiguous
+// width*height*2 chunk. Returns false when the downstream consumer has
+// closed the pipe, which ends the export without an error - an encoder
+// that has read enough is a normal way for a proxy pipeline to finish.
+bool writeFramesRaw16(std::vector<motioncam::FrameHandle>& batch) {
+#if !defined(_WIN32)
+    // One writev per batch: the frames leave the pooled buffers in a
+    // single syscall instead of one write per frame
+    std::vector<iovec> iov(batch.size());
+    size_t remaining = 0;
+
+    for(size_t i = 0; i < batch.size(); i++) {
+        iov[i].iov_base = batch[i].data();
+        iov[i].iov_len = batch[i].size() * sizeof(uint16_t);
+
+        remaining += iov[i].iov_len;
+    }
+
+    size_t first = 0;
+
+    while(remaining > 0) {
+        const ssize_t written = writev(STDOUT_FILENO, iov.data() + first, static_cast<int>(iov.size() - first));
+
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+
+            if(errno == EPIPE)
+                return false;
+
+            throw motioncam::IOException("Failed to write to stdout");
+        }
+
+        remaining -= static_cast<size_t>(written);
+
+        // Advance past fully written buffers, then trim a partial one
+        size_t advanced = static_cast<size_t>(written);
+
+        while(advanced >= iov[first].iov_len && remaining > 0) {
+            advanced -= iov[first].iov_len;
+            first++;
+        }
+
+        if(remaining > 0 && advanced > 0) {
+            iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + advanced;
+            iov[first].iov_len -= advanced;
+        }
+    }
+#else
+    for(auto& frame : batch) {
+        if(fwrite(frame.data(), sizeof(uint16_t), frame.size(), stdout) != frame.size())
+            return false;
+    }
+#endif
+
+    return true;
+}
+
+// Stream decoded frames to stdout as raw little-endian 16-bit pixels, one
+// contiguous width*height*2 chunk per frame in container order, so
+// `example clip.mcraw --pipe raw16 | ffmpeg ...` runs a proxy encode
+// without touching the filesystem. Decode and write overlap: the main
+// thread decodes into pooled buffers while a writer thread drains them
+// through vectored writes, and the ring bounds the frames in flight.
+void pipeRaw16(
+    motioncam::Decoder& decoder,
+    const std::vector<motioncam::Timestamp>& frames,
+    const int endFrame)
+{
+#if !defined(_WIN32)
+    // A consumer that exits early must end the export, not kill the process
+    signal(SIGPIPE, SIG_IGN);
+#else
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    motioncam::FrameBufferPool pool;
+    motioncam::SpscRingBuffer<motioncam::FrameHandle> ring(2 * PIPE_IOV_BATCH);
+
+    std::atomic<bool> done{false};
+    std::atomic<bool> stop{false};
+    std::exception_ptr error;
+
+    std::thread writer([&] {
+        try {
+            std::vector<motioncam::FrameHandle> batch;
+            motioncam::ringbuffer::Backoff backoff;
+
+            for(;;) {
+                motioncam::FrameHandle frame;
+
+                if(!ring.tryPop(frame)) {
+                    if(done.load(std::memory_order_acquire) && ring.empty())
+                        break;
+
+                    backoff.wait();
+                    continue;
+                }
+
+                backoff.reset();
+                batch.clear();
+                batch.push_back(std::move(frame));
+
+                // Gather whatever else is already decoded, up to the
+                // batch size, into the same writev
+                while(batch.size() < PIPE_IOV_BATCH && ring.tryPop(frame))
+                    batch.push_back(std::move(frame));
+
+                if(!writeFramesRaw16(batch))
+                    break;
+            }
+        }
+        catch(...) {
+            error = std::current_exception();
+        }
+
+        // Covers both the error and the closed-pipe path; the producer
+        // stops decoding and any queued frames drop back to the pool
+        stop.store(true, std::memory_order_release);
+    });
+
+    motioncam::ringbuffer::Backoff backoff;
+    nlohmann::json metadata;
+
+    for(int i = 0; i < endFrame && !stop.load(std::memory_order_acquire); i++) {
+        auto frame = decoder.loadFrame(frames[i], pool, metadata);
+
+        while(!ring.tryPush(std::move(frame))) {
+            if(stop.load(std::memory_order_acquire))
+                break;
+
+            backoff.wait();
+        }
+
+        backoff.reset();
+    }
+
+    done.store(true, std::memory_order_release);
+    writer.join();
+
+    if(error)
+        std::rethrow_exception(error);
+}
+
+// Stem of an input path used to prefix its output files, so concurrent
+// clips in a batch never write over each other: "shots/clip_01.mcraw"
+// becomes "clip_01_"
+std::string outputPrefix(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    const size_t dot = name.find_last_of('.');
+
+    if(dot != std::string::npos && dot > 0)
+        name.resize(dot);
+
+    return name + "_";
+}
+
+// Directory the outputs under namePrefix land in, for the directory fsync
+std::string outputDirectory(const std::string& namePrefix) {
+    const size_t slash = namePrefix.find_last_of("/\\");
+
+    return slash == std::string::npos ? std::string(".") : namePrefix.substr(0, slash + 1);
+}
+
+// Export one container - audio plus up to endFrame frames as DNGs named
+// under namePrefix - and return the number of frames exported. With resume,
+// frames a previous run completed (per the manifest, verified by output
+// size) are skipped instead of re-decoded.
+size_t exportFile(const std::string& path, int endFrame, const std::string& namePrefix, bool resume = false,
+    DurabilityPolicy durability = DurabilityPolicy::NONE, bool bundle = false) {
+    motioncam::Decoder d(path);
+
+    auto frames = d.getFrames();
+    const auto& containerMetadata = d.getTypedContainerMetadata();
+
+    if(endFrame < 0)
+        endFrame = static_cast<int>(frames.size());
+
+    endFrame = std::min(static_cast<int>(frames.size()), std::max(0, endFrame));
+
+    const std::string manifestPath = namePrefix + "export.manifest";
+
+    std::unordered_set<motioncam::Timestamp> completed;
+
+    // The manifest's per-file size verification has nothing to check
+    // against inside a bundle, so bundled exports run without one
+    std::unique_ptr<ExportManifest> manifest;
+    std::unique_ptr<DngBundleWriter> bundleWriter;
+
+    if(bundle) {
+        bundleWriter = std::make_unique<DngBundleWriter>(namePrefix + "frames.dngbundle");
+    }
+    else {
+        if(resume)
+            completed = ExportManifest::loadCompleted(manifestPath);
+
+        manifest = std::make_unique<ExportManifest>(manifestPath, resume);
+    }
+
+    DurabilitySync sync(durability);
+
+    if(endFrame == static_cast<int>(frames.size()) && completed.empty()) {
+        // Full export: audio and video in one sequential pass over the
+        // container
+        exportSequential(d, containerMetadata, namePrefix, manifest.get(), &sync, bundleWriter.get());
+    }
+    else {
+        // Partial or resumed export: write the audio first (cheap relative
+        // to the frames, so a resume just redoes it), then only the frames
+        // still missing
+        std::vector<motioncam::AudioChunk> audioChunks;
+
+        d.loadAudio(audioChunks);
+
+        writeAudio(namePrefix + "audio.wav", d.audioSampleRateHz(), d.numAudioChannels(), audioChunks);
+
+        exportFrames(d, frames, endFrame, containerMetadata, namePrefix, manifest.get(), completed.empty() ? nullptr : &completed, &sync, bundleWriter.get());
+    }
+
+    if(bundleWriter) {
+        // Seal the bundle before the sync pass so the index and footer are
+        // part of what reaches stable storage
+        bundleWriter->close();
+        sync.wrote(bundleWriter->path());
+    }
+
+    // Audio and the manifest ride along in the final sync pass
+    sync.wrote(namePrefix + "audio.wav");
+
+    if(manifest)
+        sync.wrote(manifestPath);
+
+    sync.complete(outputDirectory(namePrefix));
+
+    return static_cast<size_t>(endFrame);
+}
+
+// Export several containers concurrently. Each worker exports whole files
+// while all of their DNG writes share the process-wide pool, so small
+// clips - where open, audio and the serial decode phases dominate -
+// overlap instead of leaving cores idle between files. Returns the number
+// of files that failed.
+int exportBatch(const std::vector<std::string>& inputs, const int endFrame, const bool resume,
+    const DurabilityPolicy durability, const bool bundle) {
+    struct FileResult {
+        size_t frames{0};
+        double seconds{0};
+        std::string error;
+    };
+
+    std::vector<FileResult> results(inputs.size());
+    std::atomic<size_t> nextFile{0};
+    std::mutex logMutex;
+
+    // File-level concurrency; the shared pool handles the per-frame work
+    const size_t concurrent = std::min(inputs.size(),
+        std::max<size_t>(2, std::thread::hardware_concurrency() / 2));
+
+    const auto batchStart = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+
+    for(size_t w = 0; w < concurrent; w++) {
+        workers.emplace_back([&] {
+            for(;;) {
+                const size_t i = nextFile.fetch_add(1);
+
+                if(i >= inputs.size())
+                    break;
+
+                const auto start = std::chrono::steady_clock::now();
+
+                try {
+                    results[i].frames = exportFile(inputs[i], endFrame, outputPrefix(inputs[i]), resume, durability, bundle);
+                }
+                catch(const std::exception& e) {
+                    results[i].error = e.what();
+                }
+
+                results[i].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                std::lock_guard<std::mutex> lock(logMutex);
+
+                if(results[i].error.empty()) {
+                    std::cout << "[" << (i + 1) << "/" << inputs.size() << "] " << inputs[i]
+                              << ": " << results[i].frames << " frames in " << results[i].seconds << "s" << std::endl;
+                }
+                else {
+                    std::cout << "[" << (i + 1) << "/" << inputs.size() << "] " << inputs[i]
+                              << ": FAILED: " << results[i].error << std::endl;
+                }
+            }
+        });
+    }
+
+    for(auto& worker : workers)
+        worker.join();
+
+    const double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+
+    size_t totalFrames = 0;
+    int failures = 0;
+
+    for(const auto& result : results) {
+        totalFrames += result.frames;
+
+        if(!result.error.empty())
+            failures++;
+    }
+
+    std::cout << inputs.size() - failures << "/" << inputs.size() << " files, "
+              << totalFrames << " frames in " << wallSeconds << "s ("
+              << (wallSeconds > 0 ? totalFrames / wallSeconds : 0) << " frames/s)" << std::endl;
+
+    return failures;
+}
+
 int main(int argc, const char * argv[]) {
-    if(argc < 2) {
-        std::cout << "Usage: decoder <input file> [-n number of frames to export]" << std::endl;
+    std::vector<std::string> inputs;
+    int endFrame = -1;
+    bool pipeMode = false;
+    bool resume = false;
+    bool bundleMode = false;
+    bool unbundleMode = false;
+    DurabilityPolicy durability = DurabilityPolicy::NONE;
+
+    for(int i = 1; i < argc; i++) {
+        const std::string arg(argv[i]);
+
+        if(arg == "-n" && i + 1 < argc) {
+            endFrame = std::stoi(argv[++i]);
+        }
+        else if(arg == "--resume") {
+            resume = true;
+        }
+        else if(arg == "--bundle") {
+            bundleMode = true;
+        }
+        else if(arg == "--unbundle") {
+            unbundleMode = true;
+        }
+        else if(arg == "--durability" && i + 1 < argc) {
+            const std::string policy(argv[++i]);
+
+            if(policy == "none")
+                durability = DurabilityPolicy::NONE;
+            else if(policy == "batched")
+                durability = DurabilityPolicy::BATCHED;
+            else if(policy == "complete")
+                durability = DurabilityPolicy::COMPLETE;
+            else {
+                std::cerr << "Unknown durability policy: " << policy << std::endl;
+                return -1;
+            }
+        }
+        else if(arg == "--pipe") {
+            // The format argument is optional; raw16 is the only format
+            if(i + 1 < argc && argv[i + 1][0] != '-') {
+                if(std::string(argv[++i]) != "raw16") {
+                    std::cerr << "Unknown pipe format: " << argv[i] << std::endl;
+                    return -1;
+                }
+            }
+
+            pipeMode = true;
+        }
+        else {
+#if !defined(_WIN32)
+            // Expand patterns a shell did not (quoted, or from scripts)
+            if(arg.find_first_of("*?[") != std::string::npos) {
+                glob_t matches{};
+
+                if(glob(arg.c_str(), 0, nullptr, &matches) == 0) {
+                    for(size_t m = 0; m < matches.gl_pathc; m++)
+                        inputs.push_back(matches.gl_pathv[m]);
+                }
+
+                globfree(&matches);
+                continue;
+            }
+#endif
+            inputs.push_back(arg);
+        }
+    }
+
+    if(inputs.empty()) {
+        std::cout << "Usage: decoder <input files...> [-n number of frames to export] [--resume] [--durability none|batched|complete] [--bundle] [--pipe raw16]" << std::endl;
+        std::cout << "       decoder --unbundle <bundle file>" << std::endl;
         return -1;
     }
-    
-    std::string inputPath(argv[1]);
-    int endFrame = -1;
-    
-    if(argc > 3) {
-        if(std::string(argv[2]) == "-n")
-            endFrame = std::stoi(argv[3]);
+
+    if(pipeMode && inputs.size() > 1) {
+        std::cerr << "--pipe takes a single input file" << std::endl;
+        return -1;
     }
 
+    if(bundleMode && resume) {
+        // Completed frames inside a bundle cannot be verified the way the
+        // manifest verifies individual files
+        std::cerr << "--resume is not supported with --bundle" << std::endl;
+        return -1;
+    }
+
+    if(unbundleMode) {
+        if(inputs.size() != 1) {
+            std::cerr << "--unbundle takes a single bundle file" << std::endl;
+            return -1;
+        }
+
+        try {
+            extractBundle(inputs[0], std::string());
+        }
+        catch(const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    // In pipe mode stdout carries pixel data; diagnostics go to stderr
+    std::ostream& info = pipeMode ? std::cerr : std::cout;
+
     try {
-        motioncam::Decoder d(inputPath);
-        
+        if(inputs.size() > 1)
+            return exportBatch(inputs, endFrame, resume, durability, bundleMode) == 0 ? 0 : -1;
+
+        motioncam::Decoder d(inputs[0]);
+
         auto frames = d.getFrames();
-        auto containerMetadata = d.getContainerMetadata();
-        char path[32];
 
-        std::cout << "Found " << frames.size() << " frames" << std::endl;
-        
+        info << "Found " << frames.size() << " frames" << std::endl;
+
         if(endFrame < 0)
             endFrame = static_cast<int>(frames.size());
-        
-        //
-        // Write audio
-        //
-        
-        std::vector<motioncam::AudioChunk> audioChunks;
-        
-        d.loadAudio(audioChunks);
-        
-        writeAudio("audio.wav", d.audioSampleRateHz(), d.numAudioChannels(), audioChunks);
-        
-        //
-        // Write video
-        //
-        
-        std::vector<uint16_t> data;
-        nlohmann::json metadata;
-        
+
         endFrame = std::min(static_cast<int>(frames.size()), std::max(0, endFrame));
-        
-        for(int i = 0; i < endFrame; i++) {
-            d.loadFrame(frames[i], data, metadata);
-                        
-            std::snprintf(path, sizeof(path), "frame_%06d.dng", i);
-            
-            std::cout << "Writing " << path << std::endl;
-            
-            writeDng(std::string(path), data, metadata, containerMetadata);
+
+        info << "Exporting " << endFrame << " frames" << std::endl;
+
+        if(pipeMode) {
+            pipeRaw16(d, frames, endFrame);
+        }
+        else {
+            exportFile(inputs[0], endFrame, std::string(), resume, durability, bundleMode);
         }
     }
     catch(motioncam::MotionCamException& e) {
         std::cerr << "Error: " << e.what( )<< std::endl;
         return -1;
     }
-    
+
     return 0;
 }
@@ -0,0 +1,39 @@
+#include <motioncam/AllocStats.hpp>
+
+namespace motioncam {
+    namespace allocstats {
+        std::atomic<bool> gCounting{false};
+
+        namespace {
+            thread_local uint64_t tNumAllocations = 0;
+            thread_local uint64_t tBytesAllocated = 0;
+        }
+
+        void Enable() {
+            gCounting.store(true, std::memory_order_relaxed);
+        }
+
+        void Disable() {
+            gCounting.store(false, std::memory_order_relaxed);
+        }
+
+        void Record(size_t bytes) {
+            if(!gCounting.load(std::memory_order_relaxed))
+                return;
+
+            tNumAllocations++;
+            tBytesAllocated += bytes;
+        }
+
+        Snapshot Current() {
+            return Snapshot { tNumAllocations, tBytesAllocated };
+        }
+
+        Snapshot Since(const Snapshot& start) {
+            return Snapshot {
+                tNumAllocations - start.numAllocations,
+                tBytesAllocated - start.bytesAllocated
+            };
+        }
+    }
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/Allocator.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+#if defined(__linux__)
+    #include <sys/mman.h>
+#elif defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#endif
+
+namespace motioncam {
+
+    namespace {
+        constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        std::atomic<AllocationPolicy> sPolicy{AllocationPolicy::DEFAULT};
+
+        // Page-backed allocations and their mapped lengths, so freeAligned()
+        // unmaps them correctly even after the policy has changed
+        std::mutex sMappedMutex;
+        std::unordered_map<void*, size_t> sMapped;
+
+        void* allocateHugePages(size_t bytes) {
+            const size_t len = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+#if defined(__linux__)
+            void* ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if(ptr == MAP_FAILED) {
+                // No pre-reserved huge pages; take normal pages and ask the
+                // kernel to promote them to transparent huge pages
+                ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+                if(ptr == MAP_FAILED)
+                    return nullptr;
+
+#if defined(MADV_HUGEPAGE)
+                madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+            }
+#elif defined(_WIN32)
+            void* ptr = nullptr;
+
+            if(GetLargePageMinimum() > 0)
+                ptr = VirtualAlloc(nullptr, len, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+            if(!ptr)
+                return nullptr;
+#else
+            return nullptr;
+#endif
+
+            std::unique_lock<std::mutex> lock(sMappedMutex);
+            sMapped.emplace(ptr, len);
+
+            return ptr;
+        }
+
+        bool freeHugePages(void* ptr) {
+            size_t len;
+
+            {
+                std::unique_lock<std::mutex> lock(sMappedMutex);
+
+                auto it = sMapped.find(ptr);
+
+                if(it == sMapped.end())
+                    return false;
+
+                len = it->second;
+                sMapped.erase(it);
+            }
+
+#if defined(__linux__)
+            munmap(ptr, len);
+#elif defined(_WIN32)
+            (void) len;
+            VirtualFree(ptr, 0, MEM_RELEASE);
+#endif
+
+            return true;
+        }
+    }
+
+    void setAllocationPolicy(AllocationPolicy policy) {
+        sPolicy.store(policy, std::memory_order_relaxed);
+    }
+
+    AllocationPolicy allocationPolicy() {
+        return sPolicy.load(std::memory_order_relaxed);
+    }
+
+    void* allocateAligned(size_t bytes) {
+        if(allocationPolicy() == AllocationPolicy::HUGE_PAGES && bytes >= HUGE_PAGE_SIZE) {
+            // Page mappings are at least page aligned, well beyond
+            // ALLOCATION_ALIGNMENT
+            void* ptr = allocateHugePages(bytes);
+
+            if(ptr)
+                return ptr;
+        }
+
+        return ::operator new(bytes, std::align_val_t(ALLOCATION_ALIGNMENT));
+    }
+
+    void freeAligned(void* ptr) {
+        if(!ptr)
+            return;
+
+        if(freeHugePages(ptr))
+            return;
+
+        ::operator delete(ptr, std::align_val_t(ALLOCATION_ALIGNMENT));
+    }
+} // namespace motioncam
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/Archive.hpp>
+#include <motioncam/Decoder.hpp>
+
+#if defined(MOTIONCAM_WITH_ZSTD)
+    #include <zstd.h>
+#endif
+
+#include <cstring>
+
+namespace motioncam {
+    namespace archive {
+        namespace {
+            // The built-in codec is an LZ4-style token stream: each sequence
+            // is a token byte (high nibble literal count, low nibble match
+            // length minus MIN_MATCH, 15 extends with 255-run bytes), the
+            // literals, then a 16-bit little-endian backwards offset. The
+            // final sequence carries literals only. Nothing clever - the
+            // point is a restore path that is a straight byte copy loop and
+            // zero build dependencies; zstd is the better ratio when linked.
+            constexpr size_t MIN_MATCH = 4;
+            constexpr size_t MAX_OFFSET = 65535;
+            constexpr int HASH_BITS = 14;
+
+            uint32_t hash4(const uint8_t* p) {
+                uint32_t v;
+                std::memcpy(&v, p, sizeof(v));
+
+                return (v * 2654435761u) >> (32 - HASH_BITS);
+            }
+
+            void putLength(std::vector<uint8_t>& out, size_t length) {
+                while(length >= 255) {
+                    out.push_back(255);
+                    length -= 255;
+                }
+
+                out.push_back(static_cast<uint8_t>(length));
+            }
+
+            void compressLz(const uint8_t* data, const size_t size, std::vector<uint8_t>& out) {
+                // Positions of previously seen 4-byte sequences
+                std::vector<int64_t> table(size_t{1} << HASH_BITS, -1);
+
+                size_t pos = 0;
+                size_t literalStart = 0;
+
+                const auto emit = [&](const size_t literalEnd, const size_t matchLength, const size_t offset) {
+                    const size_t literals = literalEnd - literalStart;
+
+                    const uint8_t literalNibble = literals >= 15 ? 15 : static_cast<uint8_t>(literals);
+                    const uint8_t matchNibble = matchLength == 0 ? 0
+                        : (matchLength - MIN_MATCH >= 15 ? 15 : static_cast<uint8_t>(matchLength - MIN_MATCH));
+
+                    out.push_back(static_cast<uint8_t>((literalNibble << 4) | matchNibble));
+
+                    if(literalNibble == 15)
+                        putLength(out, literals - 15);
+
+                    out.insert(out.end(), data + literalStart, data + literalEnd);
+
+                    if(matchLength == 0)
+                        return;
+
+                    out.push_back(static_cast<uint8_t>(offset & 0xFF));
+                    out.push_back(static_cast<uint8_t>(offset >> 8));
+
+                    if(matchNibble == 15)
+                        putLength(out, matchLength - MIN_MATCH - 15);
+                };
+
+                while(pos + MIN_MATCH <= size) {
+                    const uint32_t h = hash4(data + pos);
+                    const int64_t candidate = table[h];
+
+                    table[h] = static_cast<int64_t>(pos);
+
+                    if(candidate < 0 || pos - static_cast<size_t>(candidate) > MAX_OFFSET
+                        || std::memcmp(data + candidate, data + pos, MIN_MATCH) != 0)
+                    {
+                        pos++;
+                        continue;
+                    }
+
+                    size_t matchLength = MIN_MATCH;
+
+                    while(pos + matchLength < size
+                        && data[candidate + matchLength] == data[pos + matchLength])
+                    {
+                        matchLength++;
+                    }
+
+                    emit(pos, matchLength, pos - static_cast<size_t>(candidate));
+
+                    pos += matchLength;
+                    literalStart = pos;
+                }
+
+                // Trailing literals
+                emit(size, 0, 0);
+            }
+
+            void decompressLz(const uint8_t* data, const size_t size, uint8_t* out, const size_t outSize) {
+                size_t pos = 0;
+                size_t written = 0;
+
+                const auto getLength = [&](size_t length) {
+                    if(length < 15)
+                        return length;
+
+                    uint8_t run;
+
+                    do {
+                        if(pos >= size)
+                            throw IOException("Corrupt archived payload");
+
+                        run = data[pos++];
+                        length += run;
+                    } while(run == 255);
+
+                    return length;
+                };
+
+                while(pos < size) {
+                    const uint8_t token = data[pos++];
+
+                    const size_t literals = getLength(token >> 4);
+
+                    if(pos + literals > size || written + literals > outSize)
+                        throw IOException("Corrupt archived payload");
+
+                    std::memcpy(out + written, data + pos, literals);
+
+                    pos += literals;
+                    written += literals;
+
+                    // The final sequence stops after its literals
+                    if(pos == size)
+                        break;
+
+                    if(pos + 2 > size)
+                        throw IOException("Corrupt archived payload");
+
+                    const size_t offset = data[pos] | (static_cast<size_t>(data[pos + 1]) << 8);
+                    pos += 2;
+
+                    const size_t matchLength = getLength(token & 0xF) + MIN_MATCH;
+
+                    if(offset == 0 || offset > written || written + matchLength > outSize)
+                        throw IOException("Corrupt archived payload");
+
+                    // Byte-by-byte on purpose: overlapping matches replicate
+                    const uint8_t* src = out + written - offset;
+
+                    for(size_t i = 0; i < matchLength; i++)
+                        out[written + i] = src[i];
+
+                    written += matchLength;
+                }
+
+                if(written != outSize)
+                    throw IOException("Corrupt archived payload");
+            }
+        }
+
+        bool Available(const Codec codec) {
+            if(codec == Codec::LZ)
+                return true;
+
+#if defined(MOTIONCAM_WITH_ZSTD)
+            if(codec == Codec::ZSTD)
+                return true;
+#endif
+
+            return false;
+        }
+
+        void Compress(const Codec codec, const uint8_t* data, const size_t size, std::vector<uint8_t>& output) {
+            if(!Available(codec))
+                throw IOException("Archive codec not available in this build");
+
+            output.clear();
+            output.reserve(sizeof(PayloadHeader) + size / 2);
+            output.resize(sizeof(PayloadHeader));
+
+            PayloadHeader header{};
+            header.magicNumber = PAYLOAD_MAGIC_NUMBER;
+            header.codec = static_cast<uint32_t>(codec);
+            header.uncompressedSize = static_cast<uint32_t>(size);
+
+            std::memcpy(output.data(), &header, sizeof(PayloadHeader));
+
+#if defined(MOTIONCAM_WITH_ZSTD)
+            if(codec == Codec::ZSTD) {
+                const size_t bound = ZSTD_compressBound(size);
+
+                output.resize(sizeof(PayloadHeader) + bound);
+
+                // Cold storage trades compression time for ratio once;
+                // restore speed is unaffected by the level
+                const size_t written = ZSTD_compress(output.data() + sizeof(PayloadHeader), bound, data, size, 19);
+
+                if(ZSTD_isError(written))
+                    throw IOException("Failed to compress payload");
+
+                output.resize(sizeof(PayloadHeader) + written);
+                return;
+            }
+#endif
+
+            compressLz(data, size, output);
+        }
+
+        void Decompress(const uint8_t* data, const size_t size, std::vector<uint8_t>& output) {
+            PayloadHeader header{};
+
+            if(size < sizeof(PayloadHeader))
+                throw IOException("Corrupt archived payload");
+
+            std::memcpy(&header, data, sizeof(PayloadHeader));
+
+            if(header.magicNumber != PAYLOAD_MAGIC_NUMBER)
+                throw IOException("Corrupt archived payload");
+
+            const uint8_t* stream = data + sizeof(PayloadHeader);
+            const size_t streamSize = size - sizeof(PayloadHeader);
+
+            output.resize(header.uncompressedSize);
+
+            switch(static_cast<Codec>(header.codec)) {
+                case Codec::LZ:
+                    decompressLz(stream, streamSize, output.data(), output.size());
+                    return;
+
+                case Codec::ZSTD: {
+#if defined(MOTIONCAM_WITH_ZSTD)
+                    const size_t written = ZSTD_decompress(output.data(), output.size(), stream, streamSize);
+
+                    if(ZSTD_isError(written) || written != output.size())
+                        throw IOException("Corrupt archived payload");
+
+                    return;
+#else
+                    throw IOException("Payload needs a zstd-enabled build to restore");
+#endif
+                }
+
+                default:
+                    throw IOException("Unknown archive codec");
+            }
+        }
+    }
+}
@@ -0,0 +1,180 @@
+#include <motioncam/AudioResampler.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include <simde/x86/sse2.h>
+
+namespace motioncam {
+
+    namespace {
+        double sinc(double x) {
+            if(x == 0.0)
+                return 1.0;
+
+            const double px = M_PI * x;
+
+            return std::sin(px) / px;
+        }
+
+        // Blackman window over [-1, 1]
+        double window(double u) {
+            if(u < -1.0 || u > 1.0)
+                return 0.0;
+
+            return 0.42 + 0.5 * std::cos(M_PI * u) + 0.08 * std::cos(2.0 * M_PI * u);
+        }
+    }
+
+    void convertAudioToFloat(const int16_t* samples, size_t numSamples, float* out) {
+        const simde__m128 scale = simde_mm_set1_ps(1.0f / 32768.0f);
+
+        size_t i = 0;
+
+        for(; i + 8 <= numSamples; i += 8) {
+            const simde__m128i v =
+                simde_mm_loadu_si128(reinterpret_cast<const simde__m128i*>(samples + i));
+
+            // Sign extend by widening through the high half of each lane
+            const simde__m128i lo = simde_mm_srai_epi32(simde_mm_unpacklo_epi16(v, v), 16);
+            const simde__m128i hi = simde_mm_srai_epi32(simde_mm_unpackhi_epi16(v, v), 16);
+
+            simde_mm_storeu_ps(out + i, simde_mm_mul_ps(simde_mm_cvtepi32_ps(lo), scale));
+            simde_mm_storeu_ps(out + i + 4, simde_mm_mul_ps(simde_mm_cvtepi32_ps(hi), scale));
+        }
+
+        for(; i < numSamples; i++)
+            out[i] = samples[i] * (1.0f / 32768.0f);
+    }
+
+    AudioResampler::AudioResampler(int inputRateHz, int outputRateHz, int numChannels) :
+        mInputRate(std::max(1, inputRateHz)),
+        mOutputRate(std::max(1, outputRateHz)),
+        mChannels(std::max(1, numChannels)),
+        mFilter((PHASES + 1) * TAPS),
+        mBuf(mChannels),
+        mFirst(-TAPS)
+    {
+        // Band limit to the narrower of the two Nyquist frequencies, with a
+        // little headroom for the transition band
+        const double cutoff = 0.95 * std::min(1.0, static_cast<double>(mOutputRate) / mInputRate);
+
+        for(int p = 0; p <= PHASES; p++) {
+            const double frac = static_cast<double>(p) / PHASES;
+
+            double sum = 0.0;
+
+            for(int t = 0; t < TAPS; t++) {
+                const double x = frac + TAPS / 2 - 1 - t;
+                const double h = cutoff * sinc(cutoff * x) * window(x / (TAPS / 2));
+
+                mFilter[p * TAPS + t] = static_cast<float>(h);
+                sum += h;
+            }
+
+            // Unity DC gain per phase, so resampled silence stays silent
+            // and levels don't ripple with the phase
+            for(int t = 0; t < TAPS; t++)
+                mFilter[p * TAPS + t] = static_cast<float>(mFilter[p * TAPS + t] / sum);
+        }
+
+        // Prime the delay lines so the first outputs see zeros behind the
+        // first real sample
+        for(auto& buf : mBuf)
+            buf.assign(TAPS, 0.0f);
+    }
+
+    void AudioResampler::produce(std::vector<float>& out) {
+        for(;;) {
+            if(mFinished && mTimeInt >= mTotalIn)
+                break;
+
+            const int64_t base = mTimeInt - TAPS / 2 + 1;
+
+            // All taps must be buffered
+            if(base + TAPS > mFirst + static_cast<int64_t>(mBuf[0].size()))
+                break;
+
+            // Interpolate between the two neighbouring phases once, then
+            // run the same coefficients over every channel
+            const int64_t num = mTimeFrac * PHASES;
+            const int phase = static_cast<int>(num / mOutputRate);
+            const float alpha = static_cast<float>(num % mOutputRate) / mOutputRate;
+
+            const float* c0 = &mFilter[phase * TAPS];
+            const float* c1 = c0 + TAPS;
+
+            float coeff[TAPS];
+            const simde__m128 a = simde_mm_set1_ps(alpha);
+
+            for(int t = 0; t < TAPS; t += 4) {
+                const simde__m128 f0 = simde_mm_loadu_ps(c0 + t);
+                const simde__m128 f1 = simde_mm_loadu_ps(c1 + t);
+
+                simde_mm_storeu_ps(coeff + t,
+                    simde_mm_add_ps(f0, simde_mm_mul_ps(a, simde_mm_sub_ps(f1, f0))));
+            }
+
+            for(int c = 0; c < mChannels; c++) {
+                const float* x = mBuf[c].data() + (base - mFirst);
+
+                simde__m128 acc = simde_mm_setzero_ps();
+
+                for(int t = 0; t < TAPS; t += 4)
+                    acc = simde_mm_add_ps(acc,
+                        simde_mm_mul_ps(simde_mm_loadu_ps(coeff + t), simde_mm_loadu_ps(x + t)));
+
+                const simde__m128 half = simde_mm_add_ps(acc, simde_mm_movehl_ps(acc, acc));
+                const simde__m128 sum =
+                    simde_mm_add_ss(half, simde_mm_shuffle_ps(half, half, 1));
+
+                out.push_back(simde_mm_cvtss_f32(sum));
+            }
+
+            mTimeFrac += mInputRate;
+            mTimeInt += mTimeFrac / mOutputRate;
+            mTimeFrac %= mOutputRate;
+        }
+
+        // Drop input the filter has moved past
+        const int64_t keepFrom = mTimeInt - TAPS / 2 + 1;
+
+        if(keepFrom > mFirst) {
+            const size_t drop = static_cast<size_t>(keepFrom - mFirst);
+
+            for(auto& buf : mBuf)
+                buf.erase(buf.begin(), buf.begin() + std::min(drop, buf.size()));
+
+            mFirst = keepFrom;
+        }
+    }
+
+    void AudioResampler::process(const float* samples, size_t numSamples, std::vector<float>& out) {
+        const size_t frames = numSamples / mChannels;
+
+        for(int c = 0; c < mChannels; c++) {
+            auto& buf = mBuf[c];
+
+            for(size_t i = 0; i < frames; i++)
+                buf.push_back(samples[i * mChannels + c]);
+        }
+
+        mTotalIn += static_cast<int64_t>(frames);
+
+        produce(out);
+    }
+
+    void AudioResampler::finish(std::vector<float>& out) {
+        if(mFinished)
+            return;
+
+        mFinished = true;
+
+        // Zero padding flushes outputs still inside the filter's delay line
+        for(auto& buf : mBuf)
+            buf.insert(buf.end(), TAPS, 0.0f);
+
+        produce(out);
+    }
+
+} // namespace motioncam
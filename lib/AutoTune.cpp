@@ -0,0 +1,168 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/AutoTune.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#if defined(_WIN32)
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+    #include <sys/types.h>
+#endif
+
+namespace motioncam {
+    namespace autotune {
+        namespace {
+            constexpr int PROFILE_VERSION = 1;
+
+            // Directory the profiles live in, created on first store;
+            // empty when no suitable cache location exists
+            std::string profileDir(bool create) {
+                std::string base;
+
+#if defined(_WIN32)
+                const char* appData = std::getenv("LOCALAPPDATA");
+
+                if(!appData)
+                    return std::string();
+
+                base = std::string(appData) + "\\motioncam";
+
+                if(create)
+                    _mkdir(base.c_str());
+
+                return base + "\\tune";
+#else
+                const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+
+                if(cacheHome && cacheHome[0] != '\0')
+                    base = cacheHome;
+                else {
+                    const char* home = std::getenv("HOME");
+
+                    if(!home)
+                        return std::string();
+
+                    base = std::string(home) + "/.cache";
+                }
+
+                if(create) {
+                    // Each level, in case the cache root itself is missing
+                    mkdir(base.c_str(), 0755);
+                    mkdir((base + "/motioncam").c_str(), 0755);
+                    mkdir((base + "/motioncam/tune").c_str(), 0755);
+                }
+
+                return base + "/motioncam/tune";
+#endif
+            }
+
+            // Identify the storage mount holding path. On POSIX systems the
+            // device id separates mounts; on Windows the drive letter does.
+            bool mountKey(const std::string& path, std::string& outKey) {
+#if defined(_WIN32)
+                if(path.size() < 2 || path[1] != ':')
+                    return false;
+
+                outKey = std::string("drive-") + static_cast<char>(std::tolower(path[0]));
+
+                return true;
+#else
+                struct stat st {};
+
+                if(stat(path.c_str(), &st) != 0)
+                    return false;
+
+                outKey = "dev-" + std::to_string(static_cast<unsigned long long>(st.st_dev));
+
+                return true;
+#endif
+            }
+
+            std::string profilePath(const std::string& path, bool create) {
+                const std::string dir = profileDir(create);
+                std::string key;
+
+                if(dir.empty() || !mountKey(path, key))
+                    return std::string();
+
+#if defined(_WIN32)
+                return dir + "\\" + key + ".json";
+#else
+                return dir + "/" + key + ".json";
+#endif
+            }
+        }
+
+        bool Load(const std::string& path, TunedProfile& outProfile) {
+            const std::string profile = profilePath(path, false);
+
+            if(profile.empty())
+                return false;
+
+            std::ifstream file(profile);
+
+            if(!file)
+                return false;
+
+            nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+
+            if(json.is_discarded() || json.value("version", 0) != PROFILE_VERSION)
+                return false;
+
+            outProfile.readAhead = json.value("readAhead", size_t(0));
+            outProfile.blockSize = json.value("blockSize", size_t(0));
+            outProfile.decodeThreads = json.value("decodeThreads", size_t(0));
+
+            return true;
+        }
+
+        void Store(const std::string& path, const TunedProfile& profile) {
+            const std::string profileFile = profilePath(path, true);
+
+            if(profileFile.empty())
+                return;
+
+            nlohmann::json json;
+
+            json["version"] = PROFILE_VERSION;
+            json["readAhead"] = profile.readAhead;
+            json["blockSize"] = profile.blockSize;
+            json["decodeThreads"] = profile.decodeThreads;
+
+            // Write-then-rename so a concurrent open never sees a torn file
+            const std::string tmp = profileFile + ".tmp";
+
+            {
+                std::ofstream file(tmp, std::ios::trunc);
+
+                if(!file)
+                    return;
+
+                file << json.dump();
+            }
+
+            std::rename(tmp.c_str(), profileFile.c_str());
+        }
+    }
+}
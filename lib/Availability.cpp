@@ -0,0 +1,184 @@
+#include <motioncam/Reader.hpp>
+#include <motioncam/Decoder.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#if defined(_WIN32)
+    #define FSEEK _fseeki64
+#else
+    #define _FILE_OFFSET_BITS 64
+    #define FSEEK fseeko
+#endif
+
+namespace motioncam {
+
+    //
+    // AvailabilityMap
+    //
+
+    AvailabilityMap::AvailabilityMap(int64_t finalSize) : mFinalSize(finalSize) {
+        if(finalSize <= 0)
+            throw IOException("Invalid final size");
+    }
+
+    int64_t AvailabilityMap::finalSize() const {
+        return mFinalSize;
+    }
+
+    void AvailabilityMap::markAvailable(int64_t offset, size_t len) {
+        if(len == 0)
+            return;
+
+        const int64_t begin = std::max<int64_t>(0, offset);
+        const int64_t end = std::min<int64_t>(mFinalSize, offset + static_cast<int64_t>(len));
+
+        if(begin >= end)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            // First range starting past the new one; everything before that
+            // which reaches begin overlaps or touches it
+            auto first = std::upper_bound(mRanges.begin(), mRanges.end(), std::make_pair(begin, begin));
+
+            if(first != mRanges.begin() && std::prev(first)->second >= begin)
+                --first;
+
+            auto last = first;
+            int64_t mergedBegin = begin;
+            int64_t mergedEnd = end;
+
+            while(last != mRanges.end() && last->first <= mergedEnd) {
+                mergedBegin = std::min(mergedBegin, last->first);
+                mergedEnd = std::max(mergedEnd, last->second);
+                ++last;
+            }
+
+            first = mRanges.erase(first, last);
+            mRanges.insert(first, std::make_pair(mergedBegin, mergedEnd));
+        }
+
+        mChanged.notify_all();
+    }
+
+    bool AvailabilityMap::availableLocked(int64_t begin, int64_t end) const {
+        if(begin >= end)
+            return true;
+
+        // The covering range, if any, is the last one starting at or
+        // before begin
+        auto it = std::upper_bound(mRanges.begin(), mRanges.end(), std::make_pair(begin, std::numeric_limits<int64_t>::max()));
+
+        if(it == mRanges.begin())
+            return false;
+
+        --it;
+
+        return it->second >= end;
+    }
+
+    bool AvailabilityMap::available(int64_t offset, size_t len) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        return availableLocked(offset, offset + static_cast<int64_t>(len));
+    }
+
+    bool AvailabilityMap::waitFor(int64_t offset, size_t len, int timeoutMs) const {
+        const int64_t begin = offset;
+        const int64_t end = offset + static_cast<int64_t>(len);
+
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        if(timeoutMs < 0) {
+            mChanged.wait(lock, [&] { return availableLocked(begin, end); });
+
+            return true;
+        }
+
+        return mChanged.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+            return availableLocked(begin, end);
+        });
+    }
+
+    int64_t AvailabilityMap::availableBytes() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        int64_t total = 0;
+
+        for(const auto& range : mRanges)
+            total += range.second - range.first;
+
+        return total;
+    }
+
+    //
+    // PartialFileReader
+    //
+
+    PartialFileReader::PartialFileReader(const std::string& path, std::shared_ptr<AvailabilityMap> availability) :
+        mFile(std::fopen(path.c_str(), "rb")),
+        mAvailability(std::move(availability)),
+        mPos(0)
+    {
+        if(!mFile)
+            throw IOException("Failed to open " + path);
+
+        if(!mAvailability)
+            throw IOException("Invalid availability map");
+    }
+
+    PartialFileReader::~PartialFileReader() {
+        if(mFile)
+            std::fclose(mFile);
+    }
+
+    void PartialFileReader::read(void* data, size_t size, size_t items) {
+        if(!tryRead(data, size * items))
+            throw IOException("Byte range not yet available");
+    }
+
+    bool PartialFileReader::tryRead(void* data, size_t size) {
+        if(!mAvailability->available(mPos, size))
+            return false;
+
+        // The cursor is positioned per read; the transfer may have grown
+        // the file underneath us since the last one
+        if(FSEEK(mFile, mPos, SEEK_SET) != 0)
+            return false;
+
+        if(std::fread(data, 1, size, mFile) != size)
+            return false;
+
+        mPos += static_cast<int64_t>(size);
+
+        return true;
+    }
+
+    bool PartialFileReader::seek(int64_t offset, int origin) {
+        int64_t pos;
+
+        // Resolved against the final size, not the bytes on disk, so
+        // end-relative seeks land where they will on the complete file
+        switch(origin) {
+            case SEEK_SET: pos = offset; break;
+            case SEEK_CUR: pos = mPos + offset; break;
+            case SEEK_END: pos = mAvailability->finalSize() + offset; break;
+            default: return false;
+        }
+
+        if(pos < 0 || pos > mAvailability->finalSize())
+            return false;
+
+        mPos = pos;
+
+        return true;
+    }
+
+    int64_t PartialFileReader::size() {
+        return mAvailability->finalSize();
+    }
+
+} // namespace motioncam
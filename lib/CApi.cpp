@@ -0,0 +1,169 @@
+#include <motioncam/CApi.h>
+#include <motioncam/Decoder.hpp>
+#include <motioncam/FrameBufferPool.hpp>
+
+#include <exception>
+#include <string>
+
+// The handle types are plain structs in the global namespace so the
+// typedef names in CApi.h resolve to them from C
+struct mcraw_decoder {
+    explicit mcraw_decoder(const char* path) :
+        decoder(path),
+        metadataJson(decoder.getContainerMetadata().dump())
+    {
+    }
+
+    motioncam::Decoder decoder;
+    motioncam::FrameBufferPool pool;
+    std::string metadataJson;
+};
+
+struct mcraw_frame {
+    motioncam::FrameHandle pixels;
+    std::string metadataJson;
+    int64_t timestamp{0};
+    int width{0};
+    int height{0};
+};
+
+namespace {
+    // Per thread so concurrent decoders on different threads don't race
+    // over each other's failure messages
+    thread_local std::string sLastError;
+
+    void setError(const char* what) {
+        sLastError = what;
+    }
+}
+
+extern "C" {
+
+mcraw_decoder* mcraw_open(const char* path) {
+    if(!path) {
+        setError("Invalid path");
+        return nullptr;
+    }
+
+    try {
+        return new mcraw_decoder(path);
+    }
+    catch(const std::exception& e) {
+        setError(e.what());
+        return nullptr;
+    }
+}
+
+void mcraw_close(mcraw_decoder* decoder) {
+    delete decoder;
+}
+
+const char* mcraw_last_error(void) {
+    return sLastError.c_str();
+}
+
+int64_t mcraw_frame_count(const mcraw_decoder* decoder) {
+    if(!decoder) {
+        setError("Invalid decoder");
+        return -1;
+    }
+
+    return static_cast<int64_t>(decoder->decoder.getFrames().size());
+}
+
+int64_t mcraw_frame_timestamp_at(const mcraw_decoder* decoder, int64_t index) {
+    if(!decoder) {
+        setError("Invalid decoder");
+        return -1;
+    }
+
+    const auto& frames = decoder->decoder.getFrames();
+
+    if(index < 0 || index >= static_cast<int64_t>(frames.size())) {
+        setError("Frame index out of range");
+        return -1;
+    }
+
+    return frames[static_cast<size_t>(index)];
+}
+
+const char* mcraw_metadata_json(const mcraw_decoder* decoder) {
+    if(!decoder) {
+        setError("Invalid decoder");
+        return nullptr;
+    }
+
+    return decoder->metadataJson.c_str();
+}
+
+mcraw_frame* mcraw_load_frame(mcraw_decoder* decoder, int64_t timestamp) {
+    if(!decoder) {
+        setError("Invalid decoder");
+        return nullptr;
+    }
+
+    try {
+        nlohmann::json metadata;
+
+        auto pixels = decoder->decoder.loadFrame(timestamp, decoder->pool, metadata);
+
+        auto* frame = new mcraw_frame();
+
+        frame->pixels = std::move(pixels);
+        frame->width = metadata["width"];
+        frame->height = metadata["height"];
+        frame->timestamp = timestamp;
+        frame->metadataJson = metadata.dump();
+
+        return frame;
+    }
+    catch(const std::exception& e) {
+        setError(e.what());
+        return nullptr;
+    }
+}
+
+mcraw_frame* mcraw_load_frame_at(mcraw_decoder* decoder, int64_t index) {
+    const int64_t timestamp = mcraw_frame_timestamp_at(decoder, index);
+
+    if(timestamp < 0)
+        return nullptr;
+
+    return mcraw_load_frame(decoder, timestamp);
+}
+
+const uint16_t* mcraw_frame_data(const mcraw_frame* frame) {
+    if(!frame) {
+        setError("Invalid frame");
+        return nullptr;
+    }
+
+    return frame->pixels.data();
+}
+
+int mcraw_frame_width(const mcraw_frame* frame) {
+    return frame ? frame->width : 0;
+}
+
+int mcraw_frame_height(const mcraw_frame* frame) {
+    return frame ? frame->height : 0;
+}
+
+int64_t mcraw_frame_timestamp(const mcraw_frame* frame) {
+    return frame ? frame->timestamp : -1;
+}
+
+const char* mcraw_frame_metadata_json(const mcraw_frame* frame) {
+    if(!frame) {
+        setError("Invalid frame");
+        return nullptr;
+    }
+
+    return frame->metadataJson.c_str();
+}
+
+void mcraw_frame_release(mcraw_frame* frame) {
+    delete frame;
+}
+
+} // extern "C"
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/Checksum.hpp>
+
+#include <cstring>
+
+namespace motioncam {
+    namespace {
+        const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+        const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+        const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+        const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+        const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+        inline uint64_t Rotl64(const uint64_t x, const int r) {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        // Unaligned little-endian loads; the container format is little
+        // endian throughout, so the hash is defined over LE lanes
+        inline uint64_t Read64(const uint8_t* p) {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint32_t Read32(const uint8_t* p) {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint64_t Round(uint64_t acc, const uint64_t input) {
+            acc += input * PRIME64_2;
+            acc = Rotl64(acc, 31);
+
+            return acc * PRIME64_1;
+        }
+
+        inline uint64_t MergeRound(uint64_t acc, const uint64_t val) {
+            acc ^= Round(0, val);
+
+            return acc * PRIME64_1 + PRIME64_4;
+        }
+    }
+
+    uint64_t Hash64(const void* data, size_t len, uint64_t seed) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        const uint8_t* const end = p + len;
+
+        uint64_t h;
+
+        if(len >= 32) {
+            // Four independent accumulators keep the multiply latency off
+            // the critical path; this is what makes the hash stream at
+            // memory speed on long payloads
+            uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+            uint64_t v2 = seed + PRIME64_2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - PRIME64_1;
+
+            const uint8_t* const limit = end - 32;
+
+            do {
+                v1 = Round(v1, Read64(p));
+                v2 = Round(v2, Read64(p + 8));
+                v3 = Round(v3, Read64(p + 16));
+                v4 = Round(v4, Read64(p + 24));
+
+                p += 32;
+            } while(p <= limit);
+
+            h = Rotl64(v1, 1) + Rotl64(v2, 7) + Rotl64(v3, 12) + Rotl64(v4, 18);
+
+            h = MergeRound(h, v1);
+            h = MergeRound(h, v2);
+            h = MergeRound(h, v3);
+            h = MergeRound(h, v4);
+        }
+        else {
+            h = seed + PRIME64_5;
+        }
+
+        h += static_cast<uint64_t>(len);
+
+        while(p + 8 <= end) {
+            h ^= Round(0, Read64(p));
+            h = Rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+
+            p += 8;
+        }
+
+        if(p + 4 <= end) {
+            h ^= static_cast<uint64_t>(Read32(p)) * PRIME64_1;
+            h = Rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+
+            p += 4;
+        }
+
+        while(p < end) {
+            h ^= (*p) * PRIME64_5;
+            h = Rotl64(h, 11) * PRIME64_1;
+
+            p++;
+        }
+
+        // Final avalanche
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+
+        return h;
+    }
+}
@@ -1,260 +1,5734 @@
+#include <motioncam/Archive.hpp>
+#include <motioncam/AudioResampler.hpp>
+#include <motioncam/Checksum.hpp>
 #include <motioncam/Decoder.hpp>
+#include <motioncam/MemoryGovernor.hpp>
 #include <motioncam/RawData.hpp>
+#include <motioncam/Reader.hpp>
+#include <motioncam/RingBuffer.hpp>
+#include <motioncam/ThreadPool.hpp>
+#include <motioncam/Trace.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <limits>
+#include <cstdlib>
 #include <cstring>
+#include <sys/stat.h>
+#include <chrono>
+#include <future>
+#include <thread>
 
-#if defined(_WIN32)
-    #define FSEEK _fseeki64
-    #define FTELL _ftelli64
-#elif defined(__unix__) || defined(__linux__) || defined(__APPLE__)
-    #define _FILE_OFFSET_BITS 64
-    
-    #define FSEEK fseeko
-    #define FTELL ftello
+#include <simde/x86/sse2.h>
+
+#if MOTIONCAM_DECODER_STATS
+    #define STAT_ADD(counter, n) (counter).fetch_add((n), std::memory_order_relaxed)
+    #define STAT_TIMER(name) const auto name = std::chrono::steady_clock::now()
+    #define STAT_TIMER_END(counter, name) \
+        STAT_ADD(counter, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - (name)).count())
+    #define STAT_HIST(stage, name) \
+        mLatencyHistograms[static_cast<int>(DecodeStage::stage)].record( \
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - (name)).count())
+    #define STAT_TIMER_END_HIST(counter, stage, name) \
+        do { \
+            const uint64_t _statElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - (name)).count(); \
+            STAT_ADD(counter, _statElapsed); \
+            mLatencyHistograms[static_cast<int>(DecodeStage::stage)].record(_statElapsed); \
+        } while(0)
 #else
-    #error Unknown platform
+    #define STAT_ADD(counter, n) do {} while(0)
+    #define STAT_TIMER(name) do {} while(0)
+    #define STAT_TIMER_END(counter, name) do {} while(0)
+    #define STAT_HIST(stage, name) do {} while(0)
+    #define STAT_TIMER_END_HIST(counter, stage, name) do {} while(0)
 #endif
 
 namespace motioncam {
     constexpr int MOTIONCAM_COMPRESSION_TYPE = 7;
 
-    Decoder::Decoder(FILE* file) : mFile(file) {
-        if(!mFile)
-            throw IOException("Invalid file");
-            
-        init();
-    }
+    namespace {
+        // Pull an integer field out of a flat JSON buffer without building a
+        // DOM. Returns false if the key is missing or not a plain number.
+        // Tolerant of malformed surroundings by construction, which the
+        // index recovery scan relies on when probing damaged files; the
+        // well-formed hot paths use scanFrameMetadata below instead.
+        bool scanJsonInt(const std::vector<uint8_t>& json, const char* key, long& outValue) {
+            const std::string needle = "\"" + std::string(key) + "\"";
+            const char* begin = reinterpret_cast<const char*>(json.data());
+
+            auto it = std::search(begin, begin + json.size(), needle.begin(), needle.end());
+            if(it == begin + json.size())
+                return false;
+
+            const char* p = it + needle.size();
+            const char* end = begin + json.size();
+
+            while(p < end && (*p == ' ' || *p == '\t' || *p == ':'))
+                ++p;
+
+            bool negative = false;
+
+            if(p < end && *p == '-') {
+                negative = true;
+                ++p;
+            }
+
+            if(p >= end || *p < '0' || *p > '9')
+                return false;
+
+            long value = 0;
+
+            while(p < end && *p >= '0' && *p <= '9') {
+                value = value*10 + (*p - '0');
+                ++p;
+            }
+
+            outValue = negative ? -value : value;
+
+            return true;
+        }
+
+        inline int countTrailingZeros(unsigned int mask) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctz(mask);
+#endif
+        }
+
+        // Find the next double quote, comparing 16 bytes at a time
+        inline const char* nextQuote(const char* p, const char* end) {
+            const simde__m128i quote = simde_mm_set1_epi8('"');
+
+            while(p + 16 <= end) {
+                const simde__m128i chunk = simde_mm_loadu_si128(reinterpret_cast<const simde__m128i*>(p));
+                const int mask = simde_mm_movemask_epi8(simde_mm_cmpeq_epi8(chunk, quote));
+
+                if(mask)
+                    return p + countTrailingZeros(static_cast<unsigned int>(mask));
+
+                p += 16;
+            }
+
+            while(p < end && *p != '"')
+                ++p;
+
+            return p;
+        }
+
+        inline void skipJsonWhitespace(const char*& p, const char* end) {
+            while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                ++p;
+        }
+
+        // Parse one JSON number token. outIsInt reports whether the token
+        // was a plain integer; the other representation is a cast.
+        bool scanJsonNumber(const char*& p, const char* end, double& outDouble, long long& outInt, bool& outIsInt) {
+            const char* start = p;
+
+            if(p < end && *p == '-')
+                ++p;
+
+            while(p < end && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-'))
+                ++p;
+
+            const size_t len = p - start;
+
+            char buffer[32];
+
+            if(len == 0 || len >= sizeof(buffer))
+                return false;
+
+            std::memcpy(buffer, start, len);
+            buffer[len] = 0;
+
+            outIsInt = !std::memchr(buffer, '.', len) && !std::memchr(buffer, 'e', len) && !std::memchr(buffer, 'E', len);
+
+            char* tokenEnd = nullptr;
+
+            if(outIsInt) {
+                outInt = std::strtoll(buffer, &tokenEnd, 10);
+                outDouble = static_cast<double>(outInt);
+            }
+            else {
+                outDouble = std::strtod(buffer, &tokenEnd);
+                outInt = static_cast<long long>(outDouble);
+            }
+
+            return tokenEnd == buffer + len;
+        }
+
+        // The known MCRAW frame metadata fields the scanner dispatches on
+        enum class FrameField : int {
+            NONE = 0,
+            WIDTH,
+            HEIGHT,
+            COMPRESSION_TYPE,
+            ISO,
+            ORIENTATION,
+            EXPOSURE_TIME,
+            AS_SHOT_NEUTRAL
+        };
+
+        struct FieldEntry {
+            const char* name;
+            FrameField field;
+        };
+
+        // Compile-time perfect-hash table over the schema's key set: every
+        // known key has a distinct length, so the hash is the length
+        // itself and one memcmp against the expected spelling confirms the
+        // hit. Keys sit at the slot of their length; the static_assert
+        // below keeps the table perfect if the schema grows.
+        constexpr FieldEntry FIELD_TABLE[16] = {
+            {},
+            {},
+            {},
+            { "iso", FrameField::ISO },
+            {},
+            { "width", FrameField::WIDTH },
+            { "height", FrameField::HEIGHT },
+            {},
+            {},
+            {},
+            {},
+            { "orientation", FrameField::ORIENTATION },
+            { "exposureTime", FrameField::EXPOSURE_TIME },
+            { "asShotNeutral", FrameField::AS_SHOT_NEUTRAL },
+            {},
+            { "compressionType", FrameField::COMPRESSION_TYPE },
+        };
+
+        constexpr size_t fieldNameLen(const char* name) {
+            size_t len = 0;
+
+            while(name[len])
+                ++len;
+
+            return len;
+        }
+
+        constexpr bool fieldTableIsPerfect() {
+            for(size_t i = 0; i < sizeof(FIELD_TABLE) / sizeof(FIELD_TABLE[0]); i++) {
+                if(FIELD_TABLE[i].name && fieldNameLen(FIELD_TABLE[i].name) != i)
+                    return false;
+            }
+
+            return true;
+        }
+
+        static_assert(fieldTableIsPerfect(),
+            "frame metadata field table: every key must sit at the slot of its length");
+
+        // One table load and one memcmp per key, instead of a comparison
+        // chain per known field
+        FrameField lookupField(const char* key, size_t keyLen) {
+            if(keyLen >= sizeof(FIELD_TABLE) / sizeof(FIELD_TABLE[0]))
+                return FrameField::NONE;
+
+            const FieldEntry& entry = FIELD_TABLE[keyLen];
+
+            if(!entry.name || std::memcmp(key, entry.name, keyLen) != 0)
+                return FrameField::NONE;
+
+            return entry.field;
+        }
+
+        // The fields of a frame's metadata document that the decoder needs.
+        // width, height and compressionType are negative when absent; the
+        // rest keep their zero initializers.
+        struct ScannedFrameMetadata {
+            long width{-1};
+            long height{-1};
+            long compressionType{-1};
+            long iso{0};
+            long orientation{0};
+            long long exposureTime{0};
+            double asShotNeutral[3]{};
+            bool hasAsShotNeutral{false};
+        };
+
+        // Extract every field the decoder cares about from a flat JSON
+        // document in one forward pass, without building a DOM. Quotes are
+        // located with SIMD, so the scan moves through the document at
+        // several bytes per cycle. Anything unexpected - nested objects,
+        // escaped strings, malformed tokens - returns false and the caller
+        // falls back to the full parser, so this path never has to be more
+        // lenient or more strict than nlohmann.
+        bool scanFrameMetadata(const std::vector<uint8_t>& json, ScannedFrameMetadata& out) {
+            const char* p = reinterpret_cast<const char*>(json.data());
+            const char* end = p + json.size();
+
+            skipJsonWhitespace(p, end);
+
+            if(p >= end || *p != '{')
+                return false;
+
+            ++p;
+
+            bool afterComma = false;
+
+            for(;;) {
+                skipJsonWhitespace(p, end);
+
+                if(p < end && *p == '}')
+                    return !afterComma;
+
+                if(p >= end || *p != '"')
+                    return false;
+
+                const char* key = ++p;
+                const char* keyEnd = nextQuote(p, end);
+
+                if(keyEnd >= end || keyEnd[-1] == '\\')
+                    return false;
+
+                const size_t keyLen = keyEnd - key;
+
+                p = keyEnd + 1;
+                skipJsonWhitespace(p, end);
+
+                if(p >= end || *p != ':')
+                    return false;
+
+                ++p;
+                skipJsonWhitespace(p, end);
+
+                if(p >= end)
+                    return false;
+
+                const FrameField field = lookupField(key, keyLen);
+
+                if(*p == '"') {
+                    // String value: skip it, rejecting escapes
+                    const char* valueEnd = nextQuote(p + 1, end);
+
+                    if(valueEnd >= end || valueEnd[-1] == '\\')
+                        return false;
+
+                    p = valueEnd + 1;
+                }
+                else if(*p == '[') {
+                    // Array of scalars: capture asShotNeutral, skip the rest
+                    ++p;
+
+                    size_t count = 0;
+                    double values[3] = {};
+                    bool elementAfterComma = false;
+
+                    skipJsonWhitespace(p, end);
+
+                    while(p < end && *p != ']') {
+                        double d;
+                        long long i;
+                        bool isInt;
+
+                        if(*p == '"') {
+                            const char* valueEnd = nextQuote(p + 1, end);
+
+                            if(valueEnd >= end || valueEnd[-1] == '\\')
+                                return false;
+
+                            p = valueEnd + 1;
+                        }
+                        else if(scanJsonNumber(p, end, d, i, isInt)) {
+                            if(count < 3)
+                                values[count] = d;
+
+                            count++;
+                        }
+                        else {
+                            return false;
+                        }
+
+                        skipJsonWhitespace(p, end);
+
+                        elementAfterComma = false;
+
+                        if(p < end && *p == ',') {
+                            ++p;
+                            elementAfterComma = true;
+                            skipJsonWhitespace(p, end);
+                        }
+                        else if(p < end && *p != ']') {
+                            return false;
+                        }
+                    }
+
+                    if(p >= end || elementAfterComma)
+                        return false;
+
+                    ++p;
+
+                    if(field == FrameField::AS_SHOT_NEUTRAL && count == 3) {
+                        for(int c = 0; c < 3; c++)
+                            out.asShotNeutral[c] = values[c];
+
+                        out.hasAsShotNeutral = true;
+                    }
+                }
+                else if(*p == 't' || *p == 'f' || *p == 'n') {
+                    // Literal: skip it
+                    while(p < end && *p >= 'a' && *p <= 'z')
+                        ++p;
+                }
+                else if(*p == '{') {
+                    return false;
+                }
+                else {
+                    double d;
+                    long long i;
+                    bool isInt;
+
+                    if(!scanJsonNumber(p, end, d, i, isInt))
+                        return false;
+
+                    switch(field) {
+                        case FrameField::WIDTH:
+                            if(!isInt) return false;
+                            out.width = static_cast<long>(i);
+                            break;
+
+                        case FrameField::HEIGHT:
+                            if(!isInt) return false;
+                            out.height = static_cast<long>(i);
+                            break;
+
+                        case FrameField::COMPRESSION_TYPE:
+                            if(!isInt) return false;
+                            out.compressionType = static_cast<long>(i);
+                            break;
+
+                        case FrameField::ISO:
+                            if(!isInt) return false;
+                            out.iso = static_cast<long>(i);
+                            break;
+
+                        case FrameField::ORIENTATION:
+                            if(!isInt) return false;
+                            out.orientation = static_cast<long>(i);
+                            break;
+
+                        case FrameField::EXPOSURE_TIME:
+                            if(!isInt) return false;
+                            out.exposureTime = i;
+                            break;
+
+                        default:
+                            break;
+                    }
+                }
+
+                skipJsonWhitespace(p, end);
+
+                if(p < end && *p == ',') {
+                    ++p;
+                    afterComma = true;
+                    continue;
+                }
+
+                if(p < end && *p == '}')
+                    return true;
+
+                return false;
+            }
+        }
+
+        // Advance p past one JSON value - scalar, string, array or object -
+        // leaving it on the ',' or '}' that ends the value. Strings may
+        // contain escapes; containers may nest. Returns false on malformed
+        // or truncated input.
+        bool skipJsonValue(const char*& p, const char* end) {
+            int depth = 0;
+            bool inString = false;
+
+            while(p < end) {
+                const char c = *p;
+
+                if(inString) {
+                    if(c == '\\') {
+                        p += 2;
+                        continue;
+                    }
+
+                    if(c == '"')
+                        inString = false;
+
+                    ++p;
+                    continue;
+                }
+
+                if(c == '"') {
+                    inString = true;
+                    ++p;
+                }
+                else if(c == '{' || c == '[') {
+                    ++depth;
+                    ++p;
+                }
+                else if(c == '}' || c == ']') {
+                    if(depth == 0)
+                        return true;    // The enclosing object's closer; scalar value ended
+
+                    --depth;
+                    ++p;
+
+                    if(depth == 0)
+                        return true;    // Container value complete
+                }
+                else if(c == ',' && depth == 0) {
+                    return true;
+                }
+                else {
+                    ++p;
+                }
+            }
+
+            return false;
+        }
+
+        // One top-level "key": value pair of a frame metadata document,
+        // as raw byte ranges into the document
+        struct MetadataSpan {
+            const char* key;
+            size_t keyLen;
+            const char* value;
+            size_t valueLen;
+        };
+
+        // Split a flat JSON object into its top-level key/value spans
+        // without interpreting the values. Escaped keys are rejected -
+        // their raw bytes would not equal the decoded key - and anything
+        // malformed returns false so the caller can fall back to the full
+        // parser.
+        bool splitFrameMetadata(const std::vector<uint8_t>& json, std::vector<MetadataSpan>& outSpans) {
+            const char* p = reinterpret_cast<const char*>(json.data());
+            const char* end = p + json.size();
+
+            outSpans.clear();
+            skipJsonWhitespace(p, end);
+
+            if(p >= end || *p != '{')
+                return false;
+
+            ++p;
+
+            bool afterComma = false;
+
+            for(;;) {
+                skipJsonWhitespace(p, end);
+
+                if(p < end && *p == '}')
+                    return !afterComma;
+
+                if(p >= end || *p != '"')
+                    return false;
+
+                const char* key = ++p;
+                const char* keyEnd = nextQuote(p, end);
+
+                if(keyEnd >= end || keyEnd[-1] == '\\')
+                    return false;
+
+                p = keyEnd + 1;
+                skipJsonWhitespace(p, end);
+
+                if(p >= end || *p != ':')
+                    return false;
+
+                ++p;
+                skipJsonWhitespace(p, end);
+
+                const char* value = p;
+
+                if(!skipJsonValue(p, end))
+                    return false;
+
+                outSpans.push_back(MetadataSpan{key, static_cast<size_t>(keyEnd - key), value, static_cast<size_t>(p - value)});
+
+                skipJsonWhitespace(p, end);
+
+                if(p < end && *p == ',') {
+                    ++p;
+                    afterComma = true;
+                    continue;
+                }
+
+                if(p < end && *p == '}')
+                    return true;
+
+                return false;
+            }
+        }
+
+        // Consecutive frames share almost all of their metadata text -
+        // dimensions, lens data and calibration never change mid-clip, and
+        // usually only the timestamp and exposure fields differ - so the
+        // per-thread cache below remembers the previous document's spans
+        // with their parsed values. A span whose raw bytes are unchanged
+        // reuses the cached value (a DOM copy, no text work) and only
+        // changed spans go through the parser. One cache per thread,
+        // mirroring the decode scratch: the pooled batch loaders call this
+        // concurrently, and each worker tends to see consecutive frames.
+        struct MetadataSpanCache {
+            struct Entry {
+                std::string key;
+                std::string value;
+                nlohmann::json parsed;
+            };
+
+            std::vector<Entry> entries;
+        };
+
+        // Parse a frame metadata document, reusing the calling thread's
+        // previous document for spans whose bytes did not change. Produces
+        // exactly what nlohmann::json::parse would, including throwing on
+        // malformed input.
+        nlohmann::json parseFrameMetadata(const std::vector<uint8_t>& json) {
+            thread_local MetadataSpanCache cache;
+            thread_local std::vector<MetadataSpan> spans;
+
+            if(!splitFrameMetadata(json, spans)) {
+                cache.entries.clear();
+
+                return nlohmann::json::parse(json.begin(), json.end());
+            }
+
+            nlohmann::json out = nlohmann::json::object();
+
+            if(cache.entries.size() < spans.size())
+                cache.entries.resize(spans.size());
+
+            for(size_t i = 0; i < spans.size(); i++) {
+                const MetadataSpan& span = spans[i];
+                auto& cached = cache.entries[i];
+
+                if(cached.key.size() == span.keyLen
+                    && cached.value.size() == span.valueLen
+                    && std::memcmp(cached.key.data(), span.key, span.keyLen) == 0
+                    && std::memcmp(cached.value.data(), span.value, span.valueLen) == 0)
+                {
+                    out[cached.key] = cached.parsed;
+                }
+                else {
+                    nlohmann::json parsed = nlohmann::json::parse(span.value, span.value + span.valueLen);
+
+                    cached.key.assign(span.key, span.keyLen);
+                    cached.value.assign(span.value, span.valueLen);
+
+                    out[cached.key] = parsed;
+                    cached.parsed = std::move(parsed);
+                }
+            }
+
+            if(cache.entries.size() > spans.size())
+                cache.entries.resize(spans.size());
+
+            return out;
+        }
+    }
+
+    // A compressed frame staged by the sequential scan I/O thread
+    struct PrefetchedFrame {
+        Timestamp timestamp;
+        std::vector<uint8_t> compressed;
+        std::vector<uint8_t> metadataJson;
+    };
+
+    // Staged frames flow through a lock-free SPSC ring: the I/O thread is
+    // the only producer and nextFrame() the only consumer, so neither side
+    // takes a lock per frame. error is written by the I/O thread before
+    // its release store of done and read by the consumer after an acquire
+    // load of it.
+    struct Decoder::SequentialScanState {
+        SequentialScanState(size_t ahead, size_t maxAhead) : ring(maxAhead), readAhead(ahead), maxReadAhead(maxAhead) {}
+
+        std::thread ioThread;
+        SpscRingBuffer<PrefetchedFrame> ring;
+        // Atomic so a tuned scan can adjust the depth from the consumer
+        // side while the I/O thread gates on it; the ring is sized to
+        // maxReadAhead so growing needs no reallocation
+        std::atomic<size_t> readAhead{3};
+        size_t maxReadAhead{3};
+        bool tune{false};
+        // A selective scan visits only these frame indices; an empty
+        // selection with the flag set delivers no frames at all
+        bool selective{false};
+        std::vector<size_t> selection;
+        std::atomic<bool> done{false};
+        std::atomic<bool> stop{false};
+        std::exception_ptr error;
+
+        // Tuning signals. The wait counters mark stalls - a consumer that
+        // found the ring empty, an I/O thread that found it full - and the
+        // nanosecond totals are single-writer: read* by the I/O thread,
+        // decode* by the consumer.
+        std::atomic<uint64_t> emptyWaits{0};
+        std::atomic<uint64_t> fullWaits{0};
+        std::atomic<uint64_t> readNanos{0};
+        std::atomic<uint64_t> framesRead{0};
+        uint64_t decodeNanos{0};
+        uint64_t framesDelivered{0};
+        uint64_t lastEmptyWaits{0};
+        uint64_t lastFullWaits{0};
+    };
+
+    Decoder::Decoder(FILE* file) : mReader(new FileReader(file, true)) {
+        init();
+    }
+
+    Decoder::Decoder(const uint8_t* data, size_t size) : mReader(new MemoryReader(data, size)) {
+        init();
+    }
+
+    Decoder::Decoder(std::shared_ptr<const std::vector<uint8_t>> buffer) : mReader(new MemoryReader(std::move(buffer))) {
+        init();
+    }
+
+    std::future<std::unique_ptr<Decoder>> Decoder::openAsync(const std::string& path, ReadMode mode, bool useIndexCache) {
+        auto promise = std::make_shared<std::promise<std::unique_ptr<Decoder>>>();
+        auto future = promise->get_future();
+
+        // Opens are I/O bound, so they ride the I/O priority lane and leave
+        // the decode lanes to frame work
+        ThreadPool::shared().enqueue(Priority::IO, [promise, path, mode, useIndexCache] {
+            try {
+                promise->set_value(std::unique_ptr<Decoder>(new Decoder(path, mode, useIndexCache)));
+            }
+            catch(...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+
+        return future;
+    }
+
+    std::future<std::unique_ptr<Decoder>> Decoder::openAsync(const std::string& path, const CancellationToken& token, ReadMode mode, bool useIndexCache) {
+        auto promise = std::make_shared<std::promise<std::unique_ptr<Decoder>>>();
+        auto future = promise->get_future();
+        auto cancelled = token.mCancelled;
+
+        ThreadPool::shared().enqueue(Priority::IO, [promise, path, mode, useIndexCache, cancelled] {
+            // An open still queued at cancellation resolves to null without
+            // touching the disk
+            if(cancelled->load(std::memory_order_relaxed)) {
+                promise->set_value(nullptr);
+                return;
+            }
+
+            try {
+                promise->set_value(std::unique_ptr<Decoder>(new Decoder(path, mode, useIndexCache)));
+            }
+            catch(...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+
+        return future;
+    }
+
+    std::vector<Decoder::OpenResult> Decoder::openBatch(const std::vector<std::string>& paths, ReadMode mode, bool useIndexCache) {
+        std::vector<OpenResult> results(paths.size());
+
+        // One I/O-lane task per file: the opens' small index and metadata
+        // reads from different files stay in flight together instead of
+        // one file's round trips completing before the next begin
+        TaskGroup group;
+
+        for(size_t i = 0; i < paths.size(); i++) {
+            group.run(ThreadPool::shared(), Priority::IO, [&results, &paths, i, mode, useIndexCache] {
+                try {
+                    results[i].decoder.reset(new Decoder(paths[i], mode, useIndexCache));
+                }
+                catch(const std::exception& e) {
+                    results[i].error = e.what();
+                }
+            });
+        }
+
+        group.wait();
+
+        return results;
+    }
+
+    Decoder::Decoder(std::unique_ptr<Reader> reader) : mReader(std::move(reader)) {
+        if(!mReader)
+            throw IOException("Invalid reader");
+
+        init();
+    }
+
+    Decoder::Decoder(const std::string& path, std::shared_ptr<AvailabilityMap> availability) :
+        mPath(path), mAvailability(std::move(availability))
+    {
+        if(!mAvailability)
+            throw IOException("Invalid availability map");
+
+        mReader.reset(new PartialFileReader(path, mAvailability));
+
+        // The header and camera metadata arrive first in any in-order
+        // transfer; wait for them, then for the trailing index, which the
+        // recorder writes last at the file tail. Everything init() reads is
+        // then present, and a partially synced middle only matters once a
+        // frame in it is loaded.
+        const int64_t finalSize = mAvailability->finalSize();
+
+        mAvailability->waitFor(0, sizeof(Header) + sizeof(Item));
+
+        Item metadataItem{};
+
+        if(!seek(sizeof(Header), SEEK_SET))
+            throw IOException("Invalid container");
+
+        read(&metadataItem, sizeof(Item));
+
+        if(metadataItem.type != Type::METADATA)
+            throw IOException("Invalid container");
+
+        mAvailability->waitFor(sizeof(Header) + sizeof(Item), metadataItem.size);
+
+        // The BUFFER_INDEX item at the very end names where the index data
+        // starts; everything from there to the end is index records
+        const int64_t indexItemOffset = finalSize - static_cast<int64_t>(sizeof(BufferIndex) + sizeof(Item));
+
+        if(indexItemOffset > 0) {
+            mAvailability->waitFor(indexItemOffset, sizeof(BufferIndex) + sizeof(Item));
+
+            Item bufferIndexItem{};
+            BufferIndex index{};
+
+            if(seek(indexItemOffset, SEEK_SET)
+                && mReader->tryRead(&bufferIndexItem, sizeof(Item))
+                && bufferIndexItem.type == Type::BUFFER_INDEX
+                && mReader->tryRead(&index, sizeof(BufferIndex))
+                && index.magicNumber == INDEX_MAGIC_NUMBER
+                && index.indexDataOffset > 0
+                && index.indexDataOffset < finalSize)
+            {
+                mAvailability->waitFor(index.indexDataOffset, static_cast<size_t>(finalSize - index.indexDataOffset));
+            }
+        }
+
+        // init() reads from the start of the container
+        if(!seek(0, SEEK_SET))
+            throw IOException("Invalid container");
+
+        init();
+    }
+
+    // Reader dispatch shared by the path constructor, clone() and reopen():
+    // profile opens recreate the reader for their resolved profile, mode
+    // opens the reader for their mode.
+    std::unique_ptr<Reader> Decoder::createReader(const std::string& path) const {
+        if(mProfileOpen)
+            return createReaderForProfile(path, mProfile);
+
+        if(mMode == ReadMode::MEMORY_MAPPED)
+            return std::unique_ptr<Reader>(new MemoryMappedReader(path));
+
+        if(mMode == ReadMode::IO_URING) {
+#if defined(__linux__)
+            return std::unique_ptr<Reader>(new UringReader(path));
+#else
+            throw IOException("io_uring is only available on Linux");
+#endif
+        }
+
+        if(mMode == ReadMode::OVERLAPPED_IO) {
+#if defined(_WIN32)
+            return std::unique_ptr<Reader>(new OverlappedReader(path));
+#else
+            throw IOException("Overlapped I/O is only available on Windows");
+#endif
+        }
+
+        if(mMode == ReadMode::SHARED)
+            // Decoders over one container attach to the same per-file
+            // cache, so concurrent readers still read every byte once
+            return std::unique_ptr<Reader>(new SharedFileReader(path));
+
+        return std::unique_ptr<Reader>(new FileReader(path));
+    }
+
+    Decoder::Decoder(const std::string& path, ReadMode mode, bool useIndexCache) :
+        Decoder(path, mode, useIndexCache, false)
+    {
+    }
+
+    std::unique_ptr<Decoder> Decoder::openStreamingIndex(const std::string& path, ReadMode mode) {
+        return std::unique_ptr<Decoder>(new Decoder(path, mode, false, true));
+    }
+
+    Decoder::Decoder(const std::string& path, ReadMode mode, bool useIndexCache, bool streamingIndex) : mPath(path), mMode(mode) {
+        mIndexCacheEnabled = useIndexCache;
+        mStreamingIndex = streamingIndex;
+
+        mReader = createReader(path);
+
+        if(useIndexCache && tryLoadIndexCache())
+            return;
+
+        init();
+
+        if(useIndexCache) {
+            // Harvest the per-frame item sizes first so the cache carries
+            // them; cached opens then load frames with two exact preads and
+            // scan metadata without ever seeking over a payload
+            ensureFrameSizes();
+            writeIndexCache();
+        }
+    }
+
+    Decoder::Decoder(const std::string& path, StorageProfile profile, bool useIndexCache) : mPath(path) {
+        mIndexCacheEnabled = useIndexCache;
+
+        if(profile == StorageProfile::AUTO)
+            profile = detectStorageProfile(path);
+
+        mProfile = profile;
+        mProfileOpen = true;
+
+        mReader = createReaderForProfile(path, profile);
+
+        if(useIndexCache && tryLoadIndexCache()) {
+            tuneBlockSize();
+            return;
+        }
+
+        init();
+
+        tuneBlockSize();
+
+        if(useIndexCache) {
+            ensureFrameSizes();
+            writeIndexCache();
+        }
+    }
+
+    // For the block-buffered profiles, size read blocks from the frame
+    // index: a block covering about two frames makes a typical frame load -
+    // metadata scan included - one or two sequential transfers, without
+    // dragging in megabytes of neighbouring frames the caller may skip.
+    void Decoder::tuneBlockSize() {
+        if(!mProfileOpen || (mProfile != StorageProfile::HDD && mProfile != StorageProfile::NETWORK))
+            return;
+
+        if(mFrameOffsets.size() < 2)
+            return;
+
+        std::vector<int64_t> offsets(mFrameOffsets);
+
+        std::sort(offsets.begin(), offsets.end());
+
+        // Median frame stride; robust against the occasional oversized frame
+        std::vector<int64_t> strides(offsets.size() - 1);
+
+        for(size_t i = 0; i + 1 < offsets.size(); i++)
+            strides[i] = offsets[i + 1] - offsets[i];
+
+        std::nth_element(strides.begin(), strides.begin() + strides.size() / 2, strides.end());
+
+        const int64_t stride = std::max<int64_t>(strides[strides.size() / 2], 1);
+
+        const size_t floor = mProfile == StorageProfile::NETWORK ? (1u << 20) : (256u << 10);
+        const size_t ceiling = mProfile == StorageProfile::NETWORK ? (8u << 20) : (4u << 20);
+
+        size_t blockSize = floor;
+
+        while(blockSize < static_cast<size_t>(2 * stride) && blockSize < ceiling)
+            blockSize <<= 1;
+
+        // The profile reader for these profiles is always block-buffered
+        static_cast<BlockBufferedReader*>(mReader.get())->resizeBlocks(blockSize);
+        mBlockSize = blockSize;
+    }
+
+    void Decoder::enableAutoTune() {
+        mAutoTune = true;
+
+        // Profiles are keyed by mount; FILE*/memory decoders have no path
+        // to key on and just tune online
+        if(mPath.empty() || !autotune::Load(mPath, mTunedProfile))
+            return;
+
+        // A learned block size replaces the index-derived one on the
+        // block-buffered profile readers
+        if(mProfileOpen && (mProfile == StorageProfile::HDD || mProfile == StorageProfile::NETWORK)
+            && mTunedProfile.blockSize > 0)
+        {
+            const size_t floor = mProfile == StorageProfile::NETWORK ? (1u << 20) : (256u << 10);
+            const size_t ceiling = mProfile == StorageProfile::NETWORK ? (8u << 20) : (4u << 20);
+
+            const size_t blockSize = std::min(ceiling, std::max(floor, mTunedProfile.blockSize));
+
+            static_cast<BlockBufferedReader*>(mReader.get())->resizeBlocks(blockSize);
+            mBlockSize = blockSize;
+        }
+    }
+
+    Decoder::Decoder(const Decoder& other) : mPath(other.mPath), mMode(other.mMode) {
+        mProfile = other.mProfile;
+        mProfileOpen = other.mProfileOpen;
+
+        mReader = createReader(mPath);
+
+        // Reuse the parsed state instead of re-running init()
+        mVersion = other.mVersion;
+        mFrameList = other.mFrameList;
+        mFrameOffsets = other.mFrameOffsets;
+        mPayloadSizes = other.mPayloadSizes;
+        mMetadataSizes = other.mMetadataSizes;
+        mAudioOffsets = other.mAudioOffsets;
+        mAudioStartTimestampMs = other.mAudioStartTimestampMs;
+        mAudioIndexLoaded = other.mAudioIndexLoaded;
+        mMetadata = other.mMetadata;
+        mMetadataJsonPending = other.mMetadataJsonPending;
+        mContainerMetadata = other.mContainerMetadata;
+        mAudioOverview = other.mAudioOverview;
+        mAudioOverviewLoaded = other.mAudioOverviewLoaded;
+        mIndexCacheEnabled = other.mIndexCacheEnabled;
+        mThumbnailOffset = other.mThumbnailOffset;
+        mThumbnailSize = other.mThumbnailSize;
+        mChecksums = other.mChecksums;
+        mVerifyChecksums = other.mVerifyChecksums;
+        mStreamingStores = other.mStreamingStores;
+        mDecodeQoS = other.mDecodeQoS;
+
+        tuneBlockSize();
+    }
+
+    std::unique_ptr<Decoder> Decoder::clone() const {
+        if(mPath.empty())
+            throw IOException("Cannot clone a decoder constructed from a FILE*");
+
+        return std::unique_ptr<Decoder>(new Decoder(*this));
+    }
+
+    void Decoder::reopen(const std::string& path) {
+        if(mPath.empty())
+            throw IOException("Cannot reopen a decoder not opened by path");
+
+        if(mScan)
+            endSequentialScan();
+
+        if(mFollowPos >= 0)
+            endFollow();
+
+        // Drop the per-container state. clear() keeps each vector's
+        // capacity, so the index arrays and scratch buffers of the next
+        // open land in the memory of the last one.
+        mFrameList.clear();
+        mFrameOffsets.clear();
+        mPayloadSizes.clear();
+        mMetadataSizes.clear();
+
+        mAudioOffsets.clear();
+        mAudioStartTimestampMs = 0;
+        mAudioIndexLoaded = false;
+        mAudioTimestampsIndexed = false;
+        mAudioAlignment.clear();
+        mAudioTotalFrames = 0;
+        mAudioAlignmentBuilt = false;
+        mAudioOverview.minValue.clear();
+        mAudioOverview.maxValue.clear();
+        mAudioOverview.rms.clear();
+        mAudioOverviewLoaded = false;
+
+        mThumbnailOffset = -1;
+        mThumbnailSize = 0;
+
+        mMetadata = nlohmann::json();
+        mMetadataJsonPending.clear();
+        mContainerMetadata = ContainerMetadata{};
+
+        mFileSize = -1;
+        mMetadataSizeHint = 0;
+
+        // Fixed-geometry mode stays enabled but recaptures from the next
+        // clip's first load; the dimensions are per-container
+        mFixedWidth = -1;
+        mFixedHeight = -1;
+
+        mScanHighWater = 0;
+        mDroppedTo = 0;
+
+        mFollowPos = -1;
+        mFollowEnded = false;
+
+        // A streaming-index decoder streams the next container's index too
+        mIndexReadPos = -1;
+        mIndexRemaining = 0;
+
+        // Cached frames and payloads are keyed by this container's
+        // timestamps; return their governor charges along with them
+        mCacheList.clear();
+        mCacheMap.clear();
+        mWindow.clear();
+        MemoryGovernor::shared().release(MemoryGovernor::Subsystem::FRAME_CACHE, mCacheBytes);
+        mCacheBytes = 0;
+
+        mPayloadCacheList.clear();
+        mPayloadCacheMap.clear();
+        MemoryGovernor::shared().release(MemoryGovernor::Subsystem::PAYLOAD_CACHE, mPayloadCacheBytes);
+        mPayloadCacheBytes = 0;
+
+        // Checksum references belong to the old container; verification
+        // re-arms against the new one's references when re-enabled
+        mChecksums.clear();
+        mVerifyChecksums = false;
+
+        mPath = path;
+
+        // Retarget the reader in place where the backend can (a stdio
+        // reader re-points its existing stream and keeps its buffer);
+        // otherwise construct the same kind of reader over the new path
+        if(!mReader || !mReader->reopen(path))
+            mReader = createReader(path);
+
+        if(mIndexCacheEnabled && tryLoadIndexCache()) {
+            tuneBlockSize();
+        }
+        else {
+            init();
+
+            tuneBlockSize();
+
+            if(mIndexCacheEnabled) {
+                ensureFrameSizes();
+                writeIndexCache();
+            }
+        }
+
+        // Re-key the tuned profile: the new container may sit on a
+        // different mount
+        if(mAutoTune)
+            enableAutoTune();
+    }
+
+    Decoder::~Decoder() {
+        if(mScan)
+            endSequentialScan();
+
+        // Return what the caches were charged for
+        MemoryGovernor::shared().release(MemoryGovernor::Subsystem::FRAME_CACHE, mCacheBytes);
+        MemoryGovernor::shared().release(MemoryGovernor::Subsystem::PAYLOAD_CACHE, mPayloadCacheBytes);
+    }
+
+    void Decoder::init() {
+        Header header{};
+
+        // Check validity of file
+        read(&header, sizeof(Header));
+
+        // Support the page-aligned version 4 layout and also version 3
+        if((header.version != CONTAINER_VERSION) && (header.version != CONTAINER_VERSION_4))
+            throw IOException("Invalid container version");
+
+        mVersion = header.version;
+
+        if(std::memcmp(header.ident, CONTAINER_ID, sizeof(CONTAINER_ID)) != 0)
+            throw IOException("Invalid header id");
+
+        // Read camera metadata
+        Item metadataItem{};
+        read(&metadataItem, sizeof(Item));
+
+        if(metadataItem.type != Type::METADATA)
+            throw IOException("Invalid camera metadata");
+
+        mMetadataJsonBuffer.resize(metadataItem.size);
+        read(mMetadataJsonBuffer.data(), metadataItem.size);
+
+        // Parsing the camera metadata - often hundreds of KB of calibration
+        // data - is independent of the index, so it runs on a second thread
+        // overlapped with the index read and sort
+        auto parsedMetadata = std::async(std::launch::async, [this] {
+            STAT_TIMER(metadataStart);
+
+            auto parsed = nlohmann::json::parse(mMetadataJsonBuffer.begin(), mMetadataJsonBuffer.end());
+
+            STAT_TIMER_END(mStatOpenMetadataNanos, metadataStart);
+
+            return parsed;
+        });
+
+        try {
+            // Repacked containers place the frame and audio indexes right after
+            // the camera metadata, so open never has to touch the end of the file
+            STAT_TIMER(indexStart);
+
+            const bool leadingIndex = tryReadLeadingIndex(static_cast<int64_t>(sizeof(Header) + sizeof(Item) + metadataItem.size));
+
+            if(!leadingIndex)
+                readIndex();
+
+            STAT_TIMER_END(mStatOpenIndexNanos, indexStart);
+
+            STAT_TIMER(sortStart);
+
+            reindexOffsets();
+
+            STAT_TIMER_END(mStatOpenSortNanos, sortStart);
+
+            // The leading index carries the audio index, no walk needed;
+            // otherwise the walk is deferred to the first audio access -
+            // most opens never touch audio and skip the extra seeks entirely
+            if(leadingIndex)
+                mAudioIndexLoaded = true;
+        }
+        catch(...) {
+            parsedMetadata.wait();
+            throw;
+        }
+
+        // Rethrows a metadata parse failure, as the serial path did
+        mMetadata = parsedMetadata.get();
+
+        parseTypedMetadata();
+    }
+
+    void Decoder::ensureAudioIndex() const {
+        if(mAudioIndexLoaded)
+            return;
+
+        mAudioIndexLoaded = true;
+
+        STAT_TIMER(extraStart);
+
+        readExtra();
+
+        STAT_TIMER_END(mStatOpenExtraNanos, extraStart);
+    }
+
+    int64_t Decoder::findFrameIndex(const Timestamp timestamp) const {
+        // mFrameList is sorted by timestamp after reindexOffsets
+        auto it = std::lower_bound(mFrameList.begin(), mFrameList.end(), timestamp);
+
+        if(it == mFrameList.end() || *it != timestamp)
+            return -1;
+
+        return it - mFrameList.begin();
+    }
+
+    const std::vector<uint32_t>& Decoder::getFrameSizes() {
+        ensureFrameSizes();
+
+        return mPayloadSizes;
+    }
+
+    const std::vector<Timestamp>& Decoder::getFrames() const {
+        return mFrameList;
+    }
+
+    TimingReport Decoder::analyzeTiming() const {
+        TimingReport report;
+
+        report.numFrames = mFrameList.size();
+
+        if(mFrameList.size() < 2)
+            return report;
+
+        // Inter-frame intervals; the list is sorted, so deltas are
+        // non-negative and a zero marks a duplicate timestamp
+        std::vector<int64_t> deltas(mFrameList.size() - 1);
+
+        for(size_t i = 0; i + 1 < mFrameList.size(); i++)
+            deltas[i] = mFrameList[i + 1] - mFrameList[i];
+
+        // The median delta is the expected interval: robust against the
+        // gaps and duplicates it is about to measure
+        std::vector<int64_t> sorted(deltas);
+
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+
+        report.expectedIntervalNs = sorted[sorted.size() / 2];
+
+        if(report.expectedIntervalNs <= 0)
+            return report;
+
+        report.expectedFps = 1e9 / static_cast<double>(report.expectedIntervalNs);
+
+        // An interval half again past the expected one has swallowed at
+        // least one frame
+        const int64_t gapThreshold = report.expectedIntervalNs + report.expectedIntervalNs / 2;
+
+        size_t segmentStart = 0;
+
+        auto finishSegment = [&](size_t end) {
+            // end is one past the segment's last frame
+            TimingSegment segment;
+
+            segment.firstFrame = segmentStart;
+            segment.numFrames = end - segmentStart;
+
+            const int64_t span = mFrameList[end - 1] - mFrameList[segmentStart];
+
+            if(segment.numFrames > 1 && span > 0)
+                segment.fps = 1e9 * static_cast<double>(segment.numFrames - 1) / static_cast<double>(span);
+
+            report.segments.push_back(segment);
+            segmentStart = end;
+        };
+
+        for(size_t i = 0; i < deltas.size(); i++) {
+            const int64_t delta = deltas[i];
+
+            if(delta == 0) {
+                report.duplicates++;
+                continue;
+            }
+
+            if(delta > gapThreshold) {
+                TimingGap gap;
+
+                gap.frameIndex = i + 1;
+                gap.before = mFrameList[i];
+                gap.intervalNs = delta;
+                gap.droppedFrames = static_cast<int>(
+                    (delta + report.expectedIntervalNs / 2) / report.expectedIntervalNs) - 1;
+
+                report.droppedFrames += gap.droppedFrames;
+                report.gaps.push_back(gap);
+
+                finishSegment(i + 1);
+                continue;
+            }
+
+            // A regular interval; bucket its deviation from the target
+            const int64_t jitter = std::abs(delta - report.expectedIntervalNs);
+            const double fraction = static_cast<double>(jitter) / static_cast<double>(report.expectedIntervalNs);
+
+            size_t bucket = 0;
+
+            while(bucket < TimingReport::NUM_JITTER_BUCKETS - 1 && fraction > JITTER_BUCKET_EDGES[bucket])
+                bucket++;
+
+            report.jitterHistogram[bucket]++;
+            report.maxJitterNs = std::max(report.maxJitterNs, jitter);
+        }
+
+        finishSegment(mFrameList.size());
+
+        return report;
+    }
+
+    int64_t Decoder::findFrame(const Timestamp timestamp, SeekMode mode) const {
+        if(mFrameList.empty())
+            return -1;
+
+        auto it = std::lower_bound(mFrameList.begin(), mFrameList.end(), timestamp);
+        const int64_t index = it - mFrameList.begin();
+
+        switch(mode) {
+            case SeekMode::AFTER:
+                return it == mFrameList.end() ? -1 : index;
+
+            case SeekMode::BEFORE:
+                if(it != mFrameList.end() && *it == timestamp)
+                    return index;
+
+                return it == mFrameList.begin() ? -1 : index - 1;
+
+            case SeekMode::NEAREST:
+            default:
+                if(it == mFrameList.end())
+                    return index - 1;
+
+                if(it == mFrameList.begin())
+                    return 0;
+
+                // Pick the closer of the two neighbours
+                return (*it - timestamp) < (timestamp - *(it - 1)) ? index : index - 1;
+        }
+    }
+
+    bool Decoder::isFrameAvailable(const Timestamp timestamp) const {
+        if(!mAvailability)
+            return true;
+
+        auto it = std::lower_bound(mFrameList.begin(), mFrameList.end(), timestamp);
+
+        if(it == mFrameList.end() || *it != timestamp)
+            return false;
+
+        const auto range = frameByteRange(it - mFrameList.begin());
+
+        return mAvailability->available(range.first, range.second);
+    }
+
+    bool Decoder::waitForFrame(const Timestamp timestamp, int timeoutMs) const {
+        if(!mAvailability)
+            return true;
+
+        auto it = std::lower_bound(mFrameList.begin(), mFrameList.end(), timestamp);
+
+        if(it == mFrameList.end() || *it != timestamp)
+            return false;
+
+        const auto range = frameByteRange(it - mFrameList.begin());
+
+        return mAvailability->waitFor(range.first, range.second, timeoutMs);
+    }
+
+    void Decoder::loadFrameByIndex(size_t frameIndex, std::vector<uint16_t>& outData, nlohmann::json& outMetadata) {
+        if(frameIndex >= mFrameList.size())
+            throw IOException("Frame index out of range (" + std::to_string(frameIndex) + ")");
+
+        loadFrame(mFrameList[frameIndex], outData, outMetadata);
+    }
+
+    const nlohmann::json& Decoder::getContainerMetadata() const {
+        // A cached open defers this parse: the typed fields came from the
+        // sidecar's binary metadata block, so the JSON text is only parsed
+        // when somebody actually asks for the raw form
+        std::lock_guard<std::mutex> lock(mMetadataParseMutex);
+
+        if(!mMetadataJsonPending.empty()) {
+            auto parsed = nlohmann::json::parse(mMetadataJsonPending.begin(), mMetadataJsonPending.end(), nullptr, false);
+
+            if(!parsed.is_discarded())
+                mMetadata = std::move(parsed);
+
+            mMetadataJsonPending.clear();
+            mMetadataJsonPending.shrink_to_fit();
+        }
+
+        return mMetadata;
+    }
+
+    const ContainerMetadata& Decoder::getTypedContainerMetadata() const {
+        return mContainerMetadata;
+    }
+
+    int Decoder::audioSampleRateHz() const {
+        return mContainerMetadata.audioSampleRate;
+    }
+
+    int Decoder::numAudioChannels() const {
+        return mContainerMetadata.audioChannels;
+    }
+
+    int64_t Decoder::audioStartTimestampMs() const {
+        ensureAudioIndex();
+
+        return mAudioStartTimestampMs;
+    }
+
+    void Decoder::loadFramePayload(const Timestamp timestamp, std::vector<uint8_t>& outPayload, std::vector<uint8_t>& outMetadataJson) {
+        size_t compressedLen = 0;
+        outMetadataJson.clear();
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, outMetadataJson);
+
+        outPayload.assign(compressed, compressed + compressedLen);
+    }
+
+    void Decoder::decodeFramePayload(
+        const std::vector<uint8_t>& payload,
+        const std::vector<uint8_t>& metadataJson,
+        std::vector<uint16_t>& outData,
+        nlohmann::json& outMetadata) const
+    {
+        decodePayload(payload.data(), payload.size(), metadataJson, outData, outMetadata);
+    }
+
+    void Decoder::loadFrameSummary(const Timestamp timestamp, raw::FrameSummary& outSummary) {
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> metadataJson;
+
+        loadFramePayload(timestamp, payload, metadataJson);
+
+        size_t payloadLen = payload.size();
+        const uint8_t* data = unarchivePayload(payload.data(), payloadLen);
+
+        if(!raw::ComputeFrameSummary(data, payloadLen, outSummary))
+            throw IOException("Invalid frame payload");
+    }
+
+    FrameMetadataColumns Decoder::loadAllFrameMetadata(size_t numThreads) {
+        MOTIONCAM_TRACE_SCOPE("loadAllFrameMetadata");
+
+        FrameMetadataColumns out;
+
+        const size_t numFrames = mFrameList.size();
+
+        out.timestamps = mFrameList;
+        out.widths.assign(numFrames, 0);
+        out.heights.assign(numFrames, 0);
+        out.isos.assign(numFrames, 0);
+        out.exposureTimes.assign(numFrames, 0);
+        out.orientations.assign(numFrames, 0);
+        out.asShotNeutral.assign(numFrames, std::array<double, 3>{});
+
+        if(numFrames == 0)
+            return out;
+
+        // Makes every frame's metadata position exact: version 4 indexes
+        // carry the item sizes already, version 3 containers get them
+        // harvested once (and cached in the index sidecar)
+        ensureFrameSizes();
+
+        // Same pool policy as the batch loads: the process-wide shared pool
+        // by default, a private pool for an explicit numThreads
+        std::unique_ptr<ThreadPool> ownPool;
+
+        if(numThreads > 0)
+            ownPool.reset(new ThreadPool(numThreads));
+
+        ThreadPool& pool = ownPool ? *ownPool : ThreadPool::shared();
+        TaskGroup group;
+
+        std::mutex errorMutex;
+        std::exception_ptr firstError;
+
+        // Metadata items are a few hundred bytes each, so chunks can be much
+        // larger than the payload-carrying batch loads use without holding
+        // meaningful memory; larger batches keep the reads dense
+        const size_t chunkSize = std::max<size_t>(64, 8 * pool.numThreads());
+
+        for(size_t chunkStart = 0; chunkStart < numFrames; chunkStart += chunkSize) {
+            const size_t n = std::min(chunkSize, numFrames - chunkStart);
+
+            std::vector<std::shared_ptr<std::vector<uint8_t>>> metadataJson(n);
+            std::vector<ReadRequest> requests;
+
+            // The index gives both item sizes, so every frame's metadata
+            // arrives in a single exact-sized read and the payload bytes in
+            // between are never read at all
+            requests.reserve(n);
+
+            for(size_t i = 0; i < n; i++) {
+                const size_t index = chunkStart + i;
+
+                metadataJson[i] = std::make_shared<std::vector<uint8_t>>(mMetadataSizes[index]);
+
+                requests.push_back({
+                    mFrameOffsets[index] + 2*static_cast<int64_t>(sizeof(Item)) + mPayloadSizes[index],
+                    mMetadataSizes[index],
+                    metadataJson[i]->data() });
+            }
+
+            STAT_ADD(mStatNumSeeks, requests.size());
+
+            for(const auto& r : requests)
+                STAT_ADD(mStatBytesRead, r.len);
+
+            mReader->readBatch(requests);
+
+            // Parse the chunk on the workers while the next chunk reads.
+            // Every task writes only its own row, so the columns need no lock.
+            for(size_t i = 0; i < n; i++) {
+                const size_t row = chunkStart + i;
+                auto bytes = metadataJson[i];
+
+                group.run(pool, Priority::DECODE, [row, bytes, &out, &errorMutex, &firstError] {
+                    try {
+                        // The documents are flat, so the single-pass scanner
+                        // extracts every column without building a DOM; only
+                        // an unexpected shape pays for the full parser
+                        ScannedFrameMetadata scanned;
+
+                        if(scanFrameMetadata(*bytes, scanned)) {
+                            out.widths[row] = static_cast<int>(std::max(0L, scanned.width));
+                            out.heights[row] = static_cast<int>(std::max(0L, scanned.height));
+                            out.isos[row] = static_cast<int>(scanned.iso);
+                            out.exposureTimes[row] = scanned.exposureTime;
+                            out.orientations[row] = static_cast<int>(scanned.orientation);
+
+                            if(scanned.hasAsShotNeutral)
+                                for(size_t c = 0; c < 3; c++)
+                                    out.asShotNeutral[row][c] = scanned.asShotNeutral[c];
+
+                            return;
+                        }
+
+                        const nlohmann::json metadata = nlohmann::json::parse(bytes->begin(), bytes->end());
+
+                        out.widths[row] = metadata.value("width", 0);
+                        out.heights[row] = metadata.value("height", 0);
+                        out.isos[row] = metadata.value("iso", 0);
+                        out.exposureTimes[row] = metadata.value("exposureTime", static_cast<int64_t>(0));
+                        out.orientations[row] = metadata.value("orientation", 0);
+
+                        auto it = metadata.find("asShotNeutral");
+
+                        if(it != metadata.end() && it->is_array() && it->size() == 3)
+                            for(size_t c = 0; c < 3; c++)
+                                out.asShotNeutral[row][c] = (*it)[c];
+                    }
+                    catch(...) {
+                        std::unique_lock<std::mutex> lock(errorMutex);
+
+                        if(!firstError)
+                            firstError = std::current_exception();
+                    }
+                });
+            }
+        }
+
+        group.wait();
+
+        if(firstError)
+            std::rethrow_exception(firstError);
+
+        return out;
+    }
+
+    void Decoder::parseTypedMetadata() {
+        mContainerMetadata = ContainerMetadata{};
+
+        // Copy a fixed-size numeric array field, leaving the default in place
+        // when the field is missing or the wrong shape
+        auto copyArray = [this](const char* key, auto& dst) {
+            auto it = mMetadata.find(key);
+
+            if(it == mMetadata.end() || !it->is_array() || it->size() != dst.size())
+                return;
+
+            for(size_t i = 0; i < dst.size(); i++)
+                dst[i] = (*it)[i];
+        };
+
+        auto extraData = mMetadata.find("extraData");
+
+        if(extraData != mMetadata.end()) {
+            mContainerMetadata.audioSampleRate = extraData->value("audioSampleRate", 0);
+            mContainerMetadata.audioChannels = extraData->value("audioChannels", 0);
+        }
+
+        copyArray("blackLevel", mContainerMetadata.blackLevel);
+        copyArray("colorMatrix1", mContainerMetadata.colorMatrix1);
+        copyArray("colorMatrix2", mContainerMetadata.colorMatrix2);
+        copyArray("forwardMatrix1", mContainerMetadata.forwardMatrix1);
+        copyArray("forwardMatrix2", mContainerMetadata.forwardMatrix2);
+
+        mContainerMetadata.whiteLevel = mMetadata.value("whiteLevel", 0.0);
+
+        mContainerMetadata.archiveCodec = mMetadata.value("archiveCodec", 0);
+
+        const std::string sensorArrangement = mMetadata.value("sensorArrangment", "");
+
+        if(sensorArrangement == "rggb")
+            mContainerMetadata.sensorArrangement = ColorFilterArrangement::RGGB;
+        else if(sensorArrangement == "bggr")
+            mContainerMetadata.sensorArrangement = ColorFilterArrangement::BGGR;
+        else if(sensorArrangement == "grbg")
+            mContainerMetadata.sensorArrangement = ColorFilterArrangement::GRBG;
+        else if(sensorArrangement == "gbrg")
+            mContainerMetadata.sensorArrangement = ColorFilterArrangement::GBRG;
+    }
+
+    //
+    // FrameStream
+    //
+
+    FrameStream::FrameStream(Decoder& decoder, size_t readAhead) : mDecoder(decoder) {
+        mDecoder.beginSequentialScan(readAhead);
+
+        // Kick off the decode of the first frame right away
+        mPending = true;
+        mWorker = std::thread(&FrameStream::workerLoop, this);
+    }
+
+    FrameStream::~FrameStream() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+
+        mCond.notify_all();
+        mWorker.join();
+
+        mDecoder.endSequentialScan();
+    }
+
+    void FrameStream::workerLoop() {
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+
+                mCond.wait(lock, [this] { return mPending || mStop; });
+
+                if(mStop)
+                    return;
+
+                mPending = false;
+            }
+
+            bool ok = false;
+            std::exception_ptr error;
+
+            try {
+                ok = mDecoder.nextFrame(mBack.timestamp, mBack.data, mBack.metadata);
+            }
+            catch(...) {
+                error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                mBackOk = ok;
+                mError = error;
+                mReady = true;
+            }
+
+            mCond.notify_all();
+        }
+    }
+
+    bool FrameStream::advance() {
+        if(mFinished)
+            return false;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        mCond.wait(lock, [this] { return mReady; });
+        mReady = false;
+
+        if(mError) {
+            mFinished = true;
+            std::rethrow_exception(mError);
+        }
+
+        if(!mBackOk) {
+            mFinished = true;
+            return false;
+        }
+
+        // Hand the decoded frame to the consumer and decode the next one
+        // into the buffer it just released
+        std::swap(mFront, mBack);
+
+        mPending = true;
+        lock.unlock();
+        mCond.notify_all();
+
+        return true;
+    }
+
+    FrameStream::Frame& FrameStream::iterator::operator*() const {
+        return mStream->mFront;
+    }
+
+    FrameStream::Frame* FrameStream::iterator::operator->() const {
+        return &mStream->mFront;
+    }
+
+    FrameStream::iterator& FrameStream::iterator::operator++() {
+        mAtEnd = !mStream->advance();
+
+        return *this;
+    }
+
+    bool FrameStream::iterator::operator!=(const iterator& other) const {
+        return mAtEnd != other.mAtEnd;
+    }
+
+    FrameStream::iterator FrameStream::begin() {
+        return iterator(this, !advance());
+    }
+
+    FrameStream::iterator FrameStream::end() {
+        return iterator(this, true);
+    }
+
+    FrameStream Decoder::stream(size_t readAhead) {
+        return FrameStream(*this, readAhead);
+    }
+
+    void Decoder::loadAudio(std::vector<AudioChunk>& outAudioChunks) {
+        ensureAudioIndex();
+
+        // The chunk count is known from the index, so the outer vector is
+        // sized once up front instead of growing chunk by chunk
+        outAudioChunks.reserve(outAudioChunks.size() + mAudioOffsets.size());
+
+        visitAudio([&outAudioChunks](Timestamp timestamp, const int16_t* samples, size_t numSamples) {
+            outAudioChunks.push_back(std::make_pair(timestamp, std::vector<int16_t>(samples, samples + numSamples)));
+        });
+    }
+
+    // Upper bound on the track's payload bytes from the indexes alone: a
+    // chunk extends at most to the next indexed item - the next audio
+    // chunk when the audio sits consecutively, the next frame when the
+    // recorder interleaved them - and the end of the file bounds the last.
+    // Overshoots only by the per-chunk item headers and timestamp
+    // metadata, a fraction of a percent of the track.
+    size_t Decoder::audioByteBound(const std::vector<BufferOffset>& sortedOffsets) {
+        if(mFileSize < 0)
+            mFileSize = mReader->size();
+
+        std::vector<int64_t> frameOffsets(mFrameOffsets);
+
+        std::sort(frameOffsets.begin(), frameOffsets.end());
+
+        size_t bound = 0;
+
+        for(size_t i = 0; i < sortedOffsets.size(); i++) {
+            int64_t end = i + 1 < sortedOffsets.size() ? sortedOffsets[i + 1].offset : mFileSize;
+
+            auto nextFrame = std::upper_bound(frameOffsets.begin(), frameOffsets.end(), sortedOffsets[i].offset);
+
+            if(nextFrame != frameOffsets.end() && *nextFrame < end)
+                end = *nextFrame;
+
+            const int64_t extent = end - sortedOffsets[i].offset;
+
+            if(extent > static_cast<int64_t>(sizeof(Item)))
+                bound += static_cast<size_t>(extent) - sizeof(Item);
+        }
+
+        return bound;
+    }
+
+    void Decoder::loadAudio(std::vector<int16_t>& outSamples) {
+        outSamples.clear();
+
+        ensureAudioIndex();
+
+        if(mAudioOffsets.empty())
+            return;
+
+        auto offsets = mAudioOffsets;
+
+        std::sort(offsets.begin(), offsets.end(), [](const BufferOffset& a, const BufferOffset& b) {
+            return a.offset < b.offset;
+        });
+
+        // One allocation at the index-derived bound; chunks land in slices
+        // of it and the final resize trims the header overshoot
+        outSamples.resize((audioByteBound(offsets) + 1) / 2);
+
+        size_t position = 0;
+
+        visitAudioSpan(offsets, [&outSamples, &position](Timestamp, const int16_t* samples, size_t numSamples) {
+            // Only reachable when the file size was unavailable to bound
+            // the last chunk
+            if(position + numSamples > outSamples.size())
+                outSamples.resize(std::max(position + numSamples, 2 * outSamples.size()));
+
+            std::memcpy(outSamples.data() + position, samples, sizeof(int16_t) * numSamples);
+            position += numSamples;
+        });
+
+        outSamples.resize(position);
+    }
+
+    void Decoder::ensureAudioTimestamps() {
+        if(mAudioTimestampsIndexed)
+            return;
+
+        // Pull every chunk's AudioMetadata timestamp into the index with
+        // header-only reads; the sample data itself is never touched. Done
+        // once, on the first ranged audio access.
+        for(auto& chunk : mAudioOffsets) {
+            chunk.timestamp = -1;
+
+            if(!seek(chunk.offset, SEEK_SET))
+                throw IOException("Invalid audio data");
+
+            Item audioDataItem{};
+            read(&audioDataItem, sizeof(Item));
+
+            if(audioDataItem.type != Type::AUDIO_DATA)
+                throw IOException("Invalid audio data");
+
+            if(!seek(audioDataItem.size, SEEK_CUR))
+                throw IOException("Invalid audio data");
+
+            Item audioMetadataItem{};
+
+            // Chunks predating the timestamp metadata keep -1
+            if(mReader->tryRead(&audioMetadataItem, sizeof(Item))
+                && audioMetadataItem.type == Type::AUDIO_DATA_METADATA)
+            {
+                AudioMetadata metadata{};
+
+                read(&metadata, sizeof(AudioMetadata));
+                chunk.timestamp = metadata.timestampNs;
+            }
+        }
+
+        // Untimestamped chunks sort to the front, where the range search
+        // skips them
+        std::sort(mAudioOffsets.begin(), mAudioOffsets.end(), [](const BufferOffset& a, const BufferOffset& b) {
+            return a.timestamp < b.timestamp;
+        });
+
+        mAudioTimestampsIndexed = true;
+    }
+
+    void Decoder::ensureAudioAlignment() {
+        if(mAudioAlignmentBuilt)
+            return;
+
+        ensureAudioIndex();
+
+        mAudioAlignmentBuilt = true;
+
+        if(mAudioOffsets.empty())
+            return;
+
+        // Walk the chunk headers in file order, accumulating frame counts
+        // from the chunk sizes; the sample data is never read
+        auto offsets = mAudioOffsets;
+
+        std::sort(offsets.begin(), offsets.end(), [](const BufferOffset& a, const BufferOffset& b) {
+            return a.offset < b.offset;
+        });
+
+        const int channels = std::max(1, numAudioChannels());
+
+        int64_t position = 0;
+
+        for(const auto& chunk : offsets) {
+            if(!seek(chunk.offset, SEEK_SET))
+                throw IOException("Invalid audio data");
+
+            Item audioDataItem{};
+            read(&audioDataItem, sizeof(Item));
+
+            if(audioDataItem.type != Type::AUDIO_DATA)
+                throw IOException("Invalid audio data");
+
+            if(!seek(audioDataItem.size, SEEK_CUR))
+                throw IOException("Invalid audio data");
+
+            Item audioMetadataItem{};
+
+            // Chunks predating the timestamp metadata contribute samples
+            // but can't anchor a lookup
+            if(mReader->tryRead(&audioMetadataItem, sizeof(Item))
+                && audioMetadataItem.type == Type::AUDIO_DATA_METADATA)
+            {
+                AudioMetadata metadata{};
+
+                read(&metadata, sizeof(AudioMetadata));
+
+                mAudioAlignment.emplace_back(metadata.timestampNs, position);
+            }
+
+            position += static_cast<int64_t>(audioDataItem.size / 2) / channels;
+        }
+
+        mAudioTotalFrames = position;
+
+        std::sort(mAudioAlignment.begin(), mAudioAlignment.end());
+    }
+
+    int64_t Decoder::audioPositionForFrame(const Timestamp timestamp) {
+        ensureAudioAlignment();
+
+        const int sampleRate = audioSampleRateHz();
+
+        if(mAudioAlignment.empty() || sampleRate <= 0)
+            return -1;
+
+        // Latest chunk starting at or before the frame; a frame ahead of
+        // the first chunk extrapolates backwards from it
+        auto it = std::upper_bound(mAudioAlignment.begin(), mAudioAlignment.end(),
+            std::make_pair(timestamp, std::numeric_limits<int64_t>::max()));
+
+        const auto& anchor = it == mAudioAlignment.begin() ? *it : *(it - 1);
+
+        const int64_t elapsed = timestamp - anchor.first;
+        const int64_t position = anchor.second + (elapsed * sampleRate) / 1000000000;
+
+        return std::max<int64_t>(0, std::min(position, mAudioTotalFrames));
+    }
+
+    void Decoder::loadAudioRange(const Timestamp startNs, const Timestamp endNs, std::vector<AudioChunk>& outAudioChunks) {
+        outAudioChunks.clear();
+
+        ensureAudioIndex();
+
+        if(mAudioOffsets.empty() || endNs < startNs)
+            return;
+
+        ensureAudioTimestamps();
+
+        // First chunk strictly past startNs; the one before it overlaps the
+        // start of the range when it exists and carries a timestamp
+        auto first = std::upper_bound(mAudioOffsets.begin(), mAudioOffsets.end(), startNs,
+            [](const Timestamp t, const BufferOffset& b) { return t < b.timestamp; });
+
+        if(first != mAudioOffsets.begin() && (first - 1)->timestamp >= 0)
+            --first;
+
+        while(first != mAudioOffsets.end() && first->timestamp < 0)
+            ++first;
+
+        auto last = std::upper_bound(first, mAudioOffsets.end(), endNs,
+            [](const Timestamp t, const BufferOffset& b) { return t < b.timestamp; });
+
+        std::vector<BufferOffset> span(first, last);
+
+        std::sort(span.begin(), span.end(), [](const BufferOffset& a, const BufferOffset& b) {
+            return a.offset < b.offset;
+        });
+
+        visitAudioSpan(span, [&outAudioChunks](Timestamp timestamp, const int16_t* samples, size_t numSamples) {
+            outAudioChunks.push_back(std::make_pair(timestamp, std::vector<int16_t>(samples, samples + numSamples)));
+        });
+    }
+
+    void Decoder::visitAudio(const AudioCallback& callback) {
+        ensureAudioIndex();
+
+        auto offsets = mAudioOffsets;
+
+        std::sort(offsets.begin(), offsets.end(), [](const BufferOffset& a, const BufferOffset& b) {
+            return a.offset < b.offset;
+        });
+
+        visitAudioSpan(offsets, callback);
+    }
+
+    void Decoder::visitAudioFloat(const AudioFloatCallback& callback) {
+        std::vector<float> converted;
+
+        visitAudio([&](Timestamp timestamp, const int16_t* samples, size_t numSamples) {
+            converted.resize(numSamples);
+
+            convertAudioToFloat(samples, numSamples, converted.data());
+
+            callback(timestamp, converted.data(), numSamples);
+        });
+    }
+
+    void Decoder::loadAudioFloat(int outputSampleRateHz, std::vector<float>& outSamples) {
+        outSamples.clear();
+
+        const int inputRate = audioSampleRateHz();
+
+        if(outputSampleRateHz <= 0 || inputRate <= 0 || outputSampleRateHz == inputRate) {
+            ensureAudioIndex();
+
+            // The index bounds the track, so the float buffer is reserved
+            // once instead of doubling its way up through the appends
+            auto offsets = mAudioOffsets;
+
+            std::sort(offsets.begin(), offsets.end(), [](const BufferOffset& a, const BufferOffset& b) {
+                return a.offset < b.offset;
+            });
+
+            outSamples.reserve((audioByteBound(offsets) + 1) / 2);
+
+            visitAudioFloat([&](Timestamp, const float* samples, size_t numSamples) {
+                outSamples.insert(outSamples.end(), samples, samples + numSamples);
+            });
+
+            return;
+        }
+
+        AudioResampler resampler(inputRate, outputSampleRateHz, std::max(1, numAudioChannels()));
+
+        visitAudioFloat([&](Timestamp, const float* samples, size_t numSamples) {
+            resampler.process(samples, numSamples, outSamples);
+        });
+
+        resampler.finish(outSamples);
+    }
+
+    const AudioOverview& Decoder::getAudioOverview() {
+        if(mAudioOverviewLoaded)
+            return mAudioOverview;
+
+        mAudioOverview = AudioOverview{};
+
+        // State of the bucket being filled; chunk boundaries do not align
+        // with bucket boundaries, so it carries across callbacks
+        size_t fill = 0;
+        int bucketMin = 32767;
+        int bucketMax = -32768;
+        uint64_t sumSquares = 0;
+
+        auto finishBucket = [&]() {
+            mAudioOverview.minValue.push_back(static_cast<int16_t>(bucketMin));
+            mAudioOverview.maxValue.push_back(static_cast<int16_t>(bucketMax));
+            mAudioOverview.rms.push_back(static_cast<uint16_t>(
+                std::lround(std::sqrt(static_cast<double>(sumSquares) / fill))));
+
+            fill = 0;
+            bucketMin = 32767;
+            bucketMax = -32768;
+            sumSquares = 0;
+        };
+
+        visitAudio([&](Timestamp, const int16_t* samples, size_t numSamples) {
+            size_t i = 0;
+
+            while(i < numSamples) {
+                const size_t run = std::min(AUDIO_OVERVIEW_BUCKET_SIZE - fill, numSamples - i);
+                const size_t groups = run / 8;
+
+                if(groups > 0) {
+                    const simde__m128i zero = simde_mm_setzero_si128();
+
+                    simde__m128i vmin = simde_mm_set1_epi16(32767);
+                    simde__m128i vmax = simde_mm_set1_epi16(-32768);
+                    simde__m128i vsum = zero;   // two uint64 lanes
+
+                    for(size_t g = 0; g < groups; g++) {
+                        const simde__m128i v = simde_mm_loadu_si128(
+                            reinterpret_cast<const simde__m128i*>(samples + i + g*8));
+
+                        vmin = simde_mm_min_epi16(vmin, v);
+                        vmax = simde_mm_max_epi16(vmax, v);
+
+                        // Each madd lane sums two squares, at most 2^31, so
+                        // widening with a zero half reads it as unsigned
+                        const simde__m128i squares = simde_mm_madd_epi16(v, v);
+
+                        vsum = simde_mm_add_epi64(vsum, simde_mm_unpacklo_epi32(squares, zero));
+                        vsum = simde_mm_add_epi64(vsum, simde_mm_unpackhi_epi32(squares, zero));
+                    }
+
+                    int16_t minLanes[8], maxLanes[8];
+                    uint64_t sumLanes[2];
+
+                    simde_mm_storeu_si128(reinterpret_cast<simde__m128i*>(minLanes), vmin);
+                    simde_mm_storeu_si128(reinterpret_cast<simde__m128i*>(maxLanes), vmax);
+                    simde_mm_storeu_si128(reinterpret_cast<simde__m128i*>(sumLanes), vsum);
+
+                    for(int lane = 0; lane < 8; lane++) {
+                        bucketMin = std::min<int>(bucketMin, minLanes[lane]);
+                        bucketMax = std::max<int>(bucketMax, maxLanes[lane]);
+                    }
+
+                    sumSquares += sumLanes[0] + sumLanes[1];
+                }
+
+                for(size_t s = groups*8; s < run; s++) {
+                    const int x = samples[i + s];
+
+                    bucketMin = std::min(bucketMin, x);
+                    bucketMax = std::max(bucketMax, x);
+                    sumSquares += static_cast<uint64_t>(static_cast<int64_t>(x) * x);
+                }
+
+                fill += run;
+                i += run;
+
+                if(fill == AUDIO_OVERVIEW_BUCKET_SIZE)
+                    finishBucket();
+            }
+        });
+
+        // A trailing partial bucket still gets an entry
+        if(fill > 0)
+            finishBucket();
+
+        mAudioOverviewLoaded = true;
+
+        // Rewrite the sidecar so the next open reads the overview instead
+        // of the audio track; best effort, like the rest of the cache
+        if(mIndexCacheEnabled)
+            writeIndexCache();
+
+        return mAudioOverview;
+    }
+
+    void Decoder::visitSequential(const FrameCallback& frameCallback, const AudioCallback& audioCallback) {
+        MOTIONCAM_TRACE_SCOPE("visitSequential");
+
+        ensureAudioIndex();
+
+        // Merge the frame and audio indexes into file order
+        struct Entry {
+            int64_t offset;
+            Timestamp timestamp;
+            bool audio;
+        };
+
+        std::vector<Entry> entries;
+        entries.reserve(mFrameList.size() + mAudioOffsets.size());
+
+        for(size_t i = 0; i < mFrameList.size(); i++)
+            entries.push_back({ mFrameOffsets[i], mFrameList[i], false });
+
+        for(const auto& x : mAudioOffsets)
+            entries.push_back({ x.offset, x.timestamp, true });
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.offset < b.offset;
+        });
+
+        // Walk the merged list front to back. Runs of adjacent audio chunks
+        // go through visitAudioSpan, which coalesces them into large reads;
+        // frames decode in place between the runs, so the file position only
+        // ever moves forward.
+        std::vector<BufferOffset> audioRun;
+
+        auto flushAudio = [&] {
+            if(audioRun.empty())
+                return;
+
+            visitAudioSpan(audioRun, audioCallback);
+            audioRun.clear();
+        };
+
+        for(const auto& entry : entries) {
+            if(entry.audio) {
+                audioRun.push_back({ entry.offset, entry.timestamp });
+                continue;
+            }
+
+            flushAudio();
+
+            std::vector<uint16_t> data;
+            nlohmann::json metadata;
+
+            loadFrame(entry.timestamp, data, metadata);
+            frameCallback(entry.timestamp, std::move(data), std::move(metadata));
+        }
+
+        flushAudio();
+    }
+
+    void Decoder::visitAudioSpan(const std::vector<BufferOffset>& offsets, const AudioCallback& callback) {
+        if(offsets.empty())
+            return;
+
+        // One scratch buffer reused for every chunk keeps the walk at
+        // constant memory no matter how long the recording is
+        std::vector<int16_t> samples;
+
+        // Audio chunks sit consecutively after the last frame, so instead of
+        // paying a seek per chunk we coalesce runs of adjacent chunks into
+        // large sequential reads and parse the chunk boundaries in memory.
+        // The extent of every chunk but the last is the distance to its
+        // neighbour; the last chunk has no neighbour and is read directly.
+        constexpr int64_t READ_SPAN = 4 * 1024 * 1024;
+
+        std::vector<uint8_t> buffer;
+        int64_t filePos = -1; // current read position, -1 forces the initial seek
+
+        size_t i = 0;
+
+        while(i + 1 < offsets.size()) {
+            // Extend the run while chunks stay in order and the span is small
+            size_t j = i + 1;
+
+            while(j + 1 < offsets.size()
+                && offsets[j + 1].offset > offsets[j].offset
+                && offsets[j + 1].offset - offsets[i].offset <= READ_SPAN)
+            {
+                j++;
+            }
+
+            const int64_t base = offsets[i].offset;
+            const size_t extent = offsets[j].offset - base;
+
+            if(filePos != base) {
+                if(!seek(base, SEEK_SET))
+                    return;
+            }
+
+            buffer.resize(extent);
+            read(buffer.data(), extent);
+            filePos = base + extent;
+
+            dropBehind(filePos);
+
+            // Parse the chunks out of the buffer
+            for(size_t k = i; k < j; k++) {
+                const size_t chunkOffset = offsets[k].offset - base;
+                const size_t chunkEnd = (k + 1 < j ? offsets[k + 1].offset : offsets[j].offset) - base;
+
+                if(chunkOffset + sizeof(Item) > chunkEnd)
+                    throw IOException("Invalid audio data");
+
+                Item audioDataItem{};
+                std::memcpy(&audioDataItem, buffer.data() + chunkOffset, sizeof(Item));
+
+                if(audioDataItem.type != Type::AUDIO_DATA)
+                    throw IOException("Invalid audio data");
+
+                if(chunkOffset + sizeof(Item) + audioDataItem.size > chunkEnd)
+                    throw IOException("Invalid audio data");
+
+                samples.resize((audioDataItem.size + 1) / 2);
+                std::memcpy(samples.data(), buffer.data() + chunkOffset + sizeof(Item), audioDataItem.size);
+
+                // Metadata should follow (this was added later so some files may not have it)
+                Timestamp audioTimestamp = -1;
+                const size_t metadataOffset = chunkOffset + sizeof(Item) + audioDataItem.size;
+
+                if(metadataOffset + sizeof(Item) + sizeof(AudioMetadata) <= chunkEnd) {
+                    Item audioMetadataItem{};
+                    std::memcpy(&audioMetadataItem, buffer.data() + metadataOffset, sizeof(Item));
+
+                    if(audioMetadataItem.type == Type::AUDIO_DATA_METADATA) {
+                        AudioMetadata metadata;
+
+                        std::memcpy(&metadata, buffer.data() + metadataOffset + sizeof(Item), sizeof(AudioMetadata));
+                        audioTimestamp = metadata.timestampNs;
+                    }
+                }
+
+                callback(audioTimestamp, samples.data(), samples.size());
+            }
+
+            i = j;
+        }
+
+        // The last chunk's extent is unknown, read it through the headers
+        if(filePos != offsets[i].offset) {
+            if(!seek(offsets[i].offset, SEEK_SET))
+                return;
+        }
+
+        Item audioDataItem{};
+        read(&audioDataItem, sizeof(Item));
+
+        if(audioDataItem.type != Type::AUDIO_DATA)
+            throw IOException("Invalid audio data");
+
+        samples.resize((audioDataItem.size + 1) / 2);
+        read((void*)samples.data(), audioDataItem.size);
+
+        Timestamp audioTimestamp = -1;
+        Item audioMetadataItem{};
+
+        if(mReader->tryRead(&audioMetadataItem, sizeof(Item))
+            && audioMetadataItem.type == Type::AUDIO_DATA_METADATA)
+        {
+            AudioMetadata metadata;
+
+            read(&metadata, sizeof(AudioMetadata));
+            audioTimestamp = metadata.timestampNs;
+        }
+
+        dropBehind(offsets[i].offset + static_cast<int64_t>(sizeof(Item) + audioDataItem.size));
+
+        callback(audioTimestamp, samples.data(), samples.size());
+    }
+
+    const uint8_t* Decoder::readFramePayload(const Timestamp timestamp, size_t& outCompressedLen, std::vector<uint8_t>& outMetadataJson) {
+        MOTIONCAM_TRACE_SCOPE("readFramePayload");
+
+        if(mPayloadCacheBudget == 0 && mPayloadSpillDir.empty()) {
+            const uint8_t* compressed = readFramePayloadUncached(timestamp, outCompressedLen, outMetadataJson);
+
+            if(mVerifyChecksums)
+                verifyPayload(timestamp, compressed, outCompressedLen);
+
+            return compressed;
+        }
+
+        auto it = mPayloadCacheMap.find(timestamp);
+
+        if(it != mPayloadCacheMap.end()) {
+            // Hit, mark as most recently used
+            mPayloadCacheList.splice(mPayloadCacheList.begin(), mPayloadCacheList, it->second);
+
+            const CachedPayload& entry = mPayloadCacheList.front().second;
+
+            outMetadataJson = entry.metadataJson;
+            outCompressedLen = entry.payload.size();
+
+            return entry.payload.data();
+        }
+
+        CachedPayload entry;
+
+        if(loadSpilledPayload(timestamp, entry)) {
+            outMetadataJson = entry.metadataJson;
+            outCompressedLen = entry.payload.size();
+        }
+        else {
+            const uint8_t* compressed = readFramePayloadUncached(timestamp, outCompressedLen, outMetadataJson);
+
+            // Checked as read from the container; cache hits and spilled
+            // copies were already verified on their way in
+            if(mVerifyChecksums)
+                verifyPayload(timestamp, compressed, outCompressedLen);
+
+            entry.payload.assign(compressed, compressed + outCompressedLen);
+            entry.metadataJson = outMetadataJson;
+        }
+
+        return insertPayload(timestamp, std::move(entry));
+    }
+
+    const uint8_t* Decoder::insertPayload(const Timestamp timestamp, CachedPayload entry) {
+        const size_t entryBytes = entry.payload.size() + entry.metadataJson.size();
+
+        if(mPayloadCacheBudget < entryBytes) {
+            // Too large to cache (or spill-only mode); serve it from the
+            // scratch buffer and spill so a later pass still avoids storage
+            spillPayload(timestamp, entry);
+
+            mTmpBuffer.assign(entry.payload.begin(), entry.payload.end());
+
+            return mTmpBuffer.data();
+        }
+
+        mPayloadCacheList.emplace_front(timestamp, std::move(entry));
+        mPayloadCacheMap.emplace(timestamp, mPayloadCacheList.begin());
+        mPayloadCacheBytes += entryBytes;
+
+        MemoryGovernor::shared().charge(MemoryGovernor::Subsystem::PAYLOAD_CACHE, entryBytes);
+
+        // The global governor can ask for more than the local budget; the
+        // decoder is single threaded, so the insert is its trim point
+        while((mPayloadCacheBytes > mPayloadCacheBudget
+            || MemoryGovernor::shared().overTarget(MemoryGovernor::Subsystem::PAYLOAD_CACHE))
+            && mPayloadCacheList.size() > 1)
+        {
+            const auto& evicted = mPayloadCacheList.back();
+
+            spillPayload(evicted.first, evicted.second);
+
+            const size_t evictedBytes = evicted.second.payload.size() + evicted.second.metadataJson.size();
+
+            mPayloadCacheBytes -= evictedBytes;
+            mPayloadCacheMap.erase(evicted.first);
+            mPayloadCacheList.pop_back();
+
+            MemoryGovernor::shared().release(MemoryGovernor::Subsystem::PAYLOAD_CACHE, evictedBytes);
+        }
+
+        return mPayloadCacheList.front().second.payload.data();
+    }
+
+    void Decoder::setPayloadCacheBudget(size_t bytes) {
+        mPayloadCacheBudget = bytes;
+
+        // Evict until the cache fits the new budget
+        while(mPayloadCacheBytes > mPayloadCacheBudget && !mPayloadCacheList.empty()) {
+            const auto& evicted = mPayloadCacheList.back();
+
+            spillPayload(evicted.first, evicted.second);
+
+            const size_t evictedBytes = evicted.second.payload.size() + evicted.second.metadataJson.size();
+
+            mPayloadCacheBytes -= evictedBytes;
+            mPayloadCacheMap.erase(evicted.first);
+            mPayloadCacheList.pop_back();
+
+            MemoryGovernor::shared().release(MemoryGovernor::Subsystem::PAYLOAD_CACHE, evictedBytes);
+        }
+    }
+
+    void Decoder::setPayloadCacheSpillDirectory(const std::string& path) {
+        mPayloadSpillDir = path;
+    }
+
+    std::string Decoder::spillPath(const Timestamp timestamp) const {
+        return mPayloadSpillDir + "/" + std::to_string(timestamp) + ".mcpay";
+    }
+
+    void Decoder::spillPayload(const Timestamp timestamp, const CachedPayload& entry) const {
+        if(mPayloadSpillDir.empty())
+            return;
+
+        FILE* file = std::fopen(spillPath(timestamp).c_str(), "wb");
+        if(!file)
+            return;
+
+        const uint32_t payloadSize = static_cast<uint32_t>(entry.payload.size());
+        const uint32_t metadataSize = static_cast<uint32_t>(entry.metadataJson.size());
+
+        bool ok =
+            std::fwrite(&payloadSize, sizeof(payloadSize), 1, file) == 1 &&
+            std::fwrite(&metadataSize, sizeof(metadataSize), 1, file) == 1 &&
+            std::fwrite(entry.payload.data(), 1, payloadSize, file) == payloadSize &&
+            std::fwrite(entry.metadataJson.data(), 1, metadataSize, file) == metadataSize;
+
+        std::fclose(file);
+
+        // A failed spill only costs a storage re-read later
+        if(!ok)
+            std::remove(spillPath(timestamp).c_str());
+    }
+
+    bool Decoder::loadSpilledPayload(const Timestamp timestamp, CachedPayload& outEntry) const {
+        if(mPayloadSpillDir.empty())
+            return false;
+
+        FILE* file = std::fopen(spillPath(timestamp).c_str(), "rb");
+        if(!file)
+            return false;
+
+        uint32_t payloadSize = 0;
+        uint32_t metadataSize = 0;
+
+        bool ok =
+            std::fread(&payloadSize, sizeof(payloadSize), 1, file) == 1 &&
+            std::fread(&metadataSize, sizeof(metadataSize), 1, file) == 1;
+
+        if(ok) {
+            outEntry.payload.resize(payloadSize);
+            outEntry.metadataJson.resize(metadataSize);
+
+            ok = std::fread(outEntry.payload.data(), 1, payloadSize, file) == payloadSize &&
+                 std::fread(outEntry.metadataJson.data(), 1, metadataSize, file) == metadataSize;
+        }
+
+        std::fclose(file);
+
+        return ok;
+    }
+
+    void Decoder::enableDropBehind(size_t windowBytes) {
+        mDropBehind = true;
+        mDropBehindWindow = std::max<size_t>(windowBytes, 4096);
+    }
+
+    // Advise consumed byte ranges out of the page cache once they fall a
+    // full window behind the furthest read, batching the advisory calls to
+    // about one per window of progress. Tolerates out-of-order loads: only
+    // the high-water mark moves the drop point, so a late read behind it
+    // at worst repopulates pages that are dropped again on the next call.
+    void Decoder::dropBehind(int64_t consumedEnd) {
+        if(!mDropBehind)
+            return;
+
+        mScanHighWater = std::max(mScanHighWater, consumedEnd);
+
+        const int64_t dropTo = mScanHighWater - static_cast<int64_t>(mDropBehindWindow);
+
+        if(dropTo - mDroppedTo < static_cast<int64_t>(mDropBehindWindow))
+            return;
+
+        mReader->advise(mDroppedTo, static_cast<size_t>(dropTo - mDroppedTo), Advice::DONT_NEED);
+        mDroppedTo = dropTo;
+    }
+
+    const uint8_t* Decoder::readFramePayloadUncached(const Timestamp timestamp, size_t& outCompressedLen, std::vector<uint8_t>& outMetadataJson) {
+        const int64_t frameIndex = findFrameIndex(timestamp);
+
+        if(frameIndex < 0)
+            throw IOException("Frame not found (timestamp: " + std::to_string(timestamp) + ")");
+
+        int64_t offset = mFrameOffsets[frameIndex];
+
+        // Version 4 indexes carry the sizes, so the frame is fetched with
+        // exact-sized reads and no item header round trips. Payloads sit on
+        // PAYLOAD_ALIGNMENT boundaries, so in memory mapped mode the pointer
+        // handed to the decode kernels is page aligned.
+        if(!mPayloadSizes.empty()) {
+            const size_t index = static_cast<size_t>(frameIndex);
+            const uint32_t payloadSize = mPayloadSizes[index];
+            const uint32_t metadataSize = mMetadataSizes[index];
+
+            if(!seek(offset + static_cast<int64_t>(sizeof(Item)), SEEK_SET))
+                throw IOException("Invalid offset");
+
+            const uint8_t* payload = mReader->directRead(payloadSize);
+
+            if(payload) {
+                // Skip the metadata item header, the size is already known
+                if(!seek(sizeof(Item), SEEK_CUR))
+                    throw IOException("Invalid metadata");
+
+                outMetadataJson.resize(metadataSize);
+                read(outMetadataJson.data(), metadataSize);
+            }
+            else {
+                // Both sizes are known, so the payload, the metadata item
+                // header and the metadata arrive in one contiguous read
+                const size_t span = payloadSize + sizeof(Item) + metadataSize;
+
+                mTmpBuffer.resize(span);
+                read(mTmpBuffer.data(), span);
+
+                outMetadataJson.resize(metadataSize);
+                std::memcpy(outMetadataJson.data(), mTmpBuffer.data() + payloadSize + sizeof(Item), metadataSize);
+
+                payload = mTmpBuffer.data();
+            }
+
+            outCompressedLen = payloadSize;
+
+            dropBehind(offset + static_cast<int64_t>(2 * sizeof(Item) + payloadSize + metadataSize));
+
+            return payload;
+        }
+
+        if(!seek(offset, SEEK_SET))
+            throw IOException("Invalid offset");
+
+        // Memory mapped backends resolve every read in place, so the frame
+        // is parsed item by item at no syscall cost with zero-copy pointers
+        if(const uint8_t* headerPtr = mReader->directRead(sizeof(Item))) {
+            Item bufferItem{};
+            std::memcpy(&bufferItem, headerPtr, sizeof(Item));
+
+            if(bufferItem.type != Type::BUFFER && bufferItem.type != Type::COMPRESSED_BUFFER)
+                throw IOException("Invalid buffer type");
+
+            const uint8_t* compressed = mReader->directRead(bufferItem.size);
+            const uint8_t* metaHeaderPtr = compressed ? mReader->directRead(sizeof(Item)) : nullptr;
+
+            if(!metaHeaderPtr)
+                throw IOException("Failed to read data");
+
+            Item metadataItem{};
+            std::memcpy(&metadataItem, metaHeaderPtr, sizeof(Item));
+
+            if(metadataItem.type != Type::METADATA)
+                throw IOException("Invalid metadata");
+
+            outMetadataJson.resize(metadataItem.size);
+            read(outMetadataJson.data(), metadataItem.size);
+
+            outCompressedLen = bufferItem.size;
+
+            dropBehind(offset + static_cast<int64_t>(2 * sizeof(Item) + bufferItem.size + metadataItem.size));
+
+            return compressed;
+        }
+
+        // Buffered backends: one small read for the item header, then a
+        // single contiguous read covering the payload, the metadata item
+        // header and the metadata itself, instead of four separate reads
+        // per frame. The metadata length is taken from the previous frame -
+        // per-frame metadata is near constant within a recording - and a
+        // larger one only costs one extra read for the missing tail.
+        Item bufferItem{};
+        read(&bufferItem, sizeof(Item));
+
+        if(bufferItem.type != Type::BUFFER && bufferItem.type != Type::COMPRESSED_BUFFER)
+            throw IOException("Invalid buffer type");
+
+        if(mFileSize < 0)
+            mFileSize = mReader->size();
+
+        const int64_t payloadStart = offset + static_cast<int64_t>(sizeof(Item));
+
+        size_t span = bufferItem.size + sizeof(Item) + std::max<size_t>(mMetadataSizeHint, 1024);
+
+        // Never read past the end of the file
+        if(mFileSize > 0 && payloadStart + static_cast<int64_t>(span) > mFileSize)
+            span = static_cast<size_t>(mFileSize - payloadStart);
+
+        if(span < bufferItem.size + sizeof(Item))
+            throw IOException("Invalid metadata");
+
+        mTmpBuffer.resize(span);
+        read(mTmpBuffer.data(), span);
+
+        Item metadataItem{};
+        std::memcpy(&metadataItem, mTmpBuffer.data() + bufferItem.size, sizeof(Item));
+
+        if(metadataItem.type != Type::METADATA)
+            throw IOException("Invalid metadata");
+
+        outMetadataJson.resize(metadataItem.size);
+
+        const size_t have = std::min<size_t>(metadataItem.size, span - bufferItem.size - sizeof(Item));
+        std::memcpy(outMetadataJson.data(), mTmpBuffer.data() + bufferItem.size + sizeof(Item), have);
+
+        // The read cursor sits exactly at the end of the span, so a
+        // longer-than-guessed metadata continues from there
+        if(have < metadataItem.size)
+            read(outMetadataJson.data() + have, metadataItem.size - have);
+
+        mMetadataSizeHint = metadataItem.size;
+        outCompressedLen = bufferItem.size;
+
+        dropBehind(payloadStart + static_cast<int64_t>(std::max<size_t>(span, bufferItem.size + sizeof(Item) + metadataItem.size)));
+
+        return mTmpBuffer.data();
+    }
+
+    void Decoder::loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata) {
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        decodePayload(compressed, compressedLen, mMetadataJsonBuffer, outData, outMetadata);
+
+        STAT_HIST(FRAME, frameStart);
+    }
+
+    void Decoder::loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata, raw::FrameStatistics& outStatistics) {
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        STAT_TIMER(parseStart);
+        MOTIONCAM_TRACE_BEGIN(parse);
+
+        outMetadata = parseFrameMetadata(mMetadataJsonBuffer);
+
+        STAT_TIMER_END_HIST(mStatParseNanos, PARSE, parseStart);
+        MOTIONCAM_TRACE_END(parse, "parseMetadata");
+
+        const int width = outMetadata["width"];
+        const int height = outMetadata["height"];
+        const int compressionType = outMetadata["compressionType"];
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        const size_t outputSizeBytes = sizeof(uint16_t) * width*height;
+        outData.resize(outputSizeBytes);
+
+        compressed = unarchivePayload(compressed, compressedLen);
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        if(raw::Decode(outData.data(), width, height, compressed, compressedLen, decodeContext, outStatistics) <= 0)
+            throw IOException("Failed to uncompress frame");
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+        STAT_HIST(FRAME, frameStart);
+    }
+
+    void Decoder::loadFramePlanar(const Timestamp timestamp, std::array<std::vector<uint16_t>, 4>& outPlanes, nlohmann::json& outMetadata) {
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        STAT_TIMER(parseStart);
+        MOTIONCAM_TRACE_BEGIN(parse);
+
+        outMetadata = parseFrameMetadata(mMetadataJsonBuffer);
+
+        STAT_TIMER_END_HIST(mStatParseNanos, PARSE, parseStart);
+        MOTIONCAM_TRACE_END(parse, "parseMetadata");
+
+        const int width = outMetadata["width"];
+        const int height = outMetadata["height"];
+        const int compressionType = outMetadata["compressionType"];
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        uint16_t* planes[4];
+
+        for(int p = 0; p < 4; p++) {
+            outPlanes[p].resize(static_cast<size_t>(raw::PlaneDim(width, p & 1)) * raw::PlaneDim(height, p >> 1));
+            planes[p] = outPlanes[p].data();
+        }
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        compressed = unarchivePayload(compressed, compressedLen);
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        if(raw::DecodePlanar(planes, width, height, compressed, compressedLen, decodeContext) <= 0)
+            throw IOException("Failed to uncompress frame");
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+        STAT_HIST(FRAME, frameStart);
+    }
+
+    void Decoder::loadFramePacked(const Timestamp timestamp, const int bitsPerPixel, std::vector<uint8_t>& outData, nlohmann::json& outMetadata) {
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        STAT_TIMER(parseStart);
+        MOTIONCAM_TRACE_BEGIN(parse);
+
+        outMetadata = parseFrameMetadata(mMetadataJsonBuffer);
+
+        STAT_TIMER_END_HIST(mStatParseNanos, PARSE, parseStart);
+        MOTIONCAM_TRACE_END(parse, "parseMetadata");
+
+        const int width = outMetadata["width"];
+        const int height = outMetadata["height"];
+        const int compressionType = outMetadata["compressionType"];
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        const size_t rowBytes = (static_cast<size_t>(width) * bitsPerPixel + 7) / 8;
+
+        // The kernels write whole 4-row groups; trimmed to the real height
+        // after the decode
+        outData.resize(rowBytes * ((static_cast<size_t>(height) + 3) / 4 * 4));
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        compressed = unarchivePayload(compressed, compressedLen);
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        if(raw::DecodePacked(outData.data(), width, height, bitsPerPixel, compressed, compressedLen, decodeContext) <= 0)
+            throw IOException("Failed to uncompress frame");
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+
+        outData.resize(rowBytes * height);
+
+        STAT_HIST(FRAME, frameStart);
+    }
+
+    void Decoder::loadFrameResilient(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata, raw::DamageMap& outDamage) {
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        outMetadata = parseFrameMetadata(mMetadataJsonBuffer);
+
+        const int width = outMetadata["width"];
+        const int height = outMetadata["height"];
+        const int compressionType = outMetadata["compressionType"];
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+        decodeContext.saturatingAdd = true;
+
+        // The kernels write whole 4-row groups; trimmed to the real height
+        // before returning
+        outData.resize(static_cast<size_t>(width) * ((static_cast<size_t>(height) + 3) / 4 * 4));
+
+        // A payload the archival stage cannot unpack leaves nothing to
+        // walk; the frame comes back fully flagged rather than throwing
+        try {
+            compressed = unarchivePayload(compressed, compressedLen);
+        }
+        catch(MotionCamException&) {
+            compressed = nullptr;
+        }
+
+        if(!compressed) {
+            std::fill(outData.begin(), outData.end(), static_cast<uint16_t>(0));
+
+            const size_t numBlocks = (static_cast<size_t>(width) + 63) / 64 * ((static_cast<size_t>(height) + 3) / 4 * 4);
+
+            outDamage.numBlocks = numBlocks;
+            outDamage.damaged = numBlocks;
+            outDamage.blocks.assign((numBlocks + 63) / 64, ~static_cast<uint64_t>(0));
+
+            outData.resize(static_cast<size_t>(width) * height);
+
+            return;
+        }
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        raw::DecodeResilient(outData.data(), width, height, compressed, compressedLen, decodeContext, outDamage);
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+
+        outData.resize(static_cast<size_t>(width) * height);
+
+        STAT_HIST(FRAME, frameStart);
+    }
+
+    void Decoder::setFixedGeometry(bool enable) {
+        mFixedGeometry = enable;
+
+        if(!enable) {
+            mFixedWidth = -1;
+            mFixedHeight = -1;
+        }
+    }
+
+    // Payload bytes only, skipping the metadata item entirely - the
+    // fixed-geometry read. With the payload cache active the normal read
+    // fills cache entries, which carry the metadata anyway.
+    const uint8_t* Decoder::readFramePayloadPixels(const Timestamp timestamp, size_t& outCompressedLen) {
+        MOTIONCAM_TRACE_SCOPE("readFramePayloadPixels");
+
+        if(mPayloadCacheBudget != 0 || !mPayloadSpillDir.empty()) {
+            mMetadataJsonBuffer.clear();
+            return readFramePayload(timestamp, outCompressedLen, mMetadataJsonBuffer);
+        }
+
+        const int64_t frameIndex = findFrameIndex(timestamp);
+
+        if(frameIndex < 0)
+            throw IOException("Frame not found (timestamp: " + std::to_string(timestamp) + ")");
+
+        const int64_t offset = mFrameOffsets[frameIndex];
+
+        const uint8_t* compressed;
+
+        if(!mPayloadSizes.empty()) {
+            // Version 4 index: the payload size is known, one exact read
+            const uint32_t payloadSize = mPayloadSizes[frameIndex];
+
+            if(!seek(offset + static_cast<int64_t>(sizeof(Item)), SEEK_SET))
+                throw IOException("Invalid offset");
+
+            compressed = mReader->directRead(payloadSize);
+
+            if(!compressed) {
+                mTmpBuffer.resize(payloadSize);
+                read(mTmpBuffer.data(), payloadSize);
+
+                compressed = mTmpBuffer.data();
+            }
+
+            outCompressedLen = payloadSize;
+
+            dropBehind(offset + static_cast<int64_t>(sizeof(Item) + payloadSize));
+        }
+        else {
+            if(!seek(offset, SEEK_SET))
+                throw IOException("Invalid offset");
+
+            Item bufferItem{};
+            read(&bufferItem, sizeof(Item));
+
+            if(bufferItem.type != Type::BUFFER && bufferItem.type != Type::COMPRESSED_BUFFER)
+                throw IOException("Invalid buffer type");
+
+            compressed = mReader->directRead(bufferItem.size);
+
+            if(!compressed) {
+                mTmpBuffer.resize(bufferItem.size);
+                read(mTmpBuffer.data(), bufferItem.size);
+
+                compressed = mTmpBuffer.data();
+            }
+
+            outCompressedLen = bufferItem.size;
+
+            dropBehind(offset + static_cast<int64_t>(sizeof(Item) + bufferItem.size));
+        }
+
+        if(mVerifyChecksums)
+            verifyPayload(timestamp, compressed, outCompressedLen);
+
+        return compressed;
+    }
+
+    void Decoder::loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData) {
+        size_t compressedLen = 0;
+
+        // Fixed-geometry fast path: the dimensions are already known, so
+        // the metadata item is never read
+        if(mFixedGeometry && mFixedWidth >= 0) {
+            STAT_TIMER(fixedFrameStart);
+
+            const uint8_t* compressed = readFramePayloadPixels(timestamp, compressedLen);
+
+            STAT_HIST(READ, fixedFrameStart);
+
+            thread_local raw::DecodeContext decodeContext;
+
+            decodeContext.qos = mDecodeQoS;
+
+            // The kernels write whole 4-row groups; trimmed to the real
+            // height after the decode
+            outData.resize(static_cast<size_t>(mFixedWidth) * ((static_cast<size_t>(mFixedHeight) + 3) / 4 * 4));
+
+            compressed = unarchivePayload(compressed, compressedLen);
+
+            STAT_TIMER(decodeStart);
+            MOTIONCAM_TRACE_BEGIN(decode);
+
+            if(raw::Decode(outData.data(), static_cast<int>(mFixedWidth), static_cast<int>(mFixedHeight), compressed, compressedLen, decodeContext) <= 0)
+                throw IOException("Failed to uncompress frame");
+
+            STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+            MOTIONCAM_TRACE_END(decode, "decode");
+            STAT_ADD(mStatFramesDecoded, 1);
+
+            outData.resize(static_cast<size_t>(mFixedWidth) * mFixedHeight);
+
+            STAT_HIST(FRAME, fixedFrameStart);
+
+            return;
+        }
+
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        // Fast path: scan out the three fields needed for decoding without
+        // materializing a JSON DOM
+        long width, height, compressionType;
+
+        STAT_TIMER(parseStart);
+        MOTIONCAM_TRACE_BEGIN(parse);
+
+        ScannedFrameMetadata scanned;
+
+        if(scanFrameMetadata(mMetadataJsonBuffer, scanned)
+            && scanned.width >= 0 && scanned.height >= 0 && scanned.compressionType >= 0)
+        {
+            width = scanned.width;
+            height = scanned.height;
+            compressionType = scanned.compressionType;
+        }
+        else
+        {
+            // Unexpected metadata shape, fall back to the full parser
+            auto metadata = nlohmann::json::parse(mMetadataJsonBuffer.begin(), mMetadataJsonBuffer.end());
+
+            width = metadata["width"];
+            height = metadata["height"];
+            compressionType = metadata["compressionType"];
+        }
+
+        STAT_TIMER_END_HIST(mStatParseNanos, PARSE, parseStart);
+        MOTIONCAM_TRACE_END(parse, "parseMetadata");
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        // First load under fixed-geometry mode: later loads skip the
+        // metadata item and decode with these
+        if(mFixedGeometry) {
+            mFixedWidth = width;
+            mFixedHeight = height;
+        }
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        // The kernels write whole 4-row groups; trimmed to the real height
+        // after the decode
+        outData.resize(static_cast<size_t>(width) * ((static_cast<size_t>(height) + 3) / 4 * 4));
+
+        compressed = unarchivePayload(compressed, compressedLen);
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        if(raw::Decode(outData.data(), static_cast<int>(width), static_cast<int>(height), compressed, compressedLen, decodeContext) <= 0)
+            throw IOException("Failed to uncompress frame");
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+
+        outData.resize(static_cast<size_t>(width) * height);
+
+        STAT_HIST(FRAME, frameStart);
+    }
+
+    void Decoder::loadPreview(const Timestamp timestamp, int maxHeight, std::vector<uint16_t>& outData, int& outWidth, int& outHeight) {
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        long width, height, compressionType;
+
+        STAT_TIMER(parseStart);
+        MOTIONCAM_TRACE_BEGIN(parse);
+
+        ScannedFrameMetadata scanned;
+
+        if(scanFrameMetadata(mMetadataJsonBuffer, scanned)
+            && scanned.width >= 0 && scanned.height >= 0 && scanned.compressionType >= 0)
+        {
+            width = scanned.width;
+            height = scanned.height;
+            compressionType = scanned.compressionType;
+        }
+        else
+        {
+            auto metadata = nlohmann::json::parse(mMetadataJsonBuffer.begin(), mMetadataJsonBuffer.end());
+
+            width = metadata["width"];
+            height = metadata["height"];
+            compressionType = metadata["compressionType"];
+        }
+
+        STAT_TIMER_END_HIST(mStatParseNanos, PARSE, parseStart);
+        MOTIONCAM_TRACE_END(parse, "parseMetadata");
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        // Smallest row-group step that fits the preview into maxHeight,
+        // counting the padded groups PreviewHeight sizes for
+        const int numGroups = (static_cast<int>(height) + 3) / 4;
+        const int maxGroups = std::max(1, maxHeight / 4);
+        const int step = std::max(1, (numGroups + maxGroups - 1) / maxGroups);
+
+        outWidth = static_cast<int>(width);
+        outHeight = raw::PreviewHeight(static_cast<int>(height), step);
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        outData.resize(static_cast<size_t>(outWidth) * outHeight);
+
+        compressed = unarchivePayload(compressed, compressedLen);
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        if(raw::DecodePreview(outData.data(), static_cast<int>(width), static_cast<int>(height), step, compressed, compressedLen, decodeContext) <= 0)
+            throw IOException("Failed to uncompress frame");
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+        STAT_HIST(FRAME, frameStart);
+    }
+
+    bool Decoder::loadThumbnail(Thumbnail& outThumbnail) {
+        if(mThumbnailOffset < 0 || mThumbnailSize < sizeof(ThumbnailHeader))
+            return false;
+
+        // One exact read covers the header and the pixels
+        if(!seek(mThumbnailOffset + static_cast<int64_t>(sizeof(Item)), SEEK_SET))
+            throw IOException("Invalid thumbnail offset");
+
+        std::vector<uint8_t> buffer(mThumbnailSize);
+        read(buffer.data(), buffer.size());
+
+        ThumbnailHeader header{};
+        std::memcpy(&header, buffer.data(), sizeof(ThumbnailHeader));
+
+        if(header.format != THUMBNAIL_FORMAT_RGB888)
+            return false;
+
+        const size_t pixelBytes = static_cast<size_t>(header.width) * header.height * 3;
+
+        if(sizeof(ThumbnailHeader) + pixelBytes != buffer.size())
+            throw IOException("Invalid thumbnail");
+
+        outThumbnail.width = static_cast<int>(header.width);
+        outThumbnail.height = static_cast<int>(header.height);
+        outThumbnail.rgb.assign(buffer.begin() + sizeof(ThumbnailHeader), buffer.end());
+
+        return true;
+    }
+
+    void Decoder::loadFrame(const Timestamp timestamp, uint16_t* outData, size_t capacity, nlohmann::json& outMetadata) {
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        outMetadata = parseFrameMetadata(mMetadataJsonBuffer);
+
+        const int width = outMetadata["width"];
+        const int height = outMetadata["height"];
+        const int compressionType = outMetadata["compressionType"];
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        // The kernels write whole 4-row groups. A buffer covering the padded
+        // groups takes the decode directly; the documented width*height
+        // minimum decodes into reused scratch and copies the real rows out
+        const size_t logicalSize = static_cast<size_t>(width) * height;
+        const size_t paddedSize = static_cast<size_t>(width) * ((static_cast<size_t>(height) + 3) / 4 * 4);
+
+        if(capacity < logicalSize)
+            throw IOException("Output buffer too small (need " + std::to_string(logicalSize) + " pixels)");
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        decodeContext.streamingStores = mStreamingStores;
+
+        thread_local std::vector<uint16_t> stagingBuffer;
+
+        uint16_t* dst = outData;
+
+        if(capacity < paddedSize) {
+            stagingBuffer.resize(paddedSize);
+            dst = stagingBuffer.data();
+        }
+
+        compressed = unarchivePayload(compressed, compressedLen);
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        if(raw::Decode(dst, width, height, compressed, compressedLen, decodeContext) <= 0)
+            throw IOException("Failed to uncompress frame");
+
+        if(dst != outData)
+            std::memcpy(outData, dst, logicalSize * sizeof(uint16_t));
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+        STAT_HIST(FRAME, frameStart);
+    }
+
+    Expected<FrameInfo> Decoder::tryLoadFrame(const Timestamp timestamp, uint16_t* outData, size_t capacity) noexcept {
+        if(findFrameIndex(timestamp) < 0)
+            return DecodeError::FRAME_NOT_FOUND;
+
+        size_t compressedLen = 0;
+        const uint8_t* compressed = nullptr;
+
+        try {
+            mMetadataJsonBuffer.clear();
+            compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+        }
+        catch(const ChecksumException&) {
+            return DecodeError::CHECKSUM_MISMATCH;
+        }
+        catch(...) {
+            return DecodeError::IO_FAILED;
+        }
+
+        // Scan the dimensions out of the metadata bytes; no DOM fallback
+        // here, an unexpected metadata shape is reported instead
+        long width, height, compressionType;
+
+        STAT_TIMER(parseStart);
+        MOTIONCAM_TRACE_BEGIN(parse);
+
+        ScannedFrameMetadata scanned;
+
+        if(scanFrameMetadata(mMetadataJsonBuffer, scanned)
+            && scanned.width >= 0 && scanned.height >= 0 && scanned.compressionType >= 0)
+        {
+            width = scanned.width;
+            height = scanned.height;
+            compressionType = scanned.compressionType;
+        }
+        else
+        {
+            return DecodeError::INVALID_METADATA;
+        }
+
+        STAT_TIMER_END_HIST(mStatParseNanos, PARSE, parseStart);
+        MOTIONCAM_TRACE_END(parse, "parseMetadata");
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            return DecodeError::INVALID_COMPRESSION;
+
+        const size_t logicalSize = static_cast<size_t>(width) * height;
+        const size_t paddedSize = static_cast<size_t>(width) * ((static_cast<size_t>(height) + 3) / 4 * 4);
+
+        if(capacity < logicalSize)
+            return DecodeError::BUFFER_TOO_SMALL;
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        decodeContext.streamingStores = mStreamingStores;
+
+        // The kernels write whole 4-row groups; a capacity below the padded
+        // count stages the decode and copies the real rows out
+        thread_local std::vector<uint16_t> stagingBuffer;
+
+        uint16_t* dst = outData;
+
+        if(capacity < paddedSize) {
+            try {
+                stagingBuffer.resize(paddedSize);
+            }
+            catch(...) {
+                return DecodeError::DECODE_FAILED;
+            }
+
+            dst = stagingBuffer.data();
+        }
+
+        // A corrupt archived payload surfaces as a decode failure here
+        try {
+            compressed = unarchivePayload(compressed, compressedLen);
+        }
+        catch(...) {
+            return DecodeError::DECODE_FAILED;
+        }
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        if(raw::Decode(dst, static_cast<int>(width), static_cast<int>(height), compressed, compressedLen, decodeContext) <= 0)
+            return DecodeError::DECODE_FAILED;
+
+        if(dst != outData)
+            std::memcpy(outData, dst, logicalSize * sizeof(uint16_t));
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+
+        FrameInfo info;
+        info.timestamp = timestamp;
+        info.width = static_cast<int>(width);
+        info.height = static_cast<int>(height);
+
+        return info;
+    }
+
+    FrameHandle Decoder::loadFrame(const Timestamp timestamp, FrameBufferPool& bufferPool, nlohmann::json& outMetadata) {
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        STAT_TIMER(frameStart);
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        STAT_HIST(READ, frameStart);
+
+        FrameHandle frame = decodePayloadPooled(compressed, compressedLen, mMetadataJsonBuffer, bufferPool, outMetadata);
+
+        STAT_HIST(FRAME, frameStart);
+
+        return frame;
+    }
+
+    void Decoder::setFrameCacheBudget(size_t bytes) {
+        mCacheBudget = bytes;
+
+        // Evict until the cache fits the new budget
+        while(mCacheBytes > mCacheBudget && !mCacheList.empty()) {
+            const size_t evictedBytes = sizeof(uint16_t) * mCacheList.back().second->data.size();
+
+            mCacheBytes -= evictedBytes;
+            mCacheMap.erase(mCacheList.back().first);
+            mCacheList.pop_back();
+
+            MemoryGovernor::shared().release(MemoryGovernor::Subsystem::FRAME_CACHE, evictedBytes);
+        }
+    }
+
+    size_t Decoder::frameCacheBudget() const {
+        return mCacheBudget;
+    }
+
+    std::shared_ptr<const CachedFrame> Decoder::loadCachedFrame(const Timestamp timestamp) {
+        auto it = mCacheMap.find(timestamp);
+
+        if(it != mCacheMap.end()) {
+            // Hit, mark as most recently used
+            mCacheList.splice(mCacheList.begin(), mCacheList, it->second);
+
+            return mCacheList.front().second;
+        }
+
+        size_t compressedLen = 0;
+        mMetadataJsonBuffer.clear();
+
+        const uint8_t* compressed = readFramePayload(timestamp, compressedLen, mMetadataJsonBuffer);
+
+        auto frame = std::make_shared<CachedFrame>();
+        decodePayload(compressed, compressedLen, mMetadataJsonBuffer, frame->data, frame->metadata);
+
+        const size_t frameBytes = sizeof(uint16_t) * frame->data.size();
+
+        if(mCacheBudget >= frameBytes) {
+            mCacheList.emplace_front(timestamp, frame);
+            mCacheMap.emplace(timestamp, mCacheList.begin());
+            mCacheBytes += frameBytes;
+
+            MemoryGovernor::shared().charge(MemoryGovernor::Subsystem::FRAME_CACHE, frameBytes);
+
+            while((mCacheBytes > mCacheBudget
+                || MemoryGovernor::shared().overTarget(MemoryGovernor::Subsystem::FRAME_CACHE))
+                && mCacheList.size() > 1)
+            {
+                const size_t evictedBytes = sizeof(uint16_t) * mCacheList.back().second->data.size();
+
+                mCacheBytes -= evictedBytes;
+                mCacheMap.erase(mCacheList.back().first);
+                mCacheList.pop_back();
+
+                MemoryGovernor::shared().release(MemoryGovernor::Subsystem::FRAME_CACHE, evictedBytes);
+            }
+        }
+
+        return frame;
+    }
+
+    std::vector<std::shared_ptr<const CachedFrame>> Decoder::loadWindow(const Timestamp center, int radius) {
+        if(radius < 0)
+            radius = 0;
+
+        auto it = std::lower_bound(mFrameList.begin(), mFrameList.end(), center);
+
+        if(it == mFrameList.end() || *it != center)
+            throw IOException("Frame not found");
+
+        const int64_t centerIndex = it - mFrameList.begin();
+        const int64_t first = std::max<int64_t>(0, centerIndex - radius);
+        const int64_t last = std::min<int64_t>(static_cast<int64_t>(mFrameList.size()) - 1, centerIndex + radius);
+
+        std::vector<std::pair<Timestamp, std::shared_ptr<const CachedFrame>>> window;
+        window.reserve(static_cast<size_t>(last - first + 1));
+
+        for(int64_t i = first; i <= last; i++) {
+            const Timestamp timestamp = mFrameList[static_cast<size_t>(i)];
+
+            // A frame carried over from the previous window is reused even
+            // when the cache budget could not hold it
+            auto held = std::find_if(mWindow.begin(), mWindow.end(), [timestamp](const auto& entry) {
+                return entry.first == timestamp;
+            });
+
+            if(held != mWindow.end())
+                window.emplace_back(timestamp, held->second);
+            else
+                window.emplace_back(timestamp, loadCachedFrame(timestamp));
+        }
+
+        // Frames no longer covered drop their pin here; the last shared
+        // reference going away frees the pixels, unless the frame cache is
+        // retaining them within its budget
+        mWindow = std::move(window);
+
+        std::vector<std::shared_ptr<const CachedFrame>> result;
+        result.reserve(mWindow.size());
+
+        for(const auto& entry : mWindow)
+            result.push_back(entry.second);
+
+        return result;
+    }
+
+    void Decoder::loadFrames(const std::vector<Timestamp>& timestamps, const FrameCallback& callback, size_t numThreads) {
+        loadFramesImpl(timestamps, numThreads,
+            [this, &callback](Timestamp timestamp, const std::vector<uint8_t>& compressed, const std::vector<uint8_t>& metadataJson) {
+                std::vector<uint16_t> outData;
+                nlohmann::json outMetadata;
+
+                decodePayload(compressed.data(), compressed.size(), metadataJson, outData, outMetadata);
+
+                callback(timestamp, std::move(outData), std::move(outMetadata));
+            });
+    }
+
+    void Decoder::loadFrames(const std::vector<Timestamp>& timestamps, const FrameCallback& callback, const CancellationToken& token, size_t numThreads) {
+        // The shared flag is held through the batch so a token the caller
+        // drops early cannot leave the workers with a dangling pointer
+        auto cancelled = token.mCancelled;
+
+        loadFramesImpl(timestamps, numThreads,
+            [this, &callback, cancelled](Timestamp timestamp, const std::vector<uint8_t>& compressed, const std::vector<uint8_t>& metadataJson) {
+                std::vector<uint16_t> outData;
+                nlohmann::json outMetadata;
+
+                decodePayload(compressed.data(), compressed.size(), metadataJson, outData, outMetadata, cancelled.get());
+
+                // An abandoned frame is dropped, not delivered
+                if(cancelled->load(std::memory_order_relaxed))
+                    return;
+
+                callback(timestamp, std::move(outData), std::move(outMetadata));
+            },
+            cancelled.get());
+    }
+
+    void Decoder::loadFrames(const std::vector<Timestamp>& timestamps, FrameBufferPool& bufferPool, const PooledFrameCallback& callback, size_t numThreads) {
+        loadFramesImpl(timestamps, numThreads,
+            [this, &bufferPool, &callback](Timestamp timestamp, const std::vector<uint8_t>& compressed, const std::vector<uint8_t>& metadataJson) {
+                nlohmann::json outMetadata;
+
+                FrameHandle handle = decodePayloadPooled(compressed.data(), compressed.size(), metadataJson, bufferPool, outMetadata);
+
+                callback(timestamp, std::move(handle), std::move(outMetadata));
+            });
+    }
+
+    void Decoder::loadFrames(const std::vector<Timestamp>& timestamps, FrameBufferPool& bufferPool, const PooledFrameCallback& callback, const CancellationToken& token, size_t numThreads) {
+        auto cancelled = token.mCancelled;
+
+        loadFramesImpl(timestamps, numThreads,
+            [this, &bufferPool, &callback, cancelled](Timestamp timestamp, const std::vector<uint8_t>& compressed, const std::vector<uint8_t>& metadataJson) {
+                nlohmann::json outMetadata;
+
+                FrameHandle handle = decodePayloadPooled(compressed.data(), compressed.size(), metadataJson, bufferPool, outMetadata, cancelled.get());
+
+                // Dropping the handle of an abandoned frame releases its
+                // buffer straight back to the pool
+                if(cancelled->load(std::memory_order_relaxed))
+                    return;
+
+                callback(timestamp, std::move(handle), std::move(outMetadata));
+            },
+            cancelled.get());
+    }
+
+    void Decoder::loadFramesImpl(const std::vector<Timestamp>& timestamps, size_t numThreads, const DecodeTask& decodeTask, const std::atomic<bool>* cancel) {
+        // A tuned decoder sizes the default to the parallelism its storage
+        // can actually feed; extra threads on a slow mount only contend for
+        // frames that have not arrived
+        if(numThreads == 0 && mAutoTune && mTunedProfile.decodeThreads > 0)
+            numThreads = std::min<size_t>(mTunedProfile.decodeThreads, std::max(1u, std::thread::hardware_concurrency()));
+
+        // The default runs on the process-wide pool, so concurrent batch
+        // loads, striped decodes and export work share the cores instead of
+        // each spawning a pool that oversubscribes the machine. An explicit
+        // numThreads still gets a private pool of that size.
+        std::unique_ptr<ThreadPool> ownPool;
+
+        if(numThreads > 0)
+            ownPool.reset(new ThreadPool(numThreads));
+
+        ThreadPool& pool = ownPool ? *ownPool : ThreadPool::shared();
+        TaskGroup group;
+
+        std::mutex errorMutex;
+        std::exception_ptr firstError;
+
+        // Read a chunk of frames at a time with batched I/O (kept in flight
+        // together on backends that support it) while the workers decode the
+        // previous chunk, bounding the compressed payloads held in memory.
+        const size_t chunkSize = std::max<size_t>(8, 2 * pool.numThreads());
+
+        for(size_t chunkStart = 0; chunkStart < timestamps.size(); chunkStart += chunkSize) {
+            // Chunks not yet read when the batch is cancelled never touch
+            // the storage
+            if(cancel && cancel->load(std::memory_order_relaxed))
+                break;
+
+            const size_t n = std::min(chunkSize, timestamps.size() - chunkStart);
+
+            std::vector<int64_t> indices(n);
+            std::vector<int64_t> offsets(n);
+
+            for(size_t i = 0; i < n; i++) {
+                const int64_t index = findFrameIndex(timestamps[chunkStart + i]);
+
+                if(index < 0)
+                    throw IOException("Frame not found (timestamp: " + std::to_string(timestamps[chunkStart + i]) + ")");
+
+                indices[i] = index;
+                offsets[i] = mFrameOffsets[index];
+            }
+
+            std::vector<std::shared_ptr<std::vector<uint8_t>>> compressed(n);
+            std::vector<std::shared_ptr<std::vector<uint8_t>>> metadataJson(n);
+
+            if(!mPayloadSizes.empty()) {
+                // With per-frame sizes in the index the extent of every
+                // record is known up front, so runs of adjacent frames
+                // collapse into large sequential reads sliced in memory
+                readFrameRecordsCoalesced(indices, compressed, metadataJson);
+
+                if(mVerifyChecksums)
+                    for(size_t i = 0; i < n; i++)
+                        verifyPayload(timestamps[chunkStart + i], compressed[i]->data(), compressed[i]->size());
+            }
+            else {
+                std::vector<Item> bufferItems(n);
+                std::vector<Item> metadataItems(n);
+                std::vector<ReadRequest> requests;
+
+                // Item headers
+                requests.reserve(n);
+
+                for(size_t i = 0; i < n; i++)
+                    requests.push_back({ offsets[i], sizeof(Item), &bufferItems[i] });
+
+                STAT_ADD(mStatNumSeeks, requests.size());
+
+                for(const auto& r : requests)
+                    STAT_ADD(mStatBytesRead, r.len);
+
+                mReader->readBatch(requests);
+
+                // Compressed payloads and the trailing metadata item headers
+                requests.clear();
+
+                for(size_t i = 0; i < n; i++) {
+                    if(bufferItems[i].type != Type::BUFFER && bufferItems[i].type != Type::COMPRESSED_BUFFER)
+                        throw IOException("Invalid buffer type");
+
+                    compressed[i] = std::make_shared<std::vector<uint8_t>>(bufferItems[i].size);
+
+                    requests.push_back({ offsets[i] + static_cast<int64_t>(sizeof(Item)), bufferItems[i].size, compressed[i]->data() });
+                    requests.push_back({ offsets[i] + static_cast<int64_t>(sizeof(Item)) + bufferItems[i].size, sizeof(Item), &metadataItems[i] });
+                }
+
+                STAT_ADD(mStatNumSeeks, requests.size());
+
+                for(const auto& r : requests)
+                    STAT_ADD(mStatBytesRead, r.len);
+
+                mReader->readBatch(requests);
+
+                // Hash on this thread while the workers decode the previous
+                // chunk; with the pool busy, verification is free wall-clock
+                if(mVerifyChecksums)
+                    for(size_t i = 0; i < n; i++)
+                        verifyPayload(timestamps[chunkStart + i], compressed[i]->data(), compressed[i]->size());
+
+                // Metadata payloads
+                requests.clear();
+
+                for(size_t i = 0; i < n; i++) {
+                    if(metadataItems[i].type != Type::METADATA)
+                        throw IOException("Invalid metadata");
+
+                    metadataJson[i] = std::make_shared<std::vector<uint8_t>>(metadataItems[i].size);
+
+                    requests.push_back({ offsets[i] + 2*static_cast<int64_t>(sizeof(Item)) + bufferItems[i].size, metadataItems[i].size, metadataJson[i]->data() });
+                }
+
+                STAT_ADD(mStatNumSeeks, requests.size());
+
+                for(const auto& r : requests)
+                    STAT_ADD(mStatBytesRead, r.len);
+
+                mReader->readBatch(requests);
+            }
+
+            for(size_t i = 0; i < n; i++) {
+                const Timestamp timestamp = timestamps[chunkStart + i];
+                auto frameCompressed = compressed[i];
+                auto frameMetadata = metadataJson[i];
+
+                group.run(pool, Priority::DECODE, [timestamp, frameCompressed, frameMetadata, &decodeTask, &errorMutex, &firstError, cancel] {
+                    // A task still queued at cancellation never starts
+                    if(cancel && cancel->load(std::memory_order_relaxed))
+                        return;
+
+                    try {
+                        decodeTask(timestamp, *frameCompressed, *frameMetadata);
+                    }
+                    catch(...) {
+                        std::unique_lock<std::mutex> lock(errorMutex);
+
+                        if(!firstError)
+                            firstError = std::current_exception();
+                    }
+                });
+            }
+        }
+
+        group.wait();
+
+        if(firstError)
+            std::rethrow_exception(firstError);
+    }
+
+    void Decoder::readFrameRecordsCoalesced(
+        const std::vector<int64_t>& indices,
+        std::vector<std::shared_ptr<std::vector<uint8_t>>>& outCompressed,
+        std::vector<std::shared_ptr<std::vector<uint8_t>>>& outMetadataJson)
+    {
+        // Frames requested together usually sit next to each other on disk,
+        // and a record's full extent is in the version 4 index. Instead of a
+        // seek+read per item we walk the chunk in disk order, merge runs of
+        // back-to-back records into one large read each and slice the item
+        // boundaries out of the shared buffer; sequential storage (network
+        // mounts especially) delivers a multiple of the per-frame throughput
+        // on big reads. The span cap bounds the buffer a single read holds;
+        // the gap bound lets a run read through the version 4 alignment
+        // filler and the audio chunks a recorder interleaves between frames,
+        // where the wasted bytes cost far less than the seek they save.
+        constexpr size_t COALESCED_READ_SPAN = 8 * 1024 * 1024;
+        constexpr int64_t COALESCED_GAP = 64 * 1024;
+
+        const size_t n = indices.size();
+
+        std::vector<size_t> order(n);
+
+        for(size_t i = 0; i < n; i++)
+            order[i] = i;
+
+        std::sort(order.begin(), order.end(), [this, &indices](size_t a, size_t b) {
+            return mFrameOffsets[indices[a]] < mFrameOffsets[indices[b]];
+        });
+
+        struct Run {
+            size_t first;   // range in order[]
+            size_t last;    // exclusive
+            int64_t begin;  // file offset
+            size_t span;
+        };
+
+        std::vector<Run> runs;
+        std::vector<std::vector<uint8_t>> buffers;
+
+        size_t i = 0;
+
+        while(i < n) {
+            Run run{ i, i + 1, frameByteRange(indices[order[i]]).first, frameByteRange(indices[order[i]]).second };
+
+            // Extend while the next record follows within the gap bound and
+            // the buffer stays within the span cap; a lone record larger
+            // than the cap still goes out as one read
+            while(run.last < n) {
+                const auto next = frameByteRange(indices[order[run.last]]);
+                const int64_t gap = next.first - (run.begin + static_cast<int64_t>(run.span));
+
+                if(gap < 0 || gap > COALESCED_GAP)
+                    break;
+
+                const size_t extended = static_cast<size_t>(next.first - run.begin) + next.second;
+
+                if(extended > COALESCED_READ_SPAN)
+                    break;
+
+                run.span = extended;
+                run.last++;
+            }
+
+            runs.push_back(run);
+            i = run.last;
+        }
+
+        // One request per run, issued together so backends with real
+        // vectored I/O keep them in flight at once
+        std::vector<ReadRequest> requests;
+        requests.reserve(runs.size());
+        buffers.resize(runs.size());
+
+        for(size_t r = 0; r < runs.size(); r++) {
+            buffers[r].resize(runs[r].span);
+            requests.push_back({ runs[r].begin, runs[r].span, buffers[r].data() });
+        }
+
+        STAT_ADD(mStatNumSeeks, requests.size());
+
+        for(const auto& r : requests)
+            STAT_ADD(mStatBytesRead, r.len);
+
+        mReader->readBatch(requests);
+
+        // Slice the per-frame payloads out of the run buffers; each record's
+        // position comes from its index offset, stepping over any padding
+        for(size_t r = 0; r < runs.size(); r++) {
+            const auto& buffer = buffers[r];
+
+            for(size_t k = runs[r].first; k < runs[r].last; k++) {
+                const size_t slot = order[k];
+                size_t pos = static_cast<size_t>(mFrameOffsets[indices[slot]] - runs[r].begin);
+
+                Item bufferItem{};
+                std::memcpy(&bufferItem, buffer.data() + pos, sizeof(Item));
+
+                if(bufferItem.type != Type::BUFFER && bufferItem.type != Type::COMPRESSED_BUFFER)
+                    throw IOException("Invalid buffer type");
+
+                // The index promised this record's extent; a header that
+                // disagrees would throw the slicing off the item boundaries
+                if(bufferItem.size != mPayloadSizes[indices[slot]])
+                    throw IOException("Frame record does not match index");
+
+                pos += sizeof(Item);
+
+                outCompressed[slot] = std::make_shared<std::vector<uint8_t>>(
+                    buffer.begin() + pos, buffer.begin() + pos + bufferItem.size);
+
+                pos += bufferItem.size;
+
+                Item metadataItem{};
+                std::memcpy(&metadataItem, buffer.data() + pos, sizeof(Item));
+
+                if(metadataItem.type != Type::METADATA)
+                    throw IOException("Invalid metadata");
+
+                if(metadataItem.size != mMetadataSizes[indices[slot]])
+                    throw IOException("Frame record does not match index");
+
+                pos += sizeof(Item);
+
+                outMetadataJson[slot] = std::make_shared<std::vector<uint8_t>>(
+                    buffer.begin() + pos, buffer.begin() + pos + metadataItem.size);
+
+                pos += metadataItem.size;
+            }
+        }
+    }
+
+    const uint8_t* Decoder::unarchivePayload(const uint8_t* compressed, size_t& compressedLen) const {
+        if(mContainerMetadata.archiveCodec == 0)
+            return compressed;
+
+        // Archived containers (mcraw_archive) store each payload behind an
+        // entropy stage; restore it here, at the decode boundary, so every
+        // read path - single loads, batch loads, the sequential scan - gets
+        // it transparently and in parallel on whichever thread decodes the
+        // frame. One scratch per thread, reused across frames.
+        thread_local std::vector<uint8_t> restored;
+
+        archive::Decompress(compressed, compressedLen, restored);
+
+        compressedLen = restored.size();
+
+        return restored.data();
+    }
+
+    void Decoder::decodePayload(
+        const uint8_t* compressed,
+        size_t compressedLen,
+        const std::vector<uint8_t>& metadataJson,
+        std::vector<uint16_t>& outData,
+        nlohmann::json& outMetadata,
+        const std::atomic<bool>* cancel) const
+    {
+        STAT_TIMER(parseStart);
+        MOTIONCAM_TRACE_BEGIN(parse);
+
+        outMetadata = parseFrameMetadata(metadataJson);
+
+        STAT_TIMER_END_HIST(mStatParseNanos, PARSE, parseStart);
+        MOTIONCAM_TRACE_END(parse, "parseMetadata");
+
+        const int width = outMetadata["width"];
+        const int height = outMetadata["height"];
+        const int compressionType = outMetadata["compressionType"];
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        // Decompress the buffer, reusing one set of scratch buffers per thread
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        const size_t outputSizeBytes = sizeof(uint16_t) * width*height;
+        outData.resize(outputSizeBytes);
+
+        compressed = unarchivePayload(compressed, compressedLen);
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        decodeContext.cancel = cancel;
+
+        const size_t decoded = raw::Decode(outData.data(), width, height, compressed, compressedLen, decodeContext);
+
+        decodeContext.cancel = nullptr;
+
+        // A cancelled decode returns quietly with partial output; the
+        // caller drops the frame
+        if(decoded <= 0 && cancel && cancel->load(std::memory_order_relaxed))
+            return;
+
+        if(decoded <= 0)
+            throw IOException("Failed to uncompress frame");
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+    }
+
+    FrameHandle Decoder::decodePayloadPooled(
+        const uint8_t* compressed,
+        size_t compressedLen,
+        const std::vector<uint8_t>& metadataJson,
+        FrameBufferPool& bufferPool,
+        nlohmann::json& outMetadata,
+        const std::atomic<bool>* cancel) const
+    {
+        STAT_TIMER(parseStart);
+        MOTIONCAM_TRACE_BEGIN(parse);
+
+        outMetadata = parseFrameMetadata(metadataJson);
+
+        STAT_TIMER_END_HIST(mStatParseNanos, PARSE, parseStart);
+        MOTIONCAM_TRACE_END(parse, "parseMetadata");
+
+        const int width = outMetadata["width"];
+        const int height = outMetadata["height"];
+        const int compressionType = outMetadata["compressionType"];
+
+        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
+            throw IOException("Invalid compression type");
+
+        // Blocks here when the pool cap is reached and nothing is free. The
+        // decode kernels write whole 4-row groups, so the pool buffer covers
+        // the padded height; the metadata keeps the logical dimensions
+        FrameHandle handle = bufferPool.acquire(static_cast<size_t>(width) * ((static_cast<size_t>(height) + 3) / 4 * 4));
+
+        thread_local raw::DecodeContext decodeContext;
+
+        decodeContext.qos = mDecodeQoS;
+
+        compressed = unarchivePayload(compressed, compressedLen);
+
+        STAT_TIMER(decodeStart);
+        MOTIONCAM_TRACE_BEGIN(decode);
+
+        decodeContext.cancel = cancel;
+
+        const size_t decoded = raw::Decode(handle.data(), width, height, compressed, compressedLen, decodeContext);
+
+        decodeContext.cancel = nullptr;
+
+        // The handle of a cancelled decode goes back to the pool when the
+        // caller drops it
+        if(decoded <= 0 && cancel && cancel->load(std::memory_order_relaxed))
+            return handle;
+
+        if(decoded <= 0)
+            throw IOException("Failed to uncompress frame");
+
+        STAT_TIMER_END_HIST(mStatDecodeNanos, DECODE, decodeStart);
+        MOTIONCAM_TRACE_END(decode, "decode");
+        STAT_ADD(mStatFramesDecoded, 1);
+
+        return handle;
+    }
+
+    void Decoder::beginSequentialScan(size_t readAhead) {
+        beginScan({}, false, readAhead);
+    }
+
+    void Decoder::beginSelectiveScan(size_t startFrame, size_t endFrame, size_t step, size_t readAhead) {
+        if(step == 0)
+            throw IOException("Invalid scan step");
+
+        endFrame = std::min(endFrame, mFrameList.size());
+
+        std::vector<size_t> selection;
+
+        if(startFrame < endFrame)
+            selection.reserve((endFrame - startFrame + step - 1) / step);
+
+        for(size_t i = startFrame; i < endFrame; i += step)
+            selection.push_back(i);
+
+        beginScan(std::move(selection), true, readAhead);
+    }
+
+    void Decoder::beginSelectiveScan(const std::vector<Timestamp>& frames, size_t readAhead) {
+        std::vector<size_t> selection;
+        selection.reserve(frames.size());
+
+        for(const auto timestamp : frames) {
+            const int64_t index = findFrameIndex(timestamp);
+
+            if(index < 0)
+                throw IOException("Frame not found (timestamp: " + std::to_string(timestamp) + ")");
+
+            selection.push_back(static_cast<size_t>(index));
+        }
+
+        beginScan(std::move(selection), true, readAhead);
+    }
+
+    void Decoder::beginScan(std::vector<size_t> selection, bool selective, size_t readAhead) {
+        if(mScan)
+            throw IOException("Sequential scan already active");
+
+        size_t ahead = std::max<size_t>(1, readAhead);
+        size_t maxAhead = ahead;
+
+        // A tuned scan starts from the depth learned for this mount and
+        // leaves itself room to climb
+        if(mAutoTune) {
+            if(mTunedProfile.readAhead > 0)
+                ahead = mTunedProfile.readAhead;
+
+            maxAhead = std::max<size_t>(ahead, 16);
+        }
+
+        mScan.reset(new SequentialScanState(ahead, maxAhead));
+        mScan->tune = mAutoTune;
+        mScan->selective = selective;
+        mScan->selection = std::move(selection);
+
+        mScan->ioThread = std::thread(&Decoder::scanLoop, this);
+    }
+
+    std::pair<int64_t, size_t> Decoder::frameByteRange(size_t index) const {
+        const int64_t offset = mFrameOffsets[index];
+
+        if(!mPayloadSizes.empty())
+            return { offset, 2*sizeof(Item) + mPayloadSizes[index] + mMetadataSizes[index] };
+
+        // Without per-frame sizes, span to the next frame's offset; the last
+        // frame falls back to a conservative fixed window
+        if(index + 1 < mFrameOffsets.size() && mFrameOffsets[index + 1] > offset)
+            return { offset, static_cast<size_t>(mFrameOffsets[index + 1] - offset) };
+
+        return { offset, 2*1024*1024 };
+    }
+
+    void Decoder::scanLoop() {
+        SequentialScanState& scan = *mScan;
+
+        // A selective scan visits a subset of the frames, a full scan all
+        // of them in index order
+        const size_t numFrames = scan.selective ? scan.selection.size() : mFrameList.size();
+
+        const auto frameAt = [&scan](size_t position) {
+            return scan.selective ? scan.selection[position] : position;
+        };
+
+        // The full pass runs front to back; say so up front, so the backend
+        // raises its read-ahead window before the first frame. A decimated
+        // pass must not: sequential read-ahead would drag in exactly the
+        // skipped byte ranges the stride is meant to avoid, so only the
+        // per-frame advice below runs.
+        if(!scan.selective) {
+            const int64_t fileSize = mReader->size();
+
+            if(fileSize > 0)
+                mReader->advise(0, static_cast<size_t>(fileSize), Advice::SEQUENTIAL);
+        }
+
+        // Keep the OS read-ahead a few frames in front of the scan and drop
+        // pages as soon as their frame has been copied out, so the page
+        // cache streams instead of guessing; noticeably smooths periodic
+        // read stalls on network filesystems. Re-read per frame, since a
+        // tuned scan adjusts the depth while running.
+        try {
+            for(size_t a = 0; a < scan.readAhead.load(std::memory_order_relaxed) && a < numFrames; a++) {
+                const auto range = frameByteRange(frameAt(a));
+                mReader->advise(range.first, range.second, Advice::WILL_NEED);
+            }
+
+            for(size_t position = 0; position < numFrames; position++) {
+                const size_t index = frameAt(position);
+                const Timestamp timestamp = mFrameList[index];
+                const size_t adviseAhead = scan.readAhead.load(std::memory_order_relaxed);
+
+                if(position + adviseAhead < numFrames) {
+                    const auto range = frameByteRange(frameAt(position + adviseAhead));
+                    mReader->advise(range.first, range.second, Advice::WILL_NEED);
+                }
+
+                PrefetchedFrame frame;
+                frame.timestamp = timestamp;
+
+                const auto readStart = std::chrono::steady_clock::now();
+
+                // Read the compressed payload and metadata into owned buffers
+                if(!seek(mFrameOffsets[index], SEEK_SET))
+                    throw IOException("Invalid offset");
+
+                Item bufferItem{};
+                read(&bufferItem, sizeof(Item));
+
+                if(bufferItem.type != Type::BUFFER && bufferItem.type != Type::COMPRESSED_BUFFER)
+                    throw IOException("Invalid buffer type");
+
+                frame.compressed.resize(bufferItem.size);
+                read(frame.compressed.data(), bufferItem.size);
+
+                Item metadataItem{};
+                read(&metadataItem, sizeof(Item));
+
+                if(metadataItem.type != Type::METADATA)
+                    throw IOException("Invalid metadata");
+
+                frame.metadataJson.resize(metadataItem.size);
+                read(frame.metadataJson.data(), metadataItem.size);
+
+                scan.readNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - readStart).count(), std::memory_order_relaxed);
+                scan.framesRead.fetch_add(1, std::memory_order_relaxed);
+
+                // Hashing here, on the I/O thread, overlaps the consumer's
+                // decode of the previous frame, so verification adds no
+                // wall-clock time to the scan
+                if(mVerifyChecksums)
+                    verifyPayload(timestamp, frame.compressed.data(), frame.compressed.size());
+
+                // The frame is in owned buffers now; its pages can go
+                {
+                    const auto range = frameByteRange(index);
+                    mReader->advise(range.first, range.second, Advice::DONT_NEED);
+                }
+
+                const size_t frameBytes = frame.compressed.size() + frame.metadataJson.size();
+
+                // Hand it to the consumer, backing off while a full
+                // read-ahead is staged. Under a global memory budget the
+                // prefetch gives back first: a ring over its trim target
+                // stops growing until consumption drains it, though at
+                // least one frame is always in flight so the scan keeps
+                // making progress. The ring rounds its capacity up, so
+                // gating on readAhead here keeps the configured bound exact
+                ringbuffer::Backoff backoff;
+                bool stalled = false;
+
+                while(scan.ring.size() >= scan.readAhead.load(std::memory_order_relaxed)
+                    || (!scan.ring.empty() && MemoryGovernor::shared().overTarget(MemoryGovernor::Subsystem::PREFETCH)))
+                {
+                    if(scan.stop.load(std::memory_order_relaxed))
+                        return;
+
+                    // One stall per frame however long it lasts, so the
+                    // tuner sees how often the I/O thread was ahead, not
+                    // how long it span
+                    if(!stalled) {
+                        scan.fullWaits.fetch_add(1, std::memory_order_relaxed);
+                        stalled = true;
+                    }
+
+                    backoff.wait();
+                }
+
+                while(!scan.ring.tryPush(std::move(frame)))
+                    backoff.wait();
+
+                MemoryGovernor::shared().charge(MemoryGovernor::Subsystem::PREFETCH, frameBytes);
+            }
+        }
+        catch(...) {
+            scan.error = std::current_exception();
+        }
+
+        scan.done.store(true, std::memory_order_release);
+    }
+
+    bool Decoder::nextFrame(Timestamp& outTimestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata) {
+        if(!mScan)
+            throw IOException("No sequential scan active");
+
+        SequentialScanState& scan = *mScan;
+
+        PrefetchedFrame frame;
+        ringbuffer::Backoff backoff;
+        bool starved = false;
+
+        while(!scan.ring.tryPop(frame)) {
+            // The acquire on done orders it after the I/O thread's final
+            // push, so an empty ring here really is the end of the scan
+            if(scan.done.load(std::memory_order_acquire) && scan.ring.empty()) {
+                if(scan.error)
+                    std::rethrow_exception(scan.error);
+
+                return false;
+            }
+
+            if(!starved) {
+                scan.emptyWaits.fetch_add(1, std::memory_order_relaxed);
+                starved = true;
+            }
+
+            backoff.wait();
+        }
+
+        MemoryGovernor::shared().release(MemoryGovernor::Subsystem::PREFETCH, frame.compressed.size() + frame.metadataJson.size());
+
+        const auto decodeStart = std::chrono::steady_clock::now();
+
+        decodePayload(frame.compressed.data(), frame.compressed.size(), frame.metadataJson, outData, outMetadata);
+        outTimestamp = frame.timestamp;
+
+        scan.decodeNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - decodeStart).count();
+        scan.framesDelivered++;
+
+        // Hill-climb the prefetch depth on a window of delivered frames:
+        // grow while the consumer hit an empty ring - decode is waiting on
+        // I/O - and shrink while the I/O thread was always ahead, giving
+        // back staging memory that buys nothing
+        if(scan.tune && scan.framesDelivered % 32 == 0) {
+            const uint64_t empty = scan.emptyWaits.load(std::memory_order_relaxed) - scan.lastEmptyWaits;
+            const uint64_t full = scan.fullWaits.load(std::memory_order_relaxed) - scan.lastFullWaits;
+
+            scan.lastEmptyWaits += empty;
+            scan.lastFullWaits += full;
+
+            const size_t ahead = scan.readAhead.load(std::memory_order_relaxed);
+
+            if(empty > 0 && ahead < scan.maxReadAhead)
+                scan.readAhead.store(ahead + 1, std::memory_order_relaxed);
+            else if(empty == 0 && full >= 16 && ahead > 1)
+                scan.readAhead.store(ahead - 1, std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+    void Decoder::endSequentialScan() {
+        if(!mScan)
+            return;
+
+        mScan->stop.store(true, std::memory_order_relaxed);
+
+        if(mScan->ioThread.joinable())
+            mScan->ioThread.join();
+
+        // Persist what a tuned scan learned, once it saw enough frames for
+        // the rates to mean anything
+        if(mScan->tune && mScan->framesDelivered >= 16 && !mPath.empty()) {
+            const uint64_t framesRead = std::max<uint64_t>(1, mScan->framesRead.load(std::memory_order_relaxed));
+            const uint64_t readPerFrame = mScan->readNanos.load(std::memory_order_relaxed) / framesRead;
+            const uint64_t decodePerFrame = mScan->decodeNanos / mScan->framesDelivered;
+            const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+
+            autotune::TunedProfile learned;
+
+            learned.readAhead = mScan->readAhead.load(std::memory_order_relaxed);
+
+            // Decode threads that keep pace with what the storage delivers:
+            // more cores than that just contend for frames that are not
+            // there yet
+            learned.decodeThreads = std::min<size_t>(hw,
+                std::max<uint64_t>(1, (decodePerFrame + std::max<uint64_t>(1, readPerFrame) - 1) / std::max<uint64_t>(1, readPerFrame)));
+
+            // Step the block-buffered read size toward the measured balance:
+            // bigger blocks when reads dominate the frame time, smaller when
+            // decode does and large blocks only drag in unwanted bytes
+            if(mBlockSize > 0) {
+                const size_t floor = mProfile == StorageProfile::NETWORK ? (1u << 20) : (256u << 10);
+                const size_t ceiling = mProfile == StorageProfile::NETWORK ? (8u << 20) : (4u << 20);
+
+                size_t blockSize = mBlockSize;
+
+                if(readPerFrame > 2 * decodePerFrame)
+                    blockSize = std::min(blockSize * 2, ceiling);
+                else if(4 * readPerFrame < decodePerFrame)
+                    blockSize = std::max(blockSize / 2, floor);
+
+                learned.blockSize = blockSize;
+            }
+            else
+                learned.blockSize = mTunedProfile.blockSize;
+
+            autotune::Store(mPath, learned);
+            mTunedProfile = learned;
+        }
+
+        // Frames still staged were charged to the prefetch subsystem
+        PrefetchedFrame drained[4];
+        size_t n;
+
+        while((n = mScan->ring.tryPopBatch(drained, 4)) > 0) {
+            for(size_t i = 0; i < n; i++)
+                MemoryGovernor::shared().release(MemoryGovernor::Subsystem::PREFETCH, drained[i].compressed.size() + drained[i].metadataJson.size());
+        }
+
+        mScan.reset();
+    }
+
+    namespace {
+        constexpr uint32_t INDEX_CACHE_MAGIC = 0x5843494D; // "MICX"
+        constexpr uint32_t INDEX_CACHE_VERSION = 8;
+
+        struct IndexCacheHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t fileSize;
+            int64_t fileMtime;
+            uint32_t numOffsets;
+            uint32_t numAudioOffsets;
+            uint32_t metadataLen;
+            uint32_t containerVersion;
+            uint32_t hasFrameSizes;         // The size arrays follow the offsets. Written for any
+                                            // container version once the sizes have been indexed.
+            uint32_t hasTypedMetadata;      // A TypedMetadataBlock follows the header
+            uint32_t hasAudioOverview;      // The overview arrays follow the metadata JSON:
+            uint32_t numOverviewBuckets;    // min, max and rms, numOverviewBuckets entries each
+            int64_t audioStartTimestampMs;  // Cached so audio opens skip the item walk entirely
+            int64_t thumbnailOffset;        // Embedded thumbnail item offset, -1 when none
+            uint32_t thumbnailSize;
+        };
+
+        constexpr uint32_t TYPED_METADATA_VERSION = 2;
+
+        // Flat image of ContainerMetadata, stored in the index cache right
+        // after the header. A cached open fills the typed fields straight
+        // from this block and skips the container JSON parse entirely; the
+        // JSON text still rides along for getContainerMetadata().
+        struct TypedMetadataBlock {
+            uint32_t version;
+            uint32_t sensorArrangement;     // ColorFilterArrangement
+            int32_t audioSampleRate;
+            int32_t audioChannels;
+            int32_t archiveCodec;
+            uint16_t blackLevel[4];
+            double whiteLevel;
+            double colorMatrix1[9];
+            double colorMatrix2[9];
+            double forwardMatrix1[9];
+            double forwardMatrix2[9];
+        };
+
+        void fillTypedMetadataBlock(const ContainerMetadata& metadata, TypedMetadataBlock& out) {
+            out.version = TYPED_METADATA_VERSION;
+            out.sensorArrangement = static_cast<uint32_t>(metadata.sensorArrangement);
+            out.audioSampleRate = metadata.audioSampleRate;
+            out.audioChannels = metadata.audioChannels;
+            out.archiveCodec = metadata.archiveCodec;
+            out.whiteLevel = metadata.whiteLevel;
+
+            std::copy(metadata.blackLevel.begin(), metadata.blackLevel.end(), out.blackLevel);
+            std::copy(metadata.colorMatrix1.begin(), metadata.colorMatrix1.end(), out.colorMatrix1);
+            std::copy(metadata.colorMatrix2.begin(), metadata.colorMatrix2.end(), out.colorMatrix2);
+            std::copy(metadata.forwardMatrix1.begin(), metadata.forwardMatrix1.end(), out.forwardMatrix1);
+            std::copy(metadata.forwardMatrix2.begin(), metadata.forwardMatrix2.end(), out.forwardMatrix2);
+        }
+
+        void applyTypedMetadataBlock(const TypedMetadataBlock& block, ContainerMetadata& out) {
+            out = ContainerMetadata{};
+
+            if(block.sensorArrangement <= static_cast<uint32_t>(ColorFilterArrangement::INVALID))
+                out.sensorArrangement = static_cast<ColorFilterArrangement>(block.sensorArrangement);
+
+            out.audioSampleRate = block.audioSampleRate;
+            out.audioChannels = block.audioChannels;
+            out.archiveCodec = block.archiveCodec;
+            out.whiteLevel = block.whiteLevel;
+
+            std::copy(std::begin(block.blackLevel), std::end(block.blackLevel), out.blackLevel.begin());
+            std::copy(std::begin(block.colorMatrix1), std::end(block.colorMatrix1), out.colorMatrix1.begin());
+            std::copy(std::begin(block.colorMatrix2), std::end(block.colorMatrix2), out.colorMatrix2.begin());
+            std::copy(std::begin(block.forwardMatrix1), std::end(block.forwardMatrix1), out.forwardMatrix1.begin());
+            std::copy(std::begin(block.forwardMatrix2), std::end(block.forwardMatrix2), out.forwardMatrix2.begin());
+        }
+
+        constexpr uint32_t CHECKSUM_SIDECAR_MAGIC = 0x5348434D; // "MCHS"
+        constexpr uint32_t CHECKSUM_SIDECAR_VERSION = 1;
+
+        // Header of the <path>.mchash sidecar, followed by numEntries
+        // ChecksumEntry records. Tied to the exact container like the index
+        // cache is, so a rewritten container invalidates stale references.
+        struct ChecksumSidecarHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t fileSize;
+            int64_t fileMtime;
+            int64_t numEntries;
+        };
+
+        // Size and mtime of the container, used to tie a cache to the exact
+        // file it was built from. Returns false if the file can't be stat'd.
+        bool statContainer(const std::string& path, uint64_t& outSize, int64_t& outMtime) {
+            struct stat st{};
+
+            if(stat(path.c_str(), &st) != 0)
+                return false;
+
+            outSize = static_cast<uint64_t>(st.st_size);
+            outMtime = static_cast<int64_t>(st.st_mtime);
+
+            return true;
+        }
+    }
+
+    void Decoder::ensureFrameSizes() {
+        // Version 4 indexes arrive with the size arrays filled; version 3
+        // containers only index the frame offsets, so the item sizes are
+        // harvested here with two batched header reads per frame. Once
+        // filled, frame loads become two exact preads and metadata scans
+        // skip straight to each metadata item - and the arrays persist in
+        // the index cache sidecar, so later opens never re-probe.
+        if(!mPayloadSizes.empty() || mFrameOffsets.empty())
+            return;
+
+        const size_t n = mFrameOffsets.size();
+
+        std::vector<Item> bufferItems(n);
+        std::vector<Item> metadataItems(n);
+        std::vector<ReadRequest> requests;
+
+        requests.reserve(n);
+
+        for(size_t i = 0; i < n; i++)
+            requests.push_back({ mFrameOffsets[i], sizeof(Item), &bufferItems[i] });
+
+        STAT_ADD(mStatNumSeeks, requests.size());
+        STAT_ADD(mStatBytesRead, requests.size() * sizeof(Item));
+
+        mReader->readBatch(requests);
+
+        requests.clear();
+
+        for(size_t i = 0; i < n; i++) {
+            if(bufferItems[i].type != Type::BUFFER && bufferItems[i].type != Type::COMPRESSED_BUFFER)
+                throw IOException("Invalid buffer type");
+
+            requests.push_back({ mFrameOffsets[i] + static_cast<int64_t>(sizeof(Item)) + bufferItems[i].size, sizeof(Item), &metadataItems[i] });
+        }
+
+        STAT_ADD(mStatNumSeeks, requests.size());
+        STAT_ADD(mStatBytesRead, requests.size() * sizeof(Item));
+
+        mReader->readBatch(requests);
+
+        mPayloadSizes.resize(n);
+        mMetadataSizes.resize(n);
+
+        for(size_t i = 0; i < n; i++) {
+            if(metadataItems[i].type != Type::METADATA) {
+                mPayloadSizes.clear();
+                mMetadataSizes.clear();
+
+                throw IOException("Invalid metadata");
+            }
+
+            mPayloadSizes[i] = bufferItems[i].size;
+            mMetadataSizes[i] = metadataItems[i].size;
+        }
+    }
+
+    bool Decoder::tryLoadIndexCache() {
+        uint64_t fileSize;
+        int64_t fileMtime;
+
+        if(!statContainer(mPath, fileSize, fileMtime))
+            return false;
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(fopen((mPath + ".mcidx").c_str(), "rb"), fclose);
+
+        if(!file)
+            return false;
+
+        IndexCacheHeader header{};
+
+        if(fread(&header, sizeof(IndexCacheHeader), 1, file.get()) != 1)
+            return false;
+
+        if(header.magic != INDEX_CACHE_MAGIC
+            || header.version != INDEX_CACHE_VERSION
+            || header.fileSize != fileSize
+            || header.fileMtime != fileMtime)
+        {
+            return false;
+        }
+
+        TypedMetadataBlock typed{};
+        bool haveTyped = false;
+
+        if(header.hasTypedMetadata) {
+            if(fread(&typed, sizeof(TypedMetadataBlock), 1, file.get()) != 1)
+                return false;
+
+            haveTyped = typed.version == TYPED_METADATA_VERSION;
+        }
+
+        std::vector<BufferOffset> offsets(header.numOffsets);
+        std::vector<BufferOffset> audioOffsets(header.numAudioOffsets);
+        std::vector<char> metadataJson(header.metadataLen);
+        std::vector<uint32_t> payloadSizes;
+        std::vector<uint32_t> metadataSizes;
+
+        if(header.numOffsets > 0 && fread(offsets.data(), sizeof(BufferOffset), offsets.size(), file.get()) != offsets.size())
+            return false;
+
+        if(header.hasFrameSizes && header.numOffsets > 0) {
+            payloadSizes.resize(header.numOffsets);
+            metadataSizes.resize(header.numOffsets);
+
+            if(fread(payloadSizes.data(), sizeof(uint32_t), payloadSizes.size(), file.get()) != payloadSizes.size())
+                return false;
+
+            if(fread(metadataSizes.data(), sizeof(uint32_t), metadataSizes.size(), file.get()) != metadataSizes.size())
+                return false;
+        }
+
+        if(header.numAudioOffsets > 0 && fread(audioOffsets.data(), sizeof(BufferOffset), audioOffsets.size(), file.get()) != audioOffsets.size())
+            return false;
+
+        if(header.metadataLen > 0 && fread(metadataJson.data(), 1, metadataJson.size(), file.get()) != metadataJson.size())
+            return false;
+
+        AudioOverview overview;
+
+        if(header.hasAudioOverview && header.numOverviewBuckets > 0) {
+            overview.minValue.resize(header.numOverviewBuckets);
+            overview.maxValue.resize(header.numOverviewBuckets);
+            overview.rms.resize(header.numOverviewBuckets);
+
+            if(fread(overview.minValue.data(), sizeof(int16_t), overview.minValue.size(), file.get()) != overview.minValue.size())
+                return false;
+
+            if(fread(overview.maxValue.data(), sizeof(int16_t), overview.maxValue.size(), file.get()) != overview.maxValue.size())
+                return false;
+
+            if(fread(overview.rms.data(), sizeof(uint16_t), overview.rms.size(), file.get()) != overview.rms.size())
+                return false;
+        }
+
+        nlohmann::json metadata;
+
+        if(!haveTyped) {
+            // Caches without the typed block pay the parse up front, as
+            // every open used to
+            metadata = nlohmann::json::parse(metadataJson.begin(), metadataJson.end(), nullptr, false);
+
+            if(metadata.is_discarded())
+                return false;
+        }
+
+        // Offsets were cached already sorted by timestamp
+        mVersion = static_cast<uint8_t>(header.containerVersion);
+
+        mFrameList.resize(offsets.size());
+        mFrameOffsets.resize(offsets.size());
+
+        for(size_t i = 0; i < offsets.size(); i++) {
+            mFrameList[i] = offsets[i].timestamp;
+            mFrameOffsets[i] = offsets[i].offset;
+        }
+
+        mPayloadSizes = std::move(payloadSizes);
+        mMetadataSizes = std::move(metadataSizes);
+        mAudioOffsets = std::move(audioOffsets);
+        mAudioStartTimestampMs = header.audioStartTimestampMs;
+        mThumbnailOffset = header.thumbnailOffset;
+        mThumbnailSize = header.thumbnailSize;
+        mAudioIndexLoaded = true;
+
+        if(header.hasAudioOverview) {
+            mAudioOverview = std::move(overview);
+            mAudioOverviewLoaded = true;
+        }
+
+        if(haveTyped) {
+            // Zero-parse open: the typed fields come straight from the
+            // block and the JSON text waits for getContainerMetadata()
+            applyTypedMetadataBlock(typed, mContainerMetadata);
+
+            mMetadata = nlohmann::json::object();
+            mMetadataJsonPending = std::move(metadataJson);
+        }
+        else {
+            mMetadata = std::move(metadata);
+
+            parseTypedMetadata();
+        }
+
+        return true;
+    }
+
+    void Decoder::writeIndexCache() const {
+        uint64_t fileSize;
+        int64_t fileMtime;
+
+        // Best effort, a failed write just means the next open re-indexes
+        if(!statContainer(mPath, fileSize, fileMtime))
+            return;
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(fopen((mPath + ".mcidx").c_str(), "wb"), fclose);
+
+        if(!file)
+            return;
+
+        // The cache stores the audio index, so it has to be located first
+        ensureAudioIndex();
+
+        // On a cached open the container JSON may still be waiting for
+        // getContainerMetadata(); carry the text as-is rather than dumping
+        // the empty placeholder
+        const std::string metadataJson = mMetadataJsonPending.empty()
+            ? mMetadata.dump()
+            : std::string(mMetadataJsonPending.begin(), mMetadataJsonPending.end());
+
+        IndexCacheHeader header{};
+        header.magic = INDEX_CACHE_MAGIC;
+        header.version = INDEX_CACHE_VERSION;
+        header.fileSize = fileSize;
+        header.fileMtime = fileMtime;
+        header.numOffsets = static_cast<uint32_t>(mFrameList.size());
+        header.numAudioOffsets = static_cast<uint32_t>(mAudioOffsets.size());
+        header.metadataLen = static_cast<uint32_t>(metadataJson.size());
+
+        // The size arrays are stored whenever they have been indexed - for
+        // version 4 containers always, for version 3 once ensureFrameSizes
+        // has harvested them - so a cached open of either version gets the
+        // exact-read frame path. A recovered version 4 file without sizes
+        // still reads correctly: the item-walk path handles both versions.
+        header.containerVersion = mVersion;
+        header.hasFrameSizes = mPayloadSizes.empty() ? 0 : 1;
+        header.hasTypedMetadata = 1;
+        header.hasAudioOverview = mAudioOverviewLoaded ? 1 : 0;
+        header.numOverviewBuckets = static_cast<uint32_t>(mAudioOverview.minValue.size());
+        header.audioStartTimestampMs = mAudioStartTimestampMs;
+        header.thumbnailOffset = mThumbnailOffset;
+        header.thumbnailSize = mThumbnailSize;
+
+        TypedMetadataBlock typed{};
+
+        fillTypedMetadataBlock(mContainerMetadata, typed);
+
+        // The sidecar keeps the interleaved offset record layout, so the
+        // flat in-memory arrays are re-zipped for the write
+        std::vector<BufferOffset> offsets(mFrameList.size());
+
+        for(size_t i = 0; i < offsets.size(); i++)
+            offsets[i] = BufferOffset { mFrameOffsets[i], mFrameList[i] };
+
+        fwrite(&header, sizeof(IndexCacheHeader), 1, file.get());
+        fwrite(&typed, sizeof(TypedMetadataBlock), 1, file.get());
+        fwrite(offsets.data(), sizeof(BufferOffset), offsets.size(), file.get());
+
+        if(!mPayloadSizes.empty()) {
+            fwrite(mPayloadSizes.data(), sizeof(uint32_t), mPayloadSizes.size(), file.get());
+            fwrite(mMetadataSizes.data(), sizeof(uint32_t), mMetadataSizes.size(), file.get());
+        }
+
+        fwrite(mAudioOffsets.data(), sizeof(BufferOffset), mAudioOffsets.size(), file.get());
+        fwrite(metadataJson.data(), 1, metadataJson.size(), file.get());
+
+        if(mAudioOverviewLoaded && !mAudioOverview.minValue.empty()) {
+            fwrite(mAudioOverview.minValue.data(), sizeof(int16_t), mAudioOverview.minValue.size(), file.get());
+            fwrite(mAudioOverview.maxValue.data(), sizeof(int16_t), mAudioOverview.maxValue.size(), file.get());
+            fwrite(mAudioOverview.rms.data(), sizeof(uint16_t), mAudioOverview.rms.size(), file.get());
+        }
+    }
+
+    namespace {
+        constexpr int CACHE_STATE_VERSION = 1;
+    }
+
+    void Decoder::saveCacheState(const std::string& directory) {
+        if(directory.empty() || mPath.empty())
+            return;
+
+        uint64_t fileSize;
+        int64_t fileMtime;
+
+        if(!statContainer(mPath, fileSize, fileMtime))
+            return;
+
+        // Spill every payload still held in memory into the saved area, so
+        // the next process finds them on disk next to the earlier evictions
+        const std::string previousSpillDir = mPayloadSpillDir;
+        mPayloadSpillDir = directory;
+
+        for(const auto& entry : mPayloadCacheList)
+            spillPayload(entry.first, entry.second);
+
+        mPayloadSpillDir = previousSpillDir;
+
+        nlohmann::json manifest;
+
+        manifest["version"] = CACHE_STATE_VERSION;
+        manifest["fileSize"] = fileSize;
+        manifest["fileMtime"] = fileMtime;
+
+        // The decoded-frame cache travels as keys only - pixels are cheap
+        // to regenerate from the spilled payloads - most recently used first
+        std::vector<Timestamp> frameKeys;
+        frameKeys.reserve(mCacheList.size());
+
+        for(const auto& entry : mCacheList)
+            frameKeys.push_back(entry.first);
+
+        manifest["frameKeys"] = frameKeys;
+
+        // Write-then-rename so a crash mid-save never leaves a torn manifest
+        const std::string manifestPath = directory + "/state.json";
+        const std::string tmpPath = manifestPath + ".tmp";
+
+        {
+            std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(tmpPath.c_str(), "wb"), fclose);
+
+            if(!file)
+                return;
+
+            const std::string text = manifest.dump();
+
+            if(fwrite(text.data(), 1, text.size(), file.get()) != text.size())
+                return;
+        }
+
+        std::rename(tmpPath.c_str(), manifestPath.c_str());
+    }
+
+    std::vector<Timestamp> Decoder::restoreCacheState(const std::string& directory) {
+        if(directory.empty() || mPath.empty())
+            return {};
+
+        std::string text;
+
+        {
+            std::unique_ptr<FILE, int(*)(FILE*)> file(fopen((directory + "/state.json").c_str(), "rb"), fclose);
+
+            if(!file)
+                return {};
+
+            char chunk[4096];
+            size_t n;
+
+            while((n = fread(chunk, 1, sizeof(chunk), file.get())) > 0)
+                text.append(chunk, n);
+        }
+
+        nlohmann::json manifest = nlohmann::json::parse(text, nullptr, false);
+
+        if(manifest.is_discarded() || manifest.value("version", 0) != CACHE_STATE_VERSION)
+            return {};
+
+        // A container that changed since the save invalidates everything in
+        // the area: the spilled payloads may describe frames that no longer
+        // exist at those timestamps
+        uint64_t fileSize;
+        int64_t fileMtime;
+
+        if(!statContainer(mPath, fileSize, fileMtime)
+            || manifest.value("fileSize", static_cast<uint64_t>(0)) != fileSize
+            || manifest.value("fileMtime", static_cast<int64_t>(-1)) != fileMtime)
+        {
+            return {};
+        }
+
+        // Adopt the saved area as the spill directory: payloads repopulate
+        // lazily from it as frames are touched, no eager reads here
+        mPayloadSpillDir = directory;
+
+        // Keys that no longer resolve to a frame are dropped rather than
+        // handed back for a pre-warm that would throw
+        std::vector<Timestamp> frameKeys;
+
+        for(const auto& key : manifest.value("frameKeys", std::vector<Timestamp>())) {
+            if(findFrameIndex(key) >= 0)
+                frameKeys.push_back(key);
+        }
+
+        return frameKeys;
+    }
+
+    void Decoder::enableChecksumVerification() {
+        if(mChecksums.empty() && !tryLoadChecksums())
+            throw IOException("No reference checksums found");
+
+        mVerifyChecksums = true;
+    }
+
+    void Decoder::disableChecksumVerification() {
+        mVerifyChecksums = false;
+    }
+
+    void Decoder::enableStreamingStores() {
+        mStreamingStores = true;
+    }
+
+    void Decoder::disableStreamingStores() {
+        mStreamingStores = false;
+    }
+
+    void Decoder::setDecodeQoS(const raw::DecodeQoS qos) {
+        mDecodeQoS = qos;
+    }
+
+    void Decoder::verifyPayload(const Timestamp timestamp, const uint8_t* payload, size_t len) const {
+        auto it = mChecksums.find(timestamp);
+
+        // Frames without a reference pass; a partial index (e.g. frames
+        // appended after the sidecar was written) still covers the rest
+        if(it == mChecksums.end())
+            return;
+
+        if(Hash64(payload, len) != it->second)
+            throw ChecksumException("Frame checksum mismatch (timestamp: " + std::to_string(timestamp) + ")");
+    }
+
+    bool Decoder::tryLoadChecksums() {
+        if(tryLoadChecksumSidecar())
+            return true;
+
+        // Fall back to a CHECKSUM_INDEX item; writers place it after the
+        // last frame, so the walk starts there
+        if(mFrameOffsets.empty())
+            return false;
+
+        if(!seek(mFrameOffsets[mFrameOffsets.size() - 1], SEEK_SET))
+            return false;
+
+        while(true) {
+            Item item{};
+
+            if(!mReader->tryRead(&item, sizeof(Item)))
+                return false;
+
+            if(item.type == Type::CHECKSUM_INDEX)
+                break;
+
+            // Skip everything else that can legitimately follow the last frame
+            if(item.type != Type::BUFFER && item.type != Type::COMPRESSED_BUFFER
+                && item.type != Type::METADATA
+                && item.type != Type::AUDIO_INDEX && item.type != Type::AUDIO_DATA
+                && item.type != Type::AUDIO_DATA_METADATA && item.type != Type::PADDING)
+            {
+                return false;
+            }
+
+            if(!seek(item.size, SEEK_CUR))
+                return false;
+        }
+
+        ChecksumIndex index{};
+        read(&index, sizeof(ChecksumIndex));
+
+        if(index.magicNumber != static_cast<int32_t>(INDEX_MAGIC_NUMBER) || index.numEntries < 0)
+            return false;
+
+        std::vector<ChecksumEntry> entries(index.numEntries);
+        read(entries.data(), sizeof(ChecksumEntry), entries.size());
+
+        mChecksums.clear();
+        mChecksums.reserve(entries.size());
+
+        for(const auto& e : entries)
+            mChecksums[e.timestamp] = e.hash;
+
+        return !mChecksums.empty();
+    }
+
+    bool Decoder::tryLoadChecksumSidecar() {
+        if(mPath.empty())
+            return false;
+
+        uint64_t fileSize;
+        int64_t fileMtime;
+
+        if(!statContainer(mPath, fileSize, fileMtime))
+            return false;
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(fopen((mPath + ".mchash").c_str(), "rb"), fclose);
+
+        if(!file)
+            return false;
+
+        ChecksumSidecarHeader header{};
+
+        if(fread(&header, sizeof(ChecksumSidecarHeader), 1, file.get()) != 1)
+            return false;
+
+        if(header.magic != CHECKSUM_SIDECAR_MAGIC
+            || header.version != CHECKSUM_SIDECAR_VERSION
+            || header.fileSize != fileSize
+            || header.fileMtime != fileMtime
+            || header.numEntries < 0)
+        {
+            return false;
+        }
+
+        std::vector<ChecksumEntry> entries(header.numEntries);
+
+        if(!entries.empty() && fread(entries.data(), sizeof(ChecksumEntry), entries.size(), file.get()) != entries.size())
+            return false;
+
+        mChecksums.clear();
+        mChecksums.reserve(entries.size());
+
+        for(const auto& e : entries)
+            mChecksums[e.timestamp] = e.hash;
+
+        return !mChecksums.empty();
+    }
+
+    void Decoder::writeChecksumSidecar() {
+        if(mPath.empty())
+            throw IOException("Decoder was not opened by path");
+
+        uint64_t fileSize;
+        int64_t fileMtime;
+
+        if(!statContainer(mPath, fileSize, fileMtime))
+            throw IOException("Failed to stat " + mPath);
+
+        std::vector<ChecksumEntry> entries;
+        entries.reserve(mFrameList.size());
+
+        std::vector<uint8_t> metadataJson;
+
+        for(const auto timestamp : mFrameList) {
+            size_t compressedLen = 0;
+            const uint8_t* compressed = readFramePayload(timestamp, compressedLen, metadataJson);
+
+            entries.push_back({ timestamp, Hash64(compressed, compressedLen) });
+        }
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(fopen((mPath + ".mchash").c_str(), "wb"), fclose);
+
+        if(!file)
+            throw IOException("Failed to create " + mPath + ".mchash");
+
+        ChecksumSidecarHeader header{};
+        header.magic = CHECKSUM_SIDECAR_MAGIC;
+        header.version = CHECKSUM_SIDECAR_VERSION;
+        header.fileSize = fileSize;
+        header.fileMtime = fileMtime;
+        header.numEntries = static_cast<int64_t>(entries.size());
+
+        if(fwrite(&header, sizeof(ChecksumSidecarHeader), 1, file.get()) != 1
+            || (!entries.empty() && fwrite(entries.data(), sizeof(ChecksumEntry), entries.size(), file.get()) != entries.size()))
+        {
+            throw IOException("Failed to write " + mPath + ".mchash");
+        }
+
+        // The freshly computed hashes double as loaded references
+        mChecksums.clear();
+        mChecksums.reserve(entries.size());
+
+        for(const auto& e : entries)
+            mChecksums[e.timestamp] = e.hash;
+    }
+
+    void Decoder::readIndex() {
+        // Seek to index item. An interrupted capture never gets its trailing
+        // index written, so any failure here goes through index recovery
+        // rather than rejecting the file outright.
+        if(!seek(-static_cast<int64_t>(sizeof(BufferIndex) + sizeof(Item)), SEEK_END)) {
+            recoverIndex();
+            return;
+        }
+
+        Item bufferIndexItem{};
+
+        if(!mReader->tryRead(&bufferIndexItem, sizeof(Item)) || bufferIndexItem.type != Type::BUFFER_INDEX) {
+            recoverIndex();
+            return;
+        }
+
+        BufferIndex index{};
+        read(&index, sizeof(BufferIndex));
+
+        // Check validity of index
+        if(index.magicNumber != INDEX_MAGIC_NUMBER) {
+            recoverIndex();
+            return;
+        }
+
+        // Read the index
+        if(!seek(index.indexDataOffset, SEEK_SET)) {
+            throw IOException("Invalid index");
+            return;
+        }
+
+        if(mStreamingIndex) {
+            // Only the first chunk is read here; refreshIndex() pulls the
+            // rest, so the first frame decodes without waiting on a
+            // million-record read and sort
+            mIndexReadPos = index.indexDataOffset;
+            mIndexRemaining = index.numOffsets;
+
+            readIndexChunk();
+            return;
+        }
+
+        readIndexEntries(index.numOffsets);
+    }
+
+    // Records per streaming index chunk: about 1MB of index per pull, small
+    // enough that the first frames are decodable in milliseconds
+    constexpr uint32_t STREAMING_INDEX_CHUNK_ENTRIES = 64 * 1024;
+
+    size_t Decoder::readIndexChunk() {
+        if(mIndexRemaining == 0)
+            return 0;
+
+        const uint32_t count = std::min(STREAMING_INDEX_CHUNK_ENTRIES, mIndexRemaining);
+
+        if(!seek(mIndexReadPos, SEEK_SET))
+            throw IOException("Invalid index");
+
+        const size_t base = mFrameList.size();
+
+        mFrameList.resize(base + count);
+        mFrameOffsets.resize(base + count);
+
+        if(mVersion == CONTAINER_VERSION_4) {
+            std::vector<BufferOffsetV4> offsets(count);
+
+            read(offsets.data(), sizeof(BufferOffsetV4), count);
+
+            mPayloadSizes.resize(base + count);
+            mMetadataSizes.resize(base + count);
+
+            for(size_t i = 0; i < count; i++) {
+                mFrameList[base + i] = offsets[i].timestamp;
+                mFrameOffsets[base + i] = offsets[i].offset;
+                mPayloadSizes[base + i] = offsets[i].payloadSize;
+                mMetadataSizes[base + i] = offsets[i].metadataSize;
+            }
+
+            mIndexReadPos += static_cast<int64_t>(count) * sizeof(BufferOffsetV4);
+        }
+        else {
+            std::vector<BufferOffset> offsets(count);
+
+            read(offsets.data(), sizeof(BufferOffset), count);
+
+            for(size_t i = 0; i < count; i++) {
+                mFrameList[base + i] = offsets[i].timestamp;
+                mFrameOffsets[base + i] = offsets[i].offset;
+            }
+
+            mIndexReadPos += static_cast<int64_t>(count) * sizeof(BufferOffset);
+        }
+
+        mIndexRemaining -= count;
+
+        return count;
+    }
+
+    size_t Decoder::refreshIndex() {
+        const size_t oldSize = mFrameList.size();
+        const size_t added = readIndexChunk();
+
+        if(added == 0)
+            return 0;
+
+        // Captures are recorded nearly in order, so the common case is a
+        // chunk that extends the sorted list: one pass confirms it, and
+        // anything else goes through the full permutation sort
+        bool sorted = true;
+
+        for(size_t i = std::max<size_t>(oldSize, 1); i < mFrameList.size(); i++) {
+            if(mFrameList[i] < mFrameList[i - 1]
+                || (mFrameList[i] == mFrameList[i - 1] && mFrameOffsets[i] <= mFrameOffsets[i - 1]))
+            {
+                sorted = false;
+                break;
+            }
+        }
+
+        if(!sorted)
+            reindexOffsets();
+
+        return added;
+    }
+
+    bool Decoder::indexComplete() const {
+        return mIndexRemaining == 0;
+    }
+
+    void Decoder::readIndexEntries(uint32_t numOffsets) {
+        if(mVersion == CONTAINER_VERSION_4) {
+            // Version 4 entries carry the payload and metadata sizes
+            std::vector<BufferOffsetV4> offsets(numOffsets);
+
+            read(offsets.data(), sizeof(BufferOffsetV4), offsets.size());
+
+            mFrameList.resize(offsets.size());
+            mFrameOffsets.resize(offsets.size());
+            mPayloadSizes.resize(offsets.size());
+            mMetadataSizes.resize(offsets.size());
+
+            for(size_t i = 0; i < offsets.size(); i++) {
+                mFrameList[i] = offsets[i].timestamp;
+                mFrameOffsets[i] = offsets[i].offset;
+                mPayloadSizes[i] = offsets[i].payloadSize;
+                mMetadataSizes[i] = offsets[i].metadataSize;
+            }
+        }
+        else {
+            std::vector<BufferOffset> offsets(numOffsets);
+
+            read(offsets.data(), sizeof(BufferOffset), offsets.size());
+
+            mFrameList.resize(offsets.size());
+            mFrameOffsets.resize(offsets.size());
+
+            for(size_t i = 0; i < offsets.size(); i++) {
+                mFrameList[i] = offsets[i].timestamp;
+                mFrameOffsets[i] = offsets[i].offset;
+            }
+        }
+    }
+
+    bool Decoder::tryReadLeadingIndex(int64_t resumeOffset) {
+        Item indexItem{};
+
+        if(!mReader->tryRead(&indexItem, sizeof(Item))) {
+            seek(resumeOffset, SEEK_SET);
+            return false;
+        }
+
+        // Repacked containers may embed a poster-frame thumbnail between
+        // the camera metadata and the leading index; note where it lives
+        // for loadThumbnail and move on to the index
+        if(indexItem.type == Type::THUMBNAIL) {
+            mThumbnailOffset = resumeOffset;
+            mThumbnailSize = indexItem.size;
+
+            if(!seek(indexItem.size, SEEK_CUR) || !mReader->tryRead(&indexItem, sizeof(Item))) {
+                seek(resumeOffset, SEEK_SET);
+                return false;
+            }
+        }
+
+        if(indexItem.type != Type::BUFFER_INDEX) {
+            seek(resumeOffset, SEEK_SET);
+            return false;
+        }
+
+        BufferIndex index{};
+
+        if(!mReader->tryRead(&index, sizeof(BufferIndex)) || index.magicNumber != INDEX_MAGIC_NUMBER) {
+            seek(resumeOffset, SEEK_SET);
+            return false;
+        }
+
+        Item indexDataItem{};
+        read(&indexDataItem, sizeof(Item));
+
+        if(indexDataItem.type != Type::BUFFER_INDEX_DATA)
+            throw IOException("Invalid index");
+
+        readIndexEntries(index.numOffsets);
+
+        // A leading audio index follows the frame index when there is audio
+        Item audioIndexItem{};
+
+        if(mReader->tryRead(&audioIndexItem, sizeof(Item)) && audioIndexItem.type == Type::AUDIO_INDEX) {
+            AudioIndex audioIndex{};
+
+            read(&audioIndex, sizeof(AudioIndex));
+
+            mAudioStartTimestampMs = audioIndex.startTimestampMs;
+
+            mAudioOffsets.resize(audioIndex.numOffsets);
+
+            read(mAudioOffsets.data(), sizeof(BufferOffset), mAudioOffsets.size());
+        }
 
-    Decoder::Decoder(const std::string& path) : mFile(std::fopen(path.c_str(), "rb")) {
-        if(!mFile)
-            throw IOException("Failed to open " + path);
-            
-        init();
+        return true;
     }
-    
-    Decoder::~Decoder() {
-        if(mFile)
-            std::fclose(mFile);
-    }
-    
-    void Decoder::init() {
-        Header header{};
-        
-        // Check validity of file
-        read(&header, sizeof(Header));
 
-        // Support current version and also version 3
-        if((header.version != CONTAINER_VERSION))
-            throw IOException("Invalid container version");
+    void Decoder::recoverIndex() {
+        const int64_t fileSize = mReader->size();
 
-        if(std::memcmp(header.ident, CONTAINER_ID, sizeof(CONTAINER_ID)) != 0)
-            throw IOException("Invalid header id");
+        if(fileSize <= static_cast<int64_t>(sizeof(Header)))
+            throw IOException("Corrupted file");
 
-        // Read camera metadata
-        Item metadataItem{};
-        read(&metadataItem, sizeof(Item));
-        
-        if(metadataItem.type != Type::METADATA)
-            throw IOException("Invalid camera metadata");
-        
-        std::vector<uint8_t> metadataJson(metadataItem.size);
-        read(metadataJson.data(), metadataItem.size);
-        
-        // Keep the camera metadata
-        auto cameraMetadataString = std::string(metadataJson.begin(), metadataJson.end());
-        mMetadata = nlohmann::json::parse(cameraMetadataString);
-  
-        readIndex();
-
-        reindexOffsets();
+        constexpr uint32_t MAX_ITEM_SIZE = 512u * 1024u * 1024u;
+        constexpr uint32_t MAX_METADATA_SIZE = 4u * 1024u * 1024u;
 
-        readExtra();
-    }
-    
-    const std::vector<Timestamp>& Decoder::getFrames() const {
-        return mFrameList;
-    }
-    
-    const nlohmann::json& Decoder::getContainerMetadata() const {
-        return mMetadata;
-    }
-    
-    int Decoder::audioSampleRateHz() const {
-        return mMetadata["extraData"]["audioSampleRate"];
-    }
-    
-    int Decoder::numAudioChannels() const {
-        return mMetadata["extraData"]["audioChannels"];
-    }
-    
-    void Decoder::loadAudio(std::vector<AudioChunk>& outAudioChunks) {
-        for(const auto& o : mAudioOffsets) {
-            if(FSEEK(mFile, o.offset, SEEK_SET) != 0)
-                break;
-            
-            // Get audio data header
-            Item audioDataItem{};
-            read(&audioDataItem, sizeof(Item));
-            
-            if(audioDataItem.type != Type::AUDIO_DATA)
-                throw IOException("Invalid audio data");
-            
-            // Read into temporary buffer
-            std::vector<int16_t> tmp;
+        // Confirm a candidate frame record: a BUFFER item followed by a
+        // METADATA item whose JSON scans out frame dimensions. Returns the
+        // offset of the record after the pair, or -1 if the candidate is not
+        // a frame.
+        auto confirmFrame = [&](Reader& reader, int64_t offset, BufferOffset& outFrame) -> int64_t {
+            Item bufferItem{};
 
-            tmp.resize((audioDataItem.size + 1) / 2);
-            read((void*)tmp.data(), audioDataItem.size);
+            if(!reader.seek(offset, SEEK_SET) || !reader.tryRead(&bufferItem, sizeof(Item)))
+                return -1;
 
-            // Metadata should follow (this was added later so some files may not have it)
-            Item audioMetadataItem{};
-            read(&audioMetadataItem, sizeof(Item));
-            
-            Timestamp audioTimestamp = -1;
-            
-            if(audioMetadataItem.type == Type::AUDIO_DATA_METADATA) {
-                AudioMetadata metadata;
-                
-                read(&metadata, sizeof(AudioMetadata));
-                audioTimestamp = metadata.timestampNs;
+            if((bufferItem.type != Type::BUFFER && bufferItem.type != Type::COMPRESSED_BUFFER)
+                || bufferItem.size == 0 || bufferItem.size > MAX_ITEM_SIZE)
+            {
+                return -1;
+            }
+
+            const int64_t metadataPos = offset + sizeof(Item) + bufferItem.size;
+            Item metadataItem{};
+
+            if(!reader.seek(metadataPos, SEEK_SET) || !reader.tryRead(&metadataItem, sizeof(Item)))
+                return -1;
+
+            if(metadataItem.type != Type::METADATA || metadataItem.size == 0 || metadataItem.size > MAX_METADATA_SIZE)
+                return -1;
+
+            std::vector<uint8_t> json(metadataItem.size);
+
+            if(!reader.tryRead(json.data(), json.size()))
+                return -1;
+
+            long width, height, compressionType;
+
+            if(!scanJsonInt(json, "width", width)
+                || !scanJsonInt(json, "height", height)
+                || !scanJsonInt(json, "compressionType", compressionType))
+            {
+                return -1;
+            }
+
+            long timestamp;
+
+            outFrame.offset = offset;
+            outFrame.timestamp = scanJsonInt(json, "timestamp", timestamp) ? timestamp : -1;
+
+            return metadataPos + static_cast<int64_t>(sizeof(Item)) + metadataItem.size;
+        };
+
+        // Scan one file segment for frames starting inside it. Byte-probes
+        // for a confirmed frame to synchronize, then hops record to record
+        // through the length prefixes until the chain breaks, and reprobes.
+        auto scanSegment = [&, fileSize](Reader& reader, int64_t begin, const int64_t end, std::vector<BufferOffset>& out) {
+            constexpr int64_t CHUNK = 4 * 1024 * 1024;
+
+            std::vector<uint8_t> buffer;
+            int64_t pos = begin;
+
+            while(pos + static_cast<int64_t>(sizeof(Item)) <= end) {
+                const size_t want = static_cast<size_t>(std::min(CHUNK, fileSize - pos));
+
+                buffer.resize(want);
+
+                if(!reader.seek(pos, SEEK_SET) || !reader.tryRead(buffer.data(), want))
+                    return;
+
+                int64_t resumeAt = -1;
+
+                for(size_t q = 0; q + sizeof(Item) <= want && pos + static_cast<int64_t>(q) < end; q++) {
+                    uint32_t type;
+                    std::memcpy(&type, buffer.data() + q, sizeof(type));
+
+                    if(type != static_cast<uint32_t>(Type::BUFFER)
+                        && type != static_cast<uint32_t>(Type::COMPRESSED_BUFFER))
+                    {
+                        continue;
+                    }
+
+                    BufferOffset frame{};
+                    int64_t next = confirmFrame(reader, pos + q, frame);
+
+                    if(next < 0)
+                        continue;
+
+                    // Synchronized, follow the chain of length-prefixed items
+                    out.push_back(frame);
+
+                    int64_t chainPos = next;
+
+                    while(chainPos + static_cast<int64_t>(sizeof(Item)) <= end) {
+                        Item item{};
+
+                        if(!reader.seek(chainPos, SEEK_SET) || !reader.tryRead(&item, sizeof(Item)))
+                            break;
+
+                        if(item.size > MAX_ITEM_SIZE)
+                            break;
+
+                        if(item.type == Type::BUFFER || item.type == Type::COMPRESSED_BUFFER) {
+                            BufferOffset f{};
+                            int64_t n = confirmFrame(reader, chainPos, f);
+
+                            if(n < 0)
+                                break;
+
+                            out.push_back(f);
+                            chainPos = n;
+                        }
+                        else if(item.type == Type::METADATA || item.type == Type::AUDIO_DATA || item.type == Type::AUDIO_DATA_METADATA || item.type == Type::BUFFER_INDEX_DATA || item.type == Type::PADDING) {
+                            chainPos += static_cast<int64_t>(sizeof(Item)) + item.size;
+                        }
+                        else {
+                            break;
+                        }
+                    }
+
+                    resumeAt = std::max(chainPos, pos + static_cast<int64_t>(q) + 1);
+                    break;
+                }
+
+                if(resumeAt < 0)
+                    pos += static_cast<int64_t>(want) - (static_cast<int64_t>(sizeof(Item)) - 1);
+                else
+                    pos = resumeAt;
             }
+        };
 
-            // Add audio chunk
-            outAudioChunks.push_back(std::make_pair(audioTimestamp, std::move(tmp)));
+        const int64_t begin = sizeof(Header);
+
+        std::vector<BufferOffset> recovered;
+
+        // Large files opened by path are scanned with one worker per segment,
+        // each on its own file handle; otherwise scan in place
+        constexpr int64_t MIN_SEGMENT = 64 * 1024 * 1024;
+
+        const size_t numWorkers = mPath.empty()
+            ? 1
+            : std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), std::max<int64_t>(1, (fileSize - begin) / MIN_SEGMENT));
+
+        if(numWorkers <= 1) {
+            scanSegment(*mReader, begin, fileSize, recovered);
         }
-    }
-    
-    void Decoder::loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata) {
-        if(mFrameOffsetMap.find(timestamp) == mFrameOffsetMap.end())
-            throw IOException("Frame not found (timestamp: " + std::to_string(timestamp) + ")");
-        
-        int64_t offset = mFrameOffsetMap.at(timestamp).offset;
-        
-        if(FSEEK(mFile, offset, SEEK_SET) != 0)
-            throw IOException("Invalid offset");
-        
-        Item bufferItem{};
-        read(&bufferItem, sizeof(Item));
+        else {
+            TaskGroup group;
+            std::vector<std::vector<BufferOffset>> results(numWorkers);
+            const int64_t span = (fileSize - begin + numWorkers - 1) / numWorkers;
 
-        if(bufferItem.type != Type::BUFFER)
-            throw IOException("Invalid buffer type");
+            for(size_t w = 0; w < numWorkers; w++) {
+                group.run(ThreadPool::shared(), Priority::IO, [&, w] {
+                    FileReader reader(mPath);
+                    const int64_t segBegin = begin + w*span;
+                    const int64_t segEnd = std::min(fileSize, segBegin + span);
 
-        mTmpBuffer.resize(bufferItem.size);
+                    scanSegment(reader, segBegin, segEnd, results[w]);
+                });
+            }
 
-        read(mTmpBuffer.data(), bufferItem.size);
-                
-        // Get metadata
-        Item metadataItem{};
-        read(&metadataItem, sizeof(Item));
-        
-        if(metadataItem.type != Type::METADATA)
-            throw IOException("Invalid metadata");
-        
-        std::vector<uint8_t> metadataJson(metadataItem.size);
-        read(metadataJson.data(), metadataItem.size);
-        
-        std::string metadataString = std::string(metadataJson.begin(), metadataJson.end());
-        outMetadata = nlohmann::json::parse(metadataString);        
-        
-        const int width = outMetadata["width"];
-        const int height = outMetadata["height"];
-        const int compressionType = outMetadata["compressionType"];
-        
-        if(compressionType != MOTIONCAM_COMPRESSION_TYPE)
-            throw IOException("Invalid compression type");
-            
-        // Decompress the buffer
-        const size_t outputSizeBytes = sizeof(uint16_t) * width*height;
-        outData.resize(outputSizeBytes);
-        
-        if(raw::Decode(outData.data(), width, height, mTmpBuffer.data(), mTmpBuffer.size()) <= 0)
-            throw IOException("Failed to uncompress frame");
-    }
+            group.wait();
 
-    void Decoder::readIndex() {
-        // Seek to index item
-        if(FSEEK(mFile, -static_cast<long>(sizeof(BufferIndex) + sizeof(Item)), SEEK_END) != 0)
-            throw IOException("Failed to get end chunk");
+            for(auto& r : results)
+                recovered.insert(recovered.end(), r.begin(), r.end());
+        }
 
-        Item bufferIndexItem{};
-        read(&bufferIndexItem, sizeof(Item));
-        
-        if(bufferIndexItem.type != Type::BUFFER_INDEX)
-            throw IOException("Invalid file");
-        
-        BufferIndex index{};
-        read(&index, sizeof(BufferIndex));
-        
-        // Check validity of index
-        if(index.magicNumber != INDEX_MAGIC_NUMBER)
+        if(recovered.empty())
             throw IOException("Corrupted file");
-        
-        mOffsets.resize(index.numOffsets);
-        
-        // Read the index
-        if(FSEEK(mFile, index.indexDataOffset, SEEK_SET) != 0) {
-            throw IOException("Invalid index");
-            return;
+
+        // Segments can overlap at their boundaries, deduplicate by offset
+        std::sort(recovered.begin(), recovered.end(), [](const BufferOffset& a, const BufferOffset& b) {
+            return a.offset < b.offset;
+        });
+
+        recovered.erase(std::unique(recovered.begin(), recovered.end(), [](const BufferOffset& a, const BufferOffset& b) {
+            return a.offset == b.offset;
+        }), recovered.end());
+
+        // Old files don't carry a timestamp in the frame metadata; number the
+        // frames by file order so every frame keeps a unique key
+        const bool haveTimestamps = std::all_of(recovered.begin(), recovered.end(), [](const BufferOffset& o) {
+            return o.timestamp >= 0;
+        });
+
+        if(!haveTimestamps) {
+            for(size_t i = 0; i < recovered.size(); i++)
+                recovered[i].timestamp = static_cast<Timestamp>(i);
+        }
+
+        mFrameList.resize(recovered.size());
+        mFrameOffsets.resize(recovered.size());
+
+        for(size_t i = 0; i < recovered.size(); i++) {
+            mFrameList[i] = recovered[i].timestamp;
+            mFrameOffsets[i] = recovered[i].offset;
         }
-        
-        read(mOffsets.data(), sizeof(BufferOffset), mOffsets.size());
     }
-    
+
     void Decoder::reindexOffsets() {
-        // Sort offsets so they are in order of timestamps
-        std::sort(mOffsets.begin(), mOffsets.end(), [](const auto& a, const auto&b) {
-            return a.timestamp < b.timestamp;
-        });
-        
-        mFrameList.clear();
-        mFrameOffsetMap.clear();
-        
-        for(const auto& i : mOffsets) {
-            mFrameList.push_back(i.timestamp);
-            mFrameOffsetMap.insert({ i.timestamp, i });
+        // Order by timestamp, offset breaking ties, so duplicate records
+        // always end up adjacent. Captures are usually recorded already
+        // ordered, so one linear pass replaces the sort in the common case
+        // and spots the out-of-order entries at the same time.
+        const auto before = [this](const size_t a, const size_t b) {
+            return mFrameList[a] < mFrameList[b]
+                || (mFrameList[a] == mFrameList[b] && mFrameOffsets[a] < mFrameOffsets[b]);
+        };
+
+        bool sorted = true;
+
+        for(size_t i = 1; i < mFrameList.size(); i++) {
+            if(before(i, i - 1)) {
+                sorted = false;
+                break;
+            }
+        }
+
+        if(!sorted) {
+            // Sort a permutation so every parallel array - timestamps,
+            // offsets and the version 4 size arrays - can follow the same
+            // order
+            std::vector<size_t> order(mFrameList.size());
+
+            for(size_t i = 0; i < order.size(); i++)
+                order[i] = i;
+
+            const auto& byTimestamp = before;
+
+            // Multi-hour recovered or badly interleaved indexes are the
+            // longest single-threaded stretch of open, so large ones sort
+            // across the shared pool: chunks sort concurrently, then each
+            // merge level runs its disjoint merges concurrently too
+            constexpr size_t PARALLEL_SORT_THRESHOLD = 1u << 17;
+
+            if(order.size() >= PARALLEL_SORT_THRESHOLD && ThreadPool::shared().numThreads() > 1) {
+                ThreadPool& pool = ThreadPool::shared();
+
+                const size_t numChunks = std::min<size_t>(pool.numThreads(), 64);
+
+                std::vector<size_t> bounds(numChunks + 1);
+
+                for(size_t k = 0; k <= numChunks; k++)
+                    bounds[k] = k * order.size() / numChunks;
+
+                {
+                    TaskGroup group;
+
+                    for(size_t k = 0; k < numChunks; k++)
+                        group.run(pool, Priority::DECODE, [&order, &bounds, &byTimestamp, k] {
+                            std::sort(order.begin() + bounds[k], order.begin() + bounds[k + 1], byTimestamp);
+                        });
+
+                    group.wait();
+                }
+
+                for(size_t width = 1; width < numChunks; width *= 2) {
+                    TaskGroup group;
+
+                    for(size_t k = 0; k + width < numChunks; k += 2 * width) {
+                        const size_t mid = bounds[k + width];
+                        const size_t last = bounds[std::min(k + 2 * width, numChunks)];
+
+                        group.run(pool, Priority::DECODE, [&order, &bounds, &byTimestamp, k, mid, last] {
+                            std::inplace_merge(order.begin() + bounds[k], order.begin() + mid, order.begin() + last, byTimestamp);
+                        });
+                    }
+
+                    group.wait();
+                }
+            }
+            else {
+                std::sort(order.begin(), order.end(), byTimestamp);
+            }
+
+            std::vector<Timestamp> frameList(mFrameList.size());
+            std::vector<int64_t> frameOffsets(mFrameList.size());
+
+            for(size_t i = 0; i < order.size(); i++) {
+                frameList[i] = mFrameList[order[i]];
+                frameOffsets[i] = mFrameOffsets[order[i]];
+            }
+
+            if(!mPayloadSizes.empty()) {
+                std::vector<uint32_t> payloadSizes(mFrameList.size());
+                std::vector<uint32_t> metadataSizes(mFrameList.size());
+
+                for(size_t i = 0; i < order.size(); i++) {
+                    payloadSizes[i] = mPayloadSizes[order[i]];
+                    metadataSizes[i] = mMetadataSizes[order[i]];
+                }
+
+                mPayloadSizes = std::move(payloadSizes);
+                mMetadataSizes = std::move(metadataSizes);
+            }
+
+            mFrameList = std::move(frameList);
+            mFrameOffsets = std::move(frameOffsets);
+        }
+
+        // Exact duplicate records - the same frame indexed twice, as a
+        // doubly written or recovered index produces - collapse to one.
+        // Distinct frames that merely share a timestamp are kept.
+        if(!mFrameList.empty()) {
+            size_t w = 1;
+
+            for(size_t i = 1; i < mFrameList.size(); i++) {
+                if(mFrameList[i] == mFrameList[w - 1] && mFrameOffsets[i] == mFrameOffsets[w - 1])
+                    continue;
+
+                if(w != i) {
+                    mFrameList[w] = mFrameList[i];
+                    mFrameOffsets[w] = mFrameOffsets[i];
+
+                    if(!mPayloadSizes.empty()) {
+                        mPayloadSizes[w] = mPayloadSizes[i];
+                        mMetadataSizes[w] = mMetadataSizes[i];
+                    }
+                }
+
+                w++;
+            }
+
+            if(w != mFrameList.size()) {
+                mFrameList.resize(w);
+                mFrameOffsets.resize(w);
+
+                if(!mPayloadSizes.empty()) {
+                    mPayloadSizes.resize(w);
+                    mMetadataSizes.resize(w);
+                }
+            }
         }
     }
-    
-    void Decoder::readExtra() {
-        if(mOffsets.empty())
-            return;
-        
-        auto curOffset = mOffsets[mOffsets.size() - 1].offset;
 
-        if(FSEEK(mFile, curOffset, SEEK_SET) != 0)
+    void Decoder::beginFollow() {
+        if(mFollowPos >= 0)
             return;
 
-        while(true) {
+        // Resume after the last frame record the index knows about; the
+        // scan skips over any audio items recorded since on its own
+        int64_t pos = static_cast<int64_t>(sizeof(Header) + sizeof(Item) + mMetadataJsonBuffer.size());
+
+        if(!mFrameOffsets.empty()) {
+            const int64_t last = *std::max_element(mFrameOffsets.begin(), mFrameOffsets.end());
+
+            Item bufferItem{};
+
+            if(!seek(last, SEEK_SET) || !mReader->tryRead(&bufferItem, sizeof(Item))
+                || (bufferItem.type != Type::BUFFER && bufferItem.type != Type::COMPRESSED_BUFFER))
+            {
+                throw IOException("Unable to follow container");
+            }
+
+            const int64_t metadataPos = last + static_cast<int64_t>(sizeof(Item)) + bufferItem.size;
+            Item metadataItem{};
+
+            if(!seek(metadataPos, SEEK_SET) || !mReader->tryRead(&metadataItem, sizeof(Item)) || metadataItem.type != Type::METADATA)
+                throw IOException("Unable to follow container");
+
+            pos = metadataPos + static_cast<int64_t>(sizeof(Item)) + metadataItem.size;
+        }
+
+        mFollowPos = pos;
+        mFollowEnded = false;
+    }
+
+    size_t Decoder::refreshFollow() {
+        if(mFollowPos < 0)
+            throw IOException("Not following");
+
+        if(mFollowEnded)
+            return 0;
+
+        // Reader::size() re-probes the file, so growth since the last
+        // refresh is visible here
+        const int64_t fileSize = mReader->size();
+
+        int64_t pos = mFollowPos;
+        size_t appended = 0;
+        std::vector<uint8_t> json;
+
+        while(pos + static_cast<int64_t>(sizeof(Item)) <= fileSize) {
             Item item{};
 
-            if(std::fread(&item, sizeof(Item), 1, mFile) != 1)
+            if(!seek(pos, SEEK_SET) || !mReader->tryRead(&item, sizeof(Item)))
+                break;
+
+            // An item the recorder has not finished writing waits for the
+            // next refresh
+            if(pos + static_cast<int64_t>(sizeof(Item)) + item.size > fileSize)
                 break;
-            
-            // Skip things we don't need
-            if(item.type == Type::BUFFER || item.type == Type::METADATA || item.type == Type::AUDIO_DATA || item.type == Type::AUDIO_DATA_METADATA) {
-                if(FSEEK(mFile, item.size, SEEK_CUR) != 0)
+
+            if(item.type == Type::BUFFER || item.type == Type::COMPRESSED_BUFFER) {
+                // A frame is complete only once its metadata item landed too
+                const int64_t metadataPos = pos + static_cast<int64_t>(sizeof(Item)) + item.size;
+                Item metadataItem{};
+
+                if(metadataPos + static_cast<int64_t>(sizeof(Item)) > fileSize
+                    || !seek(metadataPos, SEEK_SET)
+                    || !mReader->tryRead(&metadataItem, sizeof(Item))
+                    || metadataItem.type != Type::METADATA
+                    || metadataPos + static_cast<int64_t>(sizeof(Item)) + metadataItem.size > fileSize)
+                {
                     break;
-            }
-            else if(item.type == Type::AUDIO_INDEX) {
-                AudioIndex index{};
-                
-                read(&index, sizeof(AudioIndex));
+                }
+
+                json.resize(metadataItem.size);
 
-                // Read all audio offsets
-                mAudioOffsets.resize(index.numOffsets);
-                
-                read(mAudioOffsets.data(), sizeof(BufferOffset), mAudioOffsets.size());
+                if(!mReader->tryRead(json.data(), json.size()))
+                    break;
+
+                long timestamp;
+
+                const Timestamp frameTimestamp = scanJsonInt(json, "timestamp", timestamp)
+                    ? timestamp
+                    : static_cast<Timestamp>(mFrameList.size());
+
+                if(!mPayloadSizes.empty() && mPayloadSizes.size() == mFrameList.size()) {
+                    mPayloadSizes.push_back(item.size);
+                    mMetadataSizes.push_back(metadataItem.size);
+                }
+
+                mFrameOffsets.push_back(pos);
+                mFrameList.push_back(frameTimestamp);
+
+                appended++;
+                pos = metadataPos + static_cast<int64_t>(sizeof(Item)) + metadataItem.size;
+            }
+            else if(item.type == Type::METADATA || item.type == Type::AUDIO_DATA || item.type == Type::AUDIO_DATA_METADATA || item.type == Type::PADDING) {
+                pos += static_cast<int64_t>(sizeof(Item)) + item.size;
             }
             else {
+                // Index records are only ever written at finalize, so the
+                // recording is done
+                mFollowEnded = true;
+                break;
+            }
+        }
+
+        mFollowPos = pos;
+
+        // Keep the cached size current so read coalescing sees the new end
+        if(mFileSize >= 0)
+            mFileSize = fileSize;
+
+        // Captures append in timestamp order; a recorder that didn't falls
+        // back to the full reindex
+        if(appended > 0 && !std::is_sorted(mFrameList.begin(), mFrameList.end()))
+            reindexOffsets();
+
+        return appended;
+    }
+
+    bool Decoder::waitForFrames(size_t minFrames, int timeoutMs, int pollIntervalMs) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        while(true) {
+            refreshFollow();
+
+            if(mFrameList.size() >= minFrames)
+                return true;
+
+            if(mFollowEnded)
+                return false;
+
+            if(timeoutMs >= 0 && std::chrono::steady_clock::now() >= deadline)
+                return false;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(pollIntervalMs));
+        }
+    }
+
+    bool Decoder::followEnded() const {
+        return mFollowEnded;
+    }
+
+    void Decoder::endFollow() {
+        mFollowPos = -1;
+        mFollowEnded = false;
+    }
+
+    void Decoder::readExtra() const {
+        if(mFrameOffsets.empty())
+            return;
+
+        const int64_t tailStart = mFrameOffsets[mFrameOffsets.size() - 1];
+        const int64_t fileSize = mReader->size();
+
+        if(fileSize <= tailStart || !seek(tailStart, SEEK_SET))
+            return;
+
+        // The whole post-frames tail in one gulp - the last frame plus the
+        // trailing audio and index records - so the walk below is pointer
+        // arithmetic over one buffer instead of a seek-and-read pair per
+        // item
+        std::vector<uint8_t> tail(static_cast<size_t>(fileSize - tailStart));
+
+        if(!mReader->tryRead(tail.data(), tail.size()))
+            return;
+
+        STAT_ADD(mStatBytesRead, tail.size());
+
+        size_t pos = 0;
+
+        while(pos + sizeof(Item) <= tail.size()) {
+            Item item{};
+
+            std::memcpy(&item, tail.data() + pos, sizeof(Item));
+
+            pos += sizeof(Item);
+
+            // A declared size past the end of the file means a truncated
+            // or malformed item; stop rather than misparse what follows
+            if(item.size > tail.size() - pos)
                 break;
+
+            if(item.type == Type::AUDIO_INDEX) {
+                AudioIndex index{};
+
+                if(item.size < sizeof(AudioIndex))
+                    break;
+
+                std::memcpy(&index, tail.data() + pos, sizeof(AudioIndex));
+
+                const size_t offsetBytes = item.size - sizeof(AudioIndex);
+
+                if(index.numOffsets >= 0 && static_cast<size_t>(index.numOffsets) * sizeof(BufferOffset) <= offsetBytes) {
+                    mAudioStartTimestampMs = index.startTimestampMs;
+
+                    mAudioOffsets.resize(index.numOffsets);
+
+                    std::memcpy(mAudioOffsets.data(), tail.data() + pos + sizeof(AudioIndex),
+                        mAudioOffsets.size() * sizeof(BufferOffset));
+                }
             }
+
+            // Everything else - including item types newer than this
+            // reader - skips by its declared size, so files from newer app
+            // versions with extra trailing records still yield their audio
+            // index instead of falling back to the slow audio walk
+            pos += item.size;
         }
     }
-    
+
     void Decoder::read(void* data, size_t size, size_t items) const {
-        if(std::fread(data, size, items, mFile) != items) {
-            throw IOException("Failed to read data");
-        }
+        STAT_ADD(mStatBytesRead, size * items);
+
+        mReader->read(data, size, items);
+    }
+
+    bool Decoder::seek(int64_t offset, int origin) const {
+        STAT_ADD(mStatNumSeeks, 1);
+
+        return mReader->seek(offset, origin);
+    }
+
+    DecoderStats Decoder::getStats() const {
+        DecoderStats stats{};
+
+#if MOTIONCAM_DECODER_STATS
+        stats.bytesRead = mStatBytesRead.load(std::memory_order_relaxed);
+        stats.numSeeks = mStatNumSeeks.load(std::memory_order_relaxed);
+        stats.framesDecoded = mStatFramesDecoded.load(std::memory_order_relaxed);
+        stats.decodeNanos = mStatDecodeNanos.load(std::memory_order_relaxed);
+        stats.metadataParseNanos = mStatParseNanos.load(std::memory_order_relaxed);
+        stats.openIndexNanos = mStatOpenIndexNanos.load(std::memory_order_relaxed);
+        stats.openSortNanos = mStatOpenSortNanos.load(std::memory_order_relaxed);
+        stats.openMetadataNanos = mStatOpenMetadataNanos.load(std::memory_order_relaxed);
+        stats.openExtraNanos = mStatOpenExtraNanos.load(std::memory_order_relaxed);
+#endif
+
+        return stats;
+    }
+
+    LatencyPercentiles Decoder::getLatency(DecodeStage stage) const {
+#if MOTIONCAM_DECODER_STATS
+        return mLatencyHistograms[static_cast<int>(stage)].percentiles();
+#else
+        (void) stage;
+        return LatencyPercentiles{};
+#endif
+    }
+
+    void Decoder::resetStats() {
+#if MOTIONCAM_DECODER_STATS
+        mStatBytesRead = 0;
+        mStatNumSeeks = 0;
+        mStatFramesDecoded = 0;
+        mStatDecodeNanos = 0;
+        mStatParseNanos = 0;
+        mStatOpenIndexNanos = 0;
+        mStatOpenSortNanos = 0;
+        mStatOpenMetadataNanos = 0;
+        mStatOpenExtraNanos = 0;
+
+        for(auto& histogram : mLatencyHistograms)
+            histogram.reset();
+#endif
     }
 
 } // namespace motioncam
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/ExportEstimator.hpp>
+#include <motioncam/Decoder.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace motioncam {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        double secondsSince(const Clock::time_point& start) {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        // Same key as the perf_regress baselines, so calibrations and
+        // guardrail baselines can live side by side per machine class
+        std::string machineClass() {
+#if defined(_WIN32)
+            const char* platform = "windows";
+#elif defined(__APPLE__)
+            const char* platform = "macos";
+#else
+            const char* platform = "linux";
+#endif
+            return std::string(platform) + "-" + std::to_string(std::max(1u, std::thread::hardware_concurrency())) + "c";
+        }
+    }
+
+    ExportCostModel CalibrateExportModel(Decoder& decoder, size_t sampleFrames) {
+        const auto& frames = decoder.getFrames();
+        const auto& sizes = decoder.getFrameSizes();
+
+        ExportCostModel model;
+
+        if(frames.empty())
+            return model;
+
+        const size_t numSamples = std::max<size_t>(1, std::min(sampleFrames, frames.size()));
+
+        std::vector<uint16_t> data;
+        nlohmann::json metadata;
+
+        // Warm the code paths (pool spin-up, first-touch allocations) so
+        // the samples measure steady-state decode, which is what a long
+        // export runs at
+        decoder.loadFrameByIndex(frames.size() / 2, data, metadata);
+
+        // Decode cost per byte is not constant across a clip: the bits
+        // distribution moves with scene detail and the kernels take
+        // different paths per bit depth. So split the clip into equal
+        // strata, time the midpoint frame of each, and extrapolate that
+        // stratum's seconds-per-byte over its full byte total from the
+        // size index. The aggregate throughput then carries the clip's
+        // bits distribution, weighted the way the export will meet it.
+        double predictedSeconds = 0;
+        int64_t totalBytes = 0;
+        int64_t outputBytes = 0;
+
+        for(size_t s = 0; s < numSamples; s++) {
+            const size_t stratumBegin = (s * frames.size()) / numSamples;
+            const size_t stratumEnd = ((s + 1) * frames.size()) / numSamples;
+            const size_t index = (stratumBegin + stratumEnd) / 2;
+
+            // Best of two loads: the first may pay one-off costs (buffer
+            // growth, page faults) a long export amortizes to nothing
+            double elapsed = std::numeric_limits<double>::max();
+
+            for(int rep = 0; rep < 2; rep++) {
+                const auto start = Clock::now();
+                decoder.loadFrameByIndex(index, data, metadata);
+                elapsed = std::min(elapsed, secondsSince(start));
+            }
+
+            int64_t stratumBytes = 0;
+
+            for(size_t i = stratumBegin; i < stratumEnd; i++)
+                stratumBytes += sizes[i];
+
+            predictedSeconds += elapsed * static_cast<double>(stratumBytes) / std::max<uint32_t>(1, sizes[index]);
+            totalBytes += stratumBytes;
+
+            outputBytes += static_cast<int64_t>(data.size() * sizeof(uint16_t));
+        }
+
+        model.outputBytesPerFrame = static_cast<double>(outputBytes) / numSamples;
+
+        if(predictedSeconds > 0)
+            model.decodeBytesPerSecond = static_cast<double>(totalBytes) / predictedSeconds;
+
+        return model;
+    }
+
+    ExportEstimate EstimateExport(Decoder& decoder, size_t firstFrame, size_t lastFrame, const ExportCostModel& model) {
+        const auto& sizes = decoder.getFrameSizes();
+
+        ExportEstimate estimate;
+
+        firstFrame = std::min(firstFrame, sizes.size());
+        lastFrame = std::min(std::max(lastFrame, firstFrame), sizes.size());
+
+        estimate.numFrames = lastFrame - firstFrame;
+
+        for(size_t i = firstFrame; i < lastFrame; i++)
+            estimate.inputBytes += sizes[i];
+
+        estimate.outputBytes = static_cast<int64_t>(estimate.numFrames * model.outputBytesPerFrame);
+
+        if(model.decodeBytesPerSecond > 0)
+            estimate.decodeSeconds = estimate.numFrames * model.frameOverheadSeconds
+                + static_cast<double>(estimate.inputBytes) / model.decodeBytesPerSecond;
+
+        if(model.writeBytesPerSecond > 0)
+            estimate.writeSeconds = static_cast<double>(estimate.outputBytes) / model.writeBytesPerSecond;
+
+        estimate.totalSeconds = estimate.decodeSeconds + estimate.writeSeconds;
+
+        return estimate;
+    }
+
+    double MeasureWriteThroughput(const std::string& directory, size_t probeBytes) {
+        const std::string path = directory + "/.mcraw_write_probe";
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if(!file)
+            return 0.0;
+
+        // 1MB chunks, the granularity exports write DNGs at
+        std::vector<char> chunk(1024 * 1024, 0x5a);
+
+        const auto start = Clock::now();
+
+        size_t remaining = probeBytes;
+        bool failed = false;
+
+        while(remaining > 0) {
+            const size_t len = std::min(remaining, chunk.size());
+
+            if(fwrite(chunk.data(), 1, len, file) != len) {
+                failed = true;
+                break;
+            }
+
+            remaining -= len;
+        }
+
+        // Flush so the probe measures the device, not the page cache
+        fflush(file);
+
+#if !defined(_WIN32)
+        fsync(fileno(file));
+#endif
+
+        const double elapsed = secondsSince(start);
+
+        fclose(file);
+        std::remove(path.c_str());
+
+        if(failed || elapsed <= 0)
+            return 0.0;
+
+        return static_cast<double>(probeBytes) / elapsed;
+    }
+
+    bool LoadExportModel(const std::string& path, ExportCostModel& outModel) {
+        std::ifstream file(path);
+
+        if(!file)
+            return false;
+
+        nlohmann::json models = nlohmann::json::parse(file, nullptr, false);
+
+        if(models.is_discarded() || !models.contains(machineClass()))
+            return false;
+
+        const nlohmann::json& entry = models[machineClass()];
+
+        outModel.decodeBytesPerSecond = entry.value("decodeBytesPerSecond", 0.0);
+        outModel.frameOverheadSeconds = entry.value("frameOverheadSeconds", 0.0);
+        outModel.outputBytesPerFrame = entry.value("outputBytesPerFrame", 0.0);
+        outModel.writeBytesPerSecond = entry.value("writeBytesPerSecond", 0.0);
+
+        return outModel.decodeBytesPerSecond > 0;
+    }
+
+    void SaveExportModel(const std::string& path, const ExportCostModel& model) {
+        nlohmann::json models = nlohmann::json::object();
+
+        {
+            std::ifstream file(path);
+
+            if(file) {
+                models = nlohmann::json::parse(file, nullptr, false);
+
+                if(models.is_discarded())
+                    models = nlohmann::json::object();
+            }
+        }
+
+        nlohmann::json entry;
+
+        entry["decodeBytesPerSecond"] = model.decodeBytesPerSecond;
+        entry["frameOverheadSeconds"] = model.frameOverheadSeconds;
+        entry["outputBytesPerFrame"] = model.outputBytesPerFrame;
+        entry["writeBytesPerSecond"] = model.writeBytesPerSecond;
+
+        models[machineClass()] = entry;
+
+        std::ofstream file(path, std::ios::trunc);
+        file << models.dump(2) << "\n";
+    }
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/FrameBufferPool.hpp>
+#include <motioncam/Allocator.hpp>
+#include <motioncam/Decoder.hpp>
+#include <motioncam/MemoryGovernor.hpp>
+
+namespace motioncam {
+
+    namespace {
+        uint16_t* allocateBuffer(size_t numElements) {
+            return static_cast<uint16_t*>(allocateAligned(numElements * sizeof(uint16_t)));
+        }
+
+        void freeBuffer(uint16_t* data) {
+            freeAligned(data);
+        }
+    }
+
+    FrameHandle::FrameHandle(FrameHandle&& other) noexcept
+        : mPool(other.mPool), mData(other.mData), mSize(other.mSize), mCapacity(other.mCapacity) {
+        other.mPool = nullptr;
+        other.mData = nullptr;
+        other.mSize = 0;
+        other.mCapacity = 0;
+    }
+
+    FrameHandle& FrameHandle::operator=(FrameHandle&& other) noexcept {
+        if(this != &other) {
+            reset();
+
+            mPool = other.mPool;
+            mData = other.mData;
+            mSize = other.mSize;
+            mCapacity = other.mCapacity;
+
+            other.mPool = nullptr;
+            other.mData = nullptr;
+            other.mSize = 0;
+            other.mCapacity = 0;
+        }
+
+        return *this;
+    }
+
+    FrameHandle::~FrameHandle() {
+        reset();
+    }
+
+    void FrameHandle::reset() {
+        if(mPool && mData)
+            mPool->release(mData, mCapacity);
+
+        mPool = nullptr;
+        mData = nullptr;
+        mSize = 0;
+        mCapacity = 0;
+    }
+
+    FrameBufferPool::FrameBufferPool(size_t maxBytes) : mMaxBytes(maxBytes) {
+        // Under a global budget, cached (not in-flight) buffers can be
+        // given back; a pool busy in acquire() skips the round rather than
+        // deadlock on its own lock
+        mReclaimerId = MemoryGovernor::shared().registerReclaimer(MemoryGovernor::Subsystem::BUFFER_POOL,
+            [this](size_t bytes) -> size_t {
+                size_t freed = 0;
+
+                {
+                    std::unique_lock<std::mutex> lock(mMutex, std::try_to_lock);
+
+                    if(!lock.owns_lock())
+                        return 0;
+
+                    while(freed < bytes && !mFree.empty()) {
+                        const size_t bufferBytes = mFree.back().capacity * sizeof(uint16_t);
+
+                        freeBuffer(mFree.back().data);
+                        mFree.pop_back();
+
+                        mAllocatedBytes -= bufferBytes;
+                        freed += bufferBytes;
+                    }
+                }
+
+                MemoryGovernor::shared().release(MemoryGovernor::Subsystem::BUFFER_POOL, freed);
+
+                return freed;
+            });
+    }
+
+    FrameBufferPool::~FrameBufferPool() {
+        MemoryGovernor::shared().unregisterReclaimer(mReclaimerId);
+
+        // Destroying the pool while handles are in flight is a usage error;
+        // only the cached buffers can be reclaimed here
+        for(auto& buffer : mFree)
+            freeBuffer(buffer.data);
+
+        MemoryGovernor::shared().release(MemoryGovernor::Subsystem::BUFFER_POOL, mAllocatedBytes);
+    }
+
+    FrameHandle FrameBufferPool::acquire(size_t numElements) {
+        const size_t numBytes = numElements * sizeof(uint16_t);
+
+        if(mMaxBytes > 0 && numBytes > mMaxBytes)
+            throw IOException("Frame buffer exceeds pool limit");
+
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        while(true) {
+            // Reuse the smallest cached buffer that fits
+            auto best = mFree.end();
+
+            for(auto it = mFree.begin(); it != mFree.end(); ++it) {
+                if(it->capacity >= numElements && (best == mFree.end() || it->capacity < best->capacity))
+                    best = it;
+            }
+
+            if(best != mFree.end()) {
+                Buffer buffer = *best;
+                mFree.erase(best);
+
+                return FrameHandle(this, buffer.data, numElements, buffer.capacity);
+            }
+
+            // Evict cached buffers that are too small to make room in the
+            // budget for a new allocation
+            while(mMaxBytes > 0 && mAllocatedBytes + numBytes > mMaxBytes && !mFree.empty()) {
+                const size_t bufferBytes = mFree.back().capacity * sizeof(uint16_t);
+
+                mAllocatedBytes -= bufferBytes;
+                freeBuffer(mFree.back().data);
+                mFree.pop_back();
+
+                MemoryGovernor::shared().release(MemoryGovernor::Subsystem::BUFFER_POOL, bufferBytes);
+            }
+
+            if(mMaxBytes == 0 || mAllocatedBytes + numBytes <= mMaxBytes) {
+                mAllocatedBytes += numBytes;
+
+                uint16_t* data = nullptr;
+
+                try {
+                    data = allocateBuffer(numElements);
+                }
+                catch(...) {
+                    mAllocatedBytes -= numBytes;
+                    throw;
+                }
+
+                MemoryGovernor::shared().charge(MemoryGovernor::Subsystem::BUFFER_POOL, numBytes);
+
+                return FrameHandle(this, data, numElements, numElements);
+            }
+
+            // Every byte of the budget is in flight; wait for a release
+            mCond.wait(lock);
+        }
+    }
+
+    size_t FrameBufferPool::allocatedBytes() const {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        return mAllocatedBytes;
+    }
+
+    void FrameBufferPool::release(uint16_t* data, size_t capacity) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mFree.push_back(Buffer{data, capacity});
+        }
+
+        mCond.notify_all();
+    }
+} // namespace motioncam
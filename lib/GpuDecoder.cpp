@@ -0,0 +1,438 @@
+#include <motioncam/GpuDecoder.hpp>
+#include <motioncam/RawData.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#if defined(MOTIONCAM_WITH_OPENCL)
+
+#define CL_TARGET_OPENCL_VERSION 120
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+
+#include <CL/cl.h>
+
+namespace motioncam {
+    namespace raw {
+
+    namespace {
+    constexpr int ENCODING_BLOCK = 64;
+    constexpr size_t METADATA_OFFSET = 16;
+
+    constexpr int ENCODING_BLOCK_LENGTH[] = {
+        0, 8, 16, 24, 32, 40, 48, 64, 64, 80, 80, 128, 128, 128, 128, 128, 128
+    };
+
+    // One work item unpacks one 64-pixel block and scatters it into the
+    // mosaic. The per-class bit layouts mirror the CPU kernels exactly;
+    // classes sharing a CPU kernel (7/8, 9/10, 11..16) are canonicalized
+    // the same way here.
+    const char* KERNEL_SOURCE = R"CLC(
+__kernel void unpackFrame(
+    __global const uchar* input,
+    __global const ushort* bits,
+    __global const ushort* refs,
+    __global const uint* offsets,
+    __global ushort* output,
+    const uint numBlocks,
+    const uint blocksPerGroup,
+    const uint width)
+{
+    const uint b = get_global_id(0);
+    if(b >= numBlocks)
+        return;
+
+    __global const uchar* p = input + offsets[b];
+    const ushort ref = refs[b];
+    ushort bb = bits[b];
+
+    if(bb == 7)
+        bb = 8;
+    else if(bb == 9)
+        bb = 10;
+    else if(bb > 10)
+        bb = 16;
+
+    ushort v[64];
+
+    switch(bb) {
+        case 0:
+            for(int i = 0; i < 64; i++)
+                v[i] = 0;
+            break;
+
+        case 1:
+            for(int j = 0; j < 8; j++)
+                for(int k = 0; k < 8; k++)
+                    v[8*k + j] = (p[j] >> k) & 0x1;
+            break;
+
+        case 2:
+            for(int h = 0; h < 2; h++)
+                for(int j = 0; j < 8; j++)
+                    for(int k = 0; k < 4; k++)
+                        v[32*h + 8*k + j] = (p[8*h + j] >> (2*k)) & 0x3;
+            break;
+
+        case 3:
+            for(int j = 0; j < 8; j++) {
+                v[j]      =  p[j]       & 0x7;
+                v[8 + j]  = (p[j] >> 3) & 0x7;
+                v[16 + j] = ((p[j] >> 6) & 0x3) | (((p[16 + j] >> 6) & 0x1) << 2);
+                v[24 + j] =  p[8 + j]       & 0x7;
+                v[32 + j] = (p[8 + j] >> 3) & 0x7;
+                v[40 + j] = ((p[8 + j] >> 6) & 0x3) | (((p[16 + j] >> 7) & 0x1) << 2);
+                v[48 + j] =  p[16 + j]       & 0x7;
+                v[56 + j] = (p[16 + j] >> 3) & 0x7;
+            }
+            break;
+
+        case 4:
+            for(int c = 0; c < 4; c++)
+                for(int j = 0; j < 8; j++) {
+                    v[16*c + j]     =  p[8*c + j]       & 0xF;
+                    v[16*c + 8 + j] = (p[8*c + j] >> 4) & 0xF;
+                }
+            break;
+
+        case 5:
+            for(int j = 0; j < 8; j++) {
+                for(int k = 0; k < 5; k++)
+                    v[8*k + j] = p[8*k + j] & 0x1F;
+
+                v[40 + j] = ((p[j]      >> 5) & 0x7) | (((p[24 + j] >> 5) & 0x3) << 3);
+                v[48 + j] = ((p[8 + j]  >> 5) & 0x7) | (((p[32 + j] >> 5) & 0x3) << 3);
+                v[56 + j] = ((p[16 + j] >> 5) & 0x7)
+                    | (((p[24 + j] >> 7) & 0x1) << 3)
+                    | (((p[32 + j] >> 7) & 0x1) << 4);
+            }
+            break;
+
+        case 6:
+            for(int j = 0; j < 8; j++) {
+                for(int k = 0; k < 6; k++)
+                    v[8*k + j] = p[8*k + j] & 0x3F;
+
+                v[48 + j] = ((p[j] >> 6) & 0x3)
+                    | (((p[8 + j]  >> 6) & 0x3) << 2)
+                    | (((p[16 + j] >> 6) & 0x3) << 4);
+                v[56 + j] = ((p[24 + j] >> 6) & 0x3)
+                    | (((p[32 + j] >> 6) & 0x3) << 2)
+                    | (((p[40 + j] >> 6) & 0x3) << 4);
+            }
+            break;
+
+        case 8:
+            for(int i = 0; i < 64; i++)
+                v[i] = p[i];
+            break;
+
+        case 10:
+            for(int j = 0; j < 8; j++)
+                for(int k = 0; k < 4; k++) {
+                    v[8*k + j]      = p[8*k + j]      | ((ushort)((p[32 + j] >> (2*k)) & 0x3) << 8);
+                    v[32 + 8*k + j] = p[40 + 8*k + j] | ((ushort)((p[72 + j] >> (2*k)) & 0x3) << 8);
+                }
+            break;
+
+        default:
+            for(int i = 0; i < 64; i++)
+                v[i] = (ushort)p[2*i] | ((ushort)p[2*i + 1] << 8);
+            break;
+    }
+
+    /* The four blocks of a column chunk interleave into four mosaic
+       rows: block halves are the even/odd column halves, the block's
+       position in the chunk picks the row pair and the column parity */
+    const uint g = b / blocksPerGroup;
+    const uint inGroup = b - g*blocksPerGroup;
+    const uint chunk = inGroup >> 2;
+    const uint sub = inGroup & 0x3;
+
+    for(uint i = 0; i < 64; i++) {
+        const uint row = 4*g + (sub >> 1) + 2*(i >> 5);
+        const uint col = chunk*64 + 2*(i & 31) + (sub & 0x1);
+
+        if(col < width)
+            output[row*width + col] = (ushort)(v[i] + ref);
+    }
+}
+)CLC";
+    } // namespace
+
+    struct GpuDecoder::Impl {
+        cl_context context{nullptr};
+        cl_command_queue queue{nullptr};
+        cl_program program{nullptr};
+        cl_kernel kernel{nullptr};
+
+        cl_mem payloadBuf{nullptr};
+        cl_mem bitsBuf{nullptr};
+        cl_mem refsBuf{nullptr};
+        cl_mem offsetsBuf{nullptr};
+        cl_mem outputBuf{nullptr};
+
+        size_t payloadCapacity{0};
+        size_t bitsCapacity{0};
+        size_t refsCapacity{0};
+        size_t offsetsCapacity{0};
+        size_t outputCapacity{0};
+
+        FrameLayout layout;
+        std::vector<uint32_t> blockOffsets;
+
+        ~Impl() {
+            if(kernel)      clReleaseKernel(kernel);
+            if(program)     clReleaseProgram(program);
+            if(payloadBuf)  clReleaseMemObject(payloadBuf);
+            if(bitsBuf)     clReleaseMemObject(bitsBuf);
+            if(refsBuf)     clReleaseMemObject(refsBuf);
+            if(offsetsBuf)  clReleaseMemObject(offsetsBuf);
+            if(outputBuf)   clReleaseMemObject(outputBuf);
+            if(queue)       clReleaseCommandQueue(queue);
+            if(context)     clReleaseContext(context);
+        }
+
+        bool init() {
+            cl_platform_id platform;
+            cl_uint count = 0;
+
+            if(clGetPlatformIDs(1, &platform, &count) != CL_SUCCESS || count == 0)
+                return false;
+
+            // Prefer a GPU; fall back to whatever the platform defaults
+            // to so the backend still works on CPU-only CL runtimes
+            cl_device_id device;
+
+            if(clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, nullptr) != CL_SUCCESS &&
+               clGetDeviceIDs(platform, CL_DEVICE_TYPE_DEFAULT, 1, &device, nullptr) != CL_SUCCESS)
+            {
+                return false;
+            }
+
+            cl_int err = CL_SUCCESS;
+
+            context = clCreateContext(nullptr, 1, &device, nullptr, nullptr, &err);
+            if(err != CL_SUCCESS)
+                return false;
+
+            queue = clCreateCommandQueue(context, device, 0, &err);
+            if(err != CL_SUCCESS)
+                return false;
+
+            program = clCreateProgramWithSource(context, 1, &KERNEL_SOURCE, nullptr, &err);
+            if(err != CL_SUCCESS)
+                return false;
+
+            if(clBuildProgram(program, 1, &device, "", nullptr, nullptr) != CL_SUCCESS)
+                return false;
+
+            kernel = clCreateKernel(program, "unpackFrame", &err);
+
+            return err == CL_SUCCESS;
+        }
+
+        bool ensure(cl_mem& buf, size_t& capacity, const size_t needed, const cl_mem_flags flags) {
+            if(needed <= capacity)
+                return true;
+
+            if(buf) {
+                clReleaseMemObject(buf);
+                buf = nullptr;
+                capacity = 0;
+            }
+
+            cl_int err = CL_SUCCESS;
+
+            buf = clCreateBuffer(context, flags, needed, nullptr, &err);
+            if(err != CL_SUCCESS)
+                return false;
+
+            capacity = needed;
+
+            return true;
+        }
+
+        // Upload, unpack and optionally read back one frame. Returns the
+        // decoded pixel count, or 0 to send the caller to the CPU path.
+        size_t run(
+            uint16_t* output,
+            const int width,
+            const uint8_t* input,
+            const size_t len,
+            const bool readBack)
+        {
+            if(!ComputeFrameLayout(input, len, layout))
+                return 0;
+
+            // The kernel has no bounds checks; unverified streams belong
+            // on the bounds-checked CPU loop
+            if(!layout.verified)
+                return 0;
+
+            if(layout.encodedWidth % ENCODING_BLOCK != 0 || layout.encodedWidth < static_cast<uint32_t>(width))
+                return 0;
+
+            if(len > UINT32_MAX)
+                return 0;
+
+            const size_t numBlocks = layout.bits.size();
+            const uint32_t blocksPerGroup = (layout.encodedWidth / ENCODING_BLOCK) * 4;
+            const size_t numGroups = (layout.encodedHeight + 3) / 4;
+
+            if(numBlocks == 0 || numBlocks != static_cast<size_t>(blocksPerGroup) * numGroups)
+                return 0;
+
+            // Absolute input offset of every block, a prefix sum over the
+            // per-block lengths - this is what makes the blocks
+            // independently addressable on the device
+            blockOffsets.resize(numBlocks);
+
+            size_t offset = METADATA_OFFSET;
+
+            for(size_t i = 0; i < numBlocks; i++) {
+                if(layout.bits[i] > 16)
+                    return 0;
+
+                blockOffsets[i] = static_cast<uint32_t>(offset);
+                offset += ENCODING_BLOCK_LENGTH[layout.bits[i]];
+            }
+
+            const size_t outputPixels = static_cast<size_t>(width) * (4 * numGroups);
+
+            if(!ensure(payloadBuf, payloadCapacity, len, CL_MEM_READ_ONLY)                       ||
+               !ensure(bitsBuf, bitsCapacity, numBlocks * sizeof(uint16_t), CL_MEM_READ_ONLY)    ||
+               !ensure(refsBuf, refsCapacity, numBlocks * sizeof(uint16_t), CL_MEM_READ_ONLY)    ||
+               !ensure(offsetsBuf, offsetsCapacity, numBlocks * sizeof(uint32_t), CL_MEM_READ_ONLY) ||
+               !ensure(outputBuf, outputCapacity, outputPixels * sizeof(uint16_t), CL_MEM_READ_WRITE))
+            {
+                return 0;
+            }
+
+            if(clEnqueueWriteBuffer(queue, payloadBuf, CL_FALSE, 0, len, input, 0, nullptr, nullptr) != CL_SUCCESS ||
+               clEnqueueWriteBuffer(queue, bitsBuf, CL_FALSE, 0, numBlocks * sizeof(uint16_t), layout.bits.data(), 0, nullptr, nullptr) != CL_SUCCESS ||
+               clEnqueueWriteBuffer(queue, refsBuf, CL_FALSE, 0, numBlocks * sizeof(uint16_t), layout.refs.data(), 0, nullptr, nullptr) != CL_SUCCESS ||
+               clEnqueueWriteBuffer(queue, offsetsBuf, CL_FALSE, 0, numBlocks * sizeof(uint32_t), blockOffsets.data(), 0, nullptr, nullptr) != CL_SUCCESS)
+            {
+                return 0;
+            }
+
+            const cl_uint clNumBlocks = static_cast<cl_uint>(numBlocks);
+            const cl_uint clWidth = static_cast<cl_uint>(width);
+
+            if(clSetKernelArg(kernel, 0, sizeof(cl_mem), &payloadBuf) != CL_SUCCESS ||
+               clSetKernelArg(kernel, 1, sizeof(cl_mem), &bitsBuf) != CL_SUCCESS    ||
+               clSetKernelArg(kernel, 2, sizeof(cl_mem), &refsBuf) != CL_SUCCESS    ||
+               clSetKernelArg(kernel, 3, sizeof(cl_mem), &offsetsBuf) != CL_SUCCESS ||
+               clSetKernelArg(kernel, 4, sizeof(cl_mem), &outputBuf) != CL_SUCCESS  ||
+               clSetKernelArg(kernel, 5, sizeof(cl_uint), &clNumBlocks) != CL_SUCCESS ||
+               clSetKernelArg(kernel, 6, sizeof(cl_uint), &blocksPerGroup) != CL_SUCCESS ||
+               clSetKernelArg(kernel, 7, sizeof(cl_uint), &clWidth) != CL_SUCCESS)
+            {
+                return 0;
+            }
+
+            // Round the range up to the workgroup size; extra items
+            // return immediately off the numBlocks guard
+            const size_t localSize = 64;
+            const size_t globalSize = ((numBlocks + localSize - 1) / localSize) * localSize;
+
+            if(clEnqueueNDRangeKernel(queue, kernel, 1, nullptr, &globalSize, &localSize, 0, nullptr, nullptr) != CL_SUCCESS)
+                return 0;
+
+            if(readBack) {
+                if(clEnqueueReadBuffer(queue, outputBuf, CL_TRUE, 0, outputPixels * sizeof(uint16_t), output, 0, nullptr, nullptr) != CL_SUCCESS)
+                    return 0;
+            }
+            else {
+                if(clFinish(queue) != CL_SUCCESS)
+                    return 0;
+            }
+
+            return outputPixels;
+        }
+    };
+
+    GpuDecoder::GpuDecoder() {
+        std::unique_ptr<Impl> impl(new Impl());
+
+        if(impl->init())
+            mImpl = std::move(impl);
+    }
+
+    GpuDecoder::~GpuDecoder() = default;
+
+    bool GpuDecoder::isAvailable() const {
+        return mImpl != nullptr;
+    }
+
+    size_t GpuDecoder::decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len)
+    {
+        (void)height;
+
+        if(!mImpl || !output)
+            return 0;
+
+        return mImpl->run(output, width, input, len, true);
+    }
+
+    void* GpuDecoder::decodeToDevice(
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        size_t& outNumPixels)
+    {
+        (void)height;
+
+        outNumPixels = 0;
+
+        if(!mImpl)
+            return nullptr;
+
+        const size_t pixels = mImpl->run(nullptr, width, input, len, false);
+        if(pixels == 0)
+            return nullptr;
+
+        outNumPixels = pixels;
+
+        return mImpl->outputBuf;
+    }
+
+    } // namespace raw
+} // namespace motioncam
+
+#else // !MOTIONCAM_WITH_OPENCL
+
+namespace motioncam {
+    namespace raw {
+
+    // Backend compiled out: the class still links, reports unavailable
+    // and every call routes the caller to the CPU path
+    struct GpuDecoder::Impl {};
+
+    GpuDecoder::GpuDecoder() = default;
+    GpuDecoder::~GpuDecoder() = default;
+
+    bool GpuDecoder::isAvailable() const {
+        return false;
+    }
+
+    size_t GpuDecoder::decode(uint16_t*, const int, const int, const uint8_t*, const size_t) {
+        return 0;
+    }
+
+    void* GpuDecoder::decodeToDevice(const int, const int, const uint8_t*, const size_t, size_t& outNumPixels) {
+        outNumPixels = 0;
+
+        return nullptr;
+    }
+
+    } // namespace raw
+} // namespace motioncam
+
+#endif // MOTIONCAM_WITH_OPENCL
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/MemoryGovernor.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace motioncam {
+
+    MemoryGovernor& MemoryGovernor::shared() {
+        static MemoryGovernor instance;
+        return instance;
+    }
+
+    void MemoryGovernor::setBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBudget = bytes;
+    }
+
+    size_t MemoryGovernor::budget() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mBudget;
+    }
+
+    void MemoryGovernor::setWeight(Subsystem subsystem, double weight) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWeights[static_cast<int>(subsystem)] = std::max(0.0, weight);
+    }
+
+    void MemoryGovernor::computeReductions(size_t outReduction[NUM_SUBSYSTEMS]) const {
+        std::fill(outReduction, outReduction + NUM_SUBSYSTEMS, 0);
+
+        if(mBudget == 0)
+            return;
+
+        size_t total = 0;
+        double weightSum = 0;
+
+        for(int s = 0; s < NUM_SUBSYSTEMS; s++) {
+            total += mBytes[s];
+            weightSum += mWeights[s];
+        }
+
+        if(total <= mBudget)
+            return;
+
+        size_t deficit = total - mBudget;
+
+        // First pass: in reclaim order, take back only what a subsystem
+        // holds beyond its weighted share, so a subsystem within its share
+        // is not punished for another's growth
+        for(int s = 0; s < NUM_SUBSYSTEMS && deficit > 0; s++) {
+            const size_t share = weightSum > 0
+                ? static_cast<size_t>(mBudget * (mWeights[s] / weightSum))
+                : 0;
+
+            const size_t over = mBytes[s] > share ? mBytes[s] - share : 0;
+            const size_t take = std::min(deficit, over);
+
+            outReduction[s] = take;
+            deficit -= take;
+        }
+
+        // Second pass: still over budget, cut below the shares in the same
+        // order
+        for(int s = 0; s < NUM_SUBSYSTEMS && deficit > 0; s++) {
+            const size_t take = std::min(deficit, mBytes[s] - outReduction[s]);
+
+            outReduction[s] += take;
+            deficit -= take;
+        }
+    }
+
+    void MemoryGovernor::charge(Subsystem subsystem, size_t bytes) {
+        size_t reduction[NUM_SUBSYSTEMS];
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mBytes[static_cast<int>(subsystem)] += bytes;
+
+            computeReductions(reduction);
+        }
+
+        bool anyReduction = false;
+
+        for(int s = 0; s < NUM_SUBSYSTEMS; s++)
+            anyReduction = anyReduction || reduction[s] > 0;
+
+        if(!anyReduction)
+            return;
+
+        // Run the reclaimers outside the accounting lock - they release()
+        // what they free - serialized so unregistration can wait out an
+        // in-flight invocation
+        std::lock_guard<std::mutex> reclaimLock(mReclaimMutex);
+
+        for(int s = 0; s < NUM_SUBSYSTEMS; s++) {
+            size_t wanted = reduction[s];
+
+            if(wanted == 0)
+                continue;
+
+            std::vector<Reclaimer> reclaimers;
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                for(const auto& entry : mReclaimers) {
+                    if(entry.second.first == static_cast<Subsystem>(s))
+                        reclaimers.push_back(entry.second.second);
+                }
+            }
+
+            for(const auto& reclaim : reclaimers) {
+                const size_t freed = reclaim(wanted);
+
+                if(freed >= wanted)
+                    break;
+
+                wanted -= freed;
+            }
+        }
+    }
+
+    void MemoryGovernor::release(Subsystem subsystem, size_t bytes) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        size_t& held = mBytes[static_cast<int>(subsystem)];
+        held -= std::min(held, bytes);
+    }
+
+    size_t MemoryGovernor::trimTarget(Subsystem subsystem) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if(mBudget == 0)
+            return std::numeric_limits<size_t>::max();
+
+        size_t reduction[NUM_SUBSYSTEMS];
+        computeReductions(reduction);
+
+        size_t total = 0;
+
+        for(int s = 0; s < NUM_SUBSYSTEMS; s++)
+            total += mBytes[s];
+
+        const int s = static_cast<int>(subsystem);
+
+        if(total <= mBudget)
+            return mBytes[s] + (mBudget - total);
+
+        return mBytes[s] - reduction[s];
+    }
+
+    bool MemoryGovernor::overTarget(Subsystem subsystem) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if(mBudget == 0)
+            return false;
+
+        size_t reduction[NUM_SUBSYSTEMS];
+        computeReductions(reduction);
+
+        return reduction[static_cast<int>(subsystem)] > 0;
+    }
+
+    int MemoryGovernor::registerReclaimer(Subsystem subsystem, Reclaimer reclaimer) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        const int id = mNextReclaimerId++;
+        mReclaimers.emplace(id, std::make_pair(subsystem, std::move(reclaimer)));
+
+        return id;
+    }
+
+    void MemoryGovernor::unregisterReclaimer(int id) {
+        // Taking the reclaim lock waits out an invocation copied before
+        // this unregistration, so the reclaimer's captures stay valid for
+        // the call
+        std::lock_guard<std::mutex> reclaimLock(mReclaimMutex);
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mReclaimers.erase(id);
+    }
+
+    size_t MemoryGovernor::totalBytes() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        size_t total = 0;
+
+        for(int s = 0; s < NUM_SUBSYSTEMS; s++)
+            total += mBytes[s];
+
+        return total;
+    }
+
+    size_t MemoryGovernor::bytesOf(Subsystem subsystem) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        return mBytes[static_cast<int>(subsystem)];
+    }
+} // namespace motioncam
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/MetadataIndex.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace motioncam {
+    namespace {
+        // Read one field's value for a row of the columns. Rows a frame's
+        // metadata did not fill are zero, matching the column contract.
+        int64_t fieldValue(const FrameMetadataColumns& columns, const MetadataField field, const size_t row) {
+            switch(field) {
+                case MetadataField::ISO:
+                    return row < columns.isos.size() ? columns.isos[row] : 0;
+
+                case MetadataField::EXPOSURE_TIME:
+                    return row < columns.exposureTimes.size() ? columns.exposureTimes[row] : 0;
+
+                case MetadataField::WIDTH:
+                    return row < columns.widths.size() ? columns.widths[row] : 0;
+
+                case MetadataField::HEIGHT:
+                    return row < columns.heights.size() ? columns.heights[row] : 0;
+
+                case MetadataField::ORIENTATION:
+                default:
+                    return row < columns.orientations.size() ? columns.orientations[row] : 0;
+            }
+        }
+    }
+
+    MetadataIndex::MetadataIndex(const FrameMetadataColumns& columns) {
+        mNumFrames = columns.timestamps.size();
+
+        for(int f = 0; f < NUM_FIELDS; f++) {
+            const auto field = static_cast<MetadataField>(f);
+            Column& column = mColumns[f];
+
+            column.sorted.reserve(mNumFrames);
+
+            int64_t previous = 0;
+
+            for(size_t row = 0; row < mNumFrames; row++) {
+                const int64_t value = fieldValue(columns, field, row);
+
+                column.sorted.emplace_back(value, row);
+
+                if(row > 0 && value != previous)
+                    column.changes.push_back(row);
+
+                previous = value;
+            }
+
+            // Positions break value ties, so equal-value runs come out in
+            // frame order and range queries stay stable
+            std::sort(column.sorted.begin(), column.sorted.end());
+        }
+    }
+
+    const MetadataIndex::Column& MetadataIndex::column(const MetadataField field) const {
+        return mColumns[static_cast<int>(field)];
+    }
+
+    std::vector<size_t> MetadataIndex::query(const MetadataField field, const int64_t minValue, const int64_t maxValue) const {
+        std::vector<size_t> out;
+
+        if(maxValue < minValue)
+            return out;
+
+        const Column& c = column(field);
+
+        const auto first = std::lower_bound(c.sorted.begin(), c.sorted.end(),
+            std::make_pair(minValue, size_t{0}));
+
+        const auto last = std::upper_bound(first, c.sorted.end(),
+            std::make_pair(maxValue, std::numeric_limits<size_t>::max()));
+
+        out.reserve(last - first);
+
+        for(auto it = first; it != last; ++it)
+            out.push_back(it->second);
+
+        std::sort(out.begin(), out.end());
+
+        return out;
+    }
+
+    const std::vector<size_t>& MetadataIndex::changes(const MetadataField field) const {
+        return column(field).changes;
+    }
+
+    int64_t MetadataIndex::nearest(const MetadataField field, const int64_t value) const {
+        const Column& c = column(field);
+
+        if(c.sorted.empty())
+            return -1;
+
+        const auto it = std::lower_bound(c.sorted.begin(), c.sorted.end(),
+            std::make_pair(value, size_t{0}));
+
+        // Equal values sit in one run ordered by frame position, so the
+        // earliest frame holding a value is the run's first entry
+        const auto earliestWithValue = [&](const int64_t v) {
+            return static_cast<int64_t>(std::lower_bound(c.sorted.begin(), c.sorted.end(),
+                std::make_pair(v, size_t{0}))->second);
+        };
+
+        if(it == c.sorted.end())
+            return earliestWithValue((it - 1)->first);
+
+        if(it == c.sorted.begin() || it->first == value)
+            return earliestWithValue(it->first);
+
+        // Between two values: closer one wins, the earlier frame on a
+        // distance tie
+        const int64_t above = it->first - value;
+        const int64_t below = value - (it - 1)->first;
+
+        if(above < below)
+            return earliestWithValue(it->first);
+
+        if(below < above)
+            return earliestWithValue((it - 1)->first);
+
+        return std::min(earliestWithValue(it->first), earliestWithValue((it - 1)->first));
+    }
+}
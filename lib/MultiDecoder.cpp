@@ -0,0 +1,112 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/MultiDecoder.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+namespace motioncam {
+
+    MultiDecoder::MultiDecoder(const std::vector<std::string>& paths, ReadMode mode, size_t numThreads) : mPool(numThreads) {
+        if(paths.empty())
+            throw IOException("No containers given");
+
+        mDecoders.reserve(paths.size());
+
+        for(const auto& path : paths)
+            mDecoders.emplace_back(new Decoder(path, mode));
+
+        mPayloads.resize(paths.size());
+        mMetadataJson.resize(paths.size());
+    }
+
+    size_t MultiDecoder::numContainers() const {
+        return mDecoders.size();
+    }
+
+    Decoder& MultiDecoder::getDecoder(size_t container) {
+        return *mDecoders.at(container);
+    }
+
+    Timestamp MultiDecoder::startTimestamp() const {
+        Timestamp start = std::numeric_limits<Timestamp>::max();
+
+        for(const auto& decoder : mDecoders) {
+            const auto& frames = decoder->getFrames();
+
+            if(!frames.empty())
+                start = std::min(start, frames.front());
+        }
+
+        return start == std::numeric_limits<Timestamp>::max() ? -1 : start;
+    }
+
+    Timestamp MultiDecoder::endTimestamp() const {
+        Timestamp end = -1;
+
+        for(const auto& decoder : mDecoders) {
+            const auto& frames = decoder->getFrames();
+
+            if(!frames.empty())
+                end = std::max(end, frames.back());
+        }
+
+        return end;
+    }
+
+    void MultiDecoder::loadNearestFrames(const Timestamp timestamp, std::vector<Frame>& outFrames) {
+        outFrames.resize(mDecoders.size());
+
+        std::mutex mutex;
+        std::exception_ptr error;
+
+        // Read the compressed payloads container by container on this thread,
+        // so the disk sees one file's access pattern at a time instead of
+        // seeks interleaved across all of them, and decode each payload on
+        // the shared pool as soon as its read completes.
+        for(size_t i = 0; i < mDecoders.size(); i++) {
+            Frame& frame = outFrames[i];
+            const int64_t frameIndex = mDecoders[i]->findFrame(timestamp, SeekMode::NEAREST);
+            frame.valid = frameIndex >= 0;
+            frame.timestamp = frame.valid ? mDecoders[i]->getFrames()[frameIndex] : -1;
+
+            if(!frame.valid)
+                continue;
+
+            mDecoders[i]->loadFramePayload(frame.timestamp, mPayloads[i], mMetadataJson[i]);
+
+            mPool.enqueue([this, i, &frame, &mutex, &error] {
+                try {
+                    mDecoders[i]->decodeFramePayload(mPayloads[i], mMetadataJson[i], frame.data, frame.metadata);
+                }
+                catch(...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if(!error)
+                        error = std::current_exception();
+                }
+            });
+        }
+
+        mPool.waitAll();
+
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+} // namespace motioncam
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/Numa.hpp>
+
+#if defined(MOTIONCAM_WITH_NUMA) && defined(__linux__)
+    #include <numa.h>
+#endif
+
+#if defined(__linux__)
+    #include <cstdio>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <vector>
+#elif defined(__APPLE__)
+    #include <pthread.h>
+    #include <sys/sysctl.h>
+#endif
+
+namespace motioncam {
+    namespace numa {
+
+#if defined(MOTIONCAM_WITH_NUMA) && defined(__linux__)
+
+        int NumNodes() {
+            // numa_available() is cheap after the first call, but cache the
+            // node count anyway since the pool asks per task placement
+            static const int numNodes = (numa_available() < 0) ? 1 : (numa_max_node() + 1);
+
+            return numNodes;
+        }
+
+        void BindCurrentThread(int node) {
+            if(NumNodes() <= 1 || node < 0 || node >= NumNodes())
+                return;
+
+            // Run on the node's CPUs and take memory from it; first-touch
+            // then places everything the thread allocates node-locally
+            numa_run_on_node(node);
+            numa_set_preferred(node);
+        }
+
+#else
+
+        int NumNodes() {
+            return 1;
+        }
+
+        void BindCurrentThread(int) {
+        }
+
+#endif
+
+    }
+
+    namespace cores {
+
+#if defined(__linux__)
+
+        namespace {
+            struct Topology {
+                std::vector<int> performance;
+                std::vector<int> efficiency;
+            };
+
+            Topology detectTopology() {
+                Topology topology;
+                std::vector<std::pair<int, long>> cpus;
+
+                // cpu_capacity is the scheduler's own view of relative core
+                // strength (arm DynamIQ); hybrid x86 parts expose the split
+                // through differing per-core max frequencies instead
+                for(int cpu = 0;; cpu++) {
+                    char path[96];
+                    long value = -1;
+
+                    std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+
+                    FILE* file = std::fopen(path, "r");
+
+                    if(!file) {
+                        std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+                        file = std::fopen(path, "r");
+                    }
+
+                    if(!file)
+                        break;
+
+                    if(std::fscanf(file, "%ld", &value) != 1)
+                        value = -1;
+
+                    std::fclose(file);
+
+                    if(value < 0)
+                        break;
+
+                    cpus.emplace_back(cpu, value);
+                }
+
+                if(cpus.size() < 2)
+                    return topology;
+
+                long minValue = cpus[0].second;
+                long maxValue = cpus[0].second;
+
+                for(const auto& cpu : cpus) {
+                    minValue = minValue < cpu.second ? minValue : cpu.second;
+                    maxValue = maxValue > cpu.second ? maxValue : cpu.second;
+                }
+
+                // Small per-core frequency scatter (binning, preferred
+                // cores) is not a hybrid topology; require a clear split
+                if(minValue <= 0 || maxValue < minValue + minValue / 5)
+                    return topology;
+
+                for(const auto& cpu : cpus) {
+                    if(cpu.second == maxValue)
+                        topology.performance.push_back(cpu.first);
+                    else
+                        topology.efficiency.push_back(cpu.first);
+                }
+
+                return topology;
+            }
+
+            const Topology& topology() {
+                static const Topology cached = detectTopology();
+
+                return cached;
+            }
+        }
+
+        int NumPerformanceCores() {
+            return static_cast<int>(topology().performance.size());
+        }
+
+        int NumEfficiencyCores() {
+            return static_cast<int>(topology().efficiency.size());
+        }
+
+        void BindCurrentThread(bool efficiency) {
+            const std::vector<int>& cpus = efficiency ? topology().efficiency : topology().performance;
+
+            if(cpus.empty())
+                return;
+
+            cpu_set_t set;
+            CPU_ZERO(&set);
+
+            for(const int cpu : cpus)
+                CPU_SET(cpu, &set);
+
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+
+#elif defined(__APPLE__)
+
+        namespace {
+            int perfLevelCpus(const char* name) {
+                int count = 0;
+                size_t len = sizeof(count);
+
+                if(sysctlbyname(name, &count, &len, nullptr, 0) != 0)
+                    return 0;
+
+                return count;
+            }
+        }
+
+        int NumPerformanceCores() {
+            // perflevel0 is the performance cluster; a homogeneous machine
+            // has no perflevel1 and reports no split
+            return perfLevelCpus("hw.perflevel1.logicalcpu") > 0
+                ? perfLevelCpus("hw.perflevel0.logicalcpu") : 0;
+        }
+
+        int NumEfficiencyCores() {
+            return perfLevelCpus("hw.perflevel1.logicalcpu");
+        }
+
+        void BindCurrentThread(bool efficiency) {
+            if(NumEfficiencyCores() == 0)
+                return;
+
+            // Threads cannot be pinned on Apple platforms; the QoS class
+            // steers them onto the matching cluster instead
+            pthread_set_qos_class_self_np(efficiency ? QOS_CLASS_UTILITY : QOS_CLASS_USER_INITIATED, 0);
+        }
+
+#else
+
+        int NumPerformanceCores() {
+            return 0;
+        }
+
+        int NumEfficiencyCores() {
+            return 0;
+        }
+
+        void BindCurrentThread(bool) {
+        }
+
+#endif
+
+    }
+}
@@ -0,0 +1,217 @@
+#if defined(_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+#include <motioncam/Reader.hpp>
+#include <motioncam/Decoder.hpp>
+
+#include <cstring>
+
+namespace motioncam {
+    namespace {
+        constexpr DWORD QUEUE_DEPTH = 64;
+
+        // Per-request completion state. OVERLAPPED must be the first member so
+        // the pointer handed back by the completion port can be cast straight
+        // to it.
+        struct PendingRead {
+            OVERLAPPED overlapped;
+            size_t index;
+        };
+    }
+
+    OverlappedReader::OverlappedReader(const std::string& path) :
+        mFile(INVALID_HANDLE_VALUE), mCompletionPort(nullptr), mPos(0), mSize(0)
+    {
+        HANDLE file = CreateFileA(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+
+        if(file == INVALID_HANDLE_VALUE)
+            throw IOException("Failed to open " + path);
+
+        LARGE_INTEGER size{};
+
+        if(!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            throw IOException("Failed to get size of " + path);
+        }
+
+        HANDLE port = CreateIoCompletionPort(file, nullptr, 0, 1);
+        if(!port) {
+            CloseHandle(file);
+            throw IOException("Failed to create completion port");
+        }
+
+        mFile = file;
+        mCompletionPort = port;
+        mSize = size.QuadPart;
+    }
+
+    OverlappedReader::~OverlappedReader() {
+        if(mCompletionPort)
+            CloseHandle(static_cast<HANDLE>(mCompletionPort));
+
+        if(mFile != INVALID_HANDLE_VALUE)
+            CloseHandle(static_cast<HANDLE>(mFile));
+    }
+
+    bool OverlappedReader::readAt(void* data, size_t size, int64_t offset) {
+        uint8_t* dst = static_cast<uint8_t*>(data);
+        size_t remaining = size;
+
+        while(remaining > 0) {
+            PendingRead pending{};
+
+            pending.overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+            pending.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            const DWORD toRead = static_cast<DWORD>(
+                remaining > 0x7FFFFFFF ? 0x7FFFFFFF : remaining);
+
+            if(!ReadFile(static_cast<HANDLE>(mFile), dst, toRead, nullptr, &pending.overlapped)
+                && GetLastError() != ERROR_IO_PENDING)
+            {
+                return false;
+            }
+
+            DWORD transferred = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* completed = nullptr;
+
+            if(!GetQueuedCompletionStatus(static_cast<HANDLE>(mCompletionPort),
+                &transferred, &key, &completed, INFINITE) || transferred == 0)
+            {
+                return false;
+            }
+
+            dst += transferred;
+            offset += transferred;
+            remaining -= transferred;
+        }
+
+        return true;
+    }
+
+    void OverlappedReader::read(void* data, size_t size, size_t items) {
+        if(!tryRead(data, size * items))
+            throw IOException("Failed to read data");
+    }
+
+    bool OverlappedReader::tryRead(void* data, size_t size) {
+        if(!readAt(data, size, mPos))
+            return false;
+
+        mPos += size;
+
+        return true;
+    }
+
+    int64_t OverlappedReader::size() {
+        return mSize;
+    }
+
+    bool OverlappedReader::seek(int64_t offset, int origin) {
+        int64_t newPos;
+
+        switch(origin) {
+            case SEEK_SET:
+                newPos = offset;
+                break;
+            case SEEK_CUR:
+                newPos = mPos + offset;
+                break;
+            case SEEK_END:
+                newPos = mSize + offset;
+                break;
+            default:
+                return false;
+        }
+
+        if(newPos < 0)
+            return false;
+
+        mPos = newPos;
+
+        return true;
+    }
+
+    void OverlappedReader::readBatch(const std::vector<ReadRequest>& requests) {
+        // Per-request progress so short reads are resubmitted for the remainder
+        std::vector<size_t> completed(requests.size(), 0);
+        std::vector<PendingRead> pending(requests.size());
+
+        size_t next = 0;         // next request to submit
+        size_t inFlight = 0;
+        size_t finished = 0;
+
+        auto submitOne = [&](size_t idx) {
+            const int64_t offset = requests[idx].offset + static_cast<int64_t>(completed[idx]);
+
+            PendingRead& p = pending[idx];
+            std::memset(&p.overlapped, 0, sizeof(p.overlapped));
+
+            p.overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+            p.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            p.index = idx;
+
+            const size_t remaining = requests[idx].len - completed[idx];
+            const DWORD toRead = static_cast<DWORD>(
+                remaining > 0x7FFFFFFF ? 0x7FFFFFFF : remaining);
+
+            if(!ReadFile(static_cast<HANDLE>(mFile),
+                static_cast<uint8_t*>(requests[idx].dst) + completed[idx],
+                toRead, nullptr, &p.overlapped)
+                && GetLastError() != ERROR_IO_PENDING)
+            {
+                throw IOException("Failed to read data");
+            }
+
+            ++inFlight;
+        };
+
+        while(finished < requests.size()) {
+            while(next < requests.size() && inFlight < QUEUE_DEPTH) {
+                if(requests[next].len == 0) {
+                    ++finished;
+                    ++next;
+                    continue;
+                }
+
+                submitOne(next++);
+            }
+
+            if(finished == requests.size())
+                break;
+
+            // Reap one completion, then top the queue back up
+            DWORD transferred = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+
+            const BOOL ok = GetQueuedCompletionStatus(static_cast<HANDLE>(mCompletionPort),
+                &transferred, &key, &overlapped, INFINITE);
+
+            if(!overlapped)
+                throw IOException("Failed to read data");
+
+            const size_t idx = reinterpret_cast<PendingRead*>(overlapped)->index;
+            --inFlight;
+
+            if(!ok || transferred == 0)
+                throw IOException("Failed to read data");
+
+            completed[idx] += transferred;
+
+            if(completed[idx] >= requests[idx].len)
+                ++finished;
+            else
+                submitOne(idx);    // short read, go again for the rest
+        }
+    }
+
+} // namespace motioncam
+
+#endif // _WIN32
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/PlaybackScheduler.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace motioncam {
+
+    PlaybackScheduler::PlaybackScheduler(Decoder& decoder, size_t ringSize) : mDecoder(decoder) {
+        mRing.resize(std::max<size_t>(2, ringSize));
+
+        mAnchorWall = std::chrono::steady_clock::now();
+
+        const auto& frames = mDecoder.getFrames();
+        mAnchorMedia = frames.empty() ? 0 : frames.front();
+
+        mWorker = std::thread(&PlaybackScheduler::workerLoop, this);
+    }
+
+    PlaybackScheduler::~PlaybackScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+            mCond.notify_all();
+            mScrubDone.notify_all();
+        }
+
+        if(mWorker.joinable())
+            mWorker.join();
+    }
+
+    Timestamp PlaybackScheduler::playheadLocked() const {
+        const auto elapsed =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mAnchorWall).count();
+
+        return mAnchorMedia + static_cast<Timestamp>(mRate * static_cast<double>(elapsed));
+    }
+
+    Timestamp PlaybackScheduler::playhead() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        return playheadLocked();
+    }
+
+    void PlaybackScheduler::seek(const Timestamp timestamp, double rate) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mAnchorWall = std::chrono::steady_clock::now();
+        mAnchorMedia = timestamp;
+        mRate = rate;
+
+        const int64_t index = mDecoder.findFrame(timestamp, SeekMode::BEFORE);
+        mNextIndex = index < 0 ? 0 : index;
+        mLastDelivered = -1;
+
+        // Whatever is in flight is for the old position
+        for(auto& slot : mRing)
+            slot.ready = false;
+
+        // A seek is not part of a drag; start the direction model over
+        mScrubHistory.clear();
+        mScrubDirection = 0;
+        mSpeculateRemaining = 0;
+
+        mCond.notify_all();
+    }
+
+    void PlaybackScheduler::setRate(double rate) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // Re-anchor at the current position so the playhead doesn't jump
+        mAnchorMedia = playheadLocked();
+        mAnchorWall = std::chrono::steady_clock::now();
+        mRate = rate;
+
+        mCond.notify_all();
+    }
+
+    bool PlaybackScheduler::getFrame(Frame& outFrame) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        const Timestamp target = playheadLocked();
+
+        // Newest decoded frame at or before the playhead
+        Slot* best = nullptr;
+
+        for(auto& slot : mRing) {
+            if(slot.ready && slot.timestamp <= target && (!best || slot.frameIndex > best->frameIndex))
+                best = &slot;
+        }
+
+        if(!best || best->frameIndex <= mLastDelivered)
+            return false;
+
+        mLastDelivered = best->frameIndex;
+
+        outFrame.timestamp = best->timestamp;
+        std::swap(outFrame.data, best->data);    // recycle the caller's buffer into the ring
+        outFrame.metadata = std::move(best->metadata);
+
+        best->ready = false;
+
+        // Everything older than the delivered frame will never be shown
+        for(auto& slot : mRing) {
+            if(slot.ready && slot.frameIndex < mLastDelivered)
+                slot.ready = false;
+        }
+
+        mCond.notify_all();
+
+        return true;
+    }
+
+    std::shared_ptr<const CachedFrame> PlaybackScheduler::scrubFrame(const Timestamp timestamp) {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        const auto now = std::chrono::steady_clock::now();
+
+        int64_t index = mDecoder.findFrame(timestamp, SeekMode::BEFORE);
+
+        if(index < 0)
+            index = 0;
+
+        // Feed the direction model and refresh the speculation plan before
+        // waking the worker, so it prefetches as soon as this frame is out
+        mScrubHistory.push_back(ScrubSample { now, index });
+
+        while(mScrubHistory.size() > 6)
+            mScrubHistory.pop_front();
+
+        planSpeculationLocked(now);
+
+        mScrubTimestamp = timestamp;
+        mScrubPending = true;
+        mScrubServed = false;
+
+        mCond.notify_all();
+
+        mScrubDone.wait(lock, [this] { return mScrubServed || mStop; });
+
+        if(mStop && !mScrubServed)
+            return nullptr;
+
+        if(mScrubError)
+            std::rethrow_exception(mScrubError);
+
+        return std::move(mScrubResult);
+    }
+
+    void PlaybackScheduler::planSpeculationLocked(const std::chrono::steady_clock::time_point now) {
+        mScrubDirection = 0;
+        mSpeculateRemaining = 0;
+
+        // Speculating without a frame cache would decode frames nobody keeps
+        if(mDecoder.frameCacheBudget() == 0)
+            return;
+
+        // Only positions from an ongoing drag count; a stale history is a
+        // new gesture, not a direction
+        while(!mScrubHistory.empty() && now - mScrubHistory.front().wall > std::chrono::milliseconds(500))
+            mScrubHistory.pop_front();
+
+        if(mScrubHistory.size() < 2)
+            return;
+
+        const auto& first = mScrubHistory.front();
+        const auto& last = mScrubHistory.back();
+        const auto& previous = mScrubHistory[mScrubHistory.size() - 2];
+
+        // Direction from the newest step, velocity over the whole window
+        if(last.frameIndex == previous.frameIndex)
+            return;
+
+        mScrubDirection = last.frameIndex > previous.frameIndex ? 1 : -1;
+
+        const double seconds =
+            std::chrono::duration_cast<std::chrono::duration<double>>(last.wall - first.wall).count();
+        const double velocity =
+            seconds > 0.0 ? std::abs(static_cast<double>(last.frameIndex - first.frameIndex)) / seconds : 0.0;
+
+        // Decode ahead far enough to cover the next ~quarter second of the
+        // drag, within sane bounds
+        mSpeculateRemaining = std::min<int64_t>(16, std::max<int64_t>(2, static_cast<int64_t>(velocity * 0.25)));
+        mSpeculateIndex = last.frameIndex + mScrubDirection;
+    }
+
+    PlaybackScheduler::PlaybackStats PlaybackScheduler::getStats() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        return PlaybackStats { mFramesDecoded, mFramesDropped, mFramesPrefetched };
+    }
+
+    void PlaybackScheduler::workerLoop() {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        while(!mStop) {
+            const auto& frames = mDecoder.getFrames();
+
+            // A waiting scrub comes before everything else
+            if(mScrubPending) {
+                const Timestamp timestamp = mScrubTimestamp;
+                mScrubPending = false;
+
+                lock.unlock();
+
+                std::shared_ptr<const CachedFrame> frame;
+                std::exception_ptr error;
+
+                try {
+                    frame = mDecoder.loadCachedFrame(timestamp);
+                }
+                catch(...) {
+                    error = std::current_exception();
+                }
+
+                lock.lock();
+
+                mScrubResult = std::move(frame);
+                mScrubError = error;
+                mScrubServed = true;
+                mScrubDone.notify_all();
+
+                continue;
+            }
+
+            if(frames.empty()) {
+                mCond.wait(lock);
+                continue;
+            }
+
+            // Speculative scrub prefetch: while the transport is paused,
+            // decode ahead of the last scrub in its direction. Each frame
+            // loops back through the scrub check above, so a new request
+            // preempts the speculation at frame granularity.
+            if(mRate == 0.0 && mSpeculateRemaining > 0) {
+                if(mSpeculateIndex < 0 || mSpeculateIndex >= static_cast<int64_t>(frames.size())) {
+                    mSpeculateRemaining = 0;
+                    continue;
+                }
+
+                const Timestamp timestamp = frames[mSpeculateIndex];
+
+                mSpeculateIndex += mScrubDirection;
+                mSpeculateRemaining--;
+
+                lock.unlock();
+
+                bool prefetched = true;
+
+                try {
+                    mDecoder.loadCachedFrame(timestamp);
+                }
+                catch(...) {
+                    // Skip unreadable frames; the scrub itself will surface
+                    // the error if the user lands on one
+                    prefetched = false;
+                }
+
+                lock.lock();
+
+                if(prefetched)
+                    mFramesPrefetched++;
+
+                continue;
+            }
+
+            // The deadline check: decode for where the playhead is now,
+            // skipping frames that went stale while we were busy
+            int64_t needed = mDecoder.findFrame(playheadLocked(), SeekMode::BEFORE);
+
+            if(needed < 0)
+                needed = 0;
+
+            if(mNextIndex < needed) {
+                mFramesDropped += static_cast<uint64_t>(needed - mNextIndex);
+                mNextIndex = needed;
+            }
+
+            if(mNextIndex >= static_cast<int64_t>(frames.size())) {
+                // Decoded through to the end, wait for a seek
+                mCond.wait(lock);
+                continue;
+            }
+
+            // Claim a slot: a free one, or a decoded one that went stale
+            Slot* slot = nullptr;
+
+            for(auto& s : mRing) {
+                if(!s.ready || s.frameIndex <= mLastDelivered || s.frameIndex < needed) {
+                    slot = &s;
+                    break;
+                }
+            }
+
+            if(!slot) {
+                // Ring is full of frames the playhead still wants. Wake when
+                // the consumer frees a slot, or periodically while playing so
+                // frames passing the playhead get reclaimed.
+                if(mRate != 0.0)
+                    mCond.wait_for(lock, std::chrono::milliseconds(5));
+                else
+                    mCond.wait(lock);
+
+                continue;
+            }
+
+            const int64_t index = mNextIndex++;
+
+            slot->ready = false;
+
+            lock.unlock();
+
+            bool decoded = true;
+
+            try {
+                mDecoder.loadFrame(frames[index], slot->data, slot->metadata);
+            }
+            catch(...) {
+                // An unreadable frame is treated like a missed deadline;
+                // playback moves on to the next one
+                decoded = false;
+            }
+
+            lock.lock();
+
+            if(decoded) {
+                slot->ready = true;
+                slot->frameIndex = index;
+                slot->timestamp = frames[index];
+                mFramesDecoded++;
+            }
+            else
+                mFramesDropped++;
+        }
+    }
+
+} // namespace motioncam
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#if !defined(_WIN32)
+
+#include <motioncam/Reader.hpp>
+#include <motioncam/Decoder.hpp>
+#include <motioncam/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace motioncam {
+
+    PreadPoolReader::PreadPoolReader(const std::string& path) :
+        mFd(::open(path.c_str(), O_RDONLY)), mPos(0), mSize(-1)
+    {
+        if(mFd < 0)
+            throw IOException("Failed to open " + path);
+
+        struct stat st{};
+
+        if(::fstat(mFd, &st) == 0)
+            mSize = static_cast<int64_t>(st.st_size);
+    }
+
+    PreadPoolReader::~PreadPoolReader() {
+        ::close(mFd);
+    }
+
+    void PreadPoolReader::read(void* data, size_t size, size_t items) {
+        const size_t total = size * items;
+
+        if(::pread(mFd, data, total, mPos) != static_cast<ssize_t>(total))
+            throw IOException("Failed to read data");
+
+        mPos += static_cast<int64_t>(total);
+    }
+
+    bool PreadPoolReader::tryRead(void* data, size_t size) {
+        if(::pread(mFd, data, size, mPos) != static_cast<ssize_t>(size))
+            return false;
+
+        mPos += static_cast<int64_t>(size);
+
+        return true;
+    }
+
+    bool PreadPoolReader::seek(int64_t offset, int origin) {
+        int64_t pos;
+
+        switch(origin) {
+            case SEEK_SET:
+                pos = offset;
+                break;
+
+            case SEEK_CUR:
+                pos = mPos + offset;
+                break;
+
+            case SEEK_END:
+                pos = mSize + offset;
+                break;
+
+            default:
+                return false;
+        }
+
+        if(pos < 0)
+            return false;
+
+        mPos = pos;
+
+        return true;
+    }
+
+    int64_t PreadPoolReader::size() {
+        return mSize;
+    }
+
+    void PreadPoolReader::advise(int64_t offset, size_t len, Advice advice) {
+#if defined(__APPLE__)
+        if(advice == Advice::WILL_NEED) {
+            struct radvisory ra{};
+            ra.ra_offset = offset;
+            ra.ra_count = static_cast<int>(std::min<size_t>(len, INT32_MAX));
+
+            fcntl(mFd, F_RDADVISE, &ra);
+        }
+        else if(advice == Advice::SEQUENTIAL) {
+            fcntl(mFd, F_RDAHEAD, 1);
+        }
+#elif defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(mFd, offset, static_cast<off_t>(len),
+            advice == Advice::WILL_NEED ? POSIX_FADV_WILLNEED
+                : advice == Advice::SEQUENTIAL ? POSIX_FADV_SEQUENTIAL
+                : POSIX_FADV_DONTNEED);
+#else
+        (void) offset;
+        (void) len;
+        (void) advice;
+#endif
+    }
+
+    void PreadPoolReader::readBatch(const std::vector<ReadRequest>& requests) {
+        // pread carries its own offset, so every region runs independently;
+        // fanning them over the pool's I/O lanes keeps the device at queue
+        // depth the way the ring backends do. Small batches skip the pool -
+        // the dispatch overhead would exceed the reads.
+        if(requests.size() < 4 || ThreadPool::shared().numThreads() < 2) {
+            for(const auto& r : requests) {
+                if(::pread(mFd, r.dst, r.len, r.offset) != static_cast<ssize_t>(r.len))
+                    throw IOException("Failed to read data");
+            }
+
+            return;
+        }
+
+        std::atomic<bool> failed{false};
+
+        TaskGroup group;
+
+        for(const auto& r : requests) {
+            group.run(ThreadPool::shared(), Priority::IO, [this, &r, &failed] {
+                if(::pread(mFd, r.dst, r.len, r.offset) != static_cast<ssize_t>(r.len))
+                    failed.store(true, std::memory_order_relaxed);
+            });
+        }
+
+        group.wait();
+
+        if(failed.load())
+            throw IOException("Failed to read data");
+    }
+
+} // namespace motioncam
+
+#endif
@@ -0,0 +1,546 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/Preview.hpp>
+
+#include <motioncam/MemoryGovernor.hpp>
+
+#include <simde/arm/neon.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace motioncam {
+    namespace {
+        // XYZ (D50) to linear sRGB, Bradford adapted - the fixed second leg
+        // of the color pipeline; the camera-specific leg comes from the
+        // container
+        const double XYZ_D50_TO_SRGB[9] = {
+             3.1338561, -1.6168667, -0.4906146,
+            -0.9787684,  1.9161415,  0.0334540,
+             0.0719453, -0.2289914,  1.4052427
+        };
+
+        bool isZero(const std::array<double, 9>& m) {
+            for(const double v : m) {
+                if(std::fabs(v) > 1e-9)
+                    return false;
+            }
+
+            return true;
+        }
+
+        std::array<double, 9> multiply3x3(const double* a, const double* b) {
+            std::array<double, 9> out{};
+
+            for(int i = 0; i < 3; i++) {
+                for(int j = 0; j < 3; j++)
+                    out[3*i + j] = a[3*i]*b[j] + a[3*i + 1]*b[3 + j] + a[3*i + 2]*b[6 + j];
+            }
+
+            return out;
+        }
+
+        bool invert3x3(const std::array<double, 9>& m, std::array<double, 9>& out) {
+            const double det =
+                m[0]*(m[4]*m[8] - m[5]*m[7]) -
+                m[1]*(m[3]*m[8] - m[5]*m[6]) +
+                m[2]*(m[3]*m[7] - m[4]*m[6]);
+
+            if(std::fabs(det) < 1e-12)
+                return false;
+
+            const double inv = 1.0 / det;
+
+            out[0] = (m[4]*m[8] - m[5]*m[7]) * inv;
+            out[1] = (m[2]*m[7] - m[1]*m[8]) * inv;
+            out[2] = (m[1]*m[5] - m[2]*m[4]) * inv;
+            out[3] = (m[5]*m[6] - m[3]*m[8]) * inv;
+            out[4] = (m[0]*m[8] - m[2]*m[6]) * inv;
+            out[5] = (m[2]*m[3] - m[0]*m[5]) * inv;
+            out[6] = (m[3]*m[7] - m[4]*m[6]) * inv;
+            out[7] = (m[1]*m[6] - m[0]*m[7]) * inv;
+            out[8] = (m[0]*m[4] - m[1]*m[3]) * inv;
+
+            return true;
+        }
+
+        // (v * gain) >> 14, saturated into the 12-bit working range
+        simde_uint16x8_t applyGain(const simde_uint16x8_t v, const uint16_t gain) {
+            const simde_uint16x4_t g = simde_vdup_n_u16(gain);
+
+            const simde_uint32x4_t lo = simde_vmull_u16(simde_vget_low_u16(v), g);
+            const simde_uint32x4_t hi = simde_vmull_u16(simde_vget_high_u16(v), g);
+
+            return simde_vminq_u16(
+                simde_vcombine_u16(simde_vqshrn_n_u32(lo, 14), simde_vqshrn_n_u32(hi, 14)),
+                simde_vdupq_n_u16(4095));
+        }
+
+        // One matrix row: (c0*r + c1*g + c2*b) >> 13, saturated to 12 bits.
+        // The lanes land in an array because the sRGB curve lookup that
+        // follows is a table walk, not a vector operation.
+        void applyMatrixRow(
+            const simde_int16x8_t r,
+            const simde_int16x8_t g,
+            const simde_int16x8_t b,
+            const int16_t* coeff,
+            uint16_t* outLanes)
+        {
+            const simde_int16x4_t c0 = simde_vdup_n_s16(coeff[0]);
+            const simde_int16x4_t c1 = simde_vdup_n_s16(coeff[1]);
+            const simde_int16x4_t c2 = simde_vdup_n_s16(coeff[2]);
+
+            simde_int32x4_t lo = simde_vmull_s16(simde_vget_low_s16(r), c0);
+            lo = simde_vmlal_s16(lo, simde_vget_low_s16(g), c1);
+            lo = simde_vmlal_s16(lo, simde_vget_low_s16(b), c2);
+
+            simde_int32x4_t hi = simde_vmull_s16(simde_vget_high_s16(r), c0);
+            hi = simde_vmlal_s16(hi, simde_vget_high_s16(g), c1);
+            hi = simde_vmlal_s16(hi, simde_vget_high_s16(b), c2);
+
+            const simde_uint16x8_t v = simde_vminq_u16(
+                simde_vcombine_u16(simde_vqshrun_n_s32(lo, 13), simde_vqshrun_n_s32(hi, 13)),
+                simde_vdupq_n_u16(4095));
+
+            simde_vst1q_u16(outLanes, v);
+        }
+    }
+
+    // Each site plane of the output cell averages the four matching sites
+    // of the source 2x2 cell block, so the output stays a Bayer mosaic in
+    // the same arrangement at half the linear resolution. Odd trailing
+    // rows and columns are dropped to keep the result an even-sized
+    // mosaic.
+    void BinBayerHalf(const uint16_t* src, const int srcWidth, const int srcHeight, BayerMip& out) {
+        out.width = (srcWidth / 2) & ~1;
+        out.height = (srcHeight / 2) & ~1;
+
+        out.data.resize(static_cast<size_t>(out.width) * out.height);
+
+        for(int y = 0; y < out.height; y++) {
+            // Output row y keeps the site parity of source row
+            // 4*(y/2) + (y&1) and averages it with the row two below
+            const uint16_t* r0 = src + static_cast<size_t>(4*(y >> 1) + (y & 1)) * srcWidth;
+            const uint16_t* r1 = r0 + 2*srcWidth;
+
+            uint16_t* dst = out.data.data() + static_cast<size_t>(y) * out.width;
+
+            int x = 0;
+
+            // Eight output pixels per iteration: the interleaved load
+            // separates the row's two sites, the widening pairwise add
+            // joins horizontal cell neighbors, the row sum joins the
+            // vertical ones, +2 rounds the >>2 average
+            for(; x + 8 <= out.width; x += 8) {
+                const simde_uint16x8x2_t a = simde_vld2q_u16(r0 + 2*x);
+                const simde_uint16x8x2_t b = simde_vld2q_u16(r1 + 2*x);
+
+                const simde_uint32x4_t even = simde_vaddq_u32(simde_vpaddlq_u16(a.val[0]), simde_vpaddlq_u16(b.val[0]));
+                const simde_uint32x4_t odd = simde_vaddq_u32(simde_vpaddlq_u16(a.val[1]), simde_vpaddlq_u16(b.val[1]));
+
+                simde_uint16x4x2_t st;
+
+                st.val[0] = simde_vmovn_u32(simde_vshrq_n_u32(simde_vaddq_u32(even, simde_vdupq_n_u32(2)), 2));
+                st.val[1] = simde_vmovn_u32(simde_vshrq_n_u32(simde_vaddq_u32(odd, simde_vdupq_n_u32(2)), 2));
+
+                simde_vst2_u16(dst + x, st);
+            }
+
+            // Scalar tail, same arithmetic
+            for(; x < out.width; x++) {
+                const int c = 4*(x >> 1) + (x & 1);
+
+                dst[x] = static_cast<uint16_t>((r0[c] + r0[c + 2] + r1[c] + r1[c + 2] + 2) >> 2);
+            }
+        }
+    }
+
+    PreviewEngine::PreviewEngine(const ContainerMetadata& containerMetadata)
+        : mMetadata(containerMetadata)
+    {
+        // Cell positions of R, G1, G2, B within the 2x2, reading the cell
+        // row major. Containers without a recorded arrangement get RGGB,
+        // by far the most common.
+        switch(containerMetadata.sensorArrangement) {
+            case ColorFilterArrangement::BGGR:
+                mPos = { 3, 1, 2, 0 };
+                break;
+
+            case ColorFilterArrangement::GRBG:
+                mPos = { 1, 0, 3, 2 };
+                break;
+
+            case ColorFilterArrangement::GBRG:
+                mPos = { 2, 0, 3, 1 };
+                break;
+
+            case ColorFilterArrangement::RGGB:
+            default:
+                mPos = { 0, 1, 2, 3 };
+                break;
+        }
+
+        // Camera-to-XYZ leg: the forward matrix is exactly this (for white
+        // balanced camera values, which is what the gains produce). Without
+        // one, the inverted color matrix is close enough for a preview, and
+        // with neither the camera space passes through as-is.
+        std::array<double, 9> cameraToSrgb{ 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+        std::array<double, 9> cameraToXyz{};
+
+        if(!isZero(containerMetadata.forwardMatrix1))
+            cameraToSrgb = multiply3x3(XYZ_D50_TO_SRGB, containerMetadata.forwardMatrix1.data());
+        else if(invert3x3(containerMetadata.colorMatrix1, cameraToXyz))
+            cameraToSrgb = multiply3x3(XYZ_D50_TO_SRGB, cameraToXyz.data());
+
+        // White balanced white must stay white: normalize each row so the
+        // matrix maps (1,1,1) to (1,1,1), then quantize to Q13
+        for(int i = 0; i < 3; i++) {
+            const double sum = cameraToSrgb[3*i] + cameraToSrgb[3*i + 1] + cameraToSrgb[3*i + 2];
+
+            for(int j = 0; j < 3; j++) {
+                const double coeff = std::fabs(sum) > 1e-6 ? cameraToSrgb[3*i + j] / sum : (i == j ? 1.0 : 0.0);
+
+                mMatrix[3*i + j] = static_cast<int16_t>(
+                    std::min(32767l, std::max(-32768l, std::lround(coeff * 8192.0))));
+            }
+        }
+
+        // sRGB transfer curve over the 12-bit linear working range
+        for(int i = 0; i < 4096; i++) {
+            const double x = i / 4095.0;
+            const double y = x <= 0.0031308 ? 12.92 * x : 1.055 * std::pow(x, 1.0 / 2.4) - 0.055;
+
+            mGammaLut[i] = static_cast<uint8_t>(std::lround(255.0 * std::min(1.0, std::max(0.0, y))));
+        }
+    }
+
+    void PreviewEngine::updateGains(const std::array<double, 3>& neutral) {
+        const double white = mMetadata.whiteLevel > 0 ? mMetadata.whiteLevel : 65535.0;
+
+        // Black level is per cell position; each channel's gain uses the
+        // level at its own site (the first green site for green)
+        const int site[3] = { mPos[0], mPos[1], mPos[3] };
+
+        for(int c = 0; c < 3; c++) {
+            const double range = std::max(1.0, white - mMetadata.blackLevel[site[c]]);
+            const double gain = (1.0 / std::max(0.01, neutral[c])) * 4095.0 * 16384.0 / range;
+
+            mGain[c] = static_cast<uint16_t>(std::min(65535l, std::max(1l, std::lround(gain))));
+        }
+
+        mNeutral = neutral;
+    }
+
+    void PreviewEngine::render(
+        const std::vector<uint16_t>& data,
+        const nlohmann::json& metadata,
+        std::vector<uint8_t>& outRgb,
+        int& outWidth,
+        int& outHeight)
+    {
+        if(!metadata.contains("width") || !metadata.contains("height"))
+            throw MotionCamException("Preview frame metadata is missing its dimensions");
+
+        const int width = metadata["width"];
+        const int height = metadata["height"];
+
+        if(width < 2 || height < 2 || data.size() < static_cast<size_t>(width) * height)
+            throw MotionCamException("Preview frame does not match its metadata");
+
+        std::array<double, 3> neutral{ 1.0, 1.0, 1.0 };
+
+        if(metadata.contains("asShotNeutral") && metadata["asShotNeutral"].size() == 3) {
+            for(int i = 0; i < 3; i++)
+                neutral[i] = metadata["asShotNeutral"][i];
+        }
+
+        if(neutral != mNeutral)
+            updateGains(neutral);
+
+        outWidth = width / 2;
+        outHeight = height / 2;
+
+        outRgb.resize(static_cast<size_t>(outWidth) * outHeight * 3);
+
+        const simde_uint16x8_t black[4] = {
+            simde_vdupq_n_u16(mMetadata.blackLevel[0]),
+            simde_vdupq_n_u16(mMetadata.blackLevel[1]),
+            simde_vdupq_n_u16(mMetadata.blackLevel[2]),
+            simde_vdupq_n_u16(mMetadata.blackLevel[3]),
+        };
+
+        for(int y = 0; y < outHeight; y++) {
+            const uint16_t* top = data.data() + static_cast<size_t>(2*y) * width;
+            const uint16_t* bot = top + width;
+
+            uint8_t* out = outRgb.data() + static_cast<size_t>(y) * outWidth * 3;
+
+            int x = 0;
+
+            // Eight cells per iteration: the interleaved loads split each
+            // row pair into its two cell columns, giving the four cell
+            // sites as whole vectors
+            for(; x + 8 <= outWidth; x += 8) {
+                const simde_uint16x8x2_t t = simde_vld2q_u16(top + 2*x);
+                const simde_uint16x8x2_t b = simde_vld2q_u16(bot + 2*x);
+
+                const simde_uint16x8_t site[4] = {
+                    simde_vqsubq_u16(t.val[0], black[0]),
+                    simde_vqsubq_u16(t.val[1], black[1]),
+                    simde_vqsubq_u16(b.val[0], black[2]),
+                    simde_vqsubq_u16(b.val[1], black[3]),
+                };
+
+                // White balanced 12-bit camera RGB, greens averaged
+                const simde_uint16x8_t r12 = applyGain(site[mPos[0]], mGain[0]);
+                const simde_uint16x8_t g12 = applyGain(simde_vhaddq_u16(site[mPos[1]], site[mPos[2]]), mGain[1]);
+                const simde_uint16x8_t b12 = applyGain(site[mPos[3]], mGain[2]);
+
+                const simde_int16x8_t rs = simde_vreinterpretq_s16_u16(r12);
+                const simde_int16x8_t gs = simde_vreinterpretq_s16_u16(g12);
+                const simde_int16x8_t bs = simde_vreinterpretq_s16_u16(b12);
+
+                uint16_t lanes[3][8];
+
+                applyMatrixRow(rs, gs, bs, &mMatrix[0], lanes[0]);
+                applyMatrixRow(rs, gs, bs, &mMatrix[3], lanes[1]);
+                applyMatrixRow(rs, gs, bs, &mMatrix[6], lanes[2]);
+
+                for(int k = 0; k < 8; k++) {
+                    out[0] = mGammaLut[lanes[0][k]];
+                    out[1] = mGammaLut[lanes[1][k]];
+                    out[2] = mGammaLut[lanes[2][k]];
+
+                    out += 3;
+                }
+            }
+
+            // Scalar tail, same arithmetic
+            for(; x < outWidth; x++) {
+                const uint16_t* tc = top + 2*x;
+                const uint16_t* bc = bot + 2*x;
+
+                const uint32_t site[4] = {
+                    static_cast<uint32_t>(std::max(0, tc[0] - mMetadata.blackLevel[0])),
+                    static_cast<uint32_t>(std::max(0, tc[1] - mMetadata.blackLevel[1])),
+                    static_cast<uint32_t>(std::max(0, bc[0] - mMetadata.blackLevel[2])),
+                    static_cast<uint32_t>(std::max(0, bc[1] - mMetadata.blackLevel[3])),
+                };
+
+                const int32_t rgb[3] = {
+                    static_cast<int32_t>(std::min<uint32_t>(4095, (site[mPos[0]] * mGain[0]) >> 14)),
+                    static_cast<int32_t>(std::min<uint32_t>(4095, (((site[mPos[1]] + site[mPos[2]]) >> 1) * mGain[1]) >> 14)),
+                    static_cast<int32_t>(std::min<uint32_t>(4095, (site[mPos[3]] * mGain[2]) >> 14)),
+                };
+
+                for(int c = 0; c < 3; c++) {
+                    const int32_t v = (mMatrix[3*c]*rgb[0] + mMatrix[3*c + 1]*rgb[1] + mMatrix[3*c + 2]*rgb[2]) >> 13;
+
+                    out[c] = mGammaLut[std::min(4095, std::max(0, v))];
+                }
+
+                out += 3;
+            }
+        }
+    }
+
+    MipCache::MipCache(size_t maxFrames)
+        : mMaxFrames(std::max<size_t>(1, maxFrames))
+    {
+        mReclaimerId = MemoryGovernor::shared().registerReclaimer(
+            MemoryGovernor::Subsystem::FRAME_CACHE,
+            [this](size_t bytes) {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                const size_t freed = evictTo(mBytes > bytes ? mBytes - bytes : 0);
+
+                MemoryGovernor::shared().release(MemoryGovernor::Subsystem::FRAME_CACHE, freed);
+
+                return freed;
+            });
+    }
+
+    MipCache::~MipCache() {
+        MemoryGovernor::shared().unregisterReclaimer(mReclaimerId);
+
+        clear();
+    }
+
+    std::shared_ptr<const BayerMip> MipCache::level(
+        Timestamp timestamp,
+        int level,
+        const std::vector<uint16_t>& data,
+        int width,
+        int height)
+    {
+        if(width < 2 || height < 2 || data.size() < static_cast<size_t>(width) * height)
+            throw MotionCamException("Mip source frame does not match its dimensions");
+
+        level = std::min(3, std::max(1, level));
+
+        // The level requested, or the nearest shallower one the frame was
+        // large enough to produce
+        const auto pick = [level](const Chain& chain) -> std::shared_ptr<const BayerMip> {
+            for(int l = level; l >= 1; l--) {
+                if(chain.levels[l - 1])
+                    return chain.levels[l - 1];
+            }
+
+            return nullptr;
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            const auto it = mIndex.find(timestamp);
+
+            if(it != mIndex.end()) {
+                mLru.splice(mLru.begin(), mLru, it->second);
+
+                return pick(it->second->second);
+            }
+        }
+
+        // Build outside the lock; concurrent misses on the same frame just
+        // build twice and the loser's chain is dropped
+        Chain chain;
+
+        const uint16_t* src = data.data();
+        int srcWidth = width;
+        int srcHeight = height;
+
+        for(int l = 0; l < 3 && srcWidth >= 4 && srcHeight >= 4; l++) {
+            auto mip = std::make_shared<BayerMip>();
+
+            BinBayerHalf(src, srcWidth, srcHeight, *mip);
+
+            chain.bytes += mip->data.size() * sizeof(uint16_t);
+
+            src = mip->data.data();
+            srcWidth = mip->width;
+            srcHeight = mip->height;
+
+            chain.levels[l] = std::move(mip);
+        }
+
+        auto result = pick(chain);
+
+        const size_t chainBytes = chain.bytes;
+        size_t freed = 0;
+        bool inserted = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            if(mIndex.find(timestamp) == mIndex.end()) {
+                mLru.emplace_front(timestamp, std::move(chain));
+                mIndex[timestamp] = mLru.begin();
+                mBytes += chainBytes;
+
+                inserted = true;
+
+                // The frame-count cap is independent of the governor
+                while(mLru.size() > mMaxFrames) {
+                    const auto& victim = mLru.back();
+
+                    freed += victim.second.bytes;
+                    mBytes -= victim.second.bytes;
+                    mIndex.erase(victim.first);
+                    mLru.pop_back();
+                }
+            }
+        }
+
+        // Charge without the cache lock held: going over budget runs the
+        // reclaimers, including this cache's own
+        if(inserted) {
+            MemoryGovernor::shared().charge(MemoryGovernor::Subsystem::FRAME_CACHE, chainBytes);
+
+            if(freed > 0)
+                MemoryGovernor::shared().release(MemoryGovernor::Subsystem::FRAME_CACHE, freed);
+        }
+
+        return result;
+    }
+
+    void MipCache::clear() {
+        size_t freed = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            freed = evictTo(0);
+        }
+
+        MemoryGovernor::shared().release(MemoryGovernor::Subsystem::FRAME_CACHE, freed);
+    }
+
+    size_t MipCache::evictTo(size_t maxBytes) {
+        size_t freed = 0;
+
+        while(mBytes > maxBytes && !mLru.empty()) {
+            const auto& victim = mLru.back();
+
+            freed += victim.second.bytes;
+            mBytes -= victim.second.bytes;
+            mIndex.erase(victim.first);
+            mLru.pop_back();
+        }
+
+        return freed;
+    }
+
+    void RenderThumbnail(
+        const std::vector<uint16_t>& data,
+        const nlohmann::json& metadata,
+        const ContainerMetadata& containerMetadata,
+        const int maxDim,
+        Thumbnail& outThumbnail)
+    {
+        if(!metadata.contains("width") || !metadata.contains("height"))
+            throw MotionCamException("Thumbnail frame metadata is missing its dimensions");
+
+        int width = metadata["width"];
+        int height = metadata["height"];
+
+        // Bin the mosaic down first - each level quarters the pixels the
+        // render touches - until the render's half-resolution output lands
+        // at or under maxDim on the long edge
+        const std::vector<uint16_t>* src = &data;
+        BayerMip mip;
+
+        while(std::max(width, height) / 2 > maxDim && width >= 8 && height >= 8) {
+            BayerMip next;
+
+            BinBayerHalf(src->data(), width, height, next);
+
+            mip = std::move(next);
+            src = &mip.data;
+            width = mip.width;
+            height = mip.height;
+        }
+
+        // A binned level renders with just its own dimensions substituted
+        nlohmann::json renderMetadata = metadata;
+        renderMetadata["width"] = width;
+        renderMetadata["height"] = height;
+
+        PreviewEngine engine(containerMetadata);
+
+        engine.render(*src, renderMetadata, outThumbnail.rgb, outThumbnail.width, outThumbnail.height);
+    }
+}
@@ -1,11 +1,14 @@
 #include <motioncam/RawData.hpp>
+#include <motioncam/ThreadPool.hpp>
+#include <motioncam/Trace.hpp>
+#include <algorithm>
 #include <vector>
 #include <cstring>
 
 #include <simde/arm/neon.h>
 
 #if defined(__GNUC__)
-#  define INLINE  __attribute__((always_inline))
+#  define INLINE  inline __attribute__((always_inline))
 #  define RESTRICT __restrict__
 #elif defined(_MSC_VER)
 #  define INLINE __forceinline
@@ -15,6 +18,51 @@
 #  define RESTRICT
 #endif
 
+// Native AVX2 backend for the kernels whose packed layout widens cleanly
+// to 16 lanes; the kernels themselves live in RawDataAVX2.h. When the
+// whole library is built with AVX2 support (-mavx2 / /arch:AVX2) the wide
+// kernels are used unconditionally. Otherwise, on x86 with GCC/Clang, they
+// are compiled per-function with the avx2 target attribute and selected at
+// runtime from a one-time CPUID probe, so a single generic binary still
+// hits the wide path on capable machines. Compilers without the attribute
+// (MSVC) get the same kernels from RawDataAVX2.cpp, a separate translation
+// unit compiled with AVX2 flags; the build defines MOTIONCAM_RAW_SPLIT_AVX2
+// to select that shape.
+#if defined(__AVX2__)
+    #define MOTIONCAM_RAW_AVX2 1
+    #define MOTIONCAM_RAW_DISPATCH 0
+    #define MOTIONCAM_RAW_EXTERN_AVX2 0
+    #include <immintrin.h>
+
+    #define AVX2_FN INLINE
+    #define AVX2_HELPER INLINE
+    #include "RawDataAVX2.h"
+#elif defined(MOTIONCAM_RAW_SPLIT_AVX2)
+    #define MOTIONCAM_RAW_AVX2 0
+    #define MOTIONCAM_RAW_DISPATCH 1
+    #define MOTIONCAM_RAW_EXTERN_AVX2 1
+    #include <immintrin.h>
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+    #define MOTIONCAM_RAW_AVX2_DECLARE_ONLY 1
+    #include "RawDataAVX2.h"
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define MOTIONCAM_RAW_AVX2 0
+    #define MOTIONCAM_RAW_DISPATCH 1
+    #define MOTIONCAM_RAW_EXTERN_AVX2 0
+    #include <immintrin.h>
+
+    #define AVX2_FN __attribute__((target("avx2")))
+    #define AVX2_HELPER inline __attribute__((always_inline, target("avx2")))
+    #include "RawDataAVX2.h"
+#else
+    #define MOTIONCAM_RAW_AVX2 0
+    #define MOTIONCAM_RAW_DISPATCH 0
+    #define MOTIONCAM_RAW_EXTERN_AVX2 0
+#endif
+
 namespace motioncam {
     namespace raw {
     
@@ -43,6 +91,15 @@ namespace motioncam {
         128
     };
 
+#if MOTIONCAM_RAW_AVX2 || MOTIONCAM_RAW_DISPATCH
+    static_assert(avx2::BLOCK == ENCODING_BLOCK
+        && avx2::BLOCK_LENGTH_2 == ENCODING_BLOCK_LENGTH[2]
+        && avx2::BLOCK_LENGTH_4 == ENCODING_BLOCK_LENGTH[4]
+        && avx2::BLOCK_LENGTH_8 == ENCODING_BLOCK_LENGTH[8]
+        && avx2::BLOCK_LENGTH_16 == ENCODING_BLOCK_LENGTH[16],
+        "RawDataAVX2.h block constants out of sync");
+#endif
+
     struct UInt16x8 {
         const simde_uint16x8_t d;
         
@@ -78,13 +135,24 @@ namespace motioncam {
         }
         
         INLINE
-        UInt16x8 operator<<(const int16_t n) const {
-            return UInt16x8(simde_vshlq_u16(d, simde_vdupq_n_s16(n)));
+        UInt16x8 operator+(const UInt16x8& rhs) const {
+            return UInt16x8(simde_vaddq_u16(d, rhs.d));
         }
-        
+
+        // Shift counts are compile-time constants at every call site, so
+        // the shifts take the immediate forms: one instruction per shift,
+        // instead of materializing the count into a vector register for
+        // the variable-shift instruction each time
+        template<int N>
+        INLINE
+        UInt16x8 shl() const {
+            return UInt16x8(simde_vshlq_n_u16(d, N));
+        }
+
+        template<int N>
         INLINE
-        UInt16x8 operator>>(const int16_t n) const {
-            return UInt16x8(simde_vshlq_u16(d, simde_vdupq_n_s16(-n)));
+        UInt16x8 shr() const {
+            return UInt16x8(simde_vshrq_n_u16(d, N));
         }
     };
 
@@ -98,6 +166,15 @@ namespace motioncam {
         simde_vst1q_u16(dst, src.d);
     }
 
+    // Full-width 16-bit load; the stream gives no alignment guarantee
+    INLINE
+    UInt16x8 LoadU16(const uint8_t* src) {
+        simde_uint16x8_t v;
+        std::memcpy(&v, src, sizeof(v));
+
+        return UInt16x8(v);
+    }
+
 
     INLINE
     void DecodeHeader(uint8_t& bits, uint16_t& reference, const uint8_t* input) {
@@ -106,59 +183,63 @@ namespace motioncam {
     }
     
     INLINE
-    const uint8_t* Decode1(uint16_t *RESTRICT output, const uint8_t* input) {
+    const uint8_t* Decode1(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
         const UInt16x8 N(0x01);
         const UInt16x8 p = Load(input);
 
         const UInt16x8 r0 =  p & N;
-        const UInt16x8 r1 = (p & (N << 1)) >> 1;
-        const UInt16x8 r2 = (p & (N << 2)) >> 2;
-        const UInt16x8 r3 = (p & (N << 3)) >> 3;
-        const UInt16x8 r4 = (p & (N << 4)) >> 4;
-        const UInt16x8 r5 = (p & (N << 5)) >> 5;
-        const UInt16x8 r6 = (p & (N << 6)) >> 6;
-        const UInt16x8 r7 = (p & (N << 7)) >> 7;
-
-        Store(output,      r0);
-        Store(output + 8,  r1);
-        Store(output + 16, r2);
-        Store(output + 24, r3);
-        Store(output + 32, r4);
-        Store(output + 40, r5);
-        Store(output + 48, r6);
-        Store(output + 56, r7);
+        const UInt16x8 r1 = p.shr<1>() & N;
+        const UInt16x8 r2 = p.shr<2>() & N;
+        const UInt16x8 r3 = p.shr<3>() & N;
+        const UInt16x8 r4 = p.shr<4>() & N;
+        const UInt16x8 r5 = p.shr<5>() & N;
+        const UInt16x8 r6 = p.shr<6>() & N;
+        const UInt16x8 r7 = p.shr<7>() & N;
+
+        Store(output, r0 + REF);
+        Store(output + 8, r1 + REF);
+        Store(output + 16, r2 + REF);
+        Store(output + 24, r3 + REF);
+        Store(output + 32, r4 + REF);
+        Store(output + 40, r5 + REF);
+        Store(output + 48, r6 + REF);
+        Store(output + 56, r7 + REF);
         
         return input + ENCODING_BLOCK_LENGTH[1];
     }
     
     INLINE
-    const uint8_t* Decode2_One(uint16_t *RESTRICT output, const uint8_t* input) {
+    const uint8_t* Decode2_One(uint16_t *RESTRICT output, const uint8_t* input, const UInt16x8& REF) {
         const UInt16x8 N(0x03);
         const UInt16x8 p = Load(input);
 
         const UInt16x8 r0 =  p & N;
-        const UInt16x8 r1 = (p & (N << 2)) >> 2;
-        const UInt16x8 r2 = (p & (N << 4)) >> 4;
-        const UInt16x8 r3 = (p & (N << 6)) >> 6;
+        const UInt16x8 r1 = p.shr<2>() & N;
+        const UInt16x8 r2 = p.shr<4>() & N;
+        const UInt16x8 r3 = p.shr<6>() & N;
         
-        Store(output,      r0);
-        Store(output + 8,  r1);
-        Store(output + 16, r2);
-        Store(output + 24, r3);
+        Store(output, r0 + REF);
+        Store(output + 8, r1 + REF);
+        Store(output + 16, r2 + REF);
+        Store(output + 24, r3 + REF);
         
         return input + 8;
     }
     
     INLINE
-    const uint8_t* Decode2(uint16_t *RESTRICT output, const uint8_t* input) {
-        input = Decode2_One(output, input);
-        input = Decode2_One(output + 32, input);
+    const uint8_t* Decode2(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
+
+        input = Decode2_One(output, input, REF);
+        input = Decode2_One(output + 32, input, REF);
         
         return input;
     }
     
     INLINE
-    const uint8_t* Decode3(uint16_t *RESTRICT output, const uint8_t* input) {
+    const uint8_t* Decode3(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
         const UInt16x8 N(0x07);
         const UInt16x8 T(0x03);
         const UInt16x8 R(0x01);
@@ -168,58 +249,61 @@ namespace motioncam {
         const UInt16x8 p2 = Load(input+16);
 
         const UInt16x8 r0  =  p0 & N;
-        const UInt16x8 r1  = (p0 & (N << 3)) >> 3;
-        const UInt16x8 _r2 = (p0 & (T << 6)) >> 6;
+        const UInt16x8 r1  = p0.shr<3>() & N;
+        const UInt16x8 _r2 = p0.shr<6>() & T;
 
         const UInt16x8 r3  =  p1 & N;
-        const UInt16x8 r4  = (p1 & (N << 3)) >> 3;
-        const UInt16x8 _r5 = (p1 & (T << 6)) >> 6;
+        const UInt16x8 r4  = p1.shr<3>() & N;
+        const UInt16x8 _r5 = p1.shr<6>() & T;
 
         const UInt16x8 r6  =  p2 & N;
-        const UInt16x8 r7  = (p2 & (N << 3)) >> 3;
+        const UInt16x8 r7  = p2.shr<3>() & N;
 
         // Restore upper bits
-        const UInt16x8 r2 = _r2 | (((p2 >> 6) & R) << 2);
-        const UInt16x8 r5 = _r5 | (((p2 >> 7) & R) << 2);
-
-        Store(output,      r0);
-        Store(output + 8,  r1);
-        Store(output + 16, r2);
-        Store(output + 24, r3);
-        Store(output + 32, r4);
-        Store(output + 40, r5);
-        Store(output + 48, r6);
-        Store(output + 56, r7);
+        const UInt16x8 r2 = _r2 | (p2.shr<6>() & R).shl<2>();
+        const UInt16x8 r5 = _r5 | (p2.shr<7>() & R).shl<2>();
+
+        Store(output, r0 + REF);
+        Store(output + 8, r1 + REF);
+        Store(output + 16, r2 + REF);
+        Store(output + 24, r3 + REF);
+        Store(output + 32, r4 + REF);
+        Store(output + 40, r5 + REF);
+        Store(output + 48, r6 + REF);
+        Store(output + 56, r7 + REF);
         
         return input + ENCODING_BLOCK_LENGTH[3];
     }
 
     INLINE
-    const uint8_t* Decode4_One(uint16_t *RESTRICT output, const uint8_t* input) {
+    const uint8_t* Decode4_One(uint16_t *RESTRICT output, const uint8_t* input, const UInt16x8& REF) {
         const UInt16x8 N(0x0F);
         const UInt16x8 p = Load(input);
        
         const UInt16x8 r0 =  p & N;
-        const UInt16x8 r1 = (p & (N << 4)) >> 4;
+        const UInt16x8 r1 = p.shr<4>() & N;
         
-        Store(output,    r0);
-        Store(output+8,  r1);
+        Store(output, r0 + REF);
+        Store(output+8, r1 + REF);
         
         return input + 8;
     }
     
     INLINE
-    const uint8_t* Decode4(uint16_t *RESTRICT output, const uint8_t* input) {
-        input = Decode4_One(output, input);
-        input = Decode4_One(output + 16, input);
-        input = Decode4_One(output + 32, input);
-        input = Decode4_One(output + 48, input);
+    const uint8_t* Decode4(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
+
+        input = Decode4_One(output, input, REF);
+        input = Decode4_One(output + 16, input, REF);
+        input = Decode4_One(output + 32, input, REF);
+        input = Decode4_One(output + 48, input, REF);
         
         return input;
     }
     
     INLINE
-    const uint8_t* Decode5(uint16_t *RESTRICT output, const uint8_t* input) {
+    const uint8_t* Decode5(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
         const UInt16x8 N(0x1F);
         const UInt16x8 L(0x07);
         const UInt16x8 U(0x03);
@@ -237,28 +321,29 @@ namespace motioncam {
         const UInt16x8 r3 =  p3 & N;
         const UInt16x8 r4 =  p4 & N;
         
-        const UInt16x8 r5 = (p0 >> 5) & L | (((p3 >> 5) & U) << 3);
-        const UInt16x8 r6 = (p1 >> 5) & L | (((p4 >> 5) & U) << 3);
+        const UInt16x8 r5 = (p0.shr<5>() & L) | (p3.shr<5>() & U).shl<3>();
+        const UInt16x8 r6 = (p1.shr<5>() & L) | (p4.shr<5>() & U).shl<3>();
 
-        const UInt16x8 tmp0 = (p2 >> 5) & L;
-        const UInt16x8 tmp1 = tmp0 | ((p3 >> 7) & F) << 3;
+        const UInt16x8 tmp0 = p2.shr<5>() & L;
+        const UInt16x8 tmp1 = tmp0 | (p3.shr<7>() & F).shl<3>();
         
-        const UInt16x8 r7   = tmp1 | ((p4 >> 7) & F) << 4;
+        const UInt16x8 r7   = tmp1 | (p4.shr<7>() & F).shl<4>();
         
-        Store(output,      r0);
-        Store(output + 8,  r1);
-        Store(output + 16, r2);
-        Store(output + 24, r3);
-        Store(output + 32, r4);
-        Store(output + 40, r5);
-        Store(output + 48, r6);
-        Store(output + 56, r7);
+        Store(output, r0 + REF);
+        Store(output + 8, r1 + REF);
+        Store(output + 16, r2 + REF);
+        Store(output + 24, r3 + REF);
+        Store(output + 32, r4 + REF);
+        Store(output + 40, r5 + REF);
+        Store(output + 48, r6 + REF);
+        Store(output + 56, r7 + REF);
 
         return input + ENCODING_BLOCK_LENGTH[5];
     }
     
     INLINE
-    const uint8_t* Decode6(uint16_t *RESTRICT output, const uint8_t* input) {
+    const uint8_t* Decode6(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
         const UInt16x8 N(0x3F);
         const UInt16x8 L(0x03);
 
@@ -277,185 +362,481 @@ namespace motioncam {
         const UInt16x8 r5 =  p5 & N;
 
         const UInt16x8 r6 =
-               ((p0 >> 6) & L)
-            | (((p1 >> 6) & L) << 2)
-            | (((p1 >> 6) & L) << 2)
-            | (((p2 >> 6) & L) << 4);
-            
+              (p0.shr<6>() & L)
+            | (p1.shr<6>() & L).shl<2>()
+            | (p2.shr<6>() & L).shl<4>();
+
         const UInt16x8 r7 =
-               ((p3 >> 6) & L)
-            | (((p4 >> 6) & L) << 2)
-            | (((p5 >> 6) & L) << 4);
+              (p3.shr<6>() & L)
+            | (p4.shr<6>() & L).shl<2>()
+            | (p5.shr<6>() & L).shl<4>();
         
-        Store(output,      r0);
-        Store(output + 8,  r1);
-        Store(output + 16, r2);
-        Store(output + 24, r3);
-        Store(output + 32, r4);
-        Store(output + 40, r5);
-        Store(output + 48, r6);
-        Store(output + 56, r7);
+        Store(output, r0 + REF);
+        Store(output + 8, r1 + REF);
+        Store(output + 16, r2 + REF);
+        Store(output + 24, r3 + REF);
+        Store(output + 32, r4 + REF);
+        Store(output + 40, r5 + REF);
+        Store(output + 48, r6 + REF);
+        Store(output + 56, r7 + REF);
 
         return input + ENCODING_BLOCK_LENGTH[6];
     }
     
     INLINE
-    const uint8_t* Decode8_One(uint16_t *RESTRICT output, const uint8_t* input) {
-        Store(output, Load(input));
+    const uint8_t* Decode8_One(uint16_t *RESTRICT output, const uint8_t* input, const UInt16x8& REF) {
+        Store(output, Load(input) + REF);
         
         return input + 8;
     }
 
     INLINE
-    const uint8_t* Decode8(uint16_t *RESTRICT output, const uint8_t* input) {
-        input = Decode8_One(output, input);
-        input = Decode8_One(output + 8, input);
-        input = Decode8_One(output + 16, input);
-        input = Decode8_One(output + 24, input);
+    const uint8_t* Decode8(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
 
-        input = Decode8_One(output + 32, input);
-        input = Decode8_One(output + 40, input);
-        input = Decode8_One(output + 48, input);
-        input = Decode8_One(output + 56, input);
+        input = Decode8_One(output, input, REF);
+        input = Decode8_One(output + 8, input, REF);
+        input = Decode8_One(output + 16, input, REF);
+        input = Decode8_One(output + 24, input, REF);
+
+        input = Decode8_One(output + 32, input, REF);
+        input = Decode8_One(output + 40, input, REF);
+        input = Decode8_One(output + 48, input, REF);
+        input = Decode8_One(output + 56, input, REF);
 
         return input;
     }
 
+    // Half of a 10-bit block: 32 low bytes then 8 bytes of packed 2-bit
+    // high fields, one byte per lane covering its four rows. Each row is
+    // rebuilt by interleaving its low bytes with its extracted high field
+    // as bytes - the little-endian lane layout makes the zip itself the
+    // (low | high << 8) recombination - so the half takes three full-width
+    // loads and four byte shuffles in place of five widening loads and a
+    // mask/shift/or chain per row.
     INLINE
-    const uint8_t* Decode10(uint16_t *RESTRICT output, const uint8_t* input) {
-        const UInt16x8 N(0xFF);
-        const UInt16x8 L(0x03);
+    const uint8_t* Decode10_Half(uint16_t *RESTRICT output, const uint8_t* input, const simde_uint16x8_t ref) {
+        const simde_uint8x8_t L = simde_vdup_n_u8(0x03);
 
-        const UInt16x8 p0 = Load(input);
-        const UInt16x8 p1 = Load(input+8);
-        const UInt16x8 p2 = Load(input+16);
-        const UInt16x8 p3 = Load(input+24);
-        const UInt16x8 p4 = Load(input+32);
-        const UInt16x8 p5 = Load(input+40);
-        const UInt16x8 p6 = Load(input+48);
-        const UInt16x8 p7 = Load(input+56);
-        const UInt16x8 p8 = Load(input+64);
-        const UInt16x8 p9 = Load(input+72);
-
-        const UInt16x8 _r0 = p0 & N;
-        const UInt16x8 _r1 = p1 & N;
-        const UInt16x8 _r2 = p2 & N;
-        const UInt16x8 _r3 = p3 & N;
-
-        const UInt16x8 r0 = _r0 | ((p4 & L)          << 8);
-        const UInt16x8 r1 = _r1 | ((p4 & (L << 2))   << 6);
-        const UInt16x8 r2 = _r2 | ((p4 & (L << 4))   << 4);
-        const UInt16x8 r3 = _r3 | ((p4 & (L << 6))   << 2);
-        
-        const UInt16x8 _r4 =  p5 & N;
-        const UInt16x8 _r5 =  p6 & N;
-        const UInt16x8 _r6 =  p7 & N;
-        const UInt16x8 _r7 =  p8 & N;
-
-        const UInt16x8 r4 = _r4 | ((p9 & L)          << 8);
-        const UInt16x8 r5 = _r5 | ((p9 & (L << 2))   << 6);
-        const UInt16x8 r6 = _r6 | ((p9 & (L << 4))   << 4);
-        const UInt16x8 r7 = _r7 | ((p9 & (L << 6))   << 2);
-
-        Store(output,      r0);
-        Store(output + 8,  r1);
-        Store(output + 16, r2);
-        Store(output + 24, r3);
-        Store(output + 32, r4);
-        Store(output + 40, r5);
-        Store(output + 48, r6);
-        Store(output + 56, r7);
-
-        return input + ENCODING_BLOCK_LENGTH[10];
+        simde_uint8x16_t lo01, lo23;
+        std::memcpy(&lo01, input, sizeof(lo01));
+        std::memcpy(&lo23, input + 16, sizeof(lo23));
+
+        const simde_uint8x8_t hb = simde_vld1_u8(input + 32);
+
+        const simde_uint8x8_t h0 = simde_vand_u8(hb, L);
+        const simde_uint8x8_t h1 = simde_vand_u8(simde_vshr_n_u8(hb, 2), L);
+        const simde_uint8x8_t h2 = simde_vand_u8(simde_vshr_n_u8(hb, 4), L);
+        const simde_uint8x8_t h3 = simde_vshr_n_u8(hb, 6);
+
+        const simde_uint8x8x2_t z0 = simde_vzip_u8(simde_vget_low_u8(lo01), h0);
+        const simde_uint8x8x2_t z1 = simde_vzip_u8(simde_vget_high_u8(lo01), h1);
+        const simde_uint8x8x2_t z2 = simde_vzip_u8(simde_vget_low_u8(lo23), h2);
+        const simde_uint8x8x2_t z3 = simde_vzip_u8(simde_vget_high_u8(lo23), h3);
+
+        const simde_uint16x8_t r0 = simde_vreinterpretq_u16_u8(simde_vcombine_u8(z0.val[0], z0.val[1]));
+        const simde_uint16x8_t r1 = simde_vreinterpretq_u16_u8(simde_vcombine_u8(z1.val[0], z1.val[1]));
+        const simde_uint16x8_t r2 = simde_vreinterpretq_u16_u8(simde_vcombine_u8(z2.val[0], z2.val[1]));
+        const simde_uint16x8_t r3 = simde_vreinterpretq_u16_u8(simde_vcombine_u8(z3.val[0], z3.val[1]));
+
+        simde_vst1q_u16(output,      simde_vaddq_u16(r0, ref));
+        simde_vst1q_u16(output + 8,  simde_vaddq_u16(r1, ref));
+        simde_vst1q_u16(output + 16, simde_vaddq_u16(r2, ref));
+        simde_vst1q_u16(output + 24, simde_vaddq_u16(r3, ref));
+
+        return input + ENCODING_BLOCK_LENGTH[10] / 2;
+    }
+
+    INLINE
+    const uint8_t* Decode10(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const simde_uint16x8_t REF = simde_vdupq_n_u16(reference);
+
+        input = Decode10_Half(output, input, REF);
+        input = Decode10_Half(output + 32, input, REF);
+
+        return input;
     }
     
     INLINE
-    const uint8_t* Decode16_ONE(uint16_t *RESTRICT output, const uint8_t* input) {
-        auto input16 = reinterpret_cast<const uint16_t*>(input);
-        
-        const UInt16x8 p(
-            input16[0],
-            input16[1],
-            input16[2],
-            input16[3],
-            input16[4],
-            input16[5],
-            input16[6],
-            input16[7]);
-        
-        Store(output, p);
+    const uint8_t* Decode16_ONE(uint16_t *RESTRICT output, const uint8_t* input, const UInt16x8& REF) {
+        Store(output, LoadU16(input) + REF);
         
         return input + 16;
     }
 
     INLINE
-    const uint8_t* Decode16(uint16_t *RESTRICT output, const uint8_t* input) {
-        input = Decode16_ONE(output,    input);
-        input = Decode16_ONE(output+8,  input);
-        input = Decode16_ONE(output+16, input);
-        input = Decode16_ONE(output+24, input);
+    const uint8_t* Decode16(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
+
+        input = Decode16_ONE(output,    input, REF);
+        input = Decode16_ONE(output+8,  input, REF);
+        input = Decode16_ONE(output+16, input, REF);
+        input = Decode16_ONE(output+24, input, REF);
+
+        input = Decode16_ONE(output+32, input, REF);
+        input = Decode16_ONE(output+40, input, REF);
+        input = Decode16_ONE(output+48, input, REF);
+        input = Decode16_ONE(output+56, input, REF);
+
+        return input;
+    }
+
+    INLINE
+    const uint8_t* Decode16Sat_ONE(uint16_t *RESTRICT output, const uint8_t* input, const UInt16x8& REF) {
+        simde_vst1q_u16(output, simde_vqaddq_u16(LoadU16(input).d, REF.d));
+
+        return input + 16;
+    }
+
+    // Saturating twin of Decode16, for corrupt blocks whose values would
+    // wrap past 16 bits when the reference is applied. Only this class
+    // needs one: references are 12 bits and every narrower kernel masks
+    // its values, so no other sum can overflow. The saturating add costs
+    // the same as the wrapping add.
+    INLINE
+    const uint8_t* Decode16Sat(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const UInt16x8 REF(reference);
+
+        input = Decode16Sat_ONE(output,    input, REF);
+        input = Decode16Sat_ONE(output+8,  input, REF);
+        input = Decode16Sat_ONE(output+16, input, REF);
+        input = Decode16Sat_ONE(output+24, input, REF);
 
-        input = Decode16_ONE(output+32, input);
-        input = Decode16_ONE(output+40, input);
-        input = Decode16_ONE(output+48, input);
-        input = Decode16_ONE(output+56, input);
+        input = Decode16Sat_ONE(output+32, input, REF);
+        input = Decode16Sat_ONE(output+40, input, REF);
+        input = Decode16Sat_ONE(output+48, input, REF);
+        input = Decode16Sat_ONE(output+56, input, REF);
 
         return input;
     }
-    
+
+#if MOTIONCAM_RAW_DISPATCH
+    // One-time probe for the runtime-dispatched build
+#if defined(_MSC_VER)
+    bool ProbeAvx2() {
+        int info[4];
+
+        __cpuid(info, 0);
+        if(info[0] < 7)
+            return false;
+
+        // The OS must save the YMM state, not just the CPU advertise it
+        __cpuid(info, 1);
+        if((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+
+    const bool HAS_AVX2 = ProbeAvx2();
+#else
+    const bool HAS_AVX2 = __builtin_cpu_supports("avx2");
+#endif
+#endif // MOTIONCAM_RAW_DISPATCH
+
+    // Kernel for one fixed bits class, the dispatch resolved at compile
+    // time. B must be a canonical class value (0..6, 8, 10 or 16); bits
+    // values sharing a kernel (7/8, 9/10, 11..16) share the class.
+    // saturate selects the saturating reference add; only the 16-bit
+    // class has a saturating variant because no other class can wrap,
+    // so elsewhere the flag is dead and compiles away.
+    template<int B>
+    INLINE void DecodeBlockKernel(
+        uint16_t *RESTRICT output,
+        const uint16_t reference,
+        const uint8_t* input,
+        const bool saturate = false)
+    {
+        (void)saturate;
+
+        if constexpr (B == 0) {
+            std::fill_n(output, ENCODING_BLOCK, reference);
+        }
+        else if constexpr (B == 1) {
+            Decode1(output, input, reference);
+        }
+        else if constexpr (B == 2) {
+#if MOTIONCAM_RAW_AVX2
+            avx2::Decode2(output, input, reference);
+#elif MOTIONCAM_RAW_DISPATCH
+            if(HAS_AVX2)
+                avx2::Decode2(output, input, reference);
+            else
+                Decode2(output, input, reference);
+#else
+            Decode2(output, input, reference);
+#endif
+        }
+        else if constexpr (B == 3) {
+            Decode3(output, input, reference);
+        }
+        else if constexpr (B == 4) {
+#if MOTIONCAM_RAW_AVX2
+            avx2::Decode4(output, input, reference);
+#elif MOTIONCAM_RAW_DISPATCH
+            if(HAS_AVX2)
+                avx2::Decode4(output, input, reference);
+            else
+                Decode4(output, input, reference);
+#else
+            Decode4(output, input, reference);
+#endif
+        }
+        else if constexpr (B == 5) {
+            Decode5(output, input, reference);
+        }
+        else if constexpr (B == 6) {
+            Decode6(output, input, reference);
+        }
+        else if constexpr (B == 8) {
+#if MOTIONCAM_RAW_AVX2
+            avx2::Decode8(output, input, reference);
+#elif MOTIONCAM_RAW_DISPATCH
+            if(HAS_AVX2)
+                avx2::Decode8(output, input, reference);
+            else
+                Decode8(output, input, reference);
+#else
+            Decode8(output, input, reference);
+#endif
+        }
+        else if constexpr (B == 10) {
+            Decode10(output, input, reference);
+        }
+        else {
+            // A 16-bit block with no reference is its input bytes verbatim;
+            // high-ISO frames are dominated by them, so the copy path is
+            // checked first
+            if(reference == 0) {
+                std::memcpy(output, input, ENCODING_BLOCK_LENGTH[16]);
+                return;
+            }
+
+#if MOTIONCAM_RAW_AVX2
+            if(saturate)
+                avx2::Decode16Sat(output, input, reference);
+            else
+                avx2::Decode16(output, input, reference);
+#elif MOTIONCAM_RAW_DISPATCH
+            if(HAS_AVX2) {
+                if(saturate)
+                    avx2::Decode16Sat(output, input, reference);
+                else
+                    avx2::Decode16(output, input, reference);
+            }
+            else {
+                if(saturate)
+                    Decode16Sat(output, input, reference);
+                else
+                    Decode16(output, input, reference);
+            }
+#else
+            if(saturate)
+                Decode16Sat(output, input, reference);
+            else
+                Decode16(output, input, reference);
+#endif
+        }
+    }
+
+    // Out-of-line entry point for one kernel, so its address can go in the
+    // dispatch table below
+    template<int B>
+    void BlockKernelEntry(uint16_t *RESTRICT output, const uint16_t reference, const uint8_t* input, const bool saturate) {
+        DecodeBlockKernel<B>(output, reference, input, saturate);
+    }
+
+    // Per-block dispatch table, indexed by the raw bits value; members of
+    // a class share its kernel. A switch here compiles to a branch tree
+    // re-evaluated every 64 pixels, which mispredicts its way down on
+    // noisy footage where neighbouring blocks land in different classes;
+    // the single indirect call predicts on its target instead. Runs of
+    // same-bits blocks are still batched above this level.
+    constexpr void (*BLOCK_KERNEL_TABLE[17])(uint16_t *RESTRICT, const uint16_t, const uint8_t*, const bool) = {
+        BlockKernelEntry<0>,  BlockKernelEntry<1>,  BlockKernelEntry<2>,  BlockKernelEntry<3>,
+        BlockKernelEntry<4>,  BlockKernelEntry<5>,  BlockKernelEntry<6>,  BlockKernelEntry<8>,
+        BlockKernelEntry<8>,  BlockKernelEntry<10>, BlockKernelEntry<10>, BlockKernelEntry<16>,
+        BlockKernelEntry<16>, BlockKernelEntry<16>, BlockKernelEntry<16>, BlockKernelEntry<16>,
+        BlockKernelEntry<16>
+    };
+
+    // BoundsChecked=false is only safe after VerifyPayload has proven that
+    // every block read stays inside the input
+    template<bool BoundsChecked>
     INLINE
     size_t DecodeBlock(
         uint16_t *RESTRICT output,
         const uint16_t bits,
+        const uint16_t reference,
         const uint8_t* input,
         const size_t offset,
-        const size_t len)
+        const size_t len,
+        const bool saturate = false)
+    {
+        if(BoundsChecked) {
+            // Don't decode if past end of input
+            if(offset + ENCODING_BLOCK_LENGTH[bits] > len)
+                return len - offset;
+        }
+
+        BLOCK_KERNEL_TABLE[bits <= 16 ? bits : 16](output, reference, input + offset, saturate);
+
+        return ENCODING_BLOCK_LENGTH[bits];
+    }
+
+    // Per-block dispatch of the specialized frame loop. The frame's
+    // dominant bits value, chosen once from the bits histogram, gets its
+    // kernel inlined behind a single well-predicted branch; outlier blocks
+    // take the generic switch. CommonBits of -1 compiles back down to the
+    // generic dispatch. Only instantiated with BoundsChecked=false inputs
+    // in mind for the common path - the specialization is picked for
+    // verified streams only.
+    template<bool BoundsChecked, int CommonBits>
+    INLINE size_t DecodeBlockMaybeCommon(
+        uint16_t *RESTRICT output,
+        const uint16_t bits,
+        const uint16_t dominantBits,
+        const uint16_t reference,
+        const uint8_t* input,
+        const size_t offset,
+        const size_t len,
+        const bool saturate = false)
+    {
+        if constexpr (CommonBits >= 0) {
+            // dominantBits shares CommonBits' kernel and encoded length,
+            // so the exact value needs no canonicalizing here
+            if(bits == dominantBits) {
+                DecodeBlockKernel<CommonBits>(output, reference, input + offset, saturate);
+
+                return ENCODING_BLOCK_LENGTH[CommonBits];
+            }
+        }
+
+        (void)dominantBits;
+
+        return DecodeBlock<BoundsChecked>(output, bits, reference, input, offset, len, saturate);
+    }
+
+    // Decode numBlocks consecutive blocks that share one bits value into
+    // contiguous staging. The kernel is inlined into the loop, so its
+    // shift and mask constants stay in registers across blocks and the
+    // compiler can pipeline iterations instead of re-dispatching each one.
+    template<int B>
+    INLINE void DecodeBlockKernelRun(
+        uint16_t *RESTRICT output,
+        const uint16_t* references,
+        const uint8_t* input,
+        const int numBlocks,
+        const bool saturate = false)
+    {
+        if constexpr (B == 16) {
+            // A run of 16-bit blocks whose references are all zero is the
+            // input verbatim: the whole run collapses into one wide copy,
+            // so the worst-case (uncompressed) stretches of a frame decode
+            // at memory bandwidth
+            uint16_t anyRef = 0;
+
+            for(int i = 0; i < numBlocks; i++)
+                anyRef |= references[i];
+
+            if(anyRef == 0) {
+                std::memcpy(output, input, static_cast<size_t>(numBlocks) * ENCODING_BLOCK_LENGTH[16]);
+                return;
+            }
+        }
+
+        // B is the canonical class, but every member of a class has the
+        // same encoded length, so the stride is right for all of them
+        for(int i = 0; i < numBlocks; i++) {
+            DecodeBlockKernel<B>(
+                output + static_cast<size_t>(i) * ENCODING_BLOCK,
+                references[i],
+                input + static_cast<size_t>(i) * ENCODING_BLOCK_LENGTH[B],
+                saturate);
+        }
+    }
+
+    // Run-length counterpart of the per-block dispatch. Smooth regions
+    // produce long stretches of identical bits values, so when a whole
+    // group shares one value its blocks are decoded in a single batched
+    // call, amortizing the dispatch over the run.
+    template<bool BoundsChecked, int CommonBits>
+    INLINE size_t DecodeBlockRun(
+        uint16_t *RESTRICT output,
+        const uint16_t bits,
+        const uint16_t dominantBits,
+        const uint16_t* references,
+        const int numBlocks,
+        const uint8_t* input,
+        const size_t offset,
+        const size_t len,
+        const bool saturate = false)
     {
-        // Don't decode if past end of input
-        if(offset + ENCODING_BLOCK_LENGTH[bits] > len)
-            return len - offset;
-     
+        if(BoundsChecked) {
+            // Near a truncated input, fall back to per-block dispatch so
+            // the run degrades exactly like the unbatched loop
+            if(bits > 16 || offset + static_cast<size_t>(numBlocks) * ENCODING_BLOCK_LENGTH[bits] > len) {
+                size_t consumed = 0;
+
+                for(int i = 0; i < numBlocks; i++)
+                    consumed += DecodeBlock<true>(output + static_cast<size_t>(i) * ENCODING_BLOCK, bits, references[i], input, offset + consumed, len, saturate);
+
+                return consumed;
+            }
+        }
+
         input += offset;
 
+        if constexpr (CommonBits >= 0) {
+            if(bits == dominantBits) {
+                DecodeBlockKernelRun<CommonBits>(output, references, input, numBlocks, saturate);
+
+                return static_cast<size_t>(numBlocks) * ENCODING_BLOCK_LENGTH[CommonBits];
+            }
+        }
+
+        (void)dominantBits;
+
         switch (bits) {
             case 0:
-                std::memset(output, 0, sizeof(uint16_t)*ENCODING_BLOCK);
+                DecodeBlockKernelRun<0>(output, references, input, numBlocks);
                 break;
             case 1:
-                Decode1(output, input);
+                DecodeBlockKernelRun<1>(output, references, input, numBlocks);
                 break;
             case 2:
-                Decode2(output, input);
+                DecodeBlockKernelRun<2>(output, references, input, numBlocks);
                 break;
             case 3:
-                Decode3(output, input);
+                DecodeBlockKernelRun<3>(output, references, input, numBlocks);
                 break;
             case 4:
-                Decode4(output, input);
+                DecodeBlockKernelRun<4>(output, references, input, numBlocks);
                 break;
             case 5:
-                Decode5(output, input);
+                DecodeBlockKernelRun<5>(output, references, input, numBlocks);
                 break;
             case 6:
-                Decode6(output, input);
+                DecodeBlockKernelRun<6>(output, references, input, numBlocks);
                 break;
             case 7:
             case 8:
-                Decode8(output, input);
+                DecodeBlockKernelRun<8>(output, references, input, numBlocks);
                 break;
             case 9:
             case 10:
-                Decode10(output, input);
+                DecodeBlockKernelRun<10>(output, references, input, numBlocks);
                 break;
             default:
             case 16:
-                Decode16(output, input);
+                DecodeBlockKernelRun<16>(output, references, input, numBlocks, saturate);
                 break;
         }
 
-        return ENCODING_BLOCK_LENGTH[bits];
+        return static_cast<size_t>(numBlocks) * ENCODING_BLOCK_LENGTH[bits];
     }
-    
+
     INLINE
     size_t DecodeMetadata(
         const uint8_t* input,
@@ -482,10 +863,7 @@ namespace motioncam {
             DecodeHeader(bits, reference, input+offset);
             
             offset += HEADER_LENGTH;
-            offset += DecodeBlock(data, bits, input, offset, len);
-            
-            for(int x = 0; x < ENCODING_BLOCK; x++)
-                data[x] += reference;
+            offset += DecodeBlock<true>(data, bits, reference, input, offset, len);
             
             data += ENCODING_BLOCK;
         }
@@ -493,6 +871,201 @@ namespace motioncam {
         return offset;
     }
     
+    // One pass over the bits metadata proving that decoding numBlocks blocks
+    // never reads past the end of the input, so the frame loop can run with
+    // its per-block bounds checks compiled out
+    bool VerifyPayload(const std::vector<uint16_t>& bits, const size_t numBlocks, const size_t len) {
+        if(bits.size() < numBlocks)
+            return false;
+
+        size_t total = METADATA_OFFSET;
+
+        for(size_t i = 0; i < numBlocks; i++) {
+            const uint16_t b = bits[i];
+
+            total += ENCODING_BLOCK_LENGTH[b <= 16 ? b : 16];
+        }
+
+        return total <= len;
+    }
+
+    // Sum of the encoded lengths of count consecutive blocks, eight lanes
+    // at a time. ENCODING_BLOCK_LENGTH[b]/8 is b for b<=6, b rounded up to
+    // even for 7..10 and 16 past that, so the table folds to arithmetic on
+    // the clamped bits value.
+    INLINE
+    size_t SumBlockLengths(const uint16_t* RESTRICT bits, const int count) {
+        int i = 0;
+        size_t total = 0;
+
+        if(count >= 8) {
+            const simde_uint16x8_t SIXTEEN = simde_vdupq_n_u16(16);
+            const simde_uint16x8_t SEVEN = simde_vdupq_n_u16(7);
+            const simde_uint16x8_t TEN = simde_vdupq_n_u16(10);
+            const simde_uint16x8_t ELEVEN = simde_vdupq_n_u16(11);
+            const simde_uint16x8_t ONE = simde_vdupq_n_u16(1);
+
+            simde_uint32x4_t acc = simde_vdupq_n_u32(0);
+
+            for(; i + 8 <= count; i += 8) {
+                const simde_uint16x8_t b = simde_vminq_u16(simde_vld1q_u16(bits + i), SIXTEEN);
+
+                const simde_uint16x8_t inMid = simde_vandq_u16(simde_vcgeq_u16(b, SEVEN), simde_vcleq_u16(b, TEN));
+                const simde_uint16x8_t odd = simde_vandq_u16(b, ONE);
+
+                simde_uint16x8_t t = simde_vaddq_u16(b, simde_vandq_u16(inMid, odd));
+                t = simde_vbslq_u16(simde_vcgeq_u16(b, ELEVEN), SIXTEEN, t);
+
+                acc = simde_vpadalq_u16(acc, t);
+            }
+
+            total = static_cast<size_t>(simde_vaddvq_u32(acc)) * 8;
+        }
+
+        for(; i < count; i++) {
+            const uint16_t b = bits[i];
+
+            total += ENCODING_BLOCK_LENGTH[b <= 16 ? b : 16];
+        }
+
+        return total;
+    }
+
+    // Interleave two decoded half-blocks and write the final pixels; the
+    // block references were already folded in by the decode kernels. dst
+    // receives 2*ENCODING_BLOCK/2 interleaved values.
+    INLINE
+    void InterleaveRow(
+        uint16_t *RESTRICT dst,
+        const uint16_t* a,
+        const uint16_t* b)
+    {
+#if MOTIONCAM_RAW_AVX2
+        avx2::InterleaveRow(dst, a, b);
+#else
+#if MOTIONCAM_RAW_DISPATCH
+        if(HAS_AVX2) {
+            avx2::InterleaveRow(dst, a, b);
+            return;
+        }
+#endif
+        for(int i = 0; i < ENCODING_BLOCK/2; i += 8) {
+            const simde_uint16x8x2_t z = simde_vzipq_u16(simde_vld1q_u16(a + i), simde_vld1q_u16(b + i));
+
+            simde_vst1q_u16(dst + 2*i, z.val[0]);
+            simde_vst1q_u16(dst + 2*i + 8, z.val[1]);
+        }
+#endif
+    }
+
+#if MOTIONCAM_RAW_AVX2 || MOTIONCAM_RAW_DISPATCH
+    // Non-temporal InterleaveRow, for decode output the CPU never reads
+    // back: the stores bypass the cache on their way to write-combined
+    // or pinned memory instead of evicting useful data. dst must be
+    // 32-byte aligned; finish a streamed frame with StreamFence().
+    INLINE
+    void InterleaveRowNT(
+        uint16_t *RESTRICT dst,
+        const uint16_t* a,
+        const uint16_t* b)
+    {
+#if MOTIONCAM_RAW_AVX2
+        avx2::InterleaveRowNT(dst, a, b);
+#else
+        if(HAS_AVX2) {
+            avx2::InterleaveRowNT(dst, a, b);
+            return;
+        }
+
+#if defined(__x86_64__) || defined(_M_X64)
+        for(int i = 0; i < ENCODING_BLOCK/2; i += 8) {
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 2*i),     _mm_unpacklo_epi16(va, vb));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 2*i + 8), _mm_unpackhi_epi16(va, vb));
+        }
+#else
+        InterleaveRow(dst, a, b);
+#endif
+#endif
+    }
+
+    // Whether every row destination meets the streaming alignment: 2-byte
+    // pixels need a 32-byte aligned output and a width that keeps each
+    // row group's start aligned
+    INLINE bool CanStreamRows(const uint16_t* output, const int width) {
+        return (reinterpret_cast<uintptr_t>(output) % 32 == 0) && (width % 16 == 0);
+    }
+
+    // Order the streamed stores before anything that consumes the frame
+    INLINE void StreamFence() {
+        _mm_sfence();
+    }
+#else
+    // No non-temporal path off x86; the flag degrades to regular stores
+    INLINE void InterleaveRowNT(uint16_t *RESTRICT dst, const uint16_t* a, const uint16_t* b) {
+        InterleaveRow(dst, a, b);
+    }
+
+    INLINE bool CanStreamRows(const uint16_t*, const int) {
+        return false;
+    }
+
+    INLINE void StreamFence() {
+    }
+#endif
+
+    // Best-effort read prefetch. Safe for any address - prefetch
+    // instructions don't fault - so callers don't clamp to array ends.
+    INLINE void PrefetchRead(const void* p) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_prefetch(reinterpret_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(p, 0, 3);
+#else
+        (void)p;
+#endif
+    }
+
+    // Fold one row of a decoded half-block into a plane's statistics. src
+    // points at staged block data still in L1, so this adds no memory
+    // traffic beyond the decode itself; min/max/sum run eight lanes wide,
+    // only the histogram increments are scalar.
+    INLINE
+    void AccumulateRowStats(PlaneStatistics& plane, const uint16_t* RESTRICT src, const int count) {
+        int i = 0;
+
+        if(count >= 8) {
+            simde_uint16x8_t vmin = simde_vld1q_u16(src);
+            simde_uint16x8_t vmax = vmin;
+            simde_uint32x4_t vsum = simde_vpaddlq_u16(vmin);
+
+            for(i = 8; i + 8 <= count; i += 8) {
+                const simde_uint16x8_t v = simde_vld1q_u16(src + i);
+
+                vmin = simde_vminq_u16(vmin, v);
+                vmax = simde_vmaxq_u16(vmax, v);
+                vsum = simde_vpadalq_u16(vsum, v);
+            }
+
+            plane.minValue = std::min(plane.minValue, simde_vminvq_u16(vmin));
+            plane.maxValue = std::max(plane.maxValue, simde_vmaxvq_u16(vmax));
+            plane.sum += simde_vaddvq_u32(vsum);
+        }
+
+        for(; i < count; i++) {
+            plane.minValue = std::min(plane.minValue, src[i]);
+            plane.maxValue = std::max(plane.maxValue, src[i]);
+            plane.sum += src[i];
+        }
+
+        for(int j = 0; j < count; j++)
+            plane.histogram[src[j] < PlaneStatistics::NUM_BINS ? src[j] : PlaneStatistics::NUM_BINS - 1]++;
+
+        plane.count += count;
+    }
+
     void ReadMetadataHeader(const uint8_t* input, uint32_t& encodedWidth, uint32_t& encodedHeight, uint32_t& bitsOffset, uint32_t& refsOffset) {
         encodedWidth =
                  static_cast<uint32_t>(input[0])
@@ -519,91 +1092,2201 @@ namespace motioncam {
             |   (static_cast<uint32_t>(input[15]) << 24);
     }
     
-    } // unnamed namespace
-
-    size_t Decode(
+    // The block decode and interleave loop of the full-frame Decode, shared
+    // by the checked and trusted variants; WithStats additionally folds the
+    // staged blocks into per-plane statistics before they leave cache.
+    // Decodes the row groups covering [yBegin, yEnd); output points at the
+    // yBegin row, offset and metadataIdx at its first block, so independent
+    // stripes of a frame can decode concurrently.
+    template<bool BoundsChecked, bool WithStats, int CommonBits = -1>
+    uint16_t* DecodeFrameLoop(
         uint16_t* output,
         const int width,
         const int height,
+        const uint32_t encodedWidth,
+        const int yBegin,
+        const int yEnd,
         const uint8_t* input,
-        const size_t len)
+        const size_t len,
+        size_t offset,
+        int metadataIdx,
+        const std::vector<uint16_t>& bits,
+        const std::vector<uint16_t>& refs,
+        FrameStatistics* stats,
+        const uint16_t dominantBits = 0,
+        const bool streamingStores = false,
+        const bool saturatingAdd = false,
+        const std::atomic<bool>* cancel = nullptr)
     {
-        uint16_t* outputStart = output;
-        
-        uint16_t p0[ENCODING_BLOCK];
-        uint16_t p1[ENCODING_BLOCK];
-        uint16_t p2[ENCODING_BLOCK];
-        uint16_t p3[ENCODING_BLOCK];
-
-        std::vector<uint16_t> bits, refs;
-        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+        // Contiguous so a same-bits group can be decoded as one batched run
+        uint16_t p[4][ENCODING_BLOCK];
 
-        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
-        
-        if(bitsOffset > len || refsOffset > len)
-            return 0;
-        
-        if(encodedWidth % ENCODING_BLOCK > 0)
-            return 0;
-            
-        if(encodedWidth < width)
-            return 0;
+        // Staging for the one block per row that may cross the right edge
+        uint16_t tail[ENCODING_BLOCK];
 
-        // Decode bits
-        DecodeMetadata(input, bitsOffset, len, bits);
-        
-        // Decode refs
-        DecodeMetadata(input, refsOffset, len, refs);
+        for(int y = yBegin; y < yEnd; y+=4) {
+            // One relaxed load per 4-row group; a raised flag abandons the
+            // frame so the worker is free within a row group's decode time
+            if(cancel && cancel->load(std::memory_order_relaxed))
+                return nullptr;
+
+            for(int x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
+                uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
+                uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
+
+                if constexpr (!WithStats) {
+                    // A group of four zero blocks consumes no input and
+                    // paints constant rows: even columns carry one block's
+                    // reference, odd the other's, so each output row is a
+                    // single splatted alternating pair stored across the
+                    // group - dark frames skip the staging writes and the
+                    // interleave reads entirely. Stats and streamed frames
+                    // keep the general path.
+                    if((blockBits[0] | blockBits[1] | blockBits[2] | blockBits[3]) == 0
+                        && !streamingStores && x + ENCODING_BLOCK <= width)
+                    {
+                        const simde_uint16x8_t fill[2] = {
+                            simde_vzipq_u16(simde_vdupq_n_u16(blockRef[0]), simde_vdupq_n_u16(blockRef[1])).val[0],
+                            simde_vzipq_u16(simde_vdupq_n_u16(blockRef[2]), simde_vdupq_n_u16(blockRef[3])).val[0]
+                        };
+
+                        for(int r = 0; r < 4; r++) {
+                            uint16_t* dst = output + static_cast<size_t>(r)*width + x;
+
+                            for(int i = 0; i < ENCODING_BLOCK; i += 8)
+                                simde_vst1q_u16(dst + i, fill[r & 1]);
+                        }
+
+                        metadataIdx += 4;
+                        continue;
+                    }
+                }
+
+                if(blockBits[0] == blockBits[1] && blockBits[0] == blockBits[2] && blockBits[0] == blockBits[3]) {
+                    offset += DecodeBlockRun<BoundsChecked, CommonBits>(&p[0][0], blockBits[0], dominantBits, blockRef, 4, input, offset, len, saturatingAdd);
+                }
+                else {
+                    offset += DecodeBlockMaybeCommon<BoundsChecked, CommonBits>(&p[0][0], blockBits[0], dominantBits, blockRef[0], input, offset, len, saturatingAdd);
+                    offset += DecodeBlockMaybeCommon<BoundsChecked, CommonBits>(&p[1][0], blockBits[1], dominantBits, blockRef[1], input, offset, len, saturatingAdd);
+                    offset += DecodeBlockMaybeCommon<BoundsChecked, CommonBits>(&p[2][0], blockBits[2], dominantBits, blockRef[2], input, offset, len, saturatingAdd);
+                    offset += DecodeBlockMaybeCommon<BoundsChecked, CommonBits>(&p[3][0], blockBits[3], dominantBits, blockRef[3], input, offset, len, saturatingAdd);
+                }
+
+                // Interleave the four decoded blocks straight into the output
+                // rows; the references were added inside the kernels
+                const uint16_t* blockSrc[4][2] = {
+                    { &p[0][0],                  &p[1][0] },
+                    { &p[2][0],                  &p[3][0] },
+                    { &p[0][ENCODING_BLOCK/2],   &p[1][ENCODING_BLOCK/2] },
+                    { &p[2][ENCODING_BLOCK/2],   &p[3][ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    uint16_t* dst = output + static_cast<size_t>(r)*width + x;
+
+                    if(x + ENCODING_BLOCK <= width) {
+                        if(streamingStores)
+                            InterleaveRowNT(dst, blockSrc[r][0], blockSrc[r][1]);
+                        else
+                            InterleaveRow(dst, blockSrc[r][0], blockSrc[r][1]);
+                    }
+                    else if(x < width) {
+                        // The partial edge block keeps regular stores - a
+                        // ragged copy has no whole vectors to stream
+                        InterleaveRow(&tail[0], blockSrc[r][0], blockSrc[r][1]);
+
+                        std::memcpy(dst, &tail[0], (width - x) * sizeof(uint16_t));
+                    }
+
+                    if(WithStats && y + r < height && x < width) {
+                        // Even output columns come from the first half-block,
+                        // odd from the second; row parity picks the planes
+                        const int valid = std::min(ENCODING_BLOCK, width - x);
+
+                        AccumulateRowStats(stats->planes[2*(r & 1)], blockSrc[r][0], (valid + 1) / 2);
+                        AccumulateRowStats(stats->planes[2*(r & 1) + 1], blockSrc[r][1], valid / 2);
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+
+            output += 4 * static_cast<size_t>(width);
+        }
+
+        return output;
+    }
+
+    // Most common value of the bits array. A capture's bit depth makes one
+    // narrow range dominate, so most frames are dominated by one value.
+    uint16_t DominantBits(const std::vector<uint16_t>& bits, const size_t numBlocks) {
+        uint32_t histogram[17] = {};
+
+        for(size_t i = 0; i < numBlocks; i++) {
+            const uint16_t b = bits[i];
+
+            histogram[b <= 16 ? b : 16]++;
+        }
+
+        uint16_t dominant = 0;
+
+        for(uint16_t b = 1; b <= 16; b++) {
+            if(histogram[b] > histogram[dominant])
+                dominant = b;
+        }
+
+        return dominant;
+    }
+
+    // Run the frame loop with the kernel of the dominant bits value
+    // specialized in, picked once per frame. Verified streams only.
+    uint16_t* DecodeFrameLoopDominant(
+        const uint16_t dominantBits,
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint32_t encodedWidth,
+        const int yBegin,
+        const int yEnd,
+        const uint8_t* input,
+        const size_t len,
+        const size_t offset,
+        const int metadataIdx,
+        const std::vector<uint16_t>& bits,
+        const std::vector<uint16_t>& refs,
+        const bool streamingStores = false,
+        const bool saturatingAdd = false,
+        const std::atomic<bool>* cancel = nullptr)
+    {
+        // Canonical class of the dominant value: 7 shares 8's kernel and
+        // length, 9 shares 10's, 11..15 share 16's
+        const int commonClass = dominantBits <= 6
+            ? dominantBits
+            : (dominantBits <= 8 ? 8 : (dominantBits <= 10 ? 10 : 16));
+
+        switch(commonClass) {
+            case 0:
+                return DecodeFrameLoop<false, false, 0>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            case 1:
+                return DecodeFrameLoop<false, false, 1>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            case 2:
+                return DecodeFrameLoop<false, false, 2>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            case 3:
+                return DecodeFrameLoop<false, false, 3>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            case 4:
+                return DecodeFrameLoop<false, false, 4>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            case 5:
+                return DecodeFrameLoop<false, false, 5>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            case 6:
+                return DecodeFrameLoop<false, false, 6>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            case 8:
+                return DecodeFrameLoop<false, false, 8>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            case 10:
+                return DecodeFrameLoop<false, false, 10>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+            default:
+                return DecodeFrameLoop<false, false, 16>(output, width, height, encodedWidth, yBegin, yEnd, input, len, offset, metadataIdx, bits, refs, nullptr, dominantBits, streamingStores, saturatingAdd, cancel);
+        }
+    }
+
+    // Planar variant of the frame loop. The kernels already stage each
+    // block as contiguous even and odd column halves, which are exactly the
+    // plane rows, so the halves are copied straight out with no interleave
+    // shuffle and no full-resolution intermediate.
+    template<bool BoundsChecked>
+    size_t DecodePlanarFrameLoop(
+        uint16_t* const planes[4],
+        const int width,
+        const int height,
+        const uint32_t encodedWidth,
+        const uint32_t encodedHeight,
+        const uint8_t* input,
+        const size_t len,
+        const std::vector<uint16_t>& bits,
+        const std::vector<uint16_t>& refs,
+        const bool saturatingAdd = false)
+    {
+        uint16_t p[4][ENCODING_BLOCK];
 
         size_t offset = METADATA_OFFSET;
-        
-        std::vector<uint16_t> row0(encodedWidth);
-        std::vector<uint16_t> row1(encodedWidth);
-        std::vector<uint16_t> row2(encodedWidth);
-        std::vector<uint16_t> row3(encodedWidth);
-        
+
+        const int evenWidth = PlaneDim(width, 0);
+        const int oddWidth = PlaneDim(width, 1);
+
+        size_t written = 0;
         int metadataIdx = 0;
 
         for(int y = 0; y < encodedHeight; y+=4) {
             for(int x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
                 uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
                 uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
-            
-                offset += DecodeBlock(&p0[0], blockBits[0], input, offset, len);
-                offset += DecodeBlock(&p1[0], blockBits[1], input, offset, len);
-                offset += DecodeBlock(&p2[0], blockBits[2], input, offset, len);
-                offset += DecodeBlock(&p3[0], blockBits[3], input, offset, len);
-
-                for(int i = 0; i < ENCODING_BLOCK; i+=2) {
-                    row0[x + i]     = p0[i/2] + blockRef[0];
-                    row0[x + i + 1] = p1[i/2] + blockRef[1];
-                    
-                    row1[x + i]     = p2[i/2] + blockRef[2];
-                    row1[x + i + 1] = p3[i/2] + blockRef[3];
-
-                    row2[x + i]     = p0[ENCODING_BLOCK/2+i/2] + blockRef[0];
-                    row2[x + i + 1] = p1[ENCODING_BLOCK/2+i/2] + blockRef[1];
-                    
-                    row3[x + i]     = p2[ENCODING_BLOCK/2+i/2] + blockRef[2];
-                    row3[x + i + 1] = p3[ENCODING_BLOCK/2+i/2] + blockRef[3];
+
+                if(blockBits[0] == blockBits[1] && blockBits[0] == blockBits[2] && blockBits[0] == blockBits[3]) {
+                    offset += DecodeBlockRun<BoundsChecked, -1>(&p[0][0], blockBits[0], 0, blockRef, 4, input, offset, len, saturatingAdd);
+                }
+                else {
+                    offset += DecodeBlock<BoundsChecked>(&p[0][0], blockBits[0], blockRef[0], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[1][0], blockBits[1], blockRef[1], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[2][0], blockBits[2], blockRef[2], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[3][0], blockBits[3], blockRef[3], input, offset, len, saturatingAdd);
+                }
+
+                const uint16_t* blockSrc[4][2] = {
+                    { &p[0][0],                  &p[1][0] },
+                    { &p[2][0],                  &p[3][0] },
+                    { &p[0][ENCODING_BLOCK/2],   &p[1][ENCODING_BLOCK/2] },
+                    { &p[2][ENCODING_BLOCK/2],   &p[3][ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    const int row = y + r;
+
+                    if(row >= height || x >= width)
+                        continue;
+
+                    const int valid = std::min(ENCODING_BLOCK, width - x);
+                    const int evenCount = (valid + 1) / 2;
+                    const int oddCount = valid / 2;
+                    const size_t planeRow = static_cast<size_t>(row) / 2;
+
+                    std::memcpy(planes[2*(r & 1)] + planeRow*evenWidth + x/2, blockSrc[r][0], evenCount * sizeof(uint16_t));
+                    std::memcpy(planes[2*(r & 1) + 1] + planeRow*oddWidth + x/2, blockSrc[r][1], oddCount * sizeof(uint16_t));
+
+                    written += valid;
                 }
-                
+
                 metadataIdx += 4;
             }
+        }
+
+        return written;
+    }
+
+    // Shared body of the public full-frame Decode variants; stats may be null
+    size_t DecodeImpl(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context,
+        FrameStatistics* stats)
+    {
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return 0;
+
+        if(encodedWidth % ENCODING_BLOCK > 0)
+            return 0;
 
-            std::memcpy(output, row0.data(), width * 2);
-            output += width;
+        if(encodedWidth < width)
+            return 0;
+
+        MOTIONCAM_TRACE_BEGIN(metadata);
+
+        // Decode bits
+        DecodeMetadata(input, bitsOffset, len, bits);
+
+        // Decode refs
+        DecodeMetadata(input, refsOffset, len, refs);
+
+        MOTIONCAM_TRACE_END(metadata, "decodeMetadata");
+
+        // Verify the stream once up front; when every block read is proven
+        // in bounds the frame loop runs without per-block checks
+        const size_t numBlocks = static_cast<size_t>(encodedWidth/ENCODING_BLOCK) * encodedHeight;
+        const bool verified = refs.size() >= numBlocks && VerifyPayload(bits, numBlocks, len);
+
+        const bool streaming = context.streamingStores && CanStreamRows(output, width);
 
-            std::memcpy(output, row1.data(), width * 2);
-            output += width;
+        MOTIONCAM_TRACE_BEGIN(blocks);
 
-            std::memcpy(output, row2.data(), width * 2);
-            output += width;
+        uint16_t* end;
 
-            std::memcpy(output, row3.data(), width * 2);
-            output += width;
+        if(stats) {
+            stats->reset();
+
+            end = verified
+                ? DecodeFrameLoop<false, true>(output, width, height, encodedWidth, 0, encodedHeight, input, len, METADATA_OFFSET, 0, bits, refs, stats, 0, streaming, context.saturatingAdd, context.cancel)
+                : DecodeFrameLoop<true, true>(output, width, height, encodedWidth, 0, encodedHeight, input, len, METADATA_OFFSET, 0, bits, refs, stats, 0, streaming, context.saturatingAdd, context.cancel);
         }
-        
-        return (output - outputStart);
+        else {
+            // The dominant bits value's kernel is specialized into the loop,
+            // so the bulk of the blocks skip the dispatch switch entirely
+            end = verified
+                ? DecodeFrameLoopDominant(DominantBits(bits, numBlocks), output, width, height, encodedWidth, 0, encodedHeight, input, len, METADATA_OFFSET, 0, bits, refs, streaming, context.saturatingAdd, context.cancel)
+                : DecodeFrameLoop<true, false>(output, width, height, encodedWidth, 0, encodedHeight, input, len, METADATA_OFFSET, 0, bits, refs, nullptr, 0, streaming, context.saturatingAdd, context.cancel);
+        }
+
+        if(streaming)
+            StreamFence();
+
+        MOTIONCAM_TRACE_END(blocks, "decodeBlocks");
+
+        // Abandoned mid-frame
+        if(!end)
+            return 0;
+
+        return (end - output);
+    }
+
+    // DecodeMetadata for streams that may be corrupt. The declared block
+    // count must match the frame geometry - a flipped count byte would
+    // otherwise size an arbitrary allocation - and a truncated section
+    // keeps its decoded prefix. Returns the number of trustworthy
+    // leading entries; outMetadata is padded to a whole decode chunk.
+    size_t DecodeMetadataGuarded(
+        const uint8_t* input,
+        size_t offset,
+        const size_t len,
+        const size_t expectedBlocks,
+        std::vector<uint16_t>& outMetadata)
+    {
+        outMetadata.clear();
+
+        if(offset + 4 > len)
+            return 0;
+
+        const uint32_t numBlocks =
+                 static_cast<uint32_t>(input[offset])
+            |   (static_cast<uint32_t>(input[offset+1]) << 8)
+            |   (static_cast<uint32_t>(input[offset+2]) << 16)
+            |   (static_cast<uint32_t>(input[offset+3]) << 24);
+
+        // The encoder declares the count padded to a whole chunk
+        const size_t paddedBlocks =
+            (expectedBlocks + ENCODING_BLOCK - 1) / ENCODING_BLOCK * ENCODING_BLOCK;
+
+        if(numBlocks < expectedBlocks || numBlocks > paddedBlocks)
+            return 0;
+
+        // The decode below writes whole chunks
+        outMetadata.resize(paddedBlocks);
+        offset += 4;
+
+        uint8_t bits;
+        uint16_t reference;
+
+        uint16_t* data = outMetadata.data();
+
+        for(size_t i = 0; i < numBlocks; i += ENCODING_BLOCK) {
+            if(offset + HEADER_LENGTH > len)
+                return i;
+
+            DecodeHeader(bits, reference, input + offset);
+
+            offset += HEADER_LENGTH;
+
+            if(offset + ENCODING_BLOCK_LENGTH[bits <= 16 ? bits : 16] > len)
+                return i;
+
+            offset += DecodeBlock<true>(data, bits, reference, input, offset, len);
+
+            data += ENCODING_BLOCK;
+        }
+
+        return numBlocks;
+    }
+
+    // The serial loop behind DecodeResilient: every block's read is
+    // validated against the input before it runs, and a block that fails
+    // - or sits past a point where the stream's alignment was lost - is
+    // painted with its reference value and flagged. There is no resync:
+    // block lengths come from the bits metadata, so once an offset is
+    // off the end every later block is unreachable too.
+    size_t DecodeResilientFrameLoop(
+        uint16_t* output,
+        const int width,
+        const uint32_t encodedWidth,
+        const uint32_t encodedHeight,
+        const uint8_t* input,
+        const size_t len,
+        const std::vector<uint16_t>& bits,
+        const std::vector<uint16_t>& refs,
+        const size_t bitsValid,
+        const size_t refsValid,
+        bool lost,
+        const bool saturatingAdd,
+        DamageMap& outDamage)
+    {
+        uint16_t p[4][ENCODING_BLOCK];
+        uint16_t tail[ENCODING_BLOCK];
+
+        size_t offset = METADATA_OFFSET;
+        size_t metadataIdx = 0;
+
+        uint16_t* out = output;
+
+        for(uint32_t y = 0; y < encodedHeight; y += 4) {
+            for(uint32_t x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
+                for(int b = 0; b < 4; b++) {
+                    const size_t i = metadataIdx + b;
+                    const uint16_t blockBits = bits[i] <= 16 ? bits[i] : 16;
+                    const uint16_t reference = refs[i];
+
+                    bool damaged = lost;
+                    bool advance = !lost;
+
+                    if(!lost) {
+                        if(i >= bitsValid) {
+                            // Without its bits entry a block's length is
+                            // unknown, so alignment is gone for good
+                            damaged = true;
+                            lost = true;
+                            advance = false;
+                        }
+                        else if(bits[i] > 16 || i >= refsValid) {
+                            // Unusable entry; step the canonical stride so
+                            // the blocks after it stay reachable
+                            damaged = true;
+                        }
+
+                        if(advance && offset + ENCODING_BLOCK_LENGTH[blockBits] > len) {
+                            damaged = true;
+                            lost = true;
+                            advance = false;
+                        }
+                    }
+
+                    if(damaged) {
+                        for(int j = 0; j < ENCODING_BLOCK; j++)
+                            p[b][j] = reference;
+
+                        outDamage.blocks[i >> 6] |= static_cast<uint64_t>(1) << (i & 63);
+                        outDamage.damaged++;
+
+                        if(advance)
+                            offset += ENCODING_BLOCK_LENGTH[blockBits];
+                    }
+                    else {
+                        offset += DecodeBlock<true>(&p[b][0], blockBits, reference, input, offset, len, saturatingAdd);
+                    }
+                }
+
+                // Interleave into the output rows exactly like the regular
+                // frame loop
+                const uint16_t* blockSrc[4][2] = {
+                    { &p[0][0],                  &p[1][0] },
+                    { &p[2][0],                  &p[3][0] },
+                    { &p[0][ENCODING_BLOCK/2],   &p[1][ENCODING_BLOCK/2] },
+                    { &p[2][ENCODING_BLOCK/2],   &p[3][ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    uint16_t* dst = out + static_cast<size_t>(r)*width + x;
+
+                    if(x + ENCODING_BLOCK <= static_cast<uint32_t>(width)) {
+                        InterleaveRow(dst, blockSrc[r][0], blockSrc[r][1]);
+                    }
+                    else if(x < static_cast<uint32_t>(width)) {
+                        InterleaveRow(&tail[0], blockSrc[r][0], blockSrc[r][1]);
+
+                        std::memcpy(dst, &tail[0], (width - x) * sizeof(uint16_t));
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+
+            out += 4 * static_cast<size_t>(width);
+        }
+
+        return static_cast<size_t>(out - output);
+    }
+
+    } // unnamed namespace
+
+    size_t Decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len)
+    {
+        DecodeContext context;
+
+        return Decode(output, width, height, input, len, context);
+    }
+
+    void FrameStatistics::reset() {
+        std::memset(this, 0, sizeof(FrameStatistics));
+
+        for(auto& plane : planes)
+            plane.minValue = 0xFFFF;
+    }
+
+    size_t Decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context)
+    {
+        return DecodeImpl(output, width, height, input, len, context, nullptr);
+    }
+
+    size_t Decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context,
+        FrameStatistics& outStatistics)
+    {
+        return DecodeImpl(output, width, height, input, len, context, &outStatistics);
+    }
+
+    size_t DecodeResilient(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context,
+        DamageMap& outDamage)
+    {
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+
+        uint32_t encodedWidth = 0, encodedHeight = 0, bitsOffset = 0, refsOffset = 0;
+
+        bool headerOk = len >= static_cast<size_t>(METADATA_OFFSET);
+
+        if(headerOk) {
+            ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+            // The encoder pads to the granularity exactly, so a sane
+            // header's geometry sits within one block/group of the
+            // caller's dimensions; anything else is corruption
+            headerOk = bitsOffset <= len && refsOffset <= len
+                && encodedWidth % ENCODING_BLOCK == 0
+                && encodedWidth >= static_cast<uint32_t>(width)
+                && encodedWidth < static_cast<uint32_t>(width) + ENCODING_BLOCK
+                && encodedHeight % 4 == 0
+                && encodedHeight >= static_cast<uint32_t>(height)
+                && encodedHeight < static_cast<uint32_t>(height) + 4;
+        }
+
+        if(!headerOk) {
+            // Reconstruct the geometry from the caller's dimensions and
+            // fill the whole frame: every block flagged, but the caller
+            // gets a frame instead of nothing
+            encodedWidth = static_cast<uint32_t>((width + ENCODING_BLOCK - 1) / ENCODING_BLOCK) * ENCODING_BLOCK;
+            encodedHeight = static_cast<uint32_t>((height + 3) / 4) * 4;
+        }
+
+        const size_t numBlocks = static_cast<size_t>(encodedWidth / ENCODING_BLOCK) * encodedHeight;
+
+        size_t bitsValid = 0, refsValid = 0;
+
+        if(headerOk) {
+            bitsValid = DecodeMetadataGuarded(input, bitsOffset, len, numBlocks, bits);
+            refsValid = DecodeMetadataGuarded(input, refsOffset, len, numBlocks, refs);
+        }
+
+        // Pad so the loop can index freely; entries past the valid counts
+        // are never trusted
+        if(bits.size() < numBlocks)
+            bits.resize(numBlocks, 0);
+
+        if(refs.size() < numBlocks)
+            refs.resize(numBlocks, 0);
+
+        outDamage.numBlocks = numBlocks;
+        outDamage.damaged = 0;
+        outDamage.blocks.assign((numBlocks + 63) / 64, 0);
+
+        return DecodeResilientFrameLoop(output, width, encodedWidth, encodedHeight, input, len,
+            bits, refs, bitsValid, refsValid, !headerOk, context.saturatingAdd, outDamage);
+    }
+
+    size_t DecodePlanar(
+        uint16_t* const planes[4],
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context)
+    {
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return 0;
+
+        if(encodedWidth % ENCODING_BLOCK > 0)
+            return 0;
+
+        if(encodedWidth < width)
+            return 0;
+
+        // Decode bits
+        DecodeMetadata(input, bitsOffset, len, bits);
+
+        // Decode refs
+        DecodeMetadata(input, refsOffset, len, refs);
+
+        // Verify the stream once up front; when every block read is proven
+        // in bounds the frame loop runs without per-block checks
+        const size_t numBlocks = static_cast<size_t>(encodedWidth/ENCODING_BLOCK) * encodedHeight;
+        const bool verified = refs.size() >= numBlocks && VerifyPayload(bits, numBlocks, len);
+
+        return verified
+            ? DecodePlanarFrameLoop<false>(planes, width, height, encodedWidth, encodedHeight, input, len, bits, refs, context.saturatingAdd)
+            : DecodePlanarFrameLoop<true>(planes, width, height, encodedWidth, encodedHeight, input, len, bits, refs, context.saturatingAdd);
+    }
+
+    size_t Decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context,
+        ThreadPool& pool)
+    {
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return 0;
+
+        if(encodedWidth % ENCODING_BLOCK > 0)
+            return 0;
+
+        if(encodedWidth < width)
+            return 0;
+
+        // Scheduling class of everything this decode puts on the pool
+        const bool background = context.qos == DecodeQoS::BACKGROUND;
+        const Priority priority = background ? Priority::EXPORT : Priority::INTERACTIVE;
+
+        // The two metadata arrays are independent, so the bits decode runs
+        // as a pool task overlapped with the refs decode on the caller -
+        // the dead time at the head of every frame before pixel work can
+        // start is halved
+        {
+            TaskGroup metadataGroup;
+
+            metadataGroup.run(pool, priority, [input, bitsOffset, len, &bits] {
+                DecodeMetadata(input, bitsOffset, len, bits);
+            });
+
+            DecodeMetadata(input, refsOffset, len, refs);
+
+            metadataGroup.wait();
+        }
+
+        const size_t numBlocks = static_cast<size_t>(encodedWidth/ENCODING_BLOCK) * encodedHeight;
+        const bool verified = refs.size() >= numBlocks && VerifyPayload(bits, numBlocks, len);
+
+        const int numGroups = (static_cast<int>(encodedHeight) + 3) / 4;
+        const size_t numStripes = std::min<size_t>(pool.numThreads(), numGroups);
+
+        // Stripe offsets computed from the bits metadata are only meaningful
+        // for a stream proven in bounds; an unverified stream keeps the
+        // serial loop with its per-block checks
+        const bool streaming = context.streamingStores && CanStreamRows(output, width);
+        const bool saturating = context.saturatingAdd;
+
+        if(!verified || numStripes <= 1) {
+            uint16_t* end = verified
+                ? DecodeFrameLoop<false, false>(output, width, height, encodedWidth, 0, encodedHeight, input, len, METADATA_OFFSET, 0, bits, refs, nullptr, 0, streaming, context.saturatingAdd, context.cancel)
+                : DecodeFrameLoop<true, false>(output, width, height, encodedWidth, 0, encodedHeight, input, len, METADATA_OFFSET, 0, bits, refs, nullptr, 0, streaming, context.saturatingAdd, context.cancel);
+
+            if(streaming)
+                StreamFence();
+
+            return end ? (end - output) : 0;
+        }
+
+        // Phase one: a prefix sum over the per-block lengths gives every row
+        // group's byte offset into the stream
+        const int blocksPerGroup = static_cast<int>(encodedWidth/ENCODING_BLOCK) * 4;
+
+        std::vector<size_t> groupOffsets(numGroups);
+        size_t offset = METADATA_OFFSET;
+
+        for(int g = 0; g < numGroups; g++) {
+            groupOffsets[g] = offset;
+
+            offset += SumBlockLengths(bits.data() + static_cast<size_t>(g) * blocksPerGroup, blocksPerGroup);
+        }
+
+        // Phase two: whole row groups, about one stripe per worker, decoded
+        // concurrently. Stripes touch disjoint input and output ranges, and
+        // run as decode-priority tasks in a group of their own so the pool
+        // can carry unrelated work at the same time.
+        const int groupsPerStripe = (numGroups + static_cast<int>(numStripes) - 1) / static_cast<int>(numStripes);
+
+        // One histogram scan picks the specialized loop for every stripe
+        const uint16_t dominantBits = DominantBits(bits, numBlocks);
+
+        TaskGroup group;
+
+        for(int gBegin = 0; gBegin < numGroups; gBegin += groupsPerStripe) {
+            const int gEnd = std::min(numGroups, gBegin + groupsPerStripe);
+            const size_t stripeOffset = groupOffsets[gBegin];
+
+            const std::atomic<bool>* cancel = context.cancel;
+
+            if(background) {
+                // Background stripes decode one 4-row group at a time with
+                // a preemption point between groups: interactive work queued
+                // meanwhile runs inline here before the next group starts,
+                // so a UI frame never waits for a whole export stripe
+                group.run(pool, priority, [dominantBits, streaming, saturating, output, width, height, encodedWidth, encodedHeight, gBegin, gEnd, input, len, blocksPerGroup, &bits, &refs, &groupOffsets, &pool, cancel] {
+                    for(int g = gBegin; g < gEnd; g++) {
+                        if(cancel && cancel->load(std::memory_order_relaxed))
+                            return;
+
+                        while(pool.interactivePending() && pool.assistInteractive())
+                            ;
+
+                        DecodeFrameLoopDominant(
+                            dominantBits,
+                            output + static_cast<size_t>(g) * 4 * width,
+                            width,
+                            height,
+                            encodedWidth,
+                            g * 4,
+                            std::min((g + 1) * 4, static_cast<int>(encodedHeight)),
+                            input,
+                            len,
+                            groupOffsets[g],
+                            g * blocksPerGroup,
+                            bits,
+                            refs,
+                            streaming,
+                            saturating,
+                            cancel);
+                    }
+
+                    if(streaming)
+                        StreamFence();
+                });
+
+                continue;
+            }
+
+            group.run(pool, priority, [dominantBits, streaming, saturating, output, width, height, encodedWidth, encodedHeight, gBegin, gEnd, input, len, stripeOffset, blocksPerGroup, &bits, &refs, cancel] {
+                // A stripe still queued when the flag is raised never starts
+                if(cancel && cancel->load(std::memory_order_relaxed))
+                    return;
+
+                DecodeFrameLoopDominant(
+                    dominantBits,
+                    output + static_cast<size_t>(gBegin) * 4 * width,
+                    width,
+                    height,
+                    encodedWidth,
+                    gBegin * 4,
+                    std::min(gEnd * 4, static_cast<int>(encodedHeight)),
+                    input,
+                    len,
+                    stripeOffset,
+                    gBegin * blocksPerGroup,
+                    bits,
+                    refs,
+                    streaming,
+                    saturating,
+                    cancel);
+
+                // Each worker fences its own streamed stores
+                if(streaming)
+                    StreamFence();
+            });
+        }
+
+        group.wait();
+
+        if(context.cancel && context.cancel->load(std::memory_order_relaxed))
+            return 0;
+
+        // Matches the serial loop, which advances whole row groups
+        return static_cast<size_t>(width) * (4 * numGroups);
+    }
+
+    bool ComputeFrameLayout(
+        const uint8_t* input,
+        const size_t len,
+        FrameLayout& outLayout)
+    {
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return false;
+
+        if(encodedWidth % ENCODING_BLOCK > 0 || encodedWidth == 0)
+            return false;
+
+        DecodeMetadata(input, bitsOffset, len, outLayout.bits);
+        DecodeMetadata(input, refsOffset, len, outLayout.refs);
+
+        outLayout.encodedWidth = encodedWidth;
+        outLayout.encodedHeight = encodedHeight;
+
+        const size_t numBlocks = static_cast<size_t>(encodedWidth/ENCODING_BLOCK) * encodedHeight;
+
+        outLayout.verified = outLayout.refs.size() >= numBlocks && VerifyPayload(outLayout.bits, numBlocks, len);
+
+        const int numGroups = (static_cast<int>(encodedHeight) + 3) / 4;
+        const int blocksPerGroup = static_cast<int>(encodedWidth/ENCODING_BLOCK) * 4;
+
+        // The frame loops read whole groups, so pad out to the group
+        // granularity; a well-formed stream is not affected
+        const size_t totalBlocks = static_cast<size_t>(numGroups) * blocksPerGroup;
+
+        if(outLayout.bits.size() < totalBlocks)
+            outLayout.bits.resize(totalBlocks, 0);
+
+        if(outLayout.refs.size() < totalBlocks)
+            outLayout.refs.resize(totalBlocks, 0);
+
+        outLayout.groupOffsets.resize(numGroups);
+
+        size_t offset = METADATA_OFFSET;
+
+        for(int g = 0; g < numGroups; g++) {
+            outLayout.groupOffsets[g] = offset;
+
+            offset += SumBlockLengths(outLayout.bits.data() + static_cast<size_t>(g) * blocksPerGroup, blocksPerGroup);
+        }
+
+        return true;
+    }
+
+    bool ComputeFrameSummary(
+        const uint8_t* input,
+        const size_t len,
+        FrameSummary& outSummary)
+    {
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return false;
+
+        if(encodedWidth % ENCODING_BLOCK > 0 || encodedWidth == 0)
+            return false;
+
+        // Only the metadata sections are parsed; thread-local scratch keeps
+        // a sweep over a whole clip allocation free
+        thread_local std::vector<uint16_t> bits;
+        thread_local std::vector<uint16_t> refs;
+
+        DecodeMetadata(input, bitsOffset, len, bits);
+        DecodeMetadata(input, refsOffset, len, refs);
+
+        const size_t numBlocks = static_cast<size_t>(encodedWidth/ENCODING_BLOCK) * encodedHeight;
+
+        if(bits.size() < numBlocks || refs.size() < numBlocks)
+            return false;
+
+        outSummary.encodedWidth = encodedWidth;
+        outSummary.encodedHeight = encodedHeight;
+        outSummary.mapWidth = static_cast<int>(encodedWidth / ENCODING_BLOCK);
+        outSummary.mapHeight = (static_cast<int>(encodedHeight) + 3) / 4;
+
+        const size_t numCells = static_cast<size_t>(outSummary.mapWidth) * outSummary.mapHeight;
+
+        // A ragged final group reads as zero-filled cells, matching the
+        // group padding of the frame loops
+        if(bits.size() < 4 * numCells)
+            bits.resize(4 * numCells, 0);
+
+        if(refs.size() < 4 * numCells)
+            refs.resize(4 * numCells, 0);
+
+        outSummary.minimumMap.resize(numCells);
+
+        uint64_t referenceSum = 0;
+        uint64_t bitsSum = 0;
+        uint16_t minReference = 0xFFFF;
+        uint16_t maxReference = 0;
+        uint16_t maxBits = 0;
+
+        // Stream order is 4-row groups left to right, top to bottom, four
+        // blocks - one per CFA position - per 64x4 tile
+        for(size_t cell = 0; cell < numCells; cell++) {
+            const size_t base = 4 * cell;
+            uint16_t cellMin = 0xFFFF;
+
+            for(size_t b = 0; b < 4; b++) {
+                const uint16_t reference = refs[base + b];
+
+                cellMin = std::min(cellMin, reference);
+                maxReference = std::max(maxReference, reference);
+                referenceSum += reference;
+
+                maxBits = std::max(maxBits, bits[base + b]);
+                bitsSum += bits[base + b];
+            }
+
+            outSummary.minimumMap[cell] = cellMin;
+            minReference = std::min(minReference, cellMin);
+        }
+
+        outSummary.meanReference = numCells > 0 ? static_cast<double>(referenceSum) / (4.0 * numCells) : 0.0;
+        outSummary.minReference = numCells > 0 ? minReference : 0;
+        outSummary.maxReference = maxReference;
+
+        // The bits value is the residual width per sample of its block, so
+        // the block average is already bits per sample
+        outSummary.meanBitsPerSample = numCells > 0 ? static_cast<double>(bitsSum) / (4.0 * numCells) : 0.0;
+        outSummary.maxBits = maxBits;
+
+        return true;
+    }
+
+    size_t Decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        const FrameLayout& layout)
+    {
+        if(layout.encodedWidth % ENCODING_BLOCK > 0 || layout.encodedWidth < static_cast<uint32_t>(width))
+            return 0;
+
+        const size_t numBlocks = static_cast<size_t>(layout.encodedWidth/ENCODING_BLOCK) * layout.encodedHeight;
+
+        uint16_t* end = layout.verified
+            ? DecodeFrameLoopDominant(DominantBits(layout.bits, numBlocks), output, width, height, layout.encodedWidth, 0, layout.encodedHeight, input, len, METADATA_OFFSET, 0, layout.bits, layout.refs)
+            : DecodeFrameLoop<true, false>(output, width, height, layout.encodedWidth, 0, layout.encodedHeight, input, len, METADATA_OFFSET, 0, layout.bits, layout.refs, nullptr);
+
+        return end ? (end - output) : 0;
+    }
+
+    size_t Decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        RegionOfInterest& roi,
+        const uint8_t* input,
+        const size_t len,
+        const FrameLayout& layout)
+    {
+        uint16_t p0[ENCODING_BLOCK];
+        uint16_t p1[ENCODING_BLOCK];
+        uint16_t p2[ENCODING_BLOCK];
+        uint16_t p3[ENCODING_BLOCK];
+
+        const std::vector<uint16_t>& bits = layout.bits;
+        const std::vector<uint16_t>& refs = layout.refs;
+        const uint32_t encodedWidth = layout.encodedWidth;
+        const uint32_t encodedHeight = layout.encodedHeight;
+
+        if(encodedWidth % ENCODING_BLOCK > 0 || encodedWidth == 0)
+            return 0;
+
+        if(encodedWidth < width)
+            return 0;
+
+        if(layout.groupOffsets.size() < static_cast<size_t>((encodedHeight + 3) / 4))
+            return 0;
+
+        // Expand the region to the block granularity (4 rows by 64 columns)
+        // and clamp it to the frame
+        const int x0 = std::max(0, std::min(roi.x, width)) & ~(ENCODING_BLOCK - 1);
+        const int y0 = std::max(0, std::min(roi.y, static_cast<int>(encodedHeight))) & ~3;
+        const int x1 = std::min(width, ((std::max(x0, roi.x + roi.width) + ENCODING_BLOCK - 1) / ENCODING_BLOCK) * ENCODING_BLOCK);
+        const int y1 = std::min(static_cast<int>(encodedHeight), ((std::max(y0, roi.y + roi.height) + 3) / 4) * 4);
+
+        roi.x = x0;
+        roi.y = y0;
+        roi.width = x1 - x0;
+        roi.height = y1 - y0;
+
+        if(roi.width <= 0 || roi.height <= 0)
+            return 0;
+
+        const int blocksPerGroup = static_cast<int>(encodedWidth/ENCODING_BLOCK) * 4;
+        const int leadBlocks = (x0/ENCODING_BLOCK) * 4;
+
+        uint16_t tail[ENCODING_BLOCK];
+
+        for(int y = y0; y < y1; y += 4) {
+            // Enter the stream at this group's cached offset; only the
+            // blocks left of the region still have their lengths summed
+            const size_t group = static_cast<size_t>(y) / 4;
+
+            size_t offset = layout.groupOffsets[group] + SumBlockLengths(bits.data() + group*blocksPerGroup, leadBlocks);
+            int metadataIdx = static_cast<int>(group)*blocksPerGroup + leadBlocks;
+
+            // The hop to the next group's stripe is a far, data-dependent
+            // stride the hardware prefetcher can't follow; the cached
+            // offsets make it exact, so the next stripe's first lines are
+            // pulled in while this one decodes. The lead distance into the
+            // current group is a close estimate of the next one's.
+            if(y + 4 < y1) {
+                const uint8_t* next = input + layout.groupOffsets[group + 1] + (offset - layout.groupOffsets[group]);
+
+                PrefetchRead(next);
+                PrefetchRead(next + 64);
+            }
+
+            for(int x = x0; x < x1; x += ENCODING_BLOCK) {
+                uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
+                uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
+
+                offset += DecodeBlock<true>(&p0[0], blockBits[0], blockRef[0], input, offset, len);
+                offset += DecodeBlock<true>(&p1[0], blockBits[1], blockRef[1], input, offset, len);
+                offset += DecodeBlock<true>(&p2[0], blockBits[2], blockRef[2], input, offset, len);
+                offset += DecodeBlock<true>(&p3[0], blockBits[3], blockRef[3], input, offset, len);
+
+                const uint16_t* blockSrc[4][2] = {
+                    { &p0[0],                  &p1[0] },
+                    { &p2[0],                  &p3[0] },
+                    { &p0[ENCODING_BLOCK/2],   &p1[ENCODING_BLOCK/2] },
+                    { &p2[ENCODING_BLOCK/2],   &p3[ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    uint16_t* dst = output + static_cast<size_t>(y - y0 + r)*roi.width + (x - x0);
+
+                    if(x + ENCODING_BLOCK <= x1) {
+                        InterleaveRow(dst, blockSrc[r][0], blockSrc[r][1]);
+                    }
+                    else {
+                        InterleaveRow(&tail[0], blockSrc[r][0], blockSrc[r][1]);
+
+                        std::memcpy(dst, &tail[0], (x1 - x) * sizeof(uint16_t));
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+        }
+
+        return static_cast<size_t>(roi.width) * roi.height;
+    }
+
+    size_t DecodePreview(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const int rowGroupStep,
+        const uint8_t* input,
+        const size_t len,
+        const FrameLayout& layout)
+    {
+        uint16_t p0[ENCODING_BLOCK];
+        uint16_t p1[ENCODING_BLOCK];
+        uint16_t p2[ENCODING_BLOCK];
+        uint16_t p3[ENCODING_BLOCK];
+
+        const std::vector<uint16_t>& bits = layout.bits;
+        const std::vector<uint16_t>& refs = layout.refs;
+        const uint32_t encodedWidth = layout.encodedWidth;
+        const uint32_t encodedHeight = layout.encodedHeight;
+
+        if(encodedWidth % ENCODING_BLOCK > 0 || encodedWidth == 0)
+            return 0;
+
+        if(encodedWidth < width)
+            return 0;
+
+        const int numGroups = (static_cast<int>(encodedHeight) + 3) / 4;
+
+        if(layout.groupOffsets.size() < static_cast<size_t>(numGroups))
+            return 0;
+
+        const int blocksPerGroup = static_cast<int>(encodedWidth/ENCODING_BLOCK) * 4;
+        const int step = std::max(1, rowGroupStep);
+
+        uint16_t tail[ENCODING_BLOCK];
+        uint16_t* outputStart = output;
+
+        // Kept groups enter the stream at their cached offsets; skipped
+        // groups cost nothing
+        for(int g = 0; g < numGroups; g += step) {
+            size_t offset = layout.groupOffsets[g];
+            int metadataIdx = g * blocksPerGroup;
+
+            // The jump over the skipped groups is a far, data-dependent
+            // stride the hardware prefetcher can't follow; the next kept
+            // group's cached offset is exact, so its first lines stream in
+            // while this group decodes
+            if(g + step < numGroups) {
+                PrefetchRead(input + layout.groupOffsets[g + step]);
+                PrefetchRead(input + layout.groupOffsets[g + step] + 64);
+            }
+
+            for(int x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
+                uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
+                uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
+
+                offset += DecodeBlock<true>(&p0[0], blockBits[0], blockRef[0], input, offset, len);
+                offset += DecodeBlock<true>(&p1[0], blockBits[1], blockRef[1], input, offset, len);
+                offset += DecodeBlock<true>(&p2[0], blockBits[2], blockRef[2], input, offset, len);
+                offset += DecodeBlock<true>(&p3[0], blockBits[3], blockRef[3], input, offset, len);
+
+                const uint16_t* blockSrc[4][2] = {
+                    { &p0[0],                  &p1[0] },
+                    { &p2[0],                  &p3[0] },
+                    { &p0[ENCODING_BLOCK/2],   &p1[ENCODING_BLOCK/2] },
+                    { &p2[ENCODING_BLOCK/2],   &p3[ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    uint16_t* dst = output + static_cast<size_t>(r)*width + x;
+
+                    if(x + ENCODING_BLOCK <= width) {
+                        InterleaveRow(dst, blockSrc[r][0], blockSrc[r][1]);
+                    }
+                    else if(x < width) {
+                        InterleaveRow(&tail[0], blockSrc[r][0], blockSrc[r][1]);
+
+                        std::memcpy(dst, &tail[0], (width - x) * sizeof(uint16_t));
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+
+            output += 4 * static_cast<size_t>(width);
+        }
+
+        return (output - outputStart);
+    }
+
+    size_t Decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        RegionOfInterest& roi,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context)
+    {
+        uint16_t p0[ENCODING_BLOCK];
+        uint16_t p1[ENCODING_BLOCK];
+        uint16_t p2[ENCODING_BLOCK];
+        uint16_t p3[ENCODING_BLOCK];
+
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return 0;
+
+        if(encodedWidth % ENCODING_BLOCK > 0)
+            return 0;
+
+        if(encodedWidth < width)
+            return 0;
+
+        // Expand the region to the block granularity (4 rows by 64 columns)
+        // and clamp it to the frame
+        const int x0 = std::max(0, std::min(roi.x, width)) & ~(ENCODING_BLOCK - 1);
+        const int y0 = std::max(0, std::min(roi.y, static_cast<int>(encodedHeight))) & ~3;
+        const int x1 = std::min(width, ((std::max(x0, roi.x + roi.width) + ENCODING_BLOCK - 1) / ENCODING_BLOCK) * ENCODING_BLOCK);
+        const int y1 = std::min(static_cast<int>(encodedHeight), ((std::max(y0, roi.y + roi.height) + 3) / 4) * 4);
+
+        roi.x = x0;
+        roi.y = y0;
+        roi.width = x1 - x0;
+        roi.height = y1 - y0;
+
+        if(roi.width <= 0 || roi.height <= 0)
+            return 0;
+
+        DecodeMetadata(input, bitsOffset, len, bits);
+        DecodeMetadata(input, refsOffset, len, refs);
+
+        size_t offset = METADATA_OFFSET;
+        uint16_t tail[ENCODING_BLOCK];
+
+        int metadataIdx = 0;
+
+        for(int y = 0; y < y1; y+=4) {
+            for(int x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
+                if(y < y0 || x < x0 || x >= x1) {
+                    // Outside the region, hop over the four blocks using the
+                    // per-block lengths instead of decoding them
+                    for(int b = 0; b < 4; b++) {
+                        const uint16_t blockBits = bits[metadataIdx + b];
+
+                        offset += ENCODING_BLOCK_LENGTH[blockBits <= 16 ? blockBits : 16];
+                    }
+
+                    metadataIdx += 4;
+                    continue;
+                }
+
+                uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
+                uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
+
+                offset += DecodeBlock<true>(&p0[0], blockBits[0], blockRef[0], input, offset, len, context.saturatingAdd);
+                offset += DecodeBlock<true>(&p1[0], blockBits[1], blockRef[1], input, offset, len, context.saturatingAdd);
+                offset += DecodeBlock<true>(&p2[0], blockBits[2], blockRef[2], input, offset, len, context.saturatingAdd);
+                offset += DecodeBlock<true>(&p3[0], blockBits[3], blockRef[3], input, offset, len, context.saturatingAdd);
+
+                const uint16_t* blockSrc[4][2] = {
+                    { &p0[0],                  &p1[0] },
+                    { &p2[0],                  &p3[0] },
+                    { &p0[ENCODING_BLOCK/2],   &p1[ENCODING_BLOCK/2] },
+                    { &p2[ENCODING_BLOCK/2],   &p3[ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    uint16_t* dst = output + static_cast<size_t>(y - y0 + r)*roi.width + (x - x0);
+
+                    if(x + ENCODING_BLOCK <= x1) {
+                        InterleaveRow(dst, blockSrc[r][0], blockSrc[r][1]);
+                    }
+                    else {
+                        InterleaveRow(&tail[0], blockSrc[r][0], blockSrc[r][1]);
+
+                        std::memcpy(dst, &tail[0], (x1 - x) * sizeof(uint16_t));
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+        }
+
+        return static_cast<size_t>(roi.width) * roi.height;
+    }
+
+    size_t DecodePreview(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const int rowGroupStep,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context)
+    {
+        if(rowGroupStep <= 1)
+            return Decode(output, width, height, input, len, context);
+
+        uint16_t* outputStart = output;
+
+        uint16_t p0[ENCODING_BLOCK];
+        uint16_t p1[ENCODING_BLOCK];
+        uint16_t p2[ENCODING_BLOCK];
+        uint16_t p3[ENCODING_BLOCK];
+
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return 0;
+
+        if(encodedWidth % ENCODING_BLOCK > 0)
+            return 0;
+
+        if(encodedWidth < width)
+            return 0;
+
+        DecodeMetadata(input, bitsOffset, len, bits);
+        DecodeMetadata(input, refsOffset, len, refs);
+
+        size_t offset = METADATA_OFFSET;
+        uint16_t tail[ENCODING_BLOCK];
+
+        int metadataIdx = 0;
+
+        for(int y = 0; y < encodedHeight; y+=4) {
+            if((y/4) % rowGroupStep != 0) {
+                // Skipped group, hop over its blocks using the per-block lengths
+                for(int x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
+                    for(int b = 0; b < 4; b++) {
+                        const uint16_t blockBits = bits[metadataIdx + b];
+
+                        offset += ENCODING_BLOCK_LENGTH[blockBits <= 16 ? blockBits : 16];
+                    }
+
+                    metadataIdx += 4;
+                }
+
+                continue;
+            }
+
+            for(int x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
+                uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
+                uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
+
+                offset += DecodeBlock<true>(&p0[0], blockBits[0], blockRef[0], input, offset, len, context.saturatingAdd);
+                offset += DecodeBlock<true>(&p1[0], blockBits[1], blockRef[1], input, offset, len, context.saturatingAdd);
+                offset += DecodeBlock<true>(&p2[0], blockBits[2], blockRef[2], input, offset, len, context.saturatingAdd);
+                offset += DecodeBlock<true>(&p3[0], blockBits[3], blockRef[3], input, offset, len, context.saturatingAdd);
+
+                const uint16_t* blockSrc[4][2] = {
+                    { &p0[0],                  &p1[0] },
+                    { &p2[0],                  &p3[0] },
+                    { &p0[ENCODING_BLOCK/2],   &p1[ENCODING_BLOCK/2] },
+                    { &p2[ENCODING_BLOCK/2],   &p3[ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    uint16_t* dst = output + static_cast<size_t>(r)*width + x;
+
+                    if(x + ENCODING_BLOCK <= width) {
+                        InterleaveRow(dst, blockSrc[r][0], blockSrc[r][1]);
+                    }
+                    else if(x < width) {
+                        InterleaveRow(&tail[0], blockSrc[r][0], blockSrc[r][1]);
+
+                        std::memcpy(dst, &tail[0], (width - x) * sizeof(uint16_t));
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+
+            output += 4 * static_cast<size_t>(width);
+        }
+
+        return (output - outputStart);
+    }
+
+    // --- Destination layouts ---
+
+    namespace {
+
+    // Address of pixel (x, row) under a destination layout; x stays inside
+    // one tile because tileWidth is a whole number of 64-pixel blocks
+    INLINE uint16_t* LayoutAddress(
+        uint16_t* output,
+        const OutputLayout& layout,
+        const int x,
+        const int row,
+        const int width)
+    {
+        if(layout.tileWidth > 0) {
+            const int tilesPerRow = (width + layout.tileWidth - 1) / layout.tileWidth;
+            const int tx = x / layout.tileWidth;
+            const int ty = row / layout.tileHeight;
+
+            return output
+                + (static_cast<size_t>(ty)*tilesPerRow + tx) * layout.tileWidth * layout.tileHeight
+                + static_cast<size_t>(row % layout.tileHeight) * layout.tileWidth
+                + (x % layout.tileWidth);
+        }
+
+        const size_t pitch = layout.rowPitchPixels > 0 ? layout.rowPitchPixels : static_cast<size_t>(width);
+
+        return output + static_cast<size_t>(row)*pitch + x;
+    }
+
+    // Frame loop writing a destination layout from the store stage; the
+    // structure mirrors DecodeFrameLoop with the row address generalized
+    template<bool BoundsChecked>
+    size_t DecodeLayoutFrameLoop(
+        uint16_t* output,
+        const int width,
+        const uint32_t encodedWidth,
+        const uint32_t encodedHeight,
+        const uint8_t* input,
+        const size_t len,
+        const std::vector<uint16_t>& bits,
+        const std::vector<uint16_t>& refs,
+        const OutputLayout& layout,
+        const bool saturatingAdd,
+        const std::atomic<bool>* cancel)
+    {
+        uint16_t p[4][ENCODING_BLOCK];
+        uint16_t tail[ENCODING_BLOCK];
+
+        size_t offset = METADATA_OFFSET;
+        int metadataIdx = 0;
+
+        for(int y = 0; y < static_cast<int>(encodedHeight); y += 4) {
+            if(cancel && cancel->load(std::memory_order_relaxed))
+                return 0;
+
+            for(int x = 0; x < static_cast<int>(encodedWidth); x += ENCODING_BLOCK) {
+                uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
+                uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
+
+                if(blockBits[0] == blockBits[1] && blockBits[0] == blockBits[2] && blockBits[0] == blockBits[3]) {
+                    offset += DecodeBlockRun<BoundsChecked, -1>(&p[0][0], blockBits[0], 0, blockRef, 4, input, offset, len, saturatingAdd);
+                }
+                else {
+                    offset += DecodeBlock<BoundsChecked>(&p[0][0], blockBits[0], blockRef[0], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[1][0], blockBits[1], blockRef[1], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[2][0], blockBits[2], blockRef[2], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[3][0], blockBits[3], blockRef[3], input, offset, len, saturatingAdd);
+                }
+
+                const uint16_t* blockSrc[4][2] = {
+                    { &p[0][0],                  &p[1][0] },
+                    { &p[2][0],                  &p[3][0] },
+                    { &p[0][ENCODING_BLOCK/2],   &p[1][ENCODING_BLOCK/2] },
+                    { &p[2][ENCODING_BLOCK/2],   &p[3][ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    uint16_t* dst = LayoutAddress(output, layout, x, y + r, width);
+
+                    if(x + ENCODING_BLOCK <= width) {
+                        InterleaveRow(dst, blockSrc[r][0], blockSrc[r][1]);
+                    }
+                    else if(x < width) {
+                        InterleaveRow(&tail[0], blockSrc[r][0], blockSrc[r][1]);
+
+                        std::memcpy(dst, &tail[0], (width - x) * sizeof(uint16_t));
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+        }
+
+        return static_cast<size_t>(width) * encodedHeight;
+    }
+
+    } // unnamed namespace
+
+    size_t Decode(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context,
+        const OutputLayout& outputLayout)
+    {
+        if(outputLayout.tileWidth > 0 || outputLayout.tileHeight > 0) {
+            // The 64-pixel stores and 4-row groups must not straddle tiles
+            if(outputLayout.tileWidth <= 0 || outputLayout.tileWidth % ENCODING_BLOCK != 0)
+                return 0;
+
+            if(outputLayout.tileHeight <= 0 || outputLayout.tileHeight % 4 != 0)
+                return 0;
+        }
+        else if(outputLayout.rowPitchPixels > 0 && outputLayout.rowPitchPixels < static_cast<size_t>(width)) {
+            return 0;
+        }
+
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return 0;
+
+        if(encodedWidth % ENCODING_BLOCK > 0)
+            return 0;
+
+        if(encodedWidth < static_cast<uint32_t>(width))
+            return 0;
+
+        DecodeMetadata(input, bitsOffset, len, bits);
+        DecodeMetadata(input, refsOffset, len, refs);
+
+        const size_t numBlocks = static_cast<size_t>(encodedWidth/ENCODING_BLOCK) * encodedHeight;
+        const bool verified = refs.size() >= numBlocks && VerifyPayload(bits, numBlocks, len);
+
+        (void)height;
+
+        return verified
+            ? DecodeLayoutFrameLoop<false>(output, width, encodedWidth, encodedHeight, input, len, bits, refs, outputLayout, context.saturatingAdd, context.cancel)
+            : DecodeLayoutFrameLoop<true>(output, width, encodedWidth, encodedHeight, input, len, bits, refs, outputLayout, context.saturatingAdd, context.cancel);
+    }
+
+    // --- Normalized float output ---
+
+    namespace {
+
+    // Normalization fused into the store stage: out = pixel*scale + offset
+    // with offset = -blackLevel*scale, one fused multiply-add per four
+    // pixels while they are still in the decode registers
+    struct FloatNorm {
+        simde_float32x4_t scale;
+        simde_float32x4_t offset;
+    };
+
+    // Output traits of the two converted formats; store() widens eight
+    // decoded pixels, applies the normalization and writes them in the
+    // target precision
+    template<bool Half>
+    struct NormOut;
+
+    template<>
+    struct NormOut<false> {
+        typedef float type;
+
+        static INLINE void store(float* dst, const simde_uint16x8_t v, const FloatNorm& norm) {
+            const simde_float32x4_t lo = simde_vcvtq_f32_u32(simde_vmovl_u16(simde_vget_low_u16(v)));
+            const simde_float32x4_t hi = simde_vcvtq_f32_u32(simde_vmovl_u16(simde_vget_high_u16(v)));
+
+            simde_vst1q_f32(dst,     simde_vmlaq_f32(norm.offset, lo, norm.scale));
+            simde_vst1q_f32(dst + 4, simde_vmlaq_f32(norm.offset, hi, norm.scale));
+        }
+    };
+
+    template<>
+    struct NormOut<true> {
+        // IEEE binary16 bit patterns
+        typedef uint16_t type;
+
+        static INLINE void store(uint16_t* dst, const simde_uint16x8_t v, const FloatNorm& norm) {
+            const simde_float32x4_t lo = simde_vcvtq_f32_u32(simde_vmovl_u16(simde_vget_low_u16(v)));
+            const simde_float32x4_t hi = simde_vcvtq_f32_u32(simde_vmovl_u16(simde_vget_high_u16(v)));
+
+            const simde_float16x8_t h = simde_vcombine_f16(
+                simde_vcvt_f16_f32(simde_vmlaq_f32(norm.offset, lo, norm.scale)),
+                simde_vcvt_f16_f32(simde_vmlaq_f32(norm.offset, hi, norm.scale)));
+
+            simde_vst1q_f16(reinterpret_cast<simde_float16_t*>(dst), h);
+        }
+    };
+
+    // InterleaveRow with the conversion replacing the plain store: the
+    // zipped vectors go straight through the normalization instead of
+    // being written as uint16 and re-read by a second pass
+    template<bool Half>
+    INLINE void InterleaveRowNorm(
+        typename NormOut<Half>::type *RESTRICT dst,
+        const uint16_t* a,
+        const uint16_t* b,
+        const FloatNorm& norm)
+    {
+        for(int i = 0; i < ENCODING_BLOCK/2; i += 8) {
+            const simde_uint16x8x2_t z = simde_vzipq_u16(simde_vld1q_u16(a + i), simde_vld1q_u16(b + i));
+
+            NormOut<Half>::store(dst + 2*i, z.val[0], norm);
+            NormOut<Half>::store(dst + 2*i + 8, z.val[1], norm);
+        }
+    }
+
+    // Frame loop for converted output, mirroring DecodeFrameLoop without
+    // the stats and streaming-store variants
+    template<bool BoundsChecked, bool Half>
+    typename NormOut<Half>::type* DecodeNormFrameLoop(
+        typename NormOut<Half>::type* output,
+        const int width,
+        const uint32_t encodedWidth,
+        const int yBegin,
+        const int yEnd,
+        const uint8_t* input,
+        const size_t len,
+        size_t offset,
+        int metadataIdx,
+        const std::vector<uint16_t>& bits,
+        const std::vector<uint16_t>& refs,
+        const FloatNorm& norm,
+        const bool saturatingAdd,
+        const std::atomic<bool>* cancel)
+    {
+        uint16_t p[4][ENCODING_BLOCK];
+
+        // Staging for the one block per row that may cross the right edge
+        typename NormOut<Half>::type tail[ENCODING_BLOCK];
+
+        for(int y = yBegin; y < yEnd; y+=4) {
+            if(cancel && cancel->load(std::memory_order_relaxed))
+                return nullptr;
+
+            for(int x = 0; x < static_cast<int>(encodedWidth); x += ENCODING_BLOCK) {
+                uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
+                uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
+
+                if(blockBits[0] == blockBits[1] && blockBits[0] == blockBits[2] && blockBits[0] == blockBits[3]) {
+                    offset += DecodeBlockRun<BoundsChecked, -1>(&p[0][0], blockBits[0], 0, blockRef, 4, input, offset, len, saturatingAdd);
+                }
+                else {
+                    offset += DecodeBlock<BoundsChecked>(&p[0][0], blockBits[0], blockRef[0], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[1][0], blockBits[1], blockRef[1], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[2][0], blockBits[2], blockRef[2], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[3][0], blockBits[3], blockRef[3], input, offset, len, saturatingAdd);
+                }
+
+                const uint16_t* blockSrc[4][2] = {
+                    { &p[0][0],                  &p[1][0] },
+                    { &p[2][0],                  &p[3][0] },
+                    { &p[0][ENCODING_BLOCK/2],   &p[1][ENCODING_BLOCK/2] },
+                    { &p[2][ENCODING_BLOCK/2],   &p[3][ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    typename NormOut<Half>::type* dst = output + static_cast<size_t>(r)*width + x;
+
+                    if(x + ENCODING_BLOCK <= width) {
+                        InterleaveRowNorm<Half>(dst, blockSrc[r][0], blockSrc[r][1], norm);
+                    }
+                    else if(x < width) {
+                        InterleaveRowNorm<Half>(&tail[0], blockSrc[r][0], blockSrc[r][1], norm);
+
+                        std::memcpy(dst, &tail[0], (width - x) * sizeof(typename NormOut<Half>::type));
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+
+            output += 4 * static_cast<size_t>(width);
+        }
+
+        return output;
+    }
+
+    // Shared body of DecodeFloat and DecodeHalfFloat; the preamble matches
+    // DecodeImpl so malformed streams fail the same way
+    template<bool Half>
+    size_t DecodeNormImpl(
+        typename NormOut<Half>::type* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context,
+        const float blackLevel,
+        const float whiteLevel)
+    {
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return 0;
+
+        if(encodedWidth % ENCODING_BLOCK > 0)
+            return 0;
+
+        if(encodedWidth < static_cast<uint32_t>(width))
+            return 0;
+
+        DecodeMetadata(input, bitsOffset, len, bits);
+        DecodeMetadata(input, refsOffset, len, refs);
+
+        const size_t numBlocks = static_cast<size_t>(encodedWidth/ENCODING_BLOCK) * encodedHeight;
+        const bool verified = refs.size() >= numBlocks && VerifyPayload(bits, numBlocks, len);
+
+        const float scale = whiteLevel > blackLevel ? 1.0f / (whiteLevel - blackLevel) : 1.0f;
+
+        const FloatNorm norm{
+            simde_vdupq_n_f32(scale),
+            simde_vdupq_n_f32(-blackLevel * scale)
+        };
+
+        (void)height;
+
+        typename NormOut<Half>::type* end = verified
+            ? DecodeNormFrameLoop<false, Half>(output, width, encodedWidth, 0, encodedHeight, input, len, METADATA_OFFSET, 0, bits, refs, norm, context.saturatingAdd, context.cancel)
+            : DecodeNormFrameLoop<true, Half>(output, width, encodedWidth, 0, encodedHeight, input, len, METADATA_OFFSET, 0, bits, refs, norm, context.saturatingAdd, context.cancel);
+
+        if(!end)
+            return 0;
+
+        return (end - output);
+    }
+
+    } // unnamed namespace
+
+    size_t DecodeFloat(
+        float* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context,
+        const float blackLevel,
+        const float whiteLevel)
+    {
+        return DecodeNormImpl<false>(output, width, height, input, len, context, blackLevel, whiteLevel);
+    }
+
+    size_t DecodeHalfFloat(
+        uint16_t* output,
+        const int width,
+        const int height,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context,
+        const float blackLevel,
+        const float whiteLevel)
+    {
+        return DecodeNormImpl<true>(output, width, height, input, len, context, blackLevel, whiteLevel);
+    }
+
+    // --- Packed native-depth output ---
+
+    namespace {
+
+    // Pack one interleaved row segment of ENCODING_BLOCK pixels into
+    // ENCODING_BLOCK*bits/8 bytes, MSB first. Any even bit count keeps a
+    // 64-pixel segment on byte boundaries, so segments pack independently
+    // and a segment at column x lands at byte x*bits/8 of its row.
+    INLINE void PackSegment(uint8_t *RESTRICT dst, const uint16_t* src, const int bits, const uint16_t maxVal) {
+        uint32_t acc = 0;
+        int accBits = 0;
+
+        for(int i = 0; i < ENCODING_BLOCK; i++) {
+            acc = (acc << bits) | std::min<uint16_t>(src[i], maxVal);
+            accBits += bits;
+
+            while(accBits >= 8) {
+                *dst++ = static_cast<uint8_t>(acc >> (accBits - 8));
+                accBits -= 8;
+            }
+        }
+    }
+
+    // Frame loop for packed output, mirroring DecodeNormFrameLoop: each
+    // block interleaves into a stack stage that the packer drains while it
+    // is still in L1, so widened 16-bit pixels never reach the output
+    // buffer
+    template<bool BoundsChecked>
+    uint8_t* DecodePackedFrameLoop(
+        uint8_t* output,
+        const int width,
+        const size_t rowBytes,
+        const int bitsPerPixel,
+        const uint32_t encodedWidth,
+        const uint32_t encodedHeight,
+        const uint8_t* input,
+        const size_t len,
+        size_t offset,
+        const std::vector<uint16_t>& bits,
+        const std::vector<uint16_t>& refs,
+        const bool saturatingAdd,
+        const std::atomic<bool>* cancel)
+    {
+        const uint16_t maxVal = static_cast<uint16_t>((1u << bitsPerPixel) - 1);
+
+        // Pad bits that byte-align the end of each row
+        const int padBits = static_cast<int>(rowBytes * 8 - static_cast<size_t>(width) * bitsPerPixel);
+
+        uint16_t p[4][ENCODING_BLOCK];
+        uint16_t stage[ENCODING_BLOCK];
+
+        // Staging for the one segment per row that may cross the right edge
+        uint8_t tail[2 * ENCODING_BLOCK];
+
+        int metadataIdx = 0;
+
+        for(uint32_t y = 0; y < encodedHeight; y += 4) {
+            if(cancel && cancel->load(std::memory_order_relaxed))
+                return nullptr;
+
+            for(uint32_t x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
+                uint16_t blockBits[4] = { bits[metadataIdx], bits[metadataIdx+1], bits[metadataIdx+2], bits[metadataIdx+3] };
+                uint16_t blockRef[4] = { refs[metadataIdx], refs[metadataIdx+1], refs[metadataIdx+2], refs[metadataIdx+3] };
+
+                if(blockBits[0] == blockBits[1] && blockBits[0] == blockBits[2] && blockBits[0] == blockBits[3]) {
+                    offset += DecodeBlockRun<BoundsChecked, -1>(&p[0][0], blockBits[0], 0, blockRef, 4, input, offset, len, saturatingAdd);
+                }
+                else {
+                    offset += DecodeBlock<BoundsChecked>(&p[0][0], blockBits[0], blockRef[0], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[1][0], blockBits[1], blockRef[1], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[2][0], blockBits[2], blockRef[2], input, offset, len, saturatingAdd);
+                    offset += DecodeBlock<BoundsChecked>(&p[3][0], blockBits[3], blockRef[3], input, offset, len, saturatingAdd);
+                }
+
+                const uint16_t* blockSrc[4][2] = {
+                    { &p[0][0],                  &p[1][0] },
+                    { &p[2][0],                  &p[3][0] },
+                    { &p[0][ENCODING_BLOCK/2],   &p[1][ENCODING_BLOCK/2] },
+                    { &p[2][ENCODING_BLOCK/2],   &p[3][ENCODING_BLOCK/2] }
+                };
+
+                for(int r = 0; r < 4; r++) {
+                    uint8_t* dst = output + static_cast<size_t>(r)*rowBytes + static_cast<size_t>(x)*bitsPerPixel/8;
+
+                    InterleaveRow(&stage[0], blockSrc[r][0], blockSrc[r][1]);
+
+                    if(x + ENCODING_BLOCK <= static_cast<uint32_t>(width)) {
+                        PackSegment(dst, &stage[0], bitsPerPixel, maxVal);
+                    }
+                    else if(x < static_cast<uint32_t>(width)) {
+                        // The edge segment packs to staging; the row keeps
+                        // only its remaining bytes, pad bits zeroed
+                        PackSegment(&tail[0], &stage[0], bitsPerPixel, maxVal);
+
+                        const size_t remaining = rowBytes - static_cast<size_t>(x)*bitsPerPixel/8;
+
+                        std::memcpy(dst, &tail[0], remaining);
+
+                        if(padBits > 0)
+                            dst[remaining - 1] &= static_cast<uint8_t>(0xFF << padBits);
+                    }
+                }
+
+                metadataIdx += 4;
+            }
+
+            output += 4 * rowBytes;
+        }
+
+        return output;
+    }
+
+    } // unnamed namespace
+
+    size_t DecodePacked(
+        uint8_t* output,
+        const int width,
+        const int height,
+        const int bitsPerPixel,
+        const uint8_t* input,
+        const size_t len,
+        DecodeContext& context)
+    {
+        if(bitsPerPixel < 8 || bitsPerPixel > 16 || bitsPerPixel % 2 != 0)
+            return 0;
+
+        std::vector<uint16_t>& bits = context.bits;
+        std::vector<uint16_t>& refs = context.refs;
+        uint32_t encodedWidth, encodedHeight, bitsOffset, refsOffset;
+
+        ReadMetadataHeader(input, encodedWidth, encodedHeight, bitsOffset, refsOffset);
+
+        if(bitsOffset > len || refsOffset > len)
+            return 0;
+
+        if(encodedWidth % ENCODING_BLOCK > 0)
+            return 0;
+
+        if(encodedWidth < static_cast<uint32_t>(width))
+            return 0;
+
+        DecodeMetadata(input, bitsOffset, len, bits);
+        DecodeMetadata(input, refsOffset, len, refs);
+
+        const size_t numBlocks = static_cast<size_t>(encodedWidth/ENCODING_BLOCK) * encodedHeight;
+        const bool verified = refs.size() >= numBlocks && VerifyPayload(bits, numBlocks, len);
+
+        const size_t rowBytes = (static_cast<size_t>(width) * bitsPerPixel + 7) / 8;
+
+        (void)height;
+
+        uint8_t* end = verified
+            ? DecodePackedFrameLoop<false>(output, width, rowBytes, bitsPerPixel, encodedWidth, encodedHeight, input, len, METADATA_OFFSET, bits, refs, context.saturatingAdd, context.cancel)
+            : DecodePackedFrameLoop<true>(output, width, rowBytes, bitsPerPixel, encodedWidth, encodedHeight, input, len, METADATA_OFFSET, bits, refs, context.saturatingAdd, context.cancel);
+
+        if(!end)
+            return 0;
+
+        return (end - output);
+    }
+
+    // --- Encoding ---
+
+    namespace {
+
+    INLINE
+    UInt16x8 LoadV(const uint16_t* src) {
+        simde_uint16x8_t v;
+        std::memcpy(&v, src, sizeof(v));
+
+        return UInt16x8(v);
+    }
+
+    // Narrowing store: the low byte of each lane. Packed fields shifted
+    // above bit 7 fall off here, which the packers below rely on.
+    INLINE
+    void StoreN(uint8_t *RESTRICT dst, const UInt16x8& src) {
+        simde_vst1_u8(dst, simde_vmovn_u16(src.d));
+    }
+
+    INLINE
+    void StoreW(uint8_t *RESTRICT dst, const UInt16x8& src) {
+        std::memcpy(dst, &src.d, sizeof(src.d));
+    }
+
+    // Pack one block of 64 deltas at the given bits value, mirroring the
+    // lane layout of the matching decode kernel; classes that share a
+    // kernel (7 with 8, 9 with 10, 11..15 with 16) share a packer. Deltas
+    // must fit in bits. Returns the packed length.
+    size_t EncodeBlock(uint8_t *RESTRICT out, const uint16_t* v, const int bits) {
+        const UInt16x8 v0 = LoadV(v);
+        const UInt16x8 v1 = LoadV(v + 8);
+        const UInt16x8 v2 = LoadV(v + 16);
+        const UInt16x8 v3 = LoadV(v + 24);
+        const UInt16x8 v4 = LoadV(v + 32);
+        const UInt16x8 v5 = LoadV(v + 40);
+        const UInt16x8 v6 = LoadV(v + 48);
+        const UInt16x8 v7 = LoadV(v + 56);
+
+        switch(bits) {
+            case 0:
+                break;
+
+            case 1:
+                StoreN(out, v0 | v1.shl<1>() | v2.shl<2>() | v3.shl<3>() | v4.shl<4>() | v5.shl<5>() | v6.shl<6>() | v7.shl<7>());
+                break;
+
+            case 2:
+                StoreN(out,     v0 | v1.shl<2>() | v2.shl<4>() | v3.shl<6>());
+                StoreN(out + 8, v4 | v5.shl<2>() | v6.shl<4>() | v7.shl<6>());
+                break;
+
+            case 3:
+                // The third value of each byte triple keeps its low two
+                // bits in place; the upper bits collect in the last byte
+                StoreN(out,      v0 | v1.shl<3>() | v2.shl<6>());
+                StoreN(out + 8,  v3 | v4.shl<3>() | v5.shl<6>());
+                StoreN(out + 16, v6 | v7.shl<3>() | v2.shr<2>().shl<6>() | v5.shr<2>().shl<7>());
+                break;
+
+            case 4:
+                StoreN(out,      v0 | v1.shl<4>());
+                StoreN(out + 8,  v2 | v3.shl<4>());
+                StoreN(out + 16, v4 | v5.shl<4>());
+                StoreN(out + 24, v6 | v7.shl<4>());
+                break;
+
+            case 5:
+                StoreN(out,      v0 | v5.shl<5>());
+                StoreN(out + 8,  v1 | v6.shl<5>());
+                StoreN(out + 16, v2 | v7.shl<5>());
+                StoreN(out + 24, v3 | v5.shr<3>().shl<5>() | v7.shr<3>().shl<7>());
+                StoreN(out + 32, v4 | v6.shr<3>().shl<5>() | v7.shr<4>().shl<7>());
+                break;
+
+            case 6:
+                StoreN(out,      v0 | v6.shl<6>());
+                StoreN(out + 8,  v1 | v6.shr<2>().shl<6>());
+                StoreN(out + 16, v2 | v6.shr<4>().shl<6>());
+                StoreN(out + 24, v3 | v7.shl<6>());
+                StoreN(out + 32, v4 | v7.shr<2>().shl<6>());
+                StoreN(out + 40, v5 | v7.shr<4>().shl<6>());
+                break;
+
+            case 7:
+            case 8:
+                StoreN(out,      v0);
+                StoreN(out + 8,  v1);
+                StoreN(out + 16, v2);
+                StoreN(out + 24, v3);
+                StoreN(out + 32, v4);
+                StoreN(out + 40, v5);
+                StoreN(out + 48, v6);
+                StoreN(out + 56, v7);
+                break;
+
+            case 9:
+            case 10:
+                StoreN(out,      v0);
+                StoreN(out + 8,  v1);
+                StoreN(out + 16, v2);
+                StoreN(out + 24, v3);
+                StoreN(out + 32, v0.shr<8>() | v1.shr<8>().shl<2>() | v2.shr<8>().shl<4>() | v3.shr<8>().shl<6>());
+                StoreN(out + 40, v4);
+                StoreN(out + 48, v5);
+                StoreN(out + 56, v6);
+                StoreN(out + 64, v7);
+                StoreN(out + 72, v4.shr<8>() | v5.shr<8>().shl<2>() | v6.shr<8>().shl<4>() | v7.shr<8>().shl<6>());
+                break;
+
+            default:
+                StoreW(out,       v0);
+                StoreW(out + 16,  v1);
+                StoreW(out + 32,  v2);
+                StoreW(out + 48,  v3);
+                StoreW(out + 64,  v4);
+                StoreW(out + 80,  v5);
+                StoreW(out + 96,  v6);
+                StoreW(out + 112, v7);
+                break;
+        }
+
+        return ENCODING_BLOCK_LENGTH[bits];
+    }
+
+    // Block minimum and the bit width of the widest delta above it
+    void BlockRange(const uint16_t* v, uint16_t& outReference, int& outBits) {
+        simde_uint16x8_t mn = LoadV(v).d;
+        simde_uint16x8_t mx = mn;
+
+        for(int k = 8; k < ENCODING_BLOCK; k += 8) {
+            const simde_uint16x8_t p = LoadV(v + k).d;
+
+            mn = simde_vminq_u16(mn, p);
+            mx = simde_vmaxq_u16(mx, p);
+        }
+
+        uint16_t lanesMin[8], lanesMax[8];
+        simde_vst1q_u16(lanesMin, mn);
+        simde_vst1q_u16(lanesMax, mx);
+
+        uint16_t minValue = lanesMin[0], maxValue = lanesMax[0];
+
+        for(int i = 1; i < 8; i++) {
+            minValue = std::min(minValue, lanesMin[i]);
+            maxValue = std::max(maxValue, lanesMax[i]);
+        }
+
+        const uint16_t delta = maxValue - minValue;
+
+        int bits = 0;
+
+        while(delta >> bits)
+            bits++;
+
+        outReference = minValue;
+        outBits = bits;
+    }
+
+    // Subtract the block reference from every value
+    void SubtractReference(uint16_t *RESTRICT out, const uint16_t* v, const uint16_t reference) {
+        const simde_uint16x8_t ref = simde_vdupq_n_u16(reference);
+
+        for(int k = 0; k < ENCODING_BLOCK; k += 8)
+            simde_vst1q_u16(out + k, simde_vsubq_u16(LoadV(v + k).d, ref));
+    }
+
+    // Append one metadata section: a count then the values packed as
+    // blocks of 64 with a 2-byte bits/reference header each, exactly what
+    // DecodeMetadata unpacks. The count is padded up to whole blocks (the
+    // dimensions bound how many entries the decoder actually uses), and
+    // the header fields cap the reference at 12 bits and the bits nibble
+    // at class 16.
+    void EncodeMetadata(const std::vector<uint16_t>& values, std::vector<uint8_t>& output) {
+        const size_t numBlocks = (values.size() + ENCODING_BLOCK - 1) / ENCODING_BLOCK * ENCODING_BLOCK;
+
+        output.push_back(numBlocks & 0xFF);
+        output.push_back((numBlocks >> 8) & 0xFF);
+        output.push_back((numBlocks >> 16) & 0xFF);
+        output.push_back((numBlocks >> 24) & 0xFF);
+
+        uint16_t block[ENCODING_BLOCK];
+        uint16_t deltas[ENCODING_BLOCK];
+
+        for(size_t i = 0; i < numBlocks; i += ENCODING_BLOCK) {
+            for(int k = 0; k < ENCODING_BLOCK; k++)
+                block[k] = i + k < values.size() ? values[i + k] : 0;
+
+            uint16_t reference;
+            int bits;
+
+            BlockRange(block, reference, bits);
+
+            reference = std::min<uint16_t>(reference, 0x0FFF);
+
+            // Deltas above a capped reference can need the full 16 bits,
+            // which shares class 15's kernel and length
+            for(int k = 0; k < ENCODING_BLOCK; k++)
+                if((block[k] - reference) >> bits)
+                    bits++;
+
+            bits = std::min(bits, 15);
+
+            output.push_back(static_cast<uint8_t>((bits << 4) | ((reference >> 8) & 0x0F)));
+            output.push_back(static_cast<uint8_t>(reference & 0xFF));
+
+            SubtractReference(deltas, block, reference);
+
+            const size_t at = output.size();
+            output.resize(at + ENCODING_BLOCK_LENGTH[bits]);
+            EncodeBlock(output.data() + at, deltas, bits);
+        }
+    }
+
+    } // unnamed namespace
+
+    size_t Encode(
+        const uint16_t* input,
+        const int width,
+        const int height,
+        std::vector<uint8_t>& output)
+    {
+        const uint32_t encodedWidth = static_cast<uint32_t>((width + ENCODING_BLOCK - 1) / ENCODING_BLOCK) * ENCODING_BLOCK;
+        const uint32_t encodedHeight = static_cast<uint32_t>((height + 3) / 4) * 4;
+
+        const size_t numBlocks = static_cast<size_t>(encodedWidth / ENCODING_BLOCK) * encodedHeight;
+
+        std::vector<uint16_t> bits;
+        std::vector<uint16_t> refs;
+
+        bits.reserve(numBlocks);
+        refs.reserve(numBlocks);
+
+        output.clear();
+        output.reserve(METADATA_OFFSET + numBlocks * (ENCODING_BLOCK_LENGTH[10] + 3));
+        output.resize(METADATA_OFFSET);
+
+        // Each block is one CFA plane slice of a 4-row group: 32 same-parity
+        // columns of one row then of the row two below, the split the
+        // decode kernels stage and InterleaveRow zips back together. Edge
+        // pixels are replicated into the padding so it packs at zero or
+        // near-zero extra bits.
+        uint16_t block[4][ENCODING_BLOCK];
+        uint16_t deltas[ENCODING_BLOCK];
+
+        for(uint32_t y = 0; y < encodedHeight; y += 4) {
+            const uint16_t* rows[4];
+
+            for(uint32_t r = 0; r < 4; r++)
+                rows[r] = input + static_cast<size_t>(std::min<uint32_t>(y + r, height - 1)) * width;
+
+            for(uint32_t x = 0; x < encodedWidth; x += ENCODING_BLOCK) {
+                // Blocks 0 and 1 carry rows y and y+2 (even then odd
+                // columns), blocks 2 and 3 rows y+1 and y+3
+                for(int pair = 0; pair < 2; pair++) {
+                    const uint16_t* rowA = rows[pair];
+                    const uint16_t* rowB = rows[pair + 2];
+
+                    for(int i = 0; i < ENCODING_BLOCK; i += 2) {
+                        const uint32_t c0 = std::min<uint32_t>(x + i, width - 1);
+                        const uint32_t c1 = std::min<uint32_t>(x + i + 1, width - 1);
+
+                        block[2*pair][i/2] = rowA[c0];
+                        block[2*pair + 1][i/2] = rowA[c1];
+                        block[2*pair][ENCODING_BLOCK/2 + i/2] = rowB[c0];
+                        block[2*pair + 1][ENCODING_BLOCK/2 + i/2] = rowB[c1];
+                    }
+                }
+
+                for(int b = 0; b < 4; b++) {
+                    uint16_t reference;
+                    int blockBits;
+
+                    BlockRange(block[b], reference, blockBits);
+
+                    bits.push_back(static_cast<uint16_t>(blockBits));
+                    refs.push_back(reference);
+
+                    SubtractReference(deltas, block[b], reference);
+
+                    const size_t at = output.size();
+                    output.resize(at + ENCODING_BLOCK_LENGTH[blockBits]);
+                    EncodeBlock(output.data() + at, deltas, blockBits);
+                }
+            }
+        }
+
+        const uint32_t bitsOffset = static_cast<uint32_t>(output.size());
+        EncodeMetadata(bits, output);
+
+        const uint32_t refsOffset = static_cast<uint32_t>(output.size());
+        EncodeMetadata(refs, output);
+
+        // Header last, now that the section offsets are known
+        const uint32_t header[4] = { encodedWidth, encodedHeight, bitsOffset, refsOffset };
+        std::memcpy(output.data(), header, sizeof(header));
+
+        return output.size();
     }
 }}
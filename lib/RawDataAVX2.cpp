@@ -0,0 +1,24 @@
+// AVX2 kernel translation unit for compilers without per-function target
+// attributes (MSVC). Built with AVX2 code generation (/arch:AVX2, -mavx2)
+// and linked into the library next to the generic kernels; RawData.cpp
+// reaches these entry points through its one-time CPU probe. Compilers
+// with the attribute compile RawDataAVX2.h into RawData.cpp directly and
+// don't build this file.
+
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+    #define AVX2_FN
+    #define AVX2_HELPER inline __attribute__((always_inline))
+    #define RESTRICT __restrict__
+#elif defined(_MSC_VER)
+    #define AVX2_FN
+    #define AVX2_HELPER __forceinline
+    #define RESTRICT __restrict
+#else
+    #define AVX2_FN
+    #define AVX2_HELPER inline
+    #define RESTRICT
+#endif
+
+#include "RawDataAVX2.h"
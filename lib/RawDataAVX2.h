@@ -0,0 +1,199 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RawDataAVX2_h
+#define RawDataAVX2_h
+
+// AVX2 backend for the kernels whose packed layout widens cleanly to 16
+// lanes. One source, two build shapes:
+//
+//  - RawData.cpp includes it directly when the library is built with AVX2
+//    code generation or the compiler supports per-function target
+//    attributes (GCC, Clang); the includer supplies AVX2_FN, AVX2_HELPER
+//    and RESTRICT.
+//  - RawDataAVX2.cpp, a translation unit compiled with AVX2 flags
+//    (/arch:AVX2), carries the definitions for compilers without target
+//    attributes (MSVC); RawData.cpp then defines
+//    MOTIONCAM_RAW_AVX2_DECLARE_ONLY and sees just the entry points,
+//    reached through the same runtime probe.
+
+#include <cstdint>
+
+namespace motioncam {
+namespace raw {
+namespace avx2 {
+
+    // Values of one encoded block and the packed byte length per wide-
+    // kernel bits class; RawData.cpp static_asserts these against its
+    // ENCODING_BLOCK_LENGTH table
+    constexpr int BLOCK = 64;
+    constexpr int BLOCK_LENGTH_2 = 16;
+    constexpr int BLOCK_LENGTH_4 = 32;
+    constexpr int BLOCK_LENGTH_8 = 64;
+    constexpr int BLOCK_LENGTH_16 = 128;
+
+#if defined(MOTIONCAM_RAW_AVX2_DECLARE_ONLY)
+
+    const uint8_t* Decode2(uint16_t* output, const uint8_t* input, uint16_t reference);
+    const uint8_t* Decode4(uint16_t* output, const uint8_t* input, uint16_t reference);
+    const uint8_t* Decode8(uint16_t* output, const uint8_t* input, uint16_t reference);
+    const uint8_t* Decode16(uint16_t* output, const uint8_t* input, uint16_t reference);
+    const uint8_t* Decode16Sat(uint16_t* output, const uint8_t* input, uint16_t reference);
+    void InterleaveRow(uint16_t* dst, const uint16_t* a, const uint16_t* b);
+    void InterleaveRowNT(uint16_t* dst, const uint16_t* a, const uint16_t* b);
+
+#else // MOTIONCAM_RAW_AVX2_DECLARE_ONLY
+
+#if !defined(AVX2_FN) || !defined(AVX2_HELPER) || !defined(RESTRICT)
+    #error RawDataAVX2.h expects AVX2_FN, AVX2_HELPER and RESTRICT from its includer
+#endif
+
+    // Each iteration loads 16 packed bytes, double the width of the
+    // UInt16x8 path. The two 64-bit input groups inside a load land in the
+    // low/high 128-bit halves, which are stored to their destination
+    // offsets separately where the layout requires it.
+
+    AVX2_HELPER
+    __m256i LoadU16x16(const uint8_t* src) {
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+    }
+
+    AVX2_HELPER
+    void StoreHalves(uint16_t *RESTRICT lo, uint16_t *RESTRICT hi, const __m256i v) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lo), _mm256_castsi256_si128(v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(hi), _mm256_extracti128_si256(v, 1));
+    }
+
+    AVX2_FN
+    const uint8_t* Decode2(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const __m256i REF = _mm256_set1_epi16(reference);
+        const __m256i N = _mm256_set1_epi16(0x03);
+        const __m256i p = LoadU16x16(input);
+
+        StoreHalves(output,      output + 32, _mm256_add_epi16(_mm256_and_si256(p, N), REF));
+        StoreHalves(output + 8,  output + 40, _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi16(p, 2), N), REF));
+        StoreHalves(output + 16, output + 48, _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi16(p, 4), N), REF));
+        StoreHalves(output + 24, output + 56, _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi16(p, 6), N), REF));
+
+        return input + BLOCK_LENGTH_2;
+    }
+
+    AVX2_FN
+    const uint8_t* Decode4(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const __m256i REF = _mm256_set1_epi16(reference);
+        const __m256i N = _mm256_set1_epi16(0x0F);
+
+        __m256i p = LoadU16x16(input);
+
+        StoreHalves(output,     output + 16, _mm256_add_epi16(_mm256_and_si256(p, N), REF));
+        StoreHalves(output + 8, output + 24, _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi16(p, 4), N), REF));
+
+        p = LoadU16x16(input + 16);
+
+        StoreHalves(output + 32, output + 48, _mm256_add_epi16(_mm256_and_si256(p, N), REF));
+        StoreHalves(output + 40, output + 56, _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi16(p, 4), N), REF));
+
+        return input + BLOCK_LENGTH_4;
+    }
+
+    AVX2_FN
+    const uint8_t* Decode8(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const __m256i REF = _mm256_set1_epi16(reference);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output),      _mm256_add_epi16(LoadU16x16(input), REF));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 16), _mm256_add_epi16(LoadU16x16(input + 16), REF));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 32), _mm256_add_epi16(LoadU16x16(input + 32), REF));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 48), _mm256_add_epi16(LoadU16x16(input + 48), REF));
+
+        return input + BLOCK_LENGTH_8;
+    }
+
+    AVX2_FN
+    const uint8_t* Decode16(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const __m256i REF = _mm256_set1_epi16(reference);
+        auto* out = reinterpret_cast<__m256i*>(output);
+        auto* in = reinterpret_cast<const __m256i*>(input);
+
+        _mm256_storeu_si256(out,     _mm256_add_epi16(_mm256_loadu_si256(in), REF));
+        _mm256_storeu_si256(out + 1, _mm256_add_epi16(_mm256_loadu_si256(in + 1), REF));
+        _mm256_storeu_si256(out + 2, _mm256_add_epi16(_mm256_loadu_si256(in + 2), REF));
+        _mm256_storeu_si256(out + 3, _mm256_add_epi16(_mm256_loadu_si256(in + 3), REF));
+
+        return input + BLOCK_LENGTH_16;
+    }
+
+    // Saturating twin of Decode16 (see Decode16Sat in RawData.cpp)
+    AVX2_FN
+    const uint8_t* Decode16Sat(uint16_t *RESTRICT output, const uint8_t* input, const uint16_t reference) {
+        const __m256i REF = _mm256_set1_epi16(reference);
+        auto* out = reinterpret_cast<__m256i*>(output);
+        auto* in = reinterpret_cast<const __m256i*>(input);
+
+        _mm256_storeu_si256(out,     _mm256_adds_epu16(_mm256_loadu_si256(in), REF));
+        _mm256_storeu_si256(out + 1, _mm256_adds_epu16(_mm256_loadu_si256(in + 1), REF));
+        _mm256_storeu_si256(out + 2, _mm256_adds_epu16(_mm256_loadu_si256(in + 2), REF));
+        _mm256_storeu_si256(out + 3, _mm256_adds_epu16(_mm256_loadu_si256(in + 3), REF));
+
+        return input + BLOCK_LENGTH_16;
+    }
+
+    // 16-lane variant of InterleaveRow. unpacklo/hi zip within each 128-bit
+    // lane, so a cross-lane permute restores sequential order.
+    AVX2_FN
+    void InterleaveRow(
+        uint16_t *RESTRICT dst,
+        const uint16_t* a,
+        const uint16_t* b)
+    {
+        for(int i = 0; i < BLOCK/2; i += 16) {
+            const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+
+            const __m256i lo = _mm256_unpacklo_epi16(va, vb);
+            const __m256i hi = _mm256_unpackhi_epi16(va, vb);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2*i),      _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2*i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+    }
+
+    // Same zip, streamed past the cache for outputs the CPU never reads
+    // back. dst must be 32-byte aligned.
+    AVX2_FN
+    void InterleaveRowNT(
+        uint16_t *RESTRICT dst,
+        const uint16_t* a,
+        const uint16_t* b)
+    {
+        for(int i = 0; i < BLOCK/2; i += 16) {
+            const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+
+            const __m256i lo = _mm256_unpacklo_epi16(va, vb);
+            const __m256i hi = _mm256_unpackhi_epi16(va, vb);
+
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 2*i),      _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 2*i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+    }
+
+#endif // MOTIONCAM_RAW_AVX2_DECLARE_ONLY
+
+} // namespace avx2
+} // namespace raw
+} // namespace motioncam
+
+#endif /* RawDataAVX2_h */
@@ -0,0 +1,523 @@
+#include <motioncam/Reader.hpp>
+#include <motioncam/Decoder.hpp>
+
+#include <cstring>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+
+    #define FSEEK _fseeki64
+    #define FTELL _ftelli64
+#elif defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+    #define _FILE_OFFSET_BITS 64
+
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+    #if defined(__linux__)
+        #include <sys/sysmacros.h>
+        #include <sys/vfs.h>
+    #endif
+
+    #define FSEEK fseeko
+    #define FTELL ftello
+#else
+    #error Unknown platform
+#endif
+
+namespace motioncam {
+
+    void Reader::readBatch(const std::vector<ReadRequest>& requests) {
+        for(const auto& r : requests) {
+            if(!seek(r.offset, SEEK_SET))
+                throw IOException("Invalid offset");
+
+            read(r.dst, r.len);
+        }
+    }
+
+    //
+    // FileReader
+    //
+
+    FileReader::FileReader(const std::string& path) :
+        mFile(std::fopen(path.c_str(), "rb")), mOwnsFile(true)
+    {
+        if(!mFile)
+            throw IOException("Failed to open " + path);
+    }
+
+    FileReader::FileReader(FILE* file, bool ownsFile) : mFile(file), mOwnsFile(ownsFile) {
+        if(!mFile)
+            throw IOException("Invalid file");
+    }
+
+    FileReader::~FileReader() {
+        if(mFile && mOwnsFile)
+            std::fclose(mFile);
+    }
+
+    void FileReader::read(void* data, size_t size, size_t items) {
+        if(std::fread(data, size, items, mFile) != items)
+            throw IOException("Failed to read data");
+    }
+
+    bool FileReader::tryRead(void* data, size_t size) {
+        return std::fread(data, size, 1, mFile) == 1;
+    }
+
+    bool FileReader::seek(int64_t offset, int origin) {
+        return FSEEK(mFile, offset, origin) == 0;
+    }
+
+    void FileReader::advise(int64_t offset, size_t len, Advice advice) {
+#if defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(fileno(mFile), offset, static_cast<off_t>(len),
+            advice == Advice::WILL_NEED ? POSIX_FADV_WILLNEED
+                : advice == Advice::SEQUENTIAL ? POSIX_FADV_SEQUENTIAL
+                : POSIX_FADV_DONTNEED);
+#else
+        (void) offset;
+        (void) len;
+        (void) advice;
+#endif
+    }
+
+    int64_t FileReader::size() {
+        const int64_t pos = FTELL(mFile);
+
+        if(pos < 0 || FSEEK(mFile, 0, SEEK_END) != 0)
+            return -1;
+
+        const int64_t size = FTELL(mFile);
+
+        if(FSEEK(mFile, pos, SEEK_SET) != 0)
+            return -1;
+
+        return size;
+    }
+
+    bool FileReader::reopen(const std::string& path) {
+        if(!mFile || !mOwnsFile)
+            return false;
+
+        // freopen retargets the existing stream in place, keeping its stdio
+        // buffer; on failure the stream has already been closed
+        mFile = std::freopen(path.c_str(), "rb", mFile);
+
+        return mFile != nullptr;
+    }
+
+    //
+    // MemoryMappedReader
+    //
+
+#if defined(_WIN32)
+    MemoryMappedReader::MemoryMappedReader(const std::string& path) :
+        mData(nullptr), mSize(0), mPos(0), mFileHandle(nullptr), mMappingHandle(nullptr)
+    {
+        HANDLE file = CreateFileA(
+            path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if(file == INVALID_HANDLE_VALUE)
+            throw IOException("Failed to open " + path);
+
+        LARGE_INTEGER size{};
+
+        if(!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+            CloseHandle(file);
+            throw IOException("Failed to get size of " + path);
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!mapping) {
+            CloseHandle(file);
+            throw IOException("Failed to map " + path);
+        }
+
+        void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if(!data) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            throw IOException("Failed to map " + path);
+        }
+
+        mFileHandle = file;
+        mMappingHandle = mapping;
+        mData = static_cast<const uint8_t*>(data);
+        mSize = static_cast<size_t>(size.QuadPart);
+    }
+
+    MemoryMappedReader::~MemoryMappedReader() {
+        if(mData)
+            UnmapViewOfFile(mData);
+
+        if(mMappingHandle)
+            CloseHandle(static_cast<HANDLE>(mMappingHandle));
+
+        if(mFileHandle)
+            CloseHandle(static_cast<HANDLE>(mFileHandle));
+    }
+#else
+    MemoryMappedReader::MemoryMappedReader(const std::string& path) :
+        mData(nullptr), mSize(0), mPos(0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            throw IOException("Failed to open " + path);
+
+        struct stat st{};
+
+        if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            throw IOException("Failed to get size of " + path);
+        }
+
+        void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+
+        // The mapping keeps its own reference to the file
+        ::close(fd);
+
+        if(data == MAP_FAILED)
+            throw IOException("Failed to map " + path);
+
+        mData = static_cast<const uint8_t*>(data);
+        mSize = static_cast<size_t>(st.st_size);
+    }
+
+    MemoryMappedReader::~MemoryMappedReader() {
+        if(mData)
+            munmap(const_cast<uint8_t*>(mData), mSize);
+    }
+#endif
+
+    void MemoryMappedReader::read(void* data, size_t size, size_t items) {
+        const size_t total = size * items;
+
+        if(mPos + total > mSize)
+            throw IOException("Failed to read data");
+
+        std::memcpy(data, mData + mPos, total);
+        mPos += total;
+    }
+
+    bool MemoryMappedReader::tryRead(void* data, size_t size) {
+        if(mPos + size > mSize)
+            return false;
+
+        std::memcpy(data, mData + mPos, size);
+        mPos += size;
+
+        return true;
+    }
+
+    bool MemoryMappedReader::seek(int64_t offset, int origin) {
+        int64_t newPos;
+
+        switch(origin) {
+            case SEEK_SET:
+                newPos = offset;
+                break;
+            case SEEK_CUR:
+                newPos = static_cast<int64_t>(mPos) + offset;
+                break;
+            case SEEK_END:
+                newPos = static_cast<int64_t>(mSize) + offset;
+                break;
+            default:
+                return false;
+        }
+
+        if(newPos < 0 || newPos > static_cast<int64_t>(mSize))
+            return false;
+
+        mPos = static_cast<size_t>(newPos);
+
+        return true;
+    }
+
+    int64_t MemoryMappedReader::size() {
+        return static_cast<int64_t>(mSize);
+    }
+
+    const uint8_t* MemoryMappedReader::directRead(size_t len) {
+        if(mPos + len > mSize)
+            return nullptr;
+
+        const uint8_t* p = mData + mPos;
+        mPos += len;
+
+        return p;
+    }
+
+    MemoryReader::MemoryReader(const uint8_t* data, size_t size) :
+        mData(data), mSize(size), mPos(0)
+    {
+        if(!mData)
+            throw IOException("Invalid buffer");
+    }
+
+    MemoryReader::MemoryReader(std::shared_ptr<const std::vector<uint8_t>> buffer) :
+        mBuffer(std::move(buffer)),
+        mData(mBuffer ? mBuffer->data() : nullptr),
+        mSize(mBuffer ? mBuffer->size() : 0),
+        mPos(0)
+    {
+        if(!mData)
+            throw IOException("Invalid buffer");
+    }
+
+    void MemoryReader::read(void* data, size_t size, size_t items) {
+        const size_t total = size * items;
+
+        if(mPos + total > mSize)
+            throw IOException("Failed to read data");
+
+        std::memcpy(data, mData + mPos, total);
+        mPos += total;
+    }
+
+    bool MemoryReader::tryRead(void* data, size_t size) {
+        if(mPos + size > mSize)
+            return false;
+
+        std::memcpy(data, mData + mPos, size);
+        mPos += size;
+
+        return true;
+    }
+
+    bool MemoryReader::seek(int64_t offset, int origin) {
+        int64_t newPos;
+
+        switch(origin) {
+            case SEEK_SET:
+                newPos = offset;
+                break;
+            case SEEK_CUR:
+                newPos = static_cast<int64_t>(mPos) + offset;
+                break;
+            case SEEK_END:
+                newPos = static_cast<int64_t>(mSize) + offset;
+                break;
+            default:
+                return false;
+        }
+
+        if(newPos < 0 || newPos > static_cast<int64_t>(mSize))
+            return false;
+
+        mPos = static_cast<size_t>(newPos);
+
+        return true;
+    }
+
+    const uint8_t* MemoryReader::directRead(size_t len) {
+        if(mPos + len > mSize)
+            return nullptr;
+
+        const uint8_t* p = mData + mPos;
+        mPos += len;
+
+        return p;
+    }
+
+    int64_t MemoryReader::size() {
+        return static_cast<int64_t>(mSize);
+    }
+
+    //
+    // BlockBufferedReader
+    //
+
+    namespace {
+        FILE* openFileOrThrow(const std::string& path) {
+            FILE* file = std::fopen(path.c_str(), "rb");
+
+            if(!file)
+                throw IOException("Failed to open " + path);
+
+            return file;
+        }
+
+        int64_t fileSizeOrThrow(FILE* file) {
+            if(FSEEK(file, 0, SEEK_END) != 0) {
+                std::fclose(file);
+                throw IOException("Failed to get file size");
+            }
+
+            const int64_t size = FTELL(file);
+
+            if(size < 0) {
+                std::fclose(file);
+                throw IOException("Failed to get file size");
+            }
+
+            return size;
+        }
+    }
+
+    BlockBufferedReader::BlockBufferedReader(const std::string& path, size_t blockSize, size_t cacheBytes) :
+        BlockBufferedReader(openFileOrThrow(path), blockSize, cacheBytes)
+    {
+    }
+
+    BlockBufferedReader::BlockBufferedReader(FILE* file, size_t blockSize, size_t cacheBytes) :
+        RemoteReader(
+            [file](int64_t offset, size_t len, void* dst) -> size_t {
+                if(FSEEK(file, offset, SEEK_SET) != 0)
+                    return 0;
+
+                return std::fread(dst, 1, len, file);
+            },
+            fileSizeOrThrow(file), blockSize, cacheBytes),
+        mFile(file)
+    {
+    }
+
+    BlockBufferedReader::~BlockBufferedReader() {
+        if(mFile)
+            std::fclose(mFile);
+    }
+
+    //
+    // Storage profiles
+    //
+
+    StorageProfile detectStorageProfile(const std::string& path) {
+#if defined(__linux__)
+        struct statfs fs {};
+
+        if(statfs(path.c_str(), &fs) == 0) {
+            switch(static_cast<unsigned>(fs.f_type)) {
+                case 0x6969:        // NFS
+                case 0x517B:        // SMB
+                case 0xFE534D42:    // SMB2
+                case 0xFF534D42:    // CIFS
+                case 0x65735546:    // FUSE (sshfs, rclone and similar)
+                    return StorageProfile::NETWORK;
+
+                default:
+                    break;
+            }
+        }
+
+        struct stat st {};
+
+        if(stat(path.c_str(), &st) == 0 && st.st_dev != 0) {
+            // A partition's sysfs node has no queue/ directory, so look at
+            // the parent device too
+            const char* formats[] = {
+                "/sys/dev/block/%u:%u/queue/rotational",
+                "/sys/dev/block/%u:%u/../queue/rotational"
+            };
+
+            for(const char* format : formats) {
+                char sysPath[128];
+                std::snprintf(sysPath, sizeof(sysPath), format, major(st.st_dev), minor(st.st_dev));
+
+                FILE* file = std::fopen(sysPath, "rb");
+
+                if(!file)
+                    continue;
+
+                const int flag = std::fgetc(file);
+                std::fclose(file);
+
+                if(flag == '1')
+                    return StorageProfile::HDD;
+
+                if(flag == '0')
+                    return StorageProfile::LOCAL_SSD;
+            }
+        }
+#else
+        (void) path;
+#endif
+
+        return StorageProfile::LOCAL_SSD;
+    }
+
+    std::unique_ptr<Reader> createReaderForProfile(const std::string& path, StorageProfile profile) {
+        if(profile == StorageProfile::AUTO)
+            profile = detectStorageProfile(path);
+
+        // Seeks dominate on rotational disks and round trips on network
+        // mounts: serve both through the block cache, with bigger blocks
+        // where each transfer costs more
+        if(profile == StorageProfile::HDD)
+            return std::unique_ptr<Reader>(new BlockBufferedReader(path, 1024 * 1024));
+
+        if(profile == StorageProfile::NETWORK)
+            return std::unique_ptr<Reader>(new BlockBufferedReader(path, 4 * 1024 * 1024));
+
+        // Local flash: small reads are cheap, so issue them directly
+#if defined(__linux__)
+        try {
+            return std::unique_ptr<Reader>(new UringReader(path));
+        }
+        catch(const IOException&) {
+            // io_uring unavailable (old kernel, seccomp); fall through
+        }
+#elif defined(__APPLE__)
+        // No ring on macOS; pooled preads with F_RDADVISE hints keep the
+        // device at queue depth on batch loads
+        try {
+            return std::unique_ptr<Reader>(new PreadPoolReader(path));
+        }
+        catch(const IOException&) {
+        }
+#endif
+
+        return std::unique_ptr<Reader>(new FileReader(path));
+    }
+
+    void MemoryMappedReader::advise(int64_t offset, size_t len, Advice advice) {
+        if(offset < 0 || static_cast<size_t>(offset) >= mSize)
+            return;
+
+        if(len > mSize - static_cast<size_t>(offset))
+            len = mSize - static_cast<size_t>(offset);
+
+#if !defined(_WIN32)
+        // madvise needs a page-aligned start
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t start = static_cast<size_t>(offset) & ~(pageSize - 1);
+
+        madvise(const_cast<uint8_t*>(mData) + start, len + (static_cast<size_t>(offset) - start),
+            advice == Advice::WILL_NEED ? MADV_WILLNEED
+                : advice == Advice::SEQUENTIAL ? MADV_SEQUENTIAL
+                : MADV_DONTNEED);
+#else
+        // Windows has no madvise; WILL_NEED maps to PrefetchVirtualMemory,
+        // which pages the range in with one large request instead of
+        // per-page faults mid-decode. The call is Windows 8+, so it is
+        // resolved dynamically; DONT_NEED and SEQUENTIAL have no
+        // equivalent for a read-only view and stay no-ops.
+        if(advice != Advice::WILL_NEED)
+            return;
+
+        struct MemoryRangeEntry {
+            PVOID VirtualAddress;
+            SIZE_T NumberOfBytes;
+        };
+
+        typedef BOOL (WINAPI* PrefetchVirtualMemoryFn)(HANDLE, ULONG_PTR, MemoryRangeEntry*, ULONG);
+
+        static const PrefetchVirtualMemoryFn prefetch = reinterpret_cast<PrefetchVirtualMemoryFn>(
+            reinterpret_cast<void*>(GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory")));
+
+        if(!prefetch)
+            return;
+
+        MemoryRangeEntry range{ const_cast<uint8_t*>(mData) + offset, len };
+
+        prefetch(GetCurrentProcess(), 1, &range, 0);
+#endif
+    }
+
+} // namespace motioncam
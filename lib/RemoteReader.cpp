@@ -0,0 +1,171 @@
+#include <motioncam/Reader.hpp>
+#include <motioncam/Decoder.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace motioncam {
+
+    RemoteReader::RemoteReader(RangeFetch fetch, int64_t fileSize, size_t blockSize, size_t cacheBytes) :
+        mFetch(std::move(fetch)),
+        mSize(fileSize),
+        mBlockSize(std::max<size_t>(blockSize, 4096)),
+        mMaxBlocks(std::max<size_t>(cacheBytes / mBlockSize, 2)),
+        mCacheBytes(cacheBytes),
+        mPos(0)
+    {
+        if(!mFetch)
+            throw IOException("Invalid range fetch callback");
+
+        if(mSize < 0)
+            throw IOException("Invalid remote file size");
+    }
+
+    void RemoteReader::resizeBlocks(size_t blockSize) {
+        const size_t newSize = std::max<size_t>(blockSize, 4096);
+
+        if(newSize == mBlockSize)
+            return;
+
+        mBlocks.clear();
+        mBlockIndex.clear();
+
+        mBlockSize = newSize;
+        mMaxBlocks = std::max<size_t>(mCacheBytes / mBlockSize, 2);
+    }
+
+    size_t RemoteReader::blockLen(int64_t block) const {
+        const int64_t start = block * static_cast<int64_t>(mBlockSize);
+
+        if(start >= mSize)
+            return 0;
+
+        return static_cast<size_t>(std::min<int64_t>(mBlockSize, mSize - start));
+    }
+
+    void RemoteReader::fetchBlocks(int64_t first, int64_t last) {
+        const int64_t start = first * static_cast<int64_t>(mBlockSize);
+        const size_t len =
+            static_cast<size_t>((last - first) * static_cast<int64_t>(mBlockSize)) + blockLen(last);
+
+        // One coalesced range request covering the whole run of missing blocks
+        std::vector<uint8_t> buffer(len);
+
+        if(mFetch(start, len, buffer.data()) != len)
+            throw IOException("Failed to read data");
+
+        for(int64_t block = first; block <= last; block++) {
+            const size_t offset = static_cast<size_t>((block - first) * static_cast<int64_t>(mBlockSize));
+            const size_t count = blockLen(block);
+
+            mBlocks.emplace_front();
+            mBlocks.front().index = block;
+            mBlocks.front().data.assign(buffer.begin() + offset, buffer.begin() + offset + count);
+
+            mBlockIndex[block] = mBlocks.begin();
+        }
+
+        // Evict least recently used blocks over budget
+        while(mBlocks.size() > mMaxBlocks) {
+            mBlockIndex.erase(mBlocks.back().index);
+            mBlocks.pop_back();
+        }
+    }
+
+    const RemoteReader::Block& RemoteReader::getBlock(int64_t block) {
+        auto it = mBlockIndex.find(block);
+
+        if(it != mBlockIndex.end()) {
+            // Move to the front of the LRU list
+            mBlocks.splice(mBlocks.begin(), mBlocks, it->second);
+            return mBlocks.front();
+        }
+
+        fetchBlocks(block, block);
+
+        return mBlocks.front();
+    }
+
+    bool RemoteReader::tryRead(void* data, size_t size) {
+        if(size == 0)
+            return true;
+
+        if(mPos < 0 || mPos + static_cast<int64_t>(size) > mSize)
+            return false;
+
+        const int64_t firstBlock = mPos / static_cast<int64_t>(mBlockSize);
+        const int64_t lastBlock = (mPos + static_cast<int64_t>(size) - 1) / static_cast<int64_t>(mBlockSize);
+
+        // Fetch every missing block in the span with coalesced range requests
+        int64_t runStart = -1;
+
+        for(int64_t block = firstBlock; block <= lastBlock; block++) {
+            const bool cached = mBlockIndex.find(block) != mBlockIndex.end();
+
+            if(!cached && runStart < 0)
+                runStart = block;
+
+            if(cached && runStart >= 0) {
+                fetchBlocks(runStart, block - 1);
+                runStart = -1;
+            }
+        }
+
+        if(runStart >= 0)
+            fetchBlocks(runStart, lastBlock);
+
+        // Copy out of the cache
+        uint8_t* dst = static_cast<uint8_t*>(data);
+        size_t remaining = size;
+
+        for(int64_t block = firstBlock; block <= lastBlock; block++) {
+            const Block& b = getBlock(block);
+
+            const size_t offset = static_cast<size_t>(mPos - block * static_cast<int64_t>(mBlockSize));
+            const size_t count = std::min(remaining, b.data.size() - offset);
+
+            std::memcpy(dst, b.data.data() + offset, count);
+
+            dst += count;
+            mPos += count;
+            remaining -= count;
+        }
+
+        return remaining == 0;
+    }
+
+    void RemoteReader::read(void* data, size_t size, size_t items) {
+        if(!tryRead(data, size * items))
+            throw IOException("Failed to read data");
+    }
+
+    bool RemoteReader::seek(int64_t offset, int origin) {
+        int64_t newPos;
+
+        switch(origin) {
+            case SEEK_SET:
+                newPos = offset;
+                break;
+            case SEEK_CUR:
+                newPos = mPos + offset;
+                break;
+            case SEEK_END:
+                newPos = mSize + offset;
+                break;
+            default:
+                return false;
+        }
+
+        if(newPos < 0)
+            return false;
+
+        mPos = newPos;
+
+        return true;
+    }
+
+    int64_t RemoteReader::size() {
+        return mSize;
+    }
+
+} // namespace motioncam
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/SegmentedDecoder.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <future>
+#include <numeric>
+
+namespace motioncam {
+    namespace {
+        bool fileExists(const std::string& path) {
+            FILE* file = fopen(path.c_str(), "rb");
+
+            if(!file)
+                return false;
+
+            fclose(file);
+
+            return true;
+        }
+
+        // Collect path and its numbered siblings. A name matching
+        // <prefix>.<n>.<ext> enumerates <prefix>.0.<ext>, <prefix>.1.<ext>,
+        // ... until the first gap; anything else is a single segment.
+        std::vector<std::string> findSegments(const std::string& path) {
+            const auto extPos = path.find_last_of('.');
+
+            if(extPos != std::string::npos && extPos > 0) {
+                const auto numPos = path.find_last_of('.', extPos - 1);
+
+                if(numPos != std::string::npos && numPos + 1 < extPos) {
+                    const auto number = path.substr(numPos + 1, extPos - numPos - 1);
+
+                    if(std::all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                        const auto prefix = path.substr(0, numPos + 1);
+                        const auto ext = path.substr(extPos);
+
+                        std::vector<std::string> segments;
+
+                        for(int n = 0; ; n++) {
+                            auto segment = prefix + std::to_string(n) + ext;
+
+                            if(!fileExists(segment))
+                                break;
+
+                            segments.push_back(std::move(segment));
+                        }
+
+                        if(!segments.empty())
+                            return segments;
+                    }
+                }
+            }
+
+            return { path };
+        }
+    }
+
+    SegmentedDecoder::SegmentedDecoder(const std::string& path, ReadMode mode) {
+        const auto segments = findSegments(path);
+
+        // Each segment's open walks its own index, so the opens run in
+        // parallel on the shared pool and the slowest segment bounds the
+        // total instead of the sum
+        std::vector<std::future<std::unique_ptr<Decoder>>> opens;
+        opens.reserve(segments.size());
+
+        for(const auto& segment : segments)
+            opens.push_back(Decoder::openAsync(segment, mode));
+
+        mDecoders.reserve(segments.size());
+
+        for(auto& open : opens)
+            mDecoders.push_back(open.get());
+
+        // Merge the per-segment frame lists into one sorted timeline,
+        // remembering which segment holds each frame
+        size_t totalFrames = 0;
+
+        for(const auto& decoder : mDecoders)
+            totalFrames += decoder->getFrames().size();
+
+        mFrameList.reserve(totalFrames);
+        mFrameSegment.reserve(totalFrames);
+
+        for(size_t i = 0; i < mDecoders.size(); i++) {
+            for(const auto timestamp : mDecoders[i]->getFrames()) {
+                mFrameList.push_back(timestamp);
+                mFrameSegment.push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        // Segments are recorded back to back, so the concatenation is
+        // usually already sorted and this is a single verification pass
+        std::vector<size_t> order(mFrameList.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return mFrameList[a] < mFrameList[b];
+        });
+
+        std::vector<Timestamp> sortedFrames(mFrameList.size());
+        std::vector<uint32_t> sortedSegments(mFrameList.size());
+
+        for(size_t i = 0; i < order.size(); i++) {
+            sortedFrames[i] = mFrameList[order[i]];
+            sortedSegments[i] = mFrameSegment[order[i]];
+        }
+
+        mFrameList = std::move(sortedFrames);
+        mFrameSegment = std::move(sortedSegments);
+    }
+
+    size_t SegmentedDecoder::numSegments() const {
+        return mDecoders.size();
+    }
+
+    Decoder& SegmentedDecoder::getSegment(size_t segment) {
+        return *mDecoders.at(segment);
+    }
+
+    const nlohmann::json& SegmentedDecoder::getContainerMetadata() const {
+        return mDecoders.front()->getContainerMetadata();
+    }
+
+    const ContainerMetadata& SegmentedDecoder::getTypedContainerMetadata() const {
+        return mDecoders.front()->getTypedContainerMetadata();
+    }
+
+    const std::vector<Timestamp>& SegmentedDecoder::getFrames() const {
+        return mFrameList;
+    }
+
+    int64_t SegmentedDecoder::findFrame(const Timestamp timestamp, SeekMode mode) const {
+        if(mFrameList.empty())
+            return -1;
+
+        auto it = std::lower_bound(mFrameList.begin(), mFrameList.end(), timestamp);
+        const int64_t index = it - mFrameList.begin();
+
+        switch(mode) {
+            case SeekMode::AFTER:
+                return it == mFrameList.end() ? -1 : index;
+
+            case SeekMode::BEFORE:
+                if(it != mFrameList.end() && *it == timestamp)
+                    return index;
+
+                return it == mFrameList.begin() ? -1 : index - 1;
+
+            case SeekMode::NEAREST:
+            default:
+                if(it == mFrameList.end())
+                    return index - 1;
+
+                if(it == mFrameList.begin())
+                    return 0;
+
+                // Pick the closer of the two neighbours
+                return (*it - timestamp) < (timestamp - *(it - 1)) ? index : index - 1;
+        }
+    }
+
+    Decoder& SegmentedDecoder::decoderFor(const Timestamp timestamp) {
+        auto it = std::lower_bound(mFrameList.begin(), mFrameList.end(), timestamp);
+
+        if(it == mFrameList.end() || *it != timestamp)
+            throw IOException("Frame not found (" + std::to_string(timestamp) + ")");
+
+        return *mDecoders[mFrameSegment[it - mFrameList.begin()]];
+    }
+
+    void SegmentedDecoder::loadFrameByIndex(size_t frameIndex, std::vector<uint16_t>& outData, nlohmann::json& outMetadata) {
+        if(frameIndex >= mFrameList.size())
+            throw IOException("Frame index out of range (" + std::to_string(frameIndex) + ")");
+
+        mDecoders[mFrameSegment[frameIndex]]->loadFrame(mFrameList[frameIndex], outData, outMetadata);
+    }
+
+    void SegmentedDecoder::loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata) {
+        decoderFor(timestamp).loadFrame(timestamp, outData, outMetadata);
+    }
+
+    void SegmentedDecoder::loadFramePayload(const Timestamp timestamp, std::vector<uint8_t>& outPayload, std::vector<uint8_t>& outMetadataJson) {
+        decoderFor(timestamp).loadFramePayload(timestamp, outPayload, outMetadataJson);
+    }
+
+    void SegmentedDecoder::loadAudio(std::vector<AudioChunk>& outAudioChunks) {
+        outAudioChunks.clear();
+
+        for(const auto& decoder : mDecoders) {
+            std::vector<AudioChunk> chunks;
+            decoder->loadAudio(chunks);
+
+            outAudioChunks.insert(outAudioChunks.end(),
+                std::make_move_iterator(chunks.begin()), std::make_move_iterator(chunks.end()));
+        }
+    }
+
+    int64_t SegmentedDecoder::audioStartTimestampMs() const {
+        return mDecoders.front()->audioStartTimestampMs();
+    }
+} // namespace motioncam
@@ -0,0 +1,147 @@
+#include <motioncam/SharedFrame.hpp>
+
+#if !defined(_WIN32)
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace motioncam {
+
+    SharedFrameWriter::SharedFrameWriter(const std::string& name) : mName(name) {
+        mFd = shm_open(mName.c_str(), O_CREAT | O_RDWR, 0600);
+
+        if(mFd < 0)
+            throw IOException("Failed to create shared memory segment " + mName);
+    }
+
+    SharedFrameWriter::~SharedFrameWriter() {
+        if(mMapped)
+            munmap(mMapped, mMappedBytes);
+
+        if(mFd >= 0) {
+            close(mFd);
+            shm_unlink(mName.c_str());
+        }
+    }
+
+    void SharedFrameWriter::resize(size_t pixelBytes) {
+        const size_t total = sizeof(SharedFrameHeader) + pixelBytes;
+
+        if(mMapped) {
+            munmap(mMapped, mMappedBytes);
+            mMapped = nullptr;
+        }
+
+        if(ftruncate(mFd, static_cast<off_t>(total)) != 0)
+            throw IOException("Failed to size shared memory segment " + mName);
+
+        void* mapped = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+
+        if(mapped == MAP_FAILED)
+            throw IOException("Failed to map shared memory segment " + mName);
+
+        mMapped = static_cast<uint8_t*>(mapped);
+        mMappedBytes = total;
+
+        std::memset(mMapped, 0, sizeof(SharedFrameHeader));
+    }
+
+    void SharedFrameWriter::write(Decoder& decoder, const Timestamp timestamp) {
+        FrameInfo info{};
+
+        // Steady state: decode straight into the mapped pixels, no staging
+        // buffer anywhere
+        if(mMapped) {
+            uint16_t* pixels = reinterpret_cast<uint16_t*>(mMapped + sizeof(SharedFrameHeader));
+            const size_t capacity = (mMappedBytes - sizeof(SharedFrameHeader)) / sizeof(uint16_t);
+
+            const auto result = decoder.tryLoadFrame(timestamp, pixels, capacity);
+
+            if(result.ok())
+                info = result.value();
+        }
+
+        // First frame, a larger frame than the segment holds, or a decode
+        // failure worth a real exception: decode normally, then grow the
+        // segment and copy once
+        if(info.width == 0) {
+            std::vector<uint16_t> data;
+            nlohmann::json metadata;
+
+            decoder.loadFrame(timestamp, data, metadata);
+
+            resize(data.size() * sizeof(uint16_t));
+
+            std::memcpy(mMapped + sizeof(SharedFrameHeader), data.data(), data.size() * sizeof(uint16_t));
+
+            info.timestamp = timestamp;
+            info.width = metadata["width"];
+            info.height = metadata["height"];
+        }
+
+        // Publish the header after the pixels; a consumer that reads a
+        // frameCounter and sees it unchanged after reading the pixels got a
+        // complete frame
+        SharedFrameHeader header{};
+
+        header.magic = SharedFrameHeader::MAGIC;
+        header.version = SharedFrameHeader::VERSION;
+        header.timestamp = info.timestamp;
+        header.width = info.width;
+        header.height = info.height;
+        header.cfaLayout = static_cast<int32_t>(decoder.getTypedContainerMetadata().sensorArrangement);
+
+        std::memcpy(mMapped, &header, sizeof(SharedFrameHeader));
+
+        std::atomic_thread_fence(std::memory_order_release);
+
+        mFrameCounter++;
+        std::memcpy(mMapped + offsetof(SharedFrameHeader, frameCounter), &mFrameCounter, sizeof(mFrameCounter));
+    }
+
+    SharedFrameView::SharedFrameView(const std::string& name) {
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+        if(fd < 0)
+            throw IOException("Failed to open shared memory segment " + name);
+
+        struct stat st{};
+
+        if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SharedFrameHeader)) {
+            close(fd);
+            throw IOException("Invalid shared memory segment " + name);
+        }
+
+        void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+
+        close(fd);
+
+        if(mapped == MAP_FAILED)
+            throw IOException("Failed to map shared memory segment " + name);
+
+        mMapped = static_cast<uint8_t*>(mapped);
+        mMappedBytes = static_cast<size_t>(st.st_size);
+    }
+
+    SharedFrameView::~SharedFrameView() {
+        if(mMapped)
+            munmap(mMapped, mMappedBytes);
+    }
+
+    const SharedFrameHeader& SharedFrameView::header() const {
+        return *reinterpret_cast<const SharedFrameHeader*>(mMapped);
+    }
+
+    const uint16_t* SharedFrameView::data() const {
+        return reinterpret_cast<const uint16_t*>(mMapped + sizeof(SharedFrameHeader));
+    }
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/Reader.hpp>
+#include <motioncam/Decoder.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+    #define FSEEK _fseeki64
+    #define FTELL _ftelli64
+#else
+    #include <sys/stat.h>
+
+    #define FSEEK fseeko
+    #define FTELL ftello
+#endif
+
+namespace motioncam {
+
+    namespace {
+        // Registry of live caches. Entries hold weak references, so a
+        // cache is created on the first open of a file and disappears
+        // with its last reader; a later open starts cold again.
+        std::mutex registryMutex;
+        std::unordered_map<std::string, std::weak_ptr<SharedBlockCache>> registry;
+
+        // The file's identity: device and inode where the platform gives
+        // them, so two paths to the same file share one cache. Falls back
+        // to the path itself.
+        std::string fileKey(const std::string& path) {
+#if !defined(_WIN32)
+            struct stat st{};
+
+            if(::stat(path.c_str(), &st) == 0)
+                return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino);
+#endif
+            return path;
+        }
+    }
+
+    std::shared_ptr<SharedBlockCache> SharedBlockCache::acquire(const std::string& path) {
+        const std::string key = fileKey(path);
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+
+        auto it = registry.find(key);
+
+        if(it != registry.end()) {
+            if(auto cache = it->second.lock())
+                return cache;
+        }
+
+        FILE* file = std::fopen(path.c_str(), "rb");
+
+        if(!file)
+            throw IOException("Failed to open " + path);
+
+        if(FSEEK(file, 0, SEEK_END) != 0) {
+            std::fclose(file);
+            throw IOException("Failed to open " + path);
+        }
+
+        const int64_t size = FTELL(file);
+
+        std::shared_ptr<SharedBlockCache> cache(
+            new SharedBlockCache(file, size, DEFAULT_BLOCK_SIZE, DEFAULT_CACHE_BYTES));
+
+        registry[key] = cache;
+
+        return cache;
+    }
+
+    SharedBlockCache::SharedBlockCache(FILE* file, int64_t size, size_t blockSize, size_t cacheBytes) :
+        mFile(file), mSize(size), mBlockSize(blockSize), mCacheBytes(cacheBytes)
+    {
+    }
+
+    SharedBlockCache::~SharedBlockCache() {
+        std::fclose(mFile);
+    }
+
+    int64_t SharedBlockCache::size() const {
+        return mSize;
+    }
+
+    const SharedBlockCache::Block& SharedBlockCache::getBlock(int64_t block, std::unique_lock<std::mutex>& lock) {
+        while(true) {
+            auto it = mBlockIndex.find(block);
+
+            if(it != mBlockIndex.end()) {
+                if(!it->second->ready) {
+                    // Another decoder is reading this block; wait for it
+                    // rather than issuing the same read again
+                    mLoaded.wait(lock);
+                    continue;
+                }
+
+                mBlocks.splice(mBlocks.begin(), mBlocks, it->second);
+
+                return mBlocks.front();
+            }
+
+            // First caller: publish a loading placeholder, then read the
+            // block with the cache unlocked so other blocks stay available
+            mBlocks.push_front(Block{ block });
+            mBlockIndex[block] = mBlocks.begin();
+
+            const int64_t begin = block * static_cast<int64_t>(mBlockSize);
+            const size_t want = static_cast<size_t>(std::min<int64_t>(mBlockSize, std::max<int64_t>(0, mSize - begin)));
+
+            std::vector<uint8_t> data(want);
+
+            lock.unlock();
+
+            size_t got = 0;
+
+            {
+                std::lock_guard<std::mutex> fileLock(mFileMutex);
+
+                if(want > 0 && FSEEK(mFile, begin, SEEK_SET) == 0)
+                    got = std::fread(data.data(), 1, want, mFile);
+            }
+
+            data.resize(got);
+
+            lock.lock();
+
+            auto placed = mBlockIndex.find(block);
+
+            placed->second->data = std::move(data);
+            placed->second->ready = true;
+
+            mBytes += placed->second->data.size();
+
+            // Trim least recently used blocks over budget; placeholders
+            // mid-load are pinned
+            auto victim = mBlocks.end();
+
+            while(mBytes > mCacheBytes && victim != mBlocks.begin()) {
+                --victim;
+
+                if(!victim->ready || victim->index == block)
+                    continue;
+
+                mBytes -= victim->data.size();
+                mBlockIndex.erase(victim->index);
+                victim = mBlocks.erase(victim);
+            }
+
+            mLoaded.notify_all();
+
+            return *placed->second;
+        }
+    }
+
+    size_t SharedBlockCache::readAt(int64_t offset, size_t len, void* dst) {
+        if(offset < 0 || offset >= mSize || len == 0)
+            return 0;
+
+        len = static_cast<size_t>(std::min<int64_t>(len, mSize - offset));
+
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        size_t copied = 0;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        while(copied < len) {
+            const int64_t pos = offset + static_cast<int64_t>(copied);
+            const int64_t blockIndex = pos / static_cast<int64_t>(mBlockSize);
+            const size_t within = static_cast<size_t>(pos % static_cast<int64_t>(mBlockSize));
+
+            const Block& block = getBlock(blockIndex, lock);
+
+            if(within >= block.data.size())
+                break;
+
+            const size_t take = std::min(len - copied, block.data.size() - within);
+
+            std::memcpy(out + copied, block.data.data() + within, take);
+
+            copied += take;
+        }
+
+        return copied;
+    }
+
+    //
+    // SharedFileReader
+    //
+
+    SharedFileReader::SharedFileReader(const std::string& path) :
+        mCache(SharedBlockCache::acquire(path)), mPos(0)
+    {
+    }
+
+    void SharedFileReader::read(void* data, size_t size, size_t items) {
+        const size_t total = size * items;
+
+        if(mCache->readAt(mPos, total, data) != total)
+            throw IOException("Failed to read data");
+
+        mPos += static_cast<int64_t>(total);
+    }
+
+    bool SharedFileReader::tryRead(void* data, size_t size) {
+        if(mCache->readAt(mPos, size, data) != size)
+            return false;
+
+        mPos += static_cast<int64_t>(size);
+
+        return true;
+    }
+
+    bool SharedFileReader::seek(int64_t offset, int origin) {
+        int64_t pos;
+
+        switch(origin) {
+            case SEEK_SET:
+                pos = offset;
+                break;
+
+            case SEEK_CUR:
+                pos = mPos + offset;
+                break;
+
+            case SEEK_END:
+                pos = mCache->size() + offset;
+                break;
+
+            default:
+                return false;
+        }
+
+        if(pos < 0)
+            return false;
+
+        mPos = pos;
+
+        return true;
+    }
+
+    int64_t SharedFileReader::size() {
+        return mCache->size();
+    }
+
+} // namespace motioncam
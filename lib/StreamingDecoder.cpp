@@ -0,0 +1,198 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/StreamingDecoder.hpp>
+#include <motioncam/Container.hpp>
+
+#include <cstring>
+
+namespace motioncam {
+    namespace {
+        constexpr int STREAMING_COMPRESSION_TYPE = 7;
+    }
+
+    StreamingDecoder::StreamingDecoder(FILE* stream) : mStream(stream) {
+        if(!mStream)
+            throw IOException("Invalid stream");
+
+        Header header{};
+
+        if(!readExact(&header, sizeof(Header)))
+            throw IOException("Invalid container header");
+
+        if((header.version != CONTAINER_VERSION) && (header.version != CONTAINER_VERSION_4))
+            throw IOException("Invalid container version");
+
+        if(std::memcmp(header.ident, CONTAINER_ID, sizeof(CONTAINER_ID)) != 0)
+            throw IOException("Invalid header id");
+
+        // The camera metadata item immediately follows the header
+        Item metadataItem{};
+
+        if(!readExact(&metadataItem, sizeof(Item)) || metadataItem.type != Type::METADATA)
+            throw IOException("Invalid camera metadata");
+
+        mMetadataJson.resize(metadataItem.size);
+
+        if(!readExact(mMetadataJson.data(), mMetadataJson.size()))
+            throw IOException("Invalid camera metadata");
+
+        mMetadata = nlohmann::json::parse(mMetadataJson.begin(), mMetadataJson.end());
+    }
+
+    const nlohmann::json& StreamingDecoder::getContainerMetadata() const {
+        return mMetadata;
+    }
+
+    void StreamingDecoder::setAudioCallback(AudioCallback callback) {
+        mAudioCallback = std::move(callback);
+    }
+
+    bool StreamingDecoder::readExact(void* data, size_t size) {
+        return fread(data, 1, size, mStream) == size;
+    }
+
+    void StreamingDecoder::skip(size_t size) {
+        // The stream can't seek, so skipped items are read and discarded
+        // through a bounded scratch buffer
+        char scratch[16384];
+
+        while(size > 0) {
+            const size_t chunk = size < sizeof(scratch) ? size : sizeof(scratch);
+
+            if(fread(scratch, 1, chunk, mStream) != chunk) {
+                mEnded = true;
+                return;
+            }
+
+            size -= chunk;
+        }
+    }
+
+    void StreamingDecoder::flushPendingAudio(Timestamp timestamp) {
+        if(!mAudioPending)
+            return;
+
+        mAudioPending = false;
+
+        if(mAudioCallback)
+            mAudioCallback(timestamp, mAudioSamples.data(), mAudioSamples.size());
+    }
+
+    bool StreamingDecoder::nextFrame(Timestamp& outTimestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata) {
+        if(mEnded)
+            return false;
+
+        while(true) {
+            Item item{};
+
+            // A clean end of stream simply stops delivering frames
+            if(!readExact(&item, sizeof(Item))) {
+                mEnded = true;
+                flushPendingAudio(-1);
+                return false;
+            }
+
+            if(item.type == Type::BUFFER) {
+                mPayload.resize(item.size);
+
+                if(!readExact(mPayload.data(), mPayload.size()))
+                    throw IOException("Truncated frame payload");
+
+                // The frame's metadata item follows its payload
+                Item frameMetadataItem{};
+
+                if(!readExact(&frameMetadataItem, sizeof(Item)) || frameMetadataItem.type != Type::METADATA)
+                    throw IOException("Invalid frame metadata");
+
+                mMetadataJson.resize(frameMetadataItem.size);
+
+                if(!readExact(mMetadataJson.data(), mMetadataJson.size()))
+                    throw IOException("Truncated frame metadata");
+
+                outMetadata = nlohmann::json::parse(mMetadataJson.begin(), mMetadataJson.end());
+
+                const int width = outMetadata["width"];
+                const int height = outMetadata["height"];
+                const int compressionType = outMetadata["compressionType"];
+
+                if(compressionType != STREAMING_COMPRESSION_TYPE)
+                    throw IOException("Invalid compression type");
+
+                outTimestamp = outMetadata.value("timestamp", static_cast<Timestamp>(mNumFrames));
+
+                flushPendingAudio(outTimestamp);
+
+                // Sized as Decoder::decodePayload sizes it, with slack for
+                // the decode's 4-row output granularity
+                outData.resize(sizeof(uint16_t) * static_cast<size_t>(width) * height);
+
+                if(raw::Decode(outData.data(), width, height, mPayload.data(), mPayload.size(), mDecodeContext) <= 0)
+                    throw IOException("Failed to uncompress frame");
+
+                mNumFrames++;
+
+                return true;
+            }
+            else if(item.type == Type::AUDIO_DATA) {
+                // The chunk's timestamp arrives in the next item; hold the
+                // samples until it does
+                flushPendingAudio(-1);
+
+                if(mAudioCallback) {
+                    mAudioSamples.resize(item.size / sizeof(int16_t));
+
+                    if(!readExact(mAudioSamples.data(), item.size))
+                        throw IOException("Truncated audio data");
+
+                    mAudioPending = true;
+                }
+                else {
+                    skip(item.size);
+                }
+            }
+            else if(item.type == Type::AUDIO_DATA_METADATA && mAudioPending) {
+                if(item.size < sizeof(AudioMetadata))
+                    throw IOException("Invalid audio metadata");
+
+                AudioMetadata audioMetadata{};
+
+                if(!readExact(&audioMetadata, sizeof(AudioMetadata)))
+                    throw IOException("Truncated audio metadata");
+
+                skip(item.size - sizeof(AudioMetadata));
+
+                flushPendingAudio(audioMetadata.timestampNs);
+            }
+            else if(item.type == Type::METADATA || item.type == Type::AUDIO_DATA_METADATA || item.type == Type::PADDING || item.type == Type::BUFFER_INDEX_DATA) {
+                skip(item.size);
+            }
+            else {
+                // The trailing index; no frames follow it
+                mEnded = true;
+                flushPendingAudio(-1);
+                return false;
+            }
+
+            if(mEnded)
+                return false;
+        }
+    }
+
+    size_t StreamingDecoder::numFrames() const {
+        return mNumFrames;
+    }
+} // namespace motioncam
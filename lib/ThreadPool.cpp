@@ -0,0 +1,317 @@
+#include <motioncam/Numa.hpp>
+#include <motioncam/ThreadPool.hpp>
+
+namespace motioncam {
+    namespace {
+        // Identifies the pool and worker index of the current thread, so
+        // tasks spawned from a worker land in that worker's own queue and
+        // TaskGroup::wait can help instead of blocking a worker.
+        thread_local ThreadPool* tlsPool = nullptr;
+        thread_local size_t tlsWorker = 0;
+
+        // Queue scan order by worker class. Performance workers keep the
+        // strict priority order; efficiency workers pull I/O work - reads
+        // and metadata parsing - ahead of the interactive lane, keeping
+        // the fast cores for the decode kernels on hybrid machines.
+        const int kScanOrder[2][4] = {
+            { static_cast<int>(Priority::INTERACTIVE), static_cast<int>(Priority::IO),
+              static_cast<int>(Priority::DECODE), static_cast<int>(Priority::EXPORT) },
+            { static_cast<int>(Priority::IO), static_cast<int>(Priority::INTERACTIVE),
+              static_cast<int>(Priority::DECODE), static_cast<int>(Priority::EXPORT) },
+        };
+    }
+
+    ThreadPool& ThreadPool::shared() {
+        // Sized to the hardware concurrency; intentionally leaked at exit
+        // like any function-local static, so tasks running late in shutdown
+        // don't race its destruction
+        static ThreadPool* pool = new ThreadPool();
+
+        return *pool;
+    }
+
+    ThreadPool::ThreadPool(size_t numThreads) : mNextWorker(0), mNumTasks(0), mNumActive(0), mShutdown(false) {
+        if(numThreads == 0)
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        mWorkers.reserve(numThreads);
+
+        // Contiguous blocks of workers per NUMA node, so each socket runs
+        // about an equal share of the pool (single block on one-node or
+        // non-NUMA builds)
+        const int numNodes = numa::NumNodes();
+
+        for(size_t i = 0; i < numThreads; i++) {
+            mWorkers.emplace_back(new Worker());
+            mWorkers.back()->node = static_cast<int>((i * numNodes) / numThreads);
+        }
+
+        // On a hybrid machine the trailing workers take the efficiency
+        // cores, one per core, leaving at least one performance worker
+        const size_t numEfficiency = static_cast<size_t>(std::max(0, cores::NumEfficiencyCores()));
+
+        if(numEfficiency > 0 && numThreads > 1) {
+            const size_t efficiencyWorkers = std::min(numEfficiency, numThreads - 1);
+
+            for(size_t i = numThreads - efficiencyWorkers; i < numThreads; i++)
+                mWorkers[i]->efficiency = true;
+        }
+
+        mThreads.reserve(numThreads);
+
+        for(size_t i = 0; i < numThreads; i++)
+            mThreads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mShutdown = true;
+        }
+
+        mTaskAvailable.notify_all();
+
+        for(auto& t : mThreads)
+            t.join();
+    }
+
+    void ThreadPool::enqueue(Priority priority, std::function<void()> task) {
+        // Tasks spawned from a worker stay on that worker's queue; external
+        // submissions are spread round robin and rebalanced by stealing
+        const size_t target = (tlsPool == this)
+            ? tlsWorker
+            : mNextWorker.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+
+        if(priority == Priority::INTERACTIVE)
+            mInteractivePending.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::unique_lock<std::mutex> lock(mWorkers[target]->mutex);
+            mWorkers[target]->queues[static_cast<int>(priority)].push_back(std::move(task));
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            ++mNumTasks;
+        }
+
+        mTaskAvailable.notify_one();
+    }
+
+    bool ThreadPool::takeTask(size_t self, std::function<void()>& outTask) {
+        // Own queues first, newest task first, so nested work runs while
+        // its inputs are still in cache
+        {
+            Worker& own = *mWorkers[self];
+            const int* order = kScanOrder[own.efficiency ? 1 : 0];
+            std::unique_lock<std::mutex> lock(own.mutex);
+
+            for(int o = 0; o < NUM_PRIORITIES; o++) {
+                const int p = order[o];
+
+                if(!own.queues[p].empty()) {
+                    outTask = std::move(own.queues[p].back());
+                    own.queues[p].pop_back();
+
+                    if(p == static_cast<int>(Priority::INTERACTIVE))
+                        mInteractivePending.fetch_sub(1, std::memory_order_relaxed);
+
+                    return true;
+                }
+            }
+        }
+
+        // Steal the oldest task from another worker, checking every worker
+        // for higher-priority work before any lower, and workers on the
+        // same NUMA node before crossing the interconnect - a task's input
+        // buffers usually sit on the node that queued it
+        const int ownNode = mWorkers[self]->node;
+        const int* order = kScanOrder[mWorkers[self]->efficiency ? 1 : 0];
+
+        for(int pass = 0; pass < 2; pass++) {
+            for(int o = 0; o < NUM_PRIORITIES; o++) {
+                const int p = order[o];
+
+                for(size_t i = 1; i < mWorkers.size(); i++) {
+                    Worker& victim = *mWorkers[(self + i) % mWorkers.size()];
+
+                    if((victim.node == ownNode) != (pass == 0))
+                        continue;
+
+                    std::unique_lock<std::mutex> lock(victim.mutex);
+
+                    if(!victim.queues[p].empty()) {
+                        outTask = std::move(victim.queues[p].front());
+                        victim.queues[p].pop_front();
+
+                        if(p == static_cast<int>(Priority::INTERACTIVE))
+                            mInteractivePending.fetch_sub(1, std::memory_order_relaxed);
+
+                        return true;
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+
+    bool ThreadPool::takeInteractiveTask(std::function<void()>& outTask) {
+        // The relaxed counter keeps the common no-work case to one load
+        if(mInteractivePending.load(std::memory_order_relaxed) == 0)
+            return false;
+
+        const size_t self = (tlsPool == this) ? tlsWorker : 0;
+
+        for(size_t i = 0; i < mWorkers.size(); i++) {
+            Worker& worker = *mWorkers[(self + i) % mWorkers.size()];
+            std::unique_lock<std::mutex> lock(worker.mutex);
+
+            auto& queue = worker.queues[static_cast<int>(Priority::INTERACTIVE)];
+
+            if(!queue.empty()) {
+                outTask = std::move(queue.front());
+                queue.pop_front();
+
+                mInteractivePending.fetch_sub(1, std::memory_order_relaxed);
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool ThreadPool::assistInteractive() {
+        std::function<void()> task;
+
+        if(!takeInteractiveTask(task))
+            return false;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            --mNumTasks;
+            ++mNumActive;
+        }
+
+        task();
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            --mNumActive;
+
+            if(mNumTasks == 0 && mNumActive == 0)
+                mAllDone.notify_all();
+        }
+
+        return true;
+    }
+
+    bool ThreadPool::runOneTask() {
+        std::function<void()> task;
+
+        const size_t self = (tlsPool == this) ? tlsWorker : 0;
+
+        if(!takeTask(self, task))
+            return false;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            --mNumTasks;
+            ++mNumActive;
+        }
+
+        task();
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            --mNumActive;
+
+            if(mNumTasks == 0 && mNumActive == 0)
+                mAllDone.notify_all();
+        }
+
+        return true;
+    }
+
+    void ThreadPool::waitAll() {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        mAllDone.wait(lock, [this] {
+            return mNumTasks == 0 && mNumActive == 0;
+        });
+    }
+
+    void ThreadPool::workerLoop(size_t self) {
+        tlsPool = this;
+        tlsWorker = self;
+
+        // Pin to the worker's node and prefer its memory; a no-op on
+        // single-node machines and non-NUMA builds
+        numa::BindCurrentThread(mWorkers[self]->node);
+
+        // And to the worker's core class; a no-op on homogeneous machines
+        cores::BindCurrentThread(mWorkers[self]->efficiency);
+
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+
+                mTaskAvailable.wait(lock, [this] {
+                    return mShutdown || mNumTasks > 0;
+                });
+
+                if(mShutdown && mNumTasks == 0)
+                    return;
+            }
+
+            // A queued task can be taken by another thread between the
+            // wake-up and the dequeue; just go back to waiting
+            runOneTask();
+        }
+    }
+
+    void TaskGroup::run(ThreadPool& pool, Priority priority, std::function<void()> task) {
+        mPool = &pool;
+
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            ++mOutstanding;
+        }
+
+        pool.enqueue(priority, [this, task = std::move(task)] {
+            task();
+
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            if(--mOutstanding == 0)
+                mDone.notify_all();
+        });
+    }
+
+    void TaskGroup::wait() {
+        while(true) {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+
+                if(mOutstanding == 0)
+                    return;
+            }
+
+            // On a worker thread, help drain the pool instead of blocking it
+            // - this is what makes nested groups safe on a small pool. An
+            // external caller just sleeps; picking up unrelated tasks there
+            // would only delay its wakeup.
+            if(tlsPool == mPool && mPool->runOneTask())
+                continue;
+
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            mDone.wait(lock, [this] {
+                return mOutstanding == 0;
+            });
+
+            return;
+        }
+    }
+} // namespace motioncam
@@ -0,0 +1,111 @@
+#include <motioncam/Trace.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+namespace motioncam {
+    namespace trace {
+
+    std::atomic<bool> gCollecting{false};
+
+    namespace {
+    struct Event {
+        const char* name;
+        int tid;
+        int64_t startUs;
+        int64_t durationUs;
+    };
+
+    std::mutex gMutex;
+    std::vector<Event> gEvents;
+    std::string gPath;
+
+    // Small dense thread ids instead of the platform's opaque ones
+    int threadId() {
+        static std::atomic<int> nextId{1};
+        thread_local int id = nextId.fetch_add(1, std::memory_order_relaxed);
+
+        return id;
+    }
+
+    void writeTrace() {
+        FILE* f = std::fopen(gPath.c_str(), "w");
+        if(!f)
+            return;
+
+        std::fputs("{\"traceEvents\":[", f);
+
+        for(size_t i = 0; i < gEvents.size(); i++) {
+            const Event& e = gEvents[i];
+
+            std::fprintf(f,
+                "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+                i > 0 ? "," : "",
+                e.name,
+                e.tid,
+                static_cast<long long>(e.startUs),
+                static_cast<long long>(e.durationUs));
+        }
+
+        std::fputs("]}\n", f);
+        std::fclose(f);
+    }
+
+    // MOTIONCAM_TRACE=<path> traces the whole process lifetime; the
+    // file is written at exit
+    struct EnvTrace {
+        EnvTrace() {
+            const char* path = std::getenv("MOTIONCAM_TRACE");
+
+            if(path && path[0]) {
+                Begin(path);
+                std::atexit([] { End(); });
+            }
+        }
+    } gEnvTrace;
+    } // namespace
+
+    int64_t NowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Begin(const std::string& path) {
+        std::lock_guard<std::mutex> lock(gMutex);
+
+        gPath = path;
+        gEvents.clear();
+        gEvents.reserve(4096);
+
+        gCollecting.store(true, std::memory_order_relaxed);
+    }
+
+    void End() {
+        std::lock_guard<std::mutex> lock(gMutex);
+
+        if(!gCollecting.load(std::memory_order_relaxed))
+            return;
+
+        gCollecting.store(false, std::memory_order_relaxed);
+
+        writeTrace();
+        gEvents.clear();
+    }
+
+    void EmitSpan(const char* name, int64_t startUs, int64_t durationUs) {
+        const int tid = threadId();
+
+        std::lock_guard<std::mutex> lock(gMutex);
+
+        // A span may finish right as End() runs; drop it
+        if(!gCollecting.load(std::memory_order_relaxed))
+            return;
+
+        gEvents.push_back({name, tid, startUs, durationUs});
+    }
+
+    } // namespace trace
+} // namespace motioncam
@@ -0,0 +1,280 @@
+#if defined(__linux__)
+
+#include <motioncam/Reader.hpp>
+#include <motioncam/Decoder.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace motioncam {
+    namespace {
+        constexpr unsigned QUEUE_DEPTH = 64;
+
+        int ioUringSetup(unsigned entries, io_uring_params* p) {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+        }
+
+        int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+            return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+        }
+    }
+
+    // Minimal raw-syscall ring, no liburing dependency
+    struct UringReader::Ring {
+        int fd{-1};
+        void* sqRing{MAP_FAILED};
+        void* cqRing{MAP_FAILED};
+        io_uring_sqe* sqes{static_cast<io_uring_sqe*>(MAP_FAILED)};
+        size_t sqRingSize{0};
+        size_t cqRingSize{0};
+        bool singleMmap{false};
+
+        unsigned* sqHead{nullptr};
+        unsigned* sqTail{nullptr};
+        unsigned* sqMask{nullptr};
+        unsigned* sqArray{nullptr};
+        unsigned* cqHead{nullptr};
+        unsigned* cqTail{nullptr};
+        unsigned* cqMask{nullptr};
+        io_uring_cqe* cqes{nullptr};
+
+        ~Ring() {
+            if(sqes != MAP_FAILED)
+                munmap(sqes, QUEUE_DEPTH * sizeof(io_uring_sqe));
+
+            if(sqRing != MAP_FAILED)
+                munmap(sqRing, sqRingSize);
+
+            if(!singleMmap && cqRing != MAP_FAILED)
+                munmap(cqRing, cqRingSize);
+
+            if(fd >= 0)
+                close(fd);
+        }
+    };
+
+    UringReader::UringReader(const std::string& path) : mFd(-1), mPos(0), mSize(0) {
+        mFd = ::open(path.c_str(), O_RDONLY);
+        if(mFd < 0)
+            throw IOException("Failed to open " + path);
+
+        struct stat st{};
+
+        if(fstat(mFd, &st) != 0) {
+            ::close(mFd);
+            throw IOException("Failed to get size of " + path);
+        }
+
+        mSize = st.st_size;
+
+        auto ring = std::unique_ptr<Ring>(new Ring());
+
+        io_uring_params params{};
+
+        ring->fd = ioUringSetup(QUEUE_DEPTH, &params);
+        if(ring->fd < 0) {
+            ::close(mFd);
+            throw IOException("io_uring not available");
+        }
+
+        ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        ring->singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+        if(ring->singleMmap) {
+            ring->sqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+            ring->cqRingSize = ring->sqRingSize;
+        }
+
+        ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+        if(ring->sqRing == MAP_FAILED) {
+            ::close(mFd);
+            throw IOException("Failed to map io_uring queues");
+        }
+
+        if(ring->singleMmap) {
+            ring->cqRing = ring->sqRing;
+        }
+        else {
+            ring->cqRing = mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+            if(ring->cqRing == MAP_FAILED) {
+                ::close(mFd);
+                throw IOException("Failed to map io_uring queues");
+            }
+        }
+
+        ring->sqes = static_cast<io_uring_sqe*>(
+            mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES));
+
+        if(ring->sqes == MAP_FAILED) {
+            ::close(mFd);
+            throw IOException("Failed to map io_uring queues");
+        }
+
+        auto* sq = static_cast<uint8_t*>(ring->sqRing);
+        auto* cq = static_cast<uint8_t*>(ring->cqRing);
+
+        ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        mRing = std::move(ring);
+    }
+
+    UringReader::~UringReader() {
+        if(mFd >= 0)
+            ::close(mFd);
+    }
+
+    void UringReader::read(void* data, size_t size, size_t items) {
+        if(!tryRead(data, size * items))
+            throw IOException("Failed to read data");
+    }
+
+    bool UringReader::tryRead(void* data, size_t size) {
+        uint8_t* dst = static_cast<uint8_t*>(data);
+        size_t remaining = size;
+
+        while(remaining > 0) {
+            ssize_t n = pread(mFd, dst, remaining, mPos);
+
+            if(n <= 0)
+                return false;
+
+            dst += n;
+            mPos += n;
+            remaining -= n;
+        }
+
+        return true;
+    }
+
+    int64_t UringReader::size() {
+        return mSize;
+    }
+
+    void UringReader::advise(int64_t offset, size_t len, Advice advice) {
+        posix_fadvise(mFd, offset, static_cast<off_t>(len),
+            advice == Advice::WILL_NEED ? POSIX_FADV_WILLNEED
+                : advice == Advice::SEQUENTIAL ? POSIX_FADV_SEQUENTIAL
+                : POSIX_FADV_DONTNEED);
+    }
+
+    bool UringReader::seek(int64_t offset, int origin) {
+        int64_t newPos;
+
+        switch(origin) {
+            case SEEK_SET:
+                newPos = offset;
+                break;
+            case SEEK_CUR:
+                newPos = mPos + offset;
+                break;
+            case SEEK_END:
+                newPos = mSize + offset;
+                break;
+            default:
+                return false;
+        }
+
+        if(newPos < 0)
+            return false;
+
+        mPos = newPos;
+
+        return true;
+    }
+
+    void UringReader::readBatch(const std::vector<ReadRequest>& requests) {
+        // Per-request progress so short reads are resubmitted for the remainder
+        std::vector<size_t> completed(requests.size(), 0);
+
+        size_t next = 0;         // next request to submit
+        size_t inFlight = 0;
+        size_t finished = 0;
+        unsigned pendingSubmit = 0; // SQEs appended since the last io_uring_enter
+
+        auto submitOne = [&](size_t idx) {
+            unsigned tail = __atomic_load_n(mRing->sqTail, __ATOMIC_RELAXED);
+            unsigned slot = tail & *mRing->sqMask;
+
+            io_uring_sqe& sqe = mRing->sqes[slot];
+            std::memset(&sqe, 0, sizeof(sqe));
+
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = mFd;
+            sqe.addr = reinterpret_cast<uint64_t>(static_cast<uint8_t*>(requests[idx].dst) + completed[idx]);
+            sqe.len = static_cast<uint32_t>(requests[idx].len - completed[idx]);
+            sqe.off = static_cast<uint64_t>(requests[idx].offset) + completed[idx];
+            sqe.user_data = idx;
+
+            mRing->sqArray[slot] = slot;
+            __atomic_store_n(mRing->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+            ++inFlight;
+            ++pendingSubmit;
+        };
+
+        while(finished < requests.size()) {
+            while(next < requests.size() && inFlight < QUEUE_DEPTH) {
+                if(requests[next].len == 0) {
+                    ++finished;
+                    ++next;
+                    continue;
+                }
+
+                submitOne(next++);
+            }
+
+            if(finished == requests.size())
+                break;
+
+            if(ioUringEnter(mRing->fd, pendingSubmit, 1, IORING_ENTER_GETEVENTS) < 0)
+                throw IOException("io_uring_enter failed");
+
+            pendingSubmit = 0;
+
+            // Reap completions
+            unsigned head = __atomic_load_n(mRing->cqHead, __ATOMIC_RELAXED);
+
+            while(head != __atomic_load_n(mRing->cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& cqe = mRing->cqes[head & *mRing->cqMask];
+
+                const size_t idx = static_cast<size_t>(cqe.user_data);
+                --inFlight;
+
+                if(cqe.res <= 0) {
+                    __atomic_store_n(mRing->cqHead, head + 1, __ATOMIC_RELEASE);
+                    throw IOException("Failed to read data");
+                }
+
+                completed[idx] += static_cast<size_t>(cqe.res);
+
+                if(completed[idx] >= requests[idx].len)
+                    ++finished;
+                else
+                    submitOne(idx);    // short read, go again for the rest
+
+                ++head;
+                __atomic_store_n(mRing->cqHead, head, __ATOMIC_RELEASE);
+            }
+        }
+    }
+
+} // namespace motioncam
+
+#endif // __linux__
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <motioncam/Writer.hpp>
+#include <motioncam/Checksum.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace motioncam {
+    namespace {
+        // stdio buffer size; large enough that frame payloads reach the
+        // filesystem in few writes
+        const size_t IO_BUFFER_SIZE = 1024*1024;
+    }
+
+    Writer::Writer(const std::string& path, const nlohmann::json& containerMetadata, const uint8_t version) :
+        mPath(path),
+        mFile(nullptr),
+        mPos(0),
+        mVersion(version),
+        mChecksums(false),
+        mFinished(false),
+        mAudioStartTimestampMs(0)
+    {
+        if(version != CONTAINER_VERSION && version != CONTAINER_VERSION_4)
+            throw IOException("Unsupported container version");
+
+        mFile = fopen(path.c_str(), "wb");
+
+        if(!mFile)
+            throw IOException("Failed to create " + path);
+
+        mIoBuffer.resize(IO_BUFFER_SIZE);
+        setvbuf(mFile, mIoBuffer.data(), _IOFBF, mIoBuffer.size());
+
+        Header header{};
+        std::memcpy(header.ident, CONTAINER_ID, sizeof(CONTAINER_ID));
+        header.version = mVersion;
+
+        write(&header, sizeof(Header));
+
+        // The camera metadata item immediately follows the header; Decoder
+        // requires it there
+        const std::string metadata = containerMetadata.dump();
+
+        writeItem(Type::METADATA, static_cast<uint32_t>(metadata.size()));
+        write(metadata.data(), metadata.size());
+    }
+
+    Writer::~Writer() {
+        if(!mFinished) {
+            try {
+                finish();
+            }
+            catch(...) {
+                // Destructor must not throw; use finish() to see failures
+            }
+        }
+
+        if(mFile)
+            fclose(mFile);
+    }
+
+    void Writer::write(const void* data, size_t size) {
+        if(fwrite(data, 1, size, mFile) != size)
+            throw IOException("Failed to write " + mPath);
+
+        mPos += static_cast<int64_t>(size);
+    }
+
+    void Writer::writeItem(const Type type, const uint32_t size) {
+        Item item{type, size};
+        write(&item, sizeof(Item));
+    }
+
+    // Write padding so the next item's payload lands on a PAYLOAD_ALIGNMENT
+    // boundary
+    void Writer::align() {
+        int64_t rem = (mPos + static_cast<int64_t>(sizeof(Item))) % PAYLOAD_ALIGNMENT;
+
+        if(rem == 0)
+            return;
+
+        int64_t needed = PAYLOAD_ALIGNMENT - rem;
+
+        if(needed < static_cast<int64_t>(sizeof(Item)))
+            needed += PAYLOAD_ALIGNMENT;
+
+        const std::vector<uint8_t> zeros(needed - sizeof(Item), 0);
+
+        writeItem(Type::PADDING, static_cast<uint32_t>(zeros.size()));
+        write(zeros.data(), zeros.size());
+    }
+
+    void Writer::enableChecksumIndex() {
+        if(!mOffsets.empty())
+            throw IOException("Checksum index must be enabled before the first frame");
+
+        mChecksums = true;
+    }
+
+    void Writer::writeFrame(
+        const Timestamp timestamp, const uint8_t* payload, const size_t payloadSize, const std::string& metadata)
+    {
+        if(mFinished)
+            throw IOException("Writer is finished");
+
+        if(mVersion == CONTAINER_VERSION_4)
+            align();
+
+        BufferOffsetV4 entry{};
+
+        entry.offset = mPos;
+        entry.timestamp = timestamp;
+        entry.payloadSize = static_cast<uint32_t>(payloadSize);
+        entry.metadataSize = static_cast<uint32_t>(metadata.size());
+
+        mOffsets.push_back(entry);
+
+        if(mChecksums)
+            mChecksumEntries.push_back(ChecksumEntry{ timestamp, Hash64(payload, payloadSize) });
+
+        writeItem(Type::BUFFER, static_cast<uint32_t>(payloadSize));
+        write(payload, payloadSize);
+
+        writeItem(Type::METADATA, static_cast<uint32_t>(metadata.size()));
+        write(metadata.data(), metadata.size());
+    }
+
+    void Writer::writeFrame(
+        const Timestamp timestamp, const std::vector<uint8_t>& payload, const nlohmann::json& metadata)
+    {
+        writeFrame(timestamp, payload.data(), payload.size(), metadata.dump());
+    }
+
+    void Writer::writeAudio(const Timestamp timestampNs, const int16_t* samples, const size_t numSamples) {
+        if(mFinished)
+            throw IOException("Writer is finished");
+
+        mAudioOffsets.push_back(BufferOffset{ mPos, timestampNs });
+
+        writeItem(Type::AUDIO_DATA, static_cast<uint32_t>(numSamples * sizeof(int16_t)));
+        write(samples, numSamples * sizeof(int16_t));
+
+        AudioMetadata metadata{ timestampNs };
+
+        writeItem(Type::AUDIO_DATA_METADATA, sizeof(AudioMetadata));
+        write(&metadata, sizeof(AudioMetadata));
+    }
+
+    void Writer::writeAudio(const AudioChunk& chunk) {
+        writeAudio(chunk.first, chunk.second.data(), chunk.second.size());
+    }
+
+    void Writer::setAudioStartTimestampMs(const int64_t startTimestampMs) {
+        mAudioStartTimestampMs = startTimestampMs;
+    }
+
+    void Writer::finish() {
+        if(mFinished)
+            return;
+
+        mFinished = true;
+
+        // The trailing records in the order the deferred audio walk expects:
+        // checksums (skipped by size), the audio index, then the frame index
+        // data and the BufferIndex as the final bytes of the file, where
+        // Decoder's index read looks for it
+        if(mChecksums && !mChecksumEntries.empty()) {
+            writeItem(Type::CHECKSUM_INDEX,
+                static_cast<uint32_t>(sizeof(ChecksumIndex) + mChecksumEntries.size() * sizeof(ChecksumEntry)));
+
+            ChecksumIndex checksumIndex{};
+
+            checksumIndex.magicNumber = static_cast<int32_t>(INDEX_MAGIC_NUMBER);
+            checksumIndex.numEntries = static_cast<int32_t>(mChecksumEntries.size());
+
+            write(&checksumIndex, sizeof(ChecksumIndex));
+            write(mChecksumEntries.data(), mChecksumEntries.size() * sizeof(ChecksumEntry));
+        }
+
+        if(!mAudioOffsets.empty()) {
+            writeItem(Type::AUDIO_INDEX,
+                static_cast<uint32_t>(sizeof(AudioIndex) + mAudioOffsets.size() * sizeof(BufferOffset)));
+
+            AudioIndex audioIndex{};
+
+            audioIndex.numOffsets = static_cast<int64_t>(mAudioOffsets.size());
+            audioIndex.startTimestampMs = mAudioStartTimestampMs;
+
+            write(&audioIndex, sizeof(AudioIndex));
+            write(mAudioOffsets.data(), mAudioOffsets.size() * sizeof(BufferOffset));
+        }
+
+        std::sort(mOffsets.begin(), mOffsets.end(), [](const BufferOffsetV4& a, const BufferOffsetV4& b) {
+            return a.timestamp < b.timestamp;
+        });
+
+        int64_t indexDataOffset = 0;
+
+        if(mVersion == CONTAINER_VERSION_4) {
+            writeItem(Type::BUFFER_INDEX_DATA,
+                static_cast<uint32_t>(mOffsets.size() * sizeof(BufferOffsetV4)));
+
+            indexDataOffset = mPos;
+
+            write(mOffsets.data(), mOffsets.size() * sizeof(BufferOffsetV4));
+        }
+        else {
+            std::vector<BufferOffset> offsets(mOffsets.size());
+
+            for(size_t i = 0; i < mOffsets.size(); i++)
+                offsets[i] = BufferOffset{ mOffsets[i].offset, mOffsets[i].timestamp };
+
+            writeItem(Type::BUFFER_INDEX_DATA,
+                static_cast<uint32_t>(offsets.size() * sizeof(BufferOffset)));
+
+            indexDataOffset = mPos;
+
+            write(offsets.data(), offsets.size() * sizeof(BufferOffset));
+        }
+
+        writeItem(Type::BUFFER_INDEX, sizeof(BufferIndex));
+
+        BufferIndex index{};
+
+        index.magicNumber = static_cast<int32_t>(INDEX_MAGIC_NUMBER);
+        index.numOffsets = static_cast<int32_t>(mOffsets.size());
+        index.indexDataOffset = indexDataOffset;
+
+        write(&index, sizeof(BufferIndex));
+
+        const bool flushed = fflush(mFile) == 0;
+        const bool closed = fclose(mFile) == 0;
+
+        mFile = nullptr;
+
+        if(!flushed || !closed)
+            throw IOException("Failed to write " + mPath);
+    }
+}
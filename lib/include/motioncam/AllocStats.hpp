@@ -0,0 +1,45 @@
+#ifndef AllocStats_hpp
+#define AllocStats_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Allocation counting for the decode hot paths. The library keeps
+// re-growing scratch buffers precisely so that steady-state frame loads
+// allocate nothing; these counters let the bench suite assert that
+// instead of trusting it (see tools/alloc_bench.cpp, which fails its run
+// when a steady-state loadFrame touches the heap).
+//
+// The library itself never overrides the global allocator - the harness
+// replaces ::operator new in its own binary and forwards to Record(), so
+// normal builds carry nothing but this inert counter. Counters are
+// per-thread: a phase measured on one thread is not polluted by pool
+// workers. Counting stays off - Record() costs one relaxed atomic load -
+// until enabled.
+namespace motioncam {
+    namespace allocstats {
+        // Set while counting is enabled. Read by Record().
+        extern std::atomic<bool> gCounting;
+
+        struct Snapshot {
+            uint64_t numAllocations;
+            uint64_t bytesAllocated;
+        };
+
+        void Enable();
+        void Disable();
+
+        // Count one allocation on the calling thread, to be called from a
+        // harness's replaced operator new
+        void Record(size_t bytes);
+
+        // Counters of the calling thread
+        Snapshot Current();
+
+        // Allocations on the calling thread since the snapshot was taken
+        Snapshot Since(const Snapshot& start);
+    }
+}
+
+#endif /* AllocStats_hpp */
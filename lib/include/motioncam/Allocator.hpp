@@ -0,0 +1,81 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef Allocator_hpp
+#define Allocator_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace motioncam {
+    // Alignment of every buffer obtained through allocateAligned(),
+    // matching the widest SIMD loads in the decode kernels
+    constexpr size_t ALLOCATION_ALIGNMENT = 64;
+
+    // Library-level policy for large decode buffers. HUGE_PAGES backs
+    // allocations of 2MB and up with huge pages where the platform
+    // provides them (MAP_HUGETLB with a transparent-huge-page fallback on
+    // Linux, large pages on Windows), cutting TLB misses on the output
+    // stores of full-frame decodes. Allocation silently falls back to
+    // normal pages when huge pages are unavailable.
+    enum class AllocationPolicy : int {
+        DEFAULT = 0,
+        HUGE_PAGES
+    };
+
+    // Set the policy for subsequent allocations. Buffers already allocated
+    // are unaffected and are freed correctly regardless of later changes.
+    void setAllocationPolicy(AllocationPolicy policy);
+
+    AllocationPolicy allocationPolicy();
+
+    // Allocate bytes with ALLOCATION_ALIGNMENT alignment under the current
+    // policy. Free with freeAligned().
+    void* allocateAligned(size_t bytes);
+
+    void freeAligned(void* ptr);
+
+    // Standard allocator over allocateAligned()/freeAligned(), for keeping
+    // long-lived scratch vectors on the same policy as the buffer pool
+    template<typename T>
+    struct AlignedAllocator {
+        typedef T value_type;
+
+        AlignedAllocator() = default;
+
+        template<typename U>
+        AlignedAllocator(const AlignedAllocator<U>&) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(allocateAligned(n * sizeof(T)));
+        }
+
+        void deallocate(T* ptr, size_t) {
+            freeAligned(ptr);
+        }
+    };
+
+    template<typename T, typename U>
+    bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return true; }
+
+    template<typename T, typename U>
+    bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return false; }
+
+    typedef std::vector<uint8_t, AlignedAllocator<uint8_t>> AlignedByteBuffer;
+} // namespace motioncam
+
+#endif /* Allocator_hpp */
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef Archive_hpp
+#define Archive_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace motioncam {
+    namespace archive {
+        // Entropy stage applied over the bit-packed frame payloads by
+        // mcraw_archive. The capture-time packing is tuned for recording
+        // speed, not ratio; a general-purpose pass over the packed bytes
+        // recovers the redundancy it leaves behind, which matters for
+        // footage that sits in cold storage.
+        enum class Codec : uint32_t {
+            // Built-in byte-oriented LZ codec (LZ4-style token stream).
+            // Always available, fast to restore, modest ratio.
+            LZ = 1,
+
+            // zstd, when the library is linked in (MOTIONCAM_WITH_ZSTD).
+            // Clearly better ratio on packed raw data at the same restore
+            // speed; files written with it need a zstd-enabled build to
+            // open.
+            ZSTD = 2
+        };
+
+        // Leads every archived payload, ahead of the codec's stream. The
+        // stored size lets restore allocate the output exactly once.
+        struct PayloadHeader {
+            uint32_t magicNumber;
+            uint32_t codec;
+            uint32_t uncompressedSize;
+        };
+
+        const uint32_t PAYLOAD_MAGIC_NUMBER = 0x5A41434D; // "MCAZ"
+
+        // Whether this build can compress and restore with the codec
+        bool Available(Codec codec);
+
+        // Compress size bytes into an archived payload (PayloadHeader plus
+        // the codec's stream). Throws IOException when the codec is not
+        // available in this build.
+        void Compress(Codec codec, const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+
+        // Restore an archived payload into output. Throws IOException on a
+        // corrupt stream or a codec this build cannot restore.
+        void Decompress(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+    }
+}
+
+#endif /* Archive_hpp */
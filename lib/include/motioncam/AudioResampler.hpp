@@ -0,0 +1,76 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AudioResampler_hpp
+#define AudioResampler_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace motioncam {
+    // Convert int16 PCM to float32 in [-1, 1). SIMD inner loop, scalar tail.
+    void convertAudioToFloat(const int16_t* samples, size_t numSamples, float* out);
+
+    // Streaming windowed-sinc polyphase resampler for interleaved float
+    // audio. The filter bank is precomputed at construction (Blackman
+    // window, cutoff below the narrower Nyquist, phases interpolated
+    // linearly) and each output sample is a vectorized dot product, so the
+    // steady state is table lookups and SIMD multiply-adds. Filter history
+    // carries across process() calls: feed chunks as they arrive and call
+    // finish() once after the last.
+    class AudioResampler {
+    public:
+        static constexpr int TAPS = 32;
+        static constexpr int PHASES = 256;
+
+        AudioResampler(int inputRateHz, int outputRateHz, int numChannels);
+
+        // Feed interleaved input frames; appends resampled interleaved
+        // frames to out. numSamples counts individual samples, as in
+        // AudioChunk.
+        void process(const float* samples, size_t numSamples, std::vector<float>& out);
+
+        // Flush the filter tail after the last chunk
+        void finish(std::vector<float>& out);
+
+    private:
+        void produce(std::vector<float>& out);
+
+        int mInputRate;
+        int mOutputRate;
+        int mChannels;
+
+        // (PHASES + 1) rows of TAPS coefficients; row p holds the kernel
+        // for fractional position p / PHASES, row p + 1 the interpolation
+        // partner
+        std::vector<float> mFilter;
+
+        // Deinterleaved input, one delay line per channel. mFirst is the
+        // input frame index of the front of the buffers.
+        std::vector<std::vector<float>> mBuf;
+        int64_t mFirst;
+        int64_t mTotalIn{0};
+
+        // Input time of the next output frame: mTimeInt + mTimeFrac / mOutputRate
+        int64_t mTimeInt{0};
+        int64_t mTimeFrac{0};
+
+        bool mFinished{false};
+    };
+} // namespace motioncam
+
+#endif /* AudioResampler_hpp */
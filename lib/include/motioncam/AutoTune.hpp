@@ -0,0 +1,49 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AutoTune_hpp
+#define AutoTune_hpp
+
+#include <cstddef>
+#include <string>
+
+namespace motioncam {
+    // Persistence of tuned runtime parameters per storage device (see
+    // Decoder::enableAutoTune). The right prefetch depth, read block size
+    // and decode parallelism differ between local flash and a NAS mount,
+    // so profiles are keyed by the device a container lives on and stored
+    // in the user cache directory; a future open of any container on the
+    // same mount starts from the learned values instead of the defaults.
+    namespace autotune {
+        // Parameters learned from a tuned sequential scan. Zero means
+        // "not learned": keep the built-in default.
+        struct TunedProfile {
+            size_t readAhead{0};      // sequential-scan prefetch depth
+            size_t blockSize{0};      // block-buffered read size in bytes
+            size_t decodeThreads{0};  // decode threads that keep pace with the storage
+        };
+
+        // Load the profile learned for the device holding path. False when
+        // no profile has been stored or persistence is unsupported here.
+        bool Load(const std::string& path, TunedProfile& outProfile);
+
+        // Persist the profile for the device holding path. Best effort:
+        // failures (no cache directory, read-only home) are ignored.
+        void Store(const std::string& path, const TunedProfile& profile);
+    }
+}
+
+#endif /* AutoTune_hpp */
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CApi_h
+#define CApi_h
+
+/*
+ * Flat C API over the decoder for language bindings (Python ctypes/cffi,
+ * Rust, Go). Decoded frames are borrowed pointers into pooled buffers -
+ * no copy, no serialization - and stay valid until explicitly released,
+ * at which point the buffer returns to the pool for the next decode.
+ *
+ * A decoder and its frames must be used from one thread at a time, like
+ * the C++ Decoder; mcraw_frame_release() alone may be called from any
+ * thread. Release every frame before closing its decoder.
+ *
+ * Functions that can fail return NULL (pointers) or a negative value
+ * (counts); mcraw_last_error() describes the most recent failure on the
+ * calling thread.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mcraw_decoder mcraw_decoder;
+typedef struct mcraw_frame mcraw_frame;
+
+/* Open a container. Returns NULL on failure. */
+mcraw_decoder* mcraw_open(const char* path);
+
+/* Close a decoder, freeing its buffer pool. All frames loaded from it
+ * must have been released first. NULL is ignored. */
+void mcraw_close(mcraw_decoder* decoder);
+
+/* Message for the most recent failure on the calling thread, or an empty
+ * string. Valid until the next failing call on the same thread. */
+const char* mcraw_last_error(void);
+
+/* Number of frames in the container. */
+int64_t mcraw_frame_count(const mcraw_decoder* decoder);
+
+/* Timestamp in nanoseconds of the frame at index, in container order.
+ * Returns -1 when index is out of range. */
+int64_t mcraw_frame_timestamp_at(const mcraw_decoder* decoder, int64_t index);
+
+/* Container (camera) metadata as a JSON string owned by the decoder.
+ * Valid until mcraw_close(). */
+const char* mcraw_metadata_json(const mcraw_decoder* decoder);
+
+/* Decode the frame with the given timestamp into a pooled buffer.
+ * Returns NULL on failure (unknown timestamp, I/O or decode error). */
+mcraw_frame* mcraw_load_frame(mcraw_decoder* decoder, int64_t timestamp);
+
+/* Decode the frame at index, in container order. Returns NULL on failure. */
+mcraw_frame* mcraw_load_frame_at(mcraw_decoder* decoder, int64_t index);
+
+/* Borrowed pointer to the frame's pixels: width*height uint16 values,
+ * row major. Valid until mcraw_frame_release(). */
+const uint16_t* mcraw_frame_data(const mcraw_frame* frame);
+
+int mcraw_frame_width(const mcraw_frame* frame);
+int mcraw_frame_height(const mcraw_frame* frame);
+
+/* Timestamp of the frame in nanoseconds. */
+int64_t mcraw_frame_timestamp(const mcraw_frame* frame);
+
+/* Per-frame metadata as a JSON string owned by the frame. Valid until
+ * mcraw_frame_release(). */
+const char* mcraw_frame_metadata_json(const mcraw_frame* frame);
+
+/* Return the frame's buffer to the pool. NULL is ignored. */
+void mcraw_frame_release(mcraw_frame* frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CApi_h */
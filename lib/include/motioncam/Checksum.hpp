@@ -0,0 +1,31 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef Checksum_hpp
+#define Checksum_hpp
+
+#include <stddef.h>
+#include <cstdint>
+
+namespace motioncam {
+    // 64-bit non-cryptographic hash (the XXH64 construction) over a byte
+    // range. Fast enough that hashing a compressed frame payload on the
+    // reading thread disappears behind the decode of the previous frame.
+    // Detects storage corruption; not suitable against adversarial inputs.
+    uint64_t Hash64(const void* data, size_t len, uint64_t seed=0);
+}
+
+#endif /* Checksum_hpp */
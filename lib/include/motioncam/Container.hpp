@@ -23,6 +23,21 @@ namespace motioncam {
     const uint32_t INDEX_MAGIC_NUMBER = 0x8A905612;
     
     const uint8_t CONTAINER_VERSION = 3;
+
+    // Version 4 containers use the same item stream as version 3, with two
+    // changes aimed at memory mapped reads. A PADDING item is written before
+    // a frame's BUFFER item whenever needed so the compressed payload itself
+    // starts on a PAYLOAD_ALIGNMENT boundary, and BUFFER_INDEX_DATA holds
+    // BufferOffsetV4 entries that carry the payload and metadata sizes.
+    // Offsets still point at the BUFFER item header and items still chain by
+    // size, so the version 3 read path handles version 4 files unchanged.
+    const uint8_t CONTAINER_VERSION_4 = 4;
+
+    // Alignment of frame payloads in version 4 containers. Page sized, so a
+    // mapped payload pointer is page aligned and can be handed straight to
+    // the decode kernels.
+    const uint32_t PAYLOAD_ALIGNMENT = 4096;
+
     const uint8_t CONTAINER_ID[7] = {'M', 'O', 'T', 'I', 'O', 'N', ' '};
 
     struct Header {
@@ -42,7 +57,11 @@ namespace motioncam {
         METADATA,
         AUDIO_INDEX,
         AUDIO_DATA,
-        AUDIO_DATA_METADATA
+        AUDIO_DATA_METADATA,
+        PADDING,           // Alignment filler (version 4), contents are ignored
+        CHECKSUM_INDEX,    // Reference payload checksums (a ChecksumIndex followed by its entries)
+        COMPRESSED_BUFFER, // Frame payload recompressed for cold storage (see Archive.hpp)
+        THUMBNAIL          // Poster-frame image near the file head (a ThumbnailHeader then pixels)
     };
 
     struct Item {
@@ -55,6 +74,15 @@ namespace motioncam {
         int64_t timestamp;
     };
 
+    // Version 4 index entry. The sizes let a reader fetch a frame with
+    // exact-sized reads, no item header round trips.
+    struct BufferOffsetV4 {
+        int64_t offset;
+        int64_t timestamp;
+        uint32_t payloadSize;
+        uint32_t metadataSize;
+    };
+
     struct BufferIndex {
         int32_t magicNumber;
         int32_t numOffsets;
@@ -68,7 +96,34 @@ namespace motioncam {
 
     struct AudioMetadata {
         int64_t timestampNs;
-    };    
+    };
+
+    // Reference checksums over the compressed frame payloads, for detecting
+    // bit rot in archival copies. Stored either as a CHECKSUM_INDEX item -
+    // a ChecksumIndex followed by numEntries ChecksumEntry records - or in
+    // a sidecar file next to the container (see Decoder).
+    struct ChecksumIndex {
+        int32_t magicNumber;
+        int32_t numEntries;
+    };
+
+    struct ChecksumEntry {
+        int64_t timestamp;
+        uint64_t hash;      // Hash64 of the frame's compressed payload
+    };
+
+    // Packed RGB888 rows, no padding
+    const uint32_t THUMBNAIL_FORMAT_RGB888 = 1;
+
+    // Leads a THUMBNAIL item's payload. Repack-style tools embed the item
+    // between the camera metadata and the leading frame index, so a shot
+    // browser fetches the poster frame with one small read
+    // (Decoder::loadThumbnail) instead of an index load and a frame decode.
+    struct ThumbnailHeader {
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+    };
 }
 
 #endif /* Container_h */
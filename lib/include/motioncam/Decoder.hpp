@@ -17,17 +17,103 @@
 #ifndef Decoder_hpp
 #define Decoder_hpp
 
+#include <motioncam/AutoTune.hpp>
 #include <motioncam/Container.hpp>
+#include <motioncam/FrameBufferPool.hpp>
+#include <motioncam/LatencyHistogram.hpp>
 #include <nlohmann/json.hpp>
 
+#include <array>
 #include <string>
 #include <vector>
-#include <map>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+// Hot-path instrumentation counters (see Decoder::getStats). Define
+// MOTIONCAM_DECODER_STATS=0 to compile them out entirely.
+#ifndef MOTIONCAM_DECODER_STATS
+    #define MOTIONCAM_DECODER_STATS 1
+#endif
 
 namespace motioncam {
+    class Reader;
+    class AvailabilityMap;
+
+    namespace raw {
+        struct FrameStatistics;
+        struct FrameSummary;
+        struct DamageMap;
+        enum class DecodeQoS;
+    }
+
     typedef int64_t Timestamp;
     typedef std::pair<Timestamp, std::vector<int16_t>> AudioChunk;
 
+    // Interleaved samples per waveform overview bucket
+    constexpr size_t AUDIO_OVERVIEW_BUCKET_SIZE = 1024;
+
+    // Waveform overview of the audio track: the minimum sample, maximum
+    // sample and root-mean-square level of each run of
+    // AUDIO_OVERVIEW_BUCKET_SIZE interleaved samples, in stream order. A
+    // timeline renderer draws peaks and loudness from these few hundred
+    // KB instead of decoding the full track.
+    struct AudioOverview {
+        std::vector<int16_t> minValue;
+        std::vector<int16_t> maxValue;
+        std::vector<uint16_t> rms;
+    };
+
+    // A run of consecutive frames between capture gaps, with the rate it
+    // actually sustained (see Decoder::analyzeTiming)
+    struct TimingSegment {
+        size_t firstFrame{0};   // index into getFrames()
+        size_t numFrames{0};
+        double fps{0};
+    };
+
+    // A capture stutter: an inter-frame interval far enough past the
+    // expected one to have swallowed whole frames
+    struct TimingGap {
+        size_t frameIndex{0};   // index of the frame after the gap
+        Timestamp before{0};    // timestamp of the frame ahead of the gap
+        int64_t intervalNs{0};
+        int droppedFrames{0};   // expected intervals missing from the gap
+    };
+
+    // Capture timing analysis computed from the frame index alone - the
+    // timestamp deltas already hold the evidence of drops, jitter and
+    // duplicates - so QC triage of a clip costs microseconds and no pixel
+    // decode. See Decoder::analyzeTiming.
+    struct TimingReport {
+        size_t numFrames{0};
+        int64_t expectedIntervalNs{0};  // median inter-frame interval
+        double expectedFps{0};
+        size_t droppedFrames{0};        // summed over the gaps
+        size_t duplicates{0};           // repeated timestamps
+        std::vector<TimingGap> gaps;
+        std::vector<TimingSegment> segments;
+
+        // Deviation of each regular interval from the expected one, as a
+        // fraction of it, bucketed at the JITTER_BUCKET_EDGES thresholds
+        // (the last bucket collects everything past the largest edge)
+        static constexpr size_t NUM_JITTER_BUCKETS = 8;
+        std::array<uint32_t, NUM_JITTER_BUCKETS> jitterHistogram{};
+        int64_t maxJitterNs{0};
+    };
+
+    // Upper edge of each jitter bucket as a fraction of the expected
+    // interval; an interval 3% off its target lands in the 0.05 bucket
+    constexpr double JITTER_BUCKET_EDGES[TimingReport::NUM_JITTER_BUCKETS - 1] = {
+        0.001, 0.005, 0.01, 0.02, 0.05, 0.1, 0.25
+    };
+
     class MotionCamException : public std::runtime_error {
     public:
         MotionCamException(const std::string& error) : runtime_error(error) {}
@@ -38,21 +124,574 @@ namespace motioncam {
         IOException(const std::string& error) : MotionCamException(error) {}
     };
 
+    // Thrown when payload verification finds a checksum mismatch (see
+    // Decoder::enableChecksumVerification)
+    class ChecksumException : public IOException {
+    public:
+        ChecksumException(const std::string& error) : IOException(error) {}
+    };
+
+    // Failure reasons for the noexcept API surface. An enum with fixed
+    // context instead of an exception, so the failure path of a per-frame
+    // call builds no strings and takes no unwind path.
+    enum class DecodeError {
+        NONE,
+        FRAME_NOT_FOUND,        // No frame with the requested timestamp
+        IO_FAILED,              // Read or seek failure
+        INVALID_METADATA,       // Frame metadata missing required fields
+        INVALID_COMPRESSION,    // Unsupported compression type
+        BUFFER_TOO_SMALL,       // Caller's buffer can't hold the frame
+        CHECKSUM_MISMATCH,      // Payload failed checksum verification
+        DECODE_FAILED           // Compressed payload did not decode
+    };
+
+    // Value-or-error result of the noexcept surface. Holds the value when
+    // ok() and the error otherwise; fixed size, no allocation either way.
+    template<typename T>
+    class Expected {
+    public:
+        Expected(T value) : mValue(std::move(value)), mError(DecodeError::NONE) {}
+        Expected(DecodeError error) : mValue(), mError(error) {}
+
+        bool ok() const { return mError == DecodeError::NONE; }
+        explicit operator bool() const { return ok(); }
+
+        // Only meaningful when ok()
+        const T& value() const { return mValue; }
+
+        DecodeError error() const { return mError; }
+
+    private:
+        T mValue;
+        DecodeError mError;
+    };
+
+    // Snapshot of the decoder's cumulative instrumentation counters
+    struct DecoderStats {
+        uint64_t bytesRead;
+        uint64_t numSeeks;
+        uint64_t framesDecoded;
+        uint64_t decodeNanos;          // time inside raw::Decode
+        uint64_t metadataParseNanos;   // time parsing/scanning per-frame metadata
+        uint64_t openIndexNanos;       // open: reading the frame index (leading, trailing or recovered)
+        uint64_t openSortNanos;        // open: ordering the index and building the frame list
+        uint64_t openMetadataNanos;    // open: parsing the container metadata JSON
+        uint64_t openExtraNanos;       // locating the audio index (the deferred item walk)
+    };
+
+    // Pipeline stages with a latency histogram (see Decoder::getLatency)
+    enum class DecodeStage {
+        READ,    // payload read, including cache and spill lookups
+        PARSE,   // per-frame metadata parse/scan
+        DECODE,  // raw::Decode / raw::DecodePlanar
+        FRAME    // a whole loadFrame call, end to end
+    };
+
+    // Color filter arrangement of the sensor
+    enum class ColorFilterArrangement {
+        RGGB,
+        BGGR,
+        GRBG,
+        GBRG,
+        INVALID
+    };
+
+    // Container metadata parsed once into typed fields at open, so per-frame
+    // code reads plain members instead of repeating JSON key lookups. Fields
+    // missing from the container are left at their defaults; anything beyond
+    // these fields is still available through getContainerMetadata().
+    struct ContainerMetadata {
+        int audioSampleRate{0};
+        int audioChannels{0};
+        // archive::Codec of the payload entropy stage, 0 for a normal
+        // container (set by mcraw_archive, see Archive.hpp)
+        int archiveCodec{0};
+        std::array<uint16_t, 4> blackLevel{};
+        double whiteLevel{0};
+        ColorFilterArrangement sensorArrangement{ColorFilterArrangement::INVALID};
+        std::array<double, 9> colorMatrix1{};
+        std::array<double, 9> colorMatrix2{};
+        std::array<double, 9> forwardMatrix1{};
+        std::array<double, 9> forwardMatrix2{};
+    };
+
+    // Describes a frame decoded through the noexcept surface
+    struct FrameInfo {
+        Timestamp timestamp{0};
+        int width{0};
+        int height{0};
+    };
+
+    // Poster-frame image embedded near the head of repacked containers
+    // (Type::THUMBNAIL), packed RGB888
+    struct Thumbnail {
+        int width{0};
+        int height{0};
+        std::vector<uint8_t> rgb;
+    };
+
+    // A decoded frame held by the frame cache. Shared with callers, so a
+    // frame stays valid after eviction for as long as a reference is held.
+    struct CachedFrame {
+        std::vector<uint16_t> data;
+        nlohmann::json metadata;
+    };
+
+    // A compressed frame payload held by the payload cache
+    struct CachedPayload {
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> metadataJson;
+    };
+
+    // Per-frame metadata for a whole recording in column form, one row per
+    // frame of getFrames() in the same order (see
+    // Decoder::loadAllFrameMetadata). Fields a frame's metadata does not
+    // carry are left zero.
+    struct FrameMetadataColumns {
+        std::vector<Timestamp> timestamps;
+        std::vector<int> widths;
+        std::vector<int> heights;
+        std::vector<int> isos;
+        std::vector<int64_t> exposureTimes;             // nanoseconds
+        std::vector<int> orientations;
+        std::vector<std::array<double, 3>> asShotNeutral;
+    };
+
+    // How the decoder reads the container from disk
+    enum class ReadMode {
+        BUFFERED,       // Buffered stdio (FILE*)
+        MEMORY_MAPPED,  // Memory mapped file, reads are pointer arithmetic and frame payloads are decoded zero-copy
+        IO_URING,       // io_uring (Linux only), batch loads keep multiple frame reads in flight
+        OVERLAPPED_IO,  // Overlapped ReadFile (Windows only), batch loads keep multiple frame reads in flight
+        SHARED          // Reads go through a process-wide per-file block cache, so concurrent decoders on one container (A/B grading, several daemon sessions) share index, metadata and payload I/O
+    };
+
+    // Where a container lives, for opens that describe the storage instead
+    // of picking an I/O mechanism. Small reads are cheap on local flash but
+    // latency-bound on rotational disks and network mounts, so the decoder
+    // adapts its read sizes to the profile.
+    enum class StorageProfile : int {
+        AUTO,       // Detect from the filesystem (Linux; elsewhere assumes LOCAL_SSD)
+        LOCAL_SSD,  // Local flash: direct small reads, io_uring where available
+        HDD,        // Rotational disk: large sequential blocks amortize seeks
+        NETWORK     // NAS or other network filesystem: very large blocks amortize round trips
+    };
+
+    // How findFrame resolves a timestamp that falls between two frames
+    enum class SeekMode {
+        NEAREST,    // Closest frame in either direction
+        BEFORE,     // Latest frame at or before the timestamp
+        AFTER       // Earliest frame at or after the timestamp
+    };
+
+    // Shared cancel flag for batch and asynchronous work. Copies observe the
+    // same flag, so a caller keeps one copy and hands another to loadFrames()
+    // or openAsync(); cancel() from any thread makes the work stop early -
+    // tasks still queued never start, and frames already decoding abandon at
+    // the next 4-row group. A token is single-use: once cancelled it stays
+    // cancelled, so redirected workloads should take a fresh one.
+    class CancellationToken {
+    public:
+        CancellationToken() : mCancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+        // Request cancellation. Thread-safe and idempotent.
+        void cancel() { mCancelled->store(true, std::memory_order_relaxed); }
+
+        bool cancelled() const { return mCancelled->load(std::memory_order_relaxed); }
+
+    private:
+        friend class Decoder;
+
+        std::shared_ptr<std::atomic<bool>> mCancelled;
+    };
+
+    class Decoder;
+
+    // Pull-based stream over every frame of a container in timestamp order,
+    // usable in a range-for. A worker thread decodes the next frame into a
+    // second buffer while the caller consumes the current one, on top of the
+    // sequential scan's read-ahead, so read and decode latency hide behind
+    // consumption. The two frame buffers are recycled between iterations;
+    // steady-state streaming performs no per-frame allocation of pixel data.
+    // The frame reference obtained from the iterator is only valid until the
+    // next increment.
+    class FrameStream {
+    public:
+        struct Frame {
+            Timestamp timestamp{};
+            std::vector<uint16_t> data;
+            nlohmann::json metadata;
+        };
+
+        class iterator {
+        public:
+            Frame& operator*() const;
+            Frame* operator->() const;
+            iterator& operator++();
+            bool operator!=(const iterator& other) const;
+
+        private:
+            friend class FrameStream;
+
+            iterator(FrameStream* stream, bool atEnd) : mStream(stream), mAtEnd(atEnd) {}
+
+            FrameStream* mStream;
+            bool mAtEnd;
+        };
+
+        ~FrameStream();
+
+        FrameStream(const FrameStream&) = delete;
+        FrameStream& operator=(const FrameStream&) = delete;
+
+        iterator begin();
+        iterator end();
+
+    private:
+        friend class Decoder;
+
+        FrameStream(Decoder& decoder, size_t readAhead);
+
+        // Swap in the next decoded frame. Returns false when the stream ends.
+        bool advance();
+
+        void workerLoop();
+
+        Decoder& mDecoder;
+        Frame mFront;
+        Frame mBack;
+
+        std::thread mWorker;
+        std::mutex mMutex;
+        std::condition_variable mCond;
+        bool mPending{false};
+        bool mReady{false};
+        bool mBackOk{false};
+        bool mStop{false};
+        bool mFinished{false};
+        std::exception_ptr mError;
+    };
+
     class Decoder {
     public:
-        Decoder(const std::string& path);
+        // useIndexCache enables a sidecar index cache next to the container
+        // (<path>.mcidx). When a valid cache exists, construction loads the
+        // frame and audio indexes and the container metadata with a single
+        // small read instead of re-sorting and re-walking the file; otherwise
+        // the container is indexed normally and the cache is written for the
+        // next open. The cache is validated against the container's size and
+        // modification time.
+        Decoder(const std::string& path, ReadMode mode=ReadMode::BUFFERED, bool useIndexCache=false);
+        // Open a container described by where it lives rather than by an
+        // I/O mechanism: HDD and NETWORK read through a block cache whose
+        // block size is tuned from the frame index once it is loaded, so a
+        // typical frame load is a couple of large sequential transfers;
+        // LOCAL_SSD issues small reads directly.
+        Decoder(const std::string& path, StorageProfile profile, bool useIndexCache=false);
         Decoder(FILE* file);
-        
+        // Decode a container already resident in memory, e.g. received from
+        // a capture relay: no temp file and no page-cache double buffering,
+        // and frame payloads decode straight from the source bytes. The
+        // caller keeps data alive for the decoder's lifetime.
+        Decoder(const uint8_t* data, size_t size);
+        // As above, sharing ownership of the buffer
+        Decoder(std::shared_ptr<const std::vector<uint8_t>> buffer);
+        // Decode through a custom byte source, e.g. a RemoteReader over
+        // HTTP/S3 ranged GETs. The decoder takes ownership of the reader.
+        Decoder(std::unique_ptr<Reader> reader);
+        // Open a container still syncing to local disk. The map says which
+        // byte ranges have landed; construction waits for the header, the
+        // camera metadata and the trailing index (written last, at the file
+        // tail), then indexes normally - so decoding starts as soon as the
+        // tail syncs instead of at 100%. Loading a fully-present frame
+        // succeeds immediately; a frame with missing bytes throws, and
+        // isFrameAvailable()/waitForFrame() let a caller schedule around
+        // the transfer instead.
+        Decoder(const std::string& path, std::shared_ptr<AvailabilityMap> availability);
+
+        // Open a container on the shared pool, resolving the decoder through
+        // a future. A browser over hundreds of clips can fire off every open
+        // at once and render each entry as its decoder resolves, bounded by
+        // disk parallelism instead of one thread of constructor calls. An
+        // open failure rethrows from the future's get().
+        static std::future<std::unique_ptr<Decoder>> openAsync(const std::string& path, ReadMode mode=ReadMode::BUFFERED, bool useIndexCache=false);
+
+        // Cancellable variant. A browser scrolling away from a directory of
+        // clips cancels the opens it no longer wants; a cancelled open that
+        // had not started resolves to a null decoder instead of touching the
+        // disk (one already constructing completes normally).
+        static std::future<std::unique_ptr<Decoder>> openAsync(const std::string& path, const CancellationToken& token, ReadMode mode=ReadMode::BUFFERED, bool useIndexCache=false);
+
+        // Open with the frame index loaded incrementally instead of all at
+        // once. A normal open materializes every index record before the
+        // first frame can decode - 16 bytes times potentially millions of
+        // frames on long timelapses, read and sorted up front. A streaming
+        // open reads only the first chunk: getFrames() starts with those
+        // frames and each refreshIndex() call appends the next chunk,
+        // merging out-of-order records as they arrive (captures are
+        // recorded nearly in order, so the common case is a straight
+        // append). Frames decode as soon as their chunk has landed;
+        // callers needing the whole index - exports, follow mode, frame
+        // counts - should pull until indexComplete(). Containers with a
+        // leading index load it whole, which is already one small read.
+        static std::unique_ptr<Decoder> openStreamingIndex(const std::string& path, ReadMode mode=ReadMode::BUFFERED);
+
+        // Load the next chunk of a streaming index into getFrames().
+        // Returns the number of records appended, 0 once the index is
+        // fully loaded.
+        size_t refreshIndex();
+
+        // True once every index record has been loaded. Always true for
+        // non-streaming opens.
+        bool indexComplete() const;
+
+        // One entry of openBatch(): the decoder, or the error that kept it
+        // from opening
+        struct OpenResult {
+            std::unique_ptr<Decoder> decoder;
+            std::string error;  // empty on success
+        };
+
+        // Open many containers at once. A loop of constructors pays each
+        // file's index and metadata round trips serially; the batch runs
+        // the opens as I/O-lane tasks on the shared pool, so the small
+        // reads of different files stay in flight together and a project
+        // scan over thousands of short clips is bounded by the disk's
+        // queue depth instead of one file's latency at a time. A file
+        // that fails to open reports its error in place rather than
+        // aborting the batch. Returns one entry per path, in order.
+        static std::vector<OpenResult> openBatch(const std::vector<std::string>& paths, ReadMode mode=ReadMode::BUFFERED, bool useIndexCache=false);
+
         ~Decoder();
-        
+
+        // Create an independent decoder over the same container for use from
+        // another thread. The clone reuses the already-parsed metadata and
+        // frame index instead of re-reading them, and gets its own file
+        // handle and scratch buffers. Only available when the decoder was
+        // opened by path.
+        std::unique_ptr<Decoder> clone() const;
+
+        // Point this instance at another container instead of destroying it
+        // and constructing a new one. The frame index arrays, scratch and
+        // metadata buffers keep their capacity across files, so an ingest
+        // loop over thousands of similar clips reopens without allocating
+        // in the steady state (stdio-backed readers even keep their stream
+        // and buffer). Configuration - read mode or storage profile, cache
+        // budgets, QoS, fixed geometry, drop-behind, auto-tune - carries
+        // over; per-container state (cached frames and payloads, checksum
+        // references, the audio index and overview) is dropped. Only
+        // available when the decoder was opened by path; throws on an open
+        // failure, leaving the instance unusable until a reopen succeeds.
+        void reopen(const std::string& path);
+
         // Get container metadata
         const nlohmann::json& getContainerMetadata() const;
+
+        // Get the container metadata as typed fields
+        const ContainerMetadata& getTypedContainerMetadata() const;
         
         // Get all frame timestamps in container
         const std::vector<Timestamp>& getFrames() const;
-        
+
+        // Compressed payload bytes per frame of getFrames(), in the same
+        // order - the raw material for bitrate and complexity plots,
+        // without touching a single payload. Exact sizes come from the
+        // version 4 index or the index cache; a version 3 container
+        // harvests them on first call with two batched header reads per
+        // frame (see ensureFrameSizes), after which they persist in the
+        // index cache.
+        const std::vector<uint32_t>& getFrameSizes();
+
+        // Analyze capture timing from the sorted frame list alone: the
+        // expected interval is inferred as the median timestamp delta,
+        // intervals half again past it become gaps carrying their
+        // missing-frame counts, duplicates are counted, regular intervals
+        // feed the jitter histogram, and the runs between gaps are
+        // reported with the rate each actually sustained. Touches only
+        // the index built at open - no payload is read.
+        TimingReport analyzeTiming() const;
+
+        // Find the index into getFrames() of the frame matching a timestamp
+        // under the given seek mode, by binary search over the sorted frame
+        // list. Returns -1 when no frame satisfies the mode.
+        int64_t findFrame(const Timestamp timestamp, SeekMode mode=SeekMode::NEAREST) const;
+
+        // Scheduling class for this decoder's frame decodes on the shared
+        // pool (see raw::DecodeQoS). Defaults to INTERACTIVE; an export
+        // sets BACKGROUND so its decodes fill spare capacity and yield to
+        // interactive frames at row-group granularity.
+        void setDecodeQoS(raw::DecodeQoS qos);
+
+        // True when every byte of the frame is present locally. Always true
+        // for opens without an availability map; false for timestamps not
+        // in the index.
+        bool isFrameAvailable(const Timestamp timestamp) const;
+
+        // Block until the frame's bytes have synced. timeoutMs of -1 waits
+        // indefinitely; returns false on timeout or an unknown timestamp.
+        bool waitForFrame(const Timestamp timestamp, int timeoutMs=-1) const;
+
+        // Load a frame by its index into getFrames(). Throws when the index
+        // is out of range.
+        void loadFrameByIndex(size_t frameIndex, std::vector<uint16_t>& outData, nlohmann::json& outMetadata);
+
         // Load a single frame and its metadata.
         void loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata);
+
+        // Load a single frame tolerating payload corruption: damaged
+        // 64-pixel blocks are filled from their reference value and
+        // flagged in outDamage instead of failing the frame (see
+        // raw::DecodeResilient), so a flipped bit costs a block, not the
+        // frame plus the pipeline's retries. Decodes with the saturating
+        // reference add, so corrupt 16-bit blocks clamp instead of
+        // wrapping. Still throws when the frame is missing or its
+        // metadata document is unusable - without dimensions there is
+        // nothing to size the output with.
+        void loadFrameResilient(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata, raw::DamageMap& outDamage);
+
+        // Load a single frame and gather per-CFA-plane statistics (12-bit
+        // histogram, min/max, mean) in the same decode pass, instead of a
+        // second full read of the decoded pixels.
+        void loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata, raw::FrameStatistics& outStatistics);
+
+        // Load a frame split into its four half-resolution CFA planes,
+        // written straight from the decode kernels without building the
+        // mosaic. outPlanes[2*ry + cx] holds the pixels at row parity ry,
+        // column parity cx; see raw::DecodePlanar.
+        void loadFramePlanar(const Timestamp timestamp, std::array<std::vector<uint16_t>, 4>& outPlanes, nlohmann::json& outMetadata);
+
+        // Load a frame as tightly packed rows at bitsPerPixel instead of
+        // pixels widened to 16 bits, packed directly by the decode kernels
+        // - a 10-bit sensor's frames shrink to 62.5% of the widened bytes,
+        // and every downstream copy and GPU upload with them. See
+        // raw::DecodePacked for the row layout and depth constraints.
+        void loadFramePacked(const Timestamp timestamp, const int bitsPerPixel, std::vector<uint8_t>& outData, nlohmann::json& outMetadata);
+
+        // Load a single frame without materializing its metadata. The frame
+        // dimensions are scanned straight out of the metadata bytes, skipping
+        // the JSON parse entirely on the per-frame hot path.
+        void loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData);
+
+        // Declare the frame geometry constant across the clip. The first
+        // pixels-only load captures width, height and compression type,
+        // and every later one skips the metadata item entirely - one
+        // fewer read and scan per frame. Only for clips known not to
+        // switch resolution mid-recording; disabling clears the captured
+        // geometry. Loads that return metadata are unaffected.
+        void setFixedGeometry(bool enable);
+
+        // Load a single frame into caller-provided memory. capacity is the number
+        // of uint16_t elements outData can hold; throws if it is smaller than
+        // width*height. The decode kernels write whole 4-row groups, so a
+        // capacity of at least width * 4*ceil(height/4) decodes straight into
+        // outData; the width*height minimum still works, through a reused
+        // staging buffer when height is not a multiple of 4.
+        void loadFrame(const Timestamp timestamp, uint16_t* outData, size_t capacity, nlohmann::json& outMetadata);
+
+        // Noexcept twin of the pointer-based loadFrame() for long-running
+        // services: failures come back as a DecodeError value instead of an
+        // IOException, so per-frame calls carry no error-string allocation
+        // and no unwind-path cost. Frame dimensions are scanned straight
+        // from the metadata bytes and the decoder's scratch buffers are
+        // reused, so the steady state makes no heap allocation. capacity
+        // follows the pointer-based loadFrame() contract: width*height is
+        // the minimum (BUFFER_TOO_SMALL below it) and a padded capacity of
+        // width * 4*ceil(height/4) avoids the staging copy.
+        Expected<FrameInfo> tryLoadFrame(const Timestamp timestamp, uint16_t* outData, size_t capacity) noexcept;
+
+        // Load a single frame into a buffer acquired from the pool. The
+        // returned handle releases the buffer back to the pool when it is
+        // destroyed, so frames can be moved through a pipeline without
+        // copying pixels or allocating per frame.
+        FrameHandle loadFrame(const Timestamp timestamp, FrameBufferPool& bufferPool, nlohmann::json& outMetadata);
+
+        // Load a vertically subsampled preview of a frame, for thumbnails and
+        // gallery scans. Decodes only every n'th 4-row group, where n is the
+        // smallest step that brings the preview height to maxHeight or below,
+        // so only that fraction of the compressed data is unpacked. outWidth
+        // and outHeight receive the preview dimensions.
+        void loadPreview(const Timestamp timestamp, int maxHeight, std::vector<uint16_t>& outData, int& outWidth, int& outHeight);
+
+        // Load the embedded poster-frame thumbnail, written near the file
+        // head by the repack-style tools. One small exact read - no index
+        // walk, no frame decode - so browsing a directory of clips over a
+        // network mount costs one round trip each. Returns false when the
+        // container carries no thumbnail.
+        bool loadThumbnail(Thumbnail& outThumbnail);
+
+        // Called once per decoded frame. Invoked from worker threads, possibly concurrently.
+        typedef std::function<void(Timestamp, std::vector<uint16_t>, nlohmann::json)> FrameCallback;
+
+        // Load a batch of frames, spreading the decode work across the
+        // process-wide shared pool while reads continue on the calling
+        // thread. Frames may be delivered out of order; numThreads of 0 uses
+        // the shared pool, any other value a private pool of that size.
+        void loadFrames(const std::vector<Timestamp>& timestamps, const FrameCallback& callback, size_t numThreads=0);
+
+        // Cancellable variant, for batches a user may scrub away from.
+        // token.cancel() stops the batch early: frames not yet queued are
+        // never read, queued decodes never start, and frames mid-decode
+        // abandon at the next 4-row group without invoking the callback, so
+        // the pool is reclaimed within about a frame time. Returns normally
+        // once the remaining workers have drained; cancellation is not an
+        // error.
+        void loadFrames(const std::vector<Timestamp>& timestamps, const FrameCallback& callback, const CancellationToken& token, size_t numThreads=0);
+
+        // Called once per decoded frame. Invoked from worker threads, possibly concurrently.
+        typedef std::function<void(Timestamp, FrameHandle, nlohmann::json)> PooledFrameCallback;
+
+        // Batch load into pool buffers. Reads and decode scheduling match the
+        // FrameCallback overload; pixels land in pool buffers handed to the
+        // callback by move. A pool cap below numThreads frames stalls workers
+        // in acquire() until the callback releases handles, so size the cap
+        // to at least the decode concurrency.
+        void loadFrames(const std::vector<Timestamp>& timestamps, FrameBufferPool& bufferPool, const PooledFrameCallback& callback, size_t numThreads=0);
+
+        // Cancellable pooled variant; cancellation behaves as in the
+        // FrameCallback overload, and buffers of abandoned frames go
+        // straight back to the pool.
+        void loadFrames(const std::vector<Timestamp>& timestamps, FrameBufferPool& bufferPool, const PooledFrameCallback& callback, const CancellationToken& token, size_t numThreads=0);
+
+        // Start a sequential scan over every frame in timestamp order. A
+        // background I/O thread prefetches up to readAhead compressed payloads
+        // while the current frame decodes on the calling thread. No other reads
+        // may be made on this decoder until the scan ends.
+        void beginSequentialScan(size_t readAhead=3);
+
+        // Get the next frame of the scan. Returns false when no frames remain.
+        bool nextFrame(Timestamp& outTimestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata);
+
+        // Stop a scan before it has delivered every frame
+        void endSequentialScan();
+
+        // Start a scan over a decimated frame range: every step'th frame,
+        // counting from startFrame (an index into getFrames()) up to but not
+        // including endFrame. The prefetcher plans reads only for the
+        // selected frames and steps over the byte ranges in between, so an
+        // every-Nth-frame timelapse or proxy render costs a fraction of the
+        // full-scan I/O. Frames are delivered through nextFrame() as usual.
+        void beginSelectiveScan(size_t startFrame, size_t endFrame, size_t step, size_t readAhead=3);
+
+        // Start a scan over an explicit set of frames, delivered in the
+        // order given. Throws when a timestamp is not in the container.
+        void beginSelectiveScan(const std::vector<Timestamp>& frames, size_t readAhead=3);
+
+        // Stream every frame in timestamp order. Equivalent to a sequential
+        // scan, with the decode of the next frame additionally overlapped
+        // with consumption of the current one.
+        FrameStream stream(size_t readAhead=3);
+
+        // Tune prefetch depth, read block size and decode parallelism from
+        // the storage actually behind this container instead of the static
+        // defaults. Sequential scans start from the depth learned for this
+        // mount (when one is stored) and hill-climb it online: the depth
+        // grows while the consumer finds the ring empty and shrinks while
+        // the I/O thread is always ahead. Measured read and decode rates
+        // are persisted per storage mount when the scan ends, so future
+        // opens on the same mount start tuned; batch loads with the
+        // default thread count then use the decode parallelism the storage
+        // can actually feed. Call before beginning a scan.
+        void enableAutoTune();
         
         // Audio sample rate
         int audioSampleRateHz() const;
@@ -60,25 +699,456 @@ namespace motioncam {
         // Number of channels in audio
         int numAudioChannels() const;
         
+        // Set the decoded-frame cache budget in bytes. The cache is disabled
+        // by default; a budget of 0 disables it again and drops cached frames.
+        void setFrameCacheBudget(size_t bytes);
+
+        // Current decoded-frame cache budget, 0 while the cache is disabled
+        size_t frameCacheBudget() const;
+
+        // Load a frame through the decoded-frame cache. A cache hit returns a
+        // shared reference to the already-decoded pixels without touching the
+        // file; a miss decodes as loadFrame does and caches the result,
+        // evicting least recently used frames beyond the budget.
+        std::shared_ptr<const CachedFrame> loadCachedFrame(const Timestamp timestamp);
+
+        // Load the frames centered on a timestamp - indices [center-radius,
+        // center+radius] into getFrames(), clamped at the clip edges - as
+        // shared references, for temporal filters that need a neighbourhood
+        // of frames at once. The decoder retains the returned window until
+        // the next loadWindow() call, so as the window slides only the
+        // frames entering it are decoded, regardless of the frame cache
+        // budget; with a budget set, frames leaving the window linger in
+        // the cache as margin for a reversal. Throws when the center
+        // timestamp matches no frame.
+        std::vector<std::shared_ptr<const CachedFrame>> loadWindow(const Timestamp center, int radius);
+
+        // Set the compressed-payload cache budget in bytes. Distinct from the
+        // decoded-frame cache: it sits between the I/O layer and raw::Decode,
+        // so repeated decodes of the same frames skip the storage reads but
+        // still run the decoder (e.g. when regrading a clip on slow or remote
+        // storage). Disabled by default; a budget of 0 disables it again.
+        void setPayloadCacheBudget(size_t bytes);
+
+        // Directory for payloads evicted from the payload cache. When set,
+        // evicted payloads are written there and later misses check the
+        // directory before going back to storage, so a second pass over a
+        // remote clip runs at local disk speed. An empty path disables
+        // spilling; spilled files are left behind for subsequent opens.
+        void setPayloadCacheSpillDirectory(const std::string& path);
+
+        // Persist this decoder's warm-cache state to directory, for a later
+        // process: every payload still in the in-memory payload cache is
+        // spilled there next to any previously spilled files, and a
+        // versioned manifest records the container's identity (size and
+        // mtime) together with the decoded-frame cache keys. Best effort -
+        // a failed save only costs the next process a cold start. Requires
+        // a decoder opened by path.
+        void saveCacheState(const std::string& directory);
+
+        // Restore warm-cache state written by saveCacheState(). When the
+        // manifest version matches and the container is unchanged, the
+        // payload spill directory is pointed at the saved area - payloads
+        // then repopulate lazily as frames are touched - and the saved
+        // decoded-frame cache keys are returned, most recently used first,
+        // so a caller can pre-warm them at idle. Returns empty and adopts
+        // nothing when the manifest is missing, stale or for a different
+        // container.
+        std::vector<Timestamp> restoreCacheState(const std::string& directory);
+
+        // Load a frame's compressed payload and metadata bytes without
+        // decoding them, for tools that rewrite containers.
+        void loadFramePayload(const Timestamp timestamp, std::vector<uint8_t>& outPayload, std::vector<uint8_t>& outMetadataJson);
+
+        // Decode a payload previously obtained with loadFramePayload(). Safe
+        // to call from several threads at once, so reads can be separated
+        // from decode work.
+        void decodeFramePayload(
+            const std::vector<uint8_t>& payload,
+            const std::vector<uint8_t>& metadataJson,
+            std::vector<uint16_t>& outData,
+            nlohmann::json& outMetadata) const;
+
+        // Compressed-domain statistics of one frame: only the payload's
+        // bits and refs metadata sections are parsed (a few KB, see
+        // raw::FrameSummary), so a whole clip can be summarized at a small
+        // fraction of decode cost - exposure ramps and scene-change
+        // detection without touching pixel data. Archived payloads are
+        // restored first. Throws when the timestamp matches no frame or
+        // the payload is invalid.
+        void loadFrameSummary(const Timestamp timestamp, raw::FrameSummary& outSummary);
+
+        // Read and parse every frame's metadata without touching a payload
+        // byte, for analysis passes over long recordings. The item sizes
+        // give each metadata item's position, so the payloads in between
+        // are seeked over with batched reads on the calling thread while
+        // parsing spreads across the pool; an hour of footage scans in
+        // seconds without decoding a pixel. numThreads of 0 uses the shared
+        // pool, any other value a private pool of that size.
+        FrameMetadataColumns loadAllFrameMetadata(size_t numThreads=0);
+
+        // Enable integrity verification of compressed frame payloads against
+        // reference checksums, for detecting bit rot in archival copies.
+        // References are loaded from a CHECKSUM_INDEX item in the container
+        // or from the sidecar written by writeChecksumSidecar(); throws when
+        // neither exists. On the prefetching paths (sequential scans, batch
+        // loads) payloads are hashed on the reading thread while decode runs
+        // on, so verification adds no wall-clock time; single-frame loads
+        // hash inline. A mismatch throws IOException naming the frame.
+        void enableChecksumVerification();
+
+        // Stop verifying payload checksums
+        void disableChecksumVerification();
+
+        // Hash every frame payload and write the reference checksums to a
+        // sidecar next to the container (<path>.mchash), validated against
+        // the container's size and modification time on load. Only available
+        // when the decoder was opened by path.
+        void writeChecksumSidecar();
+
+        // Bound the page-cache footprint of whole-container scans. When
+        // enabled, byte ranges more than windowBytes behind the furthest
+        // consumed position are advised DONT_NEED after each frame or
+        // audio read, so a verification pass over a 100GB container stops
+        // evicting every other service's pages. Costs about one advisory
+        // call per window of progress; backends without an advisory
+        // mechanism ignore it.
+        void enableDropBehind(size_t windowBytes = DEFAULT_DROP_BEHIND_WINDOW);
+
+        static constexpr size_t DEFAULT_DROP_BEHIND_WINDOW = 16 * 1024 * 1024;
+
+        // Write decoded pixels with non-temporal stores on the pointer-based
+        // loadFrame()/tryLoadFrame() paths, for callers decoding straight
+        // into write-combined or pinned memory headed for a GPU upload. The
+        // stores bypass the cache instead of evicting a frame's worth of
+        // data the CPU never reads back. Takes effect on x86 when the
+        // output buffer is 32-byte aligned and the frame width a multiple
+        // of 16; otherwise decoding silently uses regular stores.
+        void enableStreamingStores();
+
+        // Back to regular, cache-filling decode stores
+        void disableStreamingStores();
+
+        // Start timestamp of the audio stream in milliseconds, 0 when the
+        // container has no audio.
+        int64_t audioStartTimestampMs() const;
+
         // Load all audio chunks.
         void loadAudio(std::vector<AudioChunk>& outAudioChunks);
+
+        // Load the whole audio track as one contiguous buffer of
+        // interleaved samples in file order. The distances between the
+        // indexed chunk offsets bound the track's bytes at open, so the
+        // buffer is allocated once at that bound and the coalesced chunk
+        // reads fill slices of it - one allocation for the entire track
+        // instead of one vector per chunk - then trimmed to the samples
+        // actually present. Place the track on the timeline with
+        // audioStartTimestampMs() or audioPositionForFrame().
+        void loadAudio(std::vector<int16_t>& outSamples);
+
+        // Load only the audio chunks overlapping [startNs, endNs]. The chunk
+        // timestamps are indexed on first use with header-only reads, so
+        // segment export costs are proportional to the segment instead of
+        // the whole recording. Chunks without timestamp metadata (present in
+        // some older files) are not returned by this path.
+        void loadAudioRange(const Timestamp startNs, const Timestamp endNs, std::vector<AudioChunk>& outAudioChunks);
+
+        // Called once per audio chunk. The sample pointer aliases an internal
+        // buffer and is only valid for the duration of the call.
+        typedef std::function<void(Timestamp, const int16_t* samples, size_t numSamples)> AudioCallback;
+
+        // Stream every audio chunk through the callback in file order. Uses
+        // constant memory regardless of recording length, so long captures
+        // can be consumed without materializing hundreds of MB of chunks.
+        void visitAudio(const AudioCallback& callback);
+
+        // Audio sample position of a frame timestamp: the interleaved frame
+        // index into the decoded stream as loadAudio()/loadAudioFloat()
+        // produce it. Built lazily from the audio index - chunk timestamps
+        // come from header-only reads and sample counts from the chunk
+        // sizes - so the first call walks the headers once and A/V sync
+        // afterwards is a binary search plus a multiply, never a full audio
+        // load. Returns -1 when the container has no timestamped audio.
+        int64_t audioPositionForFrame(const Timestamp timestamp);
+
+        // Called once per chunk of converted float samples. The sample
+        // pointer aliases an internal buffer that is reused between chunks.
+        typedef std::function<void(Timestamp, const float* samples, size_t numSamples)> AudioFloatCallback;
+
+        // Stream every audio chunk as float32 in [-1, 1). Each chunk is
+        // converted with a SIMD kernel as it arrives, so conversion
+        // interleaves with the coalesced chunk reads of visitAudio()
+        // instead of following a full int16 load of the stream.
+        void visitAudioFloat(const AudioFloatCallback& callback);
+
+        // Load the whole audio stream as interleaved float32, resampled to
+        // outputSampleRateHz when that differs from the container's rate
+        // (pass 0 to keep it). Conversion and resampling run chunk by chunk
+        // between the reads; see AudioResampler for the filter.
+        void loadAudioFloat(int outputSampleRateHz, std::vector<float>& outSamples);
+
+        // Waveform overview for timeline rendering. Computed with one
+        // streaming pass over the audio on first use - SIMD min/max and
+        // sum-of-squares reductions per chunk - and persisted in the index
+        // cache sidecar when the decoder was opened with one, so later
+        // opens get it without touching the audio at all. Empty when the
+        // container has no audio.
+        const AudioOverview& getAudioOverview();
+
+        // Stream every frame and every audio chunk through the callbacks in
+        // file order, with a single front-to-back pass over the container.
+        // Consumers exporting audio and video together pay one sequential
+        // read of the file instead of a seeky audio walk plus a separate
+        // frame pass. Frames are decoded on the calling thread and handed to
+        // frameCallback by move; runs of adjacent audio chunks are coalesced
+        // into large reads as visitAudio does.
+        void visitSequential(const FrameCallback& frameCallback, const AudioCallback& audioCallback);
+
+        // Follow a container still being recorded. The decoder remembers
+        // the end of the last indexed frame record and refreshFollow()
+        // forward-scans the items appended since, so frames become loadable
+        // seconds after capture instead of waiting for the file to finalize
+        // and write its trailing index. Works with any open that succeeded,
+        // including one that went through index recovery on a partial file.
+        void beginFollow();
+
+        // Pick up frames the recorder appended since the last refresh:
+        // complete BUFFER+METADATA records are added to getFrames() and
+        // become loadable, a record still being written is left for the
+        // next call, and a trailing index marks the recording finalized.
+        // Returns the number of frames appended. Reads only the new bytes;
+        // a refresh that finds nothing costs one file-size probe.
+        size_t refreshFollow();
+
+        // Block until getFrames() holds at least minFrames frames, polling
+        // the file every pollIntervalMs. Returns true when the frames are
+        // available, false on timeout (timeoutMs of -1 waits forever) or
+        // when the recording finalizes with fewer frames.
+        bool waitForFrames(size_t minFrames, int timeoutMs=-1, int pollIntervalMs=50);
+
+        // True once the follow scan has seen the trailing index: the
+        // recording is finalized and no more frames will arrive
+        bool followEnded() const;
+
+        // Stop following; refreshFollow() may not be called again
+        void endFollow();
+
+        // Get the instrumentation counters. All zeros when compiled out.
+        DecoderStats getStats() const;
+
+        // Percentiles of the latency recorded for one pipeline stage,
+        // so an SLO like "frame fetch p99 under 25ms" can be checked and
+        // a violation attributed to read, parse or decode time. Constant
+        // memory, one relaxed counter increment per sample; all zeros
+        // when the instrumentation is compiled out.
+        LatencyPercentiles getLatency(DecodeStage stage) const;
+
+        // Reset the instrumentation counters to zero
+        void resetStats();
         
     private:
+        struct SequentialScanState;
+
+        Decoder(const Decoder& other);
+        Decoder(const std::string& path, ReadMode mode, bool useIndexCache, bool streamingIndex);
+
+        std::unique_ptr<Reader> createReader(const std::string& path) const;
         void init();
+        void parseTypedMetadata();
+        bool tryLoadIndexCache();
+        void writeIndexCache() const;
+        void ensureFrameSizes();
+        void tuneBlockSize();
+        void beginScan(std::vector<size_t> selection, bool selective, size_t readAhead);
+        void scanLoop();
+        std::pair<int64_t, size_t> frameByteRange(size_t index) const;
         void read(void* data, size_t size, size_t items=1) const;
+        bool seek(int64_t offset, int origin) const;
         void readIndex();
+        bool tryReadLeadingIndex(int64_t resumeOffset);
+        void readIndexEntries(uint32_t numOffsets);
+        size_t readIndexChunk();
+        void recoverIndex();
         void reindexOffsets();
-        void readExtra();
+        void readExtra() const;
+        void ensureAudioIndex() const;
+        void ensureAudioAlignment();
+        void dropBehind(int64_t consumedEnd);
+        bool tryLoadChecksums();
+        bool tryLoadChecksumSidecar();
+        void verifyPayload(const Timestamp timestamp, const uint8_t* payload, size_t len) const;
+        void ensureAudioTimestamps();
+        size_t audioByteBound(const std::vector<BufferOffset>& sortedOffsets);
+        void visitAudioSpan(const std::vector<BufferOffset>& offsets, const AudioCallback& callback);
         void uncompress(const std::vector<uint8_t>& src, std::vector<uint8_t>& dst);
-        
+        const uint8_t* readFramePayload(const Timestamp timestamp, size_t& outCompressedLen, std::vector<uint8_t>& outMetadataJson);
+        const uint8_t* readFramePayloadUncached(const Timestamp timestamp, size_t& outCompressedLen, std::vector<uint8_t>& outMetadataJson);
+        const uint8_t* readFramePayloadPixels(const Timestamp timestamp, size_t& outCompressedLen);
+        const uint8_t* insertPayload(const Timestamp timestamp, CachedPayload entry);
+        std::string spillPath(const Timestamp timestamp) const;
+        void spillPayload(const Timestamp timestamp, const CachedPayload& entry) const;
+        bool loadSpilledPayload(const Timestamp timestamp, CachedPayload& outEntry) const;
+        int64_t findFrameIndex(const Timestamp timestamp) const;
+        const uint8_t* unarchivePayload(const uint8_t* compressed, size_t& compressedLen) const;
+        void decodePayload(
+            const uint8_t* compressed,
+            size_t compressedLen,
+            const std::vector<uint8_t>& metadataJson,
+            std::vector<uint16_t>& outData,
+            nlohmann::json& outMetadata,
+            const std::atomic<bool>* cancel=nullptr) const;
+        typedef std::function<void(Timestamp, const std::vector<uint8_t>&, const std::vector<uint8_t>&)> DecodeTask;
+        void loadFramesImpl(const std::vector<Timestamp>& timestamps, size_t numThreads, const DecodeTask& decodeTask, const std::atomic<bool>* cancel=nullptr);
+        void readFrameRecordsCoalesced(
+            const std::vector<int64_t>& indices,
+            std::vector<std::shared_ptr<std::vector<uint8_t>>>& outCompressed,
+            std::vector<std::shared_ptr<std::vector<uint8_t>>>& outMetadataJson);
+        FrameHandle decodePayloadPooled(
+            const uint8_t* compressed,
+            size_t compressedLen,
+            const std::vector<uint8_t>& metadataJson,
+            FrameBufferPool& bufferPool,
+            nlohmann::json& outMetadata,
+            const std::atomic<bool>* cancel=nullptr) const;
+
     private:
-        FILE* mFile;
-        std::vector<BufferOffset> mOffsets;
-        std::vector<BufferOffset> mAudioOffsets;
-        std::map<Timestamp, BufferOffset> mFrameOffsetMap;
+        std::unique_ptr<Reader> mReader;
+        std::string mPath;
+        ReadMode mMode{ReadMode::BUFFERED};
+        // Resolved storage profile when opened by profile; clones reopen
+        // through the same one
+        StorageProfile mProfile{};
+        bool mProfileOpen{false};
+        uint8_t mVersion{CONTAINER_VERSION};
+        // Frame index as parallel flat arrays sorted by timestamp, one
+        // entry per frame: mFrameList holds the timestamps (and doubles as
+        // the getFrames() view, so they are stored exactly once) and
+        // mFrameOffsets the matching byte offsets. Kept flat rather than as
+        // an array of records - million-frame timelapse indexes stay
+        // compact and timestamp searches scan densely packed keys.
         std::vector<Timestamp> mFrameList;
-        nlohmann::json mMetadata;
-        std::vector<uint8_t> mTmpBuffer;
+        std::vector<int64_t> mFrameOffsets;
+        // Payload/metadata sizes per frame, version 4 only
+        std::vector<uint32_t> mPayloadSizes;
+        std::vector<uint32_t> mMetadataSizes;
+        // Audio index, loaded lazily on the first audio access. Most opens
+        // never touch audio, so the item walk that locates it is skipped
+        // unless the index was already restored from a cache or a leading
+        // index. mutable so const accessors can trigger the load.
+        mutable std::vector<BufferOffset> mAudioOffsets;
+        mutable int64_t mAudioStartTimestampMs{0};
+        mutable bool mAudioIndexLoaded{false};
+        bool mAudioTimestampsIndexed{false};
+        // Alignment table for audioPositionForFrame(): per timestamped
+        // chunk, its timestamp and the cumulative frame position of its
+        // first sample in decoded-stream order
+        std::vector<std::pair<Timestamp, int64_t>> mAudioAlignment;
+        int64_t mAudioTotalFrames{0};
+        bool mAudioAlignmentBuilt{false};
+        // Waveform overview, restored from the index cache or built on
+        // first use by getAudioOverview()
+        AudioOverview mAudioOverview;
+        bool mAudioOverviewLoaded{false};
+        // Whether this open uses the .mcidx sidecar; getAudioOverview()
+        // only persists the overview when it does
+        bool mIndexCacheEnabled{false};
+        // Where the embedded thumbnail item lives, -1 when the container
+        // has none; found while probing the leading index and persisted in
+        // the index cache sidecar
+        int64_t mThumbnailOffset{-1};
+        uint32_t mThumbnailSize{0};
+        // Drop-behind scan mode: furthest consumed byte and the position
+        // already advised out of the page cache
+        bool mDropBehind{false};
+        size_t mDropBehindWindow{0};
+        int64_t mScanHighWater{0};
+        int64_t mDroppedTo{0};
+        // Mutable for the deferred parse below: a cached open fills the
+        // typed metadata from the sidecar's binary block and keeps the
+        // JSON text unparsed here until getContainerMetadata() asks for it
+        mutable nlohmann::json mMetadata;
+        mutable std::vector<char> mMetadataJsonPending;
+        mutable std::mutex mMetadataParseMutex;
+        ContainerMetadata mContainerMetadata;
+        // Compressed-payload scratch, on the library allocation policy so
+        // large payloads can sit on huge pages
+        AlignedByteBuffer mTmpBuffer;
+        // Lazily cached file size and the previous frame's metadata length,
+        // used to coalesce the per-frame reads
+        int64_t mFileSize{-1};
+        size_t mMetadataSizeHint{0};
+        std::vector<uint8_t> mMetadataJsonBuffer;
+        // Fixed-geometry mode (setFixedGeometry): dimensions captured by
+        // the first pixels-only load, -1 until then
+        bool mFixedGeometry{false};
+        long mFixedWidth{-1};
+        long mFixedHeight{-1};
+        std::unique_ptr<SequentialScanState> mScan;
+        // Auto-tuning state: the profile loaded (and later learned) for
+        // this container's mount, and the block size currently applied to
+        // a block-buffered reader
+        bool mAutoTune{false};
+        autotune::TunedProfile mTunedProfile;
+        size_t mBlockSize{0};
+
+        // Decoded-frame cache, most recently used at the front
+        std::list<std::pair<Timestamp, std::shared_ptr<const CachedFrame>>> mCacheList;
+        std::unordered_map<Timestamp, decltype(mCacheList)::iterator> mCacheMap;
+        size_t mCacheBudget{0};
+
+        // Frames pinned by the current loadWindow() call, keyed by
+        // timestamp; replaced wholesale when the window moves
+        std::vector<std::pair<Timestamp, std::shared_ptr<const CachedFrame>>> mWindow;
+        size_t mCacheBytes{0};
+
+        // Compressed-payload cache, most recently used at the front
+        std::list<std::pair<Timestamp, CachedPayload>> mPayloadCacheList;
+        std::unordered_map<Timestamp, decltype(mPayloadCacheList)::iterator> mPayloadCacheMap;
+        size_t mPayloadCacheBudget{0};
+        size_t mPayloadCacheBytes{0};
+        std::string mPayloadSpillDir;
+
+        // Reference payload checksums, verified only while enabled. Loaded
+        // once at enable and read-only afterwards, so the scan I/O thread
+        // can hash against them without locking.
+        std::unordered_map<Timestamp, uint64_t> mChecksums;
+        bool mVerifyChecksums{false};
+
+        // Non-temporal decode stores on the pointer-based load paths
+        bool mStreamingStores{false};
+
+        // Scheduling class of this decoder's decodes; zero-initialized to
+        // INTERACTIVE (the enum is opaque here)
+        raw::DecodeQoS mDecodeQoS{};
+
+        // Set on availability-aware opens; the reader checks it per read
+        std::shared_ptr<AvailabilityMap> mAvailability;
+
+        // Follow mode: byte position the forward scan resumes from, -1 when
+        // not following
+        int64_t mFollowPos{-1};
+        bool mFollowEnded{false};
+
+        // Streaming index mode: position of the next unread index record
+        // and how many remain past it
+        bool mStreamingIndex{false};
+        int64_t mIndexReadPos{-1};
+        uint32_t mIndexRemaining{0};
+
+#if MOTIONCAM_DECODER_STATS
+        mutable std::atomic<uint64_t> mStatBytesRead{0};
+        mutable std::atomic<uint64_t> mStatNumSeeks{0};
+        mutable std::atomic<uint64_t> mStatFramesDecoded{0};
+        mutable std::atomic<uint64_t> mStatDecodeNanos{0};
+        mutable std::atomic<uint64_t> mStatParseNanos{0};
+        mutable std::atomic<uint64_t> mStatOpenIndexNanos{0};
+        mutable std::atomic<uint64_t> mStatOpenSortNanos{0};
+        mutable std::atomic<uint64_t> mStatOpenMetadataNanos{0};
+        mutable std::atomic<uint64_t> mStatOpenExtraNanos{0};
+
+        // Indexed by DecodeStage
+        mutable LatencyHistogram mLatencyHistograms[4];
+#endif
     };
 } // namespace motioncam
 
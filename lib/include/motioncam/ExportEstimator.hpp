@@ -0,0 +1,89 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ExportEstimator_hpp
+#define ExportEstimator_hpp
+
+#include <cstdint>
+#include <string>
+
+namespace motioncam {
+    class Decoder;
+
+    // Calibrated cost coefficients for export prediction on one machine.
+    // Decode time is modelled as a fixed per-frame setup cost plus a
+    // per-compressed-byte cost, which tracks both the clip's bitrate and
+    // its bits distribution; write time is output bytes over sink
+    // bandwidth. Obtained from calibrateExportModel, or loaded from a
+    // recorded calibration file keyed by machine class in the same style
+    // as the perf_regress baselines.
+    struct ExportCostModel {
+        // Compressed payload bytes per second through read + decode
+        double decodeBytesPerSecond{0.0};
+
+        // Fixed seconds per frame on top of the byte cost (DNG encode,
+        // colour pipeline) for callers whose export does per-frame work
+        // the decode samples cannot see; calibration leaves it at 0
+        double frameOverheadSeconds{0.0};
+
+        // Decoded output bytes per frame observed during calibration
+        double outputBytesPerFrame{0.0};
+
+        // Sink bandwidth for the written output; 0 leaves write time out
+        // of the estimate
+        double writeBytesPerSecond{0.0};
+    };
+
+    // Predicted cost of exporting a frame range
+    struct ExportEstimate {
+        size_t numFrames{0};
+        int64_t inputBytes{0};
+        int64_t outputBytes{0};
+        double decodeSeconds{0.0};
+        double writeSeconds{0.0};
+        double totalSeconds{0.0};
+    };
+
+    // Measure decode cost by timing the midpoint frame of sampleFrames
+    // equal strata across the clip and extrapolating each sample's
+    // seconds-per-byte over its stratum's byte total from the size
+    // index, so the throughput number carries the clip's bits
+    // distribution. Sampled frames go through the normal load path, so
+    // the numbers include read and metadata cost. The model's write
+    // bandwidth is left at 0; set it from the farm's sink numbers or
+    // MeasureWriteThroughput.
+    ExportCostModel CalibrateExportModel(Decoder& decoder, size_t sampleFrames = 8);
+
+    // Predict decode and write time for frames [firstFrame, lastFrame)
+    // of getFrames() from the per-frame compressed sizes and the model.
+    // The range is clamped to the clip.
+    ExportEstimate EstimateExport(Decoder& decoder, size_t firstFrame, size_t lastFrame, const ExportCostModel& model);
+
+    // Write and fsync a probe file in directory to measure the sink's
+    // sequential write bandwidth in bytes per second. The probe is
+    // unlinked afterwards. Returns 0 when the directory is not writable.
+    double MeasureWriteThroughput(const std::string& directory, size_t probeBytes = 32 * 1024 * 1024);
+
+    // Calibrations persist in a JSON file keyed by machine class
+    // (platform + core count, matching the perf_regress baseline key), so
+    // one checked-in file serves a mixed fleet and a scheduler node
+    // calibrates once rather than per job. Load returns false when the
+    // file has no entry for this machine.
+    bool LoadExportModel(const std::string& path, ExportCostModel& outModel);
+    void SaveExportModel(const std::string& path, const ExportCostModel& model);
+}
+
+#endif /* ExportEstimator_hpp */
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FrameBufferPool_hpp
+#define FrameBufferPool_hpp
+
+#include <motioncam/Allocator.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace motioncam {
+    class FrameBufferPool;
+
+    // Alignment of pooled frame buffers
+    constexpr size_t FRAME_BUFFER_ALIGNMENT = ALLOCATION_ALIGNMENT;
+
+    // Move-only handle to a buffer owned by a FrameBufferPool. The buffer
+    // returns to its pool when the handle is destroyed or reset, so frames
+    // flow through pipeline stages by moving the handle, never by copying
+    // pixels. A handle must not outlive its pool.
+    class FrameHandle {
+    public:
+        FrameHandle() = default;
+        FrameHandle(FrameHandle&& other) noexcept;
+        FrameHandle& operator=(FrameHandle&& other) noexcept;
+        ~FrameHandle();
+
+        FrameHandle(const FrameHandle&) = delete;
+        FrameHandle& operator=(const FrameHandle&) = delete;
+
+        uint16_t* data() { return mData; }
+        const uint16_t* data() const { return mData; }
+
+        // Number of uint16_t elements
+        size_t size() const { return mSize; }
+
+        explicit operator bool() const { return mData != nullptr; }
+
+        // Return the buffer to the pool now
+        void reset();
+
+    private:
+        friend class FrameBufferPool;
+
+        FrameHandle(FrameBufferPool* pool, uint16_t* data, size_t size, size_t capacity)
+            : mPool(pool), mData(data), mSize(size), mCapacity(capacity) {}
+
+        FrameBufferPool* mPool{nullptr};
+        uint16_t* mData{nullptr};
+        size_t mSize{0};
+        size_t mCapacity{0};
+    };
+
+    // Recycles aligned frame buffers under a total memory cap. Released
+    // buffers are kept for reuse, so a steady-state pipeline allocates
+    // nothing per frame; when every buffer within the cap is in flight,
+    // acquire() blocks until one is released, giving pipelines natural
+    // backpressure instead of unbounded memory growth. Thread safe.
+    class FrameBufferPool {
+    public:
+        // maxBytes caps the pool's total allocation; 0 means uncapped
+        explicit FrameBufferPool(size_t maxBytes=0);
+        ~FrameBufferPool();
+
+        FrameBufferPool(const FrameBufferPool&) = delete;
+        FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+        // Acquire a buffer of at least numElements uint16_t values. Blocks
+        // while the cap is reached and every buffer is in use; throws when a
+        // single buffer alone would exceed the cap.
+        FrameHandle acquire(size_t numElements);
+
+        // Total bytes currently allocated, cached and in flight
+        size_t allocatedBytes() const;
+
+    private:
+        friend class FrameHandle;
+
+        struct Buffer {
+            uint16_t* data;
+            size_t capacity;    // in uint16_t elements
+        };
+
+        void release(uint16_t* data, size_t capacity);
+
+        const size_t mMaxBytes;
+
+        mutable std::mutex mMutex;
+        std::condition_variable mCond;
+        std::vector<Buffer> mFree;
+        size_t mAllocatedBytes{0};
+
+        // Registration with the global MemoryGovernor, which can reclaim
+        // the pool's cached buffers when a process-wide budget is set
+        int mReclaimerId{0};
+    };
+} // namespace motioncam
+
+#endif /* FrameBufferPool_hpp */
@@ -0,0 +1,66 @@
+#ifndef GpuDecoder_hpp
+#define GpuDecoder_hpp
+
+#include <stddef.h>
+#include <cstdint>
+#include <memory>
+
+namespace motioncam {
+    namespace raw {
+        // Optional GPU unpack backend. The format is a good fit for a
+        // compute kernel: blocks are independent 64-pixel units whose
+        // input offsets follow from the bits metadata, so one work item
+        // unpacks one block and scatters it into the mosaic. Built
+        // against OpenCL when MOTIONCAM_WITH_OPENCL is enabled; without
+        // it, or without a usable device, every call reports
+        // unavailable and the caller takes the CPU raw::Decode path.
+        //
+        // An instance owns a context, a queue and persistent device
+        // buffers that grow to the frame size once and are reused, so
+        // keep one per decoding thread; instances must not be shared
+        // between concurrent calls.
+        class GpuDecoder {
+        public:
+            GpuDecoder();
+            ~GpuDecoder();
+
+            GpuDecoder(const GpuDecoder&) = delete;
+            GpuDecoder& operator=(const GpuDecoder&) = delete;
+
+            // True when the backend was compiled in and a device was
+            // brought up. Construction is cheap when it wasn't.
+            bool isAvailable() const;
+
+            // Decode a frame payload and read the mosaic back into
+            // output, which needs room for the padded frame like the
+            // CPU path (width * 4 * ceil(encodedHeight/4) pixels).
+            // Returns the number of pixels written, or 0 when the
+            // backend is unavailable or the payload is rejected - fall
+            // back to raw::Decode in that case.
+            size_t decode(
+                uint16_t* output,
+                const int width,
+                const int height,
+                const uint8_t* input,
+                const size_t len);
+
+            // Decode and leave the frame in device memory for a preview
+            // path that shares the context (CL/GL interop). Returns the
+            // frame's cl_mem as an opaque handle, valid until the next
+            // decode on this instance, or nullptr on failure;
+            // outNumPixels receives the decoded pixel count.
+            void* decodeToDevice(
+                const int width,
+                const int height,
+                const uint8_t* input,
+                const size_t len,
+                size_t& outNumPixels);
+
+        private:
+            struct Impl;
+            std::unique_ptr<Impl> mImpl;
+        };
+    }
+}
+
+#endif /* GpuDecoder_hpp */
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LatencyHistogram_hpp
+#define LatencyHistogram_hpp
+
+#include <atomic>
+#include <cstdint>
+
+namespace motioncam {
+    // Percentile snapshot of a LatencyHistogram. Percentiles are bucket
+    // upper bounds, so each is within one bucket width (12.5%) above the
+    // true value; max is exact.
+    struct LatencyPercentiles {
+        uint64_t count{0};
+        uint64_t p50Nanos{0};
+        uint64_t p95Nanos{0};
+        uint64_t p99Nanos{0};
+        uint64_t maxNanos{0};
+    };
+
+    // Fixed-memory latency histogram in the HDR style: each power-of-two
+    // range of nanoseconds is split into 8 linear sub-buckets, bounding
+    // the relative error of any percentile to 12.5% while covering
+    // nanoseconds to minutes in about 300 counters. Recording is one
+    // relaxed fetch_add plus a relaxed max update, safe from any thread;
+    // percentile queries scan the buckets and may run concurrently with
+    // recording.
+    class LatencyHistogram {
+    public:
+        void record(uint64_t nanos) {
+            mBuckets[bucketFor(nanos)].fetch_add(1, std::memory_order_relaxed);
+
+            uint64_t seen = mMaxNanos.load(std::memory_order_relaxed);
+
+            while(nanos > seen && !mMaxNanos.compare_exchange_weak(seen, nanos, std::memory_order_relaxed))
+                ;
+        }
+
+        LatencyPercentiles percentiles() const {
+            LatencyPercentiles out;
+
+            uint64_t counts[NUM_BUCKETS];
+
+            for(int i = 0; i < NUM_BUCKETS; i++) {
+                counts[i] = mBuckets[i].load(std::memory_order_relaxed);
+                out.count += counts[i];
+            }
+
+            if(out.count == 0)
+                return out;
+
+            out.p50Nanos = rank(counts, (out.count * 50 + 99) / 100);
+            out.p95Nanos = rank(counts, (out.count * 95 + 99) / 100);
+            out.p99Nanos = rank(counts, (out.count * 99 + 99) / 100);
+            out.maxNanos = mMaxNanos.load(std::memory_order_relaxed);
+
+            return out;
+        }
+
+        // Clear all buckets; not atomic with respect to concurrent records
+        void reset() {
+            for(int i = 0; i < NUM_BUCKETS; i++)
+                mBuckets[i].store(0, std::memory_order_relaxed);
+
+            mMaxNanos.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        // 8 sub-buckets per octave; exponents above MAX_EXP (2^39 ns,
+        // about nine minutes) clamp into the last bucket
+        static const int SUB_BITS = 3;
+        static const int SUB = 1 << SUB_BITS;
+        static const int MAX_EXP = 39;
+        static const int NUM_BUCKETS = (MAX_EXP - SUB_BITS + 1) * SUB + SUB;
+
+        static int bucketFor(uint64_t nanos) {
+            if(nanos < SUB)
+                return static_cast<int>(nanos);
+
+            if((nanos >> (MAX_EXP + 1)) != 0)
+                return NUM_BUCKETS - 1;
+
+            int exp = SUB_BITS;
+
+            while(exp < MAX_EXP && (nanos >> (exp + 1)) != 0)
+                ++exp;
+
+            const int sub = static_cast<int>((nanos >> (exp - SUB_BITS)) & (SUB - 1));
+
+            return (exp - SUB_BITS + 1) * SUB + sub;
+        }
+
+        // Upper bound in nanoseconds of the values a bucket holds
+        static uint64_t bucketUpper(int bucket) {
+            if(bucket < SUB)
+                return static_cast<uint64_t>(bucket);
+
+            const int group = bucket / SUB;
+            const int sub = bucket % SUB;
+
+            return static_cast<uint64_t>(SUB + sub + 1) << (group - 1);
+        }
+
+        // Value at the given 1-based rank in the recorded distribution
+        static uint64_t rank(const uint64_t* counts, uint64_t target) {
+            uint64_t cumulative = 0;
+
+            for(int i = 0; i < NUM_BUCKETS; i++) {
+                cumulative += counts[i];
+
+                if(cumulative >= target)
+                    return bucketUpper(i);
+            }
+
+            return bucketUpper(NUM_BUCKETS - 1);
+        }
+
+    private:
+        std::atomic<uint64_t> mBuckets[NUM_BUCKETS]{};
+        std::atomic<uint64_t> mMaxNanos{0};
+    };
+} // namespace motioncam
+
+#endif /* LatencyHistogram_hpp */
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MemoryGovernor_hpp
+#define MemoryGovernor_hpp
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+
+namespace motioncam {
+    // One process-wide memory budget over the library's caches, pools and
+    // prefetch buffers, so an operator sets a single number instead of
+    // coordinating four per-subsystem caps by hand. Subsystems report what
+    // they hold through charge()/release(); while the total fits the
+    // budget everyone may grow into the free headroom, and going over it
+    // takes memory back in reclaim order - prefetch queues stop growing
+    // first, then the decoded-frame cache evicts, then the payload cache,
+    // then buffer pools free their cached buffers. Weights bias how much
+    // each subsystem keeps under contention. Thread-safe subsystems
+    // register a reclaimer that is called when the budget is exceeded;
+    // single-threaded ones trim themselves at their next insert instead.
+    // A budget of zero (the default) disables the governor entirely.
+    class MemoryGovernor {
+    public:
+        // In reclaim order: earlier subsystems give memory back first
+        enum class Subsystem : int {
+            PREFETCH = 0,       // sequential-scan prefetch queues
+            FRAME_CACHE,        // decoded-frame LRU caches
+            PAYLOAD_CACHE,      // compressed-payload caches
+            BUFFER_POOL,        // frame buffer pools
+            COUNT
+        };
+
+        static MemoryGovernor& shared();
+
+        // Total budget in bytes across all subsystems; 0 disables
+        void setBudget(size_t bytes);
+        size_t budget() const;
+
+        // Relative share of a subsystem under contention, default 1. A
+        // subsystem over its weighted share yields before one under it.
+        void setWeight(Subsystem subsystem, double weight);
+
+        // Record bytes a subsystem acquired or returned. A charge that
+        // takes the total over budget runs the registered reclaimers in
+        // reclaim order on the calling thread.
+        void charge(Subsystem subsystem, size_t bytes);
+        void release(Subsystem subsystem, size_t bytes);
+
+        // Bytes the subsystem should trim itself down to at its next safe
+        // point: its current usage plus the free headroom when the total
+        // fits, less its share of the deficit when it does not. SIZE_MAX
+        // when the governor is disabled.
+        size_t trimTarget(Subsystem subsystem) const;
+
+        // True when the subsystem holds more than its trim target; cheap
+        // enough to poll on insert paths
+        bool overTarget(Subsystem subsystem) const;
+
+        // Asked to free up to the given bytes, returns what it actually
+        // freed (and releases it). Called without the governor's
+        // accounting lock, possibly from any thread that charges.
+        typedef std::function<size_t(size_t)> Reclaimer;
+
+        // Returns an id for unregisterReclaimer(), which blocks until an
+        // in-flight invocation of the reclaimer has returned
+        int registerReclaimer(Subsystem subsystem, Reclaimer reclaimer);
+        void unregisterReclaimer(int id);
+
+        size_t totalBytes() const;
+        size_t bytesOf(Subsystem subsystem) const;
+
+    private:
+        MemoryGovernor() = default;
+
+        static constexpr int NUM_SUBSYSTEMS = static_cast<int>(Subsystem::COUNT);
+
+        // Per-subsystem reduction needed to get back under budget, zero
+        // when within it. Caller holds mMutex.
+        void computeReductions(size_t outReduction[NUM_SUBSYSTEMS]) const;
+
+        mutable std::mutex mMutex;
+        size_t mBudget{0};
+        double mWeights[NUM_SUBSYSTEMS]{1, 1, 1, 1};
+        size_t mBytes[NUM_SUBSYSTEMS]{};
+
+        // Serializes reclaim passes and unregistration against in-flight
+        // reclaimer invocations
+        std::mutex mReclaimMutex;
+        std::map<int, std::pair<Subsystem, Reclaimer>> mReclaimers;
+        int mNextReclaimerId{1};
+    };
+} // namespace motioncam
+
+#endif /* MemoryGovernor_hpp */
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MultiDecoder_hpp
+#define MultiDecoder_hpp
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/ThreadPool.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace motioncam {
+    // Decodes several containers in lockstep, for rigs that record the same
+    // scene with multiple synchronized cameras. Reads are scheduled one
+    // container at a time so the disk never services interleaved seek
+    // patterns across files, while the decode work of all containers is
+    // spread over one shared worker pool. Not thread safe; use one
+    // MultiDecoder per consuming thread.
+    class MultiDecoder {
+    public:
+        // A decoded frame from one container. valid is false when the
+        // container has no frames at all.
+        struct Frame {
+            bool valid{false};
+            Timestamp timestamp{};
+            std::vector<uint16_t> data;
+            nlohmann::json metadata;
+        };
+
+        // numThreads of 0 uses the hardware concurrency
+        explicit MultiDecoder(const std::vector<std::string>& paths, ReadMode mode=ReadMode::BUFFERED, size_t numThreads=0);
+
+        size_t numContainers() const;
+
+        // Access an underlying decoder, e.g. for its metadata or audio
+        Decoder& getDecoder(size_t container);
+
+        // Timestamp range covered by all containers: earliest first frame
+        // and latest last frame
+        Timestamp startTimestamp() const;
+        Timestamp endTimestamp() const;
+
+        // Load the frame nearest the given timestamp from every container.
+        // outFrames gets one entry per container, in constructor order. The
+        // frame buffers are recycled between calls; steady-state pulls make
+        // no per-frame allocation of pixel data.
+        void loadNearestFrames(const Timestamp timestamp, std::vector<Frame>& outFrames);
+
+    private:
+        std::vector<std::unique_ptr<Decoder>> mDecoders;
+        ThreadPool mPool;
+
+        // Per-container staging for the compressed payloads of one pull
+        std::vector<std::vector<uint8_t>> mPayloads;
+        std::vector<std::vector<uint8_t>> mMetadataJson;
+    };
+} // namespace motioncam
+
+#endif /* MultiDecoder_hpp */
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef Numa_hpp
+#define Numa_hpp
+
+namespace motioncam {
+    // Thin wrapper over libnuma, active only when the library is built
+    // with MOTIONCAM_WITH_NUMA on Linux. Everything degrades to a no-op
+    // single-node view otherwise, so callers need no ifdefs.
+    //
+    // The pool pins each worker to one node and sets that node as the
+    // thread's preferred allocation target; with first-touch placement,
+    // a worker's DecodeContext, scratch vectors and frame buffers then
+    // all land in node-local memory without a separate allocator.
+    namespace numa {
+        // Number of NUMA nodes, 1 on single-node machines or when NUMA
+        // support is compiled out
+        int NumNodes();
+
+        // Restrict the calling thread to the CPUs of a node and prefer
+        // that node for its memory allocations. No-op without support.
+        void BindCurrentThread(int node);
+    }
+
+    // Core-class (big.LITTLE / P+E) topology. On Linux the classes come
+    // from sysfs cpu_capacity, falling back to per-CPU max frequency; on
+    // Apple platforms from the hw.perflevel sysctls. Homogeneous machines
+    // and platforms without detection report zero efficiency cores and
+    // every bind degrades to a no-op, so callers need no ifdefs.
+    namespace cores {
+        // Number of performance cores, 0 when the topology is homogeneous
+        // or unknown
+        int NumPerformanceCores();
+
+        // Number of efficiency cores, 0 when homogeneous or unknown
+        int NumEfficiencyCores();
+
+        // Restrict the calling thread to the cores of one class. On Apple
+        // platforms, where threads cannot be pinned, the thread's QoS
+        // class is set instead and the kernel steers it accordingly.
+        void BindCurrentThread(bool efficiency);
+    }
+}
+
+#endif /* Numa_hpp */
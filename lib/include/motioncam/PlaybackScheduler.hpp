@@ -0,0 +1,141 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PlaybackScheduler_hpp
+#define PlaybackScheduler_hpp
+
+#include <motioncam/Decoder.hpp>
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+namespace motioncam {
+    // Deadline-aware playback over a Decoder, for review sessions where
+    // decode may not keep up with the display rate. A worker thread decodes
+    // upcoming frames into a small ring of reusable buffers, and whenever it
+    // falls behind the wall-clock playhead it skips straight to the frame
+    // the playhead needs next instead of working through stale ones, so
+    // latency stays bounded under load rather than snowballing.
+    //
+    // The scheduler takes exclusive use of the decoder's read paths; only
+    // its const accessors may be used elsewhere while playback runs.
+    class PlaybackScheduler {
+    public:
+        struct Frame {
+            Timestamp timestamp{-1};
+            std::vector<uint16_t> data;
+            nlohmann::json metadata;
+        };
+
+        struct PlaybackStats {
+            uint64_t framesDecoded;
+            uint64_t framesDropped;      // frames skipped because decode fell behind
+            uint64_t framesPrefetched;   // speculative scrub decodes into the frame cache
+        };
+
+        // ringSize bounds how many decoded frames are held ahead of the
+        // playhead. Playback starts paused at the first frame.
+        PlaybackScheduler(Decoder& decoder, size_t ringSize=4);
+        ~PlaybackScheduler();
+
+        PlaybackScheduler(const PlaybackScheduler&) = delete;
+        PlaybackScheduler& operator=(const PlaybackScheduler&) = delete;
+
+        // Position the playhead and set the playback rate in media
+        // nanoseconds per wall nanosecond. A rate of 0 pauses; 2.0 plays the
+        // clip at twice real time. Pending decoded frames are discarded.
+        void seek(const Timestamp timestamp, double rate);
+
+        // Change the rate without moving the playhead
+        void setRate(double rate);
+
+        // Current media position of the playhead
+        Timestamp playhead() const;
+
+        // Fetch the frame that should be on screen now: the newest decoded
+        // frame at or before the playhead. Returns false when that frame was
+        // already delivered or nothing is decoded yet. The frame's buffers
+        // are recycled into the ring on the next successful fetch.
+        bool getFrame(Frame& outFrame);
+
+        // Fetch the frame for an arbitrary scrub position through the
+        // decoder's frame cache. Each call also feeds a direction model:
+        // from the recent scrub positions the worker infers which way and
+        // how fast the user is dragging and speculatively decodes frames
+        // ahead in that direction into the cache while the transport is
+        // paused, so a continued scrub - including backward, which the
+        // sequential read-ahead cannot help - lands on cache hits. The
+        // speculation needs a frame cache; give the decoder a budget with
+        // setFrameCacheBudget() sized to the scrub window wanted.
+        std::shared_ptr<const CachedFrame> scrubFrame(const Timestamp timestamp);
+
+        PlaybackStats getStats() const;
+
+    private:
+        struct Slot {
+            bool ready{false};
+            int64_t frameIndex{-1};
+            Timestamp timestamp{-1};
+            std::vector<uint16_t> data;
+            nlohmann::json metadata;
+        };
+
+        // One observed scrub position, in frame-index space
+        struct ScrubSample {
+            std::chrono::steady_clock::time_point wall;
+            int64_t frameIndex;
+        };
+
+        Timestamp playheadLocked() const;
+        void planSpeculationLocked(std::chrono::steady_clock::time_point now);
+        void workerLoop();
+
+        Decoder& mDecoder;
+        std::vector<Slot> mRing;
+
+        mutable std::mutex mMutex;
+        std::condition_variable mCond;
+        std::thread mWorker;
+        bool mStop{false};
+
+        // Playhead anchor: media position and rate at a wall clock instant
+        std::chrono::steady_clock::time_point mAnchorWall;
+        Timestamp mAnchorMedia{0};
+        double mRate{0.0};
+
+        int64_t mNextIndex{0};          // next frame index the worker will decode
+        int64_t mLastDelivered{-1};     // frame index most recently given out
+        uint64_t mFramesDecoded{0};
+        uint64_t mFramesDropped{0};
+        uint64_t mFramesPrefetched{0};
+
+        // Scrub request handed to the worker, and the direction model
+        std::condition_variable mScrubDone;
+        std::deque<ScrubSample> mScrubHistory;
+        Timestamp mScrubTimestamp{-1};
+        bool mScrubPending{false};
+        bool mScrubServed{false};
+        std::shared_ptr<const CachedFrame> mScrubResult;
+        std::exception_ptr mScrubError;
+
+        int mScrubDirection{0};         // +1 forward, -1 backward, 0 unknown
+        int64_t mSpeculateIndex{-1};    // next frame index to prefetch
+        int64_t mSpeculateRemaining{0};
+    };
+} // namespace motioncam
+
+#endif /* PlaybackScheduler_hpp */
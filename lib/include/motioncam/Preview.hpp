@@ -0,0 +1,151 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef Preview_hpp
+#define Preview_hpp
+
+#include <motioncam/Decoder.hpp>
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace motioncam {
+    // Renders decoded raw frames into half-resolution 8-bit sRGB previews,
+    // fast enough to run at playback rate on one core. Each 2x2 Bayer cell
+    // becomes one RGB pixel - no interpolation, so nothing to alias - with
+    // black level and white balance (from the frame's asShotNeutral) folded
+    // into per-channel fixed-point gains, the camera-to-sRGB matrix applied
+    // in fixed point across SIMD lanes, and the sRGB transfer curve taken
+    // from a 12-bit lookup table.
+    //
+    // One engine per clip: the color matrices come from the container
+    // metadata at construction and the white balance gains are recomputed
+    // only when a frame's asShotNeutral changes. render() works on one
+    // frame at a time; use one engine per thread for concurrent previews.
+    class PreviewEngine {
+    public:
+        explicit PreviewEngine(const ContainerMetadata& containerMetadata);
+
+        // Render one decoded frame - the data and metadata a loadFrame call
+        // produced - into a packed outWidth x outHeight RGB888 buffer
+        void render(
+            const std::vector<uint16_t>& data,
+            const nlohmann::json& metadata,
+            std::vector<uint8_t>& outRgb,
+            int& outWidth,
+            int& outHeight);
+
+    private:
+        void updateGains(const std::array<double, 3>& neutral);
+
+        ContainerMetadata mMetadata;
+
+        // 2x2 cell positions of R, G, G, B per the sensor arrangement
+        std::array<int, 4> mPos{};
+
+        // White balance state: gains are (x * gain) >> 14 into the 12-bit
+        // working range, rebuilt when a frame's asShotNeutral changes
+        std::array<double, 3> mNeutral{};
+        std::array<uint16_t, 3> mGain{};
+
+        // Camera-to-linear-sRGB matrix, row major, Q13 fixed point
+        std::array<int16_t, 9> mMatrix{};
+
+        // 12-bit linear to 8-bit sRGB transfer curve
+        std::array<uint8_t, 4096> mGammaLut{};
+    };
+
+    // One CFA-binned mip level: still a Bayer mosaic in the container's
+    // arrangement, at half the linear resolution of the level above it.
+    // Black and white levels are unchanged by the averaging, so a level
+    // renders through PreviewEngine::render with just its own dimensions
+    // substituted into the frame metadata.
+    struct BayerMip {
+        int width{0};
+        int height{0};
+        std::vector<uint16_t> data;
+    };
+
+    // CFA-aware 2x2 binning with SIMD averaging per site plane: each
+    // output sample is the rounded mean of the four same-site samples in
+    // a 4x4 source block, so the result is the same mosaic at half the
+    // linear resolution ((width/2) & ~1 by (height/2) & ~1). Used for
+    // the mip chains below and by the proxy transcoder.
+    void BinBayerHalf(const uint16_t* src, const int srcWidth, const int srcHeight, BayerMip& out);
+
+    // Per-frame mip chains (1/2, 1/4 and 1/8 CFA-binned levels, built by
+    // SIMD 2x2 averaging per cell site) for zoomable viewers: a zoom
+    // change re-renders from the nearest cached level instead of
+    // re-decoding and re-scaling from full resolution. Chains are held in
+    // an LRU and their bytes are charged to the memory governor's
+    // frame-cache subsystem, so they shrink with the rest of the caches
+    // under memory pressure. Thread-safe.
+    class MipCache {
+    public:
+        explicit MipCache(size_t maxFrames = 16);
+        ~MipCache();
+
+        // The chain level for a zoom scale - 1 = half, 2 = quarter, 3 =
+        // eighth resolution - clamped to the deepest level the frame's
+        // size allows. Builds and caches the frame's chain from its
+        // decoded full-resolution data on first use. The returned level
+        // stays valid after eviction for as long as the reference is held.
+        std::shared_ptr<const BayerMip> level(
+            Timestamp timestamp,
+            int level,
+            const std::vector<uint16_t>& data,
+            int width,
+            int height);
+
+        void clear();
+
+    private:
+        struct Chain {
+            std::array<std::shared_ptr<const BayerMip>, 3> levels;
+            size_t bytes{0};
+        };
+
+        // Drop least recently used chains until at most maxBytes are
+        // held; returns the bytes freed. Caller holds mMutex and releases
+        // the freed bytes from the governor.
+        size_t evictTo(size_t maxBytes);
+
+        std::mutex mMutex;
+        std::list<std::pair<Timestamp, Chain>> mLru;    // front = most recent
+        std::unordered_map<Timestamp, std::list<std::pair<Timestamp, Chain>>::iterator> mIndex;
+        size_t mBytes{0};
+        size_t mMaxFrames;
+        int mReclaimerId{-1};
+    };
+
+    // Renders a decoded frame into a poster-frame thumbnail: the mosaic is
+    // CFA-binned until a render lands at or under maxDim on its long edge,
+    // then rendered through PreviewEngine. Used by the repack-style tools
+    // to build the embedded THUMBNAIL item (Decoder::loadThumbnail).
+    void RenderThumbnail(
+        const std::vector<uint16_t>& data,
+        const nlohmann::json& metadata,
+        const ContainerMetadata& containerMetadata,
+        int maxDim,
+        Thumbnail& outThumbnail);
+}
+
+#endif /* Preview_hpp */
@@ -17,21 +17,415 @@
 #ifndef RawData_hpp
 #define RawData_hpp
 
+#include <atomic>
 #include <stddef.h>
 #include <cstdint>
+#include <vector>
 
 namespace BS {
     class thread_pool;
 }
 
 namespace motioncam {
+    class ThreadPool;
+
     namespace raw {
+        // Scratch buffers reused across Decode calls so the steady state decode
+        // loop performs no heap allocations. Keep one per decoding thread; a
+        // Decode scheduling classes (see DecodeContext::qos)
+        enum class DecodeQoS {
+            INTERACTIVE,
+            BACKGROUND
+        };
+
+        // context must not be shared between concurrent Decode calls.
+        struct DecodeContext {
+            std::vector<uint16_t> bits;
+            std::vector<uint16_t> refs;
+
+            // Write the frame with non-temporal stores, for output buffers
+            // the CPU never reads back - write-combined or pinned staging
+            // headed for a GPU upload. The decode writes then bypass the
+            // cache instead of evicting a frame's worth of useful data.
+            // Takes effect on x86 full-frame decodes when the output
+            // pointer is 32-byte aligned and the width a multiple of 16;
+            // otherwise decoding silently uses regular stores.
+            bool streamingStores{false};
+
+            // Apply block references with a saturating add, so a corrupt
+            // block clamps to white instead of wrapping to a dark artifact.
+            // Only the 16-bit block class can overflow (references are 12
+            // bits and every narrower class masks its values), so the
+            // saturating variant exists for that one kernel and selecting
+            // it costs a predicted per-block branch - nothing next to the
+            // wrapping add. Well-formed streams decode identically either
+            // way.
+            bool saturatingAdd{false};
+
+            // When set, the flag is polled between 4-row groups and a raised
+            // flag makes the decode return 0 with the output only partially
+            // written, so an abandoned frame gives its core back within one
+            // row group instead of finishing into the void. The flag must
+            // stay valid for the duration of the call.
+            const std::atomic<bool>* cancel{nullptr};
+
+            // Scheduling class of the decode on the shared pool. An
+            // INTERACTIVE decode's stripes jump every queue; a BACKGROUND
+            // decode runs in the export lane and takes a preemption point
+            // at every 4-row group, running any waiting interactive work
+            // inline - so mid-export, an interactive frame starts within
+            // one row group instead of behind a queue of export frames.
+            DecodeQoS qos{DecodeQoS::INTERACTIVE};
+        };
+
         size_t Decode(
             uint16_t* output,
             const int width,
             const int height,
             const uint8_t* input,
             const size_t len);
+
+        size_t Decode(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context);
+
+        // Statistics of one CFA position, gathered while the frame decodes.
+        // Values at or above NUM_BINS are counted in the last histogram bin.
+        struct PlaneStatistics {
+            static const int NUM_BINS = 4096;   // 12-bit histogram
+
+            uint32_t histogram[NUM_BINS];
+            uint16_t minValue;
+            uint16_t maxValue;
+            uint64_t sum;
+            uint64_t count;
+
+            double mean() const {
+                return count > 0 ? static_cast<double>(sum) / static_cast<double>(count) : 0.0;
+            }
+        };
+
+        // Per-plane statistics for the four CFA positions; planes[2*ry + cx]
+        // covers pixels at row parity ry, column parity cx of the mosaic
+        struct FrameStatistics {
+            PlaneStatistics planes[4];
+
+            void reset();
+        };
+
+        // Decode and gather outStatistics in the same pass, from block data
+        // still resident in cache, instead of a second full read of the
+        // decoded frame
+        size_t Decode(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context,
+            FrameStatistics& outStatistics);
+
+        // Full-frame decode spread across pool's workers for low-latency
+        // single-frame grabs. A prefix sum over the bits metadata gives every
+        // 4-row group's input offset, then contiguous stripes of row groups
+        // decode concurrently on disjoint input and output ranges, submitted
+        // as decode-priority tasks in their own group - ThreadPool::shared()
+        // works fine even while it carries unrelated work. An unverified
+        // stream falls back to the serial bounds-checked loop.
+        size_t Decode(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context,
+            ThreadPool& pool);
+
+        // Dimensions of the CFA planes DecodePlanar produces: parity 0 is
+        // the even rows/columns plane dimension, parity 1 the odd
+        inline int PlaneDim(const int size, const int parity) {
+            return (size + 1 - parity) / 2;
+        }
+
+        // Decode into four half-resolution planar buffers instead of the
+        // mosaic, for pipelines that split the Bayer pattern immediately.
+        // planes[2*ry + cx] receives the pixels at row parity ry, column
+        // parity cx, PlaneDim(width, cx) * PlaneDim(height, ry) values.
+        // The decode kernels stage exactly the even/odd column split the
+        // planes need, so this skips the interleave shuffle and the strided
+        // re-read of a full-resolution mosaic entirely.
+        size_t DecodePlanar(
+            uint16_t* const planes[4],
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context);
+
+        // A rectangular region of a frame, in pixels
+        struct RegionOfInterest {
+            int x{0};
+            int y{0};
+            int width{0};
+            int height{0};
+        };
+
+        // Block layout of one encoded frame, computed once and reusable
+        // across decode calls on the same payload. groupOffsets holds the
+        // input byte offset of every 4-row group's first block - a prefix
+        // sum over the per-block lengths, summed eight lanes at a time - so
+        // any sub-frame access starts at its stripe directly instead of
+        // walking all preceding blocks' lengths.
+        struct FrameLayout {
+            uint32_t encodedWidth{0};
+            uint32_t encodedHeight{0};
+            bool verified{false};   // Every block read proven inside the input
+            std::vector<uint16_t> bits;
+            std::vector<uint16_t> refs;
+            std::vector<size_t> groupOffsets;
+        };
+
+        // Build outLayout from a frame payload. Returns false when the
+        // metadata header is invalid.
+        bool ComputeFrameLayout(
+            const uint8_t* input,
+            const size_t len,
+            FrameLayout& outLayout);
+
+        // Compressed-domain statistics of one encoded frame, computed from
+        // the bits and refs metadata sections alone - a few KB parsed per
+        // frame, no pixel data touched. Each block's reference is its block
+        // minimum, so the refs form a coarse brightness-floor map: one cell
+        // per 64x4 tile, the smallest of the tile's four per-plane
+        // references, in row-major map order. meanReference averages the
+        // block floors over the frame - an exposure estimate that tracks
+        // scene brightness - and meanBitsPerSample averages the residual
+        // widths, a complexity score that jumps on detail and scene
+        // changes. Values are raw sensor counts, black level included.
+        struct FrameSummary {
+            uint32_t encodedWidth{0};
+            uint32_t encodedHeight{0};
+
+            int mapWidth{0};    // cells per map row: encodedWidth / 64
+            int mapHeight{0};   // map rows: one per 4-row group
+
+            std::vector<uint16_t> minimumMap;
+
+            double meanReference{0};    // exposure estimate
+            uint16_t minReference{0};
+            uint16_t maxReference{0};
+
+            double meanBitsPerSample{0};    // complexity score
+            uint16_t maxBits{0};
+        };
+
+        // Build outSummary from a frame payload. Returns false when the
+        // metadata header is invalid or the metadata sections do not cover
+        // the frame.
+        bool ComputeFrameSummary(
+            const uint8_t* input,
+            const size_t len,
+            FrameSummary& outSummary);
+
+        // Destination layout of a full-frame decode, for consumers that
+        // want something other than tightly packed rows. rowPitchPixels
+        // pads every output row to the given stride (0 keeps rows packed
+        // at width). Setting tileWidth/tileHeight instead writes the frame
+        // as row-major tiles - each tile's pixels contiguous, tiles
+        // ordered left to right, top to bottom, edge tiles padded to full
+        // size - which is the native layout of tiled denoisers. tileWidth
+        // must be a multiple of the 64-pixel block and tileHeight of the
+        // 4-row decode group; rowPitchPixels is ignored when tiling.
+        struct OutputLayout {
+            size_t rowPitchPixels{0};
+            int tileWidth{0};
+            int tileHeight{0};
+        };
+
+        // Decode writing outputLayout directly from the interleave/store
+        // stage, so pitched or tiled consumers skip the full re-layout
+        // copy a packed frame would need. output must cover height rounded
+        // up to 4 rows at the layout's geometry; returns the decoded pixel
+        // count (as Decode) or 0 on an invalid layout or stream.
+        size_t Decode(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context,
+            const OutputLayout& outputLayout);
+
+        // Full-frame decode through a cached layout: the bits and refs
+        // arrays already decoded for a preview or region pass are reused,
+        // so a preview-then-full decode of the same payload parses its
+        // metadata sections once
+        size_t Decode(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            const FrameLayout& layout);
+
+        // Decode only the blocks covering roi, skipping the rest of the stream
+        // via the per-block lengths. roi is expanded in place to the decode
+        // granularity (4 rows by 64 columns) and clamped to the frame; on
+        // return output holds roi.width*roi.height pixels.
+        size_t Decode(
+            uint16_t* output,
+            const int width,
+            const int height,
+            RegionOfInterest& roi,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context);
+
+        // Region decode through a cached layout: the stream is entered at
+        // each group's precomputed offset, so the cost no longer depends on
+        // how far into the frame the region sits
+        size_t Decode(
+            uint16_t* output,
+            const int width,
+            const int height,
+            RegionOfInterest& roi,
+            const uint8_t* input,
+            const size_t len,
+            const FrameLayout& layout);
+
+        // Decode every rowGroupStep'th 4-row group, skipping the rest of the
+        // stream via the per-block lengths. output receives the kept groups
+        // packed together: width * PreviewHeight(height, rowGroupStep) pixels.
+        size_t DecodePreview(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const int rowGroupStep,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context);
+
+        // Preview decode through a cached layout: kept groups are entered at
+        // their precomputed offsets and skipped groups cost nothing
+        size_t DecodePreview(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const int rowGroupStep,
+            const uint8_t* input,
+            const size_t len,
+            const FrameLayout& layout);
+
+        // Height of the buffer DecodePreview produces. The encoder pads the
+        // frame up to whole 4-row groups and the decode loops write every
+        // kept group in full, so the buffer covers ceil(height/4) groups -
+        // flooring here would undersize it for any height not a multiple
+        // of 4 (step 1 delegates to the full Decode, which writes the same
+        // padded row count).
+        inline int PreviewHeight(const int height, const int rowGroupStep) {
+            return 4 * (((height + 3)/4 + rowGroupStep - 1) / rowGroupStep);
+        }
+
+        // Result of a resilient decode: one bit per 64-pixel block in
+        // stream order (4-row groups left to right, top to bottom, four
+        // blocks per group), set when the block could not be decoded and
+        // was filled from its reference value instead
+        struct DamageMap {
+            std::vector<uint64_t> blocks;
+            size_t numBlocks{0};
+            size_t damaged{0};
+
+            bool isDamaged(size_t block) const {
+                return block < numBlocks && ((blocks[block >> 6] >> (block & 63)) & 1) != 0;
+            }
+        };
+
+        // Decode tolerating a corrupt payload: block offsets are validated
+        // as the stream is walked, and a block whose read would leave the
+        // input - or whose metadata entry is unusable - is painted with
+        // its reference value (the block minimum, a flat but plausible
+        // patch) and flagged in outDamage, instead of failing the frame.
+        // One pass, never returns 0: even a destroyed header yields a
+        // fully-flagged frame of reference fill. Well-formed payloads
+        // decode identically to Decode with an empty damage map.
+        size_t DecodeResilient(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context,
+            DamageMap& outDamage);
+
+        // Decode straight to normalized linear float: every pixel is stored
+        // as (value - blackLevel) / (whiteLevel - blackLevel), converted in
+        // the store stage from the registers already holding the decoded
+        // block, so producing float frames costs no separate read-modify-
+        // write normalization pass over the output. output must hold the
+        // same pixel count Decode writes (width by height rounded up to a
+        // multiple of 4 rows); returns the number of pixels written.
+        size_t DecodeFloat(
+            float* output,
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context,
+            const float blackLevel,
+            const float whiteLevel);
+
+        // DecodeFloat variant storing IEEE binary16 bit patterns, halving
+        // the bandwidth of the converted frame for pipelines that sample
+        // half floats on the GPU
+        size_t DecodeHalfFloat(
+            uint16_t* output,
+            const int width,
+            const int height,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context,
+            const float blackLevel,
+            const float whiteLevel);
+
+        // Decode into tightly packed rows at the sensor's native bit depth
+        // instead of inflating every pixel to 16 bits, for consumers that
+        // read packed formats directly - a 10-bit frame's output is 62.5%
+        // the bytes of the widened one, and every downstream copy and
+        // upload shrinks with it. bitsPerPixel must be even and within
+        // [8, 16]; pixels are MSB first with each row starting on a byte
+        // boundary (the TIFF/DNG layout), rows are
+        // (width*bitsPerPixel + 7)/8 bytes with zero pad bits, and samples
+        // are clamped to the packed range so an outlier cannot corrupt its
+        // neighbours. output must hold a whole number of 4-row groups
+        // (height rounded up); returns the bytes written, 0 on a malformed
+        // payload or unsupported depth.
+        size_t DecodePacked(
+            uint8_t* output,
+            const int width,
+            const int height,
+            const int bitsPerPixel,
+            const uint8_t* input,
+            const size_t len,
+            DecodeContext& context);
+
+        // Encode a frame into a compressed payload that Decode and its
+        // variants accept, the inverse of the decode kernels: each 64-pixel
+        // block takes the narrowest bit class covering its range above the
+        // block minimum, values are bit-packed with the same SIMD lane
+        // layout the decoder unpacks, and the per-block bits and references
+        // go into the trailing metadata sections packed the same way. The
+        // frame is padded to the encoding granularity (64 columns, 4 rows)
+        // by edge replication, which the decoder slices off. output is
+        // replaced with the payload; returns its size in bytes.
+        size_t Encode(
+            const uint16_t* input,
+            const int width,
+            const int height,
+            std::vector<uint8_t>& output);
     }
 }
 
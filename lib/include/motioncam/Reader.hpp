@@ -0,0 +1,460 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef Reader_hpp
+#define Reader_hpp
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace motioncam {
+    // One positioned read of a readBatch() call
+    struct ReadRequest {
+        int64_t offset;
+        size_t len;
+        void* dst;
+    };
+
+    // Hint for Reader::advise()
+    enum class Advice : int {
+        WILL_NEED,  // The range will be read soon; start read-ahead
+        DONT_NEED,  // The range has been consumed; its pages may be dropped
+        SEQUENTIAL  // The range will be read front to back; raise read-ahead
+    };
+
+    // Where a container lives; defined in Decoder.hpp
+    enum class StorageProfile : int;
+
+    // Byte source for a container. The decoder reads through this interface so
+    // it can run over buffered stdio or a memory mapped region.
+    class Reader {
+    public:
+        virtual ~Reader() = default;
+
+        // Advisory hint about upcoming or completed access to a byte range.
+        // Best effort: backends without an advisory mechanism ignore it.
+        virtual void advise(int64_t offset, size_t len, Advice advice) { (void)offset; (void)len; (void)advice; }
+
+        // Read exactly size*items bytes from the current position. Throws IOException on failure.
+        virtual void read(void* data, size_t size, size_t items=1) = 0;
+
+        // Read size bytes from the current position, returning false on a short read instead of throwing.
+        virtual bool tryRead(void* data, size_t size) = 0;
+
+        // Reposition the read cursor. Returns false on failure. origin is SEEK_SET/SEEK_CUR/SEEK_END.
+        virtual bool seek(int64_t offset, int origin) = 0;
+
+        // Total size of the underlying file in bytes, -1 if unavailable
+        virtual int64_t size() = 0;
+
+        // Pointer into the underlying storage covering the next len bytes, advancing
+        // the cursor past them. Returns nullptr when the backend cannot expose one,
+        // in which case the caller should fall back to read().
+        virtual const uint8_t* directRead(size_t len) { (void)len; return nullptr; }
+
+        // Read several regions at once. Backends with asynchronous I/O keep the
+        // requests in flight together; the default runs them one by one. Does
+        // not move the read cursor. Throws IOException if any region is short.
+        virtual void readBatch(const std::vector<ReadRequest>& requests);
+
+        // Point the reader at a different file, reusing its buffers where the
+        // backend supports that. Returns false when it does not, in which case
+        // the caller constructs a fresh reader instead.
+        virtual bool reopen(const std::string& path) { (void)path; return false; }
+    };
+
+    // Buffered stdio backend. Matches the original FILE* behaviour of the decoder.
+    class FileReader : public Reader {
+    public:
+        FileReader(const std::string& path);
+        FileReader(FILE* file, bool ownsFile);
+
+        ~FileReader() override;
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        int64_t size() override;
+        void advise(int64_t offset, size_t len, Advice advice) override;
+        bool reopen(const std::string& path) override;
+
+    private:
+        FILE* mFile;
+        bool mOwnsFile;
+    };
+
+    // Memory mapped backend. All reads resolve to pointer arithmetic over the
+    // mapped region and directRead() hands out zero-copy pointers.
+    class MemoryMappedReader : public Reader {
+    public:
+        MemoryMappedReader(const std::string& path);
+
+        ~MemoryMappedReader() override;
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        const uint8_t* directRead(size_t len) override;
+        int64_t size() override;
+        void advise(int64_t offset, size_t len, Advice advice) override;
+
+    private:
+        const uint8_t* mData;
+        size_t mSize;
+        size_t mPos;
+#if defined(_WIN32)
+        void* mFileHandle;
+        void* mMappingHandle;
+#endif
+    };
+
+    // In-memory backend for container content that never touched a file -
+    // e.g. received over a capture relay. All reads resolve to pointer
+    // arithmetic over the buffer and directRead() hands out zero-copy
+    // pointers, so frame payloads decode straight from the source bytes.
+    class MemoryReader : public Reader {
+    public:
+        // Borrows data; the caller keeps it alive for the reader's lifetime
+        MemoryReader(const uint8_t* data, size_t size);
+
+        // Shares ownership of the buffer
+        MemoryReader(std::shared_ptr<const std::vector<uint8_t>> buffer);
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        const uint8_t* directRead(size_t len) override;
+        int64_t size() override;
+
+    private:
+        std::shared_ptr<const std::vector<uint8_t>> mBuffer;
+        const uint8_t* mData;
+        size_t mSize;
+        size_t mPos;
+    };
+
+    // Range-read backend for remote containers (HTTP/S3 and similar). The
+    // transport is supplied by the caller as a range-fetch callback so the
+    // library stays free of network dependencies; this class handles the
+    // access pattern: reads are served from an LRU cache of fixed-size
+    // blocks and a read spanning several missing blocks fetches them with a
+    // single coalesced range request. Opening a container costs two ranged
+    // fetches (header + trailing index) and a frame load typically one.
+    class RemoteReader : public Reader {
+    public:
+        // Copies len bytes at offset into dst, returning the number of bytes
+        // copied. A short count is treated as end of file; transport errors
+        // should be reported by throwing.
+        typedef std::function<size_t(int64_t offset, size_t len, void* dst)> RangeFetch;
+
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+        static constexpr size_t DEFAULT_CACHE_BYTES = 64 * 1024 * 1024;
+
+        // fileSize is the remote object's size in bytes (e.g. from a HEAD
+        // request). blockSize should cover a typical frame so per-frame reads
+        // coalesce into one fetch; cacheBytes bounds the memory held in blocks.
+        RemoteReader(RangeFetch fetch, int64_t fileSize,
+                     size_t blockSize = DEFAULT_BLOCK_SIZE, size_t cacheBytes = DEFAULT_CACHE_BYTES);
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        int64_t size() override;
+
+        // Change the block size, dropping any cached blocks. The byte budget
+        // is kept; the block count adjusts.
+        void resizeBlocks(size_t blockSize);
+
+    private:
+        struct Block {
+            int64_t index;
+            std::vector<uint8_t> data;
+        };
+
+        // Bytes of the block actually present (short at end of file)
+        size_t blockLen(int64_t block) const;
+        const Block& getBlock(int64_t block);
+        void fetchBlocks(int64_t first, int64_t last);
+
+        RangeFetch mFetch;
+        int64_t mSize;
+        size_t mBlockSize;
+        size_t mMaxBlocks;
+        size_t mCacheBytes;
+        int64_t mPos;
+
+        // Most recently used block at the front
+        std::list<Block> mBlocks;
+        std::unordered_map<int64_t, std::list<Block>::iterator> mBlockIndex;
+    };
+
+    // Local file served through the same LRU block cache as RemoteReader:
+    // every physical read is one large sequential block, so storage where
+    // small reads are latency-bound - rotational disks, network mounts -
+    // pays a few block transfers per frame instead of many scattered reads.
+    class BlockBufferedReader : public RemoteReader {
+    public:
+        BlockBufferedReader(const std::string& path, size_t blockSize,
+                            size_t cacheBytes = RemoteReader::DEFAULT_CACHE_BYTES);
+
+        ~BlockBufferedReader() override;
+
+    private:
+        BlockBufferedReader(FILE* file, size_t blockSize, size_t cacheBytes);
+
+        FILE* mFile;
+    };
+
+    // Process-wide block cache for one container file, shared by every
+    // decoder reading it through a SharedFileReader. Caches are keyed by
+    // the file's identity (device and inode where available, the path
+    // otherwise), so two opens of the same clip - an A/B comparison, or
+    // several sessions in a daemon - share one cache and each byte of
+    // index, metadata and payload is read from storage once. Thread safe;
+    // the cache lives until the last reader on the file is destroyed.
+    class SharedBlockCache {
+    public:
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+        static constexpr size_t DEFAULT_CACHE_BYTES = 64 * 1024 * 1024;
+
+        // The cache for path, created on first use and shared with every
+        // concurrent acquire() of the same file
+        static std::shared_ptr<SharedBlockCache> acquire(const std::string& path);
+
+        ~SharedBlockCache();
+
+        // Copy len bytes at offset into dst, returning the bytes copied
+        // (short at end of file). A missing block is read from the file
+        // once even when several decoders ask for it at the same time -
+        // later callers wait for the first read instead of repeating it.
+        size_t readAt(int64_t offset, size_t len, void* dst);
+
+        int64_t size() const;
+
+    private:
+        SharedBlockCache(FILE* file, int64_t size, size_t blockSize, size_t cacheBytes);
+
+        struct Block {
+            int64_t index;
+            bool ready{false};
+            std::vector<uint8_t> data;
+        };
+
+        // The block's bytes, loading it if this caller is first. Called
+        // and returns with lock held; the reference is only valid until
+        // the lock is released.
+        const Block& getBlock(int64_t block, std::unique_lock<std::mutex>& lock);
+
+        FILE* mFile;
+        const int64_t mSize;
+        const size_t mBlockSize;
+        const size_t mCacheBytes;
+
+        std::mutex mMutex;
+        std::condition_variable mLoaded;
+
+        // Most recently used block at the front; loading placeholders are
+        // pinned until they turn ready
+        std::list<Block> mBlocks;
+        std::unordered_map<int64_t, std::list<Block>::iterator> mBlockIndex;
+        size_t mBytes{0};
+
+        // Serializes the positioned reads on mFile
+        std::mutex mFileMutex;
+    };
+
+    // Reader over the file's SharedBlockCache: each reader keeps its own
+    // cursor, the bytes come from the shared cache. The reader instance
+    // itself follows the usual contract - one user at a time - but any
+    // number of readers on the same file run concurrently.
+    class SharedFileReader : public Reader {
+    public:
+        SharedFileReader(const std::string& path);
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        int64_t size() override;
+
+    private:
+        std::shared_ptr<SharedBlockCache> mCache;
+        int64_t mPos;
+    };
+
+    // Which byte ranges of a still-syncing container are present locally.
+    // The transfer side marks ranges as they land; readers and the decoder
+    // query or wait on them. Thread safe - share one map between the syncer
+    // and any number of readers.
+    class AvailabilityMap {
+    public:
+        // finalSize is the complete container's size in bytes, known up
+        // front (e.g. from the transfer manifest)
+        explicit AvailabilityMap(int64_t finalSize);
+
+        int64_t finalSize() const;
+
+        // Mark [offset, offset+len) as present, merging with adjacent
+        // ranges and waking waiters
+        void markAvailable(int64_t offset, size_t len);
+
+        // True when every byte of [offset, offset+len) is present
+        bool available(int64_t offset, size_t len) const;
+
+        // Block until [offset, offset+len) is present. timeoutMs of -1
+        // waits indefinitely; returns false on timeout.
+        bool waitFor(int64_t offset, size_t len, int timeoutMs=-1) const;
+
+        // Bytes marked present so far
+        int64_t availableBytes() const;
+
+    private:
+        bool availableLocked(int64_t begin, int64_t end) const;
+
+        const int64_t mFinalSize;
+
+        mutable std::mutex mMutex;
+        mutable std::condition_variable mChanged;
+
+        // Sorted, non-overlapping [begin, end) ranges
+        std::vector<std::pair<int64_t, int64_t>> mRanges;
+    };
+
+    // Local file still being synced, read through an AvailabilityMap. A
+    // read of a range the map has not marked fails - read() throws and
+    // tryRead() returns false - instead of returning whatever bytes the
+    // transfer has half-written there. size() reports the final size, so
+    // end-relative seeks and the trailing-index read behave as on a
+    // complete file and succeed the moment the tail is marked.
+    class PartialFileReader : public Reader {
+    public:
+        PartialFileReader(const std::string& path, std::shared_ptr<AvailabilityMap> availability);
+
+        ~PartialFileReader() override;
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        int64_t size() override;
+
+        const std::shared_ptr<AvailabilityMap>& availability() const { return mAvailability; }
+
+    private:
+        FILE* mFile;
+        std::shared_ptr<AvailabilityMap> mAvailability;
+        int64_t mPos;
+    };
+
+    // Best-effort storage profile of the filesystem holding path. On Linux
+    // network filesystems are recognised by their statfs magic and local
+    // devices by the sysfs rotational flag; elsewhere, and whenever
+    // detection fails, LOCAL_SSD is assumed.
+    StorageProfile detectStorageProfile(const std::string& path);
+
+    // Reader suited to where the container lives: block-buffered reads for
+    // HDD and NETWORK, direct small reads (io_uring where available) for
+    // LOCAL_SSD, detection for AUTO.
+    std::unique_ptr<Reader> createReaderForProfile(const std::string& path, StorageProfile profile);
+
+#if !defined(_WIN32)
+    // Positioned-read backend for POSIX platforms without a native
+    // asynchronous I/O ring - macOS review stations in particular, which
+    // get neither io_uring nor overlapped I/O. Scalar reads go through
+    // pread; readBatch fans the regions across the shared thread pool's
+    // I/O lanes so the device sees several reads in flight, and advise()
+    // maps to F_RDADVISE on Apple platforms (posix_fadvise elsewhere).
+    // The default local-flash backend on macOS via createReaderForProfile.
+    class PreadPoolReader : public Reader {
+    public:
+        PreadPoolReader(const std::string& path);
+
+        ~PreadPoolReader() override;
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        int64_t size() override;
+        void advise(int64_t offset, size_t len, Advice advice) override;
+        void readBatch(const std::vector<ReadRequest>& requests) override;
+
+    private:
+        int mFd;
+        int64_t mPos;
+        int64_t mSize;
+    };
+#endif
+
+#if defined(__linux__)
+    // io_uring backend. Scalar reads go through pread; readBatch submits every
+    // region to the ring at once so the device runs at full queue depth.
+    class UringReader : public Reader {
+    public:
+        UringReader(const std::string& path);
+
+        ~UringReader() override;
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        int64_t size() override;
+        void advise(int64_t offset, size_t len, Advice advice) override;
+        void readBatch(const std::vector<ReadRequest>& requests) override;
+
+    private:
+        struct Ring;
+
+        int mFd;
+        int64_t mPos;
+        int64_t mSize;
+        std::unique_ptr<Ring> mRing;
+    };
+#endif
+
+#if defined(_WIN32)
+    // Overlapped I/O backend. Scalar reads go through overlapped ReadFile;
+    // readBatch issues every region at once and drains a completion port so
+    // the device runs at full queue depth.
+    class OverlappedReader : public Reader {
+    public:
+        OverlappedReader(const std::string& path);
+
+        ~OverlappedReader() override;
+
+        void read(void* data, size_t size, size_t items=1) override;
+        bool tryRead(void* data, size_t size) override;
+        bool seek(int64_t offset, int origin) override;
+        int64_t size() override;
+        void readBatch(const std::vector<ReadRequest>& requests) override;
+
+    private:
+        bool readAt(void* data, size_t size, int64_t offset);
+
+        void* mFile;
+        void* mCompletionPort;
+        int64_t mPos;
+        int64_t mSize;
+    };
+#endif
+} // namespace motioncam
+
+#endif /* Reader_hpp */
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RingBuffer_hpp
+#define RingBuffer_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Bounded lock-free ring buffers used as the interconnect between
+// pipeline stages: the sequential scan's I/O thread feeding the decode
+// loop (SPSC) and the example's DNG writer threads returning recycled
+// jobs to the decode thread (MPSC). Handing a frame across a stage
+// boundary costs a couple of atomic operations instead of a mutex and a
+// condition variable wake, and the indices live on their own cache lines
+// so the producer and consumer do not ping-pong a line between cores.
+//
+// Neither ring blocks; both ends expose try operations plus batched
+// variants that publish a whole run of items with a single release
+// store. Callers that need to wait spin through a Backoff, which decays
+// to sleeping well under a frame time - at frame-granularity traffic the
+// worst-case added latency is noise, and nothing holds a lock while it
+// waits.
+namespace motioncam {
+    constexpr size_t RING_CACHE_LINE = 64;
+
+    namespace ringbuffer {
+        inline size_t RoundUpPow2(size_t n) {
+            size_t p = 1;
+
+            while(p < n)
+                p <<= 1;
+
+            return p;
+        }
+
+        // Progressive waiting policy for the loops around a ring: retry
+        // immediately a few times, then yield, then sleep in short slices
+        class Backoff {
+        public:
+            void wait() {
+                if(mCount < 16)
+                    ;   // immediate retry; the other end is likely mid-operation
+                else if(mCount < 64)
+                    std::this_thread::yield();
+                else
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+                if(mCount < 64)
+                    mCount++;
+            }
+
+            void reset() {
+                mCount = 0;
+            }
+
+        private:
+            unsigned mCount{0};
+        };
+    }
+
+    // Single-producer single-consumer ring. Each end advances only its
+    // own index and keeps a cached copy of the other end's, so in the
+    // common case a push or pop touches no shared state beyond its own
+    // release store; the opposing index is re-read only when the cache
+    // says the ring looks full or empty.
+    template<typename T>
+    class SpscRingBuffer {
+    public:
+        // Capacity is rounded up to a power of two
+        explicit SpscRingBuffer(size_t capacity)
+            : mCapacity(ringbuffer::RoundUpPow2(capacity < 2 ? 2 : capacity)),
+              mMask(mCapacity - 1),
+              mSlots(mCapacity)
+        {
+        }
+
+        SpscRingBuffer(const SpscRingBuffer&) = delete;
+        SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+        // Producer side. The value is moved only on success
+        bool tryPush(T&& value) {
+            const size_t tail = mTail.load(std::memory_order_relaxed);
+
+            if(tail - mCachedHead == mCapacity) {
+                mCachedHead = mHead.load(std::memory_order_acquire);
+
+                if(tail - mCachedHead == mCapacity)
+                    return false;
+            }
+
+            mSlots[tail & mMask] = std::move(value);
+            mTail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Push up to count items, publishing the run with one release
+        // store. Returns how many were taken
+        size_t tryPushBatch(T* values, size_t count) {
+            const size_t tail = mTail.load(std::memory_order_relaxed);
+            size_t free = mCapacity - (tail - mCachedHead);
+
+            if(free < count) {
+                mCachedHead = mHead.load(std::memory_order_acquire);
+                free = mCapacity - (tail - mCachedHead);
+            }
+
+            const size_t n = free < count ? free : count;
+
+            for(size_t i = 0; i < n; i++)
+                mSlots[(tail + i) & mMask] = std::move(values[i]);
+
+            if(n > 0)
+                mTail.store(tail + n, std::memory_order_release);
+
+            return n;
+        }
+
+        // Consumer side
+        bool tryPop(T& out) {
+            const size_t head = mHead.load(std::memory_order_relaxed);
+
+            if(head == mCachedTail) {
+                mCachedTail = mTail.load(std::memory_order_acquire);
+
+                if(head == mCachedTail)
+                    return false;
+            }
+
+            out = std::move(mSlots[head & mMask]);
+            mHead.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Pop up to count items, retiring the run with one release store.
+        // Returns how many were delivered
+        size_t tryPopBatch(T* out, size_t count) {
+            const size_t head = mHead.load(std::memory_order_relaxed);
+            size_t available = mCachedTail - head;
+
+            if(available < count) {
+                mCachedTail = mTail.load(std::memory_order_acquire);
+                available = mCachedTail - head;
+            }
+
+            const size_t n = available < count ? available : count;
+
+            for(size_t i = 0; i < n; i++)
+                out[i] = std::move(mSlots[(head + i) & mMask]);
+
+            if(n > 0)
+                mHead.store(head + n, std::memory_order_release);
+
+            return n;
+        }
+
+        // Approximate when read from outside the producing or consuming
+        // thread; a stale read only overestimates occupancy, so a producer
+        // gating on size() errs toward waiting
+        size_t size() const {
+            return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        size_t capacity() const {
+            return mCapacity;
+        }
+
+    private:
+        const size_t mCapacity;
+        const size_t mMask;
+        std::vector<T> mSlots;
+
+        // Consumer-owned line: its index plus its cached view of the tail
+        alignas(RING_CACHE_LINE) std::atomic<size_t> mHead{0};
+        size_t mCachedTail{0};
+
+        // Producer-owned line
+        alignas(RING_CACHE_LINE) std::atomic<size_t> mTail{0};
+        size_t mCachedHead{0};
+    };
+
+    // Multi-producer single-consumer ring: producers claim a slot with a
+    // compare-and-swap on the tail and each slot carries a sequence
+    // number that flips to "filled" only once its value is in place, so
+    // the consumer never observes a half-written slot. Slots are padded
+    // to a cache line; producers completing out of order write disjoint
+    // lines.
+    template<typename T>
+    class MpscRingBuffer {
+    public:
+        // Capacity is rounded up to a power of two
+        explicit MpscRingBuffer(size_t capacity)
+            : mCapacity(ringbuffer::RoundUpPow2(capacity < 2 ? 2 : capacity)),
+              mMask(mCapacity - 1),
+              mSlots(mCapacity)
+        {
+            for(size_t i = 0; i < mCapacity; i++)
+                mSlots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MpscRingBuffer(const MpscRingBuffer&) = delete;
+        MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+        // Any thread. The value is moved only on success
+        bool tryPush(T&& value) {
+            size_t tail = mTail.load(std::memory_order_relaxed);
+
+            for(;;) {
+                Slot& slot = mSlots[tail & mMask];
+                const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(tail);
+
+                if(diff == 0) {
+                    if(mTail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                        slot.value = std::move(value);
+                        slot.sequence.store(tail + 1, std::memory_order_release);
+
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                    return false;   // Full
+                else
+                    tail = mTail.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Consuming thread only
+        bool tryPop(T& out) {
+            const size_t head = mHead.load(std::memory_order_relaxed);
+            Slot& slot = mSlots[head & mMask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+            // Empty, or a producer claimed the slot but has not filled it
+            if(static_cast<intptr_t>(sequence) - static_cast<intptr_t>(head + 1) < 0)
+                return false;
+
+            out = std::move(slot.value);
+
+            slot.sequence.store(head + mCapacity, std::memory_order_release);
+            mHead.store(head + 1, std::memory_order_relaxed);
+
+            return true;
+        }
+
+        // Consuming thread only. Returns how many were delivered
+        size_t tryPopBatch(T* out, size_t count) {
+            size_t n = 0;
+
+            while(n < count && tryPop(out[n]))
+                n++;
+
+            return n;
+        }
+
+        size_t capacity() const {
+            return mCapacity;
+        }
+
+    private:
+        struct alignas(RING_CACHE_LINE) Slot {
+            std::atomic<size_t> sequence{0};
+            T value{};
+        };
+
+        const size_t mCapacity;
+        const size_t mMask;
+        std::vector<Slot> mSlots;
+
+        alignas(RING_CACHE_LINE) std::atomic<size_t> mHead{0};
+        alignas(RING_CACHE_LINE) std::atomic<size_t> mTail{0};
+    };
+}
+
+#endif /* RingBuffer_hpp */
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SegmentedDecoder_hpp
+#define SegmentedDecoder_hpp
+
+#include <motioncam/Decoder.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace motioncam {
+    // Presents the segments of one split recording (<name>.0.mcraw,
+    // <name>.1.mcraw, ...) as a single container: the per-segment frame
+    // indexes are merged into one timestamp-sorted timeline and frame loads
+    // route to whichever segment holds the frame, so downstream code sees
+    // the usual getFrames()/loadFrame() surface with no temp-file
+    // concatenation and no copies. Segment indexes load in parallel on the
+    // shared pool, so opening a long recording costs about one segment's
+    // open time. Not thread safe; clone per consuming thread via the
+    // underlying decoders if needed.
+    class SegmentedDecoder {
+    public:
+        // Opens path and every numbered sibling. A path matching
+        // <prefix>.<n>.<ext> pulls in all segments of the recording,
+        // starting from segment 0 regardless of which one was given; any
+        // other path opens as a single segment.
+        explicit SegmentedDecoder(const std::string& path, ReadMode mode=ReadMode::BUFFERED);
+
+        size_t numSegments() const;
+
+        // Access an underlying segment decoder, e.g. for audio or stats
+        Decoder& getSegment(size_t segment);
+
+        // Container metadata of the first segment; the capture app writes
+        // the same camera metadata into every segment
+        const nlohmann::json& getContainerMetadata() const;
+        const ContainerMetadata& getTypedContainerMetadata() const;
+
+        // All frame timestamps across every segment, sorted
+        const std::vector<Timestamp>& getFrames() const;
+
+        // As Decoder::findFrame, over the merged timeline
+        int64_t findFrame(const Timestamp timestamp, SeekMode mode=SeekMode::NEAREST) const;
+
+        // Load a frame by its index into getFrames(). Throws when the index
+        // is out of range.
+        void loadFrameByIndex(size_t frameIndex, std::vector<uint16_t>& outData, nlohmann::json& outMetadata);
+
+        // Load a single frame and its metadata from whichever segment holds it
+        void loadFrame(const Timestamp timestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata);
+
+        // Load a frame's compressed payload and metadata bytes without
+        // decoding them, as Decoder::loadFramePayload
+        void loadFramePayload(const Timestamp timestamp, std::vector<uint8_t>& outPayload, std::vector<uint8_t>& outMetadataJson);
+
+        // Audio of every segment, concatenated in segment order
+        void loadAudio(std::vector<AudioChunk>& outAudioChunks);
+
+        // Start timestamp of the first segment's audio stream
+        int64_t audioStartTimestampMs() const;
+
+    private:
+        Decoder& decoderFor(const Timestamp timestamp);
+
+        std::vector<std::unique_ptr<Decoder>> mDecoders;
+        std::vector<Timestamp> mFrameList;
+        // Segment index of each entry of mFrameList
+        std::vector<uint32_t> mFrameSegment;
+    };
+} // namespace motioncam
+
+#endif /* SegmentedDecoder_hpp */
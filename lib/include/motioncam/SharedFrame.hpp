@@ -0,0 +1,97 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SharedFrame_hpp
+#define SharedFrame_hpp
+
+#include <motioncam/Decoder.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace motioncam {
+    // Layout of a shared frame segment: this header, then width*height
+    // uint16 pixels. The header is written after the pixels, so a consumer
+    // that sees a matching frameCounter in it has a complete frame.
+    struct SharedFrameHeader {
+        static constexpr uint32_t MAGIC = 0x4653434Du;  // 'MCSF'
+        static constexpr uint32_t VERSION = 1;
+
+        uint32_t magic;
+        uint32_t version;
+        uint64_t frameCounter;      // Incremented once per completed write
+        Timestamp timestamp;
+        int32_t width;
+        int32_t height;
+        int32_t cfaLayout;          // ColorFilterArrangement of the source container
+        int32_t reserved;
+    };
+
+#if !defined(_WIN32)
+    // Decodes frames straight into a named shared-memory segment
+    // (shm_open) that another process maps, so frames cross process
+    // boundaries without touching the filesystem or being copied: the
+    // decode kernels' stores are the delivery. The segment is created by
+    // the writer, grown when a larger frame arrives, and unlinked when the
+    // writer is destroyed; consumers attach with SharedFrameView.
+    class SharedFrameWriter {
+    public:
+        // name follows shm_open convention, e.g. "/mydenoiser-frame"
+        explicit SharedFrameWriter(const std::string& name);
+
+        ~SharedFrameWriter();
+
+        SharedFrameWriter(const SharedFrameWriter&) = delete;
+        SharedFrameWriter& operator=(const SharedFrameWriter&) = delete;
+
+        // Decode the frame at timestamp into the segment. The steady state
+        // decodes into the mapped pixels directly; only a frame larger than
+        // the segment pays a regrow and one copy.
+        void write(Decoder& decoder, const Timestamp timestamp);
+
+    private:
+        void resize(size_t pixelBytes);
+
+        std::string mName;
+        int mFd{-1};
+        uint8_t* mMapped{nullptr};
+        size_t mMappedBytes{0};
+        uint64_t mFrameCounter{0};
+    };
+
+    // Read side of a shared frame segment. Maps the segment named by the
+    // writer; header() and data() point into shared memory, so a frame's
+    // pixels are valid while its frameCounter stays unchanged.
+    class SharedFrameView {
+    public:
+        explicit SharedFrameView(const std::string& name);
+
+        ~SharedFrameView();
+
+        SharedFrameView(const SharedFrameView&) = delete;
+        SharedFrameView& operator=(const SharedFrameView&) = delete;
+
+        const SharedFrameHeader& header() const;
+        const uint16_t* data() const;
+
+    private:
+        uint8_t* mMapped{nullptr};
+        size_t mMappedBytes{0};
+    };
+#endif
+}
+
+#endif /* SharedFrame_hpp */
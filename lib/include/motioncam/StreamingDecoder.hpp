@@ -0,0 +1,88 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef StreamingDecoder_hpp
+#define StreamingDecoder_hpp
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/RawData.hpp>
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace motioncam {
+    // Decodes a container arriving over a non-seekable byte stream - a
+    // pipe, socket, or stdin - where Decoder cannot open it because its
+    // index read seeks to the end of the file. Items are parsed strictly
+    // forward in the order the recorder writes them (every frame's BUFFER
+    // item immediately followed by its METADATA item), each frame decoding
+    // as soon as its bytes arrive with one payload's worth of buffering,
+    // so live relay input needs no spool to disk and no index. Not thread
+    // safe.
+    class StreamingDecoder {
+    public:
+        // Reads the container header and camera metadata before returning,
+        // so the metadata accessor is immediately valid. The stream must
+        // deliver a container from its first byte; the caller keeps
+        // ownership of it.
+        explicit StreamingDecoder(FILE* stream);
+
+        StreamingDecoder(const StreamingDecoder&) = delete;
+        StreamingDecoder& operator=(const StreamingDecoder&) = delete;
+
+        // Get container metadata
+        const nlohmann::json& getContainerMetadata() const;
+
+        // Called for each audio chunk encountered between frames, in
+        // stream order. The sample pointer aliases an internal buffer and
+        // is only valid for the duration of the call; chunks without
+        // timestamp metadata report a timestamp of -1.
+        typedef std::function<void(Timestamp, const int16_t* samples, size_t numSamples)> AudioCallback;
+
+        void setAudioCallback(AudioCallback callback);
+
+        // Decode the next frame in stream order, blocking until its bytes
+        // arrive. Audio encountered on the way goes through the callback.
+        // Returns false at the end of the stream or when the trailing
+        // index begins - there are no frames after it.
+        bool nextFrame(Timestamp& outTimestamp, std::vector<uint16_t>& outData, nlohmann::json& outMetadata);
+
+        // Number of frames delivered so far
+        size_t numFrames() const;
+
+    private:
+        bool readExact(void* data, size_t size);
+        void skip(size_t size);
+        void flushPendingAudio(Timestamp timestamp);
+
+        FILE* mStream;
+        bool mEnded{false};
+        size_t mNumFrames{0};
+        nlohmann::json mMetadata;
+        AudioCallback mAudioCallback;
+        raw::DecodeContext mDecodeContext;
+
+        // Scratch reused between frames, so steady-state streaming makes
+        // no per-frame allocation
+        std::vector<uint8_t> mPayload;
+        std::vector<uint8_t> mMetadataJson;
+        std::vector<int16_t> mAudioSamples;
+        bool mAudioPending{false};
+    };
+} // namespace motioncam
+
+#endif /* StreamingDecoder_hpp */
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace motioncam {
+    // Scheduling classes, highest first. Interactive work - a frame the UI
+    // is waiting on - runs before everything, I/O completions run before
+    // ordinary decode work so the readers stay fed, and export work fills
+    // whatever is left.
+    enum class Priority {
+        INTERACTIVE,
+        IO,
+        DECODE,
+        EXPORT
+    };
+
+    // Small work-stealing worker pool used to spread frame decodes across
+    // cores. Every worker owns a deque per priority: tasks spawned from a
+    // worker go to that worker's own queue and run newest first, keeping
+    // nested work local, while idle workers steal the oldest task from
+    // another worker - and all higher-priority work anywhere in the pool
+    // runs before any lower. Several subsystems can share one pool through
+    // TaskGroup instead of each spawning a pool that oversubscribes the
+    // machine; shared() is the process-wide instance meant for that.
+    //
+    // Built with MOTIONCAM_WITH_NUMA, workers are divided into contiguous
+    // blocks across the NUMA nodes, pinned to their node's CPUs and set to
+    // prefer node-local memory - first-touch then places each worker's
+    // decode buffers on its own socket - and idle workers steal from their
+    // own node before crossing the interconnect.
+    //
+    // On heterogeneous (big.LITTLE / P+E) machines, one worker per
+    // efficiency core is pinned to the efficiency cluster and prefers I/O
+    // work, while the rest are pinned to the performance cores and keep
+    // the priority order that favours decode - so raw::Decode stripes run
+    // on the fast cores while reads and metadata parsing fill the slow
+    // ones, instead of the scheduler placing them arbitrarily. All workers
+    // still run anything when their preferred lanes are empty.
+    class ThreadPool {
+    public:
+        // numThreads of 0 uses the hardware concurrency
+        explicit ThreadPool(size_t numThreads=0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // The process-wide pool, sized to the hardware concurrency. Batch
+        // loads, striped decode and index recovery run on it by default, so
+        // mixed workloads share the cores instead of thrashing them.
+        static ThreadPool& shared();
+
+        size_t numThreads() const { return mThreads.size(); }
+
+        // Queue a task for execution on a worker thread
+        void enqueue(Priority priority, std::function<void()> task);
+
+        void enqueue(std::function<void()> task) {
+            enqueue(Priority::DECODE, std::move(task));
+        }
+
+        // Block until all queued and running tasks have completed
+        void waitAll();
+
+        // True while any INTERACTIVE task is queued. Cheap enough to poll
+        // from a decode inner loop.
+        bool interactivePending() const {
+            return mInteractivePending.load(std::memory_order_relaxed) > 0;
+        }
+
+        // Run one queued INTERACTIVE task on the calling thread, if any.
+        // Long-running background tasks call this at their preemption
+        // points, so an interactive request starts within one row group
+        // even when every worker is busy with an export.
+        bool assistInteractive();
+
+    private:
+        friend class TaskGroup;
+
+        static const int NUM_PRIORITIES = 4;
+
+        // Per-worker state; the deques are guarded by the worker's own
+        // mutex so enqueue and steal don't serialize on one global lock
+        struct Worker {
+            std::deque<std::function<void()>> queues[NUM_PRIORITIES];
+            std::mutex mutex;
+            int node{0};            // NUMA node the worker is pinned to
+            bool efficiency{false}; // Pinned to efficiency cores on hybrid machines
+        };
+
+        void workerLoop(size_t self);
+        bool takeTask(size_t self, std::function<void()>& outTask);
+        bool takeInteractiveTask(std::function<void()>& outTask);
+
+        // Run one queued task on the calling thread if any is available.
+        // TaskGroup::wait uses it to keep making progress when waiting from
+        // a worker thread.
+        bool runOneTask();
+
+    private:
+        std::vector<std::thread> mThreads;
+        std::vector<std::unique_ptr<Worker>> mWorkers;
+        std::atomic<size_t> mNextWorker;
+        std::atomic<int> mInteractivePending{0};
+        std::mutex mMutex;
+        std::condition_variable mTaskAvailable;
+        std::condition_variable mAllDone;
+        size_t mNumTasks;
+        size_t mNumActive;
+        bool mShutdown;
+    };
+
+    // Tracks a set of tasks submitted to a pool, so a caller can wait for
+    // just its own work while other subsystems keep the same pool busy.
+    // When wait() is called from a pool worker it runs queued tasks instead
+    // of blocking the worker, so nested parallelism cannot deadlock the
+    // pool. A group must outlive its tasks; wait() before destroying it.
+    class TaskGroup {
+    public:
+        // Submit a task to the pool as part of this group. Every call must
+        // use the same pool.
+        void run(ThreadPool& pool, Priority priority, std::function<void()> task);
+
+        // Block until every task submitted through this group has finished
+        void wait();
+
+    private:
+        ThreadPool* mPool{nullptr};
+        std::mutex mMutex;
+        std::condition_variable mDone;
+        size_t mOutstanding{0};
+    };
+} // namespace motioncam
+
+#endif /* ThreadPool_hpp */
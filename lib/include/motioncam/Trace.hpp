@@ -0,0 +1,93 @@
+#ifndef Trace_hpp
+#define Trace_hpp
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+
+// Chrome-trace span emission for the decode pipeline. Spans wrap the
+// pipeline phases (payload read, metadata parse, decode) and are written
+// as chrome://tracing / Perfetto compatible JSON, giving a per-thread
+// timeline of where a slow export actually spends its time.
+//
+// The macros are compiled in by default; define MOTIONCAM_DECODER_TRACING=0
+// to compile them down to nothing. When compiled in, collection still
+// stays off - a span site costs one relaxed atomic load - until enabled
+// with trace::Begin() or by setting the MOTIONCAM_TRACE environment
+// variable to the output path, which traces the whole process lifetime.
+#ifndef MOTIONCAM_DECODER_TRACING
+    #define MOTIONCAM_DECODER_TRACING 1
+#endif
+
+namespace motioncam {
+    namespace trace {
+        // Set while a trace is being collected. Read it through the
+        // macros rather than directly.
+        extern std::atomic<bool> gCollecting;
+
+        // Start collecting spans; the trace is written to path by End()
+        // (or at process exit when started via MOTIONCAM_TRACE)
+        void Begin(const std::string& path);
+
+        // Stop collecting and write the JSON. Safe to call when no
+        // trace is active.
+        void End();
+
+        // Record one complete span. name must outlive the trace (the
+        // macros pass string literals).
+        void EmitSpan(const char* name, int64_t startUs, int64_t durationUs);
+
+        // Microseconds on the trace clock
+        int64_t NowUs();
+
+#if MOTIONCAM_DECODER_TRACING
+        // Measures from construction to destruction and emits the span;
+        // does nothing at all while no trace is active
+        class ScopedSpan {
+        public:
+            explicit ScopedSpan(const char* name)
+                : mName(name), mStart(gCollecting.load(std::memory_order_relaxed) ? NowUs() : -1)
+            {
+            }
+
+            ~ScopedSpan() {
+                if(mStart >= 0)
+                    EmitSpan(mName, mStart, NowUs() - mStart);
+            }
+
+            ScopedSpan(const ScopedSpan&) = delete;
+            ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+        private:
+            const char* mName;
+            const int64_t mStart;
+        };
+#endif
+    }
+}
+
+#if MOTIONCAM_DECODER_TRACING
+    #define MOTIONCAM_TRACE_CONCAT2(a, b) a##b
+    #define MOTIONCAM_TRACE_CONCAT(a, b) MOTIONCAM_TRACE_CONCAT2(a, b)
+
+    // Span covering the rest of the enclosing scope
+    #define MOTIONCAM_TRACE_SCOPE(name) \
+        ::motioncam::trace::ScopedSpan MOTIONCAM_TRACE_CONCAT(_traceSpan, __LINE__)(name)
+
+    // Explicit begin/end pair for phases that do not line up with a
+    // scope, in the mould of STAT_TIMER/STAT_TIMER_END
+    #define MOTIONCAM_TRACE_BEGIN(var) \
+        const int64_t _traceStart_##var = ::motioncam::trace::gCollecting.load(std::memory_order_relaxed) \
+            ? ::motioncam::trace::NowUs() : -1
+    #define MOTIONCAM_TRACE_END(var, name) \
+        do { \
+            if(_traceStart_##var >= 0) \
+                ::motioncam::trace::EmitSpan((name), _traceStart_##var, ::motioncam::trace::NowUs() - _traceStart_##var); \
+        } while(0)
+#else
+    #define MOTIONCAM_TRACE_SCOPE(name)
+    #define MOTIONCAM_TRACE_BEGIN(var) do {} while(0)
+    #define MOTIONCAM_TRACE_END(var, name) do {} while(0)
+#endif
+
+#endif /* Trace_hpp */
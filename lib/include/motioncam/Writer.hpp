@@ -0,0 +1,107 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef Writer_hpp
+#define Writer_hpp
+
+#include <motioncam/Container.hpp>
+#include <motioncam/Decoder.hpp>
+#include <nlohmann/json.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace motioncam {
+    // Streaming .mcraw container writer, the counterpart of Decoder. Frames
+    // and audio chunks are appended through a buffered file in one strictly
+    // sequential pass while the frame, audio and checksum indexes accumulate
+    // in memory; finish() emits them at the end of the file in the layout
+    // Decoder's index read expects. Nothing is ever seeked back and patched,
+    // so trimming, proxy generation and repacking jobs are single front-to-
+    // back passes over their source.
+    class Writer {
+    public:
+        // Creates the container at path and writes the header and camera
+        // metadata. version selects the layout: CONTAINER_VERSION_4 aligns
+        // every frame payload to PAYLOAD_ALIGNMENT and writes index entries
+        // carrying the payload and metadata sizes, CONTAINER_VERSION writes
+        // the compact version 3 stream.
+        Writer(const std::string& path,
+               const nlohmann::json& containerMetadata,
+               const uint8_t version = CONTAINER_VERSION_4);
+
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // Record a Hash64 of every payload as it is written and emit a
+        // CHECKSUM_INDEX item in finish(), for archival copies (see
+        // Decoder::enableChecksumVerification). Must be called before the
+        // first frame so every frame is covered.
+        void enableChecksumIndex();
+
+        // Appends one compressed frame payload (see raw::Encode) and its
+        // metadata. Frames may arrive in any order; the index entries are
+        // sorted by timestamp in finish().
+        void writeFrame(const Timestamp timestamp,
+                        const uint8_t* payload,
+                        const size_t payloadSize,
+                        const std::string& metadata);
+
+        void writeFrame(const Timestamp timestamp,
+                        const std::vector<uint8_t>& payload,
+                        const nlohmann::json& metadata);
+
+        // Appends one chunk of 16 bit audio samples, channel-interleaved at
+        // the rate the container metadata declares
+        void writeAudio(const Timestamp timestampNs, const int16_t* samples, const size_t numSamples);
+
+        void writeAudio(const AudioChunk& chunk);
+
+        // Wall clock start of the audio track in milliseconds, stored in the
+        // audio index (see Decoder::audioStartTimestampMs)
+        void setAudioStartTimestampMs(const int64_t startTimestampMs);
+
+        // Writes the indexes and closes the file. The destructor calls this
+        // if it hasn't run, but only an explicit call reports failures.
+        void finish();
+
+        size_t numFrames() const { return mOffsets.size(); }
+        size_t numAudioChunks() const { return mAudioOffsets.size(); }
+
+    private:
+        void write(const void* data, size_t size);
+        void writeItem(const Type type, const uint32_t size);
+        void align();
+
+    private:
+        std::string mPath;
+        FILE* mFile;
+        int64_t mPos;
+        uint8_t mVersion;
+        bool mChecksums;
+        bool mFinished;
+        int64_t mAudioStartTimestampMs;
+        std::vector<char> mIoBuffer;
+        std::vector<BufferOffsetV4> mOffsets;
+        std::vector<BufferOffset> mAudioOffsets;
+        std::vector<ChecksumEntry> mChecksumEntries;
+    };
+}
+
+#endif /* Writer_hpp */
@@ -317,6 +317,11 @@ class DNGWriter {
   /// Returns true upon success.
   bool WriteToFile(const char *filename, std::string *err) const;
 
+  /// Write DNG to a seekable output stream.
+  /// Return error string to `err` when Write() returns false.
+  /// Returns true upon success.
+  bool WriteToStream(std::ostream *ofs, std::string *err) const;
+
  private:
   bool swap_endian_;
   bool dng_big_endian_;  // Endianness of DNG file.
@@ -1915,6 +1920,12 @@ bool DNGWriter::WriteToFile(const char *filename, std::string *err) const {
     return false;
   }
 
+  return WriteToStream(&ofs, err);
+}
+
+bool DNGWriter::WriteToStream(std::ostream *ofs_ptr, std::string *err) const {
+  std::ostream &ofs = *ofs_ptr;
+
   std::ostringstream header;
   bool ret = WriteTIFFVersionHeader(&header, dng_big_endian_);
   if (!ret) {
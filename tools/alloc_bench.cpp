@@ -0,0 +1,206 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Allocation regression harness. Replaces the global allocator with a
+// counting shim and measures heap allocations per pipeline phase - open,
+// first loadFrame, steady-state loadFrame, loadAudio, raw::Decode - on a
+// synthesized (or given) container. Fails the run when a steady-state
+// frame load or decode touches the heap, so per-frame allocations that
+// creep back into the hot paths break the bench suite instead of
+// resurfacing in a profile months later.
+//
+// Usage: alloc_bench [container]
+//
+// Phases run on the calling thread and the counters are per thread, so
+// the numbers are not polluted by pool workers.
+
+#include <motioncam/AllocStats.hpp>
+#include <motioncam/Decoder.hpp>
+#include <motioncam/RawData.hpp>
+#include <motioncam/Writer.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// The counting shim: every allocation in this binary, including the
+// library's, goes through Record()
+void* operator new(std::size_t size) {
+    motioncam::allocstats::Record(size);
+
+    void* p = std::malloc(size);
+
+    if(!p)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+using namespace motioncam;
+
+namespace {
+    constexpr int WIDTH = 1920;
+    constexpr int HEIGHT = 1080;
+    constexpr int NUM_FRAMES = 8;
+
+    // A small clip with timestamped frames and audio, when no container
+    // was given
+    std::string synthesize() {
+        const std::string path = "/tmp/alloc_bench.mcraw";
+
+        nlohmann::json metadata;
+        metadata["audioSampleRate"] = 48000;
+        metadata["audioChannels"] = 1;
+
+        Writer writer(path, metadata);
+
+        std::mt19937 rng(42);
+        std::vector<int16_t> audio(4800, 0);
+
+        for(int i = 0; i < NUM_FRAMES; i++) {
+            std::vector<uint16_t> image(static_cast<size_t>(WIDTH) * HEIGHT);
+
+            for(auto& v : image)
+                v = rng() & 0x3ff;
+
+            std::vector<uint8_t> payload;
+            raw::Encode(image.data(), WIDTH, HEIGHT, payload);
+
+            const Timestamp timestamp = (i + 1) * 33000000LL;
+
+            writer.writeFrame(timestamp, payload.data(), payload.size(),
+                "{\"width\":" + std::to_string(WIDTH) + ",\"height\":" + std::to_string(HEIGHT) +
+                ",\"compressionType\":7,\"timestamp\":" + std::to_string(timestamp) + "}");
+
+            writer.writeAudio(timestamp, audio.data(), audio.size());
+        }
+
+        writer.finish();
+
+        return path;
+    }
+
+    allocstats::Snapshot report(const char* phase, const allocstats::Snapshot& start) {
+        const auto used = allocstats::Since(start);
+
+        std::printf("%-24s %8llu allocations %12llu bytes\n",
+            phase,
+            static_cast<unsigned long long>(used.numAllocations),
+            static_cast<unsigned long long>(used.bytesAllocated));
+
+        return used;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    try {
+        const std::string path = argc > 1 ? argv[1] : synthesize();
+
+        allocstats::Enable();
+
+        auto start = allocstats::Current();
+        auto decoder = std::make_unique<Decoder>(path);
+        report("open", start);
+
+        const auto& frames = decoder->getFrames();
+
+        if(frames.empty()) {
+            std::printf("No frames in %s\n", path.c_str());
+            return -1;
+        }
+
+        nlohmann::json metadata;
+        std::vector<uint16_t> buffer;
+
+        // First load grows every scratch buffer
+        start = allocstats::Current();
+        decoder->loadFrame(frames[0], buffer, metadata);
+        report("loadFrame first", start);
+
+        const size_t capacity = buffer.size();
+
+        // One full warmup pass grows every scratch buffer to its high-water
+        // mark; after it the path must hold at zero
+        for(size_t i = 0; i < frames.size(); i++)
+            decoder->tryLoadFrame(frames[i], buffer.data(), capacity);
+
+        start = allocstats::Current();
+
+        for(size_t i = 0; i < frames.size(); i++) {
+            if(!decoder->tryLoadFrame(frames[i], buffer.data(), capacity).ok()) {
+                std::printf("Frame load failed\n");
+                return -1;
+            }
+        }
+
+        const auto steady = report("loadFrame steady", start);
+
+        start = allocstats::Current();
+        std::vector<AudioChunk> audio;
+        decoder->loadAudio(audio);
+        report("loadAudio", start);
+
+        // Bare decode of one payload through a reused context
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> metadataJson;
+        decoder->loadFramePayload(frames[0], payload, metadataJson);
+
+        const int width = metadata["width"];
+        const int height = metadata["height"];
+
+        raw::DecodeContext context;
+        std::vector<uint16_t> output(static_cast<size_t>(width) * (4 * ((height + 3) / 4)));
+
+        raw::Decode(output.data(), width, height, payload.data(), payload.size(), context);
+
+        start = allocstats::Current();
+
+        allocstats::Snapshot decode{};
+
+        for(int i = 0; i < 4; i++)
+            raw::Decode(output.data(), width, height, payload.data(), payload.size(), context);
+
+        decode = report("raw::Decode steady", start);
+
+        allocstats::Disable();
+
+        if(steady.numAllocations > 0 || decode.numAllocations > 0) {
+            std::printf("FAIL: steady-state hot path allocated\n");
+            return 1;
+        }
+
+        std::printf("OK: steady-state hot paths allocation-free\n");
+    }
+    catch(const std::exception& e) {
+        std::printf("Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
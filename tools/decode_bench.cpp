@@ -0,0 +1,345 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Microbenchmark for the per-bit-depth decode kernels. Builds synthetic
+// frames whose blocks all use one bits value, runs them through raw::Decode
+// in a tight loop and reports throughput per kernel. On Linux, hardware
+// performance counters are sampled around each kernel loop when
+// perf_event is available, adding IPC, cache miss and branch mispredict
+// rates - GB/s alone cannot say whether a kernel is bandwidth- or
+// port-bound.
+
+#include <motioncam/RawData.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+    constexpr int WIDTH = 4096;
+    constexpr int HEIGHT = 1024;
+    constexpr int ENCODING_BLOCK = 64;
+
+    constexpr int ENCODING_BLOCK_LENGTH[] = {
+        0, 8, 16, 24, 32, 40, 48, 64, 64, 80, 80, 128, 128, 128, 128, 128, 128
+    };
+
+    void put32(std::vector<uint8_t>& v, uint32_t x) {
+        v.push_back(x & 0xFF);
+        v.push_back((x >> 8) & 0xFF);
+        v.push_back((x >> 16) & 0xFF);
+        v.push_back((x >> 24) & 0xFF);
+    }
+
+    // Encode a metadata array (bits or refs) as raw 16-bit blocks
+    void appendMetadata(std::vector<uint8_t>& stream, int numBlocks, uint16_t value) {
+        put32(stream, numBlocks);
+
+        for(int i = 0; i < numBlocks; i += ENCODING_BLOCK) {
+            // Header: bits=15 (raw 16-bit), reference=0
+            stream.push_back(0xF0);
+            stream.push_back(0x00);
+
+            for(int k = 0; k < ENCODING_BLOCK; k++) {
+                stream.push_back(value & 0xFF);
+                stream.push_back(value >> 8);
+            }
+        }
+    }
+
+    // Build a frame whose payload blocks all use the given bits value
+    std::vector<uint8_t> makeStream(int bits, std::mt19937& rng) {
+        const int numBlocks = (WIDTH / ENCODING_BLOCK) * HEIGHT;
+
+        std::vector<uint8_t> payload(static_cast<size_t>(numBlocks) * ENCODING_BLOCK_LENGTH[bits]);
+        for(auto& b : payload)
+            b = rng() & 0xFF;
+
+        std::vector<uint8_t> stream;
+        stream.reserve(payload.size() + 2 * numBlocks * 2 + 64);
+
+        std::vector<uint8_t> bitsMeta, refsMeta;
+        appendMetadata(bitsMeta, numBlocks, static_cast<uint16_t>(bits));
+        appendMetadata(refsMeta, numBlocks, 0);
+
+        put32(stream, WIDTH);
+        put32(stream, HEIGHT);
+        put32(stream, 16 + static_cast<uint32_t>(payload.size()));
+        put32(stream, 16 + static_cast<uint32_t>(payload.size() + bitsMeta.size()));
+
+        stream.insert(stream.end(), payload.begin(), payload.end());
+        stream.insert(stream.end(), bitsMeta.begin(), bitsMeta.end());
+        stream.insert(stream.end(), refsMeta.begin(), refsMeta.end());
+
+        return stream;
+    }
+
+    // Hardware counter sampling around a kernel loop. Each event is its
+    // own perf_event fd, so the kernel multiplexes and scales them
+    // independently; events the machine or the container refuses to open
+    // are simply dropped. Unprivileged environments (perf_event_paranoid,
+    // seccomp) commonly refuse everything, in which case the bench falls
+    // back to the time-only report.
+    class PerfCounters {
+    public:
+        enum Event { CYCLES, INSTRUCTIONS, L1D_ACCESS, L1D_MISS, LLC_ACCESS, LLC_MISS, BRANCHES, BRANCH_MISSES, NUM_EVENTS };
+
+        PerfCounters() {
+#if defined(__linux__)
+            const struct { uint32_t type; uint64_t config; } events[NUM_EVENTS] = {
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+                { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16) },
+                { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+                { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+            };
+
+            for(int i = 0; i < NUM_EVENTS; i++) {
+                perf_event_attr attr{};
+
+                attr.size = sizeof(attr);
+                attr.type = events[i].type;
+                attr.config = events[i].config;
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                mFd[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            }
+#endif
+        }
+
+        ~PerfCounters() {
+#if defined(__linux__)
+            for(int fd : mFd)
+                if(fd >= 0)
+                    close(fd);
+#endif
+        }
+
+        // IPC needs both of its counters; anything less and the extended
+        // columns are left out
+        bool available() const { return mFd[CYCLES] >= 0 && mFd[INSTRUCTIONS] >= 0; }
+
+        void begin() {
+#if defined(__linux__)
+            for(int fd : mFd) {
+                if(fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+#endif
+        }
+
+        void end() {
+#if defined(__linux__)
+            for(int i = 0; i < NUM_EVENTS; i++) {
+                mValue[i] = 0;
+
+                if(mFd[i] < 0)
+                    continue;
+
+                ioctl(mFd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+                uint64_t data[3] = {};  // value, time enabled, time running
+
+                if(read(mFd[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+                    continue;
+
+                // Scale for multiplexing
+                mValue[i] = static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+            }
+#endif
+        }
+
+        uint64_t value(Event event) const { return mValue[event]; }
+
+        // Misses per hundred accesses, or -1 when either counter is missing
+        double missRate(Event access, Event miss) const {
+            if(mFd[access] < 0 || mFd[miss] < 0 || mValue[access] == 0)
+                return -1.0;
+
+            return 100.0 * static_cast<double>(mValue[miss]) / static_cast<double>(mValue[access]);
+        }
+
+    private:
+        int mFd[NUM_EVENTS] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+        uint64_t mValue[NUM_EVENTS] = {};
+    };
+
+    std::string formatRate(double rate) {
+        if(rate < 0)
+            return "-";
+
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.2f%%", rate);
+
+        return buffer;
+    }
+
+    // Sustained memory bandwidth of the host: a large copy, well past any
+    // cache, best of a few passes. Counts both the read and the write, the
+    // same convention the per-kernel traffic below uses.
+    double measureBandwidth() {
+        constexpr size_t BYTES = 256u << 20;
+        constexpr int PASSES = 5;
+
+        std::vector<uint8_t> src(BYTES, 1);
+        std::vector<uint8_t> dst(BYTES);
+
+        double best = 0;
+
+        for(int i = 0; i < PASSES; i++) {
+            const auto start = std::chrono::steady_clock::now();
+
+            std::memcpy(dst.data(), src.data(), BYTES);
+
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            best = std::max(best, 2.0 * BYTES / seconds / 1e9);
+
+            std::swap(src, dst);
+        }
+
+        return best;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    int iterations = 20;
+    bool roofline = false;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--roofline") == 0)
+            roofline = true;
+        else if(std::atoi(argv[i]) > 0)
+            iterations = std::atoi(argv[i]);
+        else {
+            std::printf("Usage: decode_bench [iterations] [--roofline]\n");
+            return -1;
+        }
+    }
+
+    std::mt19937 rng(42);
+    std::vector<uint16_t> output(static_cast<size_t>(WIDTH) * HEIGHT);
+    motioncam::raw::DecodeContext context;
+
+    PerfCounters counters;
+    const bool hwCounters = counters.available();
+
+    std::printf("Frame: %dx%d, %d iterations per kernel\n", WIDTH, HEIGHT, iterations);
+
+    if(!hwCounters)
+        std::printf("(hardware counters unavailable; showing time-only report)\n");
+
+    // Roofline mode: position each kernel against the machine's memory
+    // roof. The traffic floor per frame is the compressed stream in plus
+    // 128 bytes of decoded pixels out per 64-pixel block; dividing by the
+    // measured copy bandwidth gives the fastest a purely bandwidth-bound
+    // kernel could run. A kernel near 100% has nothing left to win from
+    // instruction-level work - further variants are wasted effort - while
+    // a low percentage says the cycles, not the memory system, are the
+    // limit.
+    double bandwidthGBs = 0;
+
+    if(roofline) {
+        std::printf("measuring sustained memory bandwidth...\n");
+
+        bandwidthGBs = measureBandwidth();
+
+        std::printf("sustained bandwidth: %.2f GB/s (read+write)\n", bandwidthGBs);
+    }
+
+    std::printf("\n%-6s %12s %12s %12s", "bits", "ms/frame", "GB/s in", "Mpix/s");
+
+    if(roofline)
+        std::printf(" %10s %10s %10s", "bytes/pix", "roof ms", "% roof");
+
+    if(hwCounters)
+        std::printf(" %8s %10s %10s %10s", "IPC", "L1D miss", "LLC miss", "br miss");
+
+    std::printf("\n");
+
+    for(int bits = 0; bits <= 16; bits++) {
+        const auto stream = makeStream(bits, rng);
+
+        // Warmup
+        motioncam::raw::Decode(output.data(), WIDTH, HEIGHT, stream.data(), stream.size(), context);
+
+        counters.begin();
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < iterations; i++) {
+            if(motioncam::raw::Decode(output.data(), WIDTH, HEIGHT, stream.data(), stream.size(), context) == 0) {
+                std::fprintf(stderr, "Decode failed for bits=%d\n", bits);
+                return 1;
+            }
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+
+        counters.end();
+
+        const double seconds = std::chrono::duration<double>(end - start).count();
+
+        const double msPerFrame = 1000.0 * seconds / iterations;
+        const double gbPerSec = (static_cast<double>(stream.size()) * iterations / seconds) / 1e9;
+        const double mpixPerSec = (static_cast<double>(WIDTH) * HEIGHT * iterations / seconds) / 1e6;
+
+        std::printf("%-6d %12.3f %12.2f %12.1f", bits, msPerFrame, gbPerSec, mpixPerSec);
+
+        if(roofline) {
+            const double pixels = static_cast<double>(WIDTH) * HEIGHT;
+            const double traffic = static_cast<double>(stream.size()) + 2.0 * pixels;
+            const double roofMs = 1000.0 * traffic / (bandwidthGBs * 1e9);
+
+            std::printf(" %10.2f %10.3f %9.1f%%", traffic / pixels, roofMs, 100.0 * roofMs / msPerFrame);
+        }
+
+        if(hwCounters) {
+            const double ipc = counters.value(PerfCounters::CYCLES) > 0
+                ? static_cast<double>(counters.value(PerfCounters::INSTRUCTIONS)) / counters.value(PerfCounters::CYCLES)
+                : 0.0;
+
+            std::printf(" %8.2f %10s %10s %10s",
+                ipc,
+                formatRate(counters.missRate(PerfCounters::L1D_ACCESS, PerfCounters::L1D_MISS)).c_str(),
+                formatRate(counters.missRate(PerfCounters::LLC_ACCESS, PerfCounters::LLC_MISS)).c_str(),
+                formatRate(counters.missRate(PerfCounters::BRANCHES, PerfCounters::BRANCH_MISSES)).c_str());
+        }
+
+        std::printf("\n");
+    }
+
+    return 0;
+}
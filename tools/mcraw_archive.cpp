@@ -0,0 +1,337 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Recompresses a .mcraw container for cold storage. The capture-time
+// bit-packing is tuned for recording speed, not ratio; this runs an
+// entropy stage (zstd when linked in, the built-in LZ codec otherwise)
+// over each packed payload, in parallel across cores, and writes the
+// result in the archive-friendly leading-index layout mcraw_repack uses.
+// Frames become COMPRESSED_BUFFER items and the container metadata
+// records the codec, so Decoder opens the output directly and restores
+// payloads transparently at decode time - no unarchive step, restore
+// runs at line rate on whichever threads decode.
+//
+// Usage: mcraw_archive <input file> <output file> [--codec lz|zstd] [--threads n]
+
+#include <motioncam/Archive.hpp>
+#include <motioncam/Checksum.hpp>
+#include <motioncam/Container.hpp>
+#include <motioncam/Decoder.hpp>
+#include <motioncam/ThreadPool.hpp>
+
+#if defined(_WIN32)
+    #define FSEEK _fseeki64
+#else
+    #define FSEEK fseeko
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace motioncam;
+
+namespace {
+    struct Writer {
+        FILE* file;
+        int64_t pos{0};
+
+        void write(const void* data, size_t size) {
+            if(fwrite(data, 1, size, file) != size)
+                throw IOException("Failed to write output");
+
+            pos += static_cast<int64_t>(size);
+        }
+
+        void writeItem(Type type, uint32_t size) {
+            Item item{type, size};
+            write(&item, sizeof(Item));
+        }
+
+        // Write padding so the next item's payload lands on a
+        // PAYLOAD_ALIGNMENT boundary
+        void align() {
+            int64_t rem = (pos + static_cast<int64_t>(sizeof(Item))) % PAYLOAD_ALIGNMENT;
+
+            if(rem == 0)
+                return;
+
+            int64_t needed = PAYLOAD_ALIGNMENT - rem;
+
+            if(needed < static_cast<int64_t>(sizeof(Item)))
+                needed += PAYLOAD_ALIGNMENT;
+
+            const std::vector<uint8_t> zeros(needed - sizeof(Item), 0);
+
+            writeItem(Type::PADDING, static_cast<uint32_t>(zeros.size()));
+            write(zeros.data(), zeros.size());
+        }
+    };
+}
+
+int main(int argc, const char* argv[]) {
+    if(argc < 3) {
+        std::printf("Usage: mcraw_archive <input file> <output file> [--codec lz|zstd] [--threads n]\n");
+        return -1;
+    }
+
+    // zstd is the better ratio when this build carries it
+    archive::Codec codec = archive::Available(archive::Codec::ZSTD)
+        ? archive::Codec::ZSTD : archive::Codec::LZ;
+
+    size_t numThreads = 0;
+
+    for(int i = 3; i < argc; i++) {
+        if(std::strcmp(argv[i], "--codec") == 0 && i + 1 < argc) {
+            const std::string name = argv[++i];
+
+            if(name == "lz")
+                codec = archive::Codec::LZ;
+            else if(name == "zstd")
+                codec = archive::Codec::ZSTD;
+            else {
+                std::fprintf(stderr, "Unknown codec: %s\n", name.c_str());
+                return -1;
+            }
+
+            continue;
+        }
+
+        if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            numThreads = static_cast<size_t>(std::atoi(argv[++i]));
+            continue;
+        }
+
+        std::fprintf(stderr, "Invalid option: %s\n", argv[i]);
+        return -1;
+    }
+
+    try {
+        if(!archive::Available(codec)) {
+            std::fprintf(stderr, "Codec not available in this build (rebuild with MOTIONCAM_WITH_ZSTD)\n");
+            return -1;
+        }
+
+        Decoder decoder(argv[1]);
+
+        if(decoder.getTypedContainerMetadata().archiveCodec != 0) {
+            std::fprintf(stderr, "Input is already archived\n");
+            return -1;
+        }
+
+        const auto& frames = decoder.getFrames();
+
+        // The codec rides in the container metadata; Decoder keys its
+        // transparent restore off this field
+        auto metadata = decoder.getContainerMetadata();
+        metadata["archiveCodec"] = static_cast<int>(codec);
+
+        const std::string cameraMetadata = metadata.dump();
+
+        std::vector<AudioChunk> audioChunks;
+        decoder.loadAudio(audioChunks);
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(argv[2], "wb"), fclose);
+
+        if(!file)
+            throw IOException("Failed to create " + std::string(argv[2]));
+
+        Writer out{file.get()};
+
+        Header header{};
+        std::memcpy(header.ident, CONTAINER_ID, sizeof(CONTAINER_ID));
+        header.version = CONTAINER_VERSION_4;
+
+        out.write(&header, sizeof(Header));
+
+        out.writeItem(Type::METADATA, static_cast<uint32_t>(cameraMetadata.size()));
+        out.write(cameraMetadata.data(), cameraMetadata.size());
+
+        // Leading frame index, entries patched in once the frames are
+        // written and their offsets are known
+        out.writeItem(Type::BUFFER_INDEX, sizeof(BufferIndex));
+
+        const int64_t bufferIndexPos = out.pos;
+
+        BufferIndex index{};
+        index.magicNumber = static_cast<int32_t>(INDEX_MAGIC_NUMBER);
+        index.numOffsets = static_cast<int32_t>(frames.size());
+
+        out.write(&index, sizeof(BufferIndex));
+
+        out.writeItem(Type::BUFFER_INDEX_DATA, static_cast<uint32_t>(frames.size() * sizeof(BufferOffsetV4)));
+
+        index.indexDataOffset = out.pos;
+
+        std::vector<BufferOffsetV4> offsets(frames.size());
+        out.write(offsets.data(), offsets.size() * sizeof(BufferOffsetV4));
+
+        // Audio passes through untouched, behind its leading index
+        out.writeItem(Type::AUDIO_INDEX, static_cast<uint32_t>(sizeof(AudioIndex) + audioChunks.size() * sizeof(BufferOffset)));
+
+        AudioIndex audioIndex{};
+        audioIndex.numOffsets = static_cast<int64_t>(audioChunks.size());
+        audioIndex.startTimestampMs = decoder.audioStartTimestampMs();
+
+        out.write(&audioIndex, sizeof(AudioIndex));
+
+        const int64_t audioOffsetsPos = out.pos;
+
+        std::vector<BufferOffset> audioOffsets(audioChunks.size());
+        out.write(audioOffsets.data(), audioOffsets.size() * sizeof(BufferOffset));
+
+        for(size_t i = 0; i < audioChunks.size(); i++) {
+            audioOffsets[i].offset = out.pos;
+            audioOffsets[i].timestamp = audioChunks[i].first;
+
+            out.writeItem(Type::AUDIO_DATA, static_cast<uint32_t>(audioChunks[i].second.size() * sizeof(int16_t)));
+            out.write(audioChunks[i].second.data(), audioChunks[i].second.size() * sizeof(int16_t));
+
+            AudioMetadata audioMetadata{audioChunks[i].first};
+
+            out.writeItem(Type::AUDIO_DATA_METADATA, sizeof(AudioMetadata));
+            out.write(&audioMetadata, sizeof(AudioMetadata));
+        }
+
+        audioChunks.clear();
+
+        // The decoder reads a chunk of payloads sequentially while the pool
+        // compresses them in parallel, then the chunk is written in order -
+        // bounding memory to one chunk of payloads either side. The shared
+        // pool by default, a private pool for an explicit --threads.
+        std::unique_ptr<ThreadPool> ownPool;
+
+        if(numThreads > 0)
+            ownPool.reset(new ThreadPool(numThreads));
+
+        ThreadPool& pool = ownPool ? *ownPool : ThreadPool::shared();
+
+        const size_t chunkSize = std::max<size_t>(8, 2 * pool.numThreads());
+
+        std::vector<std::vector<uint8_t>> payloads(chunkSize);
+        std::vector<std::vector<uint8_t>> metadataJson(chunkSize);
+        std::vector<std::vector<uint8_t>> archived(chunkSize);
+
+        std::vector<ChecksumEntry> checksums(frames.size());
+
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+
+        for(size_t chunkStart = 0; chunkStart < frames.size(); chunkStart += chunkSize) {
+            const size_t n = std::min(chunkSize, frames.size() - chunkStart);
+
+            for(size_t i = 0; i < n; i++)
+                decoder.loadFramePayload(frames[chunkStart + i], payloads[i], metadataJson[i]);
+
+            TaskGroup group;
+
+            std::mutex errorMutex;
+            std::exception_ptr firstError;
+
+            for(size_t i = 0; i < n; i++) {
+                group.run(pool, Priority::EXPORT, [&, i] {
+                    try {
+                        archive::Compress(codec, payloads[i].data(), payloads[i].size(), archived[i]);
+                    }
+                    catch(...) {
+                        std::unique_lock<std::mutex> lock(errorMutex);
+
+                        if(!firstError)
+                            firstError = std::current_exception();
+                    }
+                });
+            }
+
+            group.wait();
+
+            if(firstError)
+                std::rethrow_exception(firstError);
+
+            for(size_t i = 0; i < n; i++) {
+                const size_t f = chunkStart + i;
+
+                out.align();
+
+                offsets[f].offset = out.pos;
+                offsets[f].timestamp = frames[f];
+                offsets[f].payloadSize = static_cast<uint32_t>(archived[i].size());
+                offsets[f].metadataSize = static_cast<uint32_t>(metadataJson[i].size());
+
+                // Over the stored bytes, matching what verification hashes
+                checksums[f].timestamp = frames[f];
+                checksums[f].hash = Hash64(archived[i].data(), archived[i].size());
+
+                out.writeItem(Type::COMPRESSED_BUFFER, static_cast<uint32_t>(archived[i].size()));
+                out.write(archived[i].data(), archived[i].size());
+
+                out.writeItem(Type::METADATA, static_cast<uint32_t>(metadataJson[i].size()));
+                out.write(metadataJson[i].data(), metadataJson[i].size());
+
+                bytesIn += payloads[i].size();
+                bytesOut += archived[i].size();
+            }
+        }
+
+        // Reference checksums of every payload written, so archival copies
+        // can later be verified for bit rot
+        // (Decoder::enableChecksumVerification)
+        out.writeItem(Type::CHECKSUM_INDEX, static_cast<uint32_t>(sizeof(ChecksumIndex) + checksums.size() * sizeof(ChecksumEntry)));
+
+        ChecksumIndex checksumIndex{};
+        checksumIndex.magicNumber = static_cast<int32_t>(INDEX_MAGIC_NUMBER);
+        checksumIndex.numEntries = static_cast<int32_t>(checksums.size());
+
+        out.write(&checksumIndex, sizeof(ChecksumIndex));
+        out.write(checksums.data(), checksums.size() * sizeof(ChecksumEntry));
+
+        // Patch in the index entries and the audio offsets
+        if(FSEEK(file.get(), bufferIndexPos, SEEK_SET) != 0)
+            throw IOException("Failed to write index");
+
+        if(fwrite(&index, sizeof(BufferIndex), 1, file.get()) != 1)
+            throw IOException("Failed to write index");
+
+        if(FSEEK(file.get(), index.indexDataOffset, SEEK_SET) != 0)
+            throw IOException("Failed to write index");
+
+        if(!offsets.empty() && fwrite(offsets.data(), sizeof(BufferOffsetV4), offsets.size(), file.get()) != offsets.size())
+            throw IOException("Failed to write index");
+
+        if(FSEEK(file.get(), audioOffsetsPos, SEEK_SET) != 0)
+            throw IOException("Failed to write index");
+
+        if(!audioOffsets.empty() && fwrite(audioOffsets.data(), sizeof(BufferOffset), audioOffsets.size(), file.get()) != audioOffsets.size())
+            throw IOException("Failed to write index");
+
+        std::printf("Archived %zu frames with %s: %.1f MB -> %.1f MB (%.1f%% of original) -> %s\n",
+            frames.size(),
+            codec == archive::Codec::ZSTD ? "zstd" : "lz",
+            bytesIn / (1024.0 * 1024.0),
+            bytesOut / (1024.0 * 1024.0),
+            bytesIn > 0 ? 100.0 * bytesOut / bytesIn : 0.0,
+            argv[2]);
+    }
+    catch(motioncam::MotionCamException& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
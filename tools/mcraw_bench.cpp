@@ -0,0 +1,116 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// End-to-end decode benchmark over a real .mcraw file: open latency, decode
+// rate and a breakdown of where per-frame time goes. No output is written.
+
+#include <motioncam/Decoder.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, const char* argv[]) {
+    if(argc < 2) {
+        std::printf("Usage: mcraw_bench <input file> [--mmap|--uring]\n");
+        return -1;
+    }
+
+    std::string inputPath(argv[1]);
+    motioncam::ReadMode mode = motioncam::ReadMode::BUFFERED;
+    const char* modeName = "buffered";
+
+    for(int i = 2; i < argc; i++) {
+        if(std::strcmp(argv[i], "--mmap") == 0) {
+            mode = motioncam::ReadMode::MEMORY_MAPPED;
+            modeName = "mmap";
+        }
+        else if(std::strcmp(argv[i], "--uring") == 0) {
+            mode = motioncam::ReadMode::IO_URING;
+            modeName = "io_uring";
+        }
+    }
+
+    try {
+        // Open latency
+        auto start = Clock::now();
+        motioncam::Decoder decoder(inputPath, mode);
+        const double openSeconds = secondsSince(start);
+
+        const auto& frames = decoder.getFrames();
+
+        std::printf("File:       %s\n", inputPath.c_str());
+        std::printf("Mode:       %s\n", modeName);
+        std::printf("Frames:     %zu\n", frames.size());
+        std::printf("Open:       %.2f ms\n\n", 1000.0 * openSeconds);
+
+        if(frames.empty())
+            return 0;
+
+        std::vector<uint16_t> data;
+        nlohmann::json metadata;
+        size_t pixels = 0;
+
+        // Full decode pass, metadata included
+        start = Clock::now();
+
+        for(const auto timestamp : frames) {
+            decoder.loadFrame(timestamp, data, metadata);
+            pixels += data.size();
+        }
+
+        const double fullSeconds = secondsSince(start);
+        const auto stats = decoder.getStats();
+
+        // Second pass without the JSON parse isolates the metadata cost
+        start = Clock::now();
+
+        for(const auto timestamp : frames)
+            decoder.loadFrame(timestamp, data);
+
+        const double noJsonSeconds = secondsSince(start);
+
+        const double framesPerSec = frames.size() / fullSeconds;
+        const double mpixPerSec = (static_cast<double>(pixels) / fullSeconds) / 1e6;
+
+        std::printf("Decode:     %.2f s (%.1f frames/s, %.1f Mpix/s)\n", fullSeconds, framesPerSec, mpixPerSec);
+        std::printf("w/o JSON:   %.2f s (%.1f frames/s)\n", noJsonSeconds, frames.size() / noJsonSeconds);
+        std::printf("JSON cost:  %.2f ms/frame\n", 1000.0 * (fullSeconds - noJsonSeconds) / frames.size());
+
+        // Counter breakdown from the first pass
+        if(stats.framesDecoded > 0) {
+            std::printf("\nBytes read: %.2f GB (%.2f GB/s)\n",
+                stats.bytesRead / 1e9, stats.bytesRead / 1e9 / fullSeconds);
+            std::printf("Seeks:      %llu\n", (unsigned long long)stats.numSeeks);
+            std::printf("raw decode: %.2f ms/frame\n", stats.decodeNanos / 1e6 / stats.framesDecoded);
+            std::printf("json parse: %.2f ms/frame\n", stats.metadataParseNanos / 1e6 / stats.framesDecoded);
+        }
+    }
+    catch(motioncam::MotionCamException& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Export cost estimator front-end for the farm scheduler. Answers "how
+// long will this export take" from the per-frame compressed sizes in the
+// index and this machine's calibrated decode coefficients, instead of by
+// running the export. With --model the calibration persists per machine
+// class (the perf_regress baseline key) and later runs skip the sample
+// decodes, so a scheduler node pays calibration once, then estimates any
+// clip from its index alone.
+//
+// Usage: mcraw_estimate <input file> [--range first last] [--model file]
+//                       [--calibrate] [--write-dir dir] [--json]
+//
+// --range      estimate frames [first, last) instead of the whole clip
+// --model      calibration file to load from / save to
+// --calibrate  recalibrate even when the model file has this machine
+// --write-dir  probe this directory's write bandwidth for the write term
+// --json       machine-readable output for the scheduler
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/ExportEstimator.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace motioncam;
+
+int main(int argc, const char* argv[]) {
+    std::string inputPath;
+    std::string modelPath;
+    std::string writeDir;
+    size_t firstFrame = 0;
+    size_t lastFrame = SIZE_MAX;
+    bool calibrate = false;
+    bool json = false;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--range") == 0 && i + 2 < argc) {
+            firstFrame = static_cast<size_t>(std::atoll(argv[++i]));
+            lastFrame = static_cast<size_t>(std::atoll(argv[++i]));
+        }
+        else if(std::strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+            modelPath = argv[++i];
+        else if(std::strcmp(argv[i], "--calibrate") == 0)
+            calibrate = true;
+        else if(std::strcmp(argv[i], "--write-dir") == 0 && i + 1 < argc)
+            writeDir = argv[++i];
+        else if(std::strcmp(argv[i], "--json") == 0)
+            json = true;
+        else if(argv[i][0] != '-' && inputPath.empty())
+            inputPath = argv[i];
+        else {
+            std::printf("Usage: mcraw_estimate <input file> [--range first last] [--model file] [--calibrate] [--write-dir dir] [--json]\n");
+            return -1;
+        }
+    }
+
+    if(inputPath.empty()) {
+        std::printf("Usage: mcraw_estimate <input file> [--range first last] [--model file] [--calibrate] [--write-dir dir] [--json]\n");
+        return -1;
+    }
+
+    try {
+        Decoder decoder(inputPath);
+
+        ExportCostModel model;
+        bool haveModel = !calibrate && !modelPath.empty() && LoadExportModel(modelPath, model);
+
+        if(!haveModel) {
+            model = CalibrateExportModel(decoder);
+
+            if(!writeDir.empty())
+                model.writeBytesPerSecond = MeasureWriteThroughput(writeDir);
+
+            if(!modelPath.empty())
+                SaveExportModel(modelPath, model);
+        }
+        else if(!writeDir.empty() && model.writeBytesPerSecond <= 0)
+            model.writeBytesPerSecond = MeasureWriteThroughput(writeDir);
+
+        const ExportEstimate estimate = EstimateExport(decoder, firstFrame, lastFrame, model);
+
+        if(json) {
+            std::printf("{\"numFrames\":%zu,\"inputBytes\":%lld,\"outputBytes\":%lld,"
+                "\"decodeSeconds\":%.3f,\"writeSeconds\":%.3f,\"totalSeconds\":%.3f}\n",
+                estimate.numFrames,
+                static_cast<long long>(estimate.inputBytes),
+                static_cast<long long>(estimate.outputBytes),
+                estimate.decodeSeconds,
+                estimate.writeSeconds,
+                estimate.totalSeconds);
+        }
+        else {
+            std::printf("%zu frames, %.1f MB in, %.1f MB out\n",
+                estimate.numFrames,
+                estimate.inputBytes / (1024.0 * 1024.0),
+                estimate.outputBytes / (1024.0 * 1024.0));
+
+            std::printf("  decode %8.2f s  (%.1f MB/s, %.2f ms/frame overhead)\n",
+                estimate.decodeSeconds,
+                model.decodeBytesPerSecond / (1024.0 * 1024.0),
+                1000.0 * model.frameOverheadSeconds);
+
+            if(model.writeBytesPerSecond > 0)
+                std::printf("  write  %8.2f s  (%.1f MB/s)\n",
+                    estimate.writeSeconds, model.writeBytesPerSecond / (1024.0 * 1024.0));
+
+            std::printf("  total  %8.2f s\n", estimate.totalSeconds);
+        }
+    }
+    catch(MotionCamException& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
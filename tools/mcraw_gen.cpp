@@ -0,0 +1,280 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Deterministic synthetic .mcraw generator for benchmarks and stress
+// tests: real footage is huge and private, but every scenario only
+// needs a valid container with known shape. Frame content is built per
+// 64-pixel encoding block so a bits list steers exactly which decode
+// kernels the payloads exercise, audio arrives in controllable chunk
+// sizes, and --shuffle writes frames out of timestamp order to stress
+// the open-time index sort. Same seed, same bytes - on any machine.
+//
+// Usage: mcraw_gen <output file> [options]
+//   --width n         frame width (default 1920)
+//   --height n        frame height (default 1080)
+//   --frames n        frame count (default 48)
+//   --fps n           frame rate for the synthetic timestamps (default 30)
+//   --bits list       comma-separated bits values cycled across encoding
+//                     blocks, each in 0..16 (default 10)
+//   --audio-rate n    audio sample rate, 0 for no audio (default 48000)
+//   --audio-chunk n   interleaved samples per audio chunk (default 2048)
+//   --channels n      audio channels (default 2)
+//   --shuffle         write frames in shuffled timestamp order
+//   --checksums       record a payload checksum index
+//   --seed n          RNG seed (default 42)
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/RawData.hpp>
+#include <motioncam/Writer.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace motioncam;
+
+namespace {
+    constexpr int ENCODING_BLOCK = 64;
+
+    // Parse "4,10,16" into bits values; returns false on anything invalid
+    bool parseBitsList(const char* text, std::vector<int>& outBits) {
+        outBits.clear();
+
+        std::string token;
+
+        for(const char* p = text;; p++) {
+            if(*p == ',' || *p == '\0') {
+                if(token.empty())
+                    return false;
+
+                const int bits = std::atoi(token.c_str());
+
+                if(bits < 0 || bits > 16 || (bits == 0 && token != "0"))
+                    return false;
+
+                outBits.push_back(bits);
+                token.clear();
+
+                if(*p == '\0')
+                    break;
+            }
+            else {
+                token += *p;
+            }
+        }
+
+        return !outBits.empty();
+    }
+
+    // Fill one frame so each successive 64-pixel block spans exactly the
+    // value range of the next bits class in the cycle: the block minimum
+    // is a random pedestal and the spread covers [0, 2^bits), so
+    // raw::Encode picks that class and the matching decode kernel runs
+    // over the block
+    void fillFrame(std::vector<uint16_t>& image, const int width, const int height,
+                   const std::vector<int>& bitsCycle, std::mt19937& rng)
+    {
+        size_t block = 0;
+
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x += ENCODING_BLOCK, block++) {
+                const int bits = bitsCycle[block % bitsCycle.size()];
+                const int blockWidth = std::min(ENCODING_BLOCK, width - x);
+
+                // Pedestal low enough that the spread stays in 16 bits
+                const uint16_t base = bits >= 16 ? 0
+                    : static_cast<uint16_t>(rng() % (65536 - (1u << bits)));
+
+                uint16_t* row = image.data() + static_cast<size_t>(y) * width + x;
+
+                for(int k = 0; k < blockWidth; k++)
+                    row[k] = static_cast<uint16_t>(base + (bits == 0 ? 0 : rng() & ((1u << bits) - 1)));
+
+                if(bits > 0) {
+                    // Pin the extremes so the range is exact, not just likely
+                    row[0] = base;
+                    row[blockWidth - 1] = static_cast<uint16_t>(base + ((1u << bits) - 1));
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    if(argc < 2) {
+        std::printf(
+            "Usage: mcraw_gen <output file> [--width n] [--height n] [--frames n] [--fps n]\n"
+            "                 [--bits list] [--audio-rate n] [--audio-chunk n] [--channels n]\n"
+            "                 [--shuffle] [--checksums] [--seed n]\n");
+        return -1;
+    }
+
+    const std::string path = argv[1];
+
+    int width = 1920;
+    int height = 1080;
+    int numFrames = 48;
+    int fps = 30;
+    int audioRate = 48000;
+    int audioChunk = 2048;
+    int channels = 2;
+    bool shuffle = false;
+    bool checksums = false;
+    uint32_t seed = 42;
+    std::vector<int> bitsCycle{10};
+
+    for(int i = 2; i < argc; i++) {
+        const auto intArg = [&](const char* name, int& out) {
+            if(std::strcmp(argv[i], name) != 0 || i + 1 >= argc)
+                return false;
+
+            out = std::atoi(argv[++i]);
+            return true;
+        };
+
+        if(intArg("--width", width) || intArg("--height", height) || intArg("--frames", numFrames)
+            || intArg("--fps", fps) || intArg("--audio-rate", audioRate)
+            || intArg("--audio-chunk", audioChunk) || intArg("--channels", channels))
+        {
+            continue;
+        }
+
+        if(std::strcmp(argv[i], "--bits") == 0 && i + 1 < argc && parseBitsList(argv[++i], bitsCycle))
+            continue;
+
+        if(std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<uint32_t>(std::atoll(argv[++i]));
+            continue;
+        }
+
+        if(std::strcmp(argv[i], "--shuffle") == 0) {
+            shuffle = true;
+            continue;
+        }
+
+        if(std::strcmp(argv[i], "--checksums") == 0) {
+            checksums = true;
+            continue;
+        }
+
+        std::fprintf(stderr, "Invalid option: %s\n", argv[i]);
+        return -1;
+    }
+
+    if(width <= 0 || height <= 0 || numFrames < 0 || fps <= 0 || audioChunk <= 0 || channels <= 0) {
+        std::fprintf(stderr, "Invalid dimensions\n");
+        return -1;
+    }
+
+    try {
+        nlohmann::json containerMetadata;
+        // The decoder reads this key as spelled here (historical typo in
+        // the recorder, kept for compatibility)
+        containerMetadata["sensorArrangment"] = "rggb";
+        containerMetadata["blackLevel"] = { 0, 0, 0, 0 };
+        containerMetadata["whiteLevel"] = 65535;
+
+        if(audioRate > 0) {
+            // The decoder reads the audio format from extraData
+            containerMetadata["extraData"]["audioSampleRate"] = audioRate;
+            containerMetadata["extraData"]["audioChannels"] = channels;
+        }
+
+        Writer writer(path, containerMetadata);
+
+        if(checksums)
+            writer.enableChecksumIndex();
+
+        std::mt19937 rng(seed);
+
+        const int64_t frameIntervalNs = 1000000000LL / fps;
+
+        std::vector<size_t> order(numFrames);
+        std::iota(order.begin(), order.end(), 0);
+
+        if(shuffle)
+            std::shuffle(order.begin(), order.end(), rng);
+
+        std::vector<uint16_t> image(static_cast<size_t>(width) * height);
+        std::vector<uint8_t> payload;
+
+        for(const size_t i : order) {
+            fillFrame(image, width, height, bitsCycle, rng);
+
+            raw::Encode(image.data(), width, height, payload);
+
+            const Timestamp timestamp = static_cast<Timestamp>(i + 1) * frameIntervalNs;
+
+            nlohmann::json metadata;
+            metadata["width"] = width;
+            metadata["height"] = height;
+            metadata["compressionType"] = 7;
+            metadata["timestamp"] = timestamp;
+            metadata["iso"] = 400;
+            metadata["exposureTime"] = frameIntervalNs / 2;
+            metadata["orientation"] = 1;
+            metadata["asShotNeutral"] = { 0.5, 1.0, 0.6 };
+
+            writer.writeFrame(timestamp, payload, metadata);
+        }
+
+        if(audioRate > 0 && numFrames > 0) {
+            // A 440Hz tone with a touch of noise, chunked as requested and
+            // spanning the clip
+            writer.setAudioStartTimestampMs(0);
+
+            const int64_t clipNs = static_cast<int64_t>(numFrames) * frameIntervalNs;
+            const int64_t totalSamples = clipNs * audioRate / 1000000000LL * channels;
+
+            std::vector<int16_t> chunk;
+            int64_t written = 0;
+
+            while(written < totalSamples) {
+                const int64_t n = std::min<int64_t>(audioChunk, totalSamples - written);
+
+                chunk.resize(n);
+
+                for(int64_t s = 0; s < n; s++) {
+                    const int64_t sample = (written + s) / channels;
+                    const double tone = 8000.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * sample / audioRate);
+
+                    chunk[s] = static_cast<int16_t>(tone + static_cast<int>(rng() % 64) - 32);
+                }
+
+                const Timestamp timestampNs = (written / channels) * 1000000000LL / audioRate;
+
+                writer.writeAudio(timestampNs, chunk.data(), chunk.size());
+
+                written += n;
+            }
+        }
+
+        writer.finish();
+
+        std::printf("Wrote %zu frames, %zu audio chunks -> %s\n", writer.numFrames(), writer.numAudioChunks(), path.c_str());
+    }
+    catch(MotionCamException& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Rewrites a .mcraw container into an archive-friendly layout: version 4
+// with page-aligned payloads, frames stored in timestamp order, the frame
+// and audio indexes placed at the front of the file, and any dead space
+// (interrupted writes, orphaned items, old padding) stripped. Opening a
+// repacked file reads the index without seeking to the end, and a full
+// decode pass reads the file strictly front to back.
+
+#include <motioncam/Checksum.hpp>
+#include <motioncam/Decoder.hpp>
+#include <motioncam/Container.hpp>
+#include <motioncam/Preview.hpp>
+
+#if defined(_WIN32)
+    #define FSEEK _fseeki64
+#else
+    #define FSEEK fseeko
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace motioncam;
+
+namespace {
+    struct Writer {
+        FILE* file;
+        int64_t pos{0};
+
+        void write(const void* data, size_t size) {
+            if(fwrite(data, 1, size, file) != size)
+                throw IOException("Failed to write output");
+
+            pos += static_cast<int64_t>(size);
+        }
+
+        void writeItem(Type type, uint32_t size) {
+            Item item{type, size};
+            write(&item, sizeof(Item));
+        }
+
+        // Write padding so the next item's payload lands on a
+        // PAYLOAD_ALIGNMENT boundary
+        void align() {
+            int64_t rem = (pos + static_cast<int64_t>(sizeof(Item))) % PAYLOAD_ALIGNMENT;
+
+            if(rem == 0)
+                return;
+
+            int64_t needed = PAYLOAD_ALIGNMENT - rem;
+
+            if(needed < static_cast<int64_t>(sizeof(Item)))
+                needed += PAYLOAD_ALIGNMENT;
+
+            const std::vector<uint8_t> zeros(needed - sizeof(Item), 0);
+
+            writeItem(Type::PADDING, static_cast<uint32_t>(zeros.size()));
+            write(zeros.data(), zeros.size());
+        }
+    };
+}
+
+int main(int argc, const char* argv[]) {
+    if(argc < 3) {
+        std::printf("Usage: mcraw_repack <input file> <output file>\n");
+        return -1;
+    }
+
+    try {
+        Decoder decoder(argv[1]);
+
+        const auto& frames = decoder.getFrames();
+        const std::string cameraMetadata = decoder.getContainerMetadata().dump();
+
+        std::vector<AudioChunk> audioChunks;
+        decoder.loadAudio(audioChunks);
+
+        std::unique_ptr<FILE, int(*)(FILE*)> file(fopen(argv[2], "wb"), fclose);
+
+        if(!file)
+            throw IOException("Failed to create " + std::string(argv[2]));
+
+        Writer out{file.get()};
+
+        Header header{};
+        std::memcpy(header.ident, CONTAINER_ID, sizeof(CONTAINER_ID));
+        header.version = CONTAINER_VERSION_4;
+
+        out.write(&header, sizeof(Header));
+
+        out.writeItem(Type::METADATA, static_cast<uint32_t>(cameraMetadata.size()));
+        out.write(cameraMetadata.data(), cameraMetadata.size());
+
+        // Poster-frame thumbnail from the middle of the clip, embedded
+        // ahead of the index so shot browsers fetch it with one small read
+        // (Decoder::loadThumbnail)
+        if(!frames.empty()) {
+            std::vector<uint16_t> frameData;
+            nlohmann::json frameMetadata;
+
+            decoder.loadFrame(frames[frames.size() / 2], frameData, frameMetadata);
+
+            Thumbnail thumbnail;
+            RenderThumbnail(frameData, frameMetadata, decoder.getTypedContainerMetadata(), 256, thumbnail);
+
+            ThumbnailHeader thumbnailHeader{};
+            thumbnailHeader.format = THUMBNAIL_FORMAT_RGB888;
+            thumbnailHeader.width = static_cast<uint32_t>(thumbnail.width);
+            thumbnailHeader.height = static_cast<uint32_t>(thumbnail.height);
+
+            out.writeItem(Type::THUMBNAIL, static_cast<uint32_t>(sizeof(ThumbnailHeader) + thumbnail.rgb.size()));
+            out.write(&thumbnailHeader, sizeof(ThumbnailHeader));
+            out.write(thumbnail.rgb.data(), thumbnail.rgb.size());
+        }
+
+        // Leading frame index, entries patched in once the frames are
+        // written and their offsets are known
+        out.writeItem(Type::BUFFER_INDEX, sizeof(BufferIndex));
+
+        const int64_t bufferIndexPos = out.pos;
+
+        BufferIndex index{};
+        index.magicNumber = static_cast<int32_t>(INDEX_MAGIC_NUMBER);
+        index.numOffsets = static_cast<int32_t>(frames.size());
+
+        out.write(&index, sizeof(BufferIndex));
+
+        out.writeItem(Type::BUFFER_INDEX_DATA, static_cast<uint32_t>(frames.size() * sizeof(BufferOffsetV4)));
+
+        index.indexDataOffset = out.pos;
+
+        std::vector<BufferOffsetV4> offsets(frames.size());
+        out.write(offsets.data(), offsets.size() * sizeof(BufferOffsetV4));
+
+        // Leading audio index followed by the audio chunks, so everything
+        // before the first frame is read in one sequential sweep at open
+        out.writeItem(Type::AUDIO_INDEX, static_cast<uint32_t>(sizeof(AudioIndex) + audioChunks.size() * sizeof(BufferOffset)));
+
+        AudioIndex audioIndex{};
+        audioIndex.numOffsets = static_cast<int64_t>(audioChunks.size());
+        audioIndex.startTimestampMs = decoder.audioStartTimestampMs();
+
+        out.write(&audioIndex, sizeof(AudioIndex));
+
+        const int64_t audioOffsetsPos = out.pos;
+
+        std::vector<BufferOffset> audioOffsets(audioChunks.size());
+        out.write(audioOffsets.data(), audioOffsets.size() * sizeof(BufferOffset));
+
+        for(size_t i = 0; i < audioChunks.size(); i++) {
+            audioOffsets[i].offset = out.pos;
+            audioOffsets[i].timestamp = audioChunks[i].first;
+
+            out.writeItem(Type::AUDIO_DATA, static_cast<uint32_t>(audioChunks[i].second.size() * sizeof(int16_t)));
+            out.write(audioChunks[i].second.data(), audioChunks[i].second.size() * sizeof(int16_t));
+
+            AudioMetadata audioMetadata{audioChunks[i].first};
+
+            out.writeItem(Type::AUDIO_DATA_METADATA, sizeof(AudioMetadata));
+            out.write(&audioMetadata, sizeof(AudioMetadata));
+        }
+
+        audioChunks.clear();
+
+        // Frames in timestamp order with page-aligned payloads
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> metadataJson;
+        std::vector<ChecksumEntry> checksums(frames.size());
+
+        for(size_t i = 0; i < frames.size(); i++) {
+            decoder.loadFramePayload(frames[i], payload, metadataJson);
+
+            out.align();
+
+            offsets[i].offset = out.pos;
+            offsets[i].timestamp = frames[i];
+            offsets[i].payloadSize = static_cast<uint32_t>(payload.size());
+            offsets[i].metadataSize = static_cast<uint32_t>(metadataJson.size());
+
+            checksums[i].timestamp = frames[i];
+            checksums[i].hash = Hash64(payload.data(), payload.size());
+
+            out.writeItem(Type::BUFFER, static_cast<uint32_t>(payload.size()));
+            out.write(payload.data(), payload.size());
+
+            out.writeItem(Type::METADATA, static_cast<uint32_t>(metadataJson.size()));
+            out.write(metadataJson.data(), metadataJson.size());
+        }
+
+        // Reference checksums of every payload written, so archival copies
+        // can later be verified for bit rot
+        // (Decoder::enableChecksumVerification)
+        out.writeItem(Type::CHECKSUM_INDEX, static_cast<uint32_t>(sizeof(ChecksumIndex) + checksums.size() * sizeof(ChecksumEntry)));
+
+        ChecksumIndex checksumIndex{};
+        checksumIndex.magicNumber = static_cast<int32_t>(INDEX_MAGIC_NUMBER);
+        checksumIndex.numEntries = static_cast<int32_t>(checksums.size());
+
+        out.write(&checksumIndex, sizeof(ChecksumIndex));
+        out.write(checksums.data(), checksums.size() * sizeof(ChecksumEntry));
+
+        // Patch in the index entries and the audio offsets
+        if(FSEEK(file.get(), bufferIndexPos, SEEK_SET) != 0)
+            throw IOException("Failed to write index");
+
+        if(fwrite(&index, sizeof(BufferIndex), 1, file.get()) != 1)
+            throw IOException("Failed to write index");
+
+        if(FSEEK(file.get(), index.indexDataOffset, SEEK_SET) != 0)
+            throw IOException("Failed to write index");
+
+        if(!offsets.empty() && fwrite(offsets.data(), sizeof(BufferOffsetV4), offsets.size(), file.get()) != offsets.size())
+            throw IOException("Failed to write index");
+
+        if(FSEEK(file.get(), audioOffsetsPos, SEEK_SET) != 0)
+            throw IOException("Failed to write index");
+
+        if(!audioOffsets.empty() && fwrite(audioOffsets.data(), sizeof(BufferOffset), audioOffsets.size(), file.get()) != audioOffsets.size())
+            throw IOException("Failed to write index");
+
+        std::printf("Repacked %zu frames, %zu audio chunks -> %s\n", frames.size(), audioOffsets.size(), argv[2]);
+    }
+    catch(motioncam::MotionCamException& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Sharded export coordinator. Frames are independent and the index gives
+// exact ranges, so a long recording exports across a farm with no file
+// pre-splitting:
+//
+//   mcraw_shard plan <input> <num shards> <out dir>
+//       partitions the frame index into contiguous ranges and writes one
+//       shard_NNN.json assignment per worker
+//
+//   mcraw_shard work <shard_NNN.json> <out dir>
+//       decodes the assigned range (reading the container over shared
+//       storage) into 16-bit raw frame files and writes a completion
+//       manifest listing what landed
+//
+//   mcraw_shard merge <input> <out dir>
+//       checks the completion manifests against the full frame index and
+//       reports any frame no worker delivered
+//
+// Assignments and manifests are plain JSON, so any scheduler can hand
+// them around.
+
+#include <motioncam/Decoder.hpp>
+#include <nlohmann/json.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace motioncam;
+
+namespace {
+    std::string shardName(size_t shard) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "shard_%03zu", shard);
+        return name;
+    }
+
+    int plan(const char* input, int numShards, const std::string& outDir) {
+        if(numShards < 1) {
+            std::printf("Invalid shard count\n");
+            return -1;
+        }
+
+        Decoder decoder(input);
+
+        const size_t numFrames = decoder.getFrames().size();
+
+        if(numFrames == 0) {
+            std::printf("No frames in %s\n", input);
+            return -1;
+        }
+
+        const size_t shards = std::min<size_t>(numShards, numFrames);
+
+        for(size_t s = 0; s < shards; s++) {
+            // Contiguous ranges, so every worker reads one sequential span
+            // of the container
+            const size_t begin = s * numFrames / shards;
+            const size_t end = (s + 1) * numFrames / shards;
+
+            nlohmann::json assignment;
+
+            assignment["file"] = input;
+            assignment["shard"] = s;
+            assignment["numShards"] = shards;
+            assignment["frameBegin"] = begin;
+            assignment["frameEnd"] = end;
+
+            const auto path = outDir + "/" + shardName(s) + ".json";
+            std::ofstream out(path);
+
+            if(!out) {
+                std::printf("Can't write %s\n", path.c_str());
+                return -1;
+            }
+
+            out << assignment.dump(2) << std::endl;
+        }
+
+        std::printf("Planned %zu shards over %zu frames -> %s\n", shards, numFrames, outDir.c_str());
+
+        return 0;
+    }
+
+    int work(const char* assignmentPath, const std::string& outDir) {
+        nlohmann::json assignment;
+
+        {
+            std::ifstream in(assignmentPath);
+
+            if(!in) {
+                std::printf("Can't read %s\n", assignmentPath);
+                return -1;
+            }
+
+            in >> assignment;
+        }
+
+        const std::string file = assignment["file"];
+        const size_t shard = assignment["shard"];
+        const size_t begin = assignment["frameBegin"];
+        const size_t end = assignment["frameEnd"];
+
+        Decoder decoder(file);
+
+        const auto& frames = decoder.getFrames();
+
+        if(end > frames.size() || begin > end) {
+            std::printf("Assignment range [%zu, %zu) outside container (%zu frames)\n", begin, end, frames.size());
+            return -1;
+        }
+
+        std::vector<uint16_t> data;
+        nlohmann::json metadata;
+        std::vector<Timestamp> completed;
+
+        for(size_t i = begin; i < end; i++) {
+            decoder.loadFrame(frames[i], data, metadata);
+
+            const int width = metadata["width"];
+            const int height = metadata["height"];
+
+            char name[64];
+            std::snprintf(name, sizeof(name), "%lld_%dx%d.raw", static_cast<long long>(frames[i]), width, height);
+
+            const auto path = outDir + "/" + name;
+            FILE* out = fopen(path.c_str(), "wb");
+
+            if(!out) {
+                std::printf("Can't write %s\n", path.c_str());
+                return -1;
+            }
+
+            const size_t pixels = static_cast<size_t>(width) * height;
+            const bool ok = fwrite(data.data(), sizeof(uint16_t), pixels, out) == pixels;
+
+            fclose(out);
+
+            if(!ok) {
+                std::printf("Short write on %s\n", path.c_str());
+                return -1;
+            }
+
+            completed.push_back(frames[i]);
+        }
+
+        // The manifest lands last, so its presence means every frame above
+        // is fully on disk
+        nlohmann::json manifest;
+
+        manifest["file"] = file;
+        manifest["shard"] = shard;
+        manifest["completed"] = completed;
+
+        const auto manifestPath = outDir + "/" + shardName(shard) + ".done.json";
+        std::ofstream out(manifestPath);
+
+        if(!out) {
+            std::printf("Can't write %s\n", manifestPath.c_str());
+            return -1;
+        }
+
+        out << manifest.dump(2) << std::endl;
+
+        std::printf("Shard %zu exported %zu frames -> %s\n", shard, completed.size(), outDir.c_str());
+
+        return 0;
+    }
+
+    int merge(const char* input, const std::string& outDir) {
+        Decoder decoder(input);
+
+        const auto& frames = decoder.getFrames();
+
+        std::set<Timestamp> delivered;
+        size_t manifests = 0;
+
+        // Manifests are numbered densely from zero, so walking until the
+        // first gap finds them all
+        for(size_t s = 0; ; s++) {
+            std::ifstream in(outDir + "/" + shardName(s) + ".done.json");
+
+            if(!in)
+                break;
+
+            nlohmann::json manifest;
+            in >> manifest;
+
+            for(const auto& timestamp : manifest["completed"])
+                delivered.insert(timestamp.get<Timestamp>());
+
+            manifests++;
+        }
+
+        size_t missing = 0;
+
+        for(const auto timestamp : frames) {
+            if(delivered.find(timestamp) == delivered.end()) {
+                std::printf("Missing frame %lld\n", static_cast<long long>(timestamp));
+                missing++;
+            }
+        }
+
+        std::printf("%zu manifests, %zu/%zu frames delivered, %zu missing\n",
+            manifests, delivered.size(), frames.size(), missing);
+
+        return missing == 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    if(argc < 4) {
+        std::printf("Usage: mcraw_shard plan <input file> <num shards> <out dir>\n");
+        std::printf("       mcraw_shard work <shard_NNN.json> <out dir>\n");
+        std::printf("       mcraw_shard merge <input file> <out dir>\n");
+        return -1;
+    }
+
+    try {
+        if(std::strcmp(argv[1], "plan") == 0 && argc >= 5)
+            return plan(argv[2], std::atoi(argv[3]), argv[4]);
+
+        if(std::strcmp(argv[1], "work") == 0)
+            return work(argv[2], argv[3]);
+
+        if(std::strcmp(argv[1], "merge") == 0)
+            return merge(argv[2], argv[3]);
+
+        std::printf("Unknown mode %s\n", argv[1]);
+    }
+    catch(const std::exception& e) {
+        std::printf("Error: %s\n", e.what());
+    }
+
+    return -1;
+}
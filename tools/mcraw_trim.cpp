@@ -0,0 +1,109 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cuts a clip out of a .mcraw container without touching a pixel: the
+// selected frames' compressed payloads and metadata are copied byte for
+// byte through the streaming Writer, the index is rebuilt for the kept
+// frames, and the audio chunks overlapping the range ride along. A
+// selects reel trims at disk copy speed with zero decode or
+// re-encode cost.
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/Writer.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace motioncam;
+
+int main(int argc, const char* argv[]) {
+    if(argc < 5) {
+        std::printf("Usage: mcraw_trim <input file> <output file> <start seconds> <end seconds>\n");
+        std::printf("The range is relative to the first frame; frames with timestamps inside\n");
+        std::printf("[start, end] are kept, along with the audio covering them.\n");
+        return -1;
+    }
+
+    try {
+        Decoder decoder(argv[1]);
+
+        const auto& frames = decoder.getFrames();
+
+        if(frames.empty()) {
+            std::printf("No frames in %s\n", argv[1]);
+            return -1;
+        }
+
+        const double startSec = std::atof(argv[3]);
+        const double endSec = std::atof(argv[4]);
+
+        if(endSec < startSec) {
+            std::printf("Invalid range\n");
+            return -1;
+        }
+
+        const Timestamp startNs = frames.front() + static_cast<Timestamp>(startSec * 1e9);
+        const Timestamp endNs = frames.front() + static_cast<Timestamp>(endSec * 1e9);
+
+        std::vector<Timestamp> kept;
+
+        for(const auto timestamp : frames) {
+            if(timestamp >= startNs && timestamp <= endNs)
+                kept.push_back(timestamp);
+        }
+
+        if(kept.empty()) {
+            std::printf("No frames in range\n");
+            return -1;
+        }
+
+        Writer out(argv[2], decoder.getContainerMetadata());
+
+        out.enableChecksumIndex();
+        out.setAudioStartTimestampMs(decoder.audioStartTimestampMs());
+
+        // Audio first, so playback reads it ahead of the frames it covers
+        std::vector<AudioChunk> audioChunks;
+        decoder.loadAudioRange(startNs, endNs, audioChunks);
+
+        for(const auto& chunk : audioChunks)
+            out.writeAudio(chunk);
+
+        // The payload and metadata bytes are never decoded, only copied
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> metadataJson;
+
+        for(const auto timestamp : kept) {
+            decoder.loadFramePayload(timestamp, payload, metadataJson);
+
+            out.writeFrame(timestamp, payload.data(), payload.size(),
+                std::string(metadataJson.begin(), metadataJson.end()));
+        }
+
+        out.finish();
+
+        std::printf("Kept %zu of %zu frames and %zu audio chunks -> %s\n",
+            kept.size(), frames.size(), audioChunks.size(), argv[2]);
+    }
+    catch(const std::exception& e) {
+        std::printf("Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Verifies .mcraw archives before the camera originals are deleted:
+// container structure and index consistency are checked from the open
+// alone, then every frame is proven decodable with the reads staying on
+// the calling thread - where payload checksums, when the container or
+// its sidecar carries references, are verified as the bytes arrive -
+// while the decode work fans out across the worker pool. --fast swaps
+// the pixel decode for a structural pass over each payload's block
+// metadata (raw::ComputeFrameLayout), which proves every block read
+// lands inside the payload at a fraction of the cost; a flipped bit in
+// the pixel data itself then only surfaces through the checksums. The
+// audio chunks are walked last. Exits 0 when every input verifies.
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/RawData.hpp>
+#include <motioncam/ThreadPool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace motioncam;
+
+namespace {
+    constexpr int MAX_REPORTED_FAILURES = 10;
+
+    struct Failure {
+        Timestamp timestamp;
+        std::string reason;
+    };
+
+    // Shared result sink for the fan-out; failures are few, so one mutex
+    // around the list costs nothing next to the decode work
+    struct Results {
+        std::mutex mutex;
+        std::vector<Failure> failures;
+        std::atomic<size_t> framesChecked{0};
+
+        void fail(Timestamp timestamp, std::string reason) {
+            std::lock_guard<std::mutex> lock(mutex);
+            failures.push_back({timestamp, std::move(reason)});
+        }
+    };
+
+    // Structural check of one payload: the block metadata must decode and
+    // prove every block read inside the payload, and the geometry must
+    // cover the frame the metadata promised.
+    bool verifyStructure(const std::vector<uint8_t>& payload, int width, int height, std::string& outReason) {
+        raw::FrameLayout layout;
+
+        if(!raw::ComputeFrameLayout(payload.data(), payload.size(), layout)) {
+            outReason = "invalid payload header";
+            return false;
+        }
+
+        if(!layout.verified) {
+            outReason = "block metadata inconsistent with payload size";
+            return false;
+        }
+
+        if(layout.encodedWidth < static_cast<uint32_t>(width)
+            || 4 * layout.groupOffsets.size() < static_cast<size_t>(height))
+        {
+            outReason = "payload smaller than frame dimensions";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool verifyFile(const std::string& path, bool fast, ThreadPool& pool) {
+        const auto startTime = std::chrono::steady_clock::now();
+
+        std::unique_ptr<Decoder> decoder;
+
+        try {
+            decoder.reset(new Decoder(path));
+        }
+        catch(const MotionCamException& e) {
+            std::printf("%s: FAILED (%s)\n", path.c_str(), e.what());
+            return false;
+        }
+
+        const auto& frames = decoder->getFrames();
+
+        // Index consistency: the sorted frame list may not repeat a
+        // timestamp, and every frame must carry an index entry the reads
+        // below will exercise
+        size_t duplicates = 0;
+
+        for(size_t i = 1; i < frames.size(); i++) {
+            if(frames[i] == frames[i - 1])
+                duplicates++;
+        }
+
+        // Checksum references ride along when the archive carries them;
+        // the payload reads then hash on this thread as the bytes arrive
+        bool checksums = true;
+
+        try {
+            decoder->enableChecksumVerification();
+        }
+        catch(const MotionCamException&) {
+            checksums = false;
+        }
+
+        // Archived payloads (mcraw_archive) hide the block structure under
+        // the entropy stage, so the fast pass falls back to a full decode
+        const bool archived = decoder->getTypedContainerMetadata().archiveCodec != 0;
+        const bool structural = fast && !archived;
+
+        Results results;
+        uint64_t payloadBytes = 0;
+
+        // Reads stay here; decode work is bounded so a fast disk cannot
+        // queue the whole clip's payloads in memory
+        const size_t maxInFlight = 4 * std::max<size_t>(1, pool.numThreads());
+
+        std::mutex inFlightMutex;
+        std::condition_variable inFlightCond;
+        size_t inFlight = 0;
+
+        TaskGroup group;
+
+        for(const auto timestamp : frames) {
+            auto payload = std::make_shared<std::vector<uint8_t>>();
+            auto metadataJson = std::make_shared<std::vector<uint8_t>>();
+
+            try {
+                decoder->loadFramePayload(timestamp, *payload, *metadataJson);
+            }
+            catch(const MotionCamException& e) {
+                results.fail(timestamp, e.what());
+                continue;
+            }
+
+            payloadBytes += payload->size();
+
+            {
+                std::unique_lock<std::mutex> lock(inFlightMutex);
+                inFlightCond.wait(lock, [&] { return inFlight < maxInFlight; });
+                inFlight++;
+            }
+
+            Decoder* rawDecoder = decoder.get();
+
+            group.run(pool, Priority::DECODE, [=, &results, &inFlightMutex, &inFlightCond, &inFlight] {
+                try {
+                    if(structural) {
+                        auto metadata = nlohmann::json::parse(metadataJson->begin(), metadataJson->end());
+
+                        const int width = metadata.value("width", 0);
+                        const int height = metadata.value("height", 0);
+
+                        std::string reason;
+
+                        if(width <= 0 || height <= 0)
+                            results.fail(timestamp, "invalid frame metadata");
+                        else if(!verifyStructure(*payload, width, height, reason))
+                            results.fail(timestamp, reason);
+                    }
+                    else {
+                        std::vector<uint16_t> data;
+                        nlohmann::json metadata;
+
+                        rawDecoder->decodeFramePayload(*payload, *metadataJson, data, metadata);
+                    }
+                }
+                catch(const std::exception& e) {
+                    results.fail(timestamp, e.what());
+                }
+
+                results.framesChecked++;
+
+                {
+                    std::lock_guard<std::mutex> lock(inFlightMutex);
+                    inFlight--;
+                }
+
+                inFlightCond.notify_one();
+            });
+        }
+
+        group.wait();
+
+        // The audio chunks are cheap next to the frames; walk them on this
+        // thread once the fan-out has drained
+        size_t audioChunks = 0;
+        bool audioOk = true;
+
+        try {
+            decoder->visitAudio([&audioChunks](Timestamp, const int16_t*, size_t) {
+                audioChunks++;
+            });
+        }
+        catch(const MotionCamException&) {
+            audioOk = false;
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        const double rate = seconds > 0 ? (payloadBytes / (1024.0 * 1024.0)) / seconds : 0;
+
+        const bool ok = results.failures.empty() && duplicates == 0 && audioOk && !frames.empty();
+
+        std::printf("%s: %zu frames%s, %zu audio chunks, %.1f MB in %.2fs (%.0f MB/s)%s%s - %s\n",
+            path.c_str(),
+            frames.size(),
+            structural ? " (structural)" : "",
+            audioChunks,
+            payloadBytes / (1024.0 * 1024.0),
+            seconds,
+            rate,
+            checksums ? ", checksums verified" : "",
+            duplicates > 0 ? ", DUPLICATE TIMESTAMPS" : "",
+            ok ? "OK" : "FAILED");
+
+        if(frames.empty())
+            std::printf("  no frames in container\n");
+
+        if(!audioOk)
+            std::printf("  audio stream is corrupt\n");
+
+        for(size_t i = 0; i < results.failures.size() && i < MAX_REPORTED_FAILURES; i++)
+            std::printf("  frame @%lld: %s\n",
+                static_cast<long long>(results.failures[i].timestamp), results.failures[i].reason.c_str());
+
+        if(results.failures.size() > MAX_REPORTED_FAILURES)
+            std::printf("  ... %zu more\n", results.failures.size() - MAX_REPORTED_FAILURES);
+
+        return ok;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    if(argc < 2) {
+        std::printf("Usage: mcraw_verify <input file> [more inputs] [--fast] [--threads N]\n");
+        std::printf("Checks container structure, index consistency and per-frame decodability,\n");
+        std::printf("fanning the decode work across all cores. --fast validates each payload's\n");
+        std::printf("block structure from its metadata instead of decoding pixels; --threads\n");
+        std::printf("verifies on a private pool of N workers instead of the shared one.\n");
+        return -1;
+    }
+
+    bool fast = false;
+    size_t numThreads = 0;
+    std::vector<std::string> inputs;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--fast") == 0)
+            fast = true;
+        else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            numThreads = static_cast<size_t>(std::atoi(argv[++i]));
+        else
+            inputs.push_back(argv[i]);
+    }
+
+    if(inputs.empty()) {
+        std::printf("No input files\n");
+        return -1;
+    }
+
+    std::unique_ptr<ThreadPool> privatePool;
+
+    if(numThreads > 0)
+        privatePool.reset(new ThreadPool(numThreads));
+
+    ThreadPool& pool = privatePool ? *privatePool : ThreadPool::shared();
+
+    size_t failed = 0;
+
+    for(const auto& input : inputs) {
+        if(!verifyFile(input, fast, pool))
+            failed++;
+    }
+
+    if(inputs.size() > 1)
+        std::printf("%zu/%zu files verified\n", inputs.size() - failed, inputs.size());
+
+    return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,999 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// mcrawd: a long-lived decode service. Per-clip invocations of the example
+// binary pay process start, library init and a cold container open every
+// time; mcrawd keeps a pool of warm decoders - indexes parsed, caches and
+// thread pools spun up - behind a Unix domain socket and amortizes those
+// costs across thousands of requests.
+//
+// Protocol: one request per line, one JSON response line per request.
+//
+//   info <path>                container metadata and frame timestamps
+//   decode <path> <timestamp>  decode a frame; the response line carries the
+//                              dimensions and a shared-memory fd (SCM_RIGHTS)
+//                              holding the pixels, which the client maps
+//                              directly - frames never touch the filesystem
+//   evict <path>               drop the warm decoder for a clip
+//   catalog                    every known clip's summary (frame count,
+//                              duration, geometry, thumbnail, sidecar
+//                              location) from the project catalog in one
+//                              JSON line, so a bin renders without opening
+//                              a single container
+//
+// With --watch <dir> (repeatable), the daemon watches ingest directories
+// and pre-builds the .mcidx sidecar - frame index, per-frame item sizes,
+// binary metadata block and audio overview - for every container that
+// lands in them, at idle I/O priority. By the time an editor clicks a
+// freshly ingested clip its open-time costs are already paid.
+//
+// With --catalog <file>, the watcher also maintains a flat JSON database
+// of every container it has warmed; project load is then one `catalog`
+// request instead of hundreds of cold opens, and Decoders are constructed
+// lazily only when a clip is actually touched.
+//
+// With --metrics-port, a plain HTTP listener on 127.0.0.1 serves GET
+// /metrics in OpenMetrics format for Prometheus: request and error
+// counters, a decode latency histogram (p50/p99 via histogram_quantile),
+// the aggregated Decoder counters of every warm decoder and the pool
+// occupancy. The hot path only bumps relaxed atomics; aggregation work
+// happens on the scraping thread.
+//
+// With --cache-dir, the daemon survives restarts warm: each clip's
+// payload cache spills into a per-clip area under the directory, and the
+// warm-cache state (spilled payloads plus the decoded-frame cache keys,
+// in a versioned manifest) is saved when a decoder is evicted and on
+// SIGINT/SIGTERM. The next instance validates the manifest against the
+// container and repopulates lazily from local disk as frames are
+// touched, so a mid-day deploy costs editors a local read per frame
+// instead of minutes of cold scrubbing against the NAS.
+//
+// Usage: mcrawd <socket path> [--max-decoders N] [--metrics-port N] [--catalog <file>] [--cache-dir <dir>] [--watch <dir>]...
+
+#include <motioncam/Checksum.hpp>
+#include <motioncam/Decoder.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+    #include <sys/inotify.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+#endif
+
+namespace {
+
+// Service counters, bumped with relaxed atomics on the request path so
+// metrics cost a few uncontended increments per request. The decode
+// latency histogram uses fixed millisecond buckets; Prometheus derives
+// p50/p99 with histogram_quantile over them.
+struct Metrics {
+    static constexpr int NUM_BUCKETS = 10;
+
+    // Upper bounds in milliseconds, +Inf implied as the last bucket
+    static constexpr double BUCKET_MS[NUM_BUCKETS] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+
+    std::atomic<uint64_t> infoRequests{0};
+    std::atomic<uint64_t> decodeRequests{0};
+    std::atomic<uint64_t> evictRequests{0};
+    std::atomic<uint64_t> catalogRequests{0};
+    std::atomic<uint64_t> errors{0};
+
+    std::atomic<uint64_t> warmedFiles{0};
+    std::atomic<uint64_t> warmErrors{0};
+
+    std::atomic<uint64_t> decodeLatencyBuckets[NUM_BUCKETS + 1]{};
+    std::atomic<uint64_t> decodeLatencySumNanos{0};
+    std::atomic<uint64_t> frameBytesServed{0};
+
+    void recordDecode(uint64_t nanos, size_t frameBytes) {
+        const double ms = nanos / 1e6;
+
+        int bucket = 0;
+
+        while(bucket < NUM_BUCKETS && ms > BUCKET_MS[bucket])
+            bucket++;
+
+        decodeLatencyBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        decodeLatencySumNanos.fetch_add(nanos, std::memory_order_relaxed);
+        frameBytesServed.fetch_add(frameBytes, std::memory_order_relaxed);
+    }
+};
+
+constexpr double Metrics::BUCKET_MS[];
+
+Metrics gMetrics;
+
+// Warm decoders, least recently used first to go. Each entry carries its own
+// mutex: the decoder's per-instance state means one request per clip at a
+// time, while different clips decode concurrently.
+class DecoderPool {
+public:
+    struct Entry {
+        std::mutex mutex;
+        std::unique_ptr<motioncam::Decoder> decoder;
+    };
+
+    explicit DecoderPool(size_t maxDecoders, std::string cacheDir = std::string())
+        : mMaxDecoders(std::max<size_t>(1, maxDecoders)),
+          mCacheDir(std::move(cacheDir))
+    {
+    }
+
+    std::shared_ptr<Entry> get(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mEntries.find(path);
+
+        if(it != mEntries.end()) {
+            // Move to the back, most recently used
+            mOrder.splice(mOrder.end(), mOrder, it->second.second);
+            return it->second.first;
+        }
+
+        auto entry = std::make_shared<Entry>();
+
+        // The index cache makes the next cold start of this daemon warm too
+        entry->decoder.reset(new motioncam::Decoder(path, motioncam::ReadMode::BUFFERED, true));
+
+        // With a cache area configured, payloads cache in memory and spill
+        // into the clip's slice of it; state saved by a previous instance
+        // is adopted after validation, so this decoder starts with the
+        // clip's hot payloads a local read away instead of behind storage
+        if(!mCacheDir.empty()) {
+            const std::string dir = cacheDirFor(path);
+
+            ::mkdir(dir.c_str(), 0755);
+
+            entry->decoder->setPayloadCacheBudget(64u << 20);
+            entry->decoder->restoreCacheState(dir);
+            entry->decoder->setPayloadCacheSpillDirectory(dir);
+        }
+
+        while(mEntries.size() >= mMaxDecoders) {
+            saveEntry(mOrder.front());
+
+            mEntries.erase(mOrder.front());
+            mOrder.pop_front();
+        }
+
+        mOrder.push_back(path);
+        mEntries.emplace(path, std::make_pair(entry, std::prev(mOrder.end())));
+
+        return entry;
+    }
+
+    void evict(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mEntries.find(path);
+
+        if(it != mEntries.end()) {
+            saveEntry(path);
+
+            mOrder.erase(it->second.second);
+            mEntries.erase(it);
+        }
+    }
+
+    // Persist every warm decoder's cache state; the shutdown path
+    void saveAll() {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        for(const auto& e : mEntries)
+            saveEntry(e.first);
+    }
+
+    // Aggregated Decoder counters across the warm decoders, for the
+    // metrics endpoint. Waits for in-flight requests on each entry -
+    // decodes are milliseconds, scrapes are seconds apart. Evicting a
+    // decoder drops its counts, so the aggregates can step down.
+    motioncam::DecoderStats collectStats(size_t& outWarmDecoders) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        motioncam::DecoderStats total{};
+
+        outWarmDecoders = mEntries.size();
+
+        for(auto& e : mEntries) {
+            Entry& entry = *e.second.first;
+            std::lock_guard<std::mutex> entryLock(entry.mutex);
+
+            const auto stats = entry.decoder->getStats();
+
+            total.bytesRead += stats.bytesRead;
+            total.numSeeks += stats.numSeeks;
+            total.framesDecoded += stats.framesDecoded;
+            total.decodeNanos += stats.decodeNanos;
+            total.metadataParseNanos += stats.metadataParseNanos;
+        }
+
+        return total;
+    }
+
+private:
+    // Each clip's slice of the cache area, keyed by a stable hash of its
+    // path so restarts find it again
+    std::string cacheDirFor(const std::string& path) const {
+        char key[32];
+
+        std::snprintf(key, sizeof(key), "%016llx",
+            static_cast<unsigned long long>(motioncam::Hash64(path.data(), path.size())));
+
+        return mCacheDir + "/" + key;
+    }
+
+    // Called with mMutex held; entry mutexes are only ever taken after the
+    // pool lock is released on the request path, so taking one here is safe
+    void saveEntry(const std::string& path) {
+        if(mCacheDir.empty())
+            return;
+
+        auto it = mEntries.find(path);
+
+        if(it == mEntries.end())
+            return;
+
+        Entry& entry = *it->second.first;
+        std::lock_guard<std::mutex> entryLock(entry.mutex);
+
+        entry.decoder->saveCacheState(cacheDirFor(path));
+    }
+
+    std::mutex mMutex;
+    size_t mMaxDecoders;
+    std::string mCacheDir;
+    std::list<std::string> mOrder;
+    std::map<std::string, std::pair<std::shared_ptr<Entry>, std::list<std::string>::iterator>> mEntries;
+};
+
+// The project catalog: one flat JSON database of every container the
+// ingest watcher has seen - frame count, duration, geometry, audio shape,
+// thumbnail availability and sidecar location - keyed by path. Opening a
+// large project is then one catalog read instead of one cold Decoder open
+// per clip; the daemon serves it whole over the `catalog` command. Saves
+// go through a temp file and rename so a crash mid-write never truncates
+// the database.
+class Catalog {
+public:
+    explicit Catalog(const std::string& path) : mPath(path) {
+        std::ifstream file(path);
+
+        if(file) {
+            nlohmann::json entries = nlohmann::json::parse(file, nullptr, false);
+
+            if(entries.is_object())
+                mEntries = std::move(entries);
+        }
+    }
+
+    // Whether a clip's entry exists and is at least as new as mtime
+    bool isCurrent(const std::string& clipPath, const int64_t mtime) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mEntries.find(clipPath);
+
+        return it != mEntries.end() && it->value("mtime", static_cast<int64_t>(-1)) >= mtime;
+    }
+
+    // Insert or replace one clip's entry and persist
+    void update(const std::string& clipPath, nlohmann::json entry) {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mEntries[clipPath] = std::move(entry);
+
+        save();
+    }
+
+    // Drop entries whose containers no longer exist
+    void prune() {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        bool changed = false;
+
+        for(auto it = mEntries.begin(); it != mEntries.end();) {
+            struct stat st{};
+
+            if(::stat(it.key().c_str(), &st) != 0) {
+                it = mEntries.erase(it);
+                changed = true;
+            }
+            else {
+                ++it;
+            }
+        }
+
+        if(changed)
+            save();
+    }
+
+    // The whole database as one JSON object
+    std::string dump() {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        return mEntries.dump();
+    }
+
+private:
+    void save() {
+        const std::string tmp = mPath + ".tmp";
+
+        {
+            std::ofstream file(tmp, std::ios::trunc);
+
+            file << mEntries;
+
+            if(!file.good())
+                return;
+        }
+
+        ::rename(tmp.c_str(), mPath.c_str());
+    }
+
+    std::string mPath;
+    std::mutex mMutex;
+    nlohmann::json mEntries = nlohmann::json::object();
+};
+
+// One clip's catalog entry, gathered from a decoder the watcher already
+// has open for warming
+nlohmann::json describeClip(motioncam::Decoder& decoder, const std::string& path, const struct stat& st) {
+    const auto& frames = decoder.getFrames();
+
+    nlohmann::json entry;
+
+    entry["bytes"] = static_cast<uint64_t>(st.st_size);
+    entry["mtime"] = static_cast<int64_t>(st.st_mtime);
+    entry["numFrames"] = frames.size();
+    entry["durationSeconds"] = frames.size() > 1 ? (frames.back() - frames.front()) / 1e9 : 0.0;
+
+    // Geometry from the metadata scan; the warming open just built the
+    // sidecar, so this runs over warm pages
+    const auto columns = decoder.loadAllFrameMetadata();
+
+    entry["width"] = columns.widths.empty() ? 0 : columns.widths.front();
+    entry["height"] = columns.heights.empty() ? 0 : columns.heights.front();
+
+    entry["audioSampleRateHz"] = decoder.audioSampleRateHz();
+    entry["audioChannels"] = decoder.numAudioChannels();
+
+    // The poster frame lives in the container itself when present
+    motioncam::Thumbnail thumbnail;
+
+    entry["thumbnail"] = decoder.loadThumbnail(thumbnail) ? path : "";
+
+    struct stat sidecar{};
+
+    entry["sidecar"] = ::stat((path + ".mcidx").c_str(), &sidecar) == 0 ? path + ".mcidx" : "";
+
+    return entry;
+}
+
+// Watches ingest directories and pays every open-time cost of a freshly
+// landed container in the background: a warming open builds the .mcidx
+// sidecar (frame index, per-frame item sizes, binary metadata block) and
+// the audio overview, so the first interactive open - even after this
+// daemon restarts - loads everything from the sidecar. Uses inotify on
+// Linux and falls back to periodic rescans elsewhere; warming runs one
+// file at a time on a thread dropped to idle I/O priority, so it never
+// competes with interactive decodes for the disk.
+class IngestWatcher {
+public:
+    explicit IngestWatcher(std::vector<std::string> dirs, Catalog* catalog = nullptr)
+        : mDirs(std::move(dirs)),
+          mCatalog(catalog)
+    {
+        mThread = std::thread(&IngestWatcher::loop, this);
+    }
+
+    ~IngestWatcher() {
+        mStop.store(true);
+        mThread.join();
+    }
+
+private:
+    static bool isContainer(const std::string& name) {
+        const std::string suffix = ".mcraw";
+
+        return name.size() > suffix.size()
+            && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // Warm one container; a file still mid-transfer fails to open or
+    // index and is simply retried on its next event or rescan
+    void warm(const std::string& path) {
+        struct stat st{};
+
+        // Already warmed (by us or a previous open) and current
+        struct stat sidecar{};
+
+        if(::stat(path.c_str(), &st) != 0)
+            return;
+
+        if(::stat((path + ".mcidx").c_str(), &sidecar) == 0 && sidecar.st_mtime >= st.st_mtime
+            && (!mCatalog || mCatalog->isCurrent(path, static_cast<int64_t>(st.st_mtime))))
+            return;
+
+        try {
+            motioncam::Decoder decoder(path, motioncam::ReadMode::BUFFERED, true);
+
+            // Pull the audio overview too so scrub views get it from the
+            // sidecar instead of decoding the whole track on first show
+            decoder.getAudioOverview();
+
+            if(mCatalog)
+                mCatalog->update(path, describeClip(decoder, path, st));
+
+            gMetrics.warmedFiles.fetch_add(1, std::memory_order_relaxed);
+        }
+        catch(const std::exception&) {
+            gMetrics.warmErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Sweep a directory for containers that still need warming; also the
+    // initial pass, so clips ingested while the daemon was down are
+    // picked up at startup
+    void sweep(const std::string& dir) {
+        DIR* d = opendir(dir.c_str());
+
+        if(!d)
+            return;
+
+        while(const struct dirent* entry = readdir(d)) {
+            if(mStop.load())
+                break;
+
+            if(isContainer(entry->d_name))
+                warm(dir + "/" + entry->d_name);
+        }
+
+        closedir(d);
+    }
+
+    void loop() {
+#if defined(__linux__)
+        // Idle I/O class: warming reads only run when the disk has
+        // nothing better to do. Best effort, as is the nice drop.
+        syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0,
+            (3 << 13) /* IOPRIO_CLASS_IDLE */);
+#endif
+
+        for(const auto& dir : mDirs)
+            sweep(dir);
+
+        // Containers deleted while the daemon was down leave the catalog
+        // with the initial sweep
+        if(mCatalog)
+            mCatalog->prune();
+
+#if defined(__linux__)
+        const int fd = inotify_init1(IN_NONBLOCK);
+
+        if(fd >= 0) {
+            // Warm on finished writes and on moves into the directory -
+            // ingest tools commonly download to a temp name and rename
+            std::map<int, std::string> watches;
+
+            for(const auto& dir : mDirs) {
+                const int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+                if(wd >= 0)
+                    watches[wd] = dir;
+            }
+
+            char buffer[4096];
+
+            while(!mStop.load()) {
+                const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+
+                if(n <= 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                    continue;
+                }
+
+                ssize_t pos = 0;
+
+                while(pos + static_cast<ssize_t>(sizeof(struct inotify_event)) <= n) {
+                    const struct inotify_event* event =
+                        reinterpret_cast<const struct inotify_event*>(buffer + pos);
+
+                    auto watch = watches.find(event->wd);
+
+                    if(watch != watches.end() && event->len > 0 && isContainer(event->name))
+                        warm(watch->second + "/" + event->name);
+
+                    pos += sizeof(struct inotify_event) + event->len;
+                }
+            }
+
+            close(fd);
+            return;
+        }
+#endif
+
+        // No notification mechanism: rescan at a slow cadence
+        while(!mStop.load()) {
+            for(int i = 0; i < 50 && !mStop.load(); i++)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            for(const auto& dir : mDirs)
+                sweep(dir);
+        }
+    }
+
+    std::vector<std::string> mDirs;
+    Catalog* mCatalog;
+    std::atomic<bool> mStop{false};
+    std::thread mThread;
+};
+
+// Anonymous shared-memory segment for a frame handoff. The fd travels to the
+// client over the socket; the segment lives exactly as long as both ends
+// keep it mapped.
+int createFrameShm(size_t bytes) {
+#if defined(__linux__)
+    const int fd = memfd_create("mcrawd-frame", MFD_CLOEXEC);
+#else
+    char name[64];
+    std::snprintf(name, sizeof(name), "/mcrawd-%d-%p", getpid(), (void*)&bytes);
+
+    const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+
+    if(fd >= 0)
+        shm_unlink(name);
+#endif
+
+    if(fd < 0)
+        return -1;
+
+    if(ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// One JSON response line, with an optional fd attached as ancillary data
+bool sendResponse(int client, const std::string& json, int fd) {
+    std::string line = json + "\n";
+
+    struct iovec iov {};
+    iov.iov_base = const_cast<char*>(line.data());
+    iov.iov_len = line.size();
+
+    struct msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))] = {};
+
+    if(fd >= 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    return sendmsg(client, &msg, 0) == static_cast<ssize_t>(line.size());
+}
+
+bool sendError(int client, const std::string& error) {
+    nlohmann::json response;
+
+    response["ok"] = false;
+    response["error"] = error;
+
+    gMetrics.errors.fetch_add(1, std::memory_order_relaxed);
+
+    return sendResponse(client, response.dump(), -1);
+}
+
+void handleInfo(int client, DecoderPool& pool, const std::string& path) {
+    auto entry = pool.get(path);
+    std::lock_guard<std::mutex> lock(entry->mutex);
+
+    nlohmann::json response;
+
+    response["ok"] = true;
+    response["numFrames"] = entry->decoder->getFrames().size();
+    response["timestamps"] = entry->decoder->getFrames();
+    response["containerMetadata"] = entry->decoder->getContainerMetadata();
+
+    sendResponse(client, response.dump(), -1);
+}
+
+void handleDecode(int client, DecoderPool& pool, const std::string& path, motioncam::Timestamp timestamp) {
+    auto entry = pool.get(path);
+    std::lock_guard<std::mutex> lock(entry->mutex);
+
+    std::vector<uint16_t> data;
+    nlohmann::json metadata;
+
+    const auto decodeStart = std::chrono::steady_clock::now();
+
+    entry->decoder->loadFrame(timestamp, data, metadata);
+
+    const size_t bytes = data.size() * sizeof(uint16_t);
+
+    gMetrics.recordDecode(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - decodeStart).count(),
+        bytes);
+    const int fd = createFrameShm(bytes);
+
+    if(fd < 0) {
+        sendError(client, "Failed to create shared memory");
+        return;
+    }
+
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if(mapped == MAP_FAILED) {
+        close(fd);
+        sendError(client, "Failed to map shared memory");
+        return;
+    }
+
+    std::memcpy(mapped, data.data(), bytes);
+    munmap(mapped, bytes);
+
+    nlohmann::json response;
+
+    response["ok"] = true;
+    response["timestamp"] = timestamp;
+    response["width"] = metadata.value("width", 0);
+    response["height"] = metadata.value("height", 0);
+    response["bytes"] = bytes;
+
+    sendResponse(client, response.dump(), fd);
+    close(fd);
+}
+
+// Serve the whole catalog as one response line; the client renders its
+// project bin from this without opening a single container
+void handleCatalog(int client, Catalog* catalog) {
+    if(!catalog) {
+        sendError(client, "No catalog configured");
+        return;
+    }
+
+    sendResponse(client, "{\"ok\":true,\"clips\":" + catalog->dump() + "}", -1);
+}
+
+void handleClient(int client, DecoderPool& pool, Catalog* catalog) {
+    std::string buffer;
+    char chunk[4096];
+
+    for(;;) {
+        const ssize_t n = recv(client, chunk, sizeof(chunk), 0);
+
+        if(n <= 0)
+            break;
+
+        buffer.append(chunk, n);
+
+        size_t eol;
+
+        while((eol = buffer.find('\n')) != std::string::npos) {
+            std::istringstream line(buffer.substr(0, eol));
+            buffer.erase(0, eol + 1);
+
+            std::string command, path;
+            line >> command >> path;
+
+            try {
+                if(command == "info" && !path.empty()) {
+                    gMetrics.infoRequests.fetch_add(1, std::memory_order_relaxed);
+
+                    handleInfo(client, pool, path);
+                }
+                else if(command == "decode" && !path.empty()) {
+                    motioncam::Timestamp timestamp;
+
+                    gMetrics.decodeRequests.fetch_add(1, std::memory_order_relaxed);
+
+                    if(line >> timestamp)
+                        handleDecode(client, pool, path, timestamp);
+                    else
+                        sendError(client, "Missing timestamp");
+                }
+                else if(command == "evict" && !path.empty()) {
+                    gMetrics.evictRequests.fetch_add(1, std::memory_order_relaxed);
+
+                    pool.evict(path);
+
+                    sendResponse(client, "{\"ok\":true}", -1);
+                }
+                else if(command == "catalog") {
+                    gMetrics.catalogRequests.fetch_add(1, std::memory_order_relaxed);
+
+                    handleCatalog(client, catalog);
+                }
+                else {
+                    sendError(client, "Unknown command");
+                }
+            }
+            catch(const std::exception& e) {
+                sendError(client, e.what());
+            }
+        }
+    }
+
+    close(client);
+}
+
+// The scrape body in OpenMetrics text format. Histogram buckets are
+// cumulative and in seconds, as Prometheus expects.
+std::string renderMetrics(DecoderPool& pool) {
+    size_t warmDecoders = 0;
+    const auto stats = pool.collectStats(warmDecoders);
+
+    std::ostringstream out;
+
+    out << "# TYPE mcrawd_requests counter\n";
+    out << "mcrawd_requests_total{command=\"info\"} " << gMetrics.infoRequests.load(std::memory_order_relaxed) << "\n";
+    out << "mcrawd_requests_total{command=\"decode\"} " << gMetrics.decodeRequests.load(std::memory_order_relaxed) << "\n";
+    out << "mcrawd_requests_total{command=\"evict\"} " << gMetrics.evictRequests.load(std::memory_order_relaxed) << "\n";
+    out << "mcrawd_requests_total{command=\"catalog\"} " << gMetrics.catalogRequests.load(std::memory_order_relaxed) << "\n";
+
+    out << "# TYPE mcrawd_errors counter\n";
+    out << "mcrawd_errors_total " << gMetrics.errors.load(std::memory_order_relaxed) << "\n";
+
+    out << "# TYPE mcrawd_warmed_files counter\n";
+    out << "mcrawd_warmed_files_total " << gMetrics.warmedFiles.load(std::memory_order_relaxed) << "\n";
+    out << "# TYPE mcrawd_warm_errors counter\n";
+    out << "mcrawd_warm_errors_total " << gMetrics.warmErrors.load(std::memory_order_relaxed) << "\n";
+
+    out << "# TYPE mcrawd_decode_duration_seconds histogram\n";
+
+    uint64_t cumulative = 0;
+
+    for(int i = 0; i < Metrics::NUM_BUCKETS; i++) {
+        cumulative += gMetrics.decodeLatencyBuckets[i].load(std::memory_order_relaxed);
+
+        out << "mcrawd_decode_duration_seconds_bucket{le=\"" << Metrics::BUCKET_MS[i] / 1000.0 << "\"} " << cumulative << "\n";
+    }
+
+    cumulative += gMetrics.decodeLatencyBuckets[Metrics::NUM_BUCKETS].load(std::memory_order_relaxed);
+
+    out << "mcrawd_decode_duration_seconds_bucket{le=\"+Inf\"} " << cumulative << "\n";
+    out << "mcrawd_decode_duration_seconds_count " << cumulative << "\n";
+    out << "mcrawd_decode_duration_seconds_sum " << gMetrics.decodeLatencySumNanos.load(std::memory_order_relaxed) / 1e9 << "\n";
+
+    out << "# TYPE mcrawd_frame_bytes_served counter\n";
+    out << "mcrawd_frame_bytes_served_total " << gMetrics.frameBytesServed.load(std::memory_order_relaxed) << "\n";
+
+    // Aggregates of the warm decoders' own instrumentation counters
+    out << "# TYPE mcrawd_decoder_bytes_read counter\n";
+    out << "mcrawd_decoder_bytes_read_total " << stats.bytesRead << "\n";
+    out << "# TYPE mcrawd_decoder_seeks counter\n";
+    out << "mcrawd_decoder_seeks_total " << stats.numSeeks << "\n";
+    out << "# TYPE mcrawd_decoder_frames_decoded counter\n";
+    out << "mcrawd_decoder_frames_decoded_total " << stats.framesDecoded << "\n";
+    out << "# TYPE mcrawd_decoder_decode_seconds counter\n";
+    out << "mcrawd_decoder_decode_seconds_total " << stats.decodeNanos / 1e9 << "\n";
+    out << "# TYPE mcrawd_decoder_metadata_parse_seconds counter\n";
+    out << "mcrawd_decoder_metadata_parse_seconds_total " << stats.metadataParseNanos / 1e9 << "\n";
+
+    out << "# TYPE mcrawd_warm_decoders gauge\n";
+    out << "mcrawd_warm_decoders " << warmDecoders << "\n";
+
+    out << "# EOF\n";
+
+    return out.str();
+}
+
+// Minimal HTTP responder for Prometheus scrapes: read the request, send
+// the metrics, close. One scrape at a time is plenty.
+void metricsLoop(int server, DecoderPool& pool) {
+    for(;;) {
+        const int client = accept(server, nullptr, nullptr);
+
+        if(client < 0)
+            break;
+
+        char request[1024];
+
+        if(recv(client, request, sizeof(request), 0) > 0) {
+            const std::string body = renderMetrics(pool);
+
+            std::ostringstream response;
+
+            response << "HTTP/1.1 200 OK\r\n"
+                     << "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+                     << "Content-Length: " << body.size() << "\r\n"
+                     << "Connection: close\r\n\r\n"
+                     << body;
+
+            const std::string full = response.str();
+
+            send(client, full.data(), full.size(), 0);
+        }
+
+        close(client);
+    }
+}
+
+// Loopback TCP listener for the metrics endpoint, -1 on failure
+int openMetricsSocket(int port) {
+    const int server = socket(AF_INET, SOCK_STREAM, 0);
+
+    if(server < 0)
+        return -1;
+
+    const int enable = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+
+    if(bind(server, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 || listen(server, 4) != 0) {
+        close(server);
+        return -1;
+    }
+
+    return server;
+}
+
+// The listening socket, closed from the signal handler so the accept
+// loop unblocks and the shutdown path can save the warm-cache state
+int gServerFd = -1;
+
+void handleShutdownSignal(int) {
+    if(gServerFd >= 0)
+        close(gServerFd);
+}
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    if(argc < 2) {
+        std::printf("Usage: mcrawd <socket path> [--max-decoders N] [--metrics-port N] [--catalog <file>] [--cache-dir <dir>] [--watch <dir>]...\n");
+        return -1;
+    }
+
+    const std::string socketPath(argv[1]);
+    size_t maxDecoders = 16;
+    int metricsPort = 0;
+    std::string catalogPath;
+    std::string cacheDir;
+    std::vector<std::string> watchDirs;
+
+    for(int i = 2; i + 1 < argc; i++) {
+        if(std::strcmp(argv[i], "--max-decoders") == 0)
+            maxDecoders = std::max(1, std::atoi(argv[i + 1]));
+        else if(std::strcmp(argv[i], "--metrics-port") == 0)
+            metricsPort = std::atoi(argv[i + 1]);
+        else if(std::strcmp(argv[i], "--catalog") == 0)
+            catalogPath = argv[i + 1];
+        else if(std::strcmp(argv[i], "--cache-dir") == 0)
+            cacheDir = argv[i + 1];
+        else if(std::strcmp(argv[i], "--watch") == 0)
+            watchDirs.push_back(argv[i + 1]);
+    }
+
+    if(!cacheDir.empty())
+        ::mkdir(cacheDir.c_str(), 0755);
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(server < 0) {
+        std::perror("socket");
+        return -1;
+    }
+
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    unlink(socketPath.c_str());
+
+    if(bind(server, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 || listen(server, 16) != 0) {
+        std::perror("bind");
+        close(server);
+        return -1;
+    }
+
+    std::printf("mcrawd listening on %s (%zu warm decoders)\n", socketPath.c_str(), maxDecoders);
+
+    DecoderPool pool(maxDecoders, cacheDir);
+
+    if(!cacheDir.empty()) {
+        std::printf("warm-cache area at %s\n", cacheDir.c_str());
+
+        // A clean shutdown saves every warm decoder's cache state so the
+        // next instance restarts warm
+        gServerFd = server;
+        std::signal(SIGINT, handleShutdownSignal);
+        std::signal(SIGTERM, handleShutdownSignal);
+    }
+
+    std::unique_ptr<Catalog> catalog;
+
+    if(!catalogPath.empty()) {
+        catalog.reset(new Catalog(catalogPath));
+
+        std::printf("project catalog at %s\n", catalogPath.c_str());
+    }
+
+    std::unique_ptr<IngestWatcher> watcher;
+
+    if(!watchDirs.empty()) {
+        for(const auto& dir : watchDirs)
+            std::printf("warming ingest directory %s\n", dir.c_str());
+
+        watcher.reset(new IngestWatcher(std::move(watchDirs), catalog.get()));
+    }
+
+    if(metricsPort > 0) {
+        const int metricsServer = openMetricsSocket(metricsPort);
+
+        if(metricsServer < 0) {
+            std::perror("metrics bind");
+            close(server);
+            return -1;
+        }
+
+        std::printf("metrics on http://127.0.0.1:%d/metrics\n", metricsPort);
+
+        std::thread(metricsLoop, metricsServer, std::ref(pool)).detach();
+    }
+
+    for(;;) {
+        const int client = accept(server, nullptr, nullptr);
+
+        if(client < 0)
+            break;
+
+        std::thread(handleClient, client, std::ref(pool), catalog.get()).detach();
+    }
+
+    pool.saveAll();
+
+    close(server);
+
+    return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Open-latency benchmark across index sizes. Synthesizes containers of
+// 1k to 1M tiny frames, times Decoder construction on each and breaks
+// the cost into the open phases the stats counters track - index read,
+// index ordering, container metadata parse and the deferred audio item
+// walk - plus a cached (.mcidx sidecar) open for comparison. These are
+// the numbers that justify and protect the flat-index and sidecar work:
+// construction cost grows with the index, not the footage, and only
+// shows up at frame counts no real test clip reaches.
+//
+// Usage: open_bench [--max frames] [--shuffle]
+//
+// --shuffle writes the frames with shuffled timestamps, so the open
+// pays the full index sort instead of the sorted-check fast path.
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/RawData.hpp>
+#include <motioncam/Writer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace motioncam;
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    // Frames only need to exist; one encoding granule keeps the payload
+    // and the synthesis time small even at a million frames
+    constexpr int WIDTH = 64;
+    constexpr int HEIGHT = 4;
+
+    double secondsSince(const Clock::time_point& start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    std::string synthesize(const size_t numFrames, const bool shuffle) {
+        const std::string path = "/tmp/open_bench_" + std::to_string(numFrames) + (shuffle ? "s" : "") + ".mcraw";
+
+        // Reuse a container left by a previous run
+        {
+            std::unique_ptr<FILE, int(*)(FILE*)> existing(fopen(path.c_str(), "rb"), fclose);
+
+            if(existing) {
+                existing.reset();
+
+                try {
+                    if(Decoder(path).getFrames().size() == numFrames)
+                        return path;
+                }
+                catch(MotionCamException&) {
+                }
+            }
+        }
+
+        std::printf("synthesizing %s...\n", path.c_str());
+
+        Writer writer(path, nlohmann::json::object());
+
+        const std::vector<uint16_t> image(static_cast<size_t>(WIDTH) * HEIGHT, 512);
+
+        std::vector<uint8_t> payload;
+        raw::Encode(image.data(), WIDTH, HEIGHT, payload);
+
+        std::vector<size_t> order(numFrames);
+        std::iota(order.begin(), order.end(), 0);
+
+        if(shuffle) {
+            std::mt19937 rng(42);
+            std::shuffle(order.begin(), order.end(), rng);
+        }
+
+        for(const size_t i : order) {
+            const Timestamp timestamp = static_cast<Timestamp>(i + 1) * 33000000LL;
+
+            writer.writeFrame(timestamp, payload.data(), payload.size(),
+                "{\"width\":" + std::to_string(WIDTH) + ",\"height\":" + std::to_string(HEIGHT) +
+                ",\"compressionType\":7,\"timestamp\":" + std::to_string(timestamp) + "}");
+        }
+
+        writer.finish();
+
+        return path;
+    }
+
+    // Best of three, to keep scheduler noise out of the numbers
+    template<typename F>
+    double bestOf(int reps, F&& scenario) {
+        double best = scenario();
+
+        for(int i = 1; i < reps; i++)
+            best = std::min(best, scenario());
+
+        return best;
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    size_t maxFrames = 1000000;
+    bool shuffle = false;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--max") == 0 && i + 1 < argc)
+            maxFrames = static_cast<size_t>(std::atoll(argv[++i]));
+        else if(std::strcmp(argv[i], "--shuffle") == 0)
+            shuffle = true;
+        else {
+            std::printf("Usage: open_bench [--max frames] [--shuffle]\n");
+            return -1;
+        }
+    }
+
+    try {
+        const size_t counts[] = { 1000, 10000, 100000, 1000000 };
+
+        std::printf("%9s %10s %10s %10s %10s %10s %10s\n",
+            "frames", "open ms", "index ms", "sort ms", "meta ms", "audio ms", "cached ms");
+
+        for(const size_t numFrames : counts) {
+            if(numFrames > maxFrames)
+                break;
+
+            const std::string path = synthesize(numFrames, shuffle);
+
+            DecoderStats stats{};
+
+            const double openSeconds = bestOf(3, [&] {
+                const auto start = Clock::now();
+
+                Decoder decoder(path);
+
+                // Audio is lazy; charge the item walk to the open, like a
+                // player that starts the soundtrack immediately would
+                decoder.audioStartTimestampMs();
+
+                const double seconds = secondsSince(start);
+
+                stats = decoder.getStats();
+
+                return seconds;
+            });
+
+            // Sidecar open: the first one writes the .mcidx, the timed
+            // ones read it back instead of touching the container's index
+            remove((path + ".mcidx").c_str());
+
+            { Decoder warm(path, ReadMode::BUFFERED, true); }
+
+            const double cachedSeconds = bestOf(3, [&] {
+                const auto start = Clock::now();
+
+                Decoder decoder(path, ReadMode::BUFFERED, true);
+
+                return secondsSince(start);
+            });
+
+            std::printf("%9zu %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                numFrames,
+                1000.0 * openSeconds,
+                stats.openIndexNanos / 1e6,
+                stats.openSortNanos / 1e6,
+                stats.openMetadataNanos / 1e6,
+                stats.openExtraNanos / 1e6,
+                1000.0 * cachedSeconds);
+        }
+    }
+    catch(MotionCamException& e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
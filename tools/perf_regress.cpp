@@ -0,0 +1,298 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// End-to-end performance guardrails. Runs the macro scenarios the
+// microbenchmarks cannot see - open latency, sequential decode
+// throughput, random-scrub latency and batch (export-side) decode
+// throughput - against a deterministic synthetic container, and compares
+// the results to a recorded JSON baseline. A change that regresses any
+// metric beyond the threshold fails the run with a delta report, so
+// optimization work in RawData.cpp and Decoder.cpp stays won.
+//
+// Usage: perf_regress [--baseline file] [--threshold pct] [--update]
+//
+// Baselines are keyed by machine class (platform + core count) inside the
+// baseline file, so one checked-in file serves a mixed fleet; the first
+// run on a new class records its baseline and passes.
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/RawData.hpp>
+#include <motioncam/Writer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace motioncam;
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    constexpr int WIDTH = 1920;
+    constexpr int HEIGHT = 1080;
+    constexpr int NUM_FRAMES = 48;
+    constexpr int SCRUB_LOADS = 64;
+
+    double secondsSince(const Clock::time_point& start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // The synthetic clip every scenario runs against: fixed seed, so the
+    // container is bit-identical between runs and machines
+    std::string synthesize() {
+        const std::string path = "/tmp/perf_regress.mcraw";
+
+        nlohmann::json metadata;
+        metadata["audioSampleRate"] = 48000;
+        metadata["audioChannels"] = 1;
+
+        Writer writer(path, metadata);
+
+        std::mt19937 rng(42);
+
+        for(int i = 0; i < NUM_FRAMES; i++) {
+            std::vector<uint16_t> image(static_cast<size_t>(WIDTH) * HEIGHT);
+
+            for(auto& v : image)
+                v = rng() & 0x3ff;
+
+            std::vector<uint8_t> payload;
+            raw::Encode(image.data(), WIDTH, HEIGHT, payload);
+
+            const Timestamp timestamp = (i + 1) * 33000000LL;
+
+            writer.writeFrame(timestamp, payload.data(), payload.size(),
+                "{\"width\":" + std::to_string(WIDTH) + ",\"height\":" + std::to_string(HEIGHT) +
+                ",\"compressionType\":7,\"timestamp\":" + std::to_string(timestamp) + "}");
+        }
+
+        writer.finish();
+
+        return path;
+    }
+
+    // Best of three, to keep scheduler noise out of the guardrail
+    template<typename F>
+    double bestOf(int reps, F&& scenario) {
+        double best = scenario();
+
+        for(int i = 1; i < reps; i++)
+            best = std::min(best, scenario());
+
+        return best;
+    }
+
+    double openLatency(const std::string& path) {
+        return bestOf(3, [&] {
+            const auto start = Clock::now();
+            Decoder decoder(path);
+            return secondsSince(start);
+        });
+    }
+
+    double sequentialSeconds(const std::string& path) {
+        return bestOf(3, [&] {
+            Decoder decoder(path);
+            decoder.beginSequentialScan();
+
+            Timestamp timestamp;
+            std::vector<uint16_t> data;
+            nlohmann::json metadata;
+
+            const auto start = Clock::now();
+
+            while(decoder.nextFrame(timestamp, data, metadata))
+                ;
+
+            return secondsSince(start);
+        });
+    }
+
+    // p95 of single-frame loads at shuffled timestamps - the editor-scrub
+    // access pattern
+    double scrubP95(const std::string& path) {
+        Decoder decoder(path);
+
+        std::vector<Timestamp> order = decoder.getFrames();
+        std::mt19937 rng(7);
+
+        std::vector<double> samples;
+        std::vector<uint16_t> data;
+        nlohmann::json metadata;
+
+        while(samples.size() < SCRUB_LOADS) {
+            std::shuffle(order.begin(), order.end(), rng);
+
+            for(const Timestamp timestamp : order) {
+                const auto start = Clock::now();
+                decoder.loadFrame(timestamp, data, metadata);
+                samples.push_back(secondsSince(start));
+
+                if(samples.size() == SCRUB_LOADS)
+                    break;
+            }
+        }
+
+        std::sort(samples.begin(), samples.end());
+
+        return samples[(samples.size() * 95) / 100];
+    }
+
+    // Batch pooled decode across the worker pool: the decode side of the
+    // export pipeline (DNG encoding itself lives with the callers)
+    double batchSeconds(const std::string& path) {
+        return bestOf(3, [&] {
+            Decoder decoder(path);
+            FrameBufferPool pool;
+
+            const auto start = Clock::now();
+
+            decoder.loadFrames(decoder.getFrames(), pool,
+                [](Timestamp, FrameHandle, nlohmann::json) {});
+
+            return secondsSince(start);
+        });
+    }
+
+    std::string machineClass() {
+#if defined(_WIN32)
+        const char* platform = "windows";
+#elif defined(__APPLE__)
+        const char* platform = "macos";
+#else
+        const char* platform = "linux";
+#endif
+        return std::string(platform) + "-" + std::to_string(std::max(1u, std::thread::hardware_concurrency())) + "c";
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    std::string baselinePath = "perf_baseline.json";
+    double thresholdPct = 15.0;
+    bool update = false;
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if(std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            thresholdPct = std::atof(argv[++i]);
+        else if(std::strcmp(argv[i], "--update") == 0)
+            update = true;
+        else {
+            std::printf("Usage: perf_regress [--baseline file] [--threshold pct] [--update]\n");
+            return -1;
+        }
+    }
+
+    try {
+        const std::string path = synthesize();
+        const double frames = NUM_FRAMES;
+
+        nlohmann::json results;
+
+        results["openSeconds"] = openLatency(path);
+        results["sequentialFps"] = frames / sequentialSeconds(path);
+        results["scrubP95Seconds"] = scrubP95(path);
+        results["batchFps"] = frames / batchSeconds(path);
+
+        // false: metric is a latency, lower is better
+        const std::pair<const char*, bool> metrics[] = {
+            { "openSeconds", false },
+            { "sequentialFps", true },
+            { "scrubP95Seconds", false },
+            { "batchFps", true },
+        };
+
+        const std::string machine = machineClass();
+
+        std::printf("machine class %s\n", machine.c_str());
+
+        for(const auto& metric : metrics)
+            std::printf("  %-18s %12.4f\n", metric.first, results[metric.first].get<double>());
+
+        nlohmann::json baselines;
+
+        {
+            std::ifstream file(baselinePath);
+
+            if(file) {
+                baselines = nlohmann::json::parse(file, nullptr, false);
+
+                if(baselines.is_discarded())
+                    baselines = nlohmann::json::object();
+            }
+        }
+
+        if(update || !baselines.contains(machine)) {
+            baselines[machine] = results;
+
+            std::ofstream file(baselinePath, std::ios::trunc);
+            file << baselines.dump(2) << "\n";
+
+            std::printf("%s baseline for %s in %s\n",
+                update ? "Updated" : "Recorded", machine.c_str(), baselinePath.c_str());
+
+            return 0;
+        }
+
+        // Compare against the recorded baseline; report every delta and
+        // fail on any regression beyond the threshold
+        const nlohmann::json& baseline = baselines[machine];
+        bool regressed = false;
+
+        std::printf("vs baseline (threshold %.0f%%):\n", thresholdPct);
+
+        for(const auto& metric : metrics) {
+            if(!baseline.contains(metric.first))
+                continue;
+
+            const double now = results[metric.first].get<double>();
+            const double then = baseline[metric.first].get<double>();
+            const bool higherIsBetter = metric.second;
+
+            // Positive delta = better, in either metric direction
+            const double deltaPct = then > 0
+                ? (higherIsBetter ? (now - then) : (then - now)) / then * 100.0 : 0.0;
+
+            const bool fail = deltaPct < -thresholdPct;
+
+            if(fail)
+                regressed = true;
+
+            std::printf("  %-18s %12.4f -> %12.4f  %+7.1f%%%s\n",
+                metric.first, then, now, deltaPct, fail ? "  REGRESSED" : "");
+        }
+
+        if(regressed) {
+            std::printf("FAIL: performance regressed beyond %.0f%% (re-run with --update to accept)\n", thresholdPct);
+            return 1;
+        }
+
+        std::printf("OK: within threshold\n");
+    }
+    catch(const std::exception& e) {
+        std::printf("Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2023 MotionCam
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// player_example: the reference real-time playback loop. example.cpp shows
+// batch export; this shows how the streaming, caching and scheduling APIs
+// fit together for playback, so integrators copy this instead of
+// reinventing it:
+//
+//  - timestamp-paced decode through PlaybackScheduler, which skips ahead
+//    when decode falls behind the playhead instead of snowballing latency
+//  - a triple buffer of rendered frames, rotated the way a display
+//    swapchain would consume them: one on screen, one ready, one being
+//    rendered
+//  - audio clock sync through audioPositionForFrame(), the alignment
+//    index that maps a frame timestamp to its sample position without
+//    loading the audio track
+//  - a once-per-second stats line from the instrumentation counters
+//
+// Frames go through PreviewEngine but nothing reaches an actual display,
+// so the binary doubles as an end-to-end perf test of the playback path:
+// it exits nonzero when more than --max-drop percent of the frames played
+// were dropped.
+//
+// Usage: player_example <input file> [--rate R] [--seconds N] [--max-drop PCT]
+
+#include <motioncam/Decoder.hpp>
+#include <motioncam/PlaybackScheduler.hpp>
+#include <motioncam/Preview.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// One rotation slot of the display triple buffer
+struct DisplayBuffer {
+    std::vector<uint8_t> rgb;
+    int width{0};
+    int height{0};
+    motioncam::Timestamp timestamp{-1};
+};
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    if(argc < 2) {
+        std::printf("Usage: player_example <input file> [--rate R] [--seconds N] [--max-drop PCT]\n");
+        return -1;
+    }
+
+    const std::string inputPath(argv[1]);
+    double rate = 1.0;
+    double maxSeconds = 0;     // 0 plays the whole clip
+    double maxDropPercent = 100.0;
+
+    for(int i = 2; i + 1 < argc; i++) {
+        if(std::strcmp(argv[i], "--rate") == 0)
+            rate = std::atof(argv[i + 1]);
+        else if(std::strcmp(argv[i], "--seconds") == 0)
+            maxSeconds = std::atof(argv[i + 1]);
+        else if(std::strcmp(argv[i], "--max-drop") == 0)
+            maxDropPercent = std::atof(argv[i + 1]);
+    }
+
+    if(rate <= 0) {
+        std::printf("Rate must be positive\n");
+        return -1;
+    }
+
+    try {
+        motioncam::Decoder decoder(inputPath);
+
+        const auto& frames = decoder.getFrames();
+
+        if(frames.size() < 2) {
+            std::printf("Not enough frames to play\n");
+            return -1;
+        }
+
+        // Display cadence from the recorded timestamps
+        const double clipSeconds = (frames.back() - frames.front()) / 1e9;
+        const double fps = (frames.size() - 1) / clipSeconds;
+
+        const int sampleRate = decoder.audioSampleRateHz();
+
+        // Build the audio alignment index before playback starts: the
+        // scheduler owns the decoder's read paths once it runs, and after
+        // this first call every lookup is a binary search, never a read
+        const int64_t firstSample = sampleRate > 0 ? decoder.audioPositionForFrame(frames.front()) : -1;
+
+        std::printf("%s: %zu frames, %.2f fps, %.1fs", inputPath.c_str(), frames.size(), fps, clipSeconds);
+
+        if(sampleRate > 0)
+            std::printf(", audio %d Hz x%d", sampleRate, decoder.numAudioChannels());
+
+        std::printf(", playing at %.2fx\n", rate);
+
+        // Ring of 3: one frame on screen, one decoded and waiting, one
+        // being decoded - the classic swapchain depth
+        motioncam::PlaybackScheduler scheduler(decoder, 3);
+        motioncam::PreviewEngine preview(decoder.getTypedContainerMetadata());
+
+        DisplayBuffer displayBuffers[3];
+        int front = 0;
+
+        motioncam::PlaybackScheduler::Frame frame;
+
+        scheduler.seek(frames.front(), rate);
+
+        const auto start = Clock::now();
+        const std::chrono::nanoseconds tick(static_cast<int64_t>(1e9 / (fps * rate)));
+        auto nextVsync = start + tick;
+
+        auto statsWall = start;
+        auto lastStats = decoder.getStats();
+        auto lastPlayback = scheduler.getStats();
+
+        uint64_t presented = 0, repeats = 0;
+        uint64_t statsPresented = 0, statsRepeats = 0;
+        double lateMs = 0, avOffsetMs = 0;
+
+        for(;;) {
+            if(scheduler.getFrame(frame)) {
+                // Render into the back buffer and rotate, as a present would
+                DisplayBuffer& buffer = displayBuffers[front];
+                front = (front + 1) % 3;
+
+                preview.render(frame.data, frame.metadata, buffer.rgb, buffer.width, buffer.height);
+                buffer.timestamp = frame.timestamp;
+
+                presented++;
+                statsPresented++;
+
+                // How far the frame on screen trails the playhead
+                lateMs = (scheduler.playhead() - frame.timestamp) / 1e6;
+
+                // Audio clock sync: the alignment index gives the sample a
+                // real audio device would be playing when this frame shows;
+                // the difference to the frame's own media position is the
+                // A/V offset a player would correct for
+                if(sampleRate > 0) {
+                    const double audioSeconds = (decoder.audioPositionForFrame(frame.timestamp) - firstSample) / static_cast<double>(sampleRate);
+                    const double mediaSeconds = (frame.timestamp - frames.front()) / 1e9;
+
+                    avOffsetMs = (audioSeconds - mediaSeconds) * 1e3;
+                }
+            }
+            else {
+                // Nothing new decoded: the previous frame stays on screen
+                statsRepeats++;
+                repeats++;
+            }
+
+            std::this_thread::sleep_until(nextVsync);
+            nextVsync += tick;
+
+            const auto now = Clock::now();
+
+            // The on-screen stats line, from the instrumentation counters
+            if(now - statsWall >= std::chrono::seconds(1)) {
+                const double interval = std::chrono::duration<double>(now - statsWall).count();
+                const auto stats = decoder.getStats();
+                const auto playback = scheduler.getStats();
+
+                // Decode throughput over the interval: decoded pixel bytes
+                // (the preview's source geometry, 4x the preview pixels)
+                // over time spent inside raw::Decode
+                const double decodeSeconds = (stats.decodeNanos - lastStats.decodeNanos) / 1e9;
+                const double frameBytes = 4.0 * displayBuffers[0].width * displayBuffers[0].height * sizeof(uint16_t);
+                const double decodeRate = decodeSeconds > 0
+                    ? (stats.framesDecoded - lastStats.framesDecoded) * frameBytes / decodeSeconds / 1048576.0
+                    : 0;
+
+                std::printf("fps %5.1f  repeat %2llu  drop %2llu  late %6.1fms  a/v %+5.1fms  decode %6.1f MB/s  read %6.1f MB/s\n",
+                    statsPresented / interval,
+                    static_cast<unsigned long long>(statsRepeats),
+                    static_cast<unsigned long long>(playback.framesDropped - lastPlayback.framesDropped),
+                    lateMs,
+                    avOffsetMs,
+                    decodeRate,
+                    (stats.bytesRead - lastStats.bytesRead) / interval / 1048576.0);
+
+                statsWall = now;
+                lastStats = stats;
+                lastPlayback = playback;
+                statsPresented = 0;
+                statsRepeats = 0;
+            }
+
+            if(scheduler.playhead() >= frames.back())
+                break;
+
+            if(maxSeconds > 0 && std::chrono::duration<double>(now - start).count() >= maxSeconds)
+                break;
+        }
+
+        const double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+        const auto playback = scheduler.getStats();
+
+        std::printf("\n%llu frames presented, %llu repeated, %llu dropped in %.2fs (%.1f fps)\n",
+            static_cast<unsigned long long>(presented),
+            static_cast<unsigned long long>(repeats),
+            static_cast<unsigned long long>(playback.framesDropped),
+            wallSeconds,
+            presented / wallSeconds);
+
+        const double dropPercent = playback.framesDecoded + playback.framesDropped > 0
+            ? 100.0 * playback.framesDropped / (playback.framesDecoded + playback.framesDropped)
+            : 0;
+
+        if(dropPercent > maxDropPercent) {
+            std::printf("FAILED: %.1f%% of frames dropped (max %.1f%%)\n", dropPercent, maxDropPercent);
+            return 1;
+        }
+    }
+    catch(motioncam::MotionCamException& e) {
+        std::printf("Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}